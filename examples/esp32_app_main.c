@@ -24,6 +24,9 @@ static const char* TAG = "app_main";
 /* Replace with your phone's Bluetooth MAC address */
 static const uint8_t PHONE_BD_ADDR[6] = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
 
+/* Provided by ports/esp32_classic/tinypan_hal_esp32.c */
+extern void hal_esp32_acl_disconnected(const uint8_t bda[6], int reason);
+
 /* ============================================================================
  * GAP Security Callback
  *
@@ -56,6 +59,12 @@ static void gap_callback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *par
             break;
         }
 
+        case ESP_BT_GAP_ACL_DISCONN_CMPL_STAT_EVT:
+            /* The HCI reason picks TinyPAN's reconnect backoff */
+            hal_esp32_acl_disconnected(param->acl_disconn_cmpl_stat.bda,
+                                       param->acl_disconn_cmpl_stat.reason);
+            break;
+
         default:
             break;
     }
@@ -7,6 +7,7 @@
 
 #include "../../include/tinypan_hal.h"
 #include "../../include/tinypan_config.h"
+#include "tinypan_hal_mock.h"
 #if TINYPAN_ENABLE_LWIP
 #include "lwip/pbuf.h"
 #endif
@@ -31,12 +32,16 @@
 static bool s_initialized = false;
 static bool s_connected = false;
 static bool s_can_send = true;
+static uint16_t s_link_mtu = 1500;
 
 static uint8_t s_local_addr[HAL_BD_ADDR_LEN] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
 
 static hal_l2cap_recv_callback_t s_recv_callback = NULL;
 static void* s_recv_callback_user_data = NULL;
 
+static hal_l2cap_direct_recv_callback_t s_direct_recv_callback = NULL;
+static void* s_direct_recv_callback_user_data = NULL;
+
 static hal_l2cap_event_callback_t s_event_callback = NULL;
 static void* s_event_callback_user_data = NULL;
 
@@ -51,7 +56,68 @@ static uint32_t s_mock_tick_ms = 0;
 static uint8_t s_tx_history_data[MOCK_TX_HISTORY_LEN][1500] = {0};
 static uint16_t s_tx_history_len[MOCK_TX_HISTORY_LEN] = {0};
 static int s_tx_history_head = 0;
+static uint32_t s_tx_count = 0;
 static bool s_tx_complete_pending = false;
+static uint32_t s_tx_complete_due_ms = 0;
+static uint32_t s_tx_complete_delay_ms = 0;
+static uint32_t s_tx_complete_drops = 0;     /* Completions still to be lost */
+
+/* Connection-event model: a controller with a fixed number of TX buffers that
+ * transmits up to s_ce_per_event packets every s_ce_interval_ms of mock time.
+ * Disabled (interval 0) by default, in which case sends are never throttled. */
+static uint16_t s_ce_interval_ms = 0;
+static uint16_t s_ce_per_event = 0;
+static uint16_t s_ce_buffers = 0;
+static uint16_t s_ce_queued = 0;
+static uint32_t s_ce_next_event_ms = 0;
+static bool s_ce_notify_pending = false;
+static bool s_ce_hidden = false;
+static mock_hal_conn_event_stats_t s_ce_stats;
+
+/* Accept tick of each buffered packet, oldest at s_ce_accept_head */
+#define MOCK_CE_MAX_BUFFERS 16
+static uint32_t s_ce_accept_ms[MOCK_CE_MAX_BUFFERS];
+static uint16_t s_ce_accept_head = 0;
+
+/* Link power hints: TX anchors every s_anchor_interval_ms of HAL time
+ * (0 = none), and the last idle/busy hint from the stack */
+static uint32_t s_anchor_interval_ms = 0;
+static bool s_link_idle = true;
+static uint32_t s_link_idle_hints = 0;
+
+/* TX recovery: what hal_bt_l2cap_cancel_tx() returns, and how often it ran */
+static int s_cancel_tx_result = 0;
+static uint32_t s_cancel_tx_calls = 0;
+
+/* Persistent storage: survives hal_bt_init(), like flash across a reboot */
+#define MOCK_STORAGE_SIZE 512
+static uint8_t s_storage[MOCK_STORAGE_SIZE];
+static uint16_t s_storage_len = 0;
+static uint32_t s_storage_writes = 0;
+
+#ifndef _WIN32
+/* RX reader thread model (see mock_hal_rx_thread_start()): injected frames
+ * wait in the "air" ring for the reader; frames the direct callback declines
+ * wait in the bridge ring for hal_bt_poll(), like the ESP32 port's
+ * read() -> MessageBuffer -> app task path. */
+#define MOCK_RX_SLOTS       16
+#define MOCK_RX_FRAME_MAX   1700
+
+typedef struct {
+    uint8_t data[MOCK_RX_SLOTS][MOCK_RX_FRAME_MAX];
+    uint16_t len[MOCK_RX_SLOTS];
+    uint32_t head;
+    uint32_t tail;
+} mock_rx_ring_t;
+
+static mock_rx_ring_t s_rx_air;
+static mock_rx_ring_t s_rx_bridge;
+static pthread_mutex_t s_rx_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_rx_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t s_direct_recv_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t s_rx_thread;
+static bool s_rx_thread_running = false;
+#endif
 
 /* ============================================================================
  * Mock Control API (for testing)
@@ -107,13 +173,20 @@ void mock_hal_simulate_connect_failure(int status) {
  * @brief Simulate L2CAP disconnection
  */
 void mock_hal_simulate_disconnect(void) {
+    mock_hal_simulate_disconnect_reason(0);
+}
+
+/**
+ * @brief Simulate L2CAP disconnection with an HCI reason
+ */
+void mock_hal_simulate_disconnect_reason(int status) {
     if (!s_initialized) return;
     
     s_connected = false;
-    TINYPAN_LOG_DEBUG("[MOCK] Simulating L2CAP disconnect");
+    TINYPAN_LOG_DEBUG("[MOCK] Simulating L2CAP disconnect: %d", status);
     
     if (s_event_callback) {
-        s_event_callback(HAL_L2CAP_EVENT_DISCONNECTED, 0, s_event_callback_user_data);
+        s_event_callback(HAL_L2CAP_EVENT_DISCONNECTED, status, s_event_callback_user_data);
     }
     
     if (s_wakeup_cb) s_wakeup_cb(s_wakeup_cb_data);
@@ -136,6 +209,146 @@ void mock_hal_simulate_receive(const uint8_t* data, uint16_t len) {
     }
 }
 
+#ifndef _WIN32
+static bool rx_ring_empty(const mock_rx_ring_t* ring) {
+    return ring->head == ring->tail;
+}
+
+static bool rx_ring_full(const mock_rx_ring_t* ring) {
+    return ring->tail - ring->head == MOCK_RX_SLOTS;
+}
+
+static void rx_ring_put(mock_rx_ring_t* ring, const uint8_t* data, uint16_t len) {
+    uint32_t slot = ring->tail % MOCK_RX_SLOTS;
+    memcpy(ring->data[slot], data, len);
+    ring->len[slot] = len;
+    ring->tail++;
+}
+
+static uint16_t rx_ring_get(mock_rx_ring_t* ring, uint8_t* out) {
+    uint32_t slot = ring->head % MOCK_RX_SLOTS;
+    uint16_t len = ring->len[slot];
+    memcpy(out, ring->data[slot], len);
+    ring->head++;
+    return len;
+}
+
+/**
+ * @brief RX reader thread: "reads" each injected frame, offers it to the
+ *        direct callback and queues it for hal_bt_poll() if declined
+ */
+static void* rx_reader_thread_fn(void* arg) {
+    static uint8_t buf[MOCK_RX_FRAME_MAX];     /* The reader's read() buffer */
+    (void)arg;
+
+    pthread_mutex_lock(&s_rx_lock);
+    for (;;) {
+        /* Backpressure: only read while the bridge can take a frame */
+        while (s_rx_thread_running && (rx_ring_empty(&s_rx_air) || rx_ring_full(&s_rx_bridge))) {
+            pthread_cond_wait(&s_rx_cond, &s_rx_lock);
+        }
+        if (!s_rx_thread_running) {
+            break;
+        }
+        uint16_t len = rx_ring_get(&s_rx_air, buf);
+        pthread_cond_broadcast(&s_rx_cond);
+        pthread_mutex_unlock(&s_rx_lock);
+
+        bool consumed = false;
+        pthread_mutex_lock(&s_direct_recv_lock);
+        if (s_direct_recv_callback) {
+            consumed = s_direct_recv_callback(buf, len, s_direct_recv_callback_user_data);
+        }
+        pthread_mutex_unlock(&s_direct_recv_lock);
+
+        if (!consumed) {
+            pthread_mutex_lock(&s_rx_lock);
+            rx_ring_put(&s_rx_bridge, buf, len);
+            pthread_mutex_unlock(&s_rx_lock);
+            if (s_wakeup_cb) s_wakeup_cb(s_wakeup_cb_data);
+        }
+        pthread_mutex_lock(&s_rx_lock);
+    }
+    pthread_mutex_unlock(&s_rx_lock);
+    return NULL;
+}
+
+/**
+ * @brief Deliver bridged frames to the receive callback (from hal_bt_poll())
+ */
+static void rx_bridge_drain(void) {
+    static uint8_t buf[MOCK_RX_FRAME_MAX];
+
+    for (;;) {
+        pthread_mutex_lock(&s_rx_lock);
+        if (rx_ring_empty(&s_rx_bridge)) {
+            pthread_mutex_unlock(&s_rx_lock);
+            return;
+        }
+        uint16_t len = rx_ring_get(&s_rx_bridge, buf);
+        pthread_cond_broadcast(&s_rx_cond);
+        pthread_mutex_unlock(&s_rx_lock);
+
+        if (s_recv_callback) {
+            s_recv_callback(buf, len, s_recv_callback_user_data);
+        }
+    }
+}
+#endif /* !_WIN32 */
+
+int mock_hal_rx_thread_start(void) {
+#ifdef _WIN32
+    return -1;
+#else
+    if (s_rx_thread_running) return 0;
+    memset(&s_rx_air, 0, sizeof(s_rx_air));
+    memset(&s_rx_bridge, 0, sizeof(s_rx_bridge));
+    s_rx_thread_running = true;
+    if (pthread_create(&s_rx_thread, NULL, rx_reader_thread_fn, NULL) != 0) {
+        s_rx_thread_running = false;
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+void mock_hal_rx_thread_stop(void) {
+#ifndef _WIN32
+    pthread_mutex_lock(&s_rx_lock);
+    if (!s_rx_thread_running) {
+        pthread_mutex_unlock(&s_rx_lock);
+        return;
+    }
+    s_rx_thread_running = false;
+    pthread_cond_broadcast(&s_rx_cond);
+    pthread_mutex_unlock(&s_rx_lock);
+    pthread_join(s_rx_thread, NULL);
+#endif
+}
+
+bool mock_hal_rx_thread_inject(const uint8_t* data, uint16_t len) {
+#ifdef _WIN32
+    (void)data;
+    (void)len;
+    return false;
+#else
+    if (!s_initialized || !s_connected) return false;
+    if (data == NULL || len == 0 || len > MOCK_RX_FRAME_MAX) return false;
+
+    pthread_mutex_lock(&s_rx_lock);
+    while (s_rx_thread_running && rx_ring_full(&s_rx_air)) {
+        pthread_cond_wait(&s_rx_cond, &s_rx_lock);
+    }
+    bool ok = s_rx_thread_running;
+    if (ok) {
+        rx_ring_put(&s_rx_air, data, len);
+        pthread_cond_broadcast(&s_rx_cond);
+    }
+    pthread_mutex_unlock(&s_rx_lock);
+    return ok;
+#endif
+}
+
 /**
  * @brief Simulate BNEP setup response (success)
  */
@@ -157,6 +370,118 @@ void mock_hal_set_can_send(bool can_send) {
     if (can_send && s_wakeup_cb) s_wakeup_cb(s_wakeup_cb_data);
 }
 
+/**
+ * @brief Set the link MTU reported by hal_bt_l2cap_get_mtu()
+ */
+void mock_hal_set_mtu(uint16_t mtu) {
+    s_link_mtu = mtu;
+}
+
+/**
+ * @brief Enable the connection-event model
+ */
+void mock_hal_set_conn_event_model(uint16_t interval_ms, uint16_t packets_per_event, uint16_t tx_buffers) {
+    s_ce_interval_ms = interval_ms;
+    s_ce_per_event = packets_per_event;
+    s_ce_buffers = (tx_buffers < MOCK_CE_MAX_BUFFERS) ? tx_buffers : MOCK_CE_MAX_BUFFERS;
+    s_ce_queued = 0;
+    s_ce_accept_head = 0;
+    s_ce_next_event_ms = hal_get_tick_ms() + interval_ms;
+    s_ce_notify_pending = false;
+    s_ce_hidden = false;
+    memset(&s_ce_stats, 0, sizeof(s_ce_stats));
+}
+
+/**
+ * @brief Hide the controller's free buffer count
+ */
+void mock_hal_set_conn_event_hidden_buffers(bool hidden) {
+    s_ce_hidden = hidden;
+}
+
+/**
+ * @brief Delay TX_COMPLETE events
+ */
+void mock_hal_set_tx_complete_delay(uint32_t delay_ms) {
+    s_tx_complete_delay_ms = delay_ms;
+}
+
+/**
+ * @brief Lose the TX_COMPLETE of the next sends
+ */
+void mock_hal_drop_tx_completes(uint32_t count) {
+    s_tx_complete_drops = count;
+}
+
+/**
+ * @brief Set the TX anchor interval
+ */
+void mock_hal_set_tx_anchor(uint32_t interval_ms) {
+    s_anchor_interval_ms = interval_ms;
+}
+
+/**
+ * @brief Get the last link idle hint
+ */
+bool mock_hal_get_link_idle(uint32_t* hints) {
+    if (hints) *hints = s_link_idle_hints;
+    return s_link_idle;
+}
+
+/**
+ * @brief Set the result of hal_bt_l2cap_cancel_tx()
+ */
+void mock_hal_set_cancel_tx(int result) {
+    s_cancel_tx_result = result;
+}
+
+/**
+ * @brief Get the number of hal_bt_l2cap_cancel_tx() calls
+ */
+uint32_t mock_hal_get_cancel_tx_count(void) {
+    return s_cancel_tx_calls;
+}
+
+/**
+ * @brief Get connection-event model counters
+ */
+void mock_hal_get_conn_event_stats(mock_hal_conn_event_stats_t* stats) {
+    *stats = s_ce_stats;
+    stats->queued = s_ce_queued;
+}
+
+/**
+ * @brief Run every connection event that is due at the current tick
+ */
+static void mock_hal_run_conn_events(void) {
+    uint32_t now = hal_get_tick_ms();
+    while ((int32_t)(now - s_ce_next_event_ms) >= 0) {
+        uint16_t sent = (s_ce_queued < s_ce_per_event) ? s_ce_queued : s_ce_per_event;
+        for (uint16_t i = 0; i < sent; i++) {
+            uint32_t waited = s_ce_next_event_ms - s_ce_accept_ms[s_ce_accept_head];
+            s_ce_accept_head = (uint16_t)((s_ce_accept_head + 1) % MOCK_CE_MAX_BUFFERS);
+            s_ce_stats.residence_total_ms += waited;
+            if (waited > s_ce_stats.residence_max_ms) {
+                s_ce_stats.residence_max_ms = waited;
+            }
+        }
+        s_ce_queued -= sent;
+        s_ce_stats.events++;
+        s_ce_stats.packets_on_air += sent;
+        if (sent == 0) {
+            s_ce_stats.idle_events++;
+        }
+        s_ce_next_event_ms += s_ce_interval_ms;
+
+        if (sent > 0 && s_ce_notify_pending) {
+            s_ce_notify_pending = false;
+            if (s_event_callback) {
+                s_event_callback(HAL_L2CAP_EVENT_CAN_SEND_NOW, 0, s_event_callback_user_data);
+            }
+        }
+    }
+}
+
 /**
  * @brief Check if mock is connected
  */
@@ -174,20 +499,42 @@ int hal_bt_init(void) {
     s_connected = false;
     s_can_send = true;
     s_mock_tick_ms = 0;
+    s_ce_interval_ms = 0;
+    s_link_mtu = 1500;
+    s_tx_complete_pending = false;
+    s_tx_complete_delay_ms = 0;
+    s_tx_complete_drops = 0;
+    s_anchor_interval_ms = 0;
+    s_link_idle = true;
+    s_link_idle_hints = 0;
+    s_cancel_tx_result = 0;
+    s_cancel_tx_calls = 0;
     return 0;
 }
 
 void hal_bt_deinit(void) {
     TINYPAN_LOG_INFO("[MOCK] HAL de-initializing");
+#ifndef _WIN32
+    mock_hal_rx_thread_stop();
+#endif
     s_initialized = false;
     s_connected = false;
     s_recv_callback = NULL;
+    s_direct_recv_callback = NULL;
     s_event_callback = NULL;
 }
 
 void hal_bt_poll(void) {
+    if (s_ce_interval_ms > 0) {
+        mock_hal_run_conn_events();
+    }
+
+#ifndef _WIN32
+    rx_bridge_drain();
+#endif
+
     /* Deliver any deferred TX_COMPLETE events from the previous send call */
-    if (s_tx_complete_pending) {
+    if (s_tx_complete_pending && (int32_t)(hal_get_tick_ms() - s_tx_complete_due_ms) >= 0) {
         s_tx_complete_pending = false;
         if (s_event_callback) {
             s_event_callback(HAL_L2CAP_EVENT_TX_COMPLETE, 0, s_event_callback_user_data);
@@ -224,10 +571,22 @@ int hal_bt_l2cap_send(const uint8_t* data, uint16_t len) {
     if (!s_can_send) {
         return 1; /* WOULD BLOCK */
     }
+
+    if (s_ce_interval_ms > 0) {
+        if (s_ce_queued >= s_ce_buffers) {
+            s_ce_stats.busy_returns++;
+            return 1; /* Controller buffers full until the next connection event */
+        }
+        s_ce_accept_ms[(s_ce_accept_head + s_ce_queued) % MOCK_CE_MAX_BUFFERS] = hal_get_tick_ms();
+        s_ce_queued++;
+        s_ce_stats.packets_accepted++;
+        s_ce_stats.bytes_accepted += len;
+    }
     
     TINYPAN_LOG_DEBUG("[MOCK] Sending %u bytes:", len);
     
     /* Store in history */
+    s_tx_count++;
     s_tx_history_head = (s_tx_history_head + 1) % MOCK_TX_HISTORY_LEN;
     s_tx_history_len[s_tx_history_head] = len;
     uint8_t* history_buf = s_tx_history_data[s_tx_history_head];
@@ -254,7 +613,21 @@ bool hal_bt_l2cap_can_send(void) {
     return s_initialized && s_connected && s_can_send;
 }
 
+uint16_t hal_bt_l2cap_get_tx_credits(void) {
+    if (!hal_bt_l2cap_can_send()) return 0;
+    if (s_ce_interval_ms > 0 && !s_ce_hidden) {
+        return (uint16_t)(s_ce_buffers - s_ce_queued);
+    }
+    return 1; /* No buffer model: behave like a HAL that cannot tell */
+}
+
 void hal_bt_l2cap_request_can_send_now(void) {
+    if (s_ce_interval_ms > 0 && s_ce_queued >= s_ce_buffers) {
+        /* Fired by the connection event that frees a buffer */
+        s_ce_notify_pending = true;
+        return;
+    }
+
     /* In mock, immediately fire event if can send */
     if (s_can_send && s_event_callback) {
         s_event_callback(HAL_L2CAP_EVENT_CAN_SEND_NOW, 0, s_event_callback_user_data);
@@ -278,6 +651,7 @@ int hal_bt_l2cap_send_iovec(const tinypan_iovec_t* iov, uint16_t iov_count) {
     TINYPAN_LOG_DEBUG("[MOCK] Sending iovec array, tot_len=%u", tot_len);
     
     /* Store in history for tests/simulations */
+    s_tx_count++;
     s_tx_history_head = (s_tx_history_head + 1) % MOCK_TX_HISTORY_LEN;
     s_tx_history_len[s_tx_history_head] = (uint16_t)tot_len;
     uint8_t* history_buf = s_tx_history_data[s_tx_history_head];
@@ -309,7 +683,12 @@ int hal_bt_l2cap_send_iovec(const tinypan_iovec_t* iov, uint16_t iov_count) {
     
     TINYPAN_LOG_DEBUG("[MOCK] TX: %s", hex);
     
-    s_tx_complete_pending = true;
+    if (s_tx_complete_drops > 0) {
+        s_tx_complete_drops--;      /* Lost: the stack never hears of it */
+    } else {
+        s_tx_complete_pending = true;
+        s_tx_complete_due_ms = hal_get_tick_ms() + s_tx_complete_delay_ms;
+    }
     
     return 0;
 }
@@ -319,6 +698,17 @@ void hal_bt_l2cap_register_recv_callback(hal_l2cap_recv_callback_t callback, voi
     s_recv_callback_user_data = user_data;
 }
 
+void hal_bt_l2cap_register_direct_recv_callback(hal_l2cap_direct_recv_callback_t callback, void* user_data) {
+#ifndef _WIN32
+    pthread_mutex_lock(&s_direct_recv_lock);
+#endif
+    s_direct_recv_callback = callback;
+    s_direct_recv_callback_user_data = user_data;
+#ifndef _WIN32
+    pthread_mutex_unlock(&s_direct_recv_lock);
+#endif
+}
+
 void hal_bt_l2cap_register_event_callback(hal_l2cap_event_callback_t callback, void* user_data) {
     s_event_callback = callback;
     s_event_callback_user_data = user_data;
@@ -333,6 +723,10 @@ void hal_get_local_bd_addr(uint8_t addr[HAL_BD_ADDR_LEN]) {
     memcpy(addr, s_local_addr, HAL_BD_ADDR_LEN);
 }
 
+void mock_hal_set_local_addr(const uint8_t addr[HAL_BD_ADDR_LEN]) {
+    memcpy(s_local_addr, addr, HAL_BD_ADDR_LEN);
+}
+
 uint32_t hal_get_tick_ms(void) {
     if (s_use_mock_time) {
         return s_mock_tick_ms;
@@ -347,11 +741,16 @@ uint32_t hal_get_tick_ms(void) {
 }
 
 uint32_t hal_bt_get_next_timeout_ms(void) {
+    if (s_ce_interval_ms > 0 && s_ce_queued > 0) {
+        uint32_t now = hal_get_tick_ms();
+        if ((int32_t)(s_ce_next_event_ms - now) <= 0) return 0;
+        return s_ce_next_event_ms - now;
+    }
     return 0xFFFFFFFF;
 }
 
 uint16_t hal_bt_l2cap_get_mtu(void) {
-    return 1500;
+    return s_link_mtu;
 }
 
 hal_mutex_t hal_mutex_create(void) {
@@ -394,6 +793,52 @@ void hal_mutex_destroy(hal_mutex_t mutex) {
     free(mutex);
 }
 
+uint32_t hal_bt_tx_burst_delay_ms(uint32_t max_delay_ms) {
+    if (s_anchor_interval_ms == 0) return max_delay_ms;
+    /* Last anchor (a multiple of the interval) within the budget */
+    uint32_t now = hal_get_tick_ms();
+    uint32_t last = ((now + max_delay_ms) / s_anchor_interval_ms) * s_anchor_interval_ms;
+    return ((int32_t)(last - now) >= 0) ? (last - now) : max_delay_ms;
+}
+
+void hal_bt_set_link_idle(bool idle) {
+    s_link_idle = idle;
+    s_link_idle_hints++;
+}
+
+int hal_bt_l2cap_cancel_tx(void) {
+    s_cancel_tx_calls++;
+    if (s_cancel_tx_result == 0) {
+        s_tx_complete_pending = false;  /* A late completion would be for the next frame */
+    }
+    TINYPAN_LOG_INFO("[MOCK] Cancel TX: %d", s_cancel_tx_result);
+    return s_cancel_tx_result;
+}
+
+int hal_storage_load(uint8_t* data, uint16_t max_len) {
+    if (data == NULL) return -1;
+    uint16_t n = (s_storage_len < max_len) ? s_storage_len : max_len;
+    memcpy(data, s_storage, n);
+    return n;
+}
+
+int hal_storage_save(const uint8_t* data, uint16_t len) {
+    if (data == NULL || len > MOCK_STORAGE_SIZE) return -1;
+    memcpy(s_storage, data, len);
+    s_storage_len = len;
+    s_storage_writes++;
+    return 0;
+}
+
+void mock_hal_storage_erase(void) {
+    s_storage_len = 0;
+    s_storage_writes = 0;
+}
+
+uint32_t mock_hal_storage_get_writes(void) {
+    return s_storage_writes;
+}
+
 const uint8_t* mock_hal_get_last_tx_data(void) {
     return s_tx_history_data[s_tx_history_head];
 }
@@ -402,6 +847,10 @@ uint16_t mock_hal_get_last_tx_len(void) {
     return s_tx_history_len[s_tx_history_head];
 }
 
+uint32_t mock_hal_get_tx_count(void) {
+    return s_tx_count;
+}
+
 const uint8_t* mock_hal_get_tx_history_data(int index_from_newest) {
     if (index_from_newest >= MOCK_TX_HISTORY_LEN || index_from_newest < 0) return NULL;
     int idx = s_tx_history_head - index_from_newest;
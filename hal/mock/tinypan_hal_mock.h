@@ -45,11 +45,41 @@ void mock_hal_simulate_connect_failure(int status);
  */
 void mock_hal_simulate_disconnect(void);
 
+/**
+ * @brief Simulate L2CAP disconnection with an HCI reason (HAL_HCI_ERR_*)
+ */
+void mock_hal_simulate_disconnect_reason(int status);
+
 /**
  * @brief Simulate receiving data
  */
 void mock_hal_simulate_receive(const uint8_t* data, uint16_t len);
 
+/**
+ * @brief Start a reader thread that models an RTOS HAL's RX path (POSIX only)
+ *
+ * Frames passed to mock_hal_rx_thread_inject() are picked up by a pthread,
+ * offered to the direct receive callback if one is registered, and otherwise
+ * copied into a bridge queue that hal_bt_poll() drains, firing the wakeup
+ * callback per queued frame. hal_bt_deinit() stops the thread.
+ *
+ * @return 0 on success, -1 if threads are unavailable
+ */
+int mock_hal_rx_thread_start(void);
+
+/**
+ * @brief Stop the RX reader thread; frames not yet read are discarded
+ */
+void mock_hal_rx_thread_stop(void);
+
+/**
+ * @brief Hand a received frame to the RX reader thread (thread-safe)
+ *
+ * Blocks while the reader's input queue is full.
+ * @return false if the thread is not running or the link is down
+ */
+bool mock_hal_rx_thread_inject(const uint8_t* data, uint16_t len);
+
 /**
  * @brief Simulate BNEP setup response (success)
  */
@@ -60,6 +90,111 @@ void mock_hal_simulate_bnep_setup_success(void);
  */
 void mock_hal_set_can_send(bool can_send);
 
+/**
+ * @brief Set the link MTU reported by hal_bt_l2cap_get_mtu() (default 1500,
+ *        reset by hal_bt_init())
+ */
+void mock_hal_set_mtu(uint16_t mtu);
+
+/**
+ * @brief Counters of the connection-event model
+ */
+typedef struct {
+    uint32_t events;            /**< Connection events run */
+    uint32_t idle_events;       /**< Events with nothing to transmit */
+    uint32_t packets_accepted;  /**< Sends accepted into controller buffers */
+    uint32_t bytes_accepted;
+    uint32_t packets_on_air;    /**< Packets transmitted by connection events */
+    uint32_t busy_returns;      /**< Sends rejected because all buffers were full */
+    uint32_t residence_max_ms;  /**< Longest a packet waited in a buffer before going on air */
+    uint32_t residence_total_ms;/**< Sum over packets_on_air */
+    uint16_t queued;            /**< Packets still waiting in controller buffers */
+} mock_hal_conn_event_stats_t;
+
+/**
+ * @brief Model a BLE controller (for flow control benchmarks)
+ *
+ * The controller holds tx_buffers packets; every interval_ms of HAL time a
+ * connection event transmits up to packets_per_event of them. Events are
+ * run from hal_bt_poll(), which also fires CAN_SEND_NOW once a buffer frees
+ * up after a busy send. hal_bt_l2cap_get_tx_credits() reports free buffers.
+ * An interval of 0 disables the model. Resets the counters.
+ */
+void mock_hal_set_conn_event_model(uint16_t interval_ms, uint16_t packets_per_event, uint16_t tx_buffers);
+
+/**
+ * @brief Hide the controller's free buffer count
+ *
+ * hal_bt_l2cap_get_tx_credits() then reports 1 while the link is up, like
+ * a HAL with an opaque ring buffer (ESP32 L2CAP, a NUS queue): the only
+ * sign of a full controller is a busy return. Cleared by
+ * mock_hal_set_conn_event_model().
+ */
+void mock_hal_set_conn_event_hidden_buffers(bool hidden);
+
+/**
+ * @brief Delay TX_COMPLETE events
+ *
+ * hal_bt_l2cap_send_iovec() signals TX_COMPLETE from the first
+ * hal_bt_poll() at least delay_ms after the send (0, the default after
+ * hal_bt_init(): the next poll).
+ */
+void mock_hal_set_tx_complete_delay(uint32_t delay_ms);
+
+/**
+ * @brief Lose the TX_COMPLETE of the next count iovec sends
+ */
+void mock_hal_drop_tx_completes(uint32_t count);
+
+/**
+ * @brief Model a radio that wakes every interval_ms (sniff anchors)
+ *
+ * hal_bt_tx_burst_delay_ms() then returns the time to the last multiple of
+ * interval_ms within its budget. 0 (the default after hal_bt_init())
+ * returns the whole budget.
+ */
+void mock_hal_set_tx_anchor(uint32_t interval_ms);
+
+/**
+ * @brief Get the last hal_bt_set_link_idle() hint
+ * @param hints If not NULL, receives the number of hints since hal_bt_init()
+ * @return true if the stack last reported the link idle
+ */
+bool mock_hal_get_link_idle(uint32_t* hints);
+
+/**
+ * @brief Set what hal_bt_l2cap_cancel_tx() returns
+ *
+ * 0 (the default after hal_bt_init()) reclaims the send and discards its
+ * pending TX_COMPLETE; negative models a HAL that cannot cancel.
+ */
+void mock_hal_set_cancel_tx(int result);
+
+/**
+ * @brief Get the number of hal_bt_l2cap_cancel_tx() calls since hal_bt_init()
+ */
+uint32_t mock_hal_get_cancel_tx_count(void);
+
+/**
+ * @brief Get connection-event model counters
+ */
+void mock_hal_get_conn_event_stats(mock_hal_conn_event_stats_t* stats);
+
+/**
+ * @brief Erase the mock persistent storage (kept across hal_bt_init())
+ */
+void mock_hal_storage_erase(void);
+
+/**
+ * @brief Number of hal_storage_save() calls since the last erase
+ */
+uint32_t mock_hal_storage_get_writes(void);
+
+/**
+ * @brief Set the address returned by hal_get_local_bd_addr()
+ */
+void mock_hal_set_local_addr(const uint8_t addr[6]);
+
 /**
  * @brief Check if mock is connected
  */
@@ -75,6 +210,11 @@ const uint8_t* mock_hal_get_last_tx_data(void);
  */
 uint16_t mock_hal_get_last_tx_len(void);
 
+/**
+ * @brief Number of frames sent so far (the TX history keeps the newest 5)
+ */
+uint32_t mock_hal_get_tx_count(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,7 +19,17 @@
 #define LWIP_ETHERNET               1
 #define LWIP_NETIF_STATUS_CALLBACK  1
 
+/* Static ARP entry for the NAP gateway (TINYPAN_ENABLE_GATEWAY_ARP_PRELOAD) */
+#define ETHARP_SUPPORT_STATIC_ENTRIES 1
+
 #include "tinypan_config.h"
+
+/* The NAP assigns addresses on a point-to-point link: skip the ~1 s ARP probe
+ * for duplicates before binding (TINYPAN_ENABLE_DHCP_PAN_PROFILE) */
+#if TINYPAN_ENABLE_DHCP_PAN_PROFILE
+#define DHCP_DOES_ARP_CHECK         0
+#endif
+
 #if TINYPAN_USE_BLE_SLIP
 /* LWIP_HAVE_SLIPIF enables lwIP's SLIP header definitions but TinyPAN does NOT
  * use lwIP's built-in slipif.c transport. Our SLIP operates over asynchronous
@@ -74,4 +84,43 @@ extern uint32_t hal_get_tick_ms(void);
 
 /* We will implement sys_now() in tinypan_lwip_netif.c */
 
+/* Without LWIP_DNS, lwIP neither requests nor parses the DHCP DNS server
+ * option: do both through the DHCP hooks (src/tinypan_dhcp_dns.c) */
+#if !LWIP_DNS
+struct netif;
+struct dhcp_msg;
+struct pbuf;
+extern void tinypan_dhcp_parse_option(struct netif* netif, uint8_t msg_type, uint8_t option,
+                                      uint8_t len, struct pbuf* p, uint16_t offset);
+extern void tinypan_dhcp_append_options(struct netif* netif, struct dhcp_msg* msg,
+                                        uint16_t* options_len);
+#define LWIP_HOOK_DHCP_PARSE_OPTION(netif, dhcp, state, msg, msg_type, option, len, pbuf, offset) \
+    tinypan_dhcp_parse_option(netif, msg_type, option, len, pbuf, offset)
+#define LWIP_HOOK_DHCP_APPEND_OPTIONS(netif, dhcp, state, msg, msg_type, options_len_ptr) \
+    tinypan_dhcp_append_options(netif, msg, options_len_ptr)
+#endif
+
+/* Trusted-link RX turns checksum checks off on tp0 only (TINYPAN_ENABLE_LINK_TRUST) */
+#if TINYPAN_ENABLE_LINK_TRUST
+#define LWIP_CHECKSUM_CTRL_PER_NETIF 1
+#endif
+
+/* Application buffers wrapped as PBUF_REF with a completion callback
+ * (TINYPAN_ENABLE_ZERO_COPY_TX, src/tinypan_zc_tx.c) */
+#if TINYPAN_ENABLE_ZERO_COPY_TX
+#define LWIP_SUPPORT_CUSTOM_PBUF    1
+#endif
+
+/* Word-at-a-time checksum (src/tinypan_chksum.c) */
+#if TINYPAN_ENABLE_FAST_CHKSUM
+extern uint16_t tinypan_chksum(const void* dataptr, int len);
+#define LWIP_CHKSUM                 tinypan_chksum
+#if TINYPAN_ENABLE_CHKSUM_ON_COPY
+extern uint16_t tinypan_chksum_copy(void* dst, const void* src, uint16_t len);
+#define LWIP_CHECKSUM_ON_COPY       1
+#define LWIP_CHKSUM_COPY_ALGORITHM  0
+#define LWIP_CHKSUM_COPY(dst, src, len) tinypan_chksum_copy(dst, src, len)
+#endif
+#endif
+
 #endif /* LWIP_LWIPOPTS_H */
@@ -48,7 +48,7 @@ typedef enum {
     TINYPAN_STATE_BNEP_FILTER_WAIT, /**< Waiting for BNEP multicast filter response */
     TINYPAN_STATE_DHCP,             /**< BNEP negotiated, DHCP in progress (BNEP mode only) */
     TINYPAN_STATE_ONLINE,           /**< Transport ready for data transfer */
-    TINYPAN_STATE_STALLED,          /**< Reserved, not implemented */
+    TINYPAN_STATE_STALLED,          /**< TX stalled, recovering without a reconnect (TINYPAN_ENABLE_STALL_RECOVERY) */
     TINYPAN_STATE_RECONNECTING,     /**< Connection lost, attempting reconnect */
     TINYPAN_STATE_ERROR             /**< Max reconnect attempts exhausted */
 } tinypan_state_t;
@@ -62,7 +62,8 @@ typedef enum {
     TINYPAN_EVENT_DISCONNECTED,     /**< Connection lost */
     TINYPAN_EVENT_IP_ACQUIRED,      /**< IP address obtained via DHCP */
     TINYPAN_EVENT_IP_LOST,          /**< IP address lost */
-    TINYPAN_EVENT_ERROR             /**< An error occurred */
+    TINYPAN_EVENT_ERROR,            /**< An error occurred */
+    TINYPAN_EVENT_TX_STALLED        /**< A frame missed its TX_COMPLETE (TINYPAN_ENABLE_STALL_RECOVERY) */
 } tinypan_event_t;
 
 /**
@@ -78,7 +79,10 @@ typedef enum {
     TINYPAN_ERR_BNEP_FAILED = -6,   /**< BNEP error */
     TINYPAN_ERR_TIMEOUT = -7,       /**< Operation timed out */
     TINYPAN_ERR_NO_MEMORY = -8,     /**< Out of memory */
-    TINYPAN_ERR_BUSY = -9           /**< Resource busy. Note: HAL layer returns positive 1 for busy. */
+    TINYPAN_ERR_BUSY = -9,          /**< Resource busy. Note: HAL layer returns positive 1 for busy. */
+    TINYPAN_ERR_IN_PROGRESS = -10,  /**< Started; the result is delivered to a callback */
+    TINYPAN_ERR_NOT_FOUND = -11,    /**< Name does not exist (or has no IPv4 address) */
+    TINYPAN_ERR_WOULD_BLOCK = -12   /**< Nothing to receive yet */
 } tinypan_error_t;
 
 /**
@@ -88,8 +92,8 @@ typedef struct {
     tinypan_bd_addr_t remote_addr;  /**< Bluetooth address of NAP (phone) */
     uint16_t reconnect_interval_ms; /**< Initial reconnection delay (default: 1000) */
     uint16_t reconnect_max_ms;      /**< Maximum reconnection delay (default: 30000) */
-    uint16_t heartbeat_interval_ms; /**< Link monitoring interval (default: 15000). Not implemented. */
-    uint8_t  heartbeat_retries;     /**< Retries before declaring link dead (default: 3). Not implemented. */
+    uint16_t heartbeat_interval_ms; /**< Idle time before a heartbeat probe, 0 = off (default: 15000, TINYPAN_ENABLE_HEARTBEAT) */
+    uint8_t  heartbeat_retries;     /**< Unanswered probes before declaring the link dead (default: 3) */
     uint8_t  max_reconnect_attempts;/**< Maximum reconnect attempts, 0 = infinite (default: 0) */
     bool     auto_init_lwip;        /**< If true, TinyPAN calls lwip_init(). Set false if host OS manages lwIP. (default: true) */
 } tinypan_config_t;
@@ -104,6 +108,210 @@ typedef struct {
     uint32_t dns_server;            /**< DNS server (network byte order) */
 } tinypan_ip_info_t;
 
+/**
+ * @brief Trusted-link checksum statistics (TINYPAN_ENABLE_LINK_TRUST)
+ */
+typedef struct {
+    uint32_t checks_skipped;        /**< RX frames accepted without checksum verification */
+    uint32_t frames_sampled;        /**< RX frames verified by sampling */
+    uint32_t failures;              /**< Sampled frames with a bad checksum (dropped) */
+    bool     full_checking;         /**< Every frame is verified (trust off, or revoked by a failure) */
+} tinypan_checksum_stats_t;
+
+/**
+ * @brief Resolver cache statistics (TINYPAN_ENABLE_DNS_CACHE)
+ */
+typedef struct {
+    uint32_t hits;                  /**< Lookups answered from a cached address */
+    uint32_t negative_hits;         /**< Lookups answered from a cached NXDOMAIN/no-data */
+    uint32_t misses;                /**< Lookups that had to wait for the server */
+    uint32_t queries_sent;          /**< Queries transmitted, resends included */
+    uint32_t prefetches;            /**< Background refreshes started before expiry */
+    uint32_t timeouts;              /**< Lookups failed for lack of an answer */
+} tinypan_dns_stats_t;
+
+/**
+ * @brief UDP fast path flow (TINYPAN_ENABLE_UDP_FAST), see tinypan_udp_open()
+ */
+typedef struct tinypan_udp_flow tinypan_udp_t;
+
+/**
+ * @brief UDP fast path statistics (TINYPAN_ENABLE_UDP_FAST)
+ */
+typedef struct {
+    uint32_t tx_fast;               /**< Datagrams sent from a prebuilt frame */
+    uint32_t tx_fallback;           /**< Datagrams sent through lwIP's UDP path */
+    uint32_t tx_zero_copy;          /**< Datagrams sent from application memory (tinypan_udp_send_ref()) */
+    uint32_t rx_datagrams;          /**< Datagrams queued for tinypan_udp_recv() */
+    uint32_t rx_dropped;            /**< Datagrams dropped because a flow's queue was full */
+} tinypan_udp_stats_t;
+
+/**
+ * @brief Link capacity estimate (TINYPAN_ENABLE_LINK_ESTIMATE)
+ * 
+ * Rates are measured over the time the TX queue held frames, so they track
+ * what the link can carry rather than what the application offered.
+ */
+typedef struct {
+    uint32_t tx_bytes_per_s;        /**< Goodput: frame bytes delivered per busy second */
+    uint32_t tx_frames_per_s;       /**< Frames delivered per busy second */
+    uint32_t service_time_us;       /**< Enqueue to TX_COMPLETE (BNEP) or last chunk handed to the HAL (SLIP) */
+    uint32_t queue_delay_us;        /**< Enqueue to hand-off to the HAL */
+    uint32_t windows;               /**< Measurement windows folded in, 0 = no estimate yet */
+} tinypan_link_estimate_t;
+
+/**
+ * @brief TX burst statistics (TINYPAN_ENABLE_TX_BURST)
+ * 
+ * Bursts per second is bursts * 1000 / elapsed_ms; frames per burst is
+ * frames / bursts.
+ */
+typedef struct {
+    uint32_t bursts;                /**< Bursts sent, each ending with the TX queue empty */
+    uint32_t frames;                /**< Frames sent in those bursts */
+    uint32_t urgent_bursts;         /**< Bursts opened early by an urgent frame or a full queue */
+    uint32_t max_burst_frames;      /**< Frames in the largest burst */
+    uint32_t elapsed_ms;            /**< Time the counters cover (since tinypan_init()) */
+} tinypan_tx_burst_stats_t;
+
+/**
+ * @brief TX completion timeout (TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT)
+ * 
+ * Service time is the time from handing a BNEP frame to the HAL to its
+ * TX_COMPLETE.
+ */
+typedef struct {
+    uint32_t timeout_ms;            /**< Timeout in force for the frame in flight */
+    uint32_t srtt_ms;               /**< Smoothed service time */
+    uint32_t rttvar_ms;             /**< Smoothed mean deviation of the service time */
+    uint32_t max_service_ms;        /**< Longest service time measured */
+    uint32_t samples;               /**< Completions measured */
+    uint32_t timeouts;              /**< Frames declared stalled */
+} tinypan_tx_timeout_stats_t;
+
+/**
+ * @brief TX stall recovery (TINYPAN_ENABLE_STALL_RECOVERY)
+ * 
+ * A stall lasts from the frame that missed its TX_COMPLETE until the TX
+ * queue moves again: the next frame completes or nothing is left to send.
+ */
+typedef struct {
+    uint32_t stalls;                /**< Frames that missed their TX_COMPLETE */
+    uint32_t recovered;             /**< Stalls cancelled and resumed without a reconnect */
+    uint32_t disconnects;           /**< Stalls that tore the link down */
+    uint32_t last_recovery_ms;      /**< Duration of the last recovered stall */
+    uint32_t max_recovery_ms;       /**< Longest recovered stall */
+} tinypan_stall_stats_t;
+
+/**
+ * @brief Link heartbeat (TINYPAN_ENABLE_HEARTBEAT)
+ * 
+ * The round-trip time runs from sending an ARP request to the gateway (an
+ * echo control frame in SLIP mode) to its reply. A reply that may answer
+ * an earlier, repeated probe is counted but not timed.
+ */
+typedef struct {
+    uint32_t probes;                /**< Probes sent */
+    uint32_t replies;               /**< Probes answered */
+    uint32_t misses;                /**< Probes that timed out */
+    uint32_t dead_links;            /**< Links declared dead */
+    uint32_t rtt_last_ms;           /**< Last round-trip time */
+    uint32_t rtt_avg_ms;            /**< Smoothed round-trip time */
+    uint32_t rtt_min_ms;            /**< Shortest round-trip time */
+    uint32_t rtt_max_ms;            /**< Longest round-trip time */
+} tinypan_heartbeat_stats_t;
+
+/**
+ * @brief Reconnect failure classes (TINYPAN_ENABLE_RECONNECT_POLICY)
+ */
+typedef enum {
+    TINYPAN_RECONNECT_TRANSIENT = 0,    /**< Working link dropped (supervision timeout, dead link): fast retry */
+    TINYPAN_RECONNECT_UNREACHABLE,      /**< NAP not answering (connect timeout, page timeout) */
+    TINYPAN_RECONNECT_REJECTED,         /**< NAP refused the connection or the BNEP setup */
+    TINYPAN_RECONNECT_AUTH,             /**< Authentication or pairing failed (HCI 0x05, 0x06, 0x0E, 0x18, 0x2F) */
+    TINYPAN_RECONNECT_DHCP,             /**< No lease after TINYPAN_DHCP_MAX_RETRIES */
+    TINYPAN_RECONNECT_REASON_COUNT
+} tinypan_reconnect_reason_t;
+
+/**
+ * @brief Reconnect backoff (TINYPAN_ENABLE_RECONNECT_POLICY)
+ * 
+ * Time is charged to the class of the latest failure, from that failure
+ * until the next one or until the link is ONLINE again.
+ */
+typedef struct {
+    uint32_t failures[TINYPAN_RECONNECT_REASON_COUNT];  /**< Failures per class */
+    uint32_t time_ms[TINYPAN_RECONNECT_REASON_COUNT];   /**< Time spent recovering per class */
+    uint32_t fast_retries;          /**< Reconnects on the fast-retry path */
+    uint32_t recoveries;            /**< Times the link came back ONLINE */
+    uint32_t last_delay_ms;         /**< Last reconnect delay chosen */
+    tinypan_reconnect_reason_t last_reason; /**< Class of the last failure */
+} tinypan_reconnect_stats_t;
+
+/**
+ * @brief Release callback for zero-copy TX and raw frames
+ *        (TINYPAN_ENABLE_ZERO_COPY_TX, TINYPAN_ENABLE_RAW_FRAMES)
+ * 
+ * Runs once TinyPAN holds no reference to the buffer, from inside its TX
+ * path (tinypan_process(), a queue flush in tinypan_stop()/tinypan_deinit(),
+ * or the send call itself if lwIP had to copy the data). It can run with
+ * the transport's TX queue locked: the BNEP transport releases a sent or
+ * flushed frame, raw or lwIP's, while it holds the lock. The buffer may be
+ * reused or freed from here on, and wrapped again with tinypan_pbuf_wrap().
+ * 
+ * It must not call any TinyPAN send API (tinypan_udp_send(),
+ * tinypan_udp_send_ref(), tinypan_send_frame(), lwIP output of a wrapped
+ * pbuf) or any other TinyPAN function: a HAL mutex need not be recursive,
+ * so the call can deadlock on the TX queue lock. Hand the buffer to the
+ * code that calls tinypan_process() and send from there.
+ * 
+ * @param data      The buffer that was wrapped or sent
+ * @param user_data User data passed with the buffer
+ */
+typedef void (*tinypan_tx_done_callback_t)(const void* data, void* user_data);
+
+/**
+ * @brief Receive handler for a custom ethertype (TINYPAN_ENABLE_RAW_FRAMES)
+ * 
+ * @param ethertype The registered ethertype
+ * @param dst_addr  Destination MAC
+ * @param src_addr  Source MAC
+ * @param payload   Frame payload, valid only during the call
+ * @param len       Payload length
+ * @param user_data User data passed at registration
+ */
+typedef void (*tinypan_frame_handler_t)(uint16_t ethertype, const uint8_t* dst_addr,
+                                        const uint8_t* src_addr, const uint8_t* payload,
+                                        uint16_t len, void* user_data);
+
+/**
+ * @brief TX queue watermark callback
+ * 
+ * Called with writable = false when the transport TX queue reaches its high
+ * watermark or refuses a frame, and with writable = true once the drain path
+ * has brought it down to its low watermark (TINYPAN_TX_HIGH_WATER_FRAMES
+ * and friends). Runs from tinypan_process() or a send call with no TinyPAN
+ * lock held, so it may send.
+ * 
+ * @param writable  true when the queue has room again
+ * @param user_data User data passed at registration
+ */
+typedef void (*tinypan_tx_watermark_callback_t)(bool writable, void* user_data);
+
+/** lwIP packet buffer (lwip/pbuf.h), see tinypan_pbuf_wrap() */
+struct pbuf;
+
+/**
+ * @brief Completion callback for tinypan_dns_resolve()
+ * 
+ * @param hostname  The name that was looked up
+ * @param result    TINYPAN_OK, TINYPAN_ERR_NOT_FOUND or TINYPAN_ERR_TIMEOUT
+ * @param ip_addr   IPv4 address (network byte order) if result is TINYPAN_OK
+ * @param user_data User data pointer passed to tinypan_dns_resolve
+ */
+typedef void (*tinypan_dns_callback_t)(const char* hostname, tinypan_error_t result,
+                                       uint32_t ip_addr, void* user_data);
+
 /**
  * @brief Event callback function type
  * 
@@ -202,6 +410,9 @@ const char* tinypan_state_to_string(tinypan_state_t state);
 /**
  * @brief Check if online (IP acquired and link healthy)
  * 
+ * Stays true in TINYPAN_STATE_STALLED: the link and the address are kept
+ * while the TX queue recovers, and frames sent meanwhile are queued.
+ * 
  * @return true if online and ready for data transfer
  */
 bool tinypan_is_online(void);
@@ -214,6 +425,316 @@ bool tinypan_is_online(void);
  */
 tinypan_error_t tinypan_get_ip_info(tinypan_ip_info_t* info);
 
+/**
+ * @brief Get the IP MTU of the link
+ * 
+ * In SLIP mode this follows the negotiated BLE MTU (see
+ * TINYPAN_SLIP_MTU_AUTOTUNE). Keep UDP payloads within (MTU - 28) bytes
+ * to avoid IP fragmentation.
+ * 
+ * @return MTU in bytes, or 0 if the network interface is not available
+ */
+uint16_t tinypan_get_mtu(void);
+
+/**
+ * @brief Get the number of frames the transport TX queue can take now
+ * 
+ * A producer that sends no more than this many datagrams (one frame each)
+ * before the next tinypan_process() never has one refused for a full queue.
+ * Frames lwIP sends on its own (ARP, DHCP) share the same room. With
+ * TINYPAN_ENABLE_FQ it is also no more than any one flow may still queue
+ * (TINYPAN_FQ_FLOW_LIMIT less the frames of the fullest flow).
+ * 
+ * @return Free TX queue slots, 0 if not initialized
+ */
+uint16_t tinypan_tx_available(void);
+
+/**
+ * @brief Register a callback for TX queue congestion and drain
+ * 
+ * @param callback  Callback function, NULL to remove
+ * @param user_data User data passed to callback
+ */
+void tinypan_set_tx_watermark_callback(tinypan_tx_watermark_callback_t callback, void* user_data);
+
+/**
+ * @brief Get the current link capacity estimate
+ * 
+ * Without TINYPAN_ENABLE_LINK_ESTIMATE every field is zero. The estimate
+ * holds its last value while the link is idle and decays towards zero while
+ * frames are queued but none complete.
+ * 
+ * @param estimate Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_link_estimate(tinypan_link_estimate_t* estimate);
+
+/**
+ * @brief Set the egress pacing rate (TINYPAN_ENABLE_PACING)
+ * 
+ * @param bytes_per_s Rate, or 0 for the TINYPAN_PACING_RATE_BPS behaviour
+ *                    with no rate configured (follow the link estimate if
+ *                    enabled, otherwise no pacing)
+ * @return TINYPAN_OK, TINYPAN_ERR_NOT_INITIALIZED, or
+ *         TINYPAN_ERR_INVALID_PARAM without TINYPAN_ENABLE_PACING
+ */
+tinypan_error_t tinypan_set_tx_pacing_rate(uint32_t bytes_per_s);
+
+/**
+ * @brief Get TX burst statistics
+ * 
+ * Counters run from tinypan_init(). Without TINYPAN_ENABLE_TX_BURST every
+ * field is zero.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_tx_burst_stats(tinypan_tx_burst_stats_t* stats);
+
+/**
+ * @brief Get the adaptive TX completion timeout and its inputs
+ * 
+ * The estimate starts over on every connection; the timeout count runs from
+ * tinypan_init(). Without TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT every field is
+ * zero and the fixed TINYPAN_BNEP_TX_TIMEOUT_MS applies.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_tx_timeout_stats(tinypan_tx_timeout_stats_t* stats);
+
+/**
+ * @brief Get TX stall recovery statistics
+ * 
+ * Counters run from tinypan_init(). Without TINYPAN_ENABLE_STALL_RECOVERY
+ * every field is zero and every stall tears the link down.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_stall_stats(tinypan_stall_stats_t* stats);
+
+/**
+ * @brief Get link heartbeat statistics
+ * 
+ * Counters run from tinypan_init(); the round-trip times are zero until
+ * the first probe is answered. Without TINYPAN_ENABLE_HEARTBEAT every
+ * field is zero.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_heartbeat_stats(tinypan_heartbeat_stats_t* stats);
+
+/**
+ * @brief Get reconnect backoff statistics
+ * 
+ * Counters run from tinypan_init(). Without TINYPAN_ENABLE_RECONNECT_POLICY
+ * every field is zero.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_reconnect_stats(tinypan_reconnect_stats_t* stats);
+
+/**
+ * @brief Get trusted-link checksum statistics
+ * 
+ * Counters run from tinypan_init(). Without TINYPAN_ENABLE_LINK_TRUST they
+ * stay at zero and full_checking is true.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_checksum_stats(tinypan_checksum_stats_t* stats);
+
+/**
+ * @brief Resolve a host name to an IPv4 address
+ * 
+ * Dotted-quad literals and cached names complete at once. Otherwise a query
+ * is sent to the DNS server from the DHCP lease and the result is delivered
+ * to the callback from tinypan_process(). Needs TINYPAN_ENABLE_DNS_CACHE;
+ * without it every name returns TINYPAN_ERR_NOT_FOUND.
+ * 
+ * @param hostname  Name to look up (at most TINYPAN_DNS_MAX_NAME_LEN characters)
+ * @param ip_addr   [out] Address (network byte order) when TINYPAN_OK is returned
+ * @param callback  Called when TINYPAN_ERR_IN_PROGRESS is returned (may be NULL)
+ * @param user_data User data passed to the callback
+ * @return TINYPAN_OK (*ip_addr is set), TINYPAN_ERR_IN_PROGRESS,
+ *         TINYPAN_ERR_NOT_FOUND (cached negative answer), TINYPAN_ERR_NOT_STARTED
+ *         (no address or DNS server yet) or TINYPAN_ERR_BUSY (too many lookups
+ *         in flight)
+ */
+tinypan_error_t tinypan_dns_resolve(const char* hostname, uint32_t* ip_addr,
+                                    tinypan_dns_callback_t callback, void* user_data);
+
+/**
+ * @brief Get resolver cache statistics
+ * 
+ * Counters run from tinypan_init(). Without TINYPAN_ENABLE_DNS_CACHE they
+ * stay at zero.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_dns_stats(tinypan_dns_stats_t* stats);
+
+/**
+ * @brief Open a UDP fast path flow
+ * 
+ * The flow keeps its Ethernet/IP/UDP headers prebuilt, so a send only
+ * copies the payload and patches lengths, IP ID and checksums before the
+ * frame goes to the BNEP or SLIP transport. Meant for small periodic
+ * datagrams; see TINYPAN_ENABLE_UDP_FAST. Flows stay open across
+ * reconnects and are closed by tinypan_deinit().
+ * 
+ * @param remote_ip   Destination address (network byte order), may be a broadcast
+ * @param remote_port Destination port
+ * @param local_port  Port to send from and receive on, 0 for an ephemeral one
+ * @param flow        [out] The flow
+ * @return TINYPAN_OK, TINYPAN_ERR_NO_MEMORY (all TINYPAN_UDP_FLOWS in use, or
+ *         the fast path is compiled out) or TINYPAN_ERR_BUSY (port in use)
+ */
+tinypan_error_t tinypan_udp_open(uint32_t remote_ip, uint16_t remote_port,
+                                 uint16_t local_port, tinypan_udp_t** flow);
+
+/**
+ * @brief Send a datagram on a flow
+ * 
+ * Payloads up to TINYPAN_UDP_MAX_PAYLOAD go out from the flow's prebuilt
+ * frame. Larger ones, and sends made while the previous frame is still
+ * queued, take lwIP's UDP path instead. Call from the thread that runs
+ * tinypan_process().
+ * 
+ * @param flow Flow from tinypan_udp_open()
+ * @param data Payload
+ * @param len  Payload length, at most tinypan_get_mtu() - 28
+ * @return TINYPAN_OK, TINYPAN_ERR_NOT_STARTED (no address or link),
+ *         TINYPAN_ERR_BUSY (TX queue full) or TINYPAN_ERR_INVALID_PARAM
+ */
+tinypan_error_t tinypan_udp_send(tinypan_udp_t* flow, const void* data, uint16_t len);
+
+/**
+ * @brief Send a datagram on a flow straight from application memory
+ * 
+ * The payload is not copied: it goes through lwIP's UDP path as a PBUF_REF
+ * pbuf behind a separately allocated header, and is read again only by the
+ * checksum and by the transport. done is called when the buffer is released,
+ * usually after the radio reports the frame sent; until then the buffer must
+ * not change. Meant for large buffers (firmware chunks, sensor dumps) that
+ * tinypan_udp_send() would copy. Needs TINYPAN_ENABLE_ZERO_COPY_TX.
+ * 
+ * @param flow      Flow from tinypan_udp_open()
+ * @param data      Payload, left untouched until done runs
+ * @param len       Payload length, at most tinypan_get_mtu() - 28
+ * @param done      Release callback, may be NULL; must not send (see
+ *                  tinypan_tx_done_callback_t)
+ * @param user_data Passed to done
+ * @return TINYPAN_OK (done will be called exactly once),
+ *         TINYPAN_ERR_NOT_STARTED, TINYPAN_ERR_BUSY (TX queue full or all
+ *         TINYPAN_ZC_TX_SLOTS in flight) or TINYPAN_ERR_INVALID_PARAM. On
+ *         error the buffer is not referenced and done is not called.
+ */
+tinypan_error_t tinypan_udp_send_ref(tinypan_udp_t* flow, const void* data, uint16_t len,
+                                     tinypan_tx_done_callback_t done, void* user_data);
+
+/**
+ * @brief Wrap application memory in an lwIP pbuf without copying it
+ * 
+ * For applications that call lwIP's raw API themselves (udp_sendto(),
+ * raw_sendto(), ...). The pbuf is a PBUF_REF custom pbuf with one
+ * reference, owned by the caller: pass it to lwIP, then pbuf_free() it.
+ * done runs when the last reference is released, wherever that happens.
+ * Needs TINYPAN_ENABLE_ZERO_COPY_TX.
+ * 
+ * @param data      Buffer, left untouched until done runs
+ * @param len       Buffer length
+ * @param done      Release callback, may be NULL; must not send (see
+ *                  tinypan_tx_done_callback_t)
+ * @param user_data Passed to done
+ * @return The pbuf, or NULL if all TINYPAN_ZC_TX_SLOTS are in use
+ */
+struct pbuf* tinypan_pbuf_wrap(const void* data, uint16_t len,
+                               tinypan_tx_done_callback_t done, void* user_data);
+
+/**
+ * @brief Send a raw Ethernet frame, bypassing lwIP
+ * 
+ * For proprietary layer 2 protocols on a custom ethertype. The frame joins
+ * the BNEP TX queue behind a compressed header (a full one if dst_addr is
+ * not the NAP), so frames go out in the order they were sent, interleaved
+ * with lwIP's. The payload is not copied; done runs once it is no longer
+ * referenced, as for tinypan_udp_send_ref(). BNEP mode only; needs
+ * TINYPAN_ENABLE_RAW_FRAMES.
+ * 
+ * @param dst_addr  Destination MAC, NULL for the NAP
+ * @param ethertype Ethertype, 0x0600 or above
+ * @param payload   Payload, left untouched until done runs
+ * @param len       Payload length, 1 to TINYPAN_MAX_FRAME_SIZE
+ * @param done      Release callback, may be NULL; must not send (see
+ *                  tinypan_tx_done_callback_t)
+ * @param user_data Passed to done
+ * @return TINYPAN_OK (done will be called exactly once),
+ *         TINYPAN_ERR_NOT_STARTED (BNEP not connected), TINYPAN_ERR_BUSY
+ *         (TX queue full) or TINYPAN_ERR_INVALID_PARAM (also on SLIP). On
+ *         error done is not called.
+ */
+tinypan_error_t tinypan_send_frame(const uint8_t* dst_addr, uint16_t ethertype, const void* payload,
+                                   uint16_t len, tinypan_tx_done_callback_t done, void* user_data);
+
+/**
+ * @brief Receive frames of an ethertype instead of passing them to lwIP
+ * 
+ * The handler runs where received frames are processed: in
+ * tinypan_process(), or in the HAL's RX context with TINYPAN_RX_DIRECT.
+ * Frames are delivered in arrival order. Register while stopped.
+ * Needs TINYPAN_ENABLE_RAW_FRAMES.
+ * 
+ * @param ethertype Ethertype, 0x0600 or above, other than IPv4 and ARP
+ * @param handler   Handler, NULL to remove the registration
+ * @param user_data Passed to handler
+ * @return TINYPAN_OK, TINYPAN_ERR_NO_MEMORY (TINYPAN_RAW_FRAME_HANDLERS in
+ *         use, or compiled out) or TINYPAN_ERR_INVALID_PARAM
+ */
+tinypan_error_t tinypan_register_ethertype_handler(uint16_t ethertype, tinypan_frame_handler_t handler,
+                                                   void* user_data);
+
+/**
+ * @brief Take the next datagram received on a flow, without copying it
+ * 
+ * The data stays in lwIP's receive buffer and remains valid until the next
+ * tinypan_udp_recv() or tinypan_udp_close() on the same flow. Up to
+ * TINYPAN_UDP_RX_QUEUE_LEN datagrams wait per flow; later ones are dropped.
+ * Datagrams arrive during tinypan_process().
+ * 
+ * @param flow     Flow from tinypan_udp_open()
+ * @param data     [out] Payload
+ * @param len      [out] Payload length
+ * @param src_ip   [out] Sender address (network byte order), may be NULL
+ * @param src_port [out] Sender port, may be NULL
+ * @return TINYPAN_OK or TINYPAN_ERR_WOULD_BLOCK (nothing waiting)
+ */
+tinypan_error_t tinypan_udp_recv(tinypan_udp_t* flow, const uint8_t** data, uint16_t* len,
+                                 uint32_t* src_ip, uint16_t* src_port);
+
+/**
+ * @brief Close a flow and release any datagrams it still holds
+ * 
+ * @param flow Flow from tinypan_udp_open()
+ */
+void tinypan_udp_close(tinypan_udp_t* flow);
+
+/**
+ * @brief Get UDP fast path statistics
+ * 
+ * Counters run from tinypan_init(). Without TINYPAN_ENABLE_UDP_FAST they
+ * stay at zero.
+ * 
+ * @param stats Pointer to structure to fill
+ * @return TINYPAN_OK on success, error otherwise
+ */
+tinypan_error_t tinypan_get_udp_stats(tinypan_udp_stats_t* stats);
+
 /**
  * @brief De-initialize TinyPAN library
  * 
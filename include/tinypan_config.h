@@ -57,6 +57,30 @@
 #define TINYPAN_TX_QUEUE_LEN                3
 #endif
 
+/**
+ * TX watermarks (tinypan_set_tx_watermark_callback()). The queue counts as
+ * congested once it holds TINYPAN_TX_HIGH_WATER_FRAMES frames or
+ * TINYPAN_TX_HIGH_WATER_BYTES bytes, or refuses a frame; it is reported
+ * writable again when the drain path brings it down to
+ * TINYPAN_TX_LOW_WATER_FRAMES frames and TINYPAN_TX_LOW_WATER_BYTES bytes.
+ * A byte high watermark of 0 turns the byte watermarks off.
+ */
+#ifndef TINYPAN_TX_HIGH_WATER_FRAMES
+#define TINYPAN_TX_HIGH_WATER_FRAMES        (TINYPAN_TX_QUEUE_LEN - 1)
+#endif
+
+#ifndef TINYPAN_TX_LOW_WATER_FRAMES
+#define TINYPAN_TX_LOW_WATER_FRAMES         ((TINYPAN_TX_QUEUE_LEN - 1) / 2)
+#endif
+
+#ifndef TINYPAN_TX_HIGH_WATER_BYTES
+#define TINYPAN_TX_HIGH_WATER_BYTES         0
+#endif
+
+#ifndef TINYPAN_TX_LOW_WATER_BYTES
+#define TINYPAN_TX_LOW_WATER_BYTES          0
+#endif
+
 /* ============================================================================
  * Timeout Configuration (in milliseconds)
  * ============================================================================ */
@@ -82,6 +106,16 @@
 #define TINYPAN_BNEP_FILTER_TIMEOUT_MS      2000
 #endif
 
+/**
+ * Fast bring-up: start DHCP right after the BNEP setup response instead of
+ * waiting in BNEP_FILTER_WAIT for the multicast filter response. The filter
+ * request is still sent and its response is logged whenever it arrives.
+ * Saves up to TINYPAN_BNEP_FILTER_TIMEOUT_MS with phones that never answer.
+ */
+#ifndef TINYPAN_ENABLE_FAST_BRINGUP
+#define TINYPAN_ENABLE_FAST_BRINGUP         0
+#endif
+
 /**
  * Number of retries for BNEP setup request.
  */
@@ -89,28 +123,115 @@
 #define TINYPAN_BNEP_SETUP_RETRIES          3
 #endif
 
+/**
+ * PAN DHCP timing profile (BNEP mode). lwIP backs off 2 s, 4 s, 8 s... between
+ * DHCP retransmissions, which suits a shared LAN but not a point-to-point
+ * link to a phone. With the profile, lost DHCP messages are resent after
+ * TINYPAN_DHCP_RETX_INITIAL_MS, doubling up to TINYPAN_DHCP_RETX_MAX_MS, each
+ * DHCP attempt gets a short budget, and the duplicate-address ARP check
+ * (about 1 s) is skipped.
+ *
+ * Only enable it with a bare-metal lwIP (NO_SYS=1), such as TinyPAN's own
+ * lwipopts.h used by the host build. Under an RTOS lwIP (ESP-IDF, Zephyr)
+ * the client keeps its own backoff, and the short budgets would fit no
+ * more than two DISCOVERs per attempt. The ARP check is only skipped where
+ * TinyPAN's lwipopts.h is used; other lwIP configurations must set
+ * DHCP_DOES_ARP_CHECK 0 themselves.
+ */
+#ifndef TINYPAN_ENABLE_DHCP_PAN_PROFILE
+#define TINYPAN_ENABLE_DHCP_PAN_PROFILE     0
+#endif
+
+/**
+ * First DHCP retransmission delay with the PAN profile (ms).
+ */
+#ifndef TINYPAN_DHCP_RETX_INITIAL_MS
+#define TINYPAN_DHCP_RETX_INITIAL_MS        250
+#endif
+
+/**
+ * Longest DHCP retransmission delay with the PAN profile (ms).
+ */
+#ifndef TINYPAN_DHCP_RETX_MAX_MS
+#define TINYPAN_DHCP_RETX_MAX_MS            2000
+#endif
+
 /**
  * Timeout waiting for DHCP to complete (BNEP mode only).
+ * Each timeout restarts discovery, see TINYPAN_DHCP_MAX_RETRIES.
  */
 #ifndef TINYPAN_DHCP_TIMEOUT_MS
+#if TINYPAN_ENABLE_DHCP_PAN_PROFILE
+#define TINYPAN_DHCP_TIMEOUT_MS             5000
+#else
 #define TINYPAN_DHCP_TIMEOUT_MS             30000
 #endif
+#endif
 
 /**
- * Number of retries for DHCP discovery before disconnecting.
+ * Number of DHCP attempts before disconnecting.
+ * The L2CAP link is torn down after TINYPAN_DHCP_TIMEOUT_MS * TINYPAN_DHCP_MAX_RETRIES.
  */
 #ifndef TINYPAN_DHCP_MAX_RETRIES
+#if TINYPAN_ENABLE_DHCP_PAN_PROFILE
+#define TINYPAN_DHCP_MAX_RETRIES            2
+#else
 #define TINYPAN_DHCP_MAX_RETRIES            3
 #endif
+#endif
 
 /**
  * Timeout for in-flight BNEP packets waiting for TX_COMPLETE (ms).
  * Prevents memory exhaustion if the Bluetooth hardware fails to signal completion.
+ * With TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT this is the ceiling, and the
+ * timeout used until the first completion has been measured.
  */
 #ifndef TINYPAN_BNEP_TX_TIMEOUT_MS
 #define TINYPAN_BNEP_TX_TIMEOUT_MS          2000
 #endif
 
+/**
+ * Adaptive TX completion timeout (BNEP mode). The send to TX_COMPLETE time
+ * of every frame is folded into a smoothed mean and mean deviation, as TCP
+ * does for its retransmission timeout, and a frame in flight for longer
+ * than mean + max(4 x deviation, mean) counts as stalled. A lost
+ * TX_COMPLETE on a healthy link is then caught after
+ * TINYPAN_TX_TIMEOUT_MIN_MS instead of TINYPAN_BNEP_TX_TIMEOUT_MS. Each
+ * expiry doubles the timeout (up to TINYPAN_BNEP_TX_TIMEOUT_MS) until the
+ * next completion gives a fresh sample, as RFC 6298 backs off its timer.
+ * A higher floor tolerates more sudden slowdowns (e.g. a phone pausing the
+ * link for Wi-Fi coexistence) at the cost of slower detection.
+ */
+#ifndef TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+#define TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT  0
+#endif
+
+/**
+ * Shortest adaptive TX completion timeout (ms). Covers a TX_COMPLETE held
+ * back by one sniff interval (phones default to 500 ms) or a scatternet
+ * gap, so a sniffing link is not taken for a stalled one.
+ */
+#ifndef TINYPAN_TX_TIMEOUT_MIN_MS
+#define TINYPAN_TX_TIMEOUT_MIN_MS           600
+#endif
+
+/**
+ * TX stall recovery (BNEP mode). A frame that misses its TX_COMPLETE is
+ * cancelled with hal_bt_l2cap_cancel_tx() and the queue resumes behind it,
+ * in TINYPAN_STATE_STALLED until the next frame completes, instead of
+ * tearing down the link and paying for a full L2CAP + BNEP + DHCP cycle.
+ * The link is still torn down if the HAL cannot cancel, or if the stalls
+ * keep coming with no frame completing in between.
+ */
+#ifndef TINYPAN_ENABLE_STALL_RECOVERY
+#define TINYPAN_ENABLE_STALL_RECOVERY       0
+#endif
+
+/** Consecutive stalls recovered in place before the link is torn down. */
+#ifndef TINYPAN_STALL_MAX_RECOVERIES
+#define TINYPAN_STALL_MAX_RECOVERIES        2
+#endif
+
 /* ============================================================================
  * Feature Configuration
  * ============================================================================ */
@@ -152,6 +273,366 @@
 #define TINYPAN_ENABLE_AUTO_RECONNECT       1
 #endif
 
+/**
+ * Reason-aware reconnect backoff. Each failure is classified from the HAL
+ * status code (an HCI error code, see HAL_HCI_ERR_*) and the state it
+ * happened in, and each class has its own backoff curve: a dropped link is
+ * retried almost at once, a NAP that refuses BNEP or fails authentication
+ * is left alone for much longer. Delays use decorrelated jitter seeded
+ * from the local BD address, so devices that lost the same phone at the
+ * same moment do not come back in lockstep. Without it, every failure
+ * doubles the delay from reconnect_interval_ms to reconnect_max_ms.
+ */
+#ifndef TINYPAN_ENABLE_RECONNECT_POLICY
+#define TINYPAN_ENABLE_RECONNECT_POLICY     0
+#endif
+
+/** Upper bound of the fast-retry delay after a dropped link (ms). */
+#ifndef TINYPAN_RECONNECT_FAST_MS
+#define TINYPAN_RECONNECT_FAST_MS           250
+#endif
+
+/** Fast retries per outage before the regular backoff applies. */
+#ifndef TINYPAN_RECONNECT_FAST_RETRIES
+#define TINYPAN_RECONNECT_FAST_RETRIES      2
+#endif
+
+/**
+ * Remember the last DHCP lease per NAP address (BNEP mode).
+ * On reconnect, the cached address is confirmed with a single INIT-REBOOT
+ * REQUEST instead of the full DISCOVER/OFFER/REQUEST/ACK exchange. While the
+ * lease has at least TINYPAN_DHCP_CACHE_MIN_REMAINING_S left, the address is
+ * used at once and confirmed in the background. A NAK, or no answer, drops
+ * the entry and falls back to discovery.
+ */
+#ifndef TINYPAN_ENABLE_DHCP_CACHE
+#define TINYPAN_ENABLE_DHCP_CACHE           1
+#endif
+
+/** Number of NAPs whose leases are remembered (1-16, 30 bytes each). */
+#ifndef TINYPAN_DHCP_CACHE_ENTRIES
+#define TINYPAN_DHCP_CACHE_ENTRIES          2
+#endif
+
+/**
+ * Lease time (seconds) that must remain for a cached address to be used
+ * before the NAP confirms it. Shorter leases go through INIT-REBOOT first.
+ */
+#ifndef TINYPAN_DHCP_CACHE_MIN_REMAINING_S
+#define TINYPAN_DHCP_CACHE_MIN_REMAINING_S  60
+#endif
+
+/**
+ * Persist cached leases across reboots through hal_storage_load() and
+ * hal_storage_save(), which the HAL must then implement. Leases restored
+ * after a reboot have unknown age, so they are only used for INIT-REBOOT.
+ * Storage is written only when a lease's address information changes.
+ */
+#ifndef TINYPAN_DHCP_CACHE_PERSIST
+#define TINYPAN_DHCP_CACHE_PERSIST          0
+#endif
+
+/**
+ * Install a static ARP entry for the gateway when an address is acquired
+ * (BNEP mode). In PAN the NAP is the router and its MAC is its BD_ADDR, so
+ * the first packet need not wait for an ARP round trip, and the entry never
+ * expires. Skipped when the DHCP server is not the gateway. Disable for NAPs
+ * that bridge to a separate LAN router. Needs ETHARP_SUPPORT_STATIC_ENTRIES.
+ */
+#ifndef TINYPAN_ENABLE_GATEWAY_ARP_PRELOAD
+#define TINYPAN_ENABLE_GATEWAY_ARP_PRELOAD  1
+#endif
+
+/**
+ * Use TinyPAN's word-at-a-time Internet checksum (src/tinypan_chksum.c) as
+ * lwIP's LWIP_CHKSUM instead of lwip_standard_chksum(). Same results, about
+ * 2-6x faster on full frames. Wired up in lwipopts.h, so it only applies to
+ * lwIP builds that use TinyPAN's lwipopts.h.
+ */
+#ifndef TINYPAN_ENABLE_FAST_CHKSUM
+#define TINYPAN_ENABLE_FAST_CHKSUM          1
+#endif
+
+/**
+ * Also provide LWIP_CHKSUM_COPY and turn on LWIP_CHECKSUM_ON_COPY, so data
+ * copied into pbufs (udp_sendto_chksum(), TCP writes) is summed in the
+ * same pass. Needs TINYPAN_ENABLE_FAST_CHKSUM.
+ */
+#ifndef TINYPAN_ENABLE_CHKSUM_ON_COPY
+#define TINYPAN_ENABLE_CHKSUM_ON_COPY       0
+#endif
+
+/**
+ * Trusted-link RX: skip lwIP's IP/UDP/TCP checksum verification on tp0.
+ * L2CAP over an ACL link (BNEP) and BLE (SLIP) already carry a link-layer
+ * CRC. One frame in TINYPAN_LINK_TRUST_SAMPLE_RATE is still verified; if a
+ * sampled frame fails, it is dropped and full verification is turned back
+ * on until tinypan_deinit(). See tinypan_get_checksum_stats().
+ * Transmitted frames always get checksums.
+ */
+#ifndef TINYPAN_ENABLE_LINK_TRUST
+#define TINYPAN_ENABLE_LINK_TRUST           0
+#endif
+
+/**
+ * Verify one received IPv4 frame in this many in trusted-link mode
+ * (1 = verify every frame).
+ */
+#ifndef TINYPAN_LINK_TRUST_SAMPLE_RATE
+#define TINYPAN_LINK_TRUST_SAMPLE_RATE      16
+#endif
+
+/**
+ * Deliver received BNEP data frames from the HAL's RX context (RTOS builds).
+ * The HAL offers each L2CAP SDU to TinyPAN from its reader task; data frames
+ * are parsed there and handed straight to tcpip_input(), skipping the copy
+ * into the HAL's RX queue and the hop through the tinypan_process() thread.
+ * Control packets, and every frame before BNEP setup completes, still go
+ * through hal_bt_poll(). Ignored unless NO_SYS=0 and the BNEP transport is
+ * used (not TINYPAN_USE_BLE_SLIP); when it applies, the HAL must implement
+ * hal_bt_l2cap_register_direct_recv_callback().
+ */
+#ifndef TINYPAN_ENABLE_RX_DIRECT
+#define TINYPAN_ENABLE_RX_DIRECT            0
+#endif
+
+/**
+ * Resolver cache for tinypan_dns_resolve(). A-record lookups go to the DNS
+ * server from the DHCP lease and are remembered for their TTL (capped at
+ * TINYPAN_DNS_MAX_TTL_S). NXDOMAIN and no-data answers are remembered too
+ * (RFC 2308). An entry looked up again late in its TTL is refreshed in the
+ * background, so names in steady use never make the caller wait. Cached
+ * entries survive a reconnect. Needs lwIP with UDP.
+ */
+#ifndef TINYPAN_ENABLE_DNS_CACHE
+#define TINYPAN_ENABLE_DNS_CACHE            0
+#endif
+
+/** Number of names remembered (1-16, about 90 bytes each). */
+#ifndef TINYPAN_DNS_CACHE_SIZE
+#define TINYPAN_DNS_CACHE_SIZE              4
+#endif
+
+/** Longest host name accepted by tinypan_dns_resolve(), in characters. */
+#ifndef TINYPAN_DNS_MAX_NAME_LEN
+#define TINYPAN_DNS_MAX_NAME_LEN            63
+#endif
+
+/**
+ * UDP sockets for queries in flight (1-16). Each query is sent from a fresh
+ * random source port while one is free, so a spoofed answer has to guess
+ * the port as well as the 16-bit ID (RFC 5452); beyond that, queries share
+ * the open sockets in turn. Each takes one of lwIP's MEMP_NUM_UDP_PCB.
+ */
+#ifndef TINYPAN_DNS_SOURCE_PORTS
+#define TINYPAN_DNS_SOURCE_PORTS            2
+#endif
+
+/** Wait for an answer before resending a query (ms). */
+#ifndef TINYPAN_DNS_TIMEOUT_MS
+#define TINYPAN_DNS_TIMEOUT_MS              2000
+#endif
+
+/** Resends before a lookup fails with TINYPAN_ERR_TIMEOUT. */
+#ifndef TINYPAN_DNS_RETRIES
+#define TINYPAN_DNS_RETRIES                 2
+#endif
+
+/** Upper bound on how long a positive answer is kept (seconds, max 86400). */
+#ifndef TINYPAN_DNS_MAX_TTL_S
+#define TINYPAN_DNS_MAX_TTL_S               3600
+#endif
+
+/**
+ * Upper bound on how long a negative answer is kept (seconds). Also used
+ * when the server sends no SOA record to take the time from.
+ */
+#ifndef TINYPAN_DNS_NEGATIVE_TTL_S
+#define TINYPAN_DNS_NEGATIVE_TTL_S          60
+#endif
+
+/**
+ * Refresh an entry that was looked up since it was last fetched once less
+ * than this percentage of its TTL remains (0 = never prefetch).
+ */
+#ifndef TINYPAN_DNS_PREFETCH_PERCENT
+#define TINYPAN_DNS_PREFETCH_PERCENT        10
+#endif
+
+/**
+ * UDP fast path for small periodic datagrams (tinypan_udp_open()). Each flow
+ * keeps its Ethernet/IP/UDP headers prebuilt in a static frame; a send
+ * copies the payload behind them, checksumming it in the same pass, patches
+ * the lengths, IP ID and checksums, and hands the frame to the BNEP or SLIP
+ * transport without going through udp_sendto() and etharp_output().
+ * Received datagrams are read in place from lwIP's pbufs. Sends fall back
+ * to lwIP's UDP path while the previous frame is still queued, for payloads
+ * over TINYPAN_UDP_MAX_PAYLOAD, and until the next hop is in the ARP table.
+ */
+#ifndef TINYPAN_ENABLE_UDP_FAST
+#define TINYPAN_ENABLE_UDP_FAST             0
+#endif
+
+/** Number of flows open at once (1-8). */
+#ifndef TINYPAN_UDP_FLOWS
+#define TINYPAN_UDP_FLOWS                   2
+#endif
+
+/** Largest payload sent from a flow's prebuilt frame (bytes). Each flow costs this plus about 100 bytes. */
+#ifndef TINYPAN_UDP_MAX_PAYLOAD
+#define TINYPAN_UDP_MAX_PAYLOAD             256
+#endif
+
+/**
+ * Received datagrams waiting per flow (1-8), not counting the one the
+ * application is reading. Each holds an lwIP PBUF_POOL buffer until read,
+ * so keep the total well below PBUF_POOL_SIZE.
+ */
+#ifndef TINYPAN_UDP_RX_QUEUE_LEN
+#define TINYPAN_UDP_RX_QUEUE_LEN            1
+#endif
+
+/**
+ * Zero-copy application TX (tinypan_udp_send_ref(), tinypan_pbuf_wrap()).
+ * Application memory is wrapped in an lwIP custom pbuf (PBUF_REF) instead of
+ * being copied, and a completion callback runs when the last reference is
+ * released: after TX_COMPLETE on BNEP, once the frame is encoded on SLIP, or
+ * when a queue flush drops it. Turns on LWIP_SUPPORT_CUSTOM_PBUF.
+ */
+#ifndef TINYPAN_ENABLE_ZERO_COPY_TX
+#define TINYPAN_ENABLE_ZERO_COPY_TX         0
+#endif
+
+/** Application buffers that may be in flight at once (1-16). */
+#ifndef TINYPAN_ZC_TX_SLOTS
+#define TINYPAN_ZC_TX_SLOTS                 4
+#endif
+
+/**
+ * Raw Ethernet frames for custom ethertypes (tinypan_send_frame(),
+ * tinypan_register_ethertype_handler()), BNEP mode only. Frames go onto the
+ * BNEP TX queue behind a compressed header, in order with lwIP's frames and
+ * without a pbuf; received frames of a registered ethertype are handed to
+ * their handler instead of lwIP.
+ */
+#ifndef TINYPAN_ENABLE_RAW_FRAMES
+#define TINYPAN_ENABLE_RAW_FRAMES           0
+#endif
+
+/** Ethertypes with a receive handler at once (1-8). */
+#ifndef TINYPAN_RAW_FRAME_HANDLERS
+#define TINYPAN_RAW_FRAME_HANDLERS          2
+#endif
+
+/**
+ * Link capacity estimate (tinypan_get_link_estimate()). The transports time
+ * each frame from enqueue to hand-off to the HAL and to TX_COMPLETE (BNEP)
+ * or to its last chunk going to the HAL (SLIP). Every
+ * TINYPAN_LINK_EST_WINDOW_MS the bytes and frames delivered are divided by
+ * the time the queue was busy, and the result is folded into the estimate
+ * with weight 1/2^TINYPAN_LINK_EST_EWMA_SHIFT.
+ */
+#ifndef TINYPAN_ENABLE_LINK_ESTIMATE
+#define TINYPAN_ENABLE_LINK_ESTIMATE        0
+#endif
+
+/** Measurement window; the estimate follows a bandwidth change within a few. */
+#ifndef TINYPAN_LINK_EST_WINDOW_MS
+#define TINYPAN_LINK_EST_WINDOW_MS          250
+#endif
+
+/** EWMA weight of each window (0 = no smoothing, 0-4). */
+#ifndef TINYPAN_LINK_EST_EWMA_SHIFT
+#define TINYPAN_LINK_EST_EWMA_SHIFT         1
+#endif
+
+/**
+ * Egress pacing. A token bucket in the BNEP and SLIP drain loops releases
+ * frames (SLIP: chunks) to the HAL at TINYPAN_PACING_RATE_BPS with a burst
+ * of TINYPAN_PACING_BURST_BYTES, so bursts from lwIP wait in TinyPAN's
+ * queue instead of filling the radio's buffers until it reports busy.
+ * tinypan_get_next_timeout_ms() includes the next release time.
+ */
+#ifndef TINYPAN_ENABLE_PACING
+#define TINYPAN_ENABLE_PACING               0
+#endif
+
+/**
+ * Pacing rate in bytes per second (tinypan_set_tx_pacing_rate() overrides
+ * it). 0 follows the link estimate times TINYPAN_PACING_EST_GAIN_PCT when
+ * TINYPAN_ENABLE_LINK_ESTIMATE is set, and leaves the link unpaced otherwise.
+ */
+#ifndef TINYPAN_PACING_RATE_BPS
+#define TINYPAN_PACING_RATE_BPS             0
+#endif
+
+/** Bytes that may leave back to back after an idle period. */
+#ifndef TINYPAN_PACING_BURST_BYTES
+#define TINYPAN_PACING_BURST_BYTES          1024
+#endif
+
+/**
+ * Headroom over the link estimate when pacing follows it (percent). Above
+ * 100 so the estimate, measured under pacing, can still climb.
+ */
+#ifndef TINYPAN_PACING_EST_GAIN_PCT
+#define TINYPAN_PACING_EST_GAIN_PCT         125
+#endif
+
+/**
+ * Per-flow fair queueing. Frames in the BNEP and SLIP TX queues are hashed
+ * on their IP 5-tuple into TINYPAN_FQ_BUCKETS flow buckets and sent by
+ * deficit round robin instead of in arrival order, so a bulk upload cannot
+ * hold a sparse flow's frame behind a full queue of its own. Costs one byte
+ * per queue slot and four per bucket.
+ */
+#ifndef TINYPAN_ENABLE_FQ
+#define TINYPAN_ENABLE_FQ                   0
+#endif
+
+/** Flow buckets (1-32). Flows that hash to the same bucket share it. */
+#ifndef TINYPAN_FQ_BUCKETS
+#define TINYPAN_FQ_BUCKETS                  8
+#endif
+
+/** Bytes a bucket may send per round. */
+#ifndef TINYPAN_FQ_QUANTUM
+#define TINYPAN_FQ_QUANTUM                  TINYPAN_MAX_FRAME_SIZE
+#endif
+
+/**
+ * Frames one bucket may hold in the TX queue. One below the queue's
+ * capacity (TINYPAN_TX_QUEUE_LEN - 1), so a bulk flow always leaves a slot
+ * to the others; it gets ERR_MEM beyond this and the refusal counts as a
+ * full queue for the watermark callback. The default queue of 3 leaves one
+ * frame per flow, which separates flows but keeps a bulk flow from having
+ * a frame queued behind the one being sent: raise TINYPAN_TX_QUEUE_LEN
+ * (8 or so) along with TINYPAN_ENABLE_FQ.
+ */
+#ifndef TINYPAN_FQ_FLOW_LIMIT
+#define TINYPAN_FQ_FLOW_LIMIT               ((TINYPAN_TX_QUEUE_LEN > 2) ? (TINYPAN_TX_QUEUE_LEN - 2) : 1)
+#endif
+
+/**
+ * Energy-oriented TX bursts. Frames wait in the TX queue for up to
+ * TINYPAN_TX_BURST_HOLD_MS and then leave back to back, so a device that
+ * sends a few packets per second wakes the radio once per burst instead of
+ * once per packet. TCP segments without payload (ACK, SYN, FIN), ARP,
+ * IPv6 neighbour discovery and DHCP are urgent: they open the burst at
+ * once and take any held frames with them, as does a full TX queue. The
+ * HAL chooses when within the hold a burst goes out
+ * (hal_bt_tx_burst_delay_ms()) and is told when the link goes idle
+ * (hal_bt_set_link_idle()), e.g. to request sniff mode.
+ */
+#ifndef TINYPAN_ENABLE_TX_BURST
+#define TINYPAN_ENABLE_TX_BURST             0
+#endif
+
+/** Longest a non-urgent frame is held for a burst (ms). */
+#ifndef TINYPAN_TX_BURST_HOLD_MS
+#define TINYPAN_TX_BURST_HOLD_MS            100
+#endif
+
 /**
  * Operating Mode: Dual-Path Architecture
  * 0: Native Bluetooth Classic (BNEP). Requires a BT Classic radio. Connects directly
@@ -173,6 +654,84 @@
 #define TINYPAN_SLIP_CHUNK_SIZE             247
 #endif
 
+/**
+ * Number of encoded SLIP chunks buffered ahead of the radio.
+ * The transport encodes up to this many chunks in advance and hands them to
+ * the HAL back-to-back while hal_bt_l2cap_get_tx_credits() allows, so one
+ * connection event can carry several packets. Each slot costs
+ * TINYPAN_SLIP_CHUNK_SIZE bytes; 1 restores one-chunk-at-a-time sending.
+ */
+#ifndef TINYPAN_SLIP_TX_CHUNKS
+#define TINYPAN_SLIP_TX_CHUNKS              4
+#endif
+
+/**
+ * CSLIP header compression (RFC 1144 for TCP, plus a per-flow context scheme
+ * for UDP and ICMP). Negotiated with the companion app when the link comes
+ * up; the transport falls back to plain SLIP if the peer does not answer.
+ * Costs roughly (2 * SLOTS * 68 + 2 * CTX_SLOTS * 29) bytes of RAM.
+ */
+#ifndef TINYPAN_SLIP_ENABLE_VJ
+#define TINYPAN_SLIP_ENABLE_VJ              0
+#endif
+
+/** Number of concurrent TCP flows tracked by the header compressor (1-16). */
+#ifndef TINYPAN_SLIP_VJ_SLOTS
+#define TINYPAN_SLIP_VJ_SLOTS               4
+#endif
+
+/** Number of concurrent UDP/ICMP flows tracked by the header compressor (1-16). */
+#ifndef TINYPAN_SLIP_VJ_CTX_SLOTS
+#define TINYPAN_SLIP_VJ_CTX_SLOTS           2
+#endif
+
+/**
+ * LZSS payload compression for SLIP frames (heatshrink class, no heap).
+ * Negotiated like TINYPAN_SLIP_ENABLE_VJ and applied per frame after header
+ * compression; frames that do not shrink are sent unmodified. Costs
+ * 2 * 2^WINDOW_BITS bytes of encoder window plus a TINYPAN_MAX_FRAME_SIZE TX
+ * buffer and a TINYPAN_RX_BUFFER_SIZE RX buffer.
+ */
+#ifndef TINYPAN_SLIP_ENABLE_LZ
+#define TINYPAN_SLIP_ENABLE_LZ              0
+#endif
+
+/** log2 of the LZ history window (4-12). Larger finds more matches but searches longer. */
+#ifndef TINYPAN_SLIP_LZ_WINDOW_BITS
+#define TINYPAN_SLIP_LZ_WINDOW_BITS         8
+#endif
+
+/** log2 of the longest LZ match (2 to WINDOW_BITS - 1). */
+#ifndef TINYPAN_SLIP_LZ_LOOKAHEAD_BITS
+#define TINYPAN_SLIP_LZ_LOOKAHEAD_BITS      4
+#endif
+
+/** Frames shorter than this (bytes) are not worth compressing and are sent as-is. */
+#ifndef TINYPAN_SLIP_LZ_MIN_FRAME
+#define TINYPAN_SLIP_LZ_MIN_FRAME           48
+#endif
+
+/**
+ * Derive the SLIP netif MTU from the negotiated link MTU.
+ * The MTU is lowered (never below 576) so that a full-size frame, including
+ * its END delimiters and expected escape bytes, fills a whole number of BLE
+ * writes instead of trailing a nearly empty one. Re-evaluated whenever
+ * hal_bt_l2cap_get_mtu() changes. With TCP enabled, lwIP derives the
+ * advertised MSS from this MTU as well.
+ */
+#ifndef TINYPAN_SLIP_MTU_AUTOTUNE
+#define TINYPAN_SLIP_MTU_AUTOTUNE           1
+#endif
+
+/**
+ * Escape overhead reserved by the MTU tuning, in bytes per 1000 payload bytes.
+ * Random binary data averages 2/256 (about 8); the default adds headroom so
+ * that most frames still fit. Text payloads rarely need escaping.
+ */
+#ifndef TINYPAN_SLIP_ESCAPE_PERMILLE
+#define TINYPAN_SLIP_ESCAPE_PERMILLE        12
+#endif
+
 /**
  * Depth of the ESP32 HAL internal event queue.
  */
@@ -237,14 +796,25 @@
 #endif
 
 /**
- * Enable heartbeat/link monitoring.
- * Reserved for future use. The supervisor currently operates on transport-layer
- * connectivity events.
+ * Enable heartbeat/link monitoring. While ONLINE, a link that has received
+ * nothing for heartbeat_interval_ms (tinypan_config_t) is probed with an
+ * ARP request to the gateway, and the round-trip time of each reply is
+ * measured. After heartbeat_retries unanswered probes the link is declared
+ * dead and torn down. Received traffic of any kind postpones the probe, so
+ * a busy link is never probed. SLIP has no ARP: the probe is an echo
+ * control frame, offered to the companion app when the link comes up. If
+ * the app does not agree to answer it, only received traffic is watched
+ * and a silent link is never declared dead.
  */
 #ifndef TINYPAN_ENABLE_HEARTBEAT
 #define TINYPAN_ENABLE_HEARTBEAT            0
 #endif
 
+/** Time a heartbeat probe may go unanswered before it is a miss (ms). */
+#ifndef TINYPAN_HEARTBEAT_TIMEOUT_MS
+#define TINYPAN_HEARTBEAT_TIMEOUT_MS        2000
+#endif
+
 /**
  * Enable debug logging.
  * Set to 0 to disable all debug output and reduce code size.
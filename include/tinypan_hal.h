@@ -69,11 +69,51 @@ typedef enum {
  */
 typedef void (*hal_l2cap_recv_callback_t)(const uint8_t* data, uint16_t len, void* user_data);
 
+/**
+ * @brief Callback for incoming L2CAP data, called from the HAL's RX context
+ * 
+ * Unlike hal_l2cap_recv_callback_t, this may run in the HAL's own reader
+ * task, concurrently with tinypan_process().
+ * 
+ * @param data      Pointer to received data (only valid during the call)
+ * @param len       Length of received data
+ * @param user_data User data pointer from registration
+ * @return true if the data was consumed, false if the HAL must queue it for
+ *         the regular receive callback in hal_bt_poll()
+ */
+typedef bool (*hal_l2cap_direct_recv_callback_t)(const uint8_t* data, uint16_t len, void* user_data);
+
+/**
+ * @brief HCI error codes the supervisor understands
+ * 
+ * A HAL that knows why a connection failed or closed passes the HCI
+ * reason as the status of HAL_L2CAP_EVENT_CONNECT_FAILED and
+ * HAL_L2CAP_EVENT_DISCONNECTED; TINYPAN_ENABLE_RECONNECT_POLICY picks the
+ * reconnect backoff from it. Any other value (0, a negative HAL error)
+ * is classified from the supervisor state alone.
+ */
+#define HAL_HCI_ERR_PAGE_TIMEOUT            0x04
+#define HAL_HCI_ERR_AUTH_FAILURE            0x05
+#define HAL_HCI_ERR_PIN_OR_KEY_MISSING      0x06
+#define HAL_HCI_ERR_CONN_TIMEOUT            0x08
+#define HAL_HCI_ERR_CONN_LIMIT_EXCEEDED     0x09
+#define HAL_HCI_ERR_REJ_LIMITED_RESOURCES   0x0D
+#define HAL_HCI_ERR_REJ_SECURITY            0x0E
+#define HAL_HCI_ERR_REJ_BAD_ADDR            0x0F
+#define HAL_HCI_ERR_REMOTE_USER_TERM        0x13
+#define HAL_HCI_ERR_REMOTE_LOW_RESOURCES    0x14
+#define HAL_HCI_ERR_REMOTE_POWER_OFF        0x15
+#define HAL_HCI_ERR_PAIRING_NOT_ALLOWED     0x18
+#define HAL_HCI_ERR_LMP_RESPONSE_TIMEOUT    0x22
+#define HAL_HCI_ERR_INSUFFICIENT_SECURITY   0x2F
+#define HAL_HCI_ERR_CONN_FAILED_TO_ESTABLISH 0x3E
+
 /**
  * @brief Callback for L2CAP connection events
  * 
  * @param event     Event type
- * @param status    Status code (0 = success, non-zero = error)
+ * @param status    Status code (0 = success, non-zero = error; an HCI
+ *                  error code where known, see HAL_HCI_ERR_*)
  * @param user_data User data pointer from registration
  */
 typedef void (*hal_l2cap_event_callback_t)(hal_l2cap_event_t event, int status, void* user_data);
@@ -191,6 +231,21 @@ int hal_bt_l2cap_send_iovec(const tinypan_iovec_t* iov, uint16_t iov_count);
  */
 bool hal_bt_l2cap_can_send(void);
 
+/**
+ * @brief Number of packets the link can accept right now
+ *
+ * BLE write-without-response and notification queues hold several packets
+ * per connection event. The SLIP transport pushes up to this many chunks
+ * back-to-back before asking again, so a HAL that knows its controller
+ * buffer depth should report the free slots here. HALs without that
+ * knowledge may return 1 while hal_bt_l2cap_can_send() is true; the
+ * transport then keeps sending until hal_bt_l2cap_send() reports busy.
+ *
+ * @return Free TX slots (an estimate: a send may still return 1), or 0 if
+ *         the caller must wait for HAL_L2CAP_EVENT_CAN_SEND_NOW
+ */
+uint16_t hal_bt_l2cap_get_tx_credits(void);
+
 /**
  * @brief Request a "can send now" event
  * 
@@ -213,6 +268,24 @@ void hal_bt_l2cap_request_can_send_now(void);
  */
 void hal_bt_l2cap_register_recv_callback(hal_l2cap_recv_callback_t callback, void* user_data);
 
+/**
+ * @brief Register callback for incoming L2CAP data in the HAL's RX context
+ * 
+ * Used when TINYPAN_ENABLE_RX_DIRECT=1 with NO_SYS=0. A HAL with a reader
+ * task should offer each received SDU to this callback before queueing it,
+ * and queue it for hal_bt_poll() as usual only when the callback returns
+ * false. Data order is preserved: TinyPAN only consumes frames once the
+ * BNEP connection is up, and never control packets.
+ * 
+ * HALs that receive in the application task anyway may store the callback
+ * and never call it. Registering NULL (done by tinypan_deinit()) must not
+ * return while the previous callback is still running.
+ * 
+ * @param callback  Function to call from the RX context, or NULL
+ * @param user_data User data pointer to pass to callback
+ */
+void hal_bt_l2cap_register_direct_recv_callback(hal_l2cap_direct_recv_callback_t callback, void* user_data);
+
 /**
  * @brief Register callback for L2CAP events
  * 
@@ -262,6 +335,87 @@ uint32_t hal_bt_get_next_timeout_ms(void);
  */
 uint16_t hal_bt_l2cap_get_mtu(void);
 
+/* ============================================================================
+ * Persistent Storage API
+ *
+ * Only required with TINYPAN_DHCP_CACHE_PERSIST=1. TinyPAN stores one small
+ * opaque blob (the DHCP lease cache, well under 512 bytes) and rewrites it
+ * only when its content changes.
+ * ============================================================================ */
+
+/**
+ * @brief Read the blob stored by the last hal_storage_save()
+ *
+ * @param data     Buffer to fill
+ * @param max_len  Size of the buffer
+ * @return Bytes read (truncated to max_len), 0 if nothing is stored,
+ *         negative on error
+ */
+int hal_storage_load(uint8_t* data, uint16_t max_len);
+
+/**
+ * @brief Replace the stored blob
+ *
+ * @param data  Blob to store
+ * @param len   Length of the blob
+ * @return 0 on success, negative on error
+ */
+int hal_storage_save(const uint8_t* data, uint16_t len);
+
+/* ============================================================================
+ * Link Power API
+ *
+ * Only required with TINYPAN_ENABLE_TX_BURST=1. Both calls are hints: a HAL
+ * that knows nothing of its radio's schedule returns max_delay_ms and
+ * ignores the idle notification.
+ * ============================================================================ */
+
+/**
+ * @brief Choose when a TX burst should go out
+ *
+ * Called when the first non-urgent frame of a burst is queued. Returning
+ * the time of the last sniff anchor or connection event within the budget
+ * lets the burst ride a radio wake-up that happens anyway.
+ *
+ * @param max_delay_ms  Longest the frame may be held (TINYPAN_TX_BURST_HOLD_MS)
+ * @return Milliseconds to hold the burst, at most max_delay_ms
+ */
+uint32_t hal_bt_tx_burst_delay_ms(uint32_t max_delay_ms);
+
+/**
+ * @brief The TX path went idle or became busy
+ *
+ * Called from tinypan_process(): idle after a burst has emptied the TX
+ * queue, busy when the next burst opens. A Classic HAL may request sniff
+ * mode while idle; a BLE HAL may ask for a longer connection interval or
+ * peripheral latency.
+ *
+ * @param idle  true when idle, false when busy
+ */
+void hal_bt_set_link_idle(bool idle);
+
+/* ============================================================================
+ * TX Recovery API
+ *
+ * Only required with TINYPAN_ENABLE_STALL_RECOVERY=1 (BNEP mode). A HAL
+ * that cannot reclaim a send returns -1, and every stall then tears the
+ * link down as it does without the option.
+ * ============================================================================ */
+
+/**
+ * @brief Abandon the send whose TX_COMPLETE never came
+ *
+ * Called when the frame passed to hal_bt_l2cap_send_iovec() has been in
+ * flight past its timeout. Returning 0 promises that the controller will
+ * not read the frame's buffers again (the DMA transfer was aborted, or the
+ * HAL had copied them) and that no TX_COMPLETE for it will follow: the
+ * stack then frees the buffers and sends the next frame on the same link.
+ *
+ * @return 0 if the buffers were reclaimed, negative if the send cannot be
+ *         cancelled
+ */
+int hal_bt_l2cap_cancel_tx(void);
+
 /* ============================================================================
  * Thread Synchronization API
  * 
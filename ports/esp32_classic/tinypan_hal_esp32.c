@@ -16,12 +16,20 @@
  *
  *   - **RX Path**: A dedicated FreeRTOS task blocks on `read(fd, ...)`.
  *     Received data is pushed into a `MessageBuffer`, which is drained by
- *     `hal_bt_poll()` in the application task context.
+ *     `hal_bt_poll()` in the application task context. With
+ *     `TINYPAN_ENABLE_RX_DIRECT`, each SDU is first offered to TinyPAN's
+ *     direct receive callback, which passes data frames to `tcpip_input()`
+ *     from the reader task; only what it declines is queued.
  *   - **TX Path**: `hal_bt_l2cap_send()` / `hal_bt_l2cap_send_iovec()` use
  *     POSIX `write(fd, ...)` directly. Congestion is detected synchronously
  *     from the `write()` return value (0 = ring buffer full).
  *   - **Events**: L2CAP callbacks dispatch events to a FreeRTOS queue,
  *     drained by `hal_bt_poll()`.
+ *   - **Failure reasons**: Bluedroid's L2CAP events carry its own
+ *     `esp_bt_l2cap_status_t`, not an HCI reason; failures are reported
+ *     with it negated. The HCI reason of an ACL disconnect only reaches the
+ *     application's GAP callback (`ESP_BT_GAP_ACL_DISCONN_CMPL_STAT_EVT`),
+ *     which passes it on with `hal_esp32_acl_disconnected()`.
  *
  * @note Thread Safety
  * The ESP-IDF Bluetooth stack executes all callbacks on a dedicated internal
@@ -46,6 +54,9 @@
 #include <esp_bt_device.h>
 #include <esp_l2cap_bt_api.h>
 #include <esp_timer.h>
+#if TINYPAN_DHCP_CACHE_PERSIST
+#include <nvs.h>
+#endif
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
@@ -94,6 +105,12 @@ static const char* TAG = "TinyPAN_HAL";
 static hal_l2cap_recv_callback_t s_recv_cb = NULL;
 static void* s_recv_cb_data = NULL;
 
+/* Called from the RX reader task; s_direct_recv_mutex is held across each call
+ * so that unregistering waits for a frame in progress */
+static hal_l2cap_direct_recv_callback_t s_direct_recv_cb = NULL;
+static void* s_direct_recv_cb_data = NULL;
+static SemaphoreHandle_t s_direct_recv_mutex = NULL;
+
 static hal_l2cap_event_callback_t s_event_cb = NULL;
 static void* s_event_cb_data = NULL;
 
@@ -109,6 +126,10 @@ static volatile bool s_is_connected = false;
 static volatile int s_l2cap_fd = -1;           /* VFS file descriptor (-1 = invalid) */
 static bool s_tx_complete_pending = false;
 
+/* --- HCI reason of the last ACL disconnect from the NAP (0 = none) --- */
+static esp_bd_addr_t s_remote_addr;
+static volatile uint8_t s_acl_disconnect_reason = 0;
+
 /* --- Negotiated MTU from OPEN_EVT --- */
 static uint16_t s_negotiated_mtu = TINYPAN_L2CAP_MTU;
 
@@ -143,6 +164,40 @@ typedef struct {
 
 static QueueHandle_t s_event_queue = NULL;
 
+/* ============================================================================
+ * Status Translation
+ * ============================================================================ */
+
+/**
+ * @brief Translate a Bluedroid L2CAP status into a HAL status.
+ *
+ * esp_bt_l2cap_status_t values are not HCI reasons: NEED_INIT (4),
+ * NEED_DEINIT (5) and NO_CONNECTION (6) would read as a page timeout and
+ * authentication failures. Failures are passed on negated, which the
+ * supervisor classifies from its state alone.
+ */
+static int esp_l2cap_status_to_hal(esp_bt_l2cap_status_t status) {
+    return (status == ESP_BT_L2CAP_SUCCESS) ? 0 : -(int)status;
+}
+
+/**
+ * @brief Record the HCI reason of an ACL disconnect.
+ *
+ * Call from the application's GAP callback on
+ * ESP_BT_GAP_ACL_DISCONN_CMPL_STAT_EVT with acl_disconn_cmpl_stat.bda and
+ * .reason. A disconnect from the NAP gives the next CONNECT_FAILED or
+ * DISCONNECTED event its reason; others are ignored.
+ *
+ * @param bda    Address of the peer
+ * @param reason esp_bt_status_t of the disconnect
+ */
+void hal_esp32_acl_disconnected(const uint8_t bda[HAL_BD_ADDR_LEN], int reason) {
+    if (reason < ESP_BT_STATUS_BASE_FOR_HCI_ERR || memcmp(bda, s_remote_addr, HAL_BD_ADDR_LEN) != 0) {
+        return;
+    }
+    s_acl_disconnect_reason = (uint8_t)(reason - ESP_BT_STATUS_BASE_FOR_HCI_ERR);
+}
+
 /* ============================================================================
  * CAN_SEND Timer Callback
  * ============================================================================ */
@@ -202,7 +257,7 @@ static void esp_l2cap_cb(esp_bt_l2cap_cb_event_t event,
         if (param->cl_init.status != ESP_BT_L2CAP_SUCCESS) {
             /* Initiation failed — report to app */
             event_msg.event_id = HAL_L2CAP_EVENT_CONNECT_FAILED;
-            event_msg.status = param->cl_init.status;
+            event_msg.status = esp_l2cap_status_to_hal(param->cl_init.status);
             xQueueSend(s_event_queue, &event_msg, 0);
             if (s_wakeup_cb) s_wakeup_cb(s_wakeup_cb_data);
         }
@@ -247,7 +302,7 @@ static void esp_l2cap_cb(esp_bt_l2cap_cb_event_t event,
             ESP_LOGE(TAG, "L2CAP open failed, status: %d",
                      param->open.status);
             event_msg.event_id = HAL_L2CAP_EVENT_CONNECT_FAILED;
-            event_msg.status = param->open.status;
+            event_msg.status = esp_l2cap_status_to_hal(param->open.status);
             xQueueSend(s_event_queue, &event_msg, 0);
             if (s_wakeup_cb) s_wakeup_cb(s_wakeup_cb_data);
         }
@@ -264,6 +319,10 @@ static void esp_l2cap_cb(esp_bt_l2cap_cb_event_t event,
         portEXIT_CRITICAL_SAFE(&s_state_spinlock);
 
         event_msg.event_id = HAL_L2CAP_EVENT_DISCONNECTED;
+        event_msg.status = esp_l2cap_status_to_hal(param->close.status);
+        if (event_msg.status == 0) {
+            event_msg.status = -1;  /* No reason known yet, see hal_bt_poll() */
+        }
         xQueueSend(s_event_queue, &event_msg, 0);
         if (s_wakeup_cb) s_wakeup_cb(s_wakeup_cb_data);
         break;
@@ -315,6 +374,19 @@ static void rx_reader_task_fn(void* arg) {
             continue;
         }
 
+        /* Direct delivery: TinyPAN hands data frames to tcpip_input() from here */
+        if (s_direct_recv_cb != NULL && s_direct_recv_mutex != NULL) {
+            bool consumed = false;
+            xSemaphoreTake(s_direct_recv_mutex, portMAX_DELAY);
+            if (s_direct_recv_cb != NULL) {
+                consumed = s_direct_recv_cb(s_rx_reader_buf, (uint16_t)len, s_direct_recv_cb_data);
+            }
+            xSemaphoreGive(s_direct_recv_mutex);
+            if (consumed) {
+                continue;
+            }
+        }
+
         /* Push to MessageBuffer for app task to pick up in hal_bt_poll() */
         size_t sent = xMessageBufferSend(s_rx_msg_buf, s_rx_reader_buf, (size_t)len, pdMS_TO_TICKS(100));
         if (sent == (size_t)len) {
@@ -396,6 +468,15 @@ void hal_bt_poll(void) {
     /* Drain L2CAP connection/disconnection events */
     esp_event_msg_t evt_msg;
     while (xQueueReceive(s_event_queue, &evt_msg, 0) == pdTRUE) {
+        /* The GAP event with the HCI reason is dispatched independently of
+         * the L2CAP one; by the time the app task runs it has normally
+         * arrived. Take it in place of the port-local status. */
+        if ((evt_msg.event_id == HAL_L2CAP_EVENT_CONNECT_FAILED ||
+             evt_msg.event_id == HAL_L2CAP_EVENT_DISCONNECTED) &&
+            s_acl_disconnect_reason != 0) {
+            evt_msg.status = s_acl_disconnect_reason;
+            s_acl_disconnect_reason = 0;
+        }
         if (s_event_cb) {
             s_event_cb((hal_l2cap_event_t)evt_msg.event_id, evt_msg.status, s_event_cb_data);
         }
@@ -430,6 +511,12 @@ int hal_bt_init(void) {
     s_l2cap_fd = -1;
     s_negotiated_mtu = TINYPAN_L2CAP_MTU;
 
+    s_direct_recv_mutex = xSemaphoreCreateMutex();
+    if (!s_direct_recv_mutex) {
+        ESP_LOGE(TAG, "Failed to create direct RX mutex");
+        goto cleanup;
+    }
+
     /* EventGroup for RX reader task exit signaling */
     s_rx_exit_event = xEventGroupCreate();
     if (!s_rx_exit_event) {
@@ -468,6 +555,7 @@ cleanup:
      * hal_bt_init() can be safely retried after a failure. */
     if (s_can_send_timer) { xTimerDelete(s_can_send_timer, portMAX_DELAY); s_can_send_timer = NULL; }
     if (s_rx_exit_event) { vEventGroupDelete(s_rx_exit_event); s_rx_exit_event = NULL; }
+    if (s_direct_recv_mutex) { vSemaphoreDelete(s_direct_recv_mutex); s_direct_recv_mutex = NULL; }
     if (s_event_queue) { vQueueDelete(s_event_queue); s_event_queue = NULL; }
     if (s_rx_msg_buf) { vMessageBufferDelete(s_rx_msg_buf); s_rx_msg_buf = NULL; }
     return -1;
@@ -509,6 +597,7 @@ void hal_bt_deinit(void) {
     if (s_event_queue) { vQueueDelete(s_event_queue); s_event_queue = NULL; }
     if (s_rx_msg_buf) { vMessageBufferDelete(s_rx_msg_buf); s_rx_msg_buf = NULL; }
     if (s_rx_exit_event) { vEventGroupDelete(s_rx_exit_event); s_rx_exit_event = NULL; }
+    if (s_direct_recv_mutex) { vSemaphoreDelete(s_direct_recv_mutex); s_direct_recv_mutex = NULL; }
 
     s_hal_initialized = false;
 }
@@ -528,6 +617,9 @@ int hal_bt_l2cap_connect(const uint8_t remote_addr[HAL_BD_ADDR_LEN],
         return -1;
     }
 
+    memcpy(s_remote_addr, remote_addr, HAL_BD_ADDR_LEN);
+    s_acl_disconnect_reason = 0;
+
     esp_err_t ret = esp_bt_l2cap_connect(
         ESP_BT_L2CAP_SEC_AUTHENTICATE | ESP_BT_L2CAP_SEC_ENCRYPT,  /* Android 14 requires both */
         psm,                              /* Passed from supervisor (typically HAL_BNEP_PSM 0x000F) */
@@ -650,6 +742,12 @@ bool hal_bt_l2cap_can_send(void) {
     return can_send;
 }
 
+uint16_t hal_bt_l2cap_get_tx_credits(void) {
+    /* The VFS ring buffer depth is not exposed; report one slot and let
+     * write() returning 0 signal congestion. */
+    return hal_bt_l2cap_can_send() ? 1 : 0;
+}
+
 bool hal_bt_l2cap_is_connected(void) {
     bool connected;
     portENTER_CRITICAL_SAFE(&s_state_spinlock);
@@ -667,6 +765,14 @@ void hal_bt_l2cap_register_recv_callback(hal_l2cap_recv_callback_t cb, void* use
     s_recv_cb_data = user_data;
 }
 
+void hal_bt_l2cap_register_direct_recv_callback(hal_l2cap_direct_recv_callback_t cb, void* user_data) {
+    /* Wait out a frame the RX reader may be delivering right now */
+    if (s_direct_recv_mutex) xSemaphoreTake(s_direct_recv_mutex, portMAX_DELAY);
+    s_direct_recv_cb = cb;
+    s_direct_recv_cb_data = user_data;
+    if (s_direct_recv_mutex) xSemaphoreGive(s_direct_recv_mutex);
+}
+
 void hal_bt_l2cap_register_event_callback(hal_l2cap_event_callback_t cb, void* user_data) {
     s_event_cb = cb;
     s_event_cb_data = user_data;
@@ -723,3 +829,87 @@ void hal_mutex_unlock(hal_mutex_t mutex) {
 void hal_mutex_destroy(hal_mutex_t mutex) {
     if (mutex) vSemaphoreDelete((SemaphoreHandle_t)mutex);
 }
+
+#if TINYPAN_ENABLE_TX_BURST
+/* ============================================================================
+ * Link Power Hints
+ *
+ * Bluedroid's power manager (bta_dm_pm) already parks an idle ACL link in
+ * sniff mode and does not expose the sniff anchors, so bursts use the whole
+ * hold and the idle hint needs no action here.
+ * ============================================================================ */
+
+uint32_t hal_bt_tx_burst_delay_ms(uint32_t max_delay_ms) {
+    return max_delay_ms;
+}
+
+void hal_bt_set_link_idle(bool idle) {
+    (void)idle; /* Unused when debug logs are compiled out */
+    ESP_LOGD(TAG, "TX path %s", idle ? "idle" : "busy");
+}
+#endif /* TINYPAN_ENABLE_TX_BURST */
+
+#if TINYPAN_ENABLE_STALL_RECOVERY
+/* ============================================================================
+ * TX Recovery
+ *
+ * write() has copied the frame into the VFS ring buffer before
+ * hal_bt_l2cap_send_iovec() returns, so the stack's buffers are never read
+ * afterwards and a stalled send can always be reclaimed.
+ * ============================================================================ */
+
+int hal_bt_l2cap_cancel_tx(void) {
+    s_tx_complete_pending = false;
+    ESP_LOGW(TAG, "TX stalled, send abandoned");
+    return 0;
+}
+#endif /* TINYPAN_ENABLE_STALL_RECOVERY */
+
+#if TINYPAN_DHCP_CACHE_PERSIST
+/* ============================================================================
+ * Persistent Storage (NVS)
+ *
+ * The application must have called nvs_flash_init() (it already does for
+ * Bluedroid bonding keys, see examples/esp32_app_main.c).
+ * ============================================================================ */
+
+#define TINYPAN_NVS_NAMESPACE   "tinypan"
+#define TINYPAN_NVS_KEY         "dhcp_cache"
+
+int hal_storage_load(uint8_t* data, uint16_t max_len) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(TINYPAN_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) return 0;     /* Namespace never written */
+    if (err != ESP_OK) return -1;
+
+    size_t len = 0;
+    err = nvs_get_blob(handle, TINYPAN_NVS_KEY, NULL, &len);
+    if (err == ESP_OK && len <= max_len) {
+        err = nvs_get_blob(handle, TINYPAN_NVS_KEY, data, &len);
+    } else if (err == ESP_OK) {
+        /* Written by a build with a larger cache: start over */
+        len = 0;
+    }
+    nvs_close(handle);
+
+    if (err == ESP_ERR_NVS_NOT_FOUND) return 0;
+    return (err == ESP_OK) ? (int)len : -1;
+}
+
+int hal_storage_save(const uint8_t* data, uint16_t len) {
+    nvs_handle_t handle;
+    if (nvs_open(TINYPAN_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return -1;
+    }
+    esp_err_t err = nvs_set_blob(handle, TINYPAN_NVS_KEY, data, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS write failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    return 0;
+}
+#endif /* TINYPAN_DHCP_CACHE_PERSIST */
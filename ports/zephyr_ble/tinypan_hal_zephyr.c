@@ -61,6 +61,16 @@ K_MSGQ_DEFINE(s_zephyr_event_q, sizeof(struct z_event_msg), 16, 4);
  * Size set to 2KB to handle full 1500-byte IP bursts. */
 RING_BUF_DECLARE(s_rx_ringbuf, 2048);
 
+/* Notifications the stack can buffer per connection. bt_nus_send() reports
+ * -ENOMEM once they are used up, which the SLIP transport handles as busy. */
+#ifndef TINYPAN_ZEPHYR_TX_CREDITS
+#ifdef CONFIG_BT_CONN_TX_MAX
+#define TINYPAN_ZEPHYR_TX_CREDITS   CONFIG_BT_CONN_TX_MAX
+#else
+#define TINYPAN_ZEPHYR_TX_CREDITS   3
+#endif
+#endif
+
 /* SLIP TX Chunker */
 static struct k_spinlock s_tx_lock;
 static bool s_tx_notify_pending = false;
@@ -222,6 +232,14 @@ bool hal_bt_l2cap_can_send(void) {
     return (s_current_conn != NULL);
 }
 
+uint16_t hal_bt_l2cap_get_tx_credits(void) {
+    k_spinlock_key_t key = k_spin_lock(&s_tx_lock);
+    /* Nothing can be queued while a busy backoff is running */
+    uint16_t credits = (s_current_conn && !s_tx_notify_pending) ? TINYPAN_ZEPHYR_TX_CREDITS : 0;
+    k_spin_unlock(&s_tx_lock, key);
+    return credits;
+}
+
 void hal_bt_l2cap_request_can_send_now(void) {
     k_spinlock_key_t key = k_spin_lock(&s_tx_lock);
     if (s_current_conn) {
@@ -316,3 +334,23 @@ void hal_mutex_unlock(hal_mutex_t mutex) {
 void hal_mutex_destroy(hal_mutex_t mutex) {
     if (mutex) free(mutex);
 }
+
+#if TINYPAN_ENABLE_TX_BURST
+/* Connection events are not visible through the NUS API and the central
+ * owns the connection parameters, so bursts use the whole hold. A product
+ * that negotiates peripheral latency could lower it while busy here. */
+uint32_t hal_bt_tx_burst_delay_ms(uint32_t max_delay_ms) {
+    return max_delay_ms;
+}
+
+void hal_bt_set_link_idle(bool idle) {
+    (void)idle;
+}
+#endif /* TINYPAN_ENABLE_TX_BURST */
+
+#if TINYPAN_ENABLE_STALL_RECOVERY
+/* Stall recovery is a BNEP feature; SLIP frames are never timed out. */
+int hal_bt_l2cap_cancel_tx(void) {
+    return -1;
+}
+#endif /* TINYPAN_ENABLE_STALL_RECOVERY */
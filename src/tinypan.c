@@ -15,7 +15,44 @@
 #if TINYPAN_ENABLE_LWIP
 #include "tinypan_lwip_netif.h"
 #include "lwip/timeouts.h"
+#if TINYPAN_ENABLE_DNS_CACHE
+#include "tinypan_dns.h"
 #endif
+#if TINYPAN_ENABLE_UDP_FAST
+#include "tinypan_udp_fast.h"
+#endif
+#if TINYPAN_ENABLE_ZERO_COPY_TX
+#include "tinypan_zc_tx.h"
+#endif
+#endif
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+#include "tinypan_link_est.h"
+#endif
+#if TINYPAN_ENABLE_PACING
+#include "tinypan_pacer.h"
+#endif
+#if TINYPAN_ENABLE_FQ
+#include "tinypan_fq.h"
+#endif
+#if TINYPAN_ENABLE_TX_BURST
+#include "tinypan_burst.h"
+#endif
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+#include "tinypan_tx_rto.h"
+#endif
+#if TINYPAN_ENABLE_STALL_RECOVERY
+#include "tinypan_stall.h"
+#endif
+#if TINYPAN_ENABLE_HEARTBEAT
+#include "tinypan_heartbeat.h"
+#endif
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+#include "tinypan_reconnect.h"
+#endif
+
+/** Direct RX hands BNEP data frames to tcpip_input() from the HAL's RX context */
+#define TINYPAN_RX_DIRECT \
+    (TINYPAN_ENABLE_RX_DIRECT && TINYPAN_ENABLE_LWIP && !NO_SYS && !TINYPAN_USE_BLE_SLIP)
 
 /* ============================================================================
  * State
@@ -26,11 +63,25 @@ static tinypan_config_t s_config;
 static tinypan_event_callback_t s_event_callback = NULL;
 static void* s_event_callback_user_data = NULL;
 static tinypan_state_t s_last_reported_state = TINYPAN_STATE_IDLE;
+#if TINYPAN_ENABLE_STALL_RECOVERY
+static uint32_t s_last_reported_stalls = 0;
+#endif
 
 /* IP info (will be filled by lwIP integration) */
 static tinypan_ip_info_t s_ip_info = {0};
 static bool s_has_ip = false;
 
+#if TINYPAN_ENABLE_RAW_FRAMES
+/** Receive handler for a custom ethertype (handler NULL = free) */
+typedef struct {
+    uint16_t ethertype;
+    tinypan_frame_handler_t handler;
+    void* user_data;
+} frame_handler_t;
+
+static frame_handler_t s_frame_handlers[TINYPAN_RAW_FRAME_HANDLERS];
+#endif
+
 /* ============================================================================
  * Internal Callbacks
  * ============================================================================ */
@@ -40,12 +91,32 @@ static bool s_has_ip = false;
  */
 static void l2cap_recv_callback(const uint8_t* data, uint16_t len, void* user_data) {
     (void)user_data;
+#if TINYPAN_ENABLE_HEARTBEAT
+    tinypan_heartbeat_rx();
+#endif
     const tinypan_transport_t* transport = tinypan_transport_get();
     if (transport && transport->handle_incoming) {
         transport->handle_incoming(data, len);
     }
 }
 
+#if TINYPAN_RX_DIRECT
+/**
+ * @brief L2CAP receive callback in the HAL's RX context - data frames only
+ */
+static bool l2cap_direct_recv_callback(const uint8_t* data, uint16_t len, void* user_data) {
+    (void)user_data;
+#if TINYPAN_ENABLE_HEARTBEAT
+    tinypan_heartbeat_rx();
+#endif
+    const tinypan_transport_t* transport = tinypan_transport_get();
+    if (transport && transport->handle_incoming_direct) {
+        return transport->handle_incoming_direct(data, len);
+    }
+    return false;
+}
+#endif
+
 /**
  * @brief L2CAP event callback - passes events to supervisor
  */
@@ -100,6 +171,19 @@ tinypan_error_t tinypan_init(const tinypan_config_t* config) {
     
     /* Copy config */
     memcpy(&s_config, config, sizeof(tinypan_config_t));
+#if TINYPAN_ENABLE_RAW_FRAMES
+    memset(s_frame_handlers, 0, sizeof(s_frame_handlers));
+#endif
+    tinypan_transport_tx_set_callback(NULL, NULL);
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    tinypan_link_est_reset();
+#endif
+#if TINYPAN_ENABLE_PACING
+    tinypan_pacer_reset();
+#endif
+#if TINYPAN_ENABLE_FQ
+    tinypan_fq_reset();
+#endif
     
     /* Initialize HAL */
     int hal_result = hal_bt_init();
@@ -107,10 +191,29 @@ tinypan_error_t tinypan_init(const tinypan_config_t* config) {
         TINYPAN_LOG_ERROR("HAL init failed: %d", hal_result);
         return TINYPAN_ERR_HAL_FAILED;
     }
+#if TINYPAN_ENABLE_TX_BURST
+    tinypan_burst_reset();
+#endif
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+    tinypan_tx_rto_reset();
+#endif
+#if TINYPAN_ENABLE_STALL_RECOVERY
+    tinypan_stall_reset();
+    s_last_reported_stalls = 0;
+#endif
+#if TINYPAN_ENABLE_HEARTBEAT
+    tinypan_heartbeat_reset();
+#endif
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+    tinypan_reconnect_reset();
+#endif
     
     /* Register HAL callbacks */
     hal_bt_l2cap_register_recv_callback(l2cap_recv_callback, NULL);
     hal_bt_l2cap_register_event_callback(l2cap_event_callback, NULL);
+#if TINYPAN_RX_DIRECT
+    hal_bt_l2cap_register_direct_recv_callback(l2cap_direct_recv_callback, NULL);
+#endif
     
     /* Initialize active transport */
     const tinypan_transport_t* transport = tinypan_transport_get();
@@ -212,6 +315,27 @@ void tinypan_process(void) {
     if (transport && transport->process) {
         transport->process();
     }
+#if TINYPAN_ENABLE_PACING
+    /* Release time of frames the pacer held back */
+    if (tinypan_pacer_next_ms() == 0 && transport && transport->on_can_send_now) {
+        transport->on_can_send_now();
+    }
+#endif
+#if TINYPAN_ENABLE_TX_BURST
+    /* End of a burst hold; idle hints for the HAL */
+    if (tinypan_burst_process() && transport && transport->on_can_send_now) {
+        transport->on_can_send_now();
+    }
+#endif
+
+#if TINYPAN_ENABLE_STALL_RECOVERY
+    /* One event per stall, even one that cleared before the state was seen */
+    uint32_t stalls = tinypan_stall_count();
+    if (stalls != s_last_reported_stalls) {
+        s_last_reported_stalls = stalls;
+        dispatch_event(TINYPAN_EVENT_TX_STALLED);
+    }
+#endif
 
     tinypan_state_t current_state = supervisor_get_state();
     if (current_state != s_last_reported_state) {
@@ -237,6 +361,12 @@ uint32_t tinypan_get_next_timeout_ms(void) {
     if (lwip_sleep < sleep_ms) {
         sleep_ms = lwip_sleep;
     }
+
+    /* PAN-profile DHCP retransmissions and DNS resends are scheduled outside lwIP's timers */
+    uint32_t netif_sleep = tinypan_netif_get_next_timeout_ms();
+    if (netif_sleep < sleep_ms) {
+        sleep_ms = netif_sleep;
+    }
 #endif
 
     /* TinyPAN has its own internal state machine timeouts.
@@ -246,6 +376,30 @@ uint32_t tinypan_get_next_timeout_ms(void) {
         sleep_ms = sup_sleep;
     }
 
+    /* Release time of frames held back by the egress pacer */
+#if TINYPAN_ENABLE_PACING
+    uint32_t pacer_sleep = tinypan_pacer_next_ms();
+    if (pacer_sleep < sleep_ms) {
+        sleep_ms = pacer_sleep;
+    }
+#endif
+
+    /* End of a TX burst hold */
+#if TINYPAN_ENABLE_TX_BURST
+    uint32_t burst_sleep = tinypan_burst_next_ms();
+    if (burst_sleep < sleep_ms) {
+        sleep_ms = burst_sleep;
+    }
+#endif
+
+    /* Stall check of the frame waiting for TX_COMPLETE */
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+    uint32_t rto_sleep = tinypan_tx_rto_next_ms();
+    if (rto_sleep < sleep_ms) {
+        sleep_ms = rto_sleep;
+    }
+#endif
+
     /* Consult the HAL for internal backoff requirements */
     uint32_t hal_sleep = hal_bt_get_next_timeout_ms();
     if (hal_sleep < sleep_ms) {
@@ -292,12 +446,409 @@ tinypan_error_t tinypan_get_ip_info(tinypan_ip_info_t* info) {
     return TINYPAN_OK;
 }
 
+uint16_t tinypan_get_mtu(void) {
+#if TINYPAN_ENABLE_LWIP
+    return tinypan_netif_get_mtu();
+#else
+    return 0;
+#endif
+}
+
+uint16_t tinypan_tx_available(void) {
+    if (!s_initialized) {
+        return 0;
+    }
+    /* One ring slot always stays empty to tell full from empty */
+    uint16_t capacity = TINYPAN_TX_QUEUE_LEN - 1;
+    uint16_t queued = tinypan_transport_tx_queued();
+    uint16_t available = (queued < capacity) ? (uint16_t)(capacity - queued) : 0;
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_FQ
+    /* The producer's frames may all share one flow's bucket */
+    const tinypan_transport_t* transport = tinypan_transport_get();
+    if (transport && transport->tx_flow_room) {
+        uint16_t room = transport->tx_flow_room();
+        available = (room < available) ? room : available;
+    }
+#endif
+    return available;
+}
+
+void tinypan_set_tx_watermark_callback(tinypan_tx_watermark_callback_t callback, void* user_data) {
+    tinypan_transport_tx_set_callback(callback, user_data);
+}
+
+tinypan_error_t tinypan_set_tx_pacing_rate(uint32_t bytes_per_s) {
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_PACING
+    tinypan_pacer_set_rate(bytes_per_s);
+    return TINYPAN_OK;
+#else
+    (void)bytes_per_s;
+    return TINYPAN_ERR_INVALID_PARAM;
+#endif
+}
+
+tinypan_error_t tinypan_get_link_estimate(tinypan_link_estimate_t* estimate) {
+    if (estimate == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+    memset(estimate, 0, sizeof(*estimate));
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_LINK_ESTIMATE
+    /* The transport feeds the estimate with its TX lock held */
+    const tinypan_transport_t* transport = tinypan_transport_get();
+    if (transport && transport->link_estimate) {
+        transport->link_estimate(estimate);
+    }
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_get_tx_burst_stats(tinypan_tx_burst_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_TX_BURST
+    tinypan_burst_get_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_get_tx_timeout_stats(tinypan_tx_timeout_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+    tinypan_tx_rto_get_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_get_stall_stats(tinypan_stall_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_STALL_RECOVERY
+    tinypan_stall_get_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_get_heartbeat_stats(tinypan_heartbeat_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_HEARTBEAT
+    tinypan_heartbeat_get_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_get_reconnect_stats(tinypan_reconnect_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+    tinypan_reconnect_get_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_get_checksum_stats(tinypan_checksum_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP
+    tinypan_netif_get_checksum_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+    stats->full_checking = true;
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_dns_resolve(const char* hostname, uint32_t* ip_addr,
+                                    tinypan_dns_callback_t callback, void* user_data) {
+    if (hostname == NULL || ip_addr == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_DNS_CACHE
+    return tinypan_dns_lookup(hostname, ip_addr, callback, user_data);
+#else
+    (void)callback;
+    (void)user_data;
+    return TINYPAN_ERR_NOT_FOUND;
+#endif
+}
+
+tinypan_error_t tinypan_get_dns_stats(tinypan_dns_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_DNS_CACHE
+    tinypan_dns_get_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_udp_open(uint32_t remote_ip, uint16_t remote_port,
+                                 uint16_t local_port, tinypan_udp_t** flow) {
+    if (flow == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_UDP_FAST
+    return tinypan_udp_fast_open(remote_ip, remote_port, local_port, flow);
+#else
+    (void)remote_ip;
+    (void)remote_port;
+    (void)local_port;
+    return TINYPAN_ERR_NO_MEMORY;
+#endif
+}
+
+tinypan_error_t tinypan_udp_send(tinypan_udp_t* flow, const void* data, uint16_t len) {
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_UDP_FAST
+    return tinypan_udp_fast_send(flow, data, len);
+#else
+    (void)flow;
+    (void)data;
+    (void)len;
+    return TINYPAN_ERR_INVALID_PARAM;
+#endif
+}
+
+tinypan_error_t tinypan_udp_send_ref(tinypan_udp_t* flow, const void* data, uint16_t len,
+                                     tinypan_tx_done_callback_t done, void* user_data) {
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_UDP_FAST && TINYPAN_ENABLE_ZERO_COPY_TX
+    return tinypan_udp_fast_send_ref(flow, data, len, done, user_data);
+#else
+    (void)flow;
+    (void)data;
+    (void)len;
+    (void)done;
+    (void)user_data;
+    return TINYPAN_ERR_INVALID_PARAM;
+#endif
+}
+
+struct pbuf* tinypan_pbuf_wrap(const void* data, uint16_t len,
+                               tinypan_tx_done_callback_t done, void* user_data) {
+    if (!s_initialized) {
+        return NULL;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_ZERO_COPY_TX
+    return tinypan_zc_tx_wrap(data, len, done, user_data);
+#else
+    (void)data;
+    (void)len;
+    (void)done;
+    (void)user_data;
+    return NULL;
+#endif
+}
+
+tinypan_error_t tinypan_send_frame(const uint8_t* dst_addr, uint16_t ethertype, const void* payload,
+                                   uint16_t len, tinypan_tx_done_callback_t done, void* user_data) {
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_RAW_FRAMES
+    if (payload == NULL || len == 0 || len > TINYPAN_MAX_FRAME_SIZE || ethertype < 0x0600) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    const tinypan_transport_t* transport = tinypan_transport_get();
+    if (transport == NULL || transport->send_frame == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;   /* SLIP carries IP only */
+    }
+    return (tinypan_error_t)transport->send_frame(dst_addr, ethertype, payload, len, done, user_data);
+#else
+    (void)dst_addr;
+    (void)ethertype;
+    (void)payload;
+    (void)len;
+    (void)done;
+    (void)user_data;
+    return TINYPAN_ERR_INVALID_PARAM;
+#endif
+}
+
+tinypan_error_t tinypan_register_ethertype_handler(uint16_t ethertype, tinypan_frame_handler_t handler,
+                                                   void* user_data) {
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_RAW_FRAMES
+    /* IPv4 and ARP belong to lwIP */
+    if (ethertype < 0x0600 || ethertype == 0x0800 || ethertype == 0x0806) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    frame_handler_t* slot = NULL;
+    for (int i = 0; i < TINYPAN_RAW_FRAME_HANDLERS; i++) {
+        if (s_frame_handlers[i].handler != NULL && s_frame_handlers[i].ethertype == ethertype) {
+            slot = &s_frame_handlers[i];
+            break;
+        }
+        if (slot == NULL && s_frame_handlers[i].handler == NULL) {
+            slot = &s_frame_handlers[i];
+        }
+    }
+    
+    if (handler == NULL) {
+        if (slot != NULL && slot->ethertype == ethertype) {
+            memset(slot, 0, sizeof(*slot));
+        }
+        return TINYPAN_OK;
+    }
+    if (slot == NULL) {
+        return TINYPAN_ERR_NO_MEMORY;
+    }
+    slot->ethertype = ethertype;
+    slot->user_data = user_data;
+    slot->handler = handler;
+    return TINYPAN_OK;
+#else
+    (void)ethertype;
+    (void)handler;
+    (void)user_data;
+    return TINYPAN_ERR_NO_MEMORY;
+#endif
+}
+
+tinypan_error_t tinypan_udp_recv(tinypan_udp_t* flow, const uint8_t** data, uint16_t* len,
+                                 uint32_t* src_ip, uint16_t* src_port) {
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_UDP_FAST
+    return tinypan_udp_fast_recv(flow, data, len, src_ip, src_port);
+#else
+    (void)flow;
+    (void)data;
+    (void)len;
+    (void)src_ip;
+    (void)src_port;
+    return TINYPAN_ERR_INVALID_PARAM;
+#endif
+}
+
+void tinypan_udp_close(tinypan_udp_t* flow) {
+    if (!s_initialized) {
+        return;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_UDP_FAST
+    tinypan_udp_fast_close(flow);
+#else
+    (void)flow;
+#endif
+}
+
+tinypan_error_t tinypan_get_udp_stats(tinypan_udp_stats_t* stats) {
+    if (stats == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    
+    if (!s_initialized) {
+        return TINYPAN_ERR_NOT_INITIALIZED;
+    }
+    
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_UDP_FAST
+    tinypan_udp_fast_get_stats(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    return TINYPAN_OK;
+}
+
 void tinypan_deinit(void) {
     if (!s_initialized) {
         return;
     }
     
     TINYPAN_LOG_INFO("TinyPAN de-initializing");
+
+#if TINYPAN_RX_DIRECT
+    /* Returns once the HAL's RX context is out of the netif */
+    hal_bt_l2cap_register_direct_recv_callback(NULL, NULL);
+#endif
     
     tinypan_stop();
 
@@ -311,6 +862,10 @@ void tinypan_deinit(void) {
     s_event_callback = NULL;
     s_event_callback_user_data = NULL;
     s_last_reported_state = TINYPAN_STATE_IDLE;
+#if TINYPAN_ENABLE_RAW_FRAMES
+    memset(s_frame_handlers, 0, sizeof(s_frame_handlers));
+#endif
+    tinypan_transport_tx_set_callback(NULL, NULL);
     
     TINYPAN_LOG_INFO("TinyPAN de-initialized");
 }
@@ -355,3 +910,17 @@ void tinypan_internal_clear_ip(void) {
 const tinypan_config_t* tinypan_internal_get_config(void) {
     return &s_config;
 }
+
+#if TINYPAN_ENABLE_RAW_FRAMES
+bool tinypan_internal_dispatch_frame(const uint8_t* dst_addr, const uint8_t* src_addr,
+                                     uint16_t ethertype, const uint8_t* payload, uint16_t len) {
+    for (int i = 0; i < TINYPAN_RAW_FRAME_HANDLERS; i++) {
+        const frame_handler_t* h = &s_frame_handlers[i];
+        if (h->handler != NULL && h->ethertype == ethertype) {
+            h->handler(ethertype, dst_addr, src_addr, payload, len, h->user_data);
+            return true;
+        }
+    }
+    return false;
+}
+#endif
@@ -473,6 +473,14 @@ void bnep_set_remote_addr(const uint8_t addr[BNEP_ETHER_ADDR_LEN]) {
     }
 }
 
+const uint8_t* bnep_get_local_addr(void) {
+    return s_local_addr;
+}
+
+const uint8_t* bnep_get_remote_addr(void) {
+    return s_remote_addr;
+}
+
 void bnep_register_frame_callback(bnep_frame_recv_callback_t callback, void* user_data) {
     s_frame_callback = callback;
     s_frame_callback_user_data = user_data;
@@ -701,10 +709,10 @@ static void handle_control_packet(const uint8_t* data, uint16_t len) {
         case BNEP_CTRL_FILTER_MULTI_ADDR_RESPONSE:
         case BNEP_CTRL_FILTER_NET_TYPE_RESPONSE:
             {
-                /* Parse 2-byte response code from payload */
+                /* Parse 2-byte response code following the control type */
                 uint16_t filter_resp = 0x0001; /* default: unsupported */
-                if (len >= 4) {
-                    filter_resp = ((uint16_t)data[2] << 8) | data[3];
+                if (len >= 3) {
+                    filter_resp = ((uint16_t)data[1] << 8) | data[2];
                 }
                 TINYPAN_LOG_INFO("BNEP Filter response: 0x%04X", filter_resp);
 
@@ -807,6 +815,33 @@ void bnep_handle_incoming(const uint8_t* data, uint16_t len) {
     }
 }
 
+bool bnep_handle_incoming_direct(const uint8_t* data, uint16_t len) {
+    if (data == NULL || len == 0 || s_state != BNEP_STATE_CONNECTED) {
+        return false;
+    }
+    
+    uint8_t pkt_type;
+    bool has_ext;
+    uint16_t header_len;
+    
+    if (bnep_parse_header(data, len, &pkt_type, &has_ext, &header_len) < 0) {
+        return false;
+    }
+    
+    switch (pkt_type) {
+        case BNEP_PKT_TYPE_GENERAL_ETHERNET:
+        case BNEP_PKT_TYPE_COMPRESSED_ETHERNET:
+        case BNEP_PKT_TYPE_COMPRESSED_SRC_ONLY:
+        case BNEP_PKT_TYPE_COMPRESSED_DST_ONLY:
+            /* Extension headers are bounds-checked by bnep_parse_ethernet_frame() */
+            handle_ethernet_frame(data, len);
+            return true;
+            
+        default:
+            return false;
+    }
+}
+
 void bnep_on_l2cap_connected(void) {
     TINYPAN_LOG_INFO("L2CAP connected, sending BNEP setup request");
     set_state(BNEP_STATE_WAIT_FOR_CONNECTION_RESPONSE);
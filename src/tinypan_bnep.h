@@ -173,6 +173,16 @@ void bnep_set_local_addr(const uint8_t addr[BNEP_ETHER_ADDR_LEN]);
  */
 void bnep_set_remote_addr(const uint8_t addr[BNEP_ETHER_ADDR_LEN]);
 
+/**
+ * @brief Get local Ethernet address
+ */
+const uint8_t* bnep_get_local_addr(void);
+
+/**
+ * @brief Get remote (NAP) Ethernet address
+ */
+const uint8_t* bnep_get_remote_addr(void);
+
 /**
  * @brief Register callback for received Ethernet frames
  */
@@ -282,6 +292,20 @@ void bnep_write_ethernet_header(uint8_t* buffer, uint8_t header_len,
  */
 void bnep_handle_incoming(const uint8_t* data, uint16_t len);
 
+/**
+ * @brief Handle incoming L2CAP data in the HAL's RX context
+ * 
+ * Consumes Ethernet frames once the connection is up and passes them to
+ * the frame callback, which must be thread-safe. Control packets, and
+ * anything received before BNEP_STATE_CONNECTED, are left for
+ * bnep_handle_incoming() in the application thread.
+ * 
+ * @param data  Pointer to received data
+ * @param len   Length of received data
+ * @return true if consumed (delivered or dropped), false if not handled
+ */
+bool bnep_handle_incoming_direct(const uint8_t* data, uint16_t len);
+
 /**
  * @brief Called when L2CAP channel is opened
  * 
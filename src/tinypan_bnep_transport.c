@@ -9,6 +9,12 @@
 #include "tinypan_transport.h"
 #include "tinypan_bnep.h"
 #include "tinypan_internal.h"
+#include "tinypan_link_est.h"
+#include "tinypan_pacer.h"
+#include "tinypan_fq.h"
+#include "tinypan_burst.h"
+#include "tinypan_tx_rto.h"
+#include "tinypan_stall.h"
 #include "../include/tinypan.h"
 #include "../include/tinypan_config.h"
 #include "../include/tinypan_hal.h"
@@ -34,15 +40,23 @@ static hal_mutex_t s_bnep_tx_mutex = NULL;
 
 static void bnep_transport_frame_cb(const bnep_ethernet_frame_t* frame, void* user_data) {
     (void)user_data;
+    if (frame == NULL) {
+        return;
+    }
     TINYPAN_LOG_DEBUG("transport_bnep: Received frame type=0x%04X len=%u",
                        frame->ethertype, frame->payload_len);
     
-#if TINYPAN_ENABLE_LWIP
-    if (frame != NULL) {
-        tinypan_netif_input(frame->dst_addr, frame->src_addr, frame->ethertype,
-                            frame->payload, frame->payload_len);
+#if TINYPAN_ENABLE_RAW_FRAMES
+    if (tinypan_internal_dispatch_frame(frame->dst_addr, frame->src_addr, frame->ethertype,
+                                        frame->payload, frame->payload_len)) {
+        return;
     }
 #endif
+
+#if TINYPAN_ENABLE_LWIP
+    tinypan_netif_input(frame->dst_addr, frame->src_addr, frame->ethertype,
+                        frame->payload, frame->payload_len);
+#endif
 }
 
 static void bnep_transport_setup_response_cb(uint16_t response_code, void* user_data) {
@@ -83,6 +97,12 @@ static int bnep_transport_init(void) {
 }
 
 static void bnep_transport_on_connected(void) {
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+    tinypan_tx_rto_link_up();
+#endif
+#if TINYPAN_ENABLE_STALL_RECOVERY
+    tinypan_stall_link_up();
+#endif
     bnep_on_l2cap_connected();
 }
 
@@ -94,6 +114,12 @@ static void bnep_transport_handle_incoming(const uint8_t* data, uint16_t len) {
     bnep_handle_incoming(data, len);
 }
 
+/* HAL RX context: frames go to tinypan_netif_input(), whose tcpip_input()
+ * hand-off is thread-safe when NO_SYS=0 */
+static bool bnep_transport_handle_incoming_direct(const uint8_t* data, uint16_t len) {
+    return bnep_handle_incoming_direct(data, len);
+}
+
 static void bnep_transport_retry_setup(void) {
     bnep_send_setup_request();
 }
@@ -115,11 +141,25 @@ static void bnep_transport_on_can_send_now(void) {
 /* TX Queue: stores unmodified pbufs alongside their synthesized BNEP headers */
 typedef struct {
     struct pbuf* p;
+#if TINYPAN_ENABLE_RAW_FRAMES
+    /* tinypan_send_frame(): payload referenced in place, p is NULL */
+    const uint8_t* raw;
+    uint16_t raw_len;
+    tinypan_tx_done_callback_t done;
+    void* done_arg;
+#endif
     uint8_t hdr[15];
     uint8_t hdr_len;
     tinypan_iovec_t iov[6]; /* Reduced from 16 to 6 to save RAM; 16-chain pbufs are invalid. */
     uint16_t iov_count;
     uint32_t sent_at_ms;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    uint32_t queued_at_ms;
+#endif
+#if TINYPAN_ENABLE_FQ
+    uint8_t flow;           /* Flow bucket */
+    bool scheduled;         /* Chosen by the scheduler, stays at the head */
+#endif
     bool in_flight;
 } bnep_tx_job_t;
 
@@ -127,6 +167,163 @@ static bnep_tx_job_t s_bnep_tx_queue[TINYPAN_TX_QUEUE_LEN];
 static uint8_t s_bnep_tx_head = 0;
 static uint8_t s_bnep_tx_tail = 0;
 
+/**
+ * @brief Drop the job's reference to its frame
+ *
+ * Called with s_bnep_tx_mutex held, so the release callbacks run under it
+ * too (see tinypan_tx_done_callback_t).
+ */
+static void bnep_tx_job_release(bnep_tx_job_t* job) {
+    struct pbuf* q = job->p;
+    job->p = NULL;
+#if TINYPAN_ENABLE_RAW_FRAMES
+    tinypan_tx_done_callback_t done = job->done;
+    const uint8_t* raw = job->raw;
+    job->raw = NULL;
+    job->done = NULL;
+    if (raw != NULL) {
+        tinypan_transport_tx_released(job->raw_len);
+    }
+    if (done != NULL) {
+        done(raw, job->done_arg);
+    }
+#endif
+    if (q) {
+        tinypan_transport_tx_released(q->tot_len);
+        pbuf_free(q);
+    }
+}
+
+/**
+ * @brief How long the job in flight may wait for TX_COMPLETE (ms)
+ */
+static uint32_t bnep_tx_timeout_ms(void) {
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+    return tinypan_tx_rto_ms();
+#else
+    return TINYPAN_BNEP_TX_TIMEOUT_MS;
+#endif
+}
+
+/**
+ * @brief Reclaim the head job after it missed its TX_COMPLETE
+ *
+ * With TINYPAN_ENABLE_STALL_RECOVERY the HAL first gets the chance to
+ * cancel the send, and the queue carries on behind it. Otherwise the link
+ * is torn down to safely cancel the hardware state. A disconnect request
+ * may not instantly stop an active DMA transfer on some silicon, but the
+ * buffer must be reclaimed to avoid a permanent stall.
+ *
+ * @return true if the queue may resume on this link
+ */
+static bool bnep_tx_job_expired(bnep_tx_job_t* job) {
+    bool resume = false;
+
+    job->in_flight = false;
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+    tinypan_tx_rto_expired();
+#endif
+#if TINYPAN_ENABLE_STALL_RECOVERY
+    resume = tinypan_stall_detected();
+#endif
+    if (!resume) {
+        hal_bt_l2cap_disconnect();
+    }
+
+    s_bnep_tx_head = (s_bnep_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
+    bnep_tx_job_release(job);
+    return resume;
+}
+
+#if TINYPAN_ENABLE_LINK_ESTIMATE || TINYPAN_ENABLE_PACING
+/**
+ * @brief Bytes the mapped job puts on the link
+ */
+static uint16_t bnep_tx_job_wire_len(const bnep_tx_job_t* job) {
+    uint16_t len = 0;
+    for (uint16_t i = 0; i < job->iov_count; i++) {
+        len += job->iov[i].iov_len;
+    }
+    return len;
+}
+#endif
+
+#if TINYPAN_ENABLE_FQ
+/**
+ * @brief Bytes the job took in the queue
+ */
+static uint16_t bnep_tx_job_len(const bnep_tx_job_t* job) {
+#if TINYPAN_ENABLE_RAW_FRAMES
+    if (job->p == NULL) {
+        return job->raw_len;
+    }
+#endif
+    return job->p->tot_len;
+}
+
+/**
+ * @brief Buckets and lengths of the queued jobs, head first
+ * @return Number of queued jobs
+ */
+static uint8_t bnep_fq_snapshot(uint8_t* flows, uint16_t* lens) {
+    uint8_t count = 0;
+    for (uint8_t i = s_bnep_tx_head; i != s_bnep_tx_tail; i = (i + 1) % TINYPAN_TX_QUEUE_LEN) {
+        flows[count] = s_bnep_tx_queue[i].flow;
+        lens[count] = bnep_tx_job_len(&s_bnep_tx_queue[i]);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Bring the job the scheduler picks to the head of the ring
+ *
+ * The jobs it passes move back one slot, so every bucket keeps its order.
+ * Must not run while the head job is in flight.
+ */
+static void bnep_fq_schedule(void) {
+    if (s_bnep_tx_queue[s_bnep_tx_head].scheduled) {
+        return;
+    }
+
+    uint8_t flows[TINYPAN_TX_QUEUE_LEN];
+    uint16_t lens[TINYPAN_TX_QUEUE_LEN];
+    uint8_t pick = tinypan_fq_pick(flows, lens, bnep_fq_snapshot(flows, lens));
+    if (pick == TINYPAN_FQ_NONE) {
+        return;
+    }
+    uint8_t slot = (s_bnep_tx_head + pick) % TINYPAN_TX_QUEUE_LEN;
+
+    bnep_tx_job_t picked = s_bnep_tx_queue[slot];
+    while (slot != s_bnep_tx_head) {
+        uint8_t prev = (slot + TINYPAN_TX_QUEUE_LEN - 1) % TINYPAN_TX_QUEUE_LEN;
+        s_bnep_tx_queue[slot] = s_bnep_tx_queue[prev];
+        slot = prev;
+    }
+    picked.scheduled = true;
+    s_bnep_tx_queue[s_bnep_tx_head] = picked;
+}
+#endif
+
+#if TINYPAN_ENABLE_FQ
+static uint16_t bnep_transport_tx_flow_room(void) {
+    uint8_t flows[TINYPAN_TX_QUEUE_LEN];
+    uint16_t lens[TINYPAN_TX_QUEUE_LEN];
+    hal_mutex_lock(s_bnep_tx_mutex);
+    uint8_t room = tinypan_fq_room(flows, bnep_fq_snapshot(flows, lens));
+    hal_mutex_unlock(s_bnep_tx_mutex);
+    return room;
+}
+#endif
+
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+static void bnep_transport_link_estimate(tinypan_link_estimate_t* estimate) {
+    hal_mutex_lock(s_bnep_tx_mutex);
+    tinypan_link_est_get(estimate);
+    hal_mutex_unlock(s_bnep_tx_mutex);
+}
+#endif
+
 /* Must be exposed to drain the BNEP tx queue */
 void bnep_transport_drain_tx_queue(void) {
     hal_mutex_lock(s_bnep_tx_mutex);
@@ -137,6 +334,12 @@ void bnep_transport_drain_tx_queue(void) {
     }
     
     if (s_bnep_tx_head == s_bnep_tx_tail) {
+#if TINYPAN_ENABLE_TX_BURST
+        tinypan_burst_drained();
+#endif
+#if TINYPAN_ENABLE_STALL_RECOVERY
+        tinypan_stall_queue_empty();
+#endif
         hal_mutex_unlock(s_bnep_tx_mutex);
         return;
     }
@@ -154,23 +357,34 @@ void bnep_transport_drain_tx_queue(void) {
              * TX_COMPLETE interrupt was lost (e.g. stack glitch or link drop), 
              * we must forcibly time out to reclaim memory. */
             uint32_t now = hal_get_tick_ms();
-            if (now - job->sent_at_ms > TINYPAN_BNEP_TX_TIMEOUT_MS) {
+            if (now - job->sent_at_ms > bnep_tx_timeout_ms()) {
                 TINYPAN_LOG_ERROR("transport_bnep: TX timeout (in_flight=%d, job=%p, p=%p)", 
                                    job->in_flight, (void*)job, (void*)job->p);
-                struct pbuf* q = job->p;
-                job->p = NULL;
-                job->in_flight = false;
-                /* FATAL: We cannot just slide the queue forward on a DMA timeout. 
-                 * We must tear down the entire link to safely cancel the hardware state. */
-                hal_bt_l2cap_disconnect();
-                if (q) pbuf_free(q);
+                if (bnep_tx_job_expired(job)) {
+                    continue; /* Send cancelled, next frame */
+                }
+                hal_mutex_unlock(s_bnep_tx_mutex);
+                tinypan_transport_tx_notify();
                 return; /* Stop draining until reconnection */
             }
             break; /* Packet still legitimately in flight */
         }
+
+#if TINYPAN_ENABLE_TX_BURST
+        if (!tinypan_burst_may_send()) {
+            break; /* tinypan_process() drains again when the hold expires */
+        }
+#endif
+#if TINYPAN_ENABLE_FQ
+        bnep_fq_schedule();
+#endif
         
         struct pbuf* q = job->p;
+        struct pbuf* iter = q;
         int result = 0;
+#if TINYPAN_ENABLE_PACING
+        bool admitted = false;
+#endif
         
         /* Convert to iovec array: 
          * iov[0] = Synthesized BNEP header
@@ -179,37 +393,46 @@ void bnep_transport_drain_tx_queue(void) {
         job->iov[0].iov_len = job->hdr_len;
         job->iov_count = 1;
 
-        /* Determine offset to skip the Ethernet header (typically 14 bytes) */
-        uint16_t skip_bytes = 14;
+#if TINYPAN_ENABLE_RAW_FRAMES
+        if (q == NULL) {
+            /* Raw frame: the payload follows the header as-is */
+            job->iov[1].iov_base = job->raw;
+            job->iov[1].iov_len = job->raw_len;
+            job->iov_count = 2;
+        } else
+#endif
+        {
+            /* Determine offset to skip the Ethernet header (typically 14 bytes) */
+            uint16_t skip_bytes = 14;
 
-        /* VLAN 802.1Q check: If the original header was 0x8100, we must 
-         * skip 18 bytes (14 header + 4 VLAN tag). */
-        uint8_t* eth_header;
+            /* VLAN 802.1Q check: If the original header was 0x8100, we must 
+             * skip 18 bytes (14 header + 4 VLAN tag). */
+            uint8_t* eth_header;
 #if defined(ETH_PAD_SIZE) && ETH_PAD_SIZE > 0
-        eth_header = (uint8_t*)q->payload + ETH_PAD_SIZE;
-        skip_bytes += ETH_PAD_SIZE;
+            eth_header = (uint8_t*)q->payload + ETH_PAD_SIZE;
+            skip_bytes += ETH_PAD_SIZE;
 #else
-        eth_header = (uint8_t*)q->payload;
+            eth_header = (uint8_t*)q->payload;
 #endif
-        if (eth_header[12] == 0x81 && eth_header[13] == 0x00) {
-            skip_bytes += 4;
-        }
+            if (eth_header[12] == 0x81 && eth_header[13] == 0x00) {
+                skip_bytes += 4;
+            }
 
-        struct pbuf* iter = q;
-        uint16_t max_iov = sizeof(job->iov) / sizeof(job->iov[0]);
-        while (iter != NULL && job->iov_count < max_iov) {
-            if (iter->len > 0) {
-                if (skip_bytes >= iter->len) {
-                    /* Entire pbuf is skipped */
-                    skip_bytes -= iter->len;
-                } else {
-                    job->iov[job->iov_count].iov_base = (const uint8_t*)iter->payload + skip_bytes;
-                    job->iov[job->iov_count].iov_len = iter->len - skip_bytes;
-                    job->iov_count++;
-                    skip_bytes = 0; /* Only skip in the first block(s) */
+            uint16_t max_iov = sizeof(job->iov) / sizeof(job->iov[0]);
+            while (iter != NULL && job->iov_count < max_iov) {
+                if (iter->len > 0) {
+                    if (skip_bytes >= iter->len) {
+                        /* Entire pbuf is skipped */
+                        skip_bytes -= iter->len;
+                    } else {
+                        job->iov[job->iov_count].iov_base = (const uint8_t*)iter->payload + skip_bytes;
+                        job->iov[job->iov_count].iov_len = iter->len - skip_bytes;
+                        job->iov_count++;
+                        skip_bytes = 0; /* Only skip in the first block(s) */
+                    }
                 }
+                iter = iter->next;
             }
-            iter = iter->next;
         }
         
         if (job->iov_count <= 1) {
@@ -221,6 +444,12 @@ void bnep_transport_drain_tx_queue(void) {
             TINYPAN_LOG_ERROR("transport_bnep: PBUF chain too long for iovec");
             result = -1;
         } else {
+#if TINYPAN_ENABLE_PACING
+            if (!tinypan_pacer_admit(bnep_tx_job_wire_len(job))) {
+                break; /* tinypan_process() drains again at the release time */
+            }
+            admitted = true;
+#endif
             hal_mutex_unlock(s_bnep_tx_mutex);
             result = hal_bt_l2cap_send_iovec(job->iov, job->iov_count);
             hal_mutex_lock(s_bnep_tx_mutex);
@@ -230,50 +459,75 @@ void bnep_transport_drain_tx_queue(void) {
             /* Success - HW DMA transfer initiated. Wait for complete event. */
             job->in_flight = true;
             job->sent_at_ms = hal_get_tick_ms();
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+            tinypan_link_est_started(job->queued_at_ms);
+#endif
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+            tinypan_tx_rto_started();
+#endif
+#if TINYPAN_ENABLE_TX_BURST
+            tinypan_burst_started();
+#endif
             break; /* Standard L2CAP serialization requires one packet at a time */
         } else if (result > 0) {
+#if TINYPAN_ENABLE_PACING
+            tinypan_pacer_refund(bnep_tx_job_wire_len(job));
+#endif
             hal_bt_l2cap_request_can_send_now();
             break;
         } else {
+#if TINYPAN_ENABLE_PACING
+            if (admitted) {
+                /* Never reached the air */
+                tinypan_pacer_refund(bnep_tx_job_wire_len(job));
+            }
+#endif
             /* Drop packet on hard failure */
             TINYPAN_LOG_ERROR("transport_bnep: Queue flush failed: %d", result);
-            job->p = NULL;
             s_bnep_tx_head = (s_bnep_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
-            pbuf_free(q);
+            bnep_tx_job_release(job);
         }
     }
+
+    if (s_bnep_tx_head == s_bnep_tx_tail) {
+#if TINYPAN_ENABLE_TX_BURST
+        tinypan_burst_drained();
+#endif
+#if TINYPAN_ENABLE_STALL_RECOVERY
+        tinypan_stall_queue_empty();
+#endif
+    }
     
     hal_mutex_unlock(s_bnep_tx_mutex);
+    tinypan_transport_tx_notify();
 }
 
 static void bnep_transport_process(void) {
     /* Periodic Garbage Collection: Reclaim timed-out pbufs even if no new traffic is arriving.
      * This prevents resource leaks if the hardware link stalls after enqueuing a packet. */
+    bool resume = false;
     hal_mutex_lock(s_bnep_tx_mutex);
     if (s_bnep_tx_head != s_bnep_tx_tail) {
         bnep_tx_job_t* job = &s_bnep_tx_queue[s_bnep_tx_head];
         if (job->in_flight) {
             uint32_t now = hal_get_tick_ms();
-            if (now - job->sent_at_ms > TINYPAN_BNEP_TX_TIMEOUT_MS) {
-                TINYPAN_LOG_ERROR("transport_bnep: TX cleanup timeout (job=%p)", (void*)job);
-                struct pbuf* q = job->p;
-                job->p = NULL;
-                job->in_flight = false;
-                /* Hardware/Link stall detected. Disconnect to request link termination.
-                 * Note: While this requests the Bluetooth controller to tear down the link,
-                 * it may not instantly stop an active DMA transfer. Advancing the queue
-                 * and freeing the buffer is still a potential race condition on some silicon,
-                 * but necessary to avoid permanent system stall. */
-                hal_bt_l2cap_disconnect();
-                
-                /* Update ring buffer head to reflect packet reclamation. */
-                s_bnep_tx_head = (s_bnep_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
-                
-                if (q) pbuf_free(q);
+            if (now - job->sent_at_ms > bnep_tx_timeout_ms()) {
+                TINYPAN_LOG_ERROR("transport_bnep: TX cleanup timeout (job=%p, %u ms)",
+                                  (void*)job, (unsigned)bnep_tx_timeout_ms());
+                resume = bnep_tx_job_expired(job);
             }
         }
     }
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    /* Under the TX lock, which covers every other update of the window */
+    tinypan_link_est_process();
+#endif
     hal_mutex_unlock(s_bnep_tx_mutex);
+    if (resume) {
+        bnep_transport_drain_tx_queue();
+        return;
+    }
+    tinypan_transport_tx_notify();
 }
 
 void bnep_transport_flush_tx_queue(void) {
@@ -289,14 +543,17 @@ void bnep_transport_flush_tx_queue(void) {
             break;
         }
 
-        if (job->p != NULL) {
-            pbuf_free(job->p);
-            job->p = NULL;
-        }
+        bnep_tx_job_release(job);
         job->in_flight = false;
         s_bnep_tx_head = (s_bnep_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
     }
+#if TINYPAN_ENABLE_TX_BURST
+    if (s_bnep_tx_head == s_bnep_tx_tail) {
+        tinypan_burst_drained();
+    }
+#endif
     hal_mutex_unlock(s_bnep_tx_mutex);
+    tinypan_transport_tx_notify();
 }
 
 static void bnep_transport_on_tx_complete(void) {
@@ -304,11 +561,18 @@ static void bnep_transport_on_tx_complete(void) {
     if (s_bnep_tx_head != s_bnep_tx_tail) {
         bnep_tx_job_t* job = &s_bnep_tx_queue[s_bnep_tx_head];
         if (job->in_flight) {
-            struct pbuf* q = job->p;
-            job->p = NULL;
             job->in_flight = false;
             s_bnep_tx_head = (s_bnep_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
-            if (q) pbuf_free(q);
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+            tinypan_link_est_completed(bnep_tx_job_wire_len(job), job->queued_at_ms);
+#endif
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+            tinypan_tx_rto_completed();
+#endif
+#if TINYPAN_ENABLE_STALL_RECOVERY
+            tinypan_stall_completed();
+#endif
+            bnep_tx_job_release(job);
             
             /* Process next packet */
             hal_mutex_unlock(s_bnep_tx_mutex);
@@ -354,14 +618,43 @@ static int bnep_transport_output(struct netif* netif, struct pbuf* p) {
 
     uint8_t bnep_hdr_len = bnep_get_ethernet_header_len(dst_addr, src_addr);
 
+#if TINYPAN_ENABLE_FQ || TINYPAN_ENABLE_TX_BURST
+    /* The L3 header follows the Ethernet header and any VLAN tag */
+    uint16_t l3_offset = (uint16_t)(eth_ptr - (uint8_t*)p->payload) + 14;
+    if (eth_ptr[12] == 0x81 && eth_ptr[13] == 0x00) {
+        l3_offset += 4;
+    }
+    uint8_t l3[TINYPAN_TX_PEEK_LEN];
+    uint16_t l3_len = pbuf_copy_partial(p, l3, sizeof(l3), l3_offset);
+#endif
+#if TINYPAN_ENABLE_FQ
+    uint8_t flow = tinypan_fq_classify(ethertype, l3, l3_len);
+#endif
+#if TINYPAN_ENABLE_TX_BURST
+    bool urgent = tinypan_burst_urgent(ethertype, l3, l3_len);
+#endif
+
     /* Enqueue the job */
     hal_mutex_lock(s_bnep_tx_mutex);
     uint8_t next_tail = (s_bnep_tx_tail + 1) % TINYPAN_TX_QUEUE_LEN;
     if (next_tail == s_bnep_tx_head) {
         /* Queue full, report backpressure */
+        tinypan_transport_tx_refused();
+        hal_mutex_unlock(s_bnep_tx_mutex);
+        tinypan_transport_tx_notify();
+        return ERR_MEM;
+    }
+#if TINYPAN_ENABLE_FQ
+    uint8_t flows[TINYPAN_TX_QUEUE_LEN];
+    uint16_t lens[TINYPAN_TX_QUEUE_LEN];
+    if (!tinypan_fq_admit(flows, bnep_fq_snapshot(flows, lens), flow)) {
+        /* This flow has its share; the queue stays open to the others */
+        tinypan_transport_tx_refused();
         hal_mutex_unlock(s_bnep_tx_mutex);
+        tinypan_transport_tx_notify();
         return ERR_MEM;
     }
+#endif
     
     bnep_tx_job_t* job = &s_bnep_tx_queue[s_bnep_tx_tail];
     pbuf_ref(p);
@@ -369,17 +662,98 @@ static int bnep_transport_output(struct netif* netif, struct pbuf* p) {
     job->hdr_len = bnep_hdr_len;
     job->in_flight = false;
     job->sent_at_ms = 0;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    job->queued_at_ms = hal_get_tick_ms();
+#endif
+#if TINYPAN_ENABLE_FQ
+    job->flow = flow;
+    job->scheduled = false;
+#endif
     bnep_write_ethernet_header(job->hdr, bnep_hdr_len, dst_addr, src_addr, ethertype);
     
     s_bnep_tx_tail = next_tail;
+    tinypan_transport_tx_enqueued(p->tot_len);
+#if TINYPAN_ENABLE_TX_BURST
+    tinypan_burst_queued(urgent || (s_bnep_tx_tail + 1) % TINYPAN_TX_QUEUE_LEN == s_bnep_tx_head);
+#endif
     hal_mutex_unlock(s_bnep_tx_mutex);
 
     /* Signal the HAL. The application polling thread will drain the queue
      * via bnep_transport_drain_tx_queue() on the next CAN_SEND_NOW event. */
     hal_bt_l2cap_request_can_send_now();
+    tinypan_transport_tx_notify();
     
     return ERR_OK;
 }
+
+#if TINYPAN_ENABLE_RAW_FRAMES
+static int bnep_transport_send_frame(const uint8_t* dst_addr, uint16_t ethertype, const void* payload,
+                                     uint16_t len, tinypan_tx_done_callback_t done, void* user_data) {
+    if (!bnep_is_connected()) {
+        return TINYPAN_ERR_NOT_STARTED;
+    }
+    if (dst_addr == NULL) {
+        dst_addr = bnep_get_remote_addr();
+    }
+    const uint8_t* src_addr = bnep_get_local_addr();
+    uint8_t bnep_hdr_len = bnep_get_ethernet_header_len(dst_addr, src_addr);
+#if TINYPAN_ENABLE_FQ
+    uint8_t flow = tinypan_fq_classify(ethertype, (const uint8_t*)payload, len);
+#endif
+#if TINYPAN_ENABLE_TX_BURST
+    bool urgent = tinypan_burst_urgent(ethertype, (const uint8_t*)payload, len);
+#endif
+
+    /* Same queue as lwIP's frames, so the two stay in submission order */
+    hal_mutex_lock(s_bnep_tx_mutex);
+    uint8_t next_tail = (s_bnep_tx_tail + 1) % TINYPAN_TX_QUEUE_LEN;
+    if (next_tail == s_bnep_tx_head) {
+        tinypan_transport_tx_refused();
+        hal_mutex_unlock(s_bnep_tx_mutex);
+        tinypan_transport_tx_notify();
+        return TINYPAN_ERR_BUSY;
+    }
+#if TINYPAN_ENABLE_FQ
+    uint8_t flows[TINYPAN_TX_QUEUE_LEN];
+    uint16_t lens[TINYPAN_TX_QUEUE_LEN];
+    if (!tinypan_fq_admit(flows, bnep_fq_snapshot(flows, lens), flow)) {
+        tinypan_transport_tx_refused();
+        hal_mutex_unlock(s_bnep_tx_mutex);
+        tinypan_transport_tx_notify();
+        return TINYPAN_ERR_BUSY;
+    }
+#endif
+
+    bnep_tx_job_t* job = &s_bnep_tx_queue[s_bnep_tx_tail];
+    job->p = NULL;
+    job->raw = (const uint8_t*)payload;
+    job->raw_len = len;
+    job->done = done;
+    job->done_arg = user_data;
+    job->hdr_len = bnep_hdr_len;
+    job->in_flight = false;
+    job->sent_at_ms = 0;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    job->queued_at_ms = hal_get_tick_ms();
+#endif
+#if TINYPAN_ENABLE_FQ
+    job->flow = flow;
+    job->scheduled = false;
+#endif
+    bnep_write_ethernet_header(job->hdr, bnep_hdr_len, dst_addr, src_addr, ethertype);
+
+    s_bnep_tx_tail = next_tail;
+    tinypan_transport_tx_enqueued(len);
+#if TINYPAN_ENABLE_TX_BURST
+    tinypan_burst_queued(urgent || (s_bnep_tx_tail + 1) % TINYPAN_TX_QUEUE_LEN == s_bnep_tx_head);
+#endif
+    hal_mutex_unlock(s_bnep_tx_mutex);
+
+    hal_bt_l2cap_request_can_send_now();
+    tinypan_transport_tx_notify();
+    return TINYPAN_OK;
+}
+#endif
 #endif
 
 const tinypan_transport_t transport_bnep = {
@@ -389,13 +763,23 @@ const tinypan_transport_t transport_bnep = {
     .on_connected = bnep_transport_on_connected,
     .on_disconnected = bnep_transport_on_disconnected,
     .handle_incoming = bnep_transport_handle_incoming,
+    .handle_incoming_direct = bnep_transport_handle_incoming_direct,
     .retry_setup = bnep_transport_retry_setup,
     .on_can_send_now = bnep_transport_on_can_send_now,
     .on_tx_complete = bnep_transport_on_tx_complete,
     .flush_queues = bnep_transport_flush_tx_queue,
     .process = bnep_transport_process,
 #if TINYPAN_ENABLE_LWIP
-    .output = bnep_transport_output
+    .output = bnep_transport_output,
+#if TINYPAN_ENABLE_RAW_FRAMES
+    .send_frame = bnep_transport_send_frame,
+#endif
+#if TINYPAN_ENABLE_FQ
+    .tx_flow_room = bnep_transport_tx_flow_room,
+#endif
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    .link_estimate = bnep_transport_link_estimate,
+#endif
 #endif
 };
 
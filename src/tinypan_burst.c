@@ -0,0 +1,168 @@
+/*
+ * TinyPAN TX Bursts
+ *
+ * Three states. IDLE: the queue is empty. HOLDING: non-urgent frames wait
+ * for the release time the HAL chose within TINYPAN_TX_BURST_HOLD_MS.
+ * OPEN: the drain loop sends everything queued, including frames that
+ * arrive meanwhile, until the queue is empty again. The radio thus wakes
+ * once per burst rather than once per frame, at the price of up to one
+ * hold of latency for traffic nobody is waiting on.
+ */
+
+#include "tinypan_burst.h"
+
+#if TINYPAN_ENABLE_TX_BURST
+
+#include "../include/tinypan_hal.h"
+#include <string.h>
+
+#define BURST_IDLE      0
+#define BURST_HOLDING   1
+#define BURST_OPEN      2
+
+static volatile uint8_t s_state = BURST_IDLE;
+static volatile uint32_t s_release_ms = 0;
+static uint32_t s_burst_frames = 0;     /* Frames started in the open burst */
+static bool s_urgent_open = false;      /* The open burst was opened by an urgent frame */
+
+/* Idle hint wanted by the TX path and the last one the HAL was given */
+static volatile bool s_link_idle = true;
+static bool s_hinted_idle = true;
+
+static tinypan_tx_burst_stats_t s_stats;
+static uint32_t s_start_ms = 0;
+
+static void burst_open(bool urgent) {
+    s_state = BURST_OPEN;
+    s_burst_frames = 0;
+    s_urgent_open = urgent;
+    s_link_idle = false;
+}
+
+void tinypan_burst_reset(void) {
+    s_state = BURST_IDLE;
+    s_release_ms = 0;
+    s_burst_frames = 0;
+    s_urgent_open = false;
+    s_link_idle = true;
+    s_hinted_idle = true;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_start_ms = hal_get_tick_ms();
+}
+
+bool tinypan_burst_urgent(uint16_t ethertype, const uint8_t* l3, uint16_t len) {
+    if (ethertype == 0x0806) {
+        return true;
+    }
+
+    if (ethertype == 0x0800 && len >= 20 && (l3[0] >> 4) == 4) {
+        uint16_t ihl = (uint16_t)((l3[0] & 0x0F) * 4);
+        uint16_t total = (uint16_t)((l3[2] << 8) | l3[3]);
+        if (((l3[6] & 0x1F) | l3[7]) != 0) {
+            return false; /* Non-first fragment: no L4 header */
+        }
+        if (l3[9] == 6 && len >= ihl + 13) {
+            uint16_t doff = (uint16_t)((l3[ihl + 12] >> 4) * 4);
+            return total <= ihl + doff;
+        }
+        if (l3[9] == 17 && len >= ihl + 4) {
+            uint16_t sport = (uint16_t)((l3[ihl] << 8) | l3[ihl + 1]);
+            uint16_t dport = (uint16_t)((l3[ihl + 2] << 8) | l3[ihl + 3]);
+            return (sport == 67 || sport == 68) && (dport == 67 || dport == 68);
+        }
+        return false;
+    }
+
+    if (ethertype == 0x86DD && len >= 40 && (l3[0] >> 4) == 6) {
+        uint16_t payload = (uint16_t)((l3[4] << 8) | l3[5]);
+        if (l3[6] == 58) {
+            return true;
+        }
+        if (l3[6] == 6 && len >= 53) {
+            uint16_t doff = (uint16_t)((l3[52] >> 4) * 4);
+            return payload <= doff;
+        }
+        if (l3[6] == 17 && len >= 44) {
+            uint16_t dport = (uint16_t)((l3[42] << 8) | l3[43]);
+            return dport == 546 || dport == 547;
+        }
+    }
+    return false;
+}
+
+void tinypan_burst_queued(bool urgent) {
+    if (s_state == BURST_OPEN) {
+        return; /* Joins the burst in progress */
+    }
+    if (urgent) {
+        burst_open(true);
+        return;
+    }
+    if (s_state == BURST_IDLE) {
+        uint32_t delay = hal_bt_tx_burst_delay_ms(TINYPAN_TX_BURST_HOLD_MS);
+        if (delay > TINYPAN_TX_BURST_HOLD_MS) {
+            delay = TINYPAN_TX_BURST_HOLD_MS;
+        }
+        s_release_ms = hal_get_tick_ms() + delay;
+        s_state = BURST_HOLDING;
+    }
+}
+
+bool tinypan_burst_may_send(void) {
+    if (s_state == BURST_HOLDING && (int32_t)(hal_get_tick_ms() - s_release_ms) >= 0) {
+        burst_open(false);
+    }
+    return s_state != BURST_HOLDING;
+}
+
+void tinypan_burst_started(void) {
+    s_burst_frames++;
+}
+
+void tinypan_burst_drained(void) {
+    if (s_state == BURST_OPEN && s_burst_frames > 0) {
+        s_stats.bursts++;
+        s_stats.frames += s_burst_frames;
+        if (s_urgent_open) {
+            s_stats.urgent_bursts++;
+        }
+        if (s_burst_frames > s_stats.max_burst_frames) {
+            s_stats.max_burst_frames = s_burst_frames;
+        }
+    }
+    s_state = BURST_IDLE;
+    s_burst_frames = 0;
+    s_link_idle = true;
+}
+
+bool tinypan_burst_process(void) {
+    bool due = s_state == BURST_HOLDING && (int32_t)(hal_get_tick_ms() - s_release_ms) >= 0;
+
+    /* Busy ahead of a released hold, so the HAL can wake the link for it. A
+     * burst opened and finished between two calls goes unreported: the
+     * link was idle before and is idle again. */
+    bool idle = s_link_idle && !due;
+    if (idle != s_hinted_idle) {
+        s_hinted_idle = idle;
+        hal_bt_set_link_idle(idle);
+    }
+    return due;
+}
+
+uint32_t tinypan_burst_next_ms(void) {
+    if (s_link_idle && !s_hinted_idle) {
+        return 0;
+    }
+    if (s_state != BURST_HOLDING) {
+        return 0xFFFFFFFF;
+    }
+    int32_t left = (int32_t)(s_release_ms - hal_get_tick_ms());
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+void tinypan_burst_get_stats(tinypan_tx_burst_stats_t* stats) {
+    *stats = s_stats;
+    stats->elapsed_ms = hal_get_tick_ms() - s_start_ms;
+}
+
+#endif /* TINYPAN_ENABLE_TX_BURST */
@@ -0,0 +1,86 @@
+/*
+ * TinyPAN TX Bursts - Internal Header
+ *
+ * Holds non-urgent frames in the BNEP and SLIP TX queues so they leave
+ * together (TINYPAN_ENABLE_TX_BURST). The transports report each queued
+ * frame and ask before starting the next one; tinypan.c re-runs the drain
+ * when a hold expires and passes idle/busy hints on to the HAL.
+ */
+
+#ifndef TINYPAN_BURST_H
+#define TINYPAN_BURST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Forget any hold and clear the statistics
+ */
+void tinypan_burst_reset(void);
+
+/**
+ * @brief Must the frame go out without waiting for a burst?
+ *
+ * ARP, IPv6 neighbour discovery (all of ICMPv6), TCP segments without
+ * payload, and DHCP/DHCPv6.
+ *
+ * @param ethertype Ethertype of the frame
+ * @param l3        Start of the L3 header
+ * @param len       Bytes available at l3
+ */
+bool tinypan_burst_urgent(uint16_t ethertype, const uint8_t* l3, uint16_t len);
+
+/**
+ * @brief A frame joined the TX queue (under the transport's TX lock)
+ *
+ * The first non-urgent frame starts a hold; an urgent frame opens the burst.
+ *
+ * @param urgent The frame must not wait, or the queue is now full
+ */
+void tinypan_burst_queued(bool urgent);
+
+/**
+ * @brief May the drain loop start the next frame?
+ *
+ * Opens the burst once the hold has expired.
+ */
+bool tinypan_burst_may_send(void);
+
+/**
+ * @brief A frame was handed to the link
+ */
+void tinypan_burst_started(void);
+
+/**
+ * @brief The TX queue is empty: the burst, if any, is over
+ */
+void tinypan_burst_drained(void);
+
+/**
+ * @brief Deliver pending link idle hints (from tinypan_process())
+ * @return true if an expired hold is waiting for the drain loop
+ */
+bool tinypan_burst_process(void);
+
+/**
+ * @brief Milliseconds until tinypan_burst_process() has work
+ * @return 0 if due now, 0xFFFFFFFF if nothing is held
+ */
+uint32_t tinypan_burst_next_ms(void);
+
+/**
+ * @brief Statistics since tinypan_burst_reset()
+ */
+void tinypan_burst_get_stats(tinypan_tx_burst_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_BURST_H */
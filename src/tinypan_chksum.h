@@ -0,0 +1,51 @@
+/*
+ * TinyPAN Internet Checksum - Internal Header
+ *
+ * RFC 1071 one's complement sum used by lwIP through LWIP_CHKSUM (and
+ * LWIP_CHKSUM_COPY), see lwipopts.h. Pure byte-buffer code with no lwIP
+ * dependency, so it can be tested and benchmarked on the host.
+ */
+
+#ifndef TINYPAN_CHKSUM_H
+#define TINYPAN_CHKSUM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One's complement sum of a buffer, not inverted
+ *
+ * Drop-in for lwip_standard_chksum(): same result for any length and any
+ * start address. The sum is accumulated a machine word at a time (64-bit
+ * loads where pointers are 64 bits wide, 32-bit loads otherwise) into a
+ * 64-bit accumulator and folded once at the end. Odd start addresses, as
+ * produced by ETH_PAD_SIZE, are handled by summing from the next word
+ * boundary and swapping the bytes of the result.
+ *
+ * @param dataptr Data to sum
+ * @param len     Length in bytes
+ * @return Sum in network byte order, as stored in a header
+ */
+uint16_t tinypan_chksum(const void* dataptr, int len);
+
+/**
+ * @brief Copy a buffer and return its tinypan_chksum() in the same pass
+ *
+ * Fused when source and destination share their word alignment,
+ * otherwise a memcpy() followed by a sum over the (now cached) copy.
+ *
+ * @param dst Destination (must not overlap src)
+ * @param src Source
+ * @param len Length in bytes
+ * @return Sum of the copied data, as tinypan_chksum()
+ */
+uint16_t tinypan_chksum_copy(void* dst, const void* src, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_CHKSUM_H */
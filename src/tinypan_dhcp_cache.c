@@ -0,0 +1,220 @@
+/*
+ * TinyPAN DHCP Lease Cache
+ *
+ * Small table of leases keyed by NAP address. The table itself does not
+ * depend on lwIP; tinypan_lwip_netif.c feeds it from the DHCP client and
+ * decides how to use a hit.
+ */
+
+#include "tinypan_dhcp_cache.h"
+
+#include <string.h>
+
+#if TINYPAN_DHCP_CACHE_ENTRIES < 1 || TINYPAN_DHCP_CACHE_ENTRIES > 16
+#error "TINYPAN_DHCP_CACHE_ENTRIES must be between 1 and 16"
+#endif
+
+/** DHCP "infinite" lease time */
+#define DHCP_LEASE_INFINITE     0xFFFFFFFFUL
+
+/** Longest lease tracked against the 32-bit tick counter (about 23 days) */
+#define DHCP_LEASE_MAX_MS       2000000000UL
+
+/* ============================================================================
+ * State
+ * ============================================================================ */
+
+static dhcp_cache_lease_t s_entries[TINYPAN_DHCP_CACHE_ENTRIES];
+static uint32_t s_stamp[TINYPAN_DHCP_CACHE_ENTRIES];    /**< 0 = empty slot */
+static uint32_t s_clock = 0;
+
+#if TINYPAN_DHCP_CACHE_PERSIST
+static const uint8_t s_blob_magic[4] = { 'T', 'P', 'L', 1 };
+#endif
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static int cache_find(const uint8_t peer[HAL_BD_ADDR_LEN]) {
+    for (int i = 0; i < TINYPAN_DHCP_CACHE_ENTRIES; i++) {
+        if (s_stamp[i] != 0 && memcmp(s_entries[i].peer, peer, HAL_BD_ADDR_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if TINYPAN_DHCP_CACHE_PERSIST
+static void put_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Blob: magic[4], then one 30-byte record per slot, newest first:
+ * peer[6] ip[4] netmask[4] gateway[4] dns[4] server_id[4] lease_s[4].
+ * Empty slots are all zero.
+ */
+static void cache_save(void) {
+    uint8_t blob[DHCP_CACHE_BLOB_LEN];
+    uint8_t* p = blob + sizeof(s_blob_magic);
+    bool used[TINYPAN_DHCP_CACHE_ENTRIES] = { false };
+
+    memset(blob, 0, sizeof(blob));
+    memcpy(blob, s_blob_magic, sizeof(s_blob_magic));
+    for (int n = 0; n < TINYPAN_DHCP_CACHE_ENTRIES; n++) {
+        int newest = -1;
+        for (int i = 0; i < TINYPAN_DHCP_CACHE_ENTRIES; i++) {
+            if (!used[i] && s_stamp[i] != 0 && (newest < 0 || s_stamp[i] > s_stamp[newest])) {
+                newest = i;
+            }
+        }
+        if (newest < 0) break;
+        used[newest] = true;
+
+        const dhcp_cache_lease_t* e = &s_entries[newest];
+        memcpy(p, e->peer, HAL_BD_ADDR_LEN);
+        put_be32(p + 6, e->ip_addr);
+        put_be32(p + 10, e->netmask);
+        put_be32(p + 14, e->gateway);
+        put_be32(p + 18, e->dns_server);
+        put_be32(p + 22, e->server_id);
+        put_be32(p + 26, e->lease_s);
+        p += DHCP_CACHE_ENTRY_LEN;
+    }
+
+    if (hal_storage_save(blob, sizeof(blob)) < 0) {
+        TINYPAN_LOG_WARN("DHCP cache: Failed to persist leases");
+    }
+}
+
+static void cache_load(void) {
+    uint8_t blob[DHCP_CACHE_BLOB_LEN];
+    int len = hal_storage_load(blob, sizeof(blob));
+    if (len < (int)sizeof(s_blob_magic) || memcmp(blob, s_blob_magic, sizeof(s_blob_magic)) != 0) {
+        return;
+    }
+
+    int records = (len - (int)sizeof(s_blob_magic)) / DHCP_CACHE_ENTRY_LEN;
+    int count = 0;
+    const uint8_t* p = blob + sizeof(s_blob_magic);
+    for (int i = 0; i < records; i++, p += DHCP_CACHE_ENTRY_LEN) {
+        dhcp_cache_lease_t* e = &s_entries[i];
+        memcpy(e->peer, p, HAL_BD_ADDR_LEN);
+        e->ip_addr = get_be32(p + 6);
+        e->netmask = get_be32(p + 10);
+        e->gateway = get_be32(p + 14);
+        e->dns_server = get_be32(p + 18);
+        e->server_id = get_be32(p + 22);
+        e->lease_s = get_be32(p + 26);
+        e->bound_ms = 0;
+        e->timed = false;
+        if (e->ip_addr == 0) {
+            memset(e, 0, sizeof(*e));
+            break;
+        }
+        count++;
+    }
+    /* Newest record first: give it the highest stamp */
+    for (int i = 0; i < count; i++) {
+        s_stamp[i] = (uint32_t)(count - i);
+    }
+    s_clock = (uint32_t)count;
+    TINYPAN_LOG_INFO("DHCP cache: Restored %d lease(s) from storage", count);
+}
+#endif /* TINYPAN_DHCP_CACHE_PERSIST */
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+void dhcp_cache_init(void) {
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(s_stamp, 0, sizeof(s_stamp));
+    s_clock = 0;
+#if TINYPAN_DHCP_CACHE_PERSIST
+    cache_load();
+#endif
+}
+
+dhcp_cache_result_t dhcp_cache_lookup(const uint8_t peer[HAL_BD_ADDR_LEN], dhcp_cache_lease_t* lease) {
+    int i = cache_find(peer);
+    if (i < 0) {
+        return DHCP_CACHE_MISS;
+    }
+
+    const dhcp_cache_lease_t* e = &s_entries[i];
+    if (lease != NULL) {
+        *lease = *e;
+    }
+    if (!e->timed) {
+        return DHCP_CACHE_REBOOT;
+    }
+    if (e->lease_s == DHCP_LEASE_INFINITE) {
+        return DHCP_CACHE_VALID;
+    }
+
+    uint32_t lease_ms = (e->lease_s > DHCP_LEASE_MAX_MS / 1000) ? DHCP_LEASE_MAX_MS : e->lease_s * 1000;
+    uint32_t elapsed = hal_get_tick_ms() - e->bound_ms;
+    if (elapsed >= lease_ms) {
+        /* Expired: RFC 2131 does not allow INIT-REBOOT with it any more */
+        TINYPAN_LOG_INFO("DHCP cache: Lease for this NAP expired");
+        s_stamp[i] = 0;
+        return DHCP_CACHE_MISS;
+    }
+    if ((lease_ms - elapsed) / 1000 < TINYPAN_DHCP_CACHE_MIN_REMAINING_S) {
+        return DHCP_CACHE_REBOOT;
+    }
+    return DHCP_CACHE_VALID;
+}
+
+void dhcp_cache_store(const dhcp_cache_lease_t* lease) {
+    if (lease == NULL || lease->ip_addr == 0) {
+        return;
+    }
+
+    int i = cache_find(lease->peer);
+    bool changed = true;
+    if (i >= 0) {
+        const dhcp_cache_lease_t* e = &s_entries[i];
+        changed = e->ip_addr != lease->ip_addr || e->netmask != lease->netmask ||
+                  e->gateway != lease->gateway || e->dns_server != lease->dns_server ||
+                  e->server_id != lease->server_id || e->lease_s != lease->lease_s;
+    } else {
+        /* Free slot, or the least recently stored lease */
+        i = 0;
+        for (int j = 1; j < TINYPAN_DHCP_CACHE_ENTRIES; j++) {
+            if (s_stamp[j] < s_stamp[i]) i = j;
+        }
+    }
+
+    s_entries[i] = *lease;
+    s_stamp[i] = ++s_clock;
+
+#if TINYPAN_DHCP_CACHE_PERSIST
+    /* Renewals of an unchanged lease only refresh the timing: no flash write */
+    if (changed) {
+        cache_save();
+    }
+#else
+    (void)changed;
+#endif
+}
+
+void dhcp_cache_invalidate(const uint8_t peer[HAL_BD_ADDR_LEN]) {
+    int i = cache_find(peer);
+    if (i < 0) {
+        return;
+    }
+    s_stamp[i] = 0;
+#if TINYPAN_DHCP_CACHE_PERSIST
+    cache_save();
+#endif
+}
@@ -0,0 +1,89 @@
+/*
+ * TinyPAN DHCP Lease Cache - Internal Header
+ *
+ * Remembers the last DHCP lease per NAP Bluetooth address so a reconnect can
+ * use INIT-REBOOT (RFC 2131 section 3.2) instead of a full DISCOVER/OFFER/
+ * REQUEST/ACK exchange, or skip DHCP entirely while the lease is still valid.
+ */
+
+#ifndef TINYPAN_DHCP_CACHE_H
+#define TINYPAN_DHCP_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Serialized size of one cache entry (see dhcp_cache_init()) */
+#define DHCP_CACHE_ENTRY_LEN    30
+
+/** Serialized size of the whole cache blob passed to hal_storage_save() */
+#define DHCP_CACHE_BLOB_LEN     (4 + TINYPAN_DHCP_CACHE_ENTRIES * DHCP_CACHE_ENTRY_LEN)
+
+/**
+ * @brief A remembered lease. Addresses are in network byte order.
+ */
+typedef struct {
+    uint8_t  peer[HAL_BD_ADDR_LEN]; /**< NAP the lease was obtained from */
+    uint32_t ip_addr;
+    uint32_t netmask;
+    uint32_t gateway;
+    uint32_t dns_server;            /**< 0 if the NAP supplied none */
+    uint32_t server_id;             /**< DHCP server identifier (option 54) */
+    uint32_t lease_s;               /**< Lease time granted by the server */
+    uint32_t bound_ms;              /**< hal_get_tick_ms() when bound */
+    bool     timed;                 /**< bound_ms is meaningful (false after a reboot) */
+} dhcp_cache_lease_t;
+
+/**
+ * @brief What a cached lease may be used for
+ */
+typedef enum {
+    DHCP_CACHE_MISS = 0,    /**< Nothing usable: run a full DHCP exchange */
+    DHCP_CACHE_REBOOT,      /**< Address known, validity unknown: INIT-REBOOT */
+    DHCP_CACHE_VALID        /**< Lease still valid: the address may be used at once */
+} dhcp_cache_result_t;
+
+/**
+ * @brief Reset the cache and, with TINYPAN_DHCP_CACHE_PERSIST, reload it
+ *        from hal_storage_load()
+ *
+ * Reloaded entries lose their timing (the tick counter restarted), so they
+ * are only good for INIT-REBOOT.
+ */
+void dhcp_cache_init(void);
+
+/**
+ * @brief Look up the lease for a NAP
+ *
+ * Expired entries are dropped. An entry whose lease has less than
+ * TINYPAN_DHCP_CACHE_MIN_REMAINING_S left is downgraded to DHCP_CACHE_REBOOT.
+ *
+ * @param peer  NAP Bluetooth address
+ * @param lease [out] Copy of the entry (may be NULL)
+ * @return How the lease may be used
+ */
+dhcp_cache_result_t dhcp_cache_lookup(const uint8_t peer[HAL_BD_ADDR_LEN], dhcp_cache_lease_t* lease);
+
+/**
+ * @brief Remember a freshly bound (or renewed) lease
+ *
+ * Replaces the entry for the same NAP, otherwise the least recently stored
+ * one. Persists the cache if the address information changed.
+ */
+void dhcp_cache_store(const dhcp_cache_lease_t* lease);
+
+/**
+ * @brief Forget the lease for a NAP (after a NAK or a failed INIT-REBOOT)
+ */
+void dhcp_cache_invalidate(const uint8_t peer[HAL_BD_ADDR_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_DHCP_CACHE_H */
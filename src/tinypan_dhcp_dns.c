@@ -0,0 +1,84 @@
+/*
+ * TinyPAN DHCP DNS Server Capture
+ *
+ * lwIP hooks that stand in for LWIP_DHCP_PROVIDE_DNS_SERVERS while lwIP's
+ * own resolver is compiled out. See tinypan_dhcp_dns.h.
+ */
+
+#include "tinypan_dhcp_dns.h"
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/prot/dhcp.h"
+
+#include <string.h>
+
+/** DNS server from the last ACK (network byte order, 0 = none) */
+static uint32_t s_dns_server = 0;
+
+/**
+ * @brief Only tp0 is ours when lwIP is shared with other interfaces
+ */
+static int is_tinypan_netif(const struct netif* netif) {
+    return netif != NULL && netif->name[0] == 't' && netif->name[1] == 'p';
+}
+
+void tinypan_dhcp_parse_option(struct netif* netif, uint8_t msg_type, uint8_t option,
+                               uint8_t len, struct pbuf* p, uint16_t offset) {
+    /* msg_type is 0 when option 53 comes later in the message */
+    if (option != DHCP_OPTION_DNS_SERVER || len < 4 ||
+        (msg_type != 0 && msg_type != DHCP_ACK) || !is_tinypan_netif(netif)) {
+        return;
+    }
+
+    /* First server only; the value is copied as-is, so it stays in network order */
+    uint32_t dns_server;
+    if (pbuf_copy_partial(p, &dns_server, sizeof(dns_server), offset) == sizeof(dns_server)) {
+        s_dns_server = dns_server;
+    }
+}
+
+void tinypan_dhcp_append_options(struct netif* netif, struct dhcp_msg* msg, uint16_t* options_len) {
+    if (!is_tinypan_netif(netif)) {
+        return;
+    }
+
+    uint8_t* options = msg->options;
+    uint16_t end = *options_len;
+    uint16_t pos = 0;
+    uint16_t last = end;
+
+    while (pos < end) {
+        if (options[pos] == DHCP_OPTION_PAD) {
+            pos++;
+            continue;
+        }
+        if (pos + 1 >= end) {
+            return;
+        }
+        last = pos;
+        pos = (uint16_t)(pos + 2 + options[pos + 1]);
+    }
+
+    /* lwIP writes the parameter request list last (before this hook), so it
+     * can grow in place. Leave room for the END option. */
+    if (pos != end || last == end || options[last] != DHCP_OPTION_PARAMETER_REQUEST_LIST ||
+        options[last + 1] == 0xFF || (uint32_t)end + 2 > DHCP_OPTIONS_LEN) {
+        return;
+    }
+    if (memchr(&options[last + 2], DHCP_OPTION_DNS_SERVER, options[last + 1]) != NULL) {
+        return;
+    }
+    options[end] = DHCP_OPTION_DNS_SERVER;
+    options[last + 1]++;
+    *options_len = (uint16_t)(end + 1);
+}
+
+uint32_t tinypan_dhcp_dns_get(void) {
+    return s_dns_server;
+}
+
+void tinypan_dhcp_dns_set(uint32_t dns_server) {
+    s_dns_server = dns_server;
+}
@@ -0,0 +1,67 @@
+/*
+ * TinyPAN DHCP DNS Server Capture - Internal Header
+ *
+ * lwIP only parses the DHCP DNS server option (6) when LWIP_DNS is on, and
+ * TinyPAN builds lwIP without its resolver. lwipopts.h routes lwIP's DHCP
+ * hooks here instead: the option is requested in every DISCOVER/REQUEST and
+ * the first server from the ACK is kept for tinypan_ip_info_t.
+ *
+ * Built into the lwIP library (like tinypan_chksum.c) because lwIP's DHCP
+ * client calls it.
+ */
+
+#ifndef TINYPAN_DHCP_DNS_H
+#define TINYPAN_DHCP_DNS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct netif;
+struct dhcp_msg;
+struct pbuf;
+
+/**
+ * @brief LWIP_HOOK_DHCP_PARSE_OPTION: called for options lwIP does not parse
+ *
+ * @param netif    Interface the message arrived on
+ * @param msg_type DHCP message type (option 53), 0 if not seen yet
+ * @param option   Option code
+ * @param len      Option length
+ * @param p        pbuf holding the option
+ * @param offset   Offset of the option value in p
+ */
+void tinypan_dhcp_parse_option(struct netif* netif, uint8_t msg_type, uint8_t option,
+                               uint8_t len, struct pbuf* p, uint16_t offset);
+
+/**
+ * @brief LWIP_HOOK_DHCP_APPEND_OPTIONS: add the DNS server option to the
+ *        parameter request list of an outgoing message
+ *
+ * @param netif       Interface the message is sent on
+ * @param msg         Message being built
+ * @param options_len [in/out] Bytes of msg->options used so far
+ */
+void tinypan_dhcp_append_options(struct netif* netif, struct dhcp_msg* msg, uint16_t* options_len);
+
+/**
+ * @brief DNS server from the last DHCP ACK on tp0
+ * @return Address in network byte order, 0 if none
+ */
+uint32_t tinypan_dhcp_dns_get(void);
+
+/**
+ * @brief Replace the captured DNS server (0 forgets it)
+ *
+ * Used when DHCP restarts, and to restore the server of a cached lease that
+ * is applied before the NAP confirms it.
+ */
+void tinypan_dhcp_dns_set(uint32_t dns_server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_DHCP_DNS_H */
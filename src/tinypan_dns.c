@@ -0,0 +1,753 @@
+/*
+ * TinyPAN Resolver Cache
+ *
+ * One A query per name in flight, and a table of answers keyed by name.
+ * Each query goes out from a socket on a fresh random port, so an answer
+ * is only taken if it reaches the port and carries the ID of a query in
+ * flight there. Positive answers live for the smallest TTL in the answer
+ * (capped), negative ones for the SOA's negative TTL (RFC 2308 section 5,
+ * capped). An entry that was looked up during its lifetime is queried again
+ * shortly before it expires, so a name in steady use is always a hit.
+ */
+
+#include "tinypan_dns.h"
+
+#if TINYPAN_ENABLE_DNS_CACHE
+
+#include "../include/tinypan_hal.h"
+
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/ip4_addr.h"
+
+#include <string.h>
+
+#if TINYPAN_DNS_CACHE_SIZE < 1 || TINYPAN_DNS_CACHE_SIZE > 16
+#error "TINYPAN_DNS_CACHE_SIZE must be between 1 and 16"
+#endif
+
+#if TINYPAN_DNS_MAX_NAME_LEN < 1 || TINYPAN_DNS_MAX_NAME_LEN > 253
+#error "TINYPAN_DNS_MAX_NAME_LEN must be between 1 and 253"
+#endif
+
+#if TINYPAN_DNS_MAX_TTL_S > 86400 || TINYPAN_DNS_NEGATIVE_TTL_S > 86400
+#error "TINYPAN_DNS_MAX_TTL_S and TINYPAN_DNS_NEGATIVE_TTL_S must not exceed 86400"
+#endif
+
+#if TINYPAN_DNS_PREFETCH_PERCENT >= 100
+#error "TINYPAN_DNS_PREFETCH_PERCENT must be below 100"
+#endif
+
+#if TINYPAN_DNS_SOURCE_PORTS < 1 || TINYPAN_DNS_SOURCE_PORTS > 16
+#error "TINYPAN_DNS_SOURCE_PORTS must be between 1 and 16"
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define DNS_SERVER_PORT         53
+#define DNS_HDR_LEN             12
+
+#define DNS_FLAG_QR             0x8000
+#define DNS_FLAG_RD             0x0100
+#define DNS_OPCODE_MASK         0x7800
+#define DNS_RCODE_MASK          0x000F
+
+#define DNS_RCODE_NOERROR       0
+#define DNS_RCODE_NXDOMAIN      3
+
+#define DNS_TYPE_A              1
+#define DNS_TYPE_CNAME          5
+#define DNS_TYPE_SOA            6
+#define DNS_CLASS_IN            1
+
+/** Encoded name: a length byte per label plus the root label */
+#define DNS_QNAME_MAX_LEN       (TINYPAN_DNS_MAX_NAME_LEN + 2)
+
+/** Header, name, QTYPE and QCLASS */
+#define DNS_QUERY_MAX_LEN       (DNS_HDR_LEN + DNS_QNAME_MAX_LEN + 4)
+
+/** Callbacks that may wait on lookups in flight */
+#define DNS_MAX_WAITERS         (2 * TINYPAN_DNS_CACHE_SIZE)
+
+/** Source ports are drawn from the dynamic range, 49152-65535 */
+#define DNS_PORT_BASE           0xC000
+#define DNS_PORT_MASK           0x3FFF
+#define DNS_BIND_ATTEMPTS       4
+
+/* ============================================================================
+ * State
+ * ============================================================================ */
+
+typedef enum {
+    DNS_ENTRY_FREE = 0,
+    DNS_ENTRY_PENDING,      /**< First query outstanding, nothing known yet */
+    DNS_ENTRY_VALID,        /**< addr is the answer */
+    DNS_ENTRY_NEGATIVE      /**< The name has no A record */
+} dns_entry_state_t;
+
+typedef struct {
+    char     name[TINYPAN_DNS_MAX_NAME_LEN + 1];
+    uint8_t  state;         /**< dns_entry_state_t */
+    bool     querying;      /**< A query is outstanding (first fetch or refresh) */
+    bool     used;          /**< Looked up since the answer arrived */
+    uint8_t  tries;         /**< Transmissions of the outstanding query */
+    uint16_t txid;          /**< ID of the outstanding query */
+    int8_t   port;          /**< Socket it was sent from, -1 = none yet */
+    uint32_t addr;          /**< Network byte order */
+    uint32_t fetched_ms;    /**< When the answer arrived */
+    uint32_t ttl_ms;        /**< How long the answer is good for */
+    uint32_t sent_ms;       /**< Last transmission of the outstanding query */
+    uint32_t stamp;         /**< Last use, for LRU replacement */
+} dns_entry_t;
+
+typedef struct {
+    tinypan_dns_callback_t callback;
+    void*    user_data;
+    int8_t   entry;         /**< Entry waited on, -1 = free slot */
+} dns_waiter_t;
+
+typedef struct {
+    struct udp_pcb* pcb;
+    uint8_t  users;         /**< Outstanding queries sent from it */
+} dns_port_t;
+
+static dns_entry_t s_entries[TINYPAN_DNS_CACHE_SIZE];
+static dns_waiter_t s_waiters[DNS_MAX_WAITERS];
+static dns_port_t s_ports[TINYPAN_DNS_SOURCE_PORTS];
+static uint8_t s_last_port = 0;
+static bool s_started = false;
+static tinypan_dns_stats_t s_stats;
+static uint32_t s_clock = 0;
+static uint32_t s_rng = 1;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static char dns_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static bool dns_name_eq(const char* a, const char* b) {
+    while (*a != '\0' && dns_lower(*a) == dns_lower(*b)) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static bool dns_expired(const dns_entry_t* e, uint32_t now) {
+    return (uint32_t)(now - e->fetched_ms) >= e->ttl_ms;
+}
+
+#if TINYPAN_DNS_PREFETCH_PERCENT > 0
+/** Age at which a used entry is refreshed */
+static uint32_t dns_prefetch_age(const dns_entry_t* e) {
+    return e->ttl_ms - (e->ttl_ms / 100) * TINYPAN_DNS_PREFETCH_PERCENT;
+}
+#endif
+
+static uint16_t dns_get16(const struct pbuf* p, uint32_t off) {
+    return (uint16_t)((pbuf_get_at(p, (u16_t)off) << 8) | pbuf_get_at(p, (u16_t)(off + 1)));
+}
+
+static uint32_t dns_get32(const struct pbuf* p, uint32_t off) {
+    return ((uint32_t)dns_get16(p, off) << 16) | dns_get16(p, off + 2);
+}
+
+/**
+ * @brief Encode a dotted name as DNS labels
+ * @return Encoded length, or 0 if a label is empty or longer than 63
+ */
+static uint16_t dns_encode_name(uint8_t* out, const char* name) {
+    uint16_t pos = 0;
+    const char* label = name;
+
+    for (;;) {
+        const char* dot = strchr(label, '.');
+        size_t len = (dot != NULL) ? (size_t)(dot - label) : strlen(label);
+        if (len == 0 || len > 63) {
+            return 0;
+        }
+        out[pos++] = (uint8_t)len;
+        memcpy(&out[pos], label, len);
+        pos = (uint16_t)(pos + len);
+        if (dot == NULL) {
+            break;
+        }
+        label = dot + 1;
+    }
+    out[pos++] = 0;
+    return pos;
+}
+
+/**
+ * @brief Skip an encoded name in a message
+ * @return Offset just past it, or 0 if it is malformed
+ */
+static uint32_t dns_skip_name(const struct pbuf* p, uint32_t off) {
+    for (int labels = 0; labels < 128 && off < p->tot_len; labels++) {
+        uint8_t len = pbuf_get_at(p, (u16_t)off);
+        if ((len & 0xC0) == 0xC0) {
+            return off + 2;     /* A compression pointer ends the name */
+        }
+        if ((len & 0xC0) != 0) {
+            return 0;
+        }
+        off += 1u + len;
+        if (len == 0) {
+            return off;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Compare the question name of a response with the name queried
+ * @return Offset just past the name, or 0 if it differs
+ */
+static uint32_t dns_match_name(const struct pbuf* p, uint32_t off, const char* name) {
+    const char* c = name;
+
+    for (;;) {
+        if (off >= p->tot_len) {
+            return 0;
+        }
+        uint8_t len = pbuf_get_at(p, (u16_t)off++);
+        if (len == 0) {
+            return (*c == '\0') ? off : 0;
+        }
+        if (len > 63) {
+            return 0;           /* The question is never compressed */
+        }
+        if (c != name && *c++ != '.') {
+            return 0;
+        }
+        for (uint8_t k = 0; k < len; k++, c++) {
+            if (*c == '\0' || *c == '.' ||
+                dns_lower(*c) != dns_lower((char)pbuf_get_at(p, (u16_t)(off + k)))) {
+                return 0;
+            }
+        }
+        off += len;
+    }
+}
+
+static void dns_recv(void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                     const ip_addr_t* addr, u16_t port);
+
+static uint16_t dns_random(void) {
+    /* xorshift32 stirred with the clock: IDs and ports are not predictable from the last one */
+    s_rng ^= hal_get_tick_ms();
+    if (s_rng == 0) {
+        s_rng = 1;
+    }
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return (uint16_t)(s_rng >> 8);
+}
+
+static int dns_find(const char* name) {
+    for (int i = 0; i < TINYPAN_DNS_CACHE_SIZE; i++) {
+        if (s_entries[i].state != DNS_ENTRY_FREE && dns_name_eq(s_entries[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Pick a slot for a new name: a free one, else the least recently
+ *        used expired one, else the least recently used one
+ * @return Slot index, or -1 if every entry has a query outstanding
+ */
+static int dns_alloc(uint32_t now) {
+    int best = -1;
+    bool best_expired = false;
+
+    for (int i = 0; i < TINYPAN_DNS_CACHE_SIZE; i++) {
+        const dns_entry_t* e = &s_entries[i];
+        if (e->state == DNS_ENTRY_FREE) {
+            return i;
+        }
+        if (e->querying) {
+            continue;
+        }
+        bool expired = dns_expired(e, now);
+        if (best < 0 || (expired && !best_expired) ||
+            (expired == best_expired && e->stamp < s_entries[best].stamp)) {
+            best = i;
+            best_expired = expired;
+        }
+    }
+    return best;
+}
+
+static int dns_free_waiter(void) {
+    for (int w = 0; w < DNS_MAX_WAITERS; w++) {
+        if (s_waiters[w].entry < 0) {
+            return w;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief New socket bound to a random port
+ */
+static struct udp_pcb* dns_bind_random(void) {
+    struct udp_pcb* pcb = udp_new();
+    if (pcb == NULL) {
+        return NULL;
+    }
+    for (int attempt = 0; attempt < DNS_BIND_ATTEMPTS; attempt++) {
+        u16_t port = (u16_t)(DNS_PORT_BASE | (dns_random() & DNS_PORT_MASK));
+        if (udp_bind(pcb, IP_ADDR_ANY, port) == ERR_OK) {
+            return pcb;
+        }
+    }
+    udp_remove(pcb);
+    return NULL;
+}
+
+/**
+ * @brief Socket for a new query: a fresh one while a slot is free, as lwIP's
+ *        resolver does with LWIP_DNS_SECURE_RAND_SRC_PORT, else the next
+ *        open one in turn
+ * @return Slot index, or -1 if no socket could be had
+ */
+static int dns_take_port(void) {
+    for (int i = 0; i < TINYPAN_DNS_SOURCE_PORTS; i++) {
+        if (s_ports[i].pcb != NULL) {
+            continue;
+        }
+        s_ports[i].pcb = dns_bind_random();
+        if (s_ports[i].pcb == NULL) {
+            break;      /* Out of pcbs: share an open one */
+        }
+        udp_recv(s_ports[i].pcb, dns_recv, &s_ports[i]);
+        s_ports[i].users = 1;
+        s_last_port = (uint8_t)i;
+        return i;
+    }
+    for (int k = 1; k <= TINYPAN_DNS_SOURCE_PORTS; k++) {
+        int i = (s_last_port + k) % TINYPAN_DNS_SOURCE_PORTS;
+        if (s_ports[i].pcb != NULL) {
+            s_ports[i].users++;
+            s_last_port = (uint8_t)i;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief The outstanding query of an entry is over: close its socket with
+ *        the last query on it
+ */
+static void dns_end_query(dns_entry_t* e) {
+    e->querying = false;
+    if (e->port < 0) {
+        return;
+    }
+    dns_port_t* port = &s_ports[e->port];
+    e->port = -1;
+    if (--port->users == 0) {
+        udp_remove(port->pcb);
+        port->pcb = NULL;
+    }
+}
+
+/**
+ * @brief Send (or resend) the outstanding query of an entry
+ *
+ * Without an address or a DNS server nothing goes out, but the attempt
+ * still counts, so lookups started just before the link dropped time out.
+ */
+static void dns_send(dns_entry_t* e, uint32_t now) {
+    tinypan_ip_info_t info;
+    uint8_t msg[DNS_QUERY_MAX_LEN];
+
+    e->sent_ms = now;
+    e->tries++;
+    if (!s_started || tinypan_get_ip_info(&info) != TINYPAN_OK || info.dns_server == 0) {
+        return;
+    }
+    if (e->port < 0) {
+        e->port = (int8_t)dns_take_port();
+        if (e->port < 0) {
+            return;
+        }
+    }
+
+    memset(msg, 0, DNS_HDR_LEN);
+    msg[0] = (uint8_t)(e->txid >> 8);
+    msg[1] = (uint8_t)e->txid;
+    msg[2] = (uint8_t)(DNS_FLAG_RD >> 8);
+    msg[5] = 1;                                 /* QDCOUNT */
+    uint16_t len = (uint16_t)(DNS_HDR_LEN + dns_encode_name(&msg[DNS_HDR_LEN], e->name));
+    msg[len++] = 0;
+    msg[len++] = DNS_TYPE_A;
+    msg[len++] = 0;
+    msg[len++] = DNS_CLASS_IN;
+
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (p == NULL) {
+        return;
+    }
+    pbuf_take(p, msg, len);
+
+    ip_addr_t server;
+    ip_addr_set_ip4_u32(&server, info.dns_server);
+    if (udp_sendto(s_ports[e->port].pcb, p, &server, DNS_SERVER_PORT) == ERR_OK) {
+        s_stats.queries_sent++;
+    }
+    pbuf_free(p);
+}
+
+static void dns_start_query(dns_entry_t* e, uint32_t now) {
+    e->querying = true;
+    e->tries = 0;
+    e->txid = dns_random();
+    e->port = -1;
+    dns_send(e, now);
+}
+
+/**
+ * @brief Deliver a result to everyone waiting on an entry
+ *
+ * The entry is final before the first callback runs, so callbacks may
+ * start new lookups.
+ */
+static void dns_complete(int index, tinypan_error_t result, uint32_t addr) {
+    char name[TINYPAN_DNS_MAX_NAME_LEN + 1];
+    dns_waiter_t ready[DNS_MAX_WAITERS];
+    int n = 0;
+
+    memcpy(name, s_entries[index].name, sizeof(name));
+    for (int w = 0; w < DNS_MAX_WAITERS; w++) {
+        if (s_waiters[w].entry == index) {
+            ready[n++] = s_waiters[w];
+            s_waiters[w].entry = -1;
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        ready[k].callback(name, result, addr, ready[k].user_data);
+    }
+}
+
+/**
+ * @brief Record an answer and complete the lookups waiting on it
+ */
+static void dns_store(int index, bool found, uint32_t addr, uint32_t ttl_s) {
+    dns_entry_t* e = &s_entries[index];
+
+    e->state = found ? DNS_ENTRY_VALID : DNS_ENTRY_NEGATIVE;
+    e->addr = found ? addr : 0;
+    e->fetched_ms = hal_get_tick_ms();
+    e->ttl_ms = ttl_s * 1000u;
+    dns_end_query(e);
+    e->used = false;
+
+    TINYPAN_LOG_DEBUG("dns: %s %s for %lu s", e->name, found ? "resolved" : "does not exist",
+                      (unsigned long)ttl_s);
+    dns_complete(index, found ? TINYPAN_OK : TINYPAN_ERR_NOT_FOUND, e->addr);
+}
+
+/**
+ * @brief Parse a response to an outstanding query
+ *
+ * Answers other than NOERROR and NXDOMAIN (SERVFAIL, REFUSED) say nothing
+ * about the name and are ignored: the query is resent and times out if the
+ * server keeps failing.
+ */
+static void dns_handle_response(const struct pbuf* p, int port) {
+    uint16_t id = dns_get16(p, 0);
+    uint16_t flags = dns_get16(p, 2);
+    uint16_t qdcount = dns_get16(p, 4);
+    uint16_t ancount = dns_get16(p, 6);
+    uint16_t nscount = dns_get16(p, 8);
+    uint8_t rcode = (uint8_t)(flags & DNS_RCODE_MASK);
+
+    if ((flags & DNS_FLAG_QR) == 0 || (flags & DNS_OPCODE_MASK) != 0 || qdcount != 1 ||
+        (rcode != DNS_RCODE_NOERROR && rcode != DNS_RCODE_NXDOMAIN)) {
+        return;
+    }
+
+    int index = -1;
+    for (int i = 0; i < TINYPAN_DNS_CACHE_SIZE; i++) {
+        if (s_entries[i].querying && s_entries[i].port == port && s_entries[i].txid == id) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        return;
+    }
+
+    uint32_t off = dns_match_name(p, DNS_HDR_LEN, s_entries[index].name);
+    if (off == 0 || off + 4 > p->tot_len ||
+        dns_get16(p, off) != DNS_TYPE_A || dns_get16(p, off + 2) != DNS_CLASS_IN) {
+        return;
+    }
+    off += 4;
+
+    /* Answer section: the first A record, and the smallest TTL along the
+     * CNAME chain leading to it */
+    bool found = false;
+    uint32_t addr = 0;
+    uint32_t ttl = TINYPAN_DNS_MAX_TTL_S;
+    for (uint16_t n = 0; rcode == DNS_RCODE_NOERROR && n < ancount; n++) {
+        off = dns_skip_name(p, off);
+        if (off == 0 || off + 10 > p->tot_len) {
+            return;
+        }
+        uint16_t type = dns_get16(p, off);
+        uint16_t rclass = dns_get16(p, off + 2);
+        uint32_t rr_ttl = dns_get32(p, off + 4);
+        uint16_t rdlen = dns_get16(p, off + 8);
+        off += 10;
+        if (off + rdlen > p->tot_len) {
+            return;
+        }
+        if (rr_ttl & 0x80000000UL) {
+            rr_ttl = 0;         /* RFC 2181 section 8 */
+        }
+        if (rclass == DNS_CLASS_IN && (type == DNS_TYPE_A || type == DNS_TYPE_CNAME)) {
+            if (rr_ttl < ttl) {
+                ttl = rr_ttl;
+            }
+            if (type == DNS_TYPE_A && rdlen == 4 && !found) {
+                pbuf_copy_partial(p, &addr, 4, (u16_t)off);     /* Stays in network order */
+                found = true;
+            }
+        }
+        off += rdlen;
+    }
+    if (found) {
+        dns_store(index, true, addr, ttl);
+        return;
+    }
+
+    /* NXDOMAIN or no A record: negative TTL is min(SOA TTL, SOA MINIMUM) */
+    ttl = TINYPAN_DNS_NEGATIVE_TTL_S;
+    for (uint16_t n = 0; n < nscount; n++) {
+        off = dns_skip_name(p, off);
+        if (off == 0 || off + 10 > p->tot_len) {
+            break;
+        }
+        uint16_t type = dns_get16(p, off);
+        uint32_t rr_ttl = dns_get32(p, off + 4);
+        uint16_t rdlen = dns_get16(p, off + 8);
+        off += 10;
+        if (type == DNS_TYPE_SOA) {
+            /* MNAME, RNAME, then SERIAL, REFRESH, RETRY, EXPIRE, MINIMUM */
+            uint32_t fixed = dns_skip_name(p, off);
+            fixed = (fixed != 0) ? dns_skip_name(p, fixed) : 0;
+            if (fixed != 0 && fixed + 20 <= off + rdlen && fixed + 20 <= p->tot_len) {
+                uint32_t minimum = dns_get32(p, fixed + 16);
+                uint32_t soa_ttl = (rr_ttl < minimum) ? rr_ttl : minimum;
+                if (soa_ttl < ttl) {
+                    ttl = soa_ttl;
+                }
+            }
+            break;
+        }
+        off += rdlen;
+    }
+    dns_store(index, false, 0, ttl);
+}
+
+static void dns_recv(void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                     const ip_addr_t* addr, u16_t port) {
+    (void)pcb;
+
+    /* Only the server we asked, on the DNS port */
+    tinypan_ip_info_t info;
+    if (port == DNS_SERVER_PORT && p->tot_len >= DNS_HDR_LEN &&
+        tinypan_get_ip_info(&info) == TINYPAN_OK &&
+        ip_addr_get_ip4_u32(addr) == info.dns_server) {
+        dns_handle_response(p, (int)((dns_port_t*)arg - s_ports));
+    }
+    pbuf_free(p);
+}
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+int tinypan_dns_init(void) {
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(&s_stats, 0, sizeof(s_stats));
+    for (int w = 0; w < DNS_MAX_WAITERS; w++) {
+        s_waiters[w].entry = -1;
+    }
+    s_clock = 0;
+    s_rng = 0x2545F491UL ^ hal_get_tick_ms();
+
+    /* Sockets are opened per query */
+    memset(s_ports, 0, sizeof(s_ports));
+    s_last_port = 0;
+    s_started = true;
+    return 0;
+}
+
+void tinypan_dns_deinit(void) {
+    for (int i = 0; i < TINYPAN_DNS_SOURCE_PORTS; i++) {
+        if (s_ports[i].pcb != NULL) {
+            udp_remove(s_ports[i].pcb);
+        }
+    }
+    memset(s_ports, 0, sizeof(s_ports));
+    s_started = false;
+    memset(s_entries, 0, sizeof(s_entries));
+    for (int w = 0; w < DNS_MAX_WAITERS; w++) {
+        s_waiters[w].entry = -1;
+    }
+}
+
+tinypan_error_t tinypan_dns_lookup(const char* hostname, uint32_t* ip_addr,
+                                   tinypan_dns_callback_t callback, void* user_data) {
+    ip4_addr_t literal;
+    if (ip4addr_aton(hostname, &literal)) {
+        *ip_addr = ip4_addr_get_u32(&literal);
+        return TINYPAN_OK;
+    }
+
+    uint8_t qname[DNS_QNAME_MAX_LEN];
+    if (strlen(hostname) > TINYPAN_DNS_MAX_NAME_LEN || dns_encode_name(qname, hostname) == 0) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+
+    uint32_t now = hal_get_tick_ms();
+    int index = dns_find(hostname);
+    if (index >= 0) {
+        dns_entry_t* e = &s_entries[index];
+        e->stamp = ++s_clock;
+        if (e->state == DNS_ENTRY_VALID && !dns_expired(e, now)) {
+            e->used = true;
+            s_stats.hits++;
+            *ip_addr = e->addr;
+            return TINYPAN_OK;
+        }
+        if (e->state == DNS_ENTRY_NEGATIVE && !dns_expired(e, now)) {
+            s_stats.negative_hits++;
+            return TINYPAN_ERR_NOT_FOUND;
+        }
+        if (e->querying) {
+            /* First fetch, or a refresh that has not landed before expiry */
+            int w = (callback != NULL) ? dns_free_waiter() : DNS_MAX_WAITERS;
+            if (w < 0) {
+                return TINYPAN_ERR_BUSY;
+            }
+            if (w < DNS_MAX_WAITERS) {
+                s_waiters[w].callback = callback;
+                s_waiters[w].user_data = user_data;
+                s_waiters[w].entry = (int8_t)index;
+            }
+            s_stats.misses++;
+            return TINYPAN_ERR_IN_PROGRESS;
+        }
+    }
+
+    /* Not cached, or expired: ask the server */
+    tinypan_ip_info_t info;
+    if (!s_started || tinypan_get_ip_info(&info) != TINYPAN_OK || info.dns_server == 0) {
+        return TINYPAN_ERR_NOT_STARTED;
+    }
+    int w = (callback != NULL) ? dns_free_waiter() : DNS_MAX_WAITERS;
+    if (index < 0) {
+        index = dns_alloc(now);
+    }
+    if (index < 0 || w < 0) {
+        return TINYPAN_ERR_BUSY;
+    }
+
+    dns_entry_t* e = &s_entries[index];
+    if (e->state == DNS_ENTRY_FREE || !dns_name_eq(e->name, hostname)) {
+        memset(e, 0, sizeof(*e));
+        memcpy(e->name, hostname, strlen(hostname) + 1);
+    }
+    e->state = DNS_ENTRY_PENDING;
+    e->used = false;
+    e->stamp = ++s_clock;
+    if (w < DNS_MAX_WAITERS) {
+        s_waiters[w].callback = callback;
+        s_waiters[w].user_data = user_data;
+        s_waiters[w].entry = (int8_t)index;
+    }
+    s_stats.misses++;
+    dns_start_query(e, now);
+    return TINYPAN_ERR_IN_PROGRESS;
+}
+
+void tinypan_dns_process(void) {
+    uint32_t now = hal_get_tick_ms();
+
+    for (int i = 0; i < TINYPAN_DNS_CACHE_SIZE; i++) {
+        dns_entry_t* e = &s_entries[i];
+
+        if (e->querying) {
+            if ((uint32_t)(now - e->sent_ms) < TINYPAN_DNS_TIMEOUT_MS) {
+                continue;
+            }
+            if (e->tries <= TINYPAN_DNS_RETRIES) {
+                dns_send(e, now);
+                continue;
+            }
+            dns_end_query(e);
+            if (e->state == DNS_ENTRY_PENDING || dns_expired(e, now)) {
+                /* Nothing usable left: fail everyone waiting */
+                TINYPAN_LOG_WARN("dns: No answer for %s", e->name);
+                e->state = DNS_ENTRY_FREE;
+                s_stats.timeouts++;
+                dns_complete(i, TINYPAN_ERR_TIMEOUT, 0);
+            }
+            /* A failed refresh keeps serving the old answer until it expires */
+#if TINYPAN_DNS_PREFETCH_PERCENT > 0
+        } else if (e->state == DNS_ENTRY_VALID && e->used && !dns_expired(e, now) &&
+                   (uint32_t)(now - e->fetched_ms) >= dns_prefetch_age(e)) {
+            s_stats.prefetches++;
+            dns_start_query(e, now);
+#endif
+        }
+    }
+}
+
+uint32_t tinypan_dns_get_next_timeout_ms(void) {
+    uint32_t now = hal_get_tick_ms();
+    uint32_t sleep_ms = 0xFFFFFFFF;
+
+    for (int i = 0; i < TINYPAN_DNS_CACHE_SIZE; i++) {
+        const dns_entry_t* e = &s_entries[i];
+        uint32_t due;
+
+        if (e->querying) {
+            due = e->sent_ms + TINYPAN_DNS_TIMEOUT_MS;
+#if TINYPAN_DNS_PREFETCH_PERCENT > 0
+        } else if (e->state == DNS_ENTRY_VALID && e->used && !dns_expired(e, now)) {
+            due = e->fetched_ms + dns_prefetch_age(e);
+#endif
+        } else {
+            continue;
+        }
+        uint32_t left = due - now;
+        if ((int32_t)left < 0) {
+            left = 0;
+        }
+        if (left < sleep_ms) {
+            sleep_ms = left;
+        }
+    }
+    return sleep_ms;
+}
+
+void tinypan_dns_get_stats(tinypan_dns_stats_t* stats) {
+    *stats = s_stats;
+}
+
+#endif /* TINYPAN_ENABLE_DNS_CACHE */
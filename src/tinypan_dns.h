@@ -0,0 +1,62 @@
+/*
+ * TinyPAN Resolver Cache - Internal Header
+ *
+ * A-record stub resolver on lwIP's raw UDP API, with a small cache in front
+ * of it (TINYPAN_ENABLE_DNS_CACHE). Queries go to the DNS server from the
+ * DHCP lease (tinypan_ip_info_t.dns_server). tinypan_lwip_netif.c drives it
+ * from tinypan_netif_process(); tinypan.c exposes it as tinypan_dns_resolve().
+ */
+
+#ifndef TINYPAN_DNS_H
+#define TINYPAN_DNS_H
+
+#include <stdint.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Empty the cache, clear the statistics and open the UDP socket
+ * @return 0 on success, negative if no UDP PCB is available
+ */
+int tinypan_dns_init(void);
+
+/**
+ * @brief Close the socket and forget everything; pending lookups are
+ *        dropped without a callback
+ */
+void tinypan_dns_deinit(void);
+
+/**
+ * @brief Look a name up in the cache, or start a query for it
+ *
+ * See tinypan_dns_resolve() for parameters and return values.
+ */
+tinypan_error_t tinypan_dns_lookup(const char* hostname, uint32_t* ip_addr,
+                                   tinypan_dns_callback_t callback, void* user_data);
+
+/**
+ * @brief Resend unanswered queries, fail lookups out of retries and start
+ *        prefetches. Call from tinypan_netif_process().
+ */
+void tinypan_dns_process(void);
+
+/**
+ * @brief Milliseconds until tinypan_dns_process() has work to do
+ * @return Milliseconds, or 0xFFFFFFFF if nothing is scheduled
+ */
+uint32_t tinypan_dns_get_next_timeout_ms(void);
+
+/**
+ * @brief Copy the statistics counters
+ */
+void tinypan_dns_get_stats(tinypan_dns_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_DNS_H */
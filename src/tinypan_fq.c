@@ -0,0 +1,146 @@
+/*
+ * TinyPAN Flow Queueing
+ *
+ * Classic deficit round robin without per-bucket queues: the transport's
+ * TX ring is the storage, and the frames of a bucket are its entries in
+ * arrival order. A bucket that comes up gets TINYPAN_FQ_QUANTUM bytes of
+ * credit and sends head frames while the credit covers them; then the turn
+ * passes on. A bucket with nothing queued loses its credit, so a sparse
+ * flow waits for at most one quantum of every other busy bucket.
+ */
+
+#include "tinypan_fq.h"
+
+#if TINYPAN_ENABLE_FQ
+
+#include <string.h>
+
+#if TINYPAN_FQ_BUCKETS < 1 || TINYPAN_FQ_BUCKETS > 32
+#error "TINYPAN_FQ_BUCKETS must be between 1 and 32"
+#endif
+
+#if TINYPAN_FQ_QUANTUM < 64
+#error "TINYPAN_FQ_QUANTUM must be at least 64 bytes"
+#endif
+
+#if TINYPAN_FQ_FLOW_LIMIT < 1
+#error "TINYPAN_FQ_FLOW_LIMIT must be at least 1"
+#endif
+
+static int32_t s_deficit[TINYPAN_FQ_BUCKETS];
+static uint8_t s_current = 0;       /* Bucket whose turn it is */
+static bool s_granted = false;      /* It has had its quantum this turn */
+
+static uint32_t fq_hash(uint32_t h, const uint8_t* data, uint16_t len) {
+    /* FNV-1a */
+    for (uint16_t i = 0; i < len; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+void tinypan_fq_reset(void) {
+    memset(s_deficit, 0, sizeof(s_deficit));
+    s_current = 0;
+    s_granted = false;
+}
+
+uint8_t tinypan_fq_classify(uint16_t ethertype, const uint8_t* l3, uint16_t len) {
+    uint32_t h = 2166136261u;
+
+    if (ethertype == 0x0800 && len >= 20 && (l3[0] >> 4) == 4) {
+        uint16_t ihl = (uint16_t)((l3[0] & 0x0F) * 4);
+        uint8_t proto = l3[9];
+        bool fragment = ((l3[6] & 0x3F) | l3[7]) != 0; /* MF or an offset */
+        h = fq_hash(h, &l3[9], 1);
+        h = fq_hash(h, &l3[12], 8);
+        if ((proto == 6 || proto == 17) && !fragment && len >= ihl + 4) {
+            h = fq_hash(h, &l3[ihl], 4);
+        }
+    } else if (ethertype == 0x86DD && len >= 40 && (l3[0] >> 4) == 6) {
+        uint8_t next = l3[6];
+        h = fq_hash(h, &l3[6], 1);
+        h = fq_hash(h, &l3[8], 32);
+        if ((next == 6 || next == 17) && len >= 44) {
+            h = fq_hash(h, &l3[40], 4);
+        }
+    } else {
+        const uint8_t type[2] = { (uint8_t)(ethertype >> 8), (uint8_t)ethertype };
+        h = fq_hash(h, type, 2);
+    }
+
+    return (uint8_t)(h % TINYPAN_FQ_BUCKETS);
+}
+
+bool tinypan_fq_admit(const uint8_t* flows, uint8_t count, uint8_t flow) {
+    uint8_t held = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (flows[i] == flow) {
+            held++;
+        }
+    }
+    return held < TINYPAN_FQ_FLOW_LIMIT;
+}
+
+uint8_t tinypan_fq_room(const uint8_t* flows, uint8_t count) {
+    uint8_t held[TINYPAN_FQ_BUCKETS];
+    uint8_t most = 0;
+    memset(held, 0, sizeof(held));
+    for (uint8_t i = 0; i < count; i++) {
+        held[flows[i]]++;
+        if (held[flows[i]] > most) {
+            most = held[flows[i]];
+        }
+    }
+    return (most < TINYPAN_FQ_FLOW_LIMIT) ? (uint8_t)(TINYPAN_FQ_FLOW_LIMIT - most) : 0;
+}
+
+uint8_t tinypan_fq_pick(const uint8_t* flows, const uint16_t* lens, uint8_t count) {
+    if (count == 0) {
+        return TINYPAN_FQ_NONE; /* No bucket would ever come up */
+    }
+
+    uint8_t first[TINYPAN_FQ_BUCKETS];
+    uint8_t frames[TINYPAN_FQ_BUCKETS];
+    memset(first, TINYPAN_FQ_NONE, sizeof(first));
+    memset(frames, 0, sizeof(frames));
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t b = flows[i];
+        if (first[b] == TINYPAN_FQ_NONE) {
+            first[b] = i;
+        }
+        frames[b]++;
+    }
+    for (uint8_t b = 0; b < TINYPAN_FQ_BUCKETS; b++) {
+        if (frames[b] == 0) {
+            s_deficit[b] = 0;
+        }
+    }
+
+    /* Terminates: every backlogged bucket gains a quantum per round */
+    for (;;) {
+        uint8_t b = s_current;
+        if (frames[b] > 0) {
+            if (!s_granted) {
+                s_deficit[b] += TINYPAN_FQ_QUANTUM;
+                s_granted = true;
+            }
+            uint16_t len = lens[first[b]];
+            if (s_deficit[b] >= len) {
+                s_deficit[b] -= len;
+                if (frames[b] == 1) {
+                    /* Bucket drained: its turn ends without the credit */
+                    s_deficit[b] = 0;
+                    s_current = (uint8_t)((b + 1) % TINYPAN_FQ_BUCKETS);
+                    s_granted = false;
+                }
+                return first[b];
+            }
+        }
+        s_current = (uint8_t)((b + 1) % TINYPAN_FQ_BUCKETS);
+        s_granted = false;
+    }
+}
+
+#endif /* TINYPAN_ENABLE_FQ */
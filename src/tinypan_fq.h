@@ -0,0 +1,77 @@
+/*
+ * TinyPAN Flow Queueing - Internal Header
+ *
+ * Deficit round robin over flow buckets for the BNEP and SLIP TX queues
+ * (TINYPAN_ENABLE_FQ). The transports tag each queued frame with its bucket
+ * and, when the link is ready for the next frame, pass the bucket and length
+ * of every waiting frame in arrival order; the scheduler says which to send.
+ * Frames of one bucket always leave in arrival order.
+ */
+
+#ifndef TINYPAN_FQ_H
+#define TINYPAN_FQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** No frame to send: tinypan_fq_pick() with an empty queue */
+#define TINYPAN_FQ_NONE     0xFF
+
+/**
+ * @brief Forget the deficits and restart the round at bucket 0
+ */
+void tinypan_fq_reset(void);
+
+/**
+ * @brief Bucket of a frame
+ *
+ * IPv4 and IPv6 hash on addresses, protocol and, for TCP and UDP, ports
+ * (IPv4 fragments without ports, so all fragments of a datagram stay
+ * together). Anything else hashes on the ethertype.
+ *
+ * @param ethertype Ethertype of the frame
+ * @param l3        Start of the L3 header
+ * @param len       Bytes available at l3
+ * @return Bucket, below TINYPAN_FQ_BUCKETS
+ */
+uint8_t tinypan_fq_classify(uint16_t ethertype, const uint8_t* l3, uint16_t len);
+
+/**
+ * @brief May a frame of this bucket join the queue?
+ * @param flows Buckets of the queued frames
+ * @param count Number of queued frames
+ * @param flow  Bucket of the new frame
+ * @return false if the bucket already holds TINYPAN_FQ_FLOW_LIMIT frames
+ */
+bool tinypan_fq_admit(const uint8_t* flows, uint8_t count, uint8_t flow);
+
+/**
+ * @brief Frames any one bucket may still add to the queue
+ * @param flows Buckets of the queued frames
+ * @param count Number of queued frames
+ * @return TINYPAN_FQ_FLOW_LIMIT less what the fullest bucket holds
+ */
+uint8_t tinypan_fq_room(const uint8_t* flows, uint8_t count);
+
+/**
+ * @brief Choose the next frame to send and charge its bucket
+ *
+ * Call once per frame actually started.
+ *
+ * @param flows Buckets of the queued frames, in arrival order
+ * @param lens  Their lengths
+ * @param count Number of queued frames
+ * @return Index into flows of the frame to send, TINYPAN_FQ_NONE if count is 0
+ */
+uint8_t tinypan_fq_pick(const uint8_t* flows, const uint16_t* lens, uint8_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_FQ_H */
@@ -0,0 +1,226 @@
+/*
+ * TinyPAN Link Heartbeat
+ *
+ * A link that has received nothing for heartbeat_interval_ms is probed with
+ * an ARP request to the gateway (the NAP itself on a phone hotspot), which
+ * every IPv4 host must answer and which needs no open port or ICMP. SLIP
+ * has no ARP; there the transport sends an echo control frame instead, if
+ * the companion app agreed to answer it when the link came up. A probe
+ * unanswered after TINYPAN_HEARTBEAT_TIMEOUT_MS is a miss and is repeated;
+ * after heartbeat_retries misses in a row the link is dead.
+ *
+ * Any received packet is as good as a reply, so the idle time restarts
+ * with it and a link with regular traffic is never probed. The reply to a
+ * probe is timed; the smoothed round-trip time uses a gain of 1/8 in
+ * fixed point, as the adaptive TX timeout does.
+ *
+ * A late reply to a probe that was already repeated still proves the link
+ * alive, but is not timed: measured from the repeat it would be too short.
+ * ARP replies cannot say which probe they answer, so after a repeat none
+ * is timed (Karn's algorithm). Echo replies carry the probe's tag and are
+ * timed if they answer the latest probe.
+ */
+
+#include "tinypan_heartbeat.h"
+
+#if TINYPAN_ENABLE_HEARTBEAT
+
+#include "tinypan_internal.h"
+#include "../include/tinypan_hal.h"
+#include <string.h>
+
+#if TINYPAN_ENABLE_LWIP
+#include "tinypan_lwip_netif.h"
+#include "tinypan_transport.h"
+#endif
+
+static bool s_running = false;
+static bool s_probing = false;          /* Probe sent, no reply or RX yet */
+static uint8_t s_misses = 0;            /* Misses in a row */
+static uint32_t s_alive_ms = 0;         /* Last reply, RX or ONLINE entry */
+static uint32_t s_sent_ms = 0;          /* Last probe sent */
+static uint32_t s_rtt8 = 0;             /* Smoothed round-trip time, ms x 8 */
+static bool s_have_rtt = false;         /* s_rtt8 holds a sample */
+static uint8_t s_tag = 0;               /* Tag of the last probe sent */
+static uint8_t s_round_probes = 0;      /* Probes sent since the link went quiet */
+
+/* Set from the RX path, folded in by tinypan_heartbeat_process() */
+static volatile bool s_rx_pending = false;
+static volatile uint32_t s_rx_ms = 0;
+static volatile bool s_reply_pending = false;
+static volatile uint32_t s_reply_ms = 0;
+static volatile int s_reply_tag = TINYPAN_HEARTBEAT_NO_TAG;
+
+static tinypan_heartbeat_stats_t s_stats;
+
+static uint32_t heartbeat_interval_ms(void) {
+    return tinypan_internal_get_config()->heartbeat_interval_ms;
+}
+
+/**
+ * @brief Time the probe the gateway answered
+ *
+ * Before heartbeat_take_rx(): the reply also counts as received traffic,
+ * which would end the probe without a sample.
+ */
+static void heartbeat_take_reply(void) {
+    if (!s_reply_pending) {
+        return;
+    }
+    s_reply_pending = false;
+    if (!s_probing) {
+        return;
+    }
+    s_probing = false;
+    s_misses = 0;
+    s_alive_ms = s_reply_ms;
+    s_stats.replies++;
+    bool latest = (s_reply_tag == TINYPAN_HEARTBEAT_NO_TAG) ? (s_round_probes == 1)
+                                                            : (s_reply_tag == s_tag);
+    if (!latest) {
+        TINYPAN_LOG_DEBUG("Heartbeat answered after a repeat, not timed");
+        return;
+    }
+
+    uint32_t r = s_reply_ms - s_sent_ms;
+    if (!s_have_rtt) {
+        s_rtt8 = r << 3;
+        s_stats.rtt_min_ms = r;
+        s_have_rtt = true;
+    } else {
+        s_rtt8 = s_rtt8 - (s_rtt8 >> 3) + r;
+    }
+    s_stats.rtt_last_ms = r;
+    if (r < s_stats.rtt_min_ms) {
+        s_stats.rtt_min_ms = r;
+    }
+    if (r > s_stats.rtt_max_ms) {
+        s_stats.rtt_max_ms = r;
+    }
+    TINYPAN_LOG_DEBUG("Heartbeat answered in %u ms", (unsigned)r);
+}
+
+/**
+ * @brief Received traffic restarts the idle time and answers a probe
+ */
+static void heartbeat_take_rx(void) {
+    if (!s_rx_pending) {
+        return;
+    }
+    s_rx_pending = false;
+    s_alive_ms = s_rx_ms;
+    s_probing = false;
+    s_misses = 0;
+}
+
+static void heartbeat_send_probe(uint32_t now) {
+    s_sent_ms = now;
+#if TINYPAN_ENABLE_LWIP
+    const tinypan_transport_t* transport = tinypan_transport_get();
+    uint8_t tag = (uint8_t)(s_tag + 1);
+    int sent = (transport->send_probe != NULL) ? transport->send_probe(tag)
+                                               : tinypan_netif_send_gateway_probe();
+    if (sent == 0) {
+        s_probing = true;
+        s_tag = tag;
+        s_round_probes++;
+        s_stats.probes++;
+        return;
+    }
+#endif
+    /* No gateway to ask, or a peer that cannot echo: only RX can tell */
+    s_alive_ms = now;
+}
+
+void tinypan_heartbeat_reset(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_running = false;
+    s_probing = false;
+    s_rx_pending = false;
+    s_reply_pending = false;
+    s_rtt8 = 0;
+    s_have_rtt = false;
+}
+
+void tinypan_heartbeat_start(void) {
+    s_running = true;
+    s_probing = false;
+    s_misses = 0;
+    s_rx_pending = false;
+    s_reply_pending = false;
+    s_alive_ms = hal_get_tick_ms();
+}
+
+void tinypan_heartbeat_rx(void) {
+    s_rx_ms = hal_get_tick_ms();
+    s_rx_pending = true;
+}
+
+void tinypan_heartbeat_reply(int tag) {
+    s_reply_ms = hal_get_tick_ms();
+    s_reply_tag = tag;
+    s_reply_pending = true;
+}
+
+bool tinypan_heartbeat_process(void) {
+    if (!s_running || heartbeat_interval_ms() == 0) {
+        return false;
+    }
+    uint32_t now = hal_get_tick_ms();
+    heartbeat_take_reply();
+    heartbeat_take_rx();
+
+    if (!s_probing) {
+        if (now - s_alive_ms >= heartbeat_interval_ms()) {
+            s_round_probes = 0;
+            heartbeat_send_probe(now);
+        }
+        return false;
+    }
+
+    if (now - s_sent_ms < TINYPAN_HEARTBEAT_TIMEOUT_MS) {
+        return false;
+    }
+    s_misses++;
+    s_stats.misses++;
+
+    uint8_t retries = tinypan_internal_get_config()->heartbeat_retries;
+    if (s_misses >= ((retries > 0) ? retries : 1)) {
+        TINYPAN_LOG_ERROR("Heartbeat: %u probes unanswered, link dead", (unsigned)s_misses);
+        s_stats.dead_links++;
+        s_running = false;
+        s_probing = false;
+        return true;
+    }
+    TINYPAN_LOG_WARN("Heartbeat: probe unanswered (%u/%u)", (unsigned)s_misses, (unsigned)retries);
+    heartbeat_send_probe(now);
+    return false;
+}
+
+uint32_t tinypan_heartbeat_next_ms(void) {
+    uint32_t interval = heartbeat_interval_ms();
+    if (!s_running || interval == 0) {
+        return 0xFFFFFFFF;
+    }
+
+    if (s_reply_pending) {
+        return 0; /* Time the reply */
+    }
+    uint32_t base = s_alive_ms;
+    uint32_t wait = interval;
+    if (s_rx_pending) {
+        base = s_rx_ms;
+    } else if (s_probing) {
+        base = s_sent_ms;
+        wait = TINYPAN_HEARTBEAT_TIMEOUT_MS;
+    }
+    uint32_t elapsed = hal_get_tick_ms() - base;
+    return (elapsed >= wait) ? 0 : (wait - elapsed);
+}
+
+void tinypan_heartbeat_get_stats(tinypan_heartbeat_stats_t* stats) {
+    *stats = s_stats;
+    stats->rtt_avg_ms = s_rtt8 >> 3;
+}
+
+#endif /* TINYPAN_ENABLE_HEARTBEAT */
@@ -0,0 +1,71 @@
+/*
+ * TinyPAN Link Heartbeat - Internal Header
+ *
+ * Idle-link monitoring while ONLINE (TINYPAN_ENABLE_HEARTBEAT). tinypan.c
+ * reports every received L2CAP packet, the lwIP netif reports the
+ * gateway's ARP replies (the SLIP transport its echo replies), and the
+ * supervisor runs the probe schedule and tears the link down when it is
+ * declared dead.
+ */
+
+#ifndef TINYPAN_HEARTBEAT_H
+#define TINYPAN_HEARTBEAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Stop monitoring and clear the statistics
+ */
+void tinypan_heartbeat_reset(void);
+
+/**
+ * @brief The link went ONLINE: the idle time starts now
+ */
+void tinypan_heartbeat_start(void);
+
+/**
+ * @brief Something was received (may run in the HAL's RX context)
+ */
+void tinypan_heartbeat_rx(void);
+
+/** Tag of a reply that cannot say which probe it answers (ARP) */
+#define TINYPAN_HEARTBEAT_NO_TAG    (-1)
+
+/**
+ * @brief A probe was answered (may run in the HAL's RX context)
+ * @param tag Tag of the probe answered, or TINYPAN_HEARTBEAT_NO_TAG
+ */
+void tinypan_heartbeat_reply(int tag);
+
+/**
+ * @brief Send or repeat a probe when due
+ *
+ * Called by the supervisor while ONLINE.
+ *
+ * @return true if the link is dead
+ */
+bool tinypan_heartbeat_process(void);
+
+/**
+ * @brief Milliseconds until tinypan_heartbeat_process() has work
+ * @return 0 if due, 0xFFFFFFFF if monitoring is off
+ */
+uint32_t tinypan_heartbeat_next_ms(void);
+
+/**
+ * @brief Counters and round-trip times
+ */
+void tinypan_heartbeat_get_stats(tinypan_heartbeat_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_HEARTBEAT_H */
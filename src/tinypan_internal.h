@@ -29,6 +29,17 @@ const tinypan_config_t* tinypan_internal_get_config(void);
  */
 uint32_t supervisor_get_next_timeout_ms(void);
 
+/**
+ * @brief Hand a received frame to its ethertype handler (TINYPAN_ENABLE_RAW_FRAMES)
+ *
+ * Runs wherever the transport delivers frames: tinypan_process(), or the
+ * HAL RX context with TINYPAN_RX_DIRECT.
+ *
+ * @return true if a handler took the frame, false to pass it to lwIP
+ */
+bool tinypan_internal_dispatch_frame(const uint8_t* dst_addr, const uint8_t* src_addr,
+                                     uint16_t ethertype, const uint8_t* payload, uint16_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,135 @@
+/*
+ * TinyPAN Link Capacity Estimator
+ *
+ * A window collects the bytes and frames delivered and the time the TX queue
+ * held at least one frame. Dividing by busy time rather than wall time
+ * measures what the link carries when it has work, so a producer that sends
+ * below capacity still sees the capacity. At the end of each window the
+ * rates and the mean service and queueing times are folded into an EWMA.
+ * A window in which the queue was never busy carries no information and
+ * leaves the estimate alone; a busy window without a completion is a rate
+ * sample of zero, so a stalled link decays the estimate.
+ */
+
+#include "tinypan_link_est.h"
+
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+
+#include "../include/tinypan_hal.h"
+
+#include <string.h>
+
+#if TINYPAN_LINK_EST_WINDOW_MS < 10
+#error "TINYPAN_LINK_EST_WINDOW_MS must be at least 10"
+#endif
+
+#if TINYPAN_LINK_EST_EWMA_SHIFT < 0 || TINYPAN_LINK_EST_EWMA_SHIFT > 4
+#error "TINYPAN_LINK_EST_EWMA_SHIFT must be between 0 and 4"
+#endif
+
+typedef struct {
+    uint32_t start_ms;          /**< Window start */
+    uint32_t busy_ms;           /**< Queue busy time closed so far in this window */
+    uint32_t bytes;
+    uint32_t frames;
+    uint32_t service_ms;        /**< Sum over the completed frames */
+    uint32_t started;
+    uint32_t queue_ms;          /**< Sum over the started frames */
+} link_est_window_t;
+
+static link_est_window_t s_win;
+static bool s_busy = false;
+static uint32_t s_busy_since_ms = 0;
+static tinypan_link_estimate_t s_est;
+
+static uint32_t ewma(uint32_t avg, uint32_t sample) {
+    if (sample >= avg) {
+        return avg + ((sample - avg) >> TINYPAN_LINK_EST_EWMA_SHIFT);
+    }
+    return avg - ((avg - sample) >> TINYPAN_LINK_EST_EWMA_SHIFT);
+}
+
+/**
+ * @brief Close the window if it is due
+ */
+static void link_est_roll(uint32_t now) {
+    if (now - s_win.start_ms < TINYPAN_LINK_EST_WINDOW_MS) {
+        return;
+    }
+
+    uint32_t busy_ms = s_win.busy_ms;
+    if (s_busy) {
+        busy_ms += now - s_busy_since_ms;
+        s_busy_since_ms = now;
+    }
+    if (busy_ms == 0 && s_win.frames > 0) {
+        busy_ms = 1; /* Frames faster than the tick */
+    }
+
+    if (busy_ms > 0) {
+        /* 64-bit: a window of a few seconds at several MB/s overflows 32 */
+        uint32_t bytes_per_s = (uint32_t)(((uint64_t)s_win.bytes * 1000u) / busy_ms);
+        uint32_t frames_per_s = (uint32_t)(((uint64_t)s_win.frames * 1000u) / busy_ms);
+        bool first = (s_est.windows == 0); /* Taken as is */
+
+        s_est.tx_bytes_per_s = first ? bytes_per_s : ewma(s_est.tx_bytes_per_s, bytes_per_s);
+        s_est.tx_frames_per_s = first ? frames_per_s : ewma(s_est.tx_frames_per_s, frames_per_s);
+        /* Times only move with frames that were actually timed */
+        if (s_win.frames > 0) {
+            uint32_t service_us = (uint32_t)(((uint64_t)s_win.service_ms * 1000u) / s_win.frames);
+            s_est.service_time_us = first ? service_us : ewma(s_est.service_time_us, service_us);
+        }
+        if (s_win.started > 0) {
+            uint32_t queue_us = (uint32_t)(((uint64_t)s_win.queue_ms * 1000u) / s_win.started);
+            s_est.queue_delay_us = first ? queue_us : ewma(s_est.queue_delay_us, queue_us);
+        }
+        s_est.windows++;
+    }
+
+    memset(&s_win, 0, sizeof(s_win));
+    s_win.start_ms = now;
+}
+
+void tinypan_link_est_reset(void) {
+    memset(&s_win, 0, sizeof(s_win));
+    memset(&s_est, 0, sizeof(s_est));
+    s_win.start_ms = hal_get_tick_ms();
+    s_busy = false;
+    s_busy_since_ms = 0;
+}
+
+void tinypan_link_est_set_busy(bool busy) {
+    uint32_t now = hal_get_tick_ms();
+    if (busy == s_busy) {
+        return;
+    }
+    if (busy) {
+        s_busy_since_ms = now;
+    } else {
+        s_win.busy_ms += now - s_busy_since_ms;
+    }
+    s_busy = busy;
+}
+
+void tinypan_link_est_started(uint32_t queued_at_ms) {
+    s_win.started++;
+    s_win.queue_ms += hal_get_tick_ms() - queued_at_ms;
+}
+
+void tinypan_link_est_completed(uint16_t len, uint32_t queued_at_ms) {
+    uint32_t now = hal_get_tick_ms();
+    s_win.bytes += len;
+    s_win.frames++;
+    s_win.service_ms += now - queued_at_ms;
+    link_est_roll(now);
+}
+
+void tinypan_link_est_process(void) {
+    link_est_roll(hal_get_tick_ms());
+}
+
+void tinypan_link_est_get(tinypan_link_estimate_t* estimate) {
+    memcpy(estimate, &s_est, sizeof(*estimate));
+}
+
+#endif /* TINYPAN_ENABLE_LINK_ESTIMATE */
@@ -0,0 +1,65 @@
+/*
+ * TinyPAN Link Capacity Estimator - Internal Header
+ *
+ * Running estimate of TX goodput, per-frame service time and queueing delay
+ * (TINYPAN_ENABLE_LINK_ESTIMATE). The transports report frames as they are
+ * handed to the HAL and as they complete; the TX queue accounting in
+ * tinypan_transport.c reports when the queue turns busy or idle. All of
+ * these, and tinypan_link_est_process() from the transport's process op,
+ * run with the transport's TX lock held.
+ * tinypan.c exposes it as tinypan_get_link_estimate().
+ */
+
+#ifndef TINYPAN_LINK_EST_H
+#define TINYPAN_LINK_EST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Forget the estimate and start a new window
+ */
+void tinypan_link_est_reset(void);
+
+/**
+ * @brief The TX queue went from empty to non-empty, or back
+ */
+void tinypan_link_est_set_busy(bool busy);
+
+/**
+ * @brief A frame was handed to the HAL
+ * @param queued_at_ms Tick at which it was enqueued
+ */
+void tinypan_link_est_started(uint32_t queued_at_ms);
+
+/**
+ * @brief A frame was delivered
+ * @param len          Bytes carried
+ * @param queued_at_ms Tick at which it was enqueued
+ */
+void tinypan_link_est_completed(uint16_t len, uint32_t queued_at_ms);
+
+/**
+ * @brief Close the window if it has run out, also on a link that completes nothing
+ */
+void tinypan_link_est_process(void);
+
+/**
+ * @brief Copy out the current estimate
+ *
+ * Under the TX lock like the rest; tinypan_get_link_estimate() goes
+ * through the transport's link_estimate op to take it.
+ */
+void tinypan_link_est_get(tinypan_link_estimate_t* estimate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_LINK_EST_H */
@@ -29,6 +29,42 @@
 #include "lwip/ip.h"
 #endif
 
+#if TINYPAN_ENABLE_DHCP_CACHE || TINYPAN_ENABLE_DHCP_PAN_PROFILE
+#include "lwip/prot/dhcp.h"
+#endif
+
+#if TINYPAN_ENABLE_HEARTBEAT
+#include "tinypan_heartbeat.h"
+#endif
+
+#if TINYPAN_ENABLE_LINK_TRUST
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip4.h"
+#endif
+
+#if LWIP_DNS
+#include "lwip/dns.h"
+#else
+#include "tinypan_dhcp_dns.h"
+#endif
+
+#if TINYPAN_ENABLE_DHCP_CACHE
+#include "tinypan_dhcp_cache.h"
+#endif
+
+#if TINYPAN_ENABLE_DNS_CACHE
+#include "tinypan_dns.h"
+#endif
+
+#if TINYPAN_ENABLE_UDP_FAST
+#include "tinypan_udp_fast.h"
+#endif
+
+#if TINYPAN_ENABLE_ZERO_COPY_TX
+#include "tinypan_zc_tx.h"
+#endif
+
 #include "tinypan_transport.h"
 
 #include <string.h>
@@ -44,6 +80,26 @@
 /** MTU - standard Ethernet */
 #define TINYPAN_MTU 1500
 
+/** Gateway ARP preload also needs lwIP's static ARP entries */
+#define TINYPAN_GATEWAY_ARP_PRELOAD \
+    (TINYPAN_ENABLE_GATEWAY_ARP_PRELOAD && LWIP_ARP && ETHARP_SUPPORT_STATIC_ENTRIES)
+
+/** Trusted-link RX needs lwIP's per-netif checksum control */
+#define TINYPAN_LINK_TRUST \
+    (TINYPAN_ENABLE_LINK_TRUST && LWIP_CHECKSUM_CTRL_PER_NETIF)
+
+#if TINYPAN_LINK_TRUST && TINYPAN_LINK_TRUST_SAMPLE_RATE < 1
+#error "TINYPAN_LINK_TRUST_SAMPLE_RATE must be at least 1"
+#endif
+
+/** Checks lwIP skips on a trusted link (sampled frames are verified here) */
+#define TINYPAN_TRUSTED_CHECKS \
+    (NETIF_CHECKSUM_CHECK_IP | NETIF_CHECKSUM_CHECK_UDP | NETIF_CHECKSUM_CHECK_TCP)
+
+/** Fast DHCP retransmission drives lwIP's DHCP client from this thread */
+#define TINYPAN_DHCP_FAST_RETX \
+    (TINYPAN_ENABLE_DHCP_PAN_PROFILE && NO_SYS)
+
 /* ============================================================================
  * Static State
  * ============================================================================ */
@@ -57,6 +113,38 @@ static bool s_initialized = false;
 /** Local MAC address (derived from Bluetooth address) */
 static uint8_t s_mac_addr[6] = {0};
 
+#if TINYPAN_GATEWAY_ARP_PRELOAD
+/** Gateway currently pinned in the ARP table (0 = none) */
+static ip4_addr_t s_pinned_gw;
+#endif
+
+#if TINYPAN_ENABLE_DHCP_CACHE
+/** A cached lease is being confirmed with INIT-REBOOT */
+static bool s_lease_pending = false;
+
+/** DHCP client state seen by the last tinypan_netif_process() */
+static uint8_t s_dhcp_seen_state = DHCP_STATE_OFF;
+#endif
+
+#if TINYPAN_DHCP_FAST_RETX
+/** DHCP client state the retransmission schedule belongs to */
+static uint8_t s_retx_state = DHCP_STATE_OFF;
+
+/** Tick of the next forced retransmission */
+static uint32_t s_retx_at = 0;
+
+/** Current retransmission delay (doubles up to TINYPAN_DHCP_RETX_MAX_MS) */
+static uint32_t s_retx_delay = 0;
+#endif
+
+#if TINYPAN_LINK_TRUST
+/** Trusted-link counters (reset by tinypan_netif_init()) */
+static tinypan_checksum_stats_t s_trust;
+
+/** IPv4 frames until the next sampled one */
+static uint32_t s_trust_countdown = 0;
+#endif
+
 /* The active transport layer handles TX/RX queues and sio interfaces */
 
 /*
@@ -128,10 +216,73 @@ static err_t tinypan_netif_linkoutput(struct netif* netif, struct pbuf* p) {
     return ERR_IF;
 }
 
+/* ============================================================================
+ * Gateway ARP Preload
+ * ============================================================================ */
+
+#if TINYPAN_GATEWAY_ARP_PRELOAD
+static void tinypan_netif_unpin_gateway(void) {
+    if (ip4_addr_isany_val(s_pinned_gw)) {
+        return;
+    }
+    etharp_remove_static_entry(&s_pinned_gw);
+    ip4_addr_set_zero(&s_pinned_gw);
+}
+
+/**
+ * @brief Pin the gateway to the NAP's MAC (its BD_ADDR, as used by BNEP)
+ *
+ * Called before the rest of TinyPAN learns the address, so the first packet
+ * sent from the IP_ACQUIRED handler already goes out without an ARP request.
+ */
+static void tinypan_netif_pin_gateway(const ip4_addr_t* gw) {
+    if (ip4_addr_cmp(gw, &s_pinned_gw)) {
+        return;
+    }
+    tinypan_netif_unpin_gateway();
+    if (ip4_addr_isany(gw) || tinypan_transport_get() == &transport_slip) {
+        return;
+    }
+
+#if LWIP_DHCP
+    /* If DHCP came from elsewhere, the NAP is a bridge and the router is another host */
+    const struct dhcp* dhcp = netif_dhcp_data(&s_netif);
+    if (dhcp != NULL) {
+        uint32_t server = ip4_addr_get_u32(ip_2_ip4(&dhcp->server_ip_addr));
+        if (server != 0 && server != ip4_addr_get_u32(gw)) {
+            TINYPAN_LOG_DEBUG("netif: Gateway is not the DHCP server, not pinning it");
+            return;
+        }
+    }
+#endif
+
+    struct eth_addr mac;
+    memcpy(mac.addr, tinypan_internal_get_config()->remote_addr, ETH_HWADDR_LEN);
+    err_t err = etharp_add_static_entry(gw, &mac);
+    if (err != ERR_OK) {
+        TINYPAN_LOG_WARN("netif: Could not pin gateway in ARP table: %d", err);
+        return;
+    }
+    ip4_addr_copy(s_pinned_gw, *gw);
+    TINYPAN_LOG_DEBUG("netif: Gateway pinned to NAP MAC in ARP table");
+}
+#endif /* TINYPAN_GATEWAY_ARP_PRELOAD */
+
 /* ============================================================================
  * Status Callback
  * ============================================================================ */
 
+/**
+ * @brief First DNS server from the DHCP lease (network byte order, 0 = none)
+ */
+static uint32_t tinypan_netif_dns_server(void) {
+#if LWIP_DNS
+    return ip4_addr_get_u32(ip_2_ip4(dns_getserver(0)));
+#else
+    return tinypan_dhcp_dns_get();
+#endif
+}
+
 /**
  * @brief Called when netif status changes (IP assigned, etc.)
  */
@@ -153,9 +304,20 @@ static void tinypan_netif_status_callback(struct netif* netif) {
                              ip4_addr1(mask), ip4_addr2(mask),
                              ip4_addr3(mask), ip4_addr4(mask));
             
+            uint32_t dns = tinypan_netif_dns_server();
+            const uint8_t* d = (const uint8_t*)&dns;
+            TINYPAN_LOG_INFO("  DNS:     %d.%d.%d.%d", d[0], d[1], d[2], d[3]);
+            
+#if TINYPAN_GATEWAY_ARP_PRELOAD
+            tinypan_netif_pin_gateway(gw);
+#endif
+            
             /* Notify the main TinyPAN module */
-            tinypan_internal_set_ip(ip->addr, mask->addr, gw->addr, 0);
+            tinypan_internal_set_ip(ip->addr, mask->addr, gw->addr, dns);
         } else {
+#if TINYPAN_GATEWAY_ARP_PRELOAD
+            tinypan_netif_unpin_gateway();
+#endif
             /* Link desync recovery: clear IP if address is lost/expired */
             tinypan_internal_clear_ip();
         }
@@ -219,6 +381,32 @@ int tinypan_netif_init(void) {
     
     /* Set as default interface */
     netif_set_default(&s_netif);
+
+#if TINYPAN_LINK_TRUST
+    memset(&s_trust, 0, sizeof(s_trust));
+    s_trust_countdown = 0;
+    NETIF_SET_CHECKSUM_CTRL(&s_netif, NETIF_CHECKSUM_ENABLE_ALL & ~TINYPAN_TRUSTED_CHECKS);
+#endif
+
+#if TINYPAN_ENABLE_DHCP_CACHE
+    dhcp_cache_init();
+    s_lease_pending = false;
+    s_dhcp_seen_state = DHCP_STATE_OFF;
+#endif
+
+#if TINYPAN_ENABLE_DNS_CACHE
+    if (tinypan_dns_init() != 0) {
+        TINYPAN_LOG_WARN("netif: Resolver cache unavailable");
+    }
+#endif
+
+#if TINYPAN_ENABLE_ZERO_COPY_TX
+    tinypan_zc_tx_init();
+#endif
+
+#if TINYPAN_ENABLE_UDP_FAST
+    tinypan_udp_fast_init();
+#endif
     
     s_initialized = true;
     
@@ -231,16 +419,164 @@ void tinypan_netif_deinit(void) {
         return;
     }
     
+#if TINYPAN_ENABLE_DNS_CACHE
+    tinypan_dns_deinit();
+#endif
+
+#if TINYPAN_ENABLE_UDP_FAST
+    tinypan_udp_fast_deinit();
+#endif
+
     /* Stop DHCP if running */
     dhcp_stop(&s_netif);
     
     /* Remove the interface */
     netif_remove(&s_netif);
+#if TINYPAN_GATEWAY_ARP_PRELOAD
+    ip4_addr_set_zero(&s_pinned_gw);
+#endif
     
     s_initialized = false;
     TINYPAN_LOG_INFO("netif: De-initialized");
 }
 
+#if TINYPAN_ENABLE_DHCP_CACHE
+/**
+ * @brief Start DHCP from a cached lease with INIT-REBOOT (RFC 2131 3.2)
+ *
+ * lwIP has no public INIT-REBOOT entry point, but it sends one from
+ * dhcp_network_changed() when the link comes up on a bound client. So the
+ * client is started with the link down (it parks in INIT), primed with the
+ * cached lease as if bound, and the link is raised again.
+ *
+ * @param use_now Apply the cached address immediately instead of waiting
+ *                for the ACK
+ */
+static err_t tinypan_netif_start_cached_dhcp(const dhcp_cache_lease_t* lease, bool use_now) {
+    netif_set_link_down(&s_netif);
+    err_t err = dhcp_start(&s_netif);
+    struct dhcp* dhcp = netif_dhcp_data(&s_netif);
+    if (err != ERR_OK || dhcp == NULL) {
+        netif_set_link_up(&s_netif);
+        return (err != ERR_OK) ? err : ERR_MEM;
+    }
+
+    ip4_addr_set_u32(&dhcp->offered_ip_addr, lease->ip_addr);
+    ip4_addr_set_u32(&dhcp->offered_sn_mask, lease->netmask);
+    ip4_addr_set_u32(&dhcp->offered_gw_addr, lease->gateway);
+    ip_addr_set_ip4_u32(&dhcp->server_ip_addr, lease->server_id);
+    dhcp->state = DHCP_STATE_BOUND;
+    /* Until the ACK brings a fresh one */
+#if LWIP_DNS
+    ip_addr_t dns_server;
+    ip_addr_set_ip4_u32(&dns_server, lease->dns_server);
+    dns_setserver(0, &dns_server);
+#else
+    tinypan_dhcp_dns_set(lease->dns_server);
+#endif
+
+    s_lease_pending = true;
+    netif_set_link_up(&s_netif);    /* -> dhcp_network_changed() -> dhcp_reboot() */
+
+    if (use_now) {
+        /* Lease still valid: go online now, the REQUEST confirms it in the background.
+         * Applied with the link up so the gateway is routable for the ARP preload. */
+        netif_set_addr(&s_netif, &dhcp->offered_ip_addr, &dhcp->offered_sn_mask,
+                       &dhcp->offered_gw_addr);
+    }
+    return ERR_OK;
+}
+
+/**
+ * @brief Feed lease changes from the DHCP client into the cache
+ */
+static void tinypan_netif_track_lease(void) {
+    const struct dhcp* dhcp = netif_dhcp_data(&s_netif);
+    uint8_t state = (dhcp != NULL) ? dhcp->state : (uint8_t)DHCP_STATE_OFF;
+    if (state == s_dhcp_seen_state) {
+        return;
+    }
+    s_dhcp_seen_state = state;
+
+    const tinypan_config_t* config = tinypan_internal_get_config();
+    if (state == DHCP_STATE_BOUND) {
+        if (s_lease_pending) {
+            TINYPAN_LOG_INFO("netif: Cached lease confirmed by the NAP");
+        }
+        s_lease_pending = false;
+
+        dhcp_cache_lease_t lease;
+        memset(&lease, 0, sizeof(lease));
+        memcpy(lease.peer, config->remote_addr, HAL_BD_ADDR_LEN);
+        lease.ip_addr = netif_ip4_addr(&s_netif)->addr;
+        lease.netmask = netif_ip4_netmask(&s_netif)->addr;
+        lease.gateway = netif_ip4_gw(&s_netif)->addr;
+        lease.dns_server = tinypan_netif_dns_server();
+        lease.server_id = ip4_addr_get_u32(ip_2_ip4(&dhcp->server_ip_addr));
+        lease.lease_s = dhcp->offered_t0_lease;
+        lease.bound_ms = hal_get_tick_ms();
+        lease.timed = true;
+        dhcp_cache_store(&lease);
+    } else if (s_lease_pending && state != DHCP_STATE_REBOOTING) {
+        /* NAK (BACKING_OFF) or no answer (SELECTING): lwIP fell back to discovery */
+        TINYPAN_LOG_WARN("netif: Cached lease rejected, falling back to discovery");
+        s_lease_pending = false;
+        dhcp_cache_invalidate(config->remote_addr);
+    }
+}
+#endif /* TINYPAN_ENABLE_DHCP_CACHE */
+
+#if TINYPAN_DHCP_FAST_RETX
+/**
+ * @brief Resend unanswered DHCP messages on the PAN schedule
+ *
+ * While the client waits for an OFFER or ACK, lwIP's own retransmit timer
+ * (DHCP_FINE_TIMER_MSECS ticks, exponential from 2 s) is disarmed and the
+ * timeout is fired from here instead, after TINYPAN_DHCP_RETX_INITIAL_MS
+ * and then doubling. lwIP still counts the attempts in dhcp->tries, so its
+ * fallbacks (REQUEST -> DISCOVER, INIT-REBOOT -> DISCOVER) happen as usual,
+ * only sooner.
+ */
+static void tinypan_netif_dhcp_retransmit(void) {
+    struct dhcp* dhcp = netif_dhcp_data(&s_netif);
+    uint8_t state = (dhcp != NULL) ? dhcp->state : (uint8_t)DHCP_STATE_OFF;
+    bool waiting = (state == DHCP_STATE_SELECTING || state == DHCP_STATE_REQUESTING ||
+                    state == DHCP_STATE_REBOOTING) && netif_is_link_up(&s_netif);
+    uint32_t now = hal_get_tick_ms();
+
+    if (!waiting) {
+        s_retx_state = state;
+        return;
+    }
+    if (state != s_retx_state) {
+        /* A new message went out on entry: start the schedule over */
+        s_retx_state = state;
+        s_retx_delay = TINYPAN_DHCP_RETX_INITIAL_MS;
+        s_retx_at = now + s_retx_delay;
+        dhcp->request_timeout = 0;
+        return;
+    }
+    if ((int32_t)(now - s_retx_at) < 0) {
+        return;
+    }
+
+    TINYPAN_LOG_DEBUG("netif: DHCP retransmit (state %u, try %u)",
+                      (unsigned)state, (unsigned)dhcp->tries);
+    dhcp->request_timeout = 1;
+    dhcp_fine_tmr();                /* 1 -> 0: dhcp_timeout() resends */
+
+    dhcp = netif_dhcp_data(&s_netif);
+    if (dhcp != NULL) {
+        dhcp->request_timeout = 0;
+    }
+    s_retx_delay *= 2;
+    if (s_retx_delay > TINYPAN_DHCP_RETX_MAX_MS) {
+        s_retx_delay = TINYPAN_DHCP_RETX_MAX_MS;
+    }
+    s_retx_at = now + s_retx_delay;
+}
+#endif /* TINYPAN_DHCP_FAST_RETX */
+
 int tinypan_netif_start_dhcp(void) {
     if (!s_initialized) {
         TINYPAN_LOG_ERROR("netif: Not initialized");
@@ -258,6 +594,36 @@ int tinypan_netif_start_dhcp(void) {
         return -1;
     }
 
+#if TINYPAN_DHCP_FAST_RETX
+    s_retx_state = DHCP_STATE_OFF;
+#endif
+
+#if !LWIP_DNS
+    tinypan_dhcp_dns_set(0);
+#endif
+
+#if TINYPAN_ENABLE_DHCP_CACHE
+    const tinypan_config_t* config = tinypan_internal_get_config();
+    if (s_lease_pending) {
+        /* Restarted before the cached lease was confirmed: don't trust it again */
+        dhcp_cache_invalidate(config->remote_addr);
+        s_lease_pending = false;
+    }
+    s_dhcp_seen_state = DHCP_STATE_OFF;
+
+    dhcp_cache_lease_t lease;
+    dhcp_cache_result_t cached = dhcp_cache_lookup(config->remote_addr, &lease);
+    if (cached != DHCP_CACHE_MISS) {
+        dhcp_stop(&s_netif);
+        TINYPAN_LOG_INFO("netif: Reusing cached lease (%s)",
+                         (cached == DHCP_CACHE_VALID) ? "valid" : "INIT-REBOOT");
+        if (tinypan_netif_start_cached_dhcp(&lease, cached == DHCP_CACHE_VALID) == ERR_OK) {
+            return 0;
+        }
+        TINYPAN_LOG_WARN("netif: Cached lease start failed, using discovery");
+    }
+#endif
+
     dhcp_stop(&s_netif);
     err_t err = dhcp_start(&s_netif);
     if (err != ERR_OK) {
@@ -274,6 +640,15 @@ void tinypan_netif_stop_dhcp(void) {
     }
     
     dhcp_stop(&s_netif);
+
+#if TINYPAN_ENABLE_DHCP_CACHE
+    if (s_lease_pending) {
+        /* dhcp_stop() only clears addresses lwIP considers bound */
+        netif_set_addr(&s_netif, IP4_ADDR_ANY4, IP4_ADDR_ANY4, IP4_ADDR_ANY4);
+        s_lease_pending = false;
+    }
+    s_dhcp_seen_state = DHCP_STATE_OFF;
+#endif
     TINYPAN_LOG_INFO("netif: DHCP stopped");
 }
 
@@ -287,12 +662,140 @@ void tinypan_netif_set_link(bool up) {
         netif_set_up(&s_netif);
         TINYPAN_LOG_INFO("netif: Link UP");
     } else {
+#if TINYPAN_GATEWAY_ARP_PRELOAD
+        /* The NAP is gone; a reconnect pins the gateway again */
+        tinypan_netif_unpin_gateway();
+#endif
         netif_set_link_down(&s_netif);
         netif_set_down(&s_netif);
         TINYPAN_LOG_INFO("netif: Link DOWN");
     }
 }
 
+#if TINYPAN_LINK_TRUST
+/**
+ * @brief Verify the IPv4 header and UDP/TCP checksums of a whole datagram
+ *
+ * Malformed headers pass: lwIP's own length checks drop them. Fragments
+ * only get the header check, since the transport checksum spans them all.
+ */
+static bool tinypan_netif_verify_ipv4(struct pbuf* p) {
+    const uint8_t* ip = (const uint8_t*)p->payload;
+    if (p->len < IP_HLEN || (ip[0] >> 4) != 4) {
+        return true;
+    }
+    uint16_t hlen = (uint16_t)((ip[0] & 0x0F) * 4);
+    uint16_t tot_len = (uint16_t)((ip[2] << 8) | ip[3]);
+    if (hlen < IP_HLEN || hlen > p->len || tot_len < hlen || tot_len > p->tot_len) {
+        return true;
+    }
+    if (inet_chksum(ip, hlen) != 0) {
+        return false;
+    }
+    if ((ip[6] & 0x3F) != 0 || ip[7] != 0) {
+        return true;    /* Fragment (MF set or non-zero offset) */
+    }
+
+    uint8_t proto = ip[9];
+    if (proto != IP_PROTO_UDP && proto != IP_PROTO_TCP) {
+        return true;
+    }
+    ip4_addr_t src, dst;
+    memcpy(&src.addr, ip + 12, 4);
+    memcpy(&dst.addr, ip + 16, 4);
+    uint16_t proto_len = (uint16_t)(tot_len - hlen);
+
+    bool ok = true;
+    pbuf_remove_header(p, hlen);
+    const uint8_t* th = (const uint8_t*)p->payload;
+    if (proto == IP_PROTO_UDP) {
+        /* A zero UDP checksum means "not computed" */
+        if (proto_len >= 8 && p->len >= 8 && (th[6] | th[7]) != 0) {
+            ok = inet_chksum_pseudo_partial(p, proto, proto_len, proto_len, &src, &dst) == 0;
+        }
+    } else if (proto_len >= 20) {
+        ok = inet_chksum_pseudo_partial(p, proto, proto_len, proto_len, &src, &dst) == 0;
+    }
+    pbuf_add_header(p, hlen);
+    return ok;
+}
+#endif /* TINYPAN_LINK_TRUST */
+
+bool tinypan_netif_rx_admit(struct pbuf* p, uint16_t ip_offset) {
+#if TINYPAN_LINK_TRUST
+    if (p == NULL || s_trust.full_checking) {
+        return true;    /* lwIP verifies everything itself */
+    }
+    if (s_trust_countdown > 0) {
+        s_trust_countdown--;
+        s_trust.checks_skipped++;
+        return true;
+    }
+    s_trust_countdown = TINYPAN_LINK_TRUST_SAMPLE_RATE - 1;
+    s_trust.frames_sampled++;
+
+    if (pbuf_remove_header(p, ip_offset) != 0) {
+        return true;
+    }
+    bool ok = tinypan_netif_verify_ipv4(p);
+    pbuf_add_header(p, ip_offset);
+    if (ok) {
+        return true;
+    }
+
+    s_trust.failures++;
+    s_trust.full_checking = true;
+    NETIF_SET_CHECKSUM_CTRL(&s_netif, NETIF_CHECKSUM_ENABLE_ALL);
+    TINYPAN_LOG_WARN("netif: Sampled RX frame failed its checksum, verifying every frame from now on");
+    return false;
+#else
+    (void)p;
+    (void)ip_offset;
+    return true;
+#endif
+}
+
+void tinypan_netif_get_checksum_stats(tinypan_checksum_stats_t* stats) {
+#if TINYPAN_LINK_TRUST
+    *stats = s_trust;
+#else
+    memset(stats, 0, sizeof(*stats));
+    stats->full_checking = true;
+#endif
+}
+
+#if TINYPAN_ENABLE_HEARTBEAT
+int tinypan_netif_send_gateway_probe(void) {
+    if (!s_initialized || !(s_netif.flags & NETIF_FLAG_ETHARP)) {
+        return -1;
+    }
+    const ip4_addr_t* gw = netif_ip4_gw(&s_netif);
+    if (ip4_addr_isany(gw)) {
+        return -1;
+    }
+    /* A full TX queue loses the probe, which then counts as a miss */
+    err_t err = etharp_request(&s_netif, gw);
+    if (err != ERR_OK) {
+        TINYPAN_LOG_DEBUG("netif: Heartbeat probe not sent: %d", err);
+    }
+    return 0;
+}
+
+/**
+ * @brief Report an ARP reply from the gateway to the heartbeat
+ */
+static void tinypan_netif_check_probe_reply(const uint8_t* arp, uint16_t len) {
+    /* htype(2) ptype(2) hlen plen oper(2) sha(6) spa(4) tha(6) tpa(4) */
+    if (arp == NULL || len < 28 || arp[6] != 0x00 || arp[7] != 0x02) {
+        return;
+    }
+    uint32_t gw = netif_ip4_gw(&s_netif)->addr;
+    if (gw != 0 && memcmp(arp + 14, &gw, 4) == 0) {
+        tinypan_heartbeat_reply(TINYPAN_HEARTBEAT_NO_TAG);
+    }
+}
+#endif
+
 void tinypan_netif_input(const uint8_t* dst_addr, const uint8_t* src_addr,
                           uint16_t ethertype, const uint8_t* payload,
                           uint16_t payload_len) {
@@ -311,6 +814,12 @@ void tinypan_netif_input(const uint8_t* dst_addr, const uint8_t* src_addr,
         return;
     }
 
+#if TINYPAN_ENABLE_HEARTBEAT
+    if (ethertype == ETHTYPE_ARP) {
+        tinypan_netif_check_probe_reply(payload, payload_len);
+    }
+#endif
+
     uint16_t total_len = 14 + payload_len;
     TINYPAN_LOG_DEBUG("netif RX: %u bytes", total_len);
     
@@ -345,6 +854,11 @@ void tinypan_netif_input(const uint8_t* dst_addr, const uint8_t* src_addr,
 #if defined(ETH_PAD_SIZE) && ETH_PAD_SIZE > 0
     pbuf_add_header(p, ETH_PAD_SIZE); /* Restore padding space before handing to lwIP */
 #endif
+
+    if (ethertype == ETHTYPE_IP && !tinypan_netif_rx_admit(p, (uint16_t)(14 + ETH_PAD_SIZE))) {
+        pbuf_free(p);
+        return;
+    }
     
     /* Pass to lwIP input. In RTOS/NO_SYS=0 environments, we MUST use tcpip_input
      * to ensure thread-safety. In bare-metal/NO_SYS=1, netif->input is safe. */
@@ -393,6 +907,13 @@ uint32_t tinypan_netif_get_netmask(void) {
     return netif_ip4_netmask(&s_netif)->addr;
 }
 
+uint16_t tinypan_netif_get_mtu(void) {
+    if (!s_initialized) {
+        return 0;
+    }
+    return s_netif.mtu;
+}
+
 /* ============================================================================
  * lwIP Timeout Processing
  * ============================================================================ */
@@ -413,6 +934,43 @@ void tinypan_netif_process(void) {
 #if NO_SYS
     sys_check_timeouts();
 #endif
+
+#if TINYPAN_DHCP_FAST_RETX
+    tinypan_netif_dhcp_retransmit();
+#endif
+
+#if TINYPAN_ENABLE_DHCP_CACHE
+    tinypan_netif_track_lease();
+#endif
+
+#if TINYPAN_ENABLE_DNS_CACHE
+    tinypan_dns_process();
+#endif
+}
+
+uint32_t tinypan_netif_get_next_timeout_ms(void) {
+    uint32_t sleep_ms = 0xFFFFFFFF;
+    if (!s_initialized) {
+        return sleep_ms;
+    }
+
+#if TINYPAN_DHCP_FAST_RETX
+    const struct dhcp* dhcp = netif_dhcp_data(&s_netif);
+    if (s_retx_state != DHCP_STATE_OFF && dhcp != NULL &&
+        dhcp->state == s_retx_state && dhcp->request_timeout == 0) {
+        uint32_t left = s_retx_at - hal_get_tick_ms();
+        sleep_ms = ((int32_t)left < 0) ? 0 : left;
+    }
+#endif
+
+#if TINYPAN_ENABLE_DNS_CACHE
+    uint32_t dns_sleep = tinypan_dns_get_next_timeout_ms();
+    if (dns_sleep < sleep_ms) {
+        sleep_ms = dns_sleep;
+    }
+#endif
+
+    return sleep_ms;
 }
 
 void tinypan_netif_flush_queue(void) {
@@ -9,13 +9,15 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "../include/tinypan.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Forward declaration for lwIP netif */
+/* Forward declarations for lwIP types */
 struct netif;
+struct pbuf;
 
 /**
  * @brief Initialize the TinyPAN network interface
@@ -113,6 +115,13 @@ uint32_t tinypan_netif_get_gateway(void);
  */
 uint32_t tinypan_netif_get_netmask(void);
 
+/**
+ * @brief Get the interface MTU
+ * 
+ * @return MTU in bytes, or 0 if not initialized
+ */
+uint16_t tinypan_netif_get_mtu(void);
+
 /**
  * @brief Process lwIP timeout/timer callbacks
  *
@@ -120,6 +129,43 @@ uint32_t tinypan_netif_get_netmask(void);
  */
 void tinypan_netif_process(void);
 
+/**
+ * @brief Milliseconds until tinypan_netif_process() has work to do
+ *
+ * Covers the PAN profile's DHCP retransmissions and the resolver cache's
+ * resends and prefetches, which run outside lwIP's own timers.
+ *
+ * @return Milliseconds, or 0xFFFFFFFF if nothing is scheduled
+ */
+uint32_t tinypan_netif_get_next_timeout_ms(void);
+
+/**
+ * @brief Trusted-link RX admission (TINYPAN_ENABLE_LINK_TRUST)
+ *
+ * Called by the transports for each received IPv4 frame before it is
+ * handed to lwIP. Verifies one frame in TINYPAN_LINK_TRUST_SAMPLE_RATE.
+ *
+ * @param p         Received frame
+ * @param ip_offset Offset of the IPv4 header in p
+ * @return false if the frame was sampled and failed verification (drop it)
+ */
+bool tinypan_netif_rx_admit(struct pbuf* p, uint16_t ip_offset);
+
+/**
+ * @brief Fill trusted-link checksum statistics
+ */
+void tinypan_netif_get_checksum_stats(tinypan_checksum_stats_t* stats);
+
+/**
+ * @brief Send an ARP request for the gateway (TINYPAN_ENABLE_HEARTBEAT)
+ *
+ * The reply is reported to tinypan_heartbeat_reply() by
+ * tinypan_netif_input().
+ *
+ * @return 0 if sent (or lost on a full queue), -1 if there is no gateway
+ *         or the link does not use ARP
+ */
+int tinypan_netif_send_gateway_probe(void);
 /**
  * @brief Drain the transmission queue
  * 
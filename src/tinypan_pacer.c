@@ -0,0 +1,112 @@
+/*
+ * TinyPAN Egress Pacer
+ *
+ * Deficit token bucket in milli-bytes (bytes x 1000), so a refill over a
+ * single millisecond tick at a low rate does not round to nothing. A send
+ * is admitted while the bucket is not in debt and takes its full length,
+ * which can leave it in debt; the next release is when the debt is paid
+ * off. The bucket holds at most TINYPAN_PACING_BURST_BYTES.
+ */
+
+#include "tinypan_pacer.h"
+
+#if TINYPAN_ENABLE_PACING
+
+#include "../include/tinypan_hal.h"
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+#include "tinypan_link_est.h"
+#endif
+
+#if TINYPAN_PACING_BURST_BYTES < 1
+#error "TINYPAN_PACING_BURST_BYTES must be at least 1"
+#endif
+
+#define PACER_BURST_MILLI   ((int64_t)TINYPAN_PACING_BURST_BYTES * 1000)
+
+static uint32_t s_rate = TINYPAN_PACING_RATE_BPS;
+static int64_t s_tokens = PACER_BURST_MILLI;
+static uint32_t s_last_ms = 0;
+static bool s_holding = false;
+
+/**
+ * @brief Rate in force: the set one, else the link estimate with headroom
+ * @return bytes/s, 0 for unpaced
+ */
+static uint32_t pacer_rate(void) {
+    if (s_rate != 0) {
+        return s_rate;
+    }
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    tinypan_link_estimate_t est;
+    tinypan_link_est_get(&est);
+    if (est.windows > 0 && est.tx_bytes_per_s > 0) {
+        return (uint32_t)(((uint64_t)est.tx_bytes_per_s * TINYPAN_PACING_EST_GAIN_PCT) / 100u);
+    }
+#endif
+    return 0;
+}
+
+static void pacer_refill(uint32_t rate) {
+    uint32_t now = hal_get_tick_ms();
+    uint32_t elapsed = now - s_last_ms;
+    s_last_ms = now;
+
+    s_tokens += (int64_t)elapsed * rate;
+    if (s_tokens > PACER_BURST_MILLI) {
+        s_tokens = PACER_BURST_MILLI;
+    }
+}
+
+void tinypan_pacer_reset(void) {
+    s_rate = TINYPAN_PACING_RATE_BPS;
+    s_tokens = PACER_BURST_MILLI;
+    s_last_ms = hal_get_tick_ms();
+    s_holding = false;
+}
+
+void tinypan_pacer_set_rate(uint32_t bytes_per_s) {
+    s_rate = (bytes_per_s != 0) ? bytes_per_s : TINYPAN_PACING_RATE_BPS;
+}
+
+bool tinypan_pacer_admit(uint16_t len) {
+    uint32_t rate = pacer_rate();
+    if (rate == 0) {
+        s_holding = false;
+        return true;
+    }
+
+    pacer_refill(rate);
+    if (s_tokens < 0) {
+        s_holding = true;
+        return false;
+    }
+    s_tokens -= (int64_t)len * 1000;
+    s_holding = false;
+    return true;
+}
+
+void tinypan_pacer_refund(uint16_t len) {
+    s_tokens += (int64_t)len * 1000;
+    if (s_tokens > PACER_BURST_MILLI) {
+        s_tokens = PACER_BURST_MILLI;
+    }
+}
+
+uint32_t tinypan_pacer_next_ms(void) {
+    if (!s_holding) {
+        return 0xFFFFFFFF;
+    }
+    uint32_t rate = pacer_rate();
+    if (rate == 0) {
+        return 0;
+    }
+
+    pacer_refill(rate);
+    if (s_tokens >= 0) {
+        return 0;
+    }
+    /* Round up: released at the first tick with the debt paid */
+    return (uint32_t)((-s_tokens + rate - 1) / rate);
+}
+
+#endif /* TINYPAN_ENABLE_PACING */
@@ -0,0 +1,56 @@
+/*
+ * TinyPAN Egress Pacer - Internal Header
+ *
+ * Token bucket consulted by the BNEP and SLIP drain loops before each hand-off
+ * to the HAL (TINYPAN_ENABLE_PACING). tinypan.c re-runs the drain once the
+ * next release time has come and reports it through
+ * tinypan_get_next_timeout_ms().
+ */
+
+#ifndef TINYPAN_PACER_H
+#define TINYPAN_PACER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fill the bucket and go back to TINYPAN_PACING_RATE_BPS
+ */
+void tinypan_pacer_reset(void);
+
+/**
+ * @brief Set the rate; 0 selects the configured default
+ */
+void tinypan_pacer_set_rate(uint32_t bytes_per_s);
+
+/**
+ * @brief Ask to hand len bytes to the HAL now
+ *
+ * The bucket may go into debt by one frame, so frames larger than the
+ * burst still pass.
+ *
+ * @return true to send; false to stop draining until the release time
+ */
+bool tinypan_pacer_admit(uint16_t len);
+
+/**
+ * @brief Give back the tokens of an admitted send the HAL refused as busy
+ */
+void tinypan_pacer_refund(uint16_t len);
+
+/**
+ * @brief Milliseconds until held-back frames may go
+ * @return 0 if due now, 0xFFFFFFFF if nothing is held back
+ */
+uint32_t tinypan_pacer_next_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_PACER_H */
@@ -0,0 +1,194 @@
+/*
+ * TinyPAN Reconnect Policy
+ *
+ * Each failure class has its own backoff curve. A link that was working
+ * and dropped is most likely back at once (the phone moved, a supervision
+ * timeout), so it gets TINYPAN_RECONNECT_FAST_RETRIES quick attempts
+ * before anything else. A NAP that is not answering starts at
+ * reconnect_interval_ms, one that refused DHCP at twice that, one that
+ * refused the connection or BNEP at four times that, and a failed
+ * authentication, which only the user can fix, at half of reconnect_max_ms.
+ *
+ * Delays use decorrelated jitter: each one is drawn between the class base
+ * and three times the previous delay of the class, capped at
+ * reconnect_max_ms. Devices seeded with different addresses spread out
+ * instead of paging the same phone in step after it comes back.
+ */
+
+#include "tinypan_reconnect.h"
+
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+
+#include "tinypan_internal.h"
+#include "../include/tinypan_hal.h"
+#include <string.h>
+
+static uint32_t s_rng = 1;
+static uint32_t s_sleep_ms[TINYPAN_RECONNECT_REASON_COUNT];  /* Previous delay per class, 0 = none */
+static uint8_t s_fast_used = 0;         /* Fast retries this outage */
+
+/* Time is charged to s_reason from s_charged_ms while in an outage */
+static bool s_outage = false;
+static tinypan_reconnect_reason_t s_reason = TINYPAN_RECONNECT_TRANSIENT;
+static uint32_t s_charged_ms = 0;
+
+static tinypan_reconnect_stats_t s_stats;
+
+static uint32_t reconnect_random(void) {
+    /* xorshift32 */
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static uint32_t reconnect_random_between(uint32_t lo, uint32_t hi) {
+    if (hi <= lo) {
+        return lo;
+    }
+    return lo + reconnect_random() % (hi - lo + 1);
+}
+
+static uint32_t reconnect_base_ms(tinypan_reconnect_reason_t reason,
+                                  uint32_t interval_ms, uint32_t max_ms) {
+    uint32_t base;
+    switch (reason) {
+        case TINYPAN_RECONNECT_REJECTED:
+            base = interval_ms * 4;
+            break;
+        case TINYPAN_RECONNECT_AUTH:
+            base = max_ms / 2;
+            break;
+        case TINYPAN_RECONNECT_DHCP:
+            base = interval_ms * 2;
+            break;
+        default:
+            base = interval_ms;
+            break;
+    }
+    return (base > max_ms) ? max_ms : base;
+}
+
+/**
+ * @brief Charge the time since the last failure to its class
+ */
+static void reconnect_charge(void) {
+    if (!s_outage) {
+        return;
+    }
+    uint32_t now = hal_get_tick_ms();
+    s_stats.time_ms[s_reason] += now - s_charged_ms;
+    s_charged_ms = now;
+}
+
+static void reconnect_end_outage(void) {
+    reconnect_charge();
+    s_outage = false;
+    s_fast_used = 0;
+    memset(s_sleep_ms, 0, sizeof(s_sleep_ms));
+}
+
+void tinypan_reconnect_reset(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_sleep_ms, 0, sizeof(s_sleep_ms));
+    s_fast_used = 0;
+    s_outage = false;
+
+    /* FNV-1a of the local address: the spread between devices */
+    uint8_t addr[HAL_BD_ADDR_LEN];
+    hal_get_local_bd_addr(addr);
+    uint32_t seed = 2166136261u;
+    for (int i = 0; i < HAL_BD_ADDR_LEN; i++) {
+        seed = (seed ^ addr[i]) * 16777619u;
+    }
+    seed ^= hal_get_tick_ms();
+    s_rng = (seed != 0) ? seed : 1;
+}
+
+tinypan_reconnect_reason_t tinypan_reconnect_classify(int status, tinypan_reconnect_reason_t fallback) {
+    switch (status) {
+        case HAL_HCI_ERR_AUTH_FAILURE:
+        case HAL_HCI_ERR_PIN_OR_KEY_MISSING:
+        case HAL_HCI_ERR_REJ_SECURITY:
+        case HAL_HCI_ERR_PAIRING_NOT_ALLOWED:
+        case HAL_HCI_ERR_INSUFFICIENT_SECURITY:
+            return TINYPAN_RECONNECT_AUTH;
+        case HAL_HCI_ERR_CONN_LIMIT_EXCEEDED:
+        case HAL_HCI_ERR_REJ_LIMITED_RESOURCES:
+        case HAL_HCI_ERR_REJ_BAD_ADDR:
+            return TINYPAN_RECONNECT_REJECTED;
+        case HAL_HCI_ERR_PAGE_TIMEOUT:
+        case HAL_HCI_ERR_REMOTE_POWER_OFF:
+            return TINYPAN_RECONNECT_UNREACHABLE;
+        case HAL_HCI_ERR_CONN_TIMEOUT:
+        case HAL_HCI_ERR_REMOTE_USER_TERM:
+        case HAL_HCI_ERR_REMOTE_LOW_RESOURCES:
+        case HAL_HCI_ERR_LMP_RESPONSE_TIMEOUT:
+        case HAL_HCI_ERR_CONN_FAILED_TO_ESTABLISH:
+            return TINYPAN_RECONNECT_TRANSIENT;
+        default:
+            return fallback;
+    }
+}
+
+uint32_t tinypan_reconnect_next_delay(tinypan_reconnect_reason_t reason,
+                                      uint32_t interval_ms, uint32_t max_ms) {
+    if ((unsigned)reason >= TINYPAN_RECONNECT_REASON_COUNT) {
+        reason = TINYPAN_RECONNECT_UNREACHABLE;
+    }
+    if (s_outage) {
+        reconnect_charge();
+    } else {
+        s_outage = true;
+        s_charged_ms = hal_get_tick_ms();
+    }
+    s_reason = reason;
+    s_stats.failures[reason]++;
+    s_stats.last_reason = reason;
+
+    uint32_t delay;
+    if (reason == TINYPAN_RECONNECT_TRANSIENT && s_fast_used < TINYPAN_RECONNECT_FAST_RETRIES) {
+        s_fast_used++;
+        s_stats.fast_retries++;
+        delay = reconnect_random_between(TINYPAN_RECONNECT_FAST_MS / 2, TINYPAN_RECONNECT_FAST_MS);
+    } else {
+        uint32_t base = reconnect_base_ms(reason, interval_ms, max_ms);
+        uint32_t prev = (s_sleep_ms[reason] != 0) ? s_sleep_ms[reason] : base;
+        delay = reconnect_random_between(base, prev * 3);
+        if (delay > max_ms) {
+            delay = max_ms;
+        }
+        s_sleep_ms[reason] = delay;
+    }
+
+    s_stats.last_delay_ms = delay;
+    return delay;
+}
+
+void tinypan_reconnect_connected(void) {
+    for (int i = 0; i < TINYPAN_RECONNECT_REASON_COUNT; i++) {
+        if (i != TINYPAN_RECONNECT_DHCP) {
+            s_sleep_ms[i] = 0;
+        }
+    }
+}
+
+void tinypan_reconnect_online(void) {
+    if (s_outage) {
+        s_stats.recoveries++;
+    }
+    reconnect_end_outage();
+}
+
+void tinypan_reconnect_stopped(void) {
+    reconnect_end_outage();
+}
+
+void tinypan_reconnect_get_stats(tinypan_reconnect_stats_t* stats) {
+    *stats = s_stats;
+    if (s_outage) {
+        stats->time_ms[s_reason] += hal_get_tick_ms() - s_charged_ms;
+    }
+}
+
+#endif /* TINYPAN_ENABLE_RECONNECT_POLICY */
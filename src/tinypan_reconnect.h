@@ -0,0 +1,70 @@
+/*
+ * TinyPAN Reconnect Policy - Internal Header
+ *
+ * Reason-aware reconnect backoff (TINYPAN_ENABLE_RECONNECT_POLICY). The
+ * supervisor classifies every failure that leads to a reconnect and asks
+ * for the delay before the next attempt; it also reports when the link is
+ * back ONLINE or the stack stops retrying, which ends the outage.
+ */
+
+#ifndef TINYPAN_RECONNECT_H
+#define TINYPAN_RECONNECT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Clear the backoff and the statistics, and seed the jitter
+ */
+void tinypan_reconnect_reset(void);
+
+/**
+ * @brief Classify a HAL status code
+ *
+ * @param status   Status of HAL_L2CAP_EVENT_CONNECT_FAILED/DISCONNECTED
+ * @param fallback Class to use if the status is not a known HCI reason
+ */
+tinypan_reconnect_reason_t tinypan_reconnect_classify(int status, tinypan_reconnect_reason_t fallback);
+
+/**
+ * @brief Record a failure and pick the delay before the next attempt
+ *
+ * @param reason      Failure class
+ * @param interval_ms reconnect_interval_ms from the configuration
+ * @param max_ms      reconnect_max_ms from the configuration
+ * @return Delay in milliseconds
+ */
+uint32_t tinypan_reconnect_next_delay(tinypan_reconnect_reason_t reason,
+                                      uint32_t interval_ms, uint32_t max_ms);
+
+/**
+ * @brief BNEP is up again: restart every curve but the DHCP one
+ */
+void tinypan_reconnect_connected(void);
+
+/**
+ * @brief The link is ONLINE: the outage is over
+ */
+void tinypan_reconnect_online(void);
+
+/**
+ * @brief The supervisor stopped or gave up: the outage is over
+ */
+void tinypan_reconnect_stopped(void);
+
+/**
+ * @brief Counters and time per class, including an outage in progress
+ */
+void tinypan_reconnect_get_stats(tinypan_reconnect_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_RECONNECT_H */
@@ -0,0 +1,197 @@
+/*
+ * TinyPAN SLIP Payload Compression
+ *
+ * LZSS encoder/decoder used by the SLIP transport for optional per-frame
+ * payload compression. The encoder searches the window exhaustively; with
+ * the default 256-byte window this costs a few hundred cycles per input byte,
+ * which is cheap compared to the air time saved on a BLE link.
+ */
+
+#include "tinypan_slip_lz.h"
+
+#include <string.h>
+
+#if TINYPAN_SLIP_LZ_WINDOW_BITS < 4 || TINYPAN_SLIP_LZ_WINDOW_BITS > 12
+#error "TINYPAN_SLIP_LZ_WINDOW_BITS must be between 4 and 12"
+#endif
+
+#if TINYPAN_SLIP_LZ_LOOKAHEAD_BITS < 2 || TINYPAN_SLIP_LZ_LOOKAHEAD_BITS >= TINYPAN_SLIP_LZ_WINDOW_BITS
+#error "TINYPAN_SLIP_LZ_LOOKAHEAD_BITS must be at least 2 and smaller than the window bits"
+#endif
+
+#define LZ_W        TINYPAN_SLIP_LZ_WINDOW_BITS
+#define LZ_L        TINYPAN_SLIP_LZ_LOOKAHEAD_BITS
+#define LZ_MIN      SLIP_LZ_MIN_MATCH(LZ_W, LZ_L)
+
+/* ============================================================================
+ * Encoder
+ * ============================================================================ */
+
+static void lz_put_bits(slip_lz_enc_t* enc, uint16_t value, uint8_t bits) {
+    while (bits > 0) {
+        bits--;
+        enc->bit_acc = (uint8_t)((enc->bit_acc << 1) | ((value >> bits) & 1));
+        if (++enc->bit_count == 8) {
+            if (enc->out_len >= enc->out_max) {
+                enc->overflow = true;
+                return;
+            }
+            enc->out[enc->out_len++] = enc->bit_acc;
+            enc->bit_acc = 0;
+            enc->bit_count = 0;
+        }
+    }
+}
+
+/**
+ * @brief Encode one literal or back-reference at enc->pos
+ *
+ * @param avail Bytes of lookahead available from enc->pos
+ */
+static void lz_encode_step(slip_lz_enc_t* enc, uint16_t avail) {
+    const uint8_t* cur = &enc->buf[enc->pos];
+    uint16_t max_len = (avail < SLIP_LZ_MAX_MATCH) ? avail : (uint16_t)SLIP_LZ_MAX_MATCH;
+    uint16_t start = (enc->pos > SLIP_LZ_WINDOW) ? (uint16_t)(enc->pos - SLIP_LZ_WINDOW) : 0;
+    uint16_t best_len = 0;
+    uint16_t best_dist = 0;
+
+    /* Nearest candidates first so ties pick the shortest distance */
+    for (uint16_t cand = enc->pos; cand > start && best_len < max_len; ) {
+        cand--;
+        const uint8_t* c = &enc->buf[cand];
+        if (c[0] != cur[0]) continue;
+
+        uint16_t len = 1;
+        while (len < max_len && c[len] == cur[len]) len++;
+        if (len > best_len) {
+            best_len = len;
+            best_dist = (uint16_t)(enc->pos - cand);
+        }
+    }
+
+    if (best_len >= LZ_MIN) {
+        lz_put_bits(enc, 0, 1);
+        lz_put_bits(enc, (uint16_t)(best_dist - 1), LZ_W);
+        lz_put_bits(enc, (uint16_t)(best_len - LZ_MIN), LZ_L);
+        enc->pos = (uint16_t)(enc->pos + best_len);
+    } else {
+        lz_put_bits(enc, 1, 1);
+        lz_put_bits(enc, *cur, 8);
+        enc->pos++;
+    }
+}
+
+void slip_lz_enc_begin(slip_lz_enc_t* enc, uint8_t* out, uint16_t out_max, uint16_t orig_len) {
+    enc->fill = 0;
+    enc->pos = 0;
+    enc->out = out;
+    enc->out_len = SLIP_LZ_HDR_LEN;
+    enc->out_max = out_max;
+    enc->bit_acc = 0;
+    enc->bit_count = 0;
+    enc->overflow = (out_max <= SLIP_LZ_HDR_LEN);
+
+    if (!enc->overflow) {
+        out[0] = SLIP_LZ_TYPE;
+        out[1] = (uint8_t)((LZ_W << 4) | LZ_L);
+        out[2] = (uint8_t)(orig_len >> 8);
+        out[3] = (uint8_t)orig_len;
+    }
+}
+
+bool slip_lz_enc_feed(slip_lz_enc_t* enc, const uint8_t* data, uint16_t len) {
+    while (len > 0 && !enc->overflow) {
+        /* Keep one window of history once the buffer is full */
+        if (enc->fill == sizeof(enc->buf)) {
+            uint16_t shift = (uint16_t)(enc->pos - SLIP_LZ_WINDOW);
+            memmove(enc->buf, &enc->buf[shift], (size_t)(enc->fill - shift));
+            enc->fill = (uint16_t)(enc->fill - shift);
+            enc->pos = (uint16_t)(enc->pos - shift);
+        }
+
+        uint16_t n = (uint16_t)(sizeof(enc->buf) - enc->fill);
+        if (n > len) n = len;
+        memcpy(&enc->buf[enc->fill], data, n);
+        enc->fill = (uint16_t)(enc->fill + n);
+        data += n;
+        len = (uint16_t)(len - n);
+
+        /* Encode while a full lookahead is buffered; the tail waits for
+         * more input or for slip_lz_enc_finish() */
+        while (!enc->overflow && (uint16_t)(enc->fill - enc->pos) >= SLIP_LZ_MAX_MATCH) {
+            lz_encode_step(enc, (uint16_t)(enc->fill - enc->pos));
+        }
+    }
+    return !enc->overflow;
+}
+
+uint16_t slip_lz_enc_finish(slip_lz_enc_t* enc) {
+    while (!enc->overflow && enc->pos < enc->fill) {
+        lz_encode_step(enc, (uint16_t)(enc->fill - enc->pos));
+    }
+    if (!enc->overflow && enc->bit_count > 0) {
+        lz_put_bits(enc, 0, (uint8_t)(8 - enc->bit_count));
+    }
+    return enc->overflow ? 0 : enc->out_len;
+}
+
+/* ============================================================================
+ * Decoder
+ * ============================================================================ */
+
+typedef struct {
+    const uint8_t* data;
+    uint16_t len;
+    uint16_t byte;
+    uint8_t  bit;
+} lz_bit_reader_t;
+
+static bool lz_get_bits(lz_bit_reader_t* r, uint8_t bits, uint16_t* value) {
+    uint16_t v = 0;
+    while (bits-- > 0) {
+        if (r->byte >= r->len) return false;
+        v = (uint16_t)((v << 1) | ((r->data[r->byte] >> (7 - r->bit)) & 1));
+        if (++r->bit == 8) {
+            r->bit = 0;
+            r->byte++;
+        }
+    }
+    *value = v;
+    return true;
+}
+
+int slip_lz_decode(const uint8_t* frame, uint16_t len, uint8_t* out, uint16_t out_max) {
+    if (frame == NULL || len < SLIP_LZ_HDR_LEN || frame[0] != SLIP_LZ_TYPE) return -1;
+
+    uint8_t w = frame[1] >> 4;
+    uint8_t l = frame[1] & 0x0F;
+    uint16_t orig_len = (uint16_t)((frame[2] << 8) | frame[3]);
+    if (w < 4 || w > 12 || l < 2 || l >= w || orig_len > out_max) return -1;
+
+    uint8_t min_match = SLIP_LZ_MIN_MATCH(w, l);
+    lz_bit_reader_t r = { frame + SLIP_LZ_HDR_LEN, (uint16_t)(len - SLIP_LZ_HDR_LEN), 0, 0 };
+    uint16_t produced = 0;
+    uint16_t v;
+
+    while (produced < orig_len) {
+        if (!lz_get_bits(&r, 1, &v)) return -1;
+        if (v) {
+            if (!lz_get_bits(&r, 8, &v)) return -1;
+            out[produced++] = (uint8_t)v;
+            continue;
+        }
+
+        uint16_t dist, count;
+        if (!lz_get_bits(&r, w, &dist) || !lz_get_bits(&r, l, &count)) return -1;
+        dist++;
+        count = (uint16_t)(count + min_match);
+        if (dist > produced || count > orig_len - produced) return -1;
+
+        /* Byte-wise copy: overlapping references repeat the pattern */
+        for (uint16_t i = 0; i < count; i++) {
+            out[produced] = out[produced - dist];
+            produced++;
+        }
+    }
+    return produced;
+}
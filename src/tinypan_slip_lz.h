@@ -0,0 +1,113 @@
+/*
+ * TinyPAN SLIP Payload Compression - Internal Header
+ *
+ * LZSS codec in the heatshrink family: a static sliding window of
+ * 2^TINYPAN_SLIP_LZ_WINDOW_BITS bytes, no heap, and a streaming encoder so
+ * pbuf chains can be fed segment by segment. Each SLIP frame is compressed
+ * independently, so a frame lost on the air never corrupts its successors.
+ *
+ * Frame layout:
+ *   [0x50][window_bits << 4 | lookahead_bits][original length (BE16)][bitstream]
+ *
+ * Bitstream (MSB first): 1 + 8 bits is a literal, 0 + W bits (distance - 1)
+ * + L bits (length - SLIP_LZ_MIN_MATCH) is a back-reference.
+ */
+
+#ifndef TINYPAN_SLIP_LZ_H
+#define TINYPAN_SLIP_LZ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/** First byte of an LZ-compressed SLIP frame */
+#define SLIP_LZ_TYPE                0x50
+
+/** Frame header length (type, parameters, original length) */
+#define SLIP_LZ_HDR_LEN             4
+
+/** Shortest back-reference worth encoding for a given bit layout */
+#define SLIP_LZ_MIN_MATCH(w, l)     ((1 + (w) + (l)) < 18 ? 2 : 3)
+
+#define SLIP_LZ_WINDOW              (1u << TINYPAN_SLIP_LZ_WINDOW_BITS)
+#define SLIP_LZ_MAX_MATCH           ((1u << TINYPAN_SLIP_LZ_LOOKAHEAD_BITS) + \
+                                     SLIP_LZ_MIN_MATCH(TINYPAN_SLIP_LZ_WINDOW_BITS, \
+                                                       TINYPAN_SLIP_LZ_LOOKAHEAD_BITS) - 1)
+
+/* ============================================================================
+ * State
+ * ============================================================================ */
+
+/**
+ * @brief Streaming encoder state for one frame
+ *
+ * buf holds up to one window of history plus the pending input.
+ */
+typedef struct {
+    uint8_t  buf[2 * SLIP_LZ_WINDOW];
+    uint16_t fill;              /**< Valid bytes in buf */
+    uint16_t pos;               /**< Next byte of buf to encode */
+    uint8_t* out;
+    uint16_t out_len;
+    uint16_t out_max;
+    uint8_t  bit_acc;           /**< Partially filled output byte */
+    uint8_t  bit_count;         /**< Bits used in bit_acc */
+    bool     overflow;          /**< Output would not be smaller than the input */
+} slip_lz_enc_t;
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+/**
+ * @brief Start compressing a frame
+ *
+ * @param enc       Encoder state
+ * @param out       Output buffer (receives the complete LZ frame)
+ * @param out_max   Output limit; compression is abandoned once exceeded
+ * @param orig_len  Total number of bytes that will be fed
+ */
+void slip_lz_enc_begin(slip_lz_enc_t* enc, uint8_t* out, uint16_t out_max, uint16_t orig_len);
+
+/**
+ * @brief Feed the next piece of the frame
+ *
+ * @return false once the output limit has been exceeded (further input is ignored)
+ */
+bool slip_lz_enc_feed(slip_lz_enc_t* enc, const uint8_t* data, uint16_t len);
+
+/**
+ * @brief Flush the encoder
+ *
+ * @return Length of the LZ frame in out, or 0 if the frame is incompressible
+ */
+uint16_t slip_lz_enc_finish(slip_lz_enc_t* enc);
+
+/**
+ * @brief Decode an LZ frame
+ *
+ * Accepts any window/lookahead layout announced in the frame header, so the
+ * two ends of the link may be built with different settings.
+ *
+ * @param frame     LZ frame (starting with SLIP_LZ_TYPE)
+ * @param len       Frame length
+ * @param out       Output buffer
+ * @param out_max   Size of out
+ * @return Decoded length, or negative if the frame is malformed
+ */
+int slip_lz_decode(const uint8_t* frame, uint16_t len, uint8_t* out, uint16_t out_max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_SLIP_LZ_H */
@@ -2,14 +2,38 @@
  * TinyPAN SLIP Transport Backend
  *
  * Implements tinypan_transport_t for BLE SLIP companion mode.
- * TX: Encodes outgoing pbuf chains into a staging buffer using a
- * structural single-pass C loop. Flushed via hal_bt_l2cap_send().
+ * TX: Encodes outgoing pbuf chains into a small ring of chunk buffers using a
+ * structural single-pass C loop. Chunks are flushed via hal_bt_l2cap_send()
+ * back-to-back for as long as hal_bt_l2cap_get_tx_credits() allows, so every
+ * BLE connection event can be filled.
  *
  * RX: Accumulates incoming bytes from the HAL into a static accumulator.
  * Frame completion triggers a single pbuf_alloc (PBUF_POOL) and pbuf_take.
+ *
+ * Optional CSLIP header compression (TINYPAN_SLIP_ENABLE_VJ) is negotiated
+ * with the companion app through a small control frame when the link comes
+ * up. Compression runs once per packet when the drain loop picks it up, so
+ * the compressor sees frames in wire order even when the flow scheduler
+ * (TINYPAN_ENABLE_FQ) reorders the queue; the encoder then emits the
+ * replacement header followed by the remainder of the pbuf chain, so the
+ * zero-copy TX path is preserved.
+ *
+ * Optional LZSS payload compression (TINYPAN_SLIP_ENABLE_LZ) is negotiated
+ * the same way. It runs when the drain loop picks up a frame: the frame is
+ * streamed through the encoder into a static buffer and sent from there if
+ * it came out smaller, otherwise the original pbuf chain is sent as-is.
+ *
+ * With TINYPAN_ENABLE_HEARTBEAT an echo feature is offered as well: SLIP
+ * has no ARP, so the heartbeat probes a peer that agreed to it with an
+ * echo control frame.
  */
 
 #include "tinypan_transport.h"
+#include "tinypan_link_est.h"
+#include "tinypan_pacer.h"
+#include "tinypan_fq.h"
+#include "tinypan_burst.h"
+#include "tinypan_heartbeat.h"
 #include "../include/tinypan.h"
 #include "../include/tinypan_config.h"
 #include "../include/tinypan_hal.h"
@@ -23,32 +47,328 @@
 #include "lwip/netif.h"
 #endif
 
+#if TINYPAN_SLIP_ENABLE_VJ
+#include "tinypan_slip_vj.h"
+#endif
+
+#if TINYPAN_SLIP_ENABLE_LZ
+#include "tinypan_slip_lz.h"
+#endif
+
 #include <string.h>
 
+/* SLIP Escape characters */
+#define SLIP_END            0xC0
+#define SLIP_ESC            0xDB
+#define SLIP_ESC_END        0xDC
+#define SLIP_ESC_ESC        0xDD
+
+/* IP MTU bounds for SLIP MTU tuning (576 = minimum IPv4 reassembly size) */
+#define SLIP_IP_MTU_MAX         1500
+#define SLIP_IP_MTU_MIN         576
+
+/* Link negotiation is only needed when an optional feature is compiled in */
+#define SLIP_HAS_NEGOTIATION    (TINYPAN_SLIP_ENABLE_VJ || TINYPAN_SLIP_ENABLE_LZ || \
+                                 TINYPAN_ENABLE_HEARTBEAT)
+
+/* ----------------------------------------------------------------------------
+ * Control Frames
+ *
+ * [0x10][op][features], or [0x10][op][tag] for the echo ops. The first byte
+ * cannot start an IPv4 packet or any CSLIP frame, so peers without
+ * negotiation support simply drop it.
+ * ---------------------------------------------------------------------------- */
+#define SLIP_CTRL_TYPE          0x10
+#define SLIP_CTRL_HELLO         0x01    /**< Offer: features supported by sender */
+#define SLIP_CTRL_HELLO_ACK     0x02    /**< Answer: features both sides support */
+#define SLIP_CTRL_ECHO          0x03    /**< Heartbeat probe, answered with its tag */
+#define SLIP_CTRL_ECHO_REPLY    0x04    /**< Answer to an echo */
+#define SLIP_CTRL_LEN           3
+
+#define SLIP_FEATURE_VJ         0x01    /**< CSLIP header compression */
+#define SLIP_FEATURE_LZ         0x02    /**< LZSS payload compression */
+#define SLIP_FEATURE_ECHO       0x04    /**< Echo ops for the heartbeat */
+
+#if TINYPAN_ENABLE_LWIP
+
+/* Configuration guard: prevent integer underflow in chunking loop */
+_Static_assert(TINYPAN_SLIP_CHUNK_SIZE >= 4, "TINYPAN_SLIP_CHUNK_SIZE must be at least 4 bytes");
+
+/**
+ * @brief Queued TX frame
+ *
+ * With header compression the first `skip` bytes of the pbuf are replaced on
+ * the wire by hdr[0..hdr_len).
+ */
+typedef struct {
+    struct pbuf* p;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    uint32_t queued_at_ms;
+#endif
+#if TINYPAN_ENABLE_FQ
+    uint8_t  flow;          /* Flow bucket */
+#endif
+#if TINYPAN_SLIP_ENABLE_VJ
+    bool     compress;      /* Offer to the header compressor */
+    uint8_t  hdr[SLIP_VJ_MAX_OUT];
+    uint8_t  hdr_len;
+    uint16_t skip;
+#endif
+} slip_tx_job_t;
+
+/* RX State Machine */
+static uint8_t  s_slip_rx_buf[TINYPAN_RX_BUFFER_SIZE]; /* Static accumulator sized for maximum BNEP MTU */
+static uint16_t s_slip_rx_len = 0;
+static bool s_slip_rx_escape = false;
+static bool s_slip_rx_seeking_end = false;
+
+/* SLIP Interface variables */
+static slip_tx_job_t s_slip_tx_queue[TINYPAN_TX_QUEUE_LEN];
+static uint8_t s_slip_tx_head = 0;
+static uint8_t s_slip_tx_tail = 0;
+static hal_mutex_t s_slip_tx_mutex = NULL;
+
+/**
+ * @brief Encoded chunk waiting for the radio
+ *
+ * Fits a standard 247-byte BLE 4.2+ Data Length Extension MTU without
+ * artificially fragmenting it and causing extra RTOS context switches.
+ */
+typedef struct {
+    uint16_t len;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    uint16_t frame_len;         /* Length of the frame this chunk ends, 0 if none */
+    uint32_t queued_at_ms;      /* Enqueue tick of that frame */
+#endif
+    uint8_t  buf[TINYPAN_SLIP_CHUNK_SIZE];
+} slip_tx_chunk_t;
+
+_Static_assert(TINYPAN_SLIP_TX_CHUNKS >= 1 && TINYPAN_SLIP_TX_CHUNKS <= 255,
+               "TINYPAN_SLIP_TX_CHUNKS must be between 1 and 255");
+
+static slip_tx_chunk_t s_slip_chunks[TINYPAN_SLIP_TX_CHUNKS];
+static uint8_t s_slip_chunk_head = 0;
+static uint8_t s_slip_chunk_count = 0;
+static struct pbuf* s_slip_tx_current = NULL; /* Tracks current segment in the chain */
+static uint16_t s_slip_tx_offset = 0;
+static uint8_t s_slip_tx_state = 0; /* 0 = START, 1 = PAYLOAD, 2 = END */
+
+#if TINYPAN_SLIP_ENABLE_VJ
+static slip_vj_state_t s_slip_vj;
+#endif
+
+#if TINYPAN_SLIP_ENABLE_LZ
+static slip_lz_enc_t s_slip_lz_enc;
+static uint8_t s_slip_lz_tx_buf[TINYPAN_MAX_FRAME_SIZE]; /* Compressed frame being sent */
+static uint8_t s_slip_lz_rx_buf[TINYPAN_RX_BUFFER_SIZE]; /* Decompressed frame being delivered */
+#endif
+
+#if SLIP_HAS_NEGOTIATION
+static uint8_t s_slip_tx_features = 0;  /* Features agreed with the peer */
+
+/* Bytes sent ahead of the pbuf chain: a compressed header or a whole LZ frame */
+static const uint8_t* s_slip_tx_prefix = NULL;
+static uint16_t s_slip_tx_prefix_len = 0;
+static uint16_t s_slip_tx_prefix_offset = 0;
+#endif
+
+#if TINYPAN_SLIP_MTU_AUTOTUNE
+static uint16_t s_slip_link_mtu = 0;    /* HAL MTU the netif MTU was last derived from */
+#endif
+
+static void slip_transport_drain_tx_queue(void);
+
+#endif /* TINYPAN_ENABLE_LWIP */
+
 static int slip_transport_init(void) {
+#if TINYPAN_ENABLE_LWIP
     if (s_slip_tx_mutex == NULL) {
         s_slip_tx_mutex = hal_mutex_create();
     }
+#endif
     return 0;
 }
 
-static void slip_transport_on_connected(void) {
-    /* No setup phase for SLIP */
-}
-
-static void slip_transport_on_disconnected(void) {
+static void slip_transport_reset_rx(void) {
 #if TINYPAN_ENABLE_LWIP
-    /* Reset RX framing */
     s_slip_rx_len = 0;
     s_slip_rx_escape = false;
     s_slip_rx_seeking_end = false;
 #endif
 }
 
-#if TINYPAN_ENABLE_LWIP
-/* Configuration guard: prevent integer underflow in chunking loop */
-_Static_assert(TINYPAN_SLIP_CHUNK_SIZE >= 4, "TINYPAN_SLIP_CHUNK_SIZE must be at least 4 bytes");
+#if TINYPAN_ENABLE_LWIP && SLIP_HAS_NEGOTIATION
+
+/**
+ * @brief Reset per-link compression state (both directions)
+ */
+static void slip_transport_reset_link_state(void) {
+    hal_mutex_lock(s_slip_tx_mutex);
+    s_slip_tx_features = 0;
+#if TINYPAN_SLIP_ENABLE_VJ
+    slip_vj_init(&s_slip_vj);
+#endif
+    hal_mutex_unlock(s_slip_tx_mutex);
+}
+
+static uint8_t slip_transport_local_features(void) {
+    uint8_t features = 0;
+#if TINYPAN_SLIP_ENABLE_VJ
+    features |= SLIP_FEATURE_VJ;
+#endif
+#if TINYPAN_SLIP_ENABLE_LZ
+    features |= SLIP_FEATURE_LZ;
 #endif
+#if TINYPAN_ENABLE_HEARTBEAT
+    features |= SLIP_FEATURE_ECHO;
+#endif
+    return features;
+}
+
+static int slip_transport_enqueue(struct pbuf* p, bool compress);
+
+static int slip_transport_send_control(uint8_t op, uint8_t arg) {
+    const uint8_t frame[SLIP_CTRL_LEN] = { SLIP_CTRL_TYPE, op, arg };
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, SLIP_CTRL_LEN, PBUF_RAM);
+    if (p == NULL) {
+        TINYPAN_LOG_WARN("slip: No memory for control frame");
+        return -1;
+    }
+    pbuf_take(p, frame, SLIP_CTRL_LEN);
+    if (slip_transport_enqueue(p, false) != 0) {
+        return -1;
+    }
+    slip_transport_drain_tx_queue();
+    return 0;
+}
+
+static void slip_transport_handle_control(const uint8_t* frame, uint16_t len) {
+    if (len < SLIP_CTRL_LEN) return;
+
+#if TINYPAN_ENABLE_HEARTBEAT
+    if (frame[1] == SLIP_CTRL_ECHO) {
+        slip_transport_send_control(SLIP_CTRL_ECHO_REPLY, frame[2]);
+        return;
+    }
+    if (frame[1] == SLIP_CTRL_ECHO_REPLY) {
+        tinypan_heartbeat_reply(frame[2]);
+        return;
+    }
+#endif
+
+    uint8_t agreed = frame[2] & slip_transport_local_features();
+
+    switch (frame[1]) {
+        case SLIP_CTRL_HELLO:
+            slip_transport_send_control(SLIP_CTRL_HELLO_ACK, agreed);
+            break;
+        case SLIP_CTRL_HELLO_ACK:
+            break;
+        default:
+            return;
+    }
+
+    hal_mutex_lock(s_slip_tx_mutex);
+    if (agreed != s_slip_tx_features) {
+        TINYPAN_LOG_INFO("slip: Peer features 0x%02X (VJ %s, LZ %s, echo %s)", agreed,
+                         (agreed & SLIP_FEATURE_VJ) ? "on" : "off",
+                         (agreed & SLIP_FEATURE_LZ) ? "on" : "off",
+                         (agreed & SLIP_FEATURE_ECHO) ? "on" : "off");
+    }
+    s_slip_tx_features = agreed;
+    hal_mutex_unlock(s_slip_tx_mutex);
+}
+
+#if TINYPAN_ENABLE_HEARTBEAT
+/**
+ * @brief Heartbeat probe: an echo, if the peer agreed to answer one
+ */
+static int slip_transport_send_probe(uint8_t tag) {
+    hal_mutex_lock(s_slip_tx_mutex);
+    bool echo = (s_slip_tx_features & SLIP_FEATURE_ECHO) != 0;
+    hal_mutex_unlock(s_slip_tx_mutex);
+    if (!echo) {
+        return -1;
+    }
+    return slip_transport_send_control(SLIP_CTRL_ECHO, tag);
+}
+#endif
+
+#endif /* TINYPAN_ENABLE_LWIP && SLIP_HAS_NEGOTIATION */
+
+#if TINYPAN_ENABLE_LWIP && TINYPAN_SLIP_MTU_AUTOTUNE
+
+/**
+ * @brief Largest IP MTU whose full-size frames fill a whole number of chunks
+ *
+ * A frame occupies END + payload + escapes + END on the wire. The result is
+ * chosen so that this, with TINYPAN_SLIP_ESCAPE_PERMILLE escape bytes
+ * reserved, is an exact multiple of the chunk size.
+ */
+static uint16_t slip_transport_tuned_mtu(uint16_t link_mtu) {
+    uint32_t chunk = (link_mtu < TINYPAN_SLIP_CHUNK_SIZE) ? link_mtu : TINYPAN_SLIP_CHUNK_SIZE;
+    if (chunk < 4) {
+        return SLIP_IP_MTU_MAX;
+    }
+
+    const uint32_t scale = 1000 + TINYPAN_SLIP_ESCAPE_PERMILLE;
+    uint32_t chunks = (2 + SLIP_IP_MTU_MAX * scale / 1000) / chunk;
+    uint32_t mtu = 0;
+    for (; chunks > 0; chunks--) {
+        mtu = (chunks * chunk - 2) * 1000 / scale;
+        if (mtu <= SLIP_IP_MTU_MAX) break;
+    }
+
+    if (mtu < SLIP_IP_MTU_MIN) {
+        mtu = SLIP_IP_MTU_MIN; /* Fragmenting common traffic costs more than a short last chunk */
+    }
+    return (uint16_t)mtu;
+}
+
+/**
+ * @brief Re-derive the netif MTU if the link MTU changed
+ *
+ * BLE MTU exchange usually completes after the connection is reported, so
+ * this runs from process() as well as on connect.
+ */
+static void slip_transport_tune_mtu(void) {
+    uint16_t link_mtu = hal_bt_l2cap_get_mtu();
+    if (link_mtu == s_slip_link_mtu) {
+        return;
+    }
+
+    struct netif* netif = tinypan_netif_get();
+    if (netif == NULL) {
+        return;
+    }
+
+    s_slip_link_mtu = link_mtu;
+    netif->mtu = slip_transport_tuned_mtu(link_mtu);
+    TINYPAN_LOG_INFO("slip: Link MTU %u, IP MTU %u", link_mtu, netif->mtu);
+}
+
+#endif /* TINYPAN_ENABLE_LWIP && TINYPAN_SLIP_MTU_AUTOTUNE */
+
+static void slip_transport_on_connected(void) {
+#if TINYPAN_ENABLE_LWIP && TINYPAN_SLIP_MTU_AUTOTUNE
+    s_slip_link_mtu = 0;
+    slip_transport_tune_mtu();
+#endif
+    /* No setup phase for SLIP. Optional features are offered to the peer but
+     * the link is usable immediately with plain SLIP. */
+#if TINYPAN_ENABLE_LWIP && SLIP_HAS_NEGOTIATION
+    slip_transport_reset_link_state();
+    slip_transport_send_control(SLIP_CTRL_HELLO, slip_transport_local_features());
+#endif
+}
+
+static void slip_transport_on_disconnected(void) {
+    /* Reset RX framing */
+    slip_transport_reset_rx();
+#if TINYPAN_ENABLE_LWIP && SLIP_HAS_NEGOTIATION
+    slip_transport_reset_link_state();
+#endif
+}
 
 static void slip_transport_retry_setup(void) {
     /* SLIP has no setup phase, this is a no-op */
@@ -60,32 +380,81 @@ static void slip_transport_on_can_send_now(void) {
 #endif
 }
 
-/* SLIP Escape characters */
-#define SLIP_END            0xC0
-#define SLIP_ESC            0xDB
-#define SLIP_ESC_END        0xDC
-#define SLIP_ESC_ESC        0xDD
-
 #if TINYPAN_ENABLE_LWIP
-/* RX State Machine */
-static uint8_t  s_slip_rx_buf[TINYPAN_RX_BUFFER_SIZE]; /* Static accumulator sized for maximum BNEP MTU */
-static uint16_t s_slip_rx_len = 0;
-static bool s_slip_rx_escape = false;
-static bool s_slip_rx_seeking_end = false;
 
-/* SLIP Interface variables */
-static struct pbuf* s_slip_tx_queue[TINYPAN_TX_QUEUE_LEN] = {0};
-static uint8_t s_slip_tx_head = 0;
-static uint8_t s_slip_tx_tail = 0;
-static hal_mutex_t s_slip_tx_mutex = NULL;
+/**
+ * @brief Report a framing error on the current RX frame
+ */
+static void slip_transport_rx_error(void) {
+    s_slip_rx_len = 0;
+    s_slip_rx_seeking_end = true;
+#if TINYPAN_SLIP_ENABLE_VJ
+    /* A lost frame desynchronises the decompressor (RFC 1144 section 4.2) */
+    slip_vj_rx_error(&s_slip_vj);
+#endif
+}
 
-/* Fits a standard 247-byte BLE 4.2+ Data Length Extension MTU without
- * artificially fragmenting it and causing extra RTOS context switches */
-static uint8_t s_slip_chunk_buf[TINYPAN_SLIP_CHUNK_SIZE];
-static uint16_t s_slip_chunk_len = 0;
-static struct pbuf* s_slip_tx_current = NULL; /* Tracks current segment in the chain */
-static uint16_t s_slip_tx_offset = 0;
-static uint8_t s_slip_tx_state = 0; /* 0 = START, 1 = PAYLOAD, 2 = END */
+/**
+ * @brief Deliver a complete decoded frame from the accumulator
+ */
+static void slip_transport_deliver_frame(void) {
+    const uint8_t* frame = s_slip_rx_buf;
+    uint16_t len = s_slip_rx_len;
+    uint16_t hdr_len = 0;
+    uint16_t consumed = 0;
+
+#if TINYPAN_SLIP_ENABLE_LZ
+    if (frame[0] == SLIP_LZ_TYPE) {
+        int decoded = slip_lz_decode(frame, len, s_slip_lz_rx_buf, sizeof(s_slip_lz_rx_buf));
+        if (decoded <= 0) {
+            TINYPAN_LOG_WARN("slip_rx: Dropping corrupt LZ frame");
+#if TINYPAN_SLIP_ENABLE_VJ
+            slip_vj_rx_error(&s_slip_vj);
+#endif
+            return;
+        }
+        frame = s_slip_lz_rx_buf;
+        len = (uint16_t)decoded;
+    }
+#endif
+
+#if SLIP_HAS_NEGOTIATION
+    if (frame[0] == SLIP_CTRL_TYPE) {
+        slip_transport_handle_control(frame, len);
+        return;
+    }
+#endif
+
+#if TINYPAN_SLIP_ENABLE_VJ
+    uint8_t hdr[SLIP_VJ_MAX_HDR];
+    if (slip_vj_owns_type(frame[0])) {
+        int result = slip_vj_uncompress(&s_slip_vj, frame, len, hdr, &hdr_len);
+        if (result < 0) {
+            TINYPAN_LOG_DEBUG("slip_rx: Dropping undecodable frame (type 0x%02X)", frame[0]);
+            return;
+        }
+        consumed = (uint16_t)result;
+    }
+#endif
+
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, (uint16_t)(hdr_len + len - consumed), PBUF_POOL);
+    if (p == NULL) {
+        TINYPAN_LOG_ERROR("slip_rx: pbuf_alloc failed");
+        return;
+    }
+
+#if TINYPAN_SLIP_ENABLE_VJ
+    if (hdr_len > 0) {
+        pbuf_take(p, hdr, hdr_len);
+    }
+#endif
+    pbuf_take_at(p, frame + consumed, (uint16_t)(len - consumed), hdr_len);
+
+    struct netif* netif = tinypan_netif_get();
+    if (netif == NULL || !tinypan_netif_rx_admit(p, 0) || netif->input(p, netif) != ERR_OK) {
+        pbuf_free(p);
+    }
+}
 
 #endif /* TINYPAN_ENABLE_LWIP */
 
@@ -112,15 +481,14 @@ static void slip_transport_handle_incoming(const uint8_t* data, uint16_t len) {
 
         /* Process character */
         uint8_t c = *p++;
-        
+
         if (s_slip_rx_escape) {
             s_slip_rx_escape = false;
             if (c == SLIP_ESC_END) c = SLIP_END;
             else if (c == SLIP_ESC_ESC) c = SLIP_ESC;
             else {
                 TINYPAN_LOG_ERROR("slip_rx: Invalid escape sequence");
-                s_slip_rx_len = 0;
-                s_slip_rx_seeking_end = true;
+                slip_transport_rx_error();
                 continue;
             }
         } else if (c == SLIP_ESC) {
@@ -129,18 +497,7 @@ static void slip_transport_handle_incoming(const uint8_t* data, uint16_t len) {
         } else if (c == SLIP_END) {
             /* Frame delimiter: allocate exactly once and pass to lwIP */
             if (s_slip_rx_len > 0) {
-                struct pbuf* p = pbuf_alloc(PBUF_RAW, s_slip_rx_len, PBUF_POOL);
-                if (p) {
-                    pbuf_take(p, s_slip_rx_buf, s_slip_rx_len);
-                    struct netif* netif = tinypan_netif_get();
-                    if (netif && netif->input(p, netif) != ERR_OK) {
-                        pbuf_free(p);
-                    } else if (!netif) {
-                        pbuf_free(p);
-                    }
-                } else {
-                    TINYPAN_LOG_ERROR("slip_rx: pbuf_alloc failed");
-                }
+                slip_transport_deliver_frame();
                 s_slip_rx_len = 0;
             }
             continue;
@@ -151,11 +508,9 @@ static void slip_transport_handle_incoming(const uint8_t* data, uint16_t len) {
             s_slip_rx_buf[s_slip_rx_len++] = c;
         } else {
             TINYPAN_LOG_ERROR("slip_rx: Frame too large, dropping");
-            s_slip_rx_len = 0;
-            s_slip_rx_seeking_end = true;
+            slip_transport_rx_error();
         }
     }
-    }
 #else
     (void)data;
     (void)len;
@@ -164,194 +519,531 @@ static void slip_transport_handle_incoming(const uint8_t* data, uint16_t len) {
 
 #if TINYPAN_ENABLE_LWIP
 
-void slip_transport_drain_tx_queue(void) {
+/**
+ * @brief SLIP-escape bytes into a chunk buffer
+ *
+ * @return Number of source bytes consumed (stops when the chunk is full,
+ *         or when only one byte is left and the next byte needs escaping)
+ */
+static uint16_t slip_encode_bytes(const uint8_t* src, uint16_t len, uint8_t* dst,
+                                  uint16_t* chunk_idx, uint16_t limit) {
+    uint16_t n = 0;
+    uint16_t idx = *chunk_idx;
+
+    while (n < len) {
+        uint8_t c = src[n];
+        if (c == SLIP_END || c == SLIP_ESC) {
+            /* Never split an escape sequence across chunks */
+            if (idx + 2 > limit) break;
+            dst[idx++] = SLIP_ESC;
+            dst[idx++] = (c == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+        } else {
+            if (idx >= limit) break;
+            dst[idx++] = c;
+        }
+        n++;
+    }
+
+    *chunk_idx = idx;
+    return n;
+}
+
+#if TINYPAN_SLIP_ENABLE_LZ
+/**
+ * @brief Replace the current frame by its LZ encoding if that is smaller
+ */
+static void slip_transport_lz_compress(void) {
+    uint16_t total = s_slip_tx_prefix_len;
+    for (struct pbuf* q = s_slip_tx_current; q != NULL; q = q->next) {
+        total = (uint16_t)(total + q->len);
+    }
+    total = (uint16_t)(total - s_slip_tx_offset);
+
+    if (total < TINYPAN_SLIP_LZ_MIN_FRAME) {
+        return;
+    }
+
+    /* Abandon as soon as the output stops being smaller than the input */
+    uint16_t out_max = (uint16_t)(total - 1);
+    if (out_max > sizeof(s_slip_lz_tx_buf)) {
+        out_max = sizeof(s_slip_lz_tx_buf);
+    }
+
+    slip_lz_enc_begin(&s_slip_lz_enc, s_slip_lz_tx_buf, out_max, total);
+    bool ok = slip_lz_enc_feed(&s_slip_lz_enc, s_slip_tx_prefix, s_slip_tx_prefix_len);
+    uint16_t offset = s_slip_tx_offset;
+    for (struct pbuf* q = s_slip_tx_current; q != NULL && ok; q = q->next) {
+        ok = slip_lz_enc_feed(&s_slip_lz_enc, (const uint8_t*)q->payload + offset,
+                              (uint16_t)(q->len - offset));
+        offset = 0;
+    }
+
+    uint16_t lz_len = ok ? slip_lz_enc_finish(&s_slip_lz_enc) : 0;
+    if (lz_len == 0) {
+        return; /* Incompressible, send the original */
+    }
+
+    s_slip_tx_prefix = s_slip_lz_tx_buf;
+    s_slip_tx_prefix_len = lz_len;
+    s_slip_tx_current = NULL;
+    s_slip_tx_offset = 0;
+}
+#endif /* TINYPAN_SLIP_ENABLE_LZ */
+
+/**
+ * @brief Position the encoder at the start of a queued frame
+ */
+static void slip_transport_start_job(slip_tx_job_t* job) {
+    s_slip_tx_current = job->p;
+    s_slip_tx_offset = 0;
+    s_slip_tx_state = 0;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    tinypan_link_est_started(job->queued_at_ms);
+#endif
+
+#if SLIP_HAS_NEGOTIATION
+    s_slip_tx_prefix = NULL;
+    s_slip_tx_prefix_len = 0;
+    s_slip_tx_prefix_offset = 0;
+#endif
+
+#if TINYPAN_SLIP_ENABLE_VJ
+    job->hdr_len = 0;
+    job->skip = 0;
+    if (job->compress && (s_slip_tx_features & SLIP_FEATURE_VJ)) {
+        /* The compressor only looks at the headers, so a bounded copy keeps
+         * it independent of how lwIP split the chain. */
+        uint8_t pkt[SLIP_VJ_MAX_HDR];
+        uint16_t avail = pbuf_copy_partial(job->p, pkt, sizeof(pkt), 0);
+        job->hdr_len = slip_vj_compress(&s_slip_vj, pkt, avail, job->p->tot_len,
+                                        job->hdr, &job->skip);
+    }
+
+    /* Skip the header bytes that were replaced by the compressor */
+    uint16_t skip = job->skip;
+    while (s_slip_tx_current != NULL && skip >= s_slip_tx_current->len) {
+        skip -= s_slip_tx_current->len;
+        s_slip_tx_current = s_slip_tx_current->next;
+    }
+    s_slip_tx_offset = skip;
+    s_slip_tx_prefix = job->hdr;
+    s_slip_tx_prefix_len = job->hdr_len;
+#endif
+
+#if TINYPAN_SLIP_ENABLE_LZ
+    if (s_slip_tx_features & SLIP_FEATURE_LZ) {
+        slip_transport_lz_compress();
+    }
+#endif
+}
+
+/**
+ * @brief Forget compression state the peer can no longer follow
+ */
+static void slip_transport_tx_desync(void) {
+#if TINYPAN_SLIP_ENABLE_VJ
+    /* The peer never sees the dropped frame, so its compression slots are now stale */
+    slip_vj_tx_reset(&s_slip_vj);
+#endif
+}
+
+/**
+ * @brief Release the frame at the head of the TX ring
+ */
+static void slip_transport_finish_job(void) {
+    slip_tx_job_t* job = &s_slip_tx_queue[s_slip_tx_head];
+    if (job->p != NULL) {
+        tinypan_transport_tx_released(job->p->tot_len);
+        pbuf_free(job->p);
+    }
+    job->p = NULL;
+    s_slip_tx_head = (s_slip_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
+    s_slip_tx_current = NULL;
+    s_slip_tx_offset = 0;
+    s_slip_tx_state = 0;
+}
+
+#if TINYPAN_ENABLE_FQ
+/**
+ * @brief Buckets and lengths of the queued frames, head first
+ * @return Number of queued frames
+ */
+static uint8_t slip_fq_snapshot(uint8_t* flows, uint16_t* lens) {
+    uint8_t count = 0;
+    for (uint8_t i = s_slip_tx_head; i != s_slip_tx_tail; i = (i + 1) % TINYPAN_TX_QUEUE_LEN) {
+        flows[count] = s_slip_tx_queue[i].flow;
+        lens[count] = s_slip_tx_queue[i].p->tot_len;
+        count++;
+    }
+    return count;
+}
+
+static uint16_t slip_transport_tx_flow_room(void) {
+    uint8_t flows[TINYPAN_TX_QUEUE_LEN];
+    uint16_t lens[TINYPAN_TX_QUEUE_LEN];
     hal_mutex_lock(s_slip_tx_mutex);
-    if (s_slip_tx_head == s_slip_tx_tail) {
-        hal_mutex_unlock(s_slip_tx_mutex);
+    uint8_t room = tinypan_fq_room(flows, slip_fq_snapshot(flows, lens));
+    hal_mutex_unlock(s_slip_tx_mutex);
+    return room;
+}
+
+/**
+ * @brief Bring the frame the scheduler picks to the head of the ring
+ *
+ * The frames it passes move back one slot, so every bucket keeps its order.
+ * Only between frames: the head must not be half encoded.
+ */
+static void slip_fq_schedule(void) {
+    uint8_t flows[TINYPAN_TX_QUEUE_LEN];
+    uint16_t lens[TINYPAN_TX_QUEUE_LEN];
+    uint8_t pick = tinypan_fq_pick(flows, lens, slip_fq_snapshot(flows, lens));
+    if (pick == TINYPAN_FQ_NONE) {
         return;
     }
+    uint8_t slot = (s_slip_tx_head + pick) % TINYPAN_TX_QUEUE_LEN;
 
-    while (s_slip_tx_head != s_slip_tx_tail) {
-        if (!hal_bt_l2cap_can_send()) {
-            hal_bt_l2cap_request_can_send_now();
-            hal_mutex_unlock(s_slip_tx_mutex);
-            break;
-        }
+    slip_tx_job_t picked = s_slip_tx_queue[slot];
+    while (slot != s_slip_tx_head) {
+        uint8_t prev = (slot + TINYPAN_TX_QUEUE_LEN - 1) % TINYPAN_TX_QUEUE_LEN;
+        s_slip_tx_queue[slot] = s_slip_tx_queue[prev];
+        slot = prev;
+    }
+    s_slip_tx_queue[s_slip_tx_head] = picked;
+}
+#endif
 
-        /* If we have a pending chunk from a previous busy state, try sending it first */
-        if (s_slip_chunk_len > 0) {
-            int result = hal_bt_l2cap_send(s_slip_chunk_buf, s_slip_chunk_len);
-            if (result > 0) {
-                hal_bt_l2cap_request_can_send_now();
-                hal_mutex_unlock(s_slip_tx_mutex);
-                break;
-            } else if (result < 0) {
-                /* Hard error, drop packet and log */
-                TINYPAN_LOG_ERROR("slip_tx: HAL send failed (%d), dropping packet", result);
-                s_slip_chunk_len = 0;
-                goto drop_packet;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+static void slip_transport_link_estimate(tinypan_link_estimate_t* estimate) {
+    hal_mutex_lock(s_slip_tx_mutex);
+    tinypan_link_est_get(estimate);
+    hal_mutex_unlock(s_slip_tx_mutex);
+}
+#endif
+
+/**
+ * @brief Encode queued frames into free chunk slots
+ *
+ * A frame's pbuf is released as soon as its closing END has been encoded;
+ * the chunks hold their own copy of the bytes. The chunk with the END
+ * carries what the link estimator needs to time the frame once it is sent.
+ */
+static void slip_transport_fill_chunks(void) {
+    while (s_slip_chunk_count < TINYPAN_SLIP_TX_CHUNKS && s_slip_tx_head != s_slip_tx_tail) {
+        if (s_slip_tx_state == 0) {
+#if TINYPAN_ENABLE_TX_BURST
+            if (!tinypan_burst_may_send()) {
+                break; /* tinypan_process() drains again when the hold expires */
             }
-            s_slip_chunk_len = 0; /* Successfully sent */
-            continue; /* Immediately check if we can send more */
+            tinypan_burst_started();
+#endif
+#if TINYPAN_ENABLE_FQ
+            slip_fq_schedule();
+#endif
+            slip_transport_start_job(&s_slip_tx_queue[s_slip_tx_head]);
         }
 
-        /* Fill the next chunk */
-        struct pbuf* root_pbuf = s_slip_tx_queue[s_slip_tx_head];
-        if (s_slip_tx_current == NULL) {
-            s_slip_tx_current = root_pbuf;
-            s_slip_tx_offset = 0;
-            s_slip_tx_state = 0;
+        /* BLE-compliant Dynamic MTU: The operational chunk size is the minimum of
+         * our static staging buffer and the current HAL-negotiated link MTU.
+         * This ensures TinyPAN remains compatible with iOS (MTU 185) and Android
+         * (MTU 247) without requiring compile-time branching. */
+        uint16_t hal_mtu = hal_bt_l2cap_get_mtu();
+        uint16_t max_chunk = (hal_mtu < TINYPAN_SLIP_CHUNK_SIZE) ? hal_mtu : TINYPAN_SLIP_CHUNK_SIZE;
+
+        /* Prevent runtime integer underflow/overflow if MTU is abnormally small.
+         * If link is unusable, drop the packet to prevent queue stalls. */
+        if (max_chunk < 4) {
+            TINYPAN_LOG_ERROR("slip_tx: MTU %u too small for SLIP, dropping packet", hal_mtu);
+            slip_transport_tx_desync();
+            slip_transport_finish_job();
+            continue;
         }
 
+        slip_tx_chunk_t* chunk = &s_slip_chunks[(s_slip_chunk_head + s_slip_chunk_count) % TINYPAN_SLIP_TX_CHUNKS];
+        uint8_t* buf = chunk->buf;
         uint16_t chunk_idx = 0;
 
         if (s_slip_tx_state == 0) {
-            s_slip_chunk_buf[chunk_idx++] = SLIP_END;
+            buf[chunk_idx++] = SLIP_END;
             s_slip_tx_state = 1;
         }
 
         if (s_slip_tx_state == 1) {
-            /* BLE-compliant Dynamic MTU: The operational chunk size is the minimum of
-     * our static staging buffer and the current HAL-negotiated link MTU.
-     * This ensures TinyPAN remains compatible with iOS (MTU 185) and Android 
-     * (MTU 247) without requiring compile-time branching. */
-    uint16_t hal_mtu = hal_bt_l2cap_get_mtu();
-    uint16_t max_chunk = (hal_mtu < sizeof(s_slip_chunk_buf)) ? hal_mtu : sizeof(s_slip_chunk_buf);
-    
-    /* Prevent runtime integer underflow/overflow if MTU is abnormally small. 
-     * If link is unusable, drop the packet to prevent queue stalls. */
-    if (max_chunk < 4) {
-        TINYPAN_LOG_ERROR("slip_tx: MTU %u too small for SLIP, dropping packet", hal_mtu);
-        goto drop_packet;
-    }
-    
-    /* Worst-Case Expansion Note
-     * SLIP guarantees frame integrity by escaping 0xC0 (END) and 0xDB (ESC). 
-     * In the absolute worst case where an entire IP payload consists exclusively 
-     * of these bytes, the payload size will exactly double during encoding. 
-     * The `max_chunk - 2` logic below ensures the buffer will never overflow 
-     * even with peak back-to-back escapes, but integrators pushing maximum UDP 
-     * throughput should be aware that worst-case payloads will take twice as 
-     * long to transmit over the BLE link due to this expansion.
-     */
-    /* Efficient single-pass encoder using direct pointer traversal. */
-    while (s_slip_tx_current != NULL && chunk_idx < max_chunk - 2) {
-        /* Skip zero-length pbufs in the chain (valid in lwIP) */
-        if (s_slip_tx_current->len == 0) {
-            s_slip_tx_current = s_slip_tx_current->next;
-            s_slip_tx_offset = 0;
-            continue;
-        }
+            /* Worst-Case Expansion Note
+             * SLIP guarantees frame integrity by escaping 0xC0 (END) and 0xDB (ESC).
+             * In the absolute worst case where an entire IP payload consists exclusively
+             * of these bytes, the payload size will exactly double during encoding.
+             * slip_encode_bytes() only emits an escape pair when both bytes fit, so
+             * chunks fill to max_chunk without overflowing, but integrators pushing
+             * maximum UDP throughput should be aware that worst-case payloads will
+             * take twice as long to transmit over the BLE link due to this expansion.
+             */
+            bool hdr_pending = false;
+#if SLIP_HAS_NEGOTIATION
+            /* Prefix first, then the rest of the original packet */
+            if (s_slip_tx_prefix_offset < s_slip_tx_prefix_len) {
+                s_slip_tx_prefix_offset += slip_encode_bytes(
+                    &s_slip_tx_prefix[s_slip_tx_prefix_offset],
+                    (uint16_t)(s_slip_tx_prefix_len - s_slip_tx_prefix_offset),
+                    buf, &chunk_idx, max_chunk);
+                hdr_pending = (s_slip_tx_prefix_offset < s_slip_tx_prefix_len);
+            }
+#endif
+            /* Efficient single-pass encoder using direct pointer traversal. */
+            while (!hdr_pending && s_slip_tx_current != NULL && chunk_idx < max_chunk) {
+                /* Skip zero-length pbufs in the chain (valid in lwIP) */
+                if (s_slip_tx_current->len == 0) {
+                    s_slip_tx_current = s_slip_tx_current->next;
+                    s_slip_tx_offset = 0;
+                    continue;
+                }
 
-        const uint8_t* payload_ptr = (const uint8_t*)s_slip_tx_current->payload + s_slip_tx_offset;
-        uint16_t remaining_in_pbuf = s_slip_tx_current->len - s_slip_tx_offset;
-
-        while (remaining_in_pbuf > 0 && chunk_idx < max_chunk - 2) {
-            uint8_t c = *payload_ptr;
-            if (c == SLIP_END) {
-                s_slip_chunk_buf[chunk_idx++] = SLIP_ESC;
-                s_slip_chunk_buf[chunk_idx++] = SLIP_ESC_END;
-            } else if (c == SLIP_ESC) {
-                s_slip_chunk_buf[chunk_idx++] = SLIP_ESC;
-                s_slip_chunk_buf[chunk_idx++] = SLIP_ESC_ESC;
-            } else {
-                s_slip_chunk_buf[chunk_idx++] = c;
+                const uint8_t* payload_ptr = (const uint8_t*)s_slip_tx_current->payload + s_slip_tx_offset;
+                uint16_t remaining_in_pbuf = s_slip_tx_current->len - s_slip_tx_offset;
+
+                uint16_t consumed = slip_encode_bytes(payload_ptr, remaining_in_pbuf,
+                                                      buf, &chunk_idx, max_chunk);
+                s_slip_tx_offset += consumed;
+
+                if (s_slip_tx_offset >= s_slip_tx_current->len) {
+                    s_slip_tx_current = s_slip_tx_current->next;
+                    s_slip_tx_offset = 0;
+                } else if (consumed < remaining_in_pbuf) {
+                    break; /* Chunk full */
+                }
             }
-            
-            payload_ptr++;
-            s_slip_tx_offset++;
-            remaining_in_pbuf--;
-        }
 
-        if (s_slip_tx_offset >= s_slip_tx_current->len) {
-            s_slip_tx_current = s_slip_tx_current->next;
-            s_slip_tx_offset = 0;
-        }
-    }
-            if (s_slip_tx_current == NULL) {
+            if (!hdr_pending && s_slip_tx_current == NULL) {
                 s_slip_tx_state = 2;
             }
         }
 
         bool frame_done = false;
         if (s_slip_tx_state == 2 && chunk_idx < max_chunk) {
-            s_slip_chunk_buf[chunk_idx++] = SLIP_END;
-            s_slip_tx_state = 0; /* Reset state immediately so we don't double-append on retry */
+            buf[chunk_idx++] = SLIP_END;
             frame_done = true;
         }
 
-        if (chunk_idx > 0) {
-            s_slip_chunk_len = chunk_idx;
-            int result = hal_bt_l2cap_send(s_slip_chunk_buf, s_slip_chunk_len);
+        chunk->len = chunk_idx;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+        chunk->frame_len = 0;
+        if (frame_done) {
+            const slip_tx_job_t* job = &s_slip_tx_queue[s_slip_tx_head];
+            chunk->frame_len = job->p->tot_len;
+            chunk->queued_at_ms = job->queued_at_ms;
+        }
+#endif
+        s_slip_chunk_count++;
+
+        if (frame_done) {
+            slip_transport_finish_job();
+        }
+    }
+}
+
+/**
+ * @brief Discard all encoded chunks after a hard HAL error
+ */
+static void slip_transport_drop_chunks(void) {
+    s_slip_chunk_head = 0;
+    s_slip_chunk_count = 0;
+    slip_transport_tx_desync();
+    if (s_slip_tx_state != 0) {
+        /* The start of the frame being encoded is gone with the chunks */
+        slip_transport_finish_job();
+    }
+}
+
+/**
+ * @brief Hand encoded chunks to the HAL while it reports free TX slots
+ *
+ * @return false if the radio is congested and CAN_SEND_NOW has been
+ *         requested, or the pacer holds the next chunk back
+ */
+static bool slip_transport_send_chunks(void) {
+    while (s_slip_chunk_count > 0) {
+        uint16_t credits = hal_bt_l2cap_get_tx_credits();
+        if (credits == 0) {
+            hal_bt_l2cap_request_can_send_now();
+            return false;
+        }
+
+        while (credits > 0 && s_slip_chunk_count > 0) {
+            slip_tx_chunk_t* chunk = &s_slip_chunks[s_slip_chunk_head];
+#if TINYPAN_ENABLE_PACING
+            if (!tinypan_pacer_admit(chunk->len)) {
+                return false; /* tinypan_process() drains again at the release time */
+            }
+#endif
+            int result = hal_bt_l2cap_send(chunk->buf, chunk->len);
             if (result > 0) {
+#if TINYPAN_ENABLE_PACING
+                tinypan_pacer_refund(chunk->len);
+#endif
+                /* Chunk stays at the head of the ring for the next attempt */
                 hal_bt_l2cap_request_can_send_now();
-                hal_mutex_unlock(s_slip_tx_mutex);
-                break;
+                return false;
             } else if (result < 0) {
-                s_slip_chunk_len = 0;
-                goto drop_packet;
+#if TINYPAN_ENABLE_PACING
+                tinypan_pacer_refund(chunk->len);
+#endif
+                TINYPAN_LOG_ERROR("slip_tx: HAL send failed (%d), dropping %u buffered chunks",
+                                  result, s_slip_chunk_count);
+                slip_transport_drop_chunks();
+                return true;
+            }
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+            if (chunk->frame_len > 0) {
+                /* The last chunk of the frame is with the radio */
+                tinypan_link_est_completed(chunk->frame_len, chunk->queued_at_ms);
             }
-            s_slip_chunk_len = 0; /* Sent successfully */
+#endif
+            s_slip_chunk_head = (uint8_t)((s_slip_chunk_head + 1) % TINYPAN_SLIP_TX_CHUNKS);
+            s_slip_chunk_count--;
+            credits--;
         }
+    }
+    return true;
+}
 
-        if (frame_done) {
-drop_packet:
-            pbuf_free(root_pbuf);
-            s_slip_tx_queue[s_slip_tx_head] = NULL;
-            s_slip_tx_head = (s_slip_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
-            s_slip_tx_current = NULL;
-            s_slip_tx_offset = 0;
-            s_slip_tx_state = 0;
-            s_slip_chunk_len = 0;
+static void slip_transport_drain_tx_queue(void) {
+    hal_mutex_lock(s_slip_tx_mutex);
+
+    /* Encode ahead, then fill every free TX slot the link reports so a single
+     * connection event can carry several chunks */
+    for (;;) {
+        slip_transport_fill_chunks();
+        if (s_slip_chunk_count == 0 || !slip_transport_send_chunks()) {
+            break;
         }
     }
+
+#if TINYPAN_ENABLE_TX_BURST
+    if (s_slip_chunk_count == 0 && s_slip_tx_head == s_slip_tx_tail) {
+        tinypan_burst_drained();
+    }
+#endif
+
     hal_mutex_unlock(s_slip_tx_mutex);
+    tinypan_transport_tx_notify();
 }
 
 static void slip_transport_process(void) {
-    /* Maintenance hook for future use (e.g. flow control timeouts) */
+#if TINYPAN_SLIP_MTU_AUTOTUNE
+    /* Cheap when nothing changed: one HAL query and a compare */
+    slip_transport_tune_mtu();
+#endif
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    /* Under the TX lock, which covers every other update of the window */
+    hal_mutex_lock(s_slip_tx_mutex);
+    tinypan_link_est_process();
+    hal_mutex_unlock(s_slip_tx_mutex);
+#endif
 }
 
-void slip_transport_flush_tx_queue(void) {
+static void slip_transport_flush_tx_queue(void) {
     hal_mutex_lock(s_slip_tx_mutex);
     while (s_slip_tx_head != s_slip_tx_tail) {
-        if (s_slip_tx_queue[s_slip_tx_head] != NULL) {
-            pbuf_free(s_slip_tx_queue[s_slip_tx_head]);
-            s_slip_tx_queue[s_slip_tx_head] = NULL;
+        if (s_slip_tx_queue[s_slip_tx_head].p != NULL) {
+            tinypan_transport_tx_released(s_slip_tx_queue[s_slip_tx_head].p->tot_len);
+            pbuf_free(s_slip_tx_queue[s_slip_tx_head].p);
+            s_slip_tx_queue[s_slip_tx_head].p = NULL;
         }
         s_slip_tx_head = (s_slip_tx_head + 1) % TINYPAN_TX_QUEUE_LEN;
     }
     s_slip_tx_current = NULL;
     s_slip_tx_offset = 0;
     s_slip_tx_state = 0;
-    s_slip_chunk_len = 0;
+    s_slip_chunk_head = 0;
+    s_slip_chunk_count = 0;
+    slip_transport_tx_desync();
+#if TINYPAN_ENABLE_TX_BURST
+    tinypan_burst_drained();
+#endif
+    hal_mutex_unlock(s_slip_tx_mutex);
+    tinypan_transport_tx_notify();
+}
+
+/**
+ * @brief Append a frame to the TX ring
+ *
+ * Takes ownership of one reference to p (freed on failure).
+ *
+ * @param compress  Run the frame through the header compressor if negotiated
+ * @return 0 on success, -1 if the ring (or the frame's flow share) is full
+ */
+static int slip_transport_enqueue(struct pbuf* p, bool compress) {
+#if TINYPAN_ENABLE_FQ || TINYPAN_ENABLE_TX_BURST
+    uint8_t l3[TINYPAN_TX_PEEK_LEN];
+    uint16_t l3_len = pbuf_copy_partial(p, l3, sizeof(l3), 0);
+    uint16_t ethertype = (l3_len > 0 && (l3[0] >> 4) == 6) ? 0x86DD : 0x0800;
+#endif
+#if TINYPAN_ENABLE_FQ
+    uint8_t flow = tinypan_fq_classify(ethertype, l3, l3_len);
+#endif
+#if TINYPAN_ENABLE_TX_BURST
+    /* Control frames (not offered to the compressor) never wait */
+    bool urgent = !compress || tinypan_burst_urgent(ethertype, l3, l3_len);
+#endif
+
+    hal_mutex_lock(s_slip_tx_mutex);
+    uint8_t next_tail = (s_slip_tx_tail + 1) % TINYPAN_TX_QUEUE_LEN;
+    if (next_tail == s_slip_tx_head) {
+        tinypan_transport_tx_refused();
+        hal_mutex_unlock(s_slip_tx_mutex);
+        pbuf_free(p);
+        tinypan_transport_tx_notify();
+        return -1;
+    }
+#if TINYPAN_ENABLE_FQ
+    uint8_t flows[TINYPAN_TX_QUEUE_LEN];
+    uint16_t lens[TINYPAN_TX_QUEUE_LEN];
+    if (!tinypan_fq_admit(flows, slip_fq_snapshot(flows, lens), flow)) {
+        /* This flow has its share; the queue stays open to the others */
+        tinypan_transport_tx_refused();
+        hal_mutex_unlock(s_slip_tx_mutex);
+        pbuf_free(p);
+        tinypan_transport_tx_notify();
+        return -1;
+    }
+#endif
+
+    slip_tx_job_t* job = &s_slip_tx_queue[s_slip_tx_tail];
+    job->p = p;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    job->queued_at_ms = hal_get_tick_ms();
+#endif
+#if TINYPAN_ENABLE_FQ
+    job->flow = flow;
+#endif
+#if TINYPAN_SLIP_ENABLE_VJ
+    job->compress = compress;
+#else
+    (void)compress;
+#endif
+
+    s_slip_tx_tail = next_tail;
+    tinypan_transport_tx_enqueued(p->tot_len);
+#if TINYPAN_ENABLE_TX_BURST
+    tinypan_burst_queued(urgent || (s_slip_tx_tail + 1) % TINYPAN_TX_QUEUE_LEN == s_slip_tx_head);
+#endif
     hal_mutex_unlock(s_slip_tx_mutex);
+    return 0;
 }
 
 static int slip_transport_output(struct netif* netif, struct pbuf* p) {
     (void)netif;
     if (p == NULL) return ERR_ARG;
-    
+
     /* Incref the original pbuf. The drain loop will free it.
      * We avoid pbuf_clone(PBUF_RAM) because it would eat the heap. */
     pbuf_ref(p);
-    struct pbuf* q = p;
-
-    uint8_t next_tail = (s_slip_tx_tail + 1) % TINYPAN_TX_QUEUE_LEN;
-    hal_mutex_lock(s_slip_tx_mutex);
-    if (next_tail == s_slip_tx_head) {
-        hal_mutex_unlock(s_slip_tx_mutex);
-        pbuf_free(q);
+    if (slip_transport_enqueue(p, true) != 0) {
         return ERR_MEM;
     }
 
-    s_slip_tx_queue[s_slip_tx_tail] = q;
-    s_slip_tx_tail = next_tail;
-    hal_mutex_unlock(s_slip_tx_mutex);
-    
     /* Kick TX engine */
     slip_transport_drain_tx_queue();
-    
+
     return ERR_OK;
 }
 
@@ -366,10 +1058,19 @@ const tinypan_transport_t transport_slip = {
     .handle_incoming = slip_transport_handle_incoming,
     .retry_setup = slip_transport_retry_setup,
     .on_can_send_now = slip_transport_on_can_send_now,
+#if TINYPAN_ENABLE_LWIP
     .flush_queues = slip_transport_flush_tx_queue,
     .process = slip_transport_process,
-#if TINYPAN_ENABLE_LWIP
-    .output = slip_transport_output
+    .output = slip_transport_output,
+#if TINYPAN_ENABLE_FQ
+    .tx_flow_room = slip_transport_tx_flow_room,
+#endif
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    .link_estimate = slip_transport_link_estimate,
+#endif
+#if TINYPAN_ENABLE_HEARTBEAT
+    .send_probe = slip_transport_send_probe,
+#endif
 #endif
 };
 
@@ -0,0 +1,598 @@
+/*
+ * TinyPAN SLIP Header Compression
+ *
+ * RFC 1144 TCP/IP header compression (Van Jacobson, CSLIP) with a small
+ * TinyPAN extension for UDP and ICMP datagram flows. The TCP part follows
+ * the reference slcompress.c algorithm: per-connection slots hold the last
+ * header seen, and only the fields that changed are sent as deltas.
+ *
+ * UDP/ICMP context scheme: the first frame of a flow carries a one-byte
+ * refresh prefix (0x2X) in front of the full packet, which primes slot X on
+ * both sides. Later frames carry (0x3X, IP ID, UDP checksum) instead of the
+ * 20-byte IP header and the UDP ports/length (28 -> 5 bytes for UDP,
+ * 20 -> 3 bytes for ICMP).
+ *
+ * All header fields are accessed through byte-wise helpers so the codec is
+ * safe on MCUs that fault on unaligned loads.
+ */
+
+#include "tinypan_slip_vj.h"
+
+#include <string.h>
+
+#if TINYPAN_SLIP_VJ_SLOTS < 1 || TINYPAN_SLIP_VJ_SLOTS > 16
+#error "TINYPAN_SLIP_VJ_SLOTS must be between 1 and 16"
+#endif
+
+#if TINYPAN_SLIP_VJ_CTX_SLOTS < 1 || TINYPAN_SLIP_VJ_CTX_SLOTS > 16
+#error "TINYPAN_SLIP_VJ_CTX_SLOTS must be between 1 and 16"
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* IP protocol numbers */
+#define VJ_PROTO_ICMP           1
+#define VJ_PROTO_TCP            6
+#define VJ_PROTO_UDP            17
+
+/* TCP flags */
+#define VJ_TH_FIN               0x01
+#define VJ_TH_SYN               0x02
+#define VJ_TH_RST               0x04
+#define VJ_TH_PUSH              0x08
+#define VJ_TH_ACK               0x10
+#define VJ_TH_URG               0x20
+
+/* RFC 1144 change mask bits */
+#define VJ_NEW_C                0x40
+#define VJ_NEW_I                0x20
+#define VJ_TCP_PUSH_BIT         0x10
+#define VJ_NEW_S                0x08
+#define VJ_NEW_A                0x04
+#define VJ_NEW_W                0x02
+#define VJ_NEW_U                0x01
+
+#define VJ_SPECIAL_I            (VJ_NEW_S | VJ_NEW_W | VJ_NEW_U)
+#define VJ_SPECIAL_D            (VJ_NEW_S | VJ_NEW_A | VJ_NEW_W | VJ_NEW_U)
+#define VJ_SPECIALS_MASK        (VJ_NEW_S | VJ_NEW_A | VJ_NEW_W | VJ_NEW_U)
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static inline uint16_t rd16(const uint8_t* p) {
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static inline uint32_t rd32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void wr16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static inline void wr32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+/**
+ * @brief Recompute the IPv4 header checksum in place
+ */
+static void ip_hdr_checksum(uint8_t* ip, uint16_t ip_hlen) {
+    uint32_t sum = 0;
+    ip[10] = 0;
+    ip[11] = 0;
+    for (uint16_t i = 0; i < ip_hlen; i += 2) {
+        sum += rd16(&ip[i]);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    wr16(&ip[10], (uint16_t)~sum);
+}
+
+/**
+ * @brief RFC 1144 ENCODE/ENCODEZ: one byte, or a zero escape plus 16 bits
+ *
+ * @param allow_zero true for fields that may legitimately be 0 (ENCODEZ)
+ */
+static uint8_t* vj_encode(uint8_t* cp, uint16_t n, bool allow_zero) {
+    if (n >= 256 || (allow_zero && n == 0)) {
+        *cp++ = 0;
+        *cp++ = (uint8_t)(n >> 8);
+        *cp++ = (uint8_t)n;
+    } else {
+        *cp++ = (uint8_t)n;
+    }
+    return cp;
+}
+
+/**
+ * @brief RFC 1144 DECODE: bounds-checked inverse of vj_encode()
+ */
+static bool vj_decode(const uint8_t** cp, const uint8_t* end, uint16_t* n) {
+    const uint8_t* p = *cp;
+    if (p >= end) return false;
+    if (*p == 0) {
+        if (end - p < 3) return false;
+        *n = rd16(p + 1);
+        *cp = p + 3;
+    } else {
+        *n = *p;
+        *cp = p + 1;
+    }
+    return true;
+}
+
+/* ============================================================================
+ * Compression
+ * ============================================================================ */
+
+static uint8_t vj_compress_tcp(slip_vj_state_t* vj, const uint8_t* pkt, uint16_t avail,
+                               uint16_t pkt_len, uint8_t* out, uint16_t* skip) {
+    uint16_t ip_hlen = (uint16_t)((pkt[0] & 0x0F) * 4);
+    if (ip_hlen < 20 || avail < ip_hlen + 20) return 0;
+
+    const uint8_t* th = pkt + ip_hlen;
+    uint16_t hlen = (uint16_t)(ip_hlen + (th[12] >> 4) * 4);
+    if ((th[12] >> 4) < 5 || hlen > SLIP_VJ_MAX_HDR || hlen > avail || hlen > pkt_len) {
+        return 0;
+    }
+
+    /* Only plain ACK segments are compressible; SYN/FIN/RST go as TYPE_IP */
+    uint8_t flags = th[13];
+    if ((flags & (VJ_TH_SYN | VJ_TH_FIN | VJ_TH_RST | VJ_TH_ACK)) != VJ_TH_ACK) {
+        return 0;
+    }
+
+    /* Locate the connection slot: same addresses and ports. Otherwise take
+     * the least recently used slot and send the header uncompressed. */
+    uint8_t slot = 0;
+    bool found = false;
+    bool victim_free = false;
+    for (uint8_t i = 0; i < TINYPAN_SLIP_VJ_SLOTS; i++) {
+        slip_vj_tcp_slot_t* cs = &vj->tx_tcp[i];
+        if (cs->hlen != 0 &&
+            memcmp(&cs->hdr[12], &pkt[12], 8) == 0 &&
+            memcmp(&cs->hdr[(cs->hdr[0] & 0x0F) * 4], th, 4) == 0) {
+            slot = i;
+            found = true;
+            break;
+        }
+        if (victim_free) continue;
+        if (cs->hlen == 0) {
+            slot = i;
+            victim_free = true;
+        } else if ((int16_t)(cs->stamp - vj->tx_tcp[slot].stamp) < 0) {
+            slot = i;
+        }
+    }
+
+    slip_vj_tcp_slot_t* cs = &vj->tx_tcp[slot];
+    cs->stamp = ++vj->tx_clock;
+
+    uint8_t deltas[16];
+    uint8_t* cp = deltas;
+    uint8_t changes = 0;
+    const uint8_t* oip = cs->hdr;
+    const uint8_t* oth = cs->hdr + ip_hlen;
+
+    if (!found) goto uncompressed;
+
+    /* Fields that must stay constant for the slot to remain valid:
+     * version/IHL/TOS, fragment field, TTL/protocol, data offset and options. */
+    if (cs->hlen != hlen ||
+        memcmp(&oip[0], &pkt[0], 2) != 0 ||
+        memcmp(&oip[6], &pkt[6], 4) != 0 ||
+        oth[12] != th[12] ||
+        memcmp(&oip[20], &pkt[20], ip_hlen - 20) != 0 ||
+        memcmp(&oth[20], &th[20], hlen - ip_hlen - 20) != 0) {
+        goto uncompressed;
+    }
+
+    /* The decompressor only regenerates PUSH and URG; any other flag change
+     * (or URG being cleared, which the special encodings cannot express)
+     * needs a refresh. */
+    if (((flags ^ oth[13]) & (uint8_t)~(VJ_TH_PUSH | VJ_TH_URG)) != 0) {
+        goto uncompressed;
+    }
+
+    if (flags & VJ_TH_URG) {
+        cp = vj_encode(cp, rd16(&th[18]), true);
+        changes |= VJ_NEW_U;
+    } else if (rd16(&th[18]) != rd16(&oth[18]) || (oth[13] & VJ_TH_URG)) {
+        goto uncompressed;
+    }
+
+    uint16_t delta_w = (uint16_t)(rd16(&th[14]) - rd16(&oth[14]));
+    if (delta_w) {
+        cp = vj_encode(cp, delta_w, false);
+        changes |= VJ_NEW_W;
+    }
+
+    uint32_t delta_a = rd32(&th[8]) - rd32(&oth[8]);
+    if (delta_a) {
+        if (delta_a > 0xFFFF) goto uncompressed;
+        cp = vj_encode(cp, (uint16_t)delta_a, false);
+        changes |= VJ_NEW_A;
+    }
+
+    uint32_t delta_s = rd32(&th[4]) - rd32(&oth[4]);
+    if (delta_s) {
+        if (delta_s > 0xFFFF) goto uncompressed;
+        cp = vj_encode(cp, (uint16_t)delta_s, false);
+        changes |= VJ_NEW_S;
+    }
+
+    switch (changes) {
+        case 0:
+            /* Nothing changed. A data segment following a pure ACK is normal
+             * on interactive flows; anything else is probably a retransmit
+             * and goes uncompressed in case the peer missed the original. */
+            if (rd16(&pkt[2]) != rd16(&oip[2]) && rd16(&oip[2]) == hlen) {
+                break;
+            }
+            goto uncompressed;
+
+        case VJ_SPECIAL_I:
+        case VJ_SPECIAL_D:
+            /* Actual changes collide with the special encodings */
+            goto uncompressed;
+
+        case VJ_NEW_S | VJ_NEW_A:
+            if (delta_s == delta_a && delta_s == (uint32_t)(rd16(&oip[2]) - hlen)) {
+                /* Terminal traffic: both sides advanced by the last payload */
+                changes = VJ_SPECIAL_I;
+                cp = deltas;
+            }
+            break;
+
+        case VJ_NEW_S:
+            if (delta_s == (uint32_t)(rd16(&oip[2]) - hlen)) {
+                /* Unidirectional data transfer */
+                changes = VJ_SPECIAL_D;
+                cp = deltas;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    uint16_t delta_i = (uint16_t)(rd16(&pkt[4]) - rd16(&oip[4]));
+    if (delta_i != 1) {
+        cp = vj_encode(cp, delta_i, true);
+        changes |= VJ_NEW_I;
+    }
+    if (flags & VJ_TH_PUSH) {
+        changes |= VJ_TCP_PUSH_BIT;
+    }
+
+    memcpy(cs->hdr, pkt, hlen);
+
+    uint8_t* o = out;
+    if (vj->tx_last != slot) {
+        vj->tx_last = slot;
+        *o++ = (uint8_t)(SLIP_VJ_TYPE_COMPRESSED_TCP | VJ_NEW_C | changes);
+        *o++ = slot;
+    } else {
+        *o++ = (uint8_t)(SLIP_VJ_TYPE_COMPRESSED_TCP | changes);
+    }
+    *o++ = th[16]; /* TCP checksum is always sent verbatim */
+    *o++ = th[17];
+    memcpy(o, deltas, (size_t)(cp - deltas));
+    o += cp - deltas;
+
+    *skip = hlen;
+    vj->tx_compressed++;
+    vj->tx_bytes_saved += (uint32_t)(hlen - (o - out));
+    return (uint8_t)(o - out);
+
+uncompressed:
+    /* Refresh the slot: full header, version nibble replaced by the type
+     * and the protocol byte replaced by the slot id. */
+    memcpy(cs->hdr, pkt, hlen);
+    cs->hlen = (uint8_t)hlen;
+    vj->tx_last = slot;
+
+    memcpy(out, pkt, hlen);
+    out[0] = (uint8_t)(SLIP_VJ_TYPE_UNCOMPRESSED_TCP | (pkt[0] & 0x0F));
+    out[9] = slot;
+    *skip = hlen;
+    return (uint8_t)hlen;
+}
+
+static uint8_t vj_compress_ctx(slip_vj_state_t* vj, const uint8_t* pkt, uint16_t avail,
+                               uint16_t pkt_len, uint8_t* out, uint16_t* skip) {
+    /* Context flows are restricted to option-less headers */
+    if (pkt[0] != 0x45) return 0;
+
+    bool udp = (pkt[9] == VJ_PROTO_UDP);
+    if (!udp && pkt[9] != VJ_PROTO_ICMP) return 0;
+
+    uint16_t hlen = udp ? SLIP_VJ_CTX_HDR : 20;
+    if (avail < hlen || pkt_len < hlen) return 0;
+    if (udp && rd16(&pkt[24]) != pkt_len - 20) return 0;
+
+    for (uint8_t i = 0; i < TINYPAN_SLIP_VJ_CTX_SLOTS; i++) {
+        slip_vj_ctx_slot_t* ctx = &vj->tx_ctx[i];
+        if (ctx->valid &&
+            memcmp(&ctx->hdr[0], &pkt[0], 2) == 0 &&
+            memcmp(&ctx->hdr[6], &pkt[6], 4) == 0 &&
+            memcmp(&ctx->hdr[12], &pkt[12], 8) == 0 &&
+            (!udp || memcmp(&ctx->hdr[20], &pkt[20], 4) == 0)) {
+            uint8_t n = 0;
+            out[n++] = (uint8_t)(SLIP_VJ_TYPE_CTX_COMPRESSED | i);
+            out[n++] = pkt[4]; /* IP ID */
+            out[n++] = pkt[5];
+            if (udp) {
+                out[n++] = pkt[26]; /* UDP checksum */
+                out[n++] = pkt[27];
+            }
+            *skip = hlen;
+            vj->tx_compressed++;
+            vj->tx_bytes_saved += (uint32_t)(hlen - n);
+            return n;
+        }
+    }
+
+    uint8_t slot = vj->tx_ctx_next;
+    vj->tx_ctx_next = (uint8_t)((slot + 1) % TINYPAN_SLIP_VJ_CTX_SLOTS);
+    memcpy(vj->tx_ctx[slot].hdr, pkt, hlen);
+    vj->tx_ctx[slot].valid = true;
+
+    out[0] = (uint8_t)(SLIP_VJ_TYPE_CTX_REFRESH | slot);
+    *skip = 0;
+    return 1;
+}
+
+/* ============================================================================
+ * Decompression
+ * ============================================================================ */
+
+static int vj_uncompress_tcp(slip_vj_state_t* vj, const uint8_t* frame, uint16_t len,
+                             uint8_t* hdr_out, uint16_t* hdr_len) {
+    const uint8_t* cp = frame;
+    const uint8_t* end = frame + len;
+    uint8_t changes = *cp++;
+
+    if (changes & VJ_NEW_C) {
+        if (cp >= end || *cp >= TINYPAN_SLIP_VJ_SLOTS) goto bad;
+        vj->rx_last = *cp++;
+        vj->rx_toss = false;
+    } else if (vj->rx_toss) {
+        /* Waiting for the sender to resynchronise this slot */
+        vj->rx_errors++;
+        return -1;
+    }
+
+    slip_vj_tcp_slot_t* cs = &vj->rx_tcp[vj->rx_last];
+    if (cs->hlen == 0 || end - cp < 2) goto bad;
+
+    uint8_t* ip = cs->hdr;
+    uint16_t ip_hlen = (uint16_t)((ip[0] & 0x0F) * 4);
+    uint8_t* th = ip + ip_hlen;
+    uint16_t n;
+
+    th[16] = *cp++;
+    th[17] = *cp++;
+
+    if (changes & VJ_TCP_PUSH_BIT) {
+        th[13] |= VJ_TH_PUSH;
+    } else {
+        th[13] &= (uint8_t)~VJ_TH_PUSH;
+    }
+
+    switch (changes & VJ_SPECIALS_MASK) {
+        case VJ_SPECIAL_I: {
+            uint32_t i = (uint32_t)(rd16(&ip[2]) - cs->hlen);
+            wr32(&th[8], rd32(&th[8]) + i);
+            wr32(&th[4], rd32(&th[4]) + i);
+            break;
+        }
+        case VJ_SPECIAL_D:
+            wr32(&th[4], rd32(&th[4]) + (uint32_t)(rd16(&ip[2]) - cs->hlen));
+            break;
+
+        default:
+            if (changes & VJ_NEW_U) {
+                th[13] |= VJ_TH_URG;
+                if (!vj_decode(&cp, end, &n)) goto bad;
+                wr16(&th[18], n);
+            } else {
+                th[13] &= (uint8_t)~VJ_TH_URG;
+            }
+            if (changes & VJ_NEW_W) {
+                if (!vj_decode(&cp, end, &n)) goto bad;
+                wr16(&th[14], (uint16_t)(rd16(&th[14]) + n));
+            }
+            if (changes & VJ_NEW_A) {
+                if (!vj_decode(&cp, end, &n)) goto bad;
+                wr32(&th[8], rd32(&th[8]) + n);
+            }
+            if (changes & VJ_NEW_S) {
+                if (!vj_decode(&cp, end, &n)) goto bad;
+                wr32(&th[4], rd32(&th[4]) + n);
+            }
+            break;
+    }
+
+    if (changes & VJ_NEW_I) {
+        if (!vj_decode(&cp, end, &n)) goto bad;
+        wr16(&ip[4], (uint16_t)(rd16(&ip[4]) + n));
+    } else {
+        wr16(&ip[4], (uint16_t)(rd16(&ip[4]) + 1));
+    }
+
+    uint16_t consumed = (uint16_t)(cp - frame);
+    wr16(&ip[2], (uint16_t)(cs->hlen + (len - consumed)));
+    ip_hdr_checksum(ip, ip_hlen);
+
+    memcpy(hdr_out, cs->hdr, cs->hlen);
+    *hdr_len = cs->hlen;
+    vj->rx_compressed++;
+    return consumed;
+
+bad:
+    vj->rx_toss = true;
+    vj->rx_errors++;
+    return -1;
+}
+
+static int vj_uncompress_refresh_tcp(slip_vj_state_t* vj, const uint8_t* frame, uint16_t len,
+                                     uint8_t* hdr_out, uint16_t* hdr_len) {
+    uint16_t ip_hlen = (uint16_t)((frame[0] & 0x0F) * 4);
+    if (ip_hlen < 20 || len < ip_hlen + 20) return -1;
+
+    uint16_t hlen = (uint16_t)(ip_hlen + (frame[ip_hlen + 12] >> 4) * 4);
+    uint8_t slot = frame[9];
+    if (hlen > SLIP_VJ_MAX_HDR || hlen > len || slot >= TINYPAN_SLIP_VJ_SLOTS) return -1;
+
+    memcpy(hdr_out, frame, hlen);
+    hdr_out[0] = (uint8_t)(SLIP_VJ_TYPE_IP | (frame[0] & 0x0F));
+    hdr_out[9] = VJ_PROTO_TCP;
+
+    slip_vj_tcp_slot_t* cs = &vj->rx_tcp[slot];
+    memcpy(cs->hdr, hdr_out, hlen);
+    cs->hlen = (uint8_t)hlen;
+    vj->rx_last = slot;
+    vj->rx_toss = false;
+
+    *hdr_len = hlen;
+    return hlen;
+}
+
+static int vj_uncompress_ctx(slip_vj_state_t* vj, const uint8_t* frame, uint16_t len,
+                             uint8_t* hdr_out, uint16_t* hdr_len) {
+    uint8_t slot = frame[0] & 0x0F;
+    if (slot >= TINYPAN_SLIP_VJ_CTX_SLOTS) return -1;
+    slip_vj_ctx_slot_t* ctx = &vj->rx_ctx[slot];
+
+    if ((frame[0] & 0xF0) == SLIP_VJ_TYPE_CTX_REFRESH) {
+        const uint8_t* ip = frame + 1;
+        if (len < 1 + 20 || ip[0] != 0x45) return -1;
+        bool udp = (ip[9] == VJ_PROTO_UDP);
+        if (!udp && ip[9] != VJ_PROTO_ICMP) return -1;
+        if (udp && len < 1 + SLIP_VJ_CTX_HDR) return -1;
+
+        memcpy(ctx->hdr, ip, udp ? SLIP_VJ_CTX_HDR : 20);
+        ctx->valid = true;
+        return 1; /* Strip the prefix, the packet itself is untouched */
+    }
+
+    if (!ctx->valid) return -1;
+
+    bool udp = (ctx->hdr[9] == VJ_PROTO_UDP);
+    uint16_t consumed = udp ? 5 : 3;
+    if (len < consumed) return -1;
+    uint16_t payload_len = (uint16_t)(len - consumed);
+
+    memcpy(hdr_out, ctx->hdr, 20);
+    hdr_out[4] = frame[1];
+    hdr_out[5] = frame[2];
+    if (udp) {
+        memcpy(&hdr_out[20], &ctx->hdr[20], 4);
+        wr16(&hdr_out[24], (uint16_t)(8 + payload_len));
+        hdr_out[26] = frame[3];
+        hdr_out[27] = frame[4];
+        *hdr_len = SLIP_VJ_CTX_HDR;
+    } else {
+        *hdr_len = 20;
+    }
+    wr16(&hdr_out[2], (uint16_t)(*hdr_len + payload_len));
+    ip_hdr_checksum(hdr_out, 20);
+
+    vj->rx_compressed++;
+    return consumed;
+}
+
+/* ============================================================================
+ * API Implementation
+ * ============================================================================ */
+
+void slip_vj_init(slip_vj_state_t* vj) {
+    if (vj == NULL) return;
+    memset(vj, 0, sizeof(*vj));
+    vj->tx_last = 0xFF;
+    vj->rx_toss = true;
+}
+
+void slip_vj_tx_reset(slip_vj_state_t* vj) {
+    if (vj == NULL) return;
+    memset(vj->tx_tcp, 0, sizeof(vj->tx_tcp));
+    memset(vj->tx_ctx, 0, sizeof(vj->tx_ctx));
+    vj->tx_last = 0xFF;
+}
+
+uint8_t slip_vj_compress(slip_vj_state_t* vj, const uint8_t* pkt, uint16_t avail,
+                         uint16_t pkt_len, uint8_t* out, uint16_t* skip) {
+    *skip = 0;
+    if (vj == NULL || pkt == NULL || avail < 20 || pkt_len < 20) return 0;
+    if ((pkt[0] >> 4) != 4 || rd16(&pkt[2]) != pkt_len) return 0;
+
+    /* Fragments always travel as TYPE_IP */
+    if (rd16(&pkt[6]) & 0x3FFF) return 0;
+
+    if (pkt[9] == VJ_PROTO_TCP) {
+        return vj_compress_tcp(vj, pkt, avail, pkt_len, out, skip);
+    }
+    return vj_compress_ctx(vj, pkt, avail, pkt_len, out, skip);
+}
+
+bool slip_vj_owns_type(uint8_t type) {
+    if (type & SLIP_VJ_TYPE_COMPRESSED_TCP) return true;
+
+    switch (type & 0xF0) {
+        case SLIP_VJ_TYPE_UNCOMPRESSED_TCP:
+        case SLIP_VJ_TYPE_CTX_REFRESH:
+        case SLIP_VJ_TYPE_CTX_COMPRESSED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int slip_vj_uncompress(slip_vj_state_t* vj, const uint8_t* frame, uint16_t len,
+                       uint8_t* hdr_out, uint16_t* hdr_len) {
+    int result;
+    *hdr_len = 0;
+    if (vj == NULL || frame == NULL || len == 0) return -1;
+
+    uint8_t type = frame[0];
+    if (type & SLIP_VJ_TYPE_COMPRESSED_TCP) {
+        return vj_uncompress_tcp(vj, frame, len, hdr_out, hdr_len);
+    }
+
+    switch (type & 0xF0) {
+        case SLIP_VJ_TYPE_IP:
+            return 0;
+        case SLIP_VJ_TYPE_UNCOMPRESSED_TCP:
+            result = vj_uncompress_refresh_tcp(vj, frame, len, hdr_out, hdr_len);
+            break;
+        case SLIP_VJ_TYPE_CTX_REFRESH:
+        case SLIP_VJ_TYPE_CTX_COMPRESSED:
+            result = vj_uncompress_ctx(vj, frame, len, hdr_out, hdr_len);
+            break;
+        default:
+            result = -1;
+            break;
+    }
+
+    if (result < 0) {
+        vj->rx_errors++;
+    }
+    return result;
+}
+
+void slip_vj_rx_error(slip_vj_state_t* vj) {
+    if (vj == NULL) return;
+    vj->rx_toss = true;
+}
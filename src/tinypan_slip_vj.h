@@ -0,0 +1,162 @@
+/*
+ * TinyPAN SLIP Header Compression - Internal Header
+ *
+ * RFC 1144 (Van Jacobson / CSLIP) TCP/IP header compression plus a small
+ * context scheme for UDP and ICMP flows. Operates on contiguous byte
+ * buffers only, so it carries no lwIP dependency and can be unit tested
+ * on the host in isolation.
+ */
+
+#ifndef TINYPAN_SLIP_VJ_H
+#define TINYPAN_SLIP_VJ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/** Largest IP+TCP header tracked by a connection slot (20 + 20 + 24 options) */
+#define SLIP_VJ_MAX_HDR             64
+
+/** Largest compressed header emitted by slip_vj_compress() */
+#define SLIP_VJ_MAX_OUT             SLIP_VJ_MAX_HDR
+
+/** IP + UDP header bytes stored by a UDP/ICMP context slot */
+#define SLIP_VJ_CTX_HDR             28
+
+/* ----------------------------------------------------------------------------
+ * Frame Types (high bits of the first byte of every SLIP frame)
+ *
+ *   0x4X        Plain IPv4 (TYPE_IP)
+ *   0x7X        RFC 1144 UNCOMPRESSED_TCP (protocol byte carries the slot)
+ *   0x80-0xFF   RFC 1144 COMPRESSED_TCP (low 7 bits are the change mask)
+ *   0x2X        TinyPAN UDP/ICMP context refresh, slot X, full packet follows
+ *   0x3X        TinyPAN UDP/ICMP compressed, slot X
+ * ---------------------------------------------------------------------------- */
+#define SLIP_VJ_TYPE_IP                 0x40
+#define SLIP_VJ_TYPE_UNCOMPRESSED_TCP   0x70
+#define SLIP_VJ_TYPE_COMPRESSED_TCP     0x80
+#define SLIP_VJ_TYPE_CTX_REFRESH        0x20
+#define SLIP_VJ_TYPE_CTX_COMPRESSED     0x30
+
+/* ============================================================================
+ * State
+ * ============================================================================ */
+
+/**
+ * @brief RFC 1144 connection slot (one per TCP flow)
+ */
+typedef struct {
+    uint8_t  hdr[SLIP_VJ_MAX_HDR];  /**< Last IP+TCP header seen on this flow */
+    uint8_t  hlen;                  /**< Valid bytes in hdr (0 = unused) */
+    uint16_t stamp;                 /**< LRU stamp (TX side only) */
+} slip_vj_tcp_slot_t;
+
+/**
+ * @brief UDP/ICMP context slot (one per datagram flow)
+ */
+typedef struct {
+    uint8_t hdr[SLIP_VJ_CTX_HDR];   /**< Last IP (+UDP) header seen on this flow */
+    bool    valid;
+} slip_vj_ctx_slot_t;
+
+/**
+ * @brief Compressor and decompressor state for one SLIP link
+ */
+typedef struct {
+    slip_vj_tcp_slot_t tx_tcp[TINYPAN_SLIP_VJ_SLOTS];
+    slip_vj_tcp_slot_t rx_tcp[TINYPAN_SLIP_VJ_SLOTS];
+    slip_vj_ctx_slot_t tx_ctx[TINYPAN_SLIP_VJ_CTX_SLOTS];
+    slip_vj_ctx_slot_t rx_ctx[TINYPAN_SLIP_VJ_CTX_SLOTS];
+    uint16_t tx_clock;              /**< LRU clock for TCP slot replacement */
+    uint8_t  tx_last;               /**< Slot id of the last TCP frame sent */
+    uint8_t  rx_last;               /**< Slot id of the last TCP frame received */
+    uint8_t  tx_ctx_next;           /**< Round-robin victim for context slots */
+    bool     rx_toss;               /**< Drop COMPRESSED_TCP until a slot refresh */
+
+    /* Statistics */
+    uint32_t tx_compressed;         /**< Frames sent with an elided header */
+    uint32_t tx_bytes_saved;        /**< Header bytes removed from the wire */
+    uint32_t rx_compressed;         /**< Compressed frames expanded */
+    uint32_t rx_errors;             /**< Frames dropped by the decompressor */
+} slip_vj_state_t;
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+/**
+ * @brief Reset all slots (both directions) and statistics
+ */
+void slip_vj_init(slip_vj_state_t* vj);
+
+/**
+ * @brief Invalidate the TX slots so every flow is refreshed on its next frame
+ *
+ * Must be called whenever a frame that already went through
+ * slip_vj_compress() is dropped before reaching the wire.
+ */
+void slip_vj_tx_reset(slip_vj_state_t* vj);
+
+/**
+ * @brief Compress the headers of an outgoing IPv4 packet
+ *
+ * @param vj        Link state
+ * @param pkt       Contiguous copy of the start of the packet
+ * @param avail     Valid bytes in pkt (at least min(pkt_len, SLIP_VJ_MAX_HDR))
+ * @param pkt_len   Total length of the packet
+ * @param out       [out] Replacement header (SLIP_VJ_MAX_OUT bytes)
+ * @param skip      [out] Number of leading packet bytes replaced by out
+ * @return Length written to out, or 0 to send the packet unmodified
+ */
+uint8_t slip_vj_compress(slip_vj_state_t* vj, const uint8_t* pkt, uint16_t avail,
+                         uint16_t pkt_len, uint8_t* out, uint16_t* skip);
+
+/**
+ * @brief Check whether a frame type belongs to the compression framing
+ *
+ * Frames of any other type (plain IPv4, IPv6, ...) carry the packet as-is
+ * and must bypass slip_vj_uncompress().
+ *
+ * @param type      First byte of a decoded SLIP frame
+ * @return true for UNCOMPRESSED_TCP, COMPRESSED_TCP and the context types
+ */
+bool slip_vj_owns_type(uint8_t type);
+
+/**
+ * @brief Expand the header of an incoming SLIP frame
+ *
+ * The reconstructed packet is hdr_out[0..hdr_len) followed by
+ * frame[consumed..len).
+ *
+ * @param vj        Link state
+ * @param frame     Decoded SLIP frame
+ * @param len       Frame length
+ * @param hdr_out   [out] Reconstructed header (SLIP_VJ_MAX_HDR bytes)
+ * @param hdr_len   [out] Bytes written to hdr_out
+ * @return Number of frame bytes consumed, or negative if the frame must be dropped
+ */
+int slip_vj_uncompress(slip_vj_state_t* vj, const uint8_t* frame, uint16_t len,
+                       uint8_t* hdr_out, uint16_t* hdr_len);
+
+/**
+ * @brief Report a corrupted or truncated frame to the decompressor
+ *
+ * Subsequent COMPRESSED_TCP frames are discarded until the sender refreshes
+ * the slot (RFC 1144 section 4.2).
+ */
+void slip_vj_rx_error(slip_vj_state_t* vj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_SLIP_VJ_H */
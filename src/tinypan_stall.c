@@ -0,0 +1,98 @@
+/*
+ * TinyPAN TX Stall Recovery
+ *
+ * Recovery is graduated. A frame that missed its TX_COMPLETE is cancelled
+ * in the HAL and the frames queued behind it go out on the same link, which
+ * costs one timeout instead of seconds of L2CAP, BNEP and DHCP bring-up.
+ * Each stall is a strike and a completed frame forgives them all; once
+ * TINYPAN_STALL_MAX_RECOVERIES strikes have been recovered in a row, or if
+ * the HAL cannot cancel, the next stall tears the link down.
+ */
+
+#include "tinypan_stall.h"
+
+#if TINYPAN_ENABLE_STALL_RECOVERY
+
+#include "tinypan_supervisor.h"
+#include "tinypan_internal.h"
+#include "../include/tinypan_hal.h"
+#include <string.h>
+
+static uint8_t s_strikes = 0;           /* Stalls since the last completion */
+static bool s_stalled = false;          /* Recovered stall, queue not moving yet */
+static uint32_t s_stalled_at_ms = 0;
+
+static tinypan_stall_stats_t s_stats;
+
+/**
+ * @brief The queue moves again
+ */
+static void stall_end(void) {
+    if (!s_stalled) {
+        return;
+    }
+    s_stalled = false;
+
+    uint32_t ms = hal_get_tick_ms() - s_stalled_at_ms;
+    s_stats.last_recovery_ms = ms;
+    if (ms > s_stats.max_recovery_ms) {
+        s_stats.max_recovery_ms = ms;
+    }
+    TINYPAN_LOG_INFO("TX stall recovered after %u ms", (unsigned)ms);
+    supervisor_on_tx_recovered();
+}
+
+void tinypan_stall_reset(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+    tinypan_stall_link_up();
+}
+
+void tinypan_stall_link_up(void) {
+    s_strikes = 0;
+    s_stalled = false;
+}
+
+bool tinypan_stall_detected(void) {
+    s_stats.stalls++;
+
+    if (s_strikes >= TINYPAN_STALL_MAX_RECOVERIES) {
+        TINYPAN_LOG_ERROR("TX stalled %u times in a row, dropping the link",
+                          (unsigned)(s_strikes + 1));
+    } else if (hal_bt_l2cap_cancel_tx() < 0) {
+        TINYPAN_LOG_ERROR("TX stalled and the HAL cannot cancel, dropping the link");
+    } else {
+        s_strikes++;
+        s_stats.recovered++;
+        if (!s_stalled) {
+            s_stalled = true;
+            s_stalled_at_ms = hal_get_tick_ms();
+        }
+        TINYPAN_LOG_WARN("TX stalled, send cancelled (strike %u/%u)",
+                         (unsigned)s_strikes, (unsigned)TINYPAN_STALL_MAX_RECOVERIES);
+        supervisor_on_tx_stalled();
+        return true;
+    }
+
+    s_stats.disconnects++;
+    s_stalled = false;
+    return false;
+}
+
+void tinypan_stall_completed(void) {
+    s_strikes = 0;
+    stall_end();
+}
+
+void tinypan_stall_queue_empty(void) {
+    stall_end();
+}
+
+uint32_t tinypan_stall_count(void) {
+    return s_stats.stalls;
+}
+
+void tinypan_stall_get_stats(tinypan_stall_stats_t* stats) {
+    *stats = s_stats;
+}
+
+#endif /* TINYPAN_ENABLE_STALL_RECOVERY */
@@ -0,0 +1,68 @@
+/*
+ * TinyPAN TX Stall Recovery - Internal Header
+ *
+ * Decides what happens to a BNEP frame that missed its TX_COMPLETE
+ * (TINYPAN_ENABLE_STALL_RECOVERY): cancel it in the HAL and resume the
+ * queue, or tear the link down. The BNEP transport reports stalls and
+ * completions; the supervisor shows a stall on an online link as
+ * TINYPAN_STATE_STALLED and tinypan.c raises TINYPAN_EVENT_TX_STALLED.
+ */
+
+#ifndef TINYPAN_STALL_H
+#define TINYPAN_STALL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief End any stall and clear the statistics
+ */
+void tinypan_stall_reset(void);
+
+/**
+ * @brief A new link: no stall, no earlier strikes
+ */
+void tinypan_stall_link_up(void);
+
+/**
+ * @brief The frame in flight missed its TX_COMPLETE
+ *
+ * Asks the HAL to cancel the send unless TINYPAN_STALL_MAX_RECOVERIES
+ * stalls have already come without a completion in between.
+ *
+ * @return true if the frame was cancelled and the queue may resume,
+ *         false if the link must be torn down
+ */
+bool tinypan_stall_detected(void);
+
+/**
+ * @brief A frame completed: the link moves, the strikes are forgiven
+ */
+void tinypan_stall_completed(void);
+
+/**
+ * @brief The TX queue is empty: nothing is left waiting on the stall
+ */
+void tinypan_stall_queue_empty(void);
+
+/**
+ * @brief Stalls since tinypan_init(), recovered or not
+ */
+uint32_t tinypan_stall_count(void);
+
+/**
+ * @brief Counters and recovery times
+ */
+void tinypan_stall_get_stats(tinypan_stall_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_STALL_H */
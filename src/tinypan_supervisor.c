@@ -3,6 +3,20 @@
  * 
  * Manages the high-level connection state machine:
  * IDLE -> CONNECTING -> BNEP_SETUP -> BNEP_FILTER_WAIT -> DHCP -> ONLINE
+ *
+ * With TINYPAN_ENABLE_FAST_BRINGUP, BNEP_SETUP goes straight to DHCP and the
+ * filter response is handled whenever it arrives.
+ *
+ * With TINYPAN_ENABLE_STALL_RECOVERY, ONLINE -> STALLED -> ONLINE while the
+ * BNEP transport recovers a stalled TX queue without a reconnect; the link
+ * counts as online throughout. With TINYPAN_ENABLE_HEARTBEAT, an idle
+ * ONLINE link is probed and goes to RECONNECTING once it is declared dead.
+ * The heartbeat only runs in ONLINE: in STALLED a probe could not be sent
+ * and the stall has its own deadline. It pauses there and, back in ONLINE,
+ * resumes with the idle time and misses it had.
+ *
+ * With TINYPAN_ENABLE_RECONNECT_POLICY, every path into RECONNECTING
+ * names the class of the failure and the delay follows that class's curve.
  */
 
 #include "tinypan_supervisor.h"
@@ -17,6 +31,18 @@
 #include "tinypan_lwip_netif.h"
 #endif
 
+#if TINYPAN_ENABLE_HEARTBEAT
+#include "tinypan_heartbeat.h"
+#endif
+
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+#include "tinypan_reconnect.h"
+#endif
+
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+#include "tinypan_tx_rto.h"
+#endif
+
 /* ============================================================================
  * State
  * ============================================================================ */
@@ -33,6 +59,9 @@ static uint8_t s_reconnect_attempts = 0;
 static uint8_t s_setup_retries = 0;
 static uint8_t s_dhcp_retries = 0;
 
+/** Multicast filter sent, response not yet seen (fast bring-up) */
+static bool s_filter_pending = false;
+
 /* ============================================================================
  * Helper Functions
  * ============================================================================ */
@@ -45,11 +74,37 @@ static void set_state(tinypan_state_t new_state) {
         TINYPAN_LOG_INFO("Supervisor: %s -> %s",
                           tinypan_state_to_string(s_state),
                           tinypan_state_to_string(new_state));
+#if TINYPAN_ENABLE_HEARTBEAT
+        /* Back from STALLED the idle time and misses carry on */
+        if (new_state == TINYPAN_STATE_ONLINE && s_state != TINYPAN_STATE_STALLED) {
+            tinypan_heartbeat_start();
+        }
+#endif
         s_state = new_state;
         s_state_enter_time = hal_get_tick_ms();
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+        if (new_state == TINYPAN_STATE_ONLINE) {
+            tinypan_reconnect_online();
+        } else if (new_state == TINYPAN_STATE_IDLE || new_state == TINYPAN_STATE_ERROR) {
+            tinypan_reconnect_stopped();
+        }
+#endif
     }
 }
 
+/**
+ * @brief How long the TX queue may stay STALLED without sending
+ *
+ * Twice the TX timeout leaves a frame sent on entry room to expire.
+ */
+static uint32_t stalled_timeout_ms(void) {
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+    return 2 * tinypan_tx_rto_ms();
+#else
+    return 2 * TINYPAN_BNEP_TX_TIMEOUT_MS;
+#endif
+}
+
 /**
  * @brief Check if timeout has elapsed since state entry
  */
@@ -73,8 +128,15 @@ static int start_l2cap_connect(void) {
 
 /**
  * @brief Schedule reconnection with exponential backoff
+ * 
+ * @param reason Class of the failure (TINYPAN_ENABLE_RECONNECT_POLICY)
  */
-static void schedule_reconnect(void) {
+static void schedule_reconnect(tinypan_reconnect_reason_t reason) {
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+    s_reconnect_delay_ms = tinypan_reconnect_next_delay(reason, s_config.reconnect_interval_ms,
+                                                        s_config.reconnect_max_ms);
+#else
+    (void)reason;
     if (s_reconnect_delay_ms == 0) {
         s_reconnect_delay_ms = s_config.reconnect_interval_ms;
     } else {
@@ -83,6 +145,7 @@ static void schedule_reconnect(void) {
             s_reconnect_delay_ms = s_config.reconnect_max_ms;
         }
     }
+#endif
     
     TINYPAN_LOG_INFO("Reconnect scheduled in %lu ms (next attempt %u)",
                       (unsigned long)s_reconnect_delay_ms,
@@ -91,6 +154,37 @@ static void schedule_reconnect(void) {
     s_last_action_time = hal_get_tick_ms();
 }
 
+#if TINYPAN_ENABLE_AUTO_RECONNECT
+/**
+ * @brief Class of a failure reported by the HAL
+ */
+static tinypan_reconnect_reason_t classify_failure(int status, tinypan_reconnect_reason_t fallback) {
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+    return tinypan_reconnect_classify(status, fallback);
+#else
+    (void)status;
+    return fallback;
+#endif
+}
+#endif
+
+/**
+ * @brief Enter the DHCP state: raise the link and start the DHCP client
+ */
+static void start_dhcp_phase(void) {
+    set_state(TINYPAN_STATE_DHCP);
+    s_dhcp_retries = 0; /* Reset retry counter on first entry */
+#if TINYPAN_ENABLE_LWIP
+    tinypan_netif_set_link(true);
+    if (tinypan_netif_start_dhcp() < 0) {
+        TINYPAN_LOG_ERROR("Failed to start DHCP");
+        hal_bt_l2cap_disconnect();
+        set_state(TINYPAN_STATE_RECONNECTING);
+        schedule_reconnect(TINYPAN_RECONNECT_DHCP);
+    }
+#endif
+}
+
 /* ============================================================================
  * Supervisor API Implementation
  * ============================================================================ */
@@ -109,6 +203,7 @@ void supervisor_init(const tinypan_config_t* config) {
     s_reconnect_attempts = 0;
     s_setup_retries = 0;
     s_dhcp_retries = 0;
+    s_filter_pending = false;
     s_initialized = true;
     
     TINYPAN_LOG_INFO("Supervisor initialized");
@@ -130,6 +225,7 @@ int supervisor_start(void) {
     s_reconnect_attempts = 0;
     s_setup_retries = 0;
     s_dhcp_retries = 0;
+    s_filter_pending = false;
     
     /* Begin connecting */
     set_state(TINYPAN_STATE_CONNECTING);
@@ -181,7 +277,7 @@ void supervisor_process(void) {
                 
 #if TINYPAN_ENABLE_AUTO_RECONNECT
                 set_state(TINYPAN_STATE_RECONNECTING);
-                schedule_reconnect();
+                schedule_reconnect(TINYPAN_RECONNECT_UNREACHABLE);
 #else
                 set_state(TINYPAN_STATE_ERROR);
 #endif
@@ -209,7 +305,7 @@ void supervisor_process(void) {
                     
 #if TINYPAN_ENABLE_AUTO_RECONNECT
                     set_state(TINYPAN_STATE_RECONNECTING);
-                    schedule_reconnect();
+                    schedule_reconnect(TINYPAN_RECONNECT_REJECTED);
 #else
                     set_state(TINYPAN_STATE_ERROR);
 #endif
@@ -223,16 +319,8 @@ void supervisor_process(void) {
              * proceed to DHCP anyway (filter is optional). */
             if (timeout_elapsed(TINYPAN_BNEP_FILTER_TIMEOUT_MS)) {
                 TINYPAN_LOG_WARN("Filter ACK timeout, proceeding to DHCP without filter");
-                set_state(TINYPAN_STATE_DHCP);
-#if TINYPAN_ENABLE_LWIP
-                tinypan_netif_set_link(true);
-                if (tinypan_netif_start_dhcp() < 0) {
-                    TINYPAN_LOG_ERROR("Failed to start DHCP");
-                    hal_bt_l2cap_disconnect();
-                    set_state(TINYPAN_STATE_RECONNECTING);
-                    schedule_reconnect();
-                }
-#endif
+                s_filter_pending = false;
+                start_dhcp_phase();
             }
             break;
             
@@ -256,18 +344,40 @@ void supervisor_process(void) {
                     hal_bt_l2cap_disconnect();
                     s_dhcp_retries = 0;
                     set_state(TINYPAN_STATE_RECONNECTING);
-                    schedule_reconnect();
+                    schedule_reconnect(TINYPAN_RECONNECT_DHCP);
                 }
             }
             break;
             
         case TINYPAN_STATE_ONLINE:
-            /* Not implemented: heartbeat/keepalive monitoring.
-               TINYPAN_STATE_STALLED is reserved for future use. */
+#if TINYPAN_ENABLE_HEARTBEAT
+            /* A silently dead link would otherwise only show when a DHCP
+             * renewal or a TX timeout fails, possibly minutes later. */
+            if (tinypan_heartbeat_process()) {
+                hal_bt_l2cap_disconnect();
+#if TINYPAN_ENABLE_AUTO_RECONNECT
+                set_state(TINYPAN_STATE_RECONNECTING);
+                schedule_reconnect(TINYPAN_RECONNECT_TRANSIENT);
+#else
+                set_state(TINYPAN_STATE_ERROR);
+#endif
+            }
+#endif
             break;
             
         case TINYPAN_STATE_STALLED:
-            /* Not implemented: link recovery logic */
+            /* The transport times every frame it sends, so only a queue that
+             * stopped sending altogether (e.g. no L2CAP credits) lands here. */
+            if (timeout_elapsed(stalled_timeout_ms())) {
+                TINYPAN_LOG_ERROR("TX queue still stalled, forcing L2CAP disconnect");
+                hal_bt_l2cap_disconnect();
+#if TINYPAN_ENABLE_AUTO_RECONNECT
+                set_state(TINYPAN_STATE_RECONNECTING);
+                schedule_reconnect(TINYPAN_RECONNECT_TRANSIENT);
+#else
+                set_state(TINYPAN_STATE_ERROR);
+#endif
+            }
             break;
             
         case TINYPAN_STATE_RECONNECTING:
@@ -294,7 +404,7 @@ void supervisor_process(void) {
                         if (result < 0) {
                             TINYPAN_LOG_ERROR("Reconnect failed: %d", result);
                             set_state(TINYPAN_STATE_RECONNECTING);
-                            schedule_reconnect();
+                            schedule_reconnect(TINYPAN_RECONNECT_UNREACHABLE);
                         }
                     }
                 }
@@ -317,7 +427,8 @@ tinypan_state_t supervisor_get_state(void) {
 }
 
 bool supervisor_is_online(void) {
-    return s_state == TINYPAN_STATE_ONLINE;
+    /* STALLED keeps the link and the address; the queue is being recovered */
+    return s_state == TINYPAN_STATE_ONLINE || s_state == TINYPAN_STATE_STALLED;
 }
 
 void supervisor_on_l2cap_event(int event, int status) {
@@ -333,6 +444,7 @@ void supervisor_on_l2cap_event(int event, int status) {
                 if (transport && transport->requires_setup) {
                     set_state(TINYPAN_STATE_BNEP_SETUP);
                     s_setup_retries = 0;
+                    s_filter_pending = false;
                 } else {
                     /* SLIP (Raw IP) does not support DHCP. 
                      * Transition directly to ONLINE to prevent timeout suicide loops. */
@@ -345,7 +457,8 @@ void supervisor_on_l2cap_event(int event, int status) {
                     tinypan_internal_set_ip(
                         TINYPAN_SLIP_IP_ADDR, 
                         TINYPAN_SLIP_NETMASK, 
-                        TINYPAN_SLIP_GATEWAY
+                        TINYPAN_SLIP_GATEWAY,
+                        0
                     );
 #endif
 #endif
@@ -382,12 +495,17 @@ void supervisor_on_l2cap_event(int event, int status) {
 #endif
             
             if (s_state == TINYPAN_STATE_ONLINE || 
+                s_state == TINYPAN_STATE_STALLED ||
                 s_state == TINYPAN_STATE_DHCP ||
                 s_state == TINYPAN_STATE_BNEP_SETUP ||
                 s_state == TINYPAN_STATE_BNEP_FILTER_WAIT) {
 #if TINYPAN_ENABLE_AUTO_RECONNECT
+                /* Closed during the handshake: the NAP turned us away */
+                bool in_setup = (s_state == TINYPAN_STATE_BNEP_SETUP ||
+                                 s_state == TINYPAN_STATE_BNEP_FILTER_WAIT);
                 set_state(TINYPAN_STATE_RECONNECTING);
-                schedule_reconnect();
+                schedule_reconnect(classify_failure(status, in_setup ? TINYPAN_RECONNECT_REJECTED
+                                                                     : TINYPAN_RECONNECT_TRANSIENT));
 #else
                 set_state(TINYPAN_STATE_IDLE);
 #endif
@@ -395,7 +513,7 @@ void supervisor_on_l2cap_event(int event, int status) {
                 /* Connect failed */
 #if TINYPAN_ENABLE_AUTO_RECONNECT
                 set_state(TINYPAN_STATE_RECONNECTING);
-                schedule_reconnect();
+                schedule_reconnect(classify_failure(status, TINYPAN_RECONNECT_UNREACHABLE));
 #else
                 set_state(TINYPAN_STATE_ERROR);
 #endif
@@ -407,7 +525,7 @@ void supervisor_on_l2cap_event(int event, int status) {
             
 #if TINYPAN_ENABLE_AUTO_RECONNECT
             set_state(TINYPAN_STATE_RECONNECTING);
-            schedule_reconnect();
+            schedule_reconnect(classify_failure(status, TINYPAN_RECONNECT_UNREACHABLE));
 #else
             set_state(TINYPAN_STATE_ERROR);
 #endif
@@ -450,11 +568,17 @@ void supervisor_on_bnep_connected(void) {
     /* Reset reconnect state on successful connection */
     s_reconnect_delay_ms = 0;
     s_reconnect_attempts = 0;
+#if TINYPAN_ENABLE_RECONNECT_POLICY
+    tinypan_reconnect_connected();
+#endif
 }
 
 void supervisor_on_bnep_setup_response(uint16_t response_code) {
     if (response_code == BNEP_SETUP_RESPONSE_SUCCESS) {
         TINYPAN_LOG_INFO("BNEP setup successful");
+        /* Before the DHCP phase starts: a failure there schedules a
+         * reconnect, whose delay must not be reset afterwards. */
+        supervisor_on_bnep_connected();
         
         /* Multicast Filtering: Define standard multicast MAC ranges 
          * for the BNEP filter request. */
@@ -484,23 +608,26 @@ void supervisor_on_bnep_setup_response(uint16_t response_code) {
 #endif
 
         if (bnep_set_multicast_filters((const uint8_t (*)[12])filter_ranges, num_ranges) == 0) {
+#if TINYPAN_ENABLE_FAST_BRINGUP
+            /* Don't wait for the filter response: many phones never send one,
+             * and DHCP traffic passes the filter either way. */
+            s_filter_pending = true;
+            start_dhcp_phase();
+#else
             set_state(TINYPAN_STATE_BNEP_FILTER_WAIT);
+#endif
         } else {
             /* Fallback: proceed to DHCP if filter set fails */
             TINYPAN_LOG_WARN("Failed to set multicast filters, proceeding to DHCP");
-            set_state(TINYPAN_STATE_DHCP);
-            tinypan_netif_set_link(true);
-            tinypan_netif_start_dhcp();
+            start_dhcp_phase();
         }
-        
-        supervisor_on_bnep_connected();
     } else {
         TINYPAN_LOG_ERROR("BNEP setup rejected: 0x%04X", response_code);
         hal_bt_l2cap_disconnect();
         
 #if TINYPAN_ENABLE_AUTO_RECONNECT
         set_state(TINYPAN_STATE_RECONNECTING);
-        schedule_reconnect();
+        schedule_reconnect(TINYPAN_RECONNECT_REJECTED);
 #else
         set_state(TINYPAN_STATE_ERROR);
 #endif
@@ -513,6 +640,18 @@ void supervisor_on_ip_acquired(void) {
 }
 
 void supervisor_on_bnep_filter_response(uint16_t response_code) {
+    if (s_filter_pending &&
+        (s_state == TINYPAN_STATE_DHCP || s_state == TINYPAN_STATE_ONLINE)) {
+        /* Fast bring-up: DHCP is already running, just record the verdict */
+        s_filter_pending = false;
+        if (response_code == BNEP_FILTER_RESPONSE_SUCCESS) {
+            TINYPAN_LOG_INFO("NAP accepted multicast filter");
+        } else {
+            TINYPAN_LOG_WARN("NAP rejected multicast filter (0x%04X)", response_code);
+        }
+        return;
+    }
+
     if (s_state != TINYPAN_STATE_BNEP_FILTER_WAIT) {
         TINYPAN_LOG_DEBUG("Filter response in state %s, ignoring",
                           tinypan_state_to_string(s_state));
@@ -526,22 +665,13 @@ void supervisor_on_bnep_filter_response(uint16_t response_code) {
                          response_code);
     }
 
-    set_state(TINYPAN_STATE_DHCP);
-    s_dhcp_retries = 0; /* Reset retry counter on first entry */
-#if TINYPAN_ENABLE_LWIP
-    tinypan_netif_set_link(true);
-    if (tinypan_netif_start_dhcp() < 0) {
-        TINYPAN_LOG_ERROR("Failed to start DHCP");
-        hal_bt_l2cap_disconnect();
-        set_state(TINYPAN_STATE_RECONNECTING);
-        schedule_reconnect();
-    }
-#endif
+    s_filter_pending = false;
+    start_dhcp_phase();
 }
 
 void supervisor_on_ip_lost(void) {
     TINYPAN_LOG_WARN("IP lost");
-    if (s_state == TINYPAN_STATE_ONLINE) {
+    if (s_state == TINYPAN_STATE_ONLINE || s_state == TINYPAN_STATE_STALLED) {
         set_state(TINYPAN_STATE_DHCP);
 #if TINYPAN_ENABLE_LWIP
         if (tinypan_netif_start_dhcp() < 0) {
@@ -553,7 +683,27 @@ void supervisor_on_ip_lost(void) {
     }
 }
 
+void supervisor_on_tx_stalled(void) {
+    if (s_state == TINYPAN_STATE_ONLINE) {
+        set_state(TINYPAN_STATE_STALLED);
+    } else if (s_state == TINYPAN_STATE_STALLED) {
+        /* Another frame went out and stalled: the queue is not stuck */
+        s_state_enter_time = hal_get_tick_ms();
+    }
+}
+
+void supervisor_on_tx_recovered(void) {
+    if (s_state == TINYPAN_STATE_STALLED) {
+        set_state(TINYPAN_STATE_ONLINE);
+    }
+}
+
 uint32_t supervisor_get_next_timeout_ms(void) {
+#if TINYPAN_ENABLE_HEARTBEAT
+    if (s_state == TINYPAN_STATE_ONLINE) {
+        return tinypan_heartbeat_next_ms();
+    }
+#endif
     if (s_state == TINYPAN_STATE_IDLE || s_state == TINYPAN_STATE_ONLINE || s_state == TINYPAN_STATE_ERROR) {
         return 0xFFFFFFFF;
     }
@@ -575,6 +725,9 @@ uint32_t supervisor_get_next_timeout_ms(void) {
         case TINYPAN_STATE_DHCP:
             target_timeout = TINYPAN_DHCP_TIMEOUT_MS;
             break;
+        case TINYPAN_STATE_STALLED:
+            target_timeout = stalled_timeout_ms();
+            break;
         case TINYPAN_STATE_RECONNECTING:
             target_timeout = s_reconnect_delay_ms;
             base_time = s_last_action_time;
@@ -51,7 +51,7 @@ void supervisor_process(void);
 tinypan_state_t supervisor_get_state(void);
 
 /**
- * @brief Check if online
+ * @brief Check if online (ONLINE, or STALLED while the TX queue recovers)
  */
 bool supervisor_is_online(void);
 
@@ -97,6 +97,16 @@ void supervisor_on_ip_lost(void);
  */
 void supervisor_on_l2cap_event(int event, int status);
 
+/**
+ * @brief Called when a stalled TX frame was cancelled and the queue resumed
+ */
+void supervisor_on_tx_stalled(void);
+
+/**
+ * @brief Called when the TX queue moves again after a stall
+ */
+void supervisor_on_tx_recovered(void);
+
 #ifdef __cplusplus
 }
 #endif
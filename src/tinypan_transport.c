@@ -1,9 +1,12 @@
 /*
- * TinyPAN Transport Factory
+ * TinyPAN Transport Factory and TX Queue Accounting
  */
 
 #include "tinypan_transport.h"
 #include "../include/tinypan_config.h"
+#include "tinypan_link_est.h"
+
+#include <stddef.h>
 
 extern const tinypan_transport_t transport_bnep;
 extern const tinypan_transport_t transport_slip;
@@ -15,3 +18,98 @@ const tinypan_transport_t* tinypan_transport_get(void) {
     return &transport_bnep;
 #endif
 }
+
+/* ============================================================================
+ * TX Queue Accounting
+ * ============================================================================ */
+
+#if TINYPAN_TX_LOW_WATER_FRAMES >= TINYPAN_TX_HIGH_WATER_FRAMES
+#error "TINYPAN_TX_LOW_WATER_FRAMES must be below TINYPAN_TX_HIGH_WATER_FRAMES"
+#endif
+
+#if TINYPAN_TX_HIGH_WATER_BYTES > 0 && TINYPAN_TX_LOW_WATER_BYTES >= TINYPAN_TX_HIGH_WATER_BYTES
+#error "TINYPAN_TX_LOW_WATER_BYTES must be below TINYPAN_TX_HIGH_WATER_BYTES"
+#endif
+
+#define TX_NOTIFY_NONE      0
+#define TX_NOTIFY_FULL      1
+#define TX_NOTIFY_WRITABLE  2
+
+static volatile uint16_t s_tx_frames = 0;
+static volatile uint32_t s_tx_bytes = 0;
+static bool s_tx_congested = false;
+static volatile uint8_t s_tx_notify = TX_NOTIFY_NONE;
+static tinypan_tx_watermark_callback_t s_tx_callback = NULL;
+static void* s_tx_callback_user_data = NULL;
+
+static void tx_congest(void) {
+    if (!s_tx_congested) {
+        s_tx_congested = true;
+        s_tx_notify = TX_NOTIFY_FULL;
+    }
+}
+
+void tinypan_transport_tx_enqueued(uint16_t len) {
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    if (s_tx_frames == 0) {
+        tinypan_link_est_set_busy(true);
+    }
+#endif
+    s_tx_frames++;
+    s_tx_bytes += len;
+    if (s_tx_frames >= TINYPAN_TX_HIGH_WATER_FRAMES
+#if TINYPAN_TX_HIGH_WATER_BYTES > 0
+        || s_tx_bytes >= TINYPAN_TX_HIGH_WATER_BYTES
+#endif
+       ) {
+        tx_congest();
+    }
+}
+
+void tinypan_transport_tx_released(uint16_t len) {
+    if (s_tx_frames > 0) {
+        s_tx_frames--;
+    }
+    s_tx_bytes = (s_tx_bytes > len) ? s_tx_bytes - len : 0;
+#if TINYPAN_ENABLE_LINK_ESTIMATE
+    if (s_tx_frames == 0) {
+        tinypan_link_est_set_busy(false);
+    }
+#endif
+
+    /* Hysteresis: stay congested until the queue drops to the low watermark */
+    if (s_tx_congested && s_tx_frames <= TINYPAN_TX_LOW_WATER_FRAMES
+#if TINYPAN_TX_HIGH_WATER_BYTES > 0
+        && s_tx_bytes <= TINYPAN_TX_LOW_WATER_BYTES
+#endif
+       ) {
+        s_tx_congested = false;
+        s_tx_notify = TX_NOTIFY_WRITABLE;
+    }
+}
+
+void tinypan_transport_tx_refused(void) {
+    tx_congest();
+}
+
+void tinypan_transport_tx_notify(void) {
+    uint8_t notify = s_tx_notify;
+    if (notify == TX_NOTIFY_NONE) {
+        return;
+    }
+    /* Clear first: the callback may send and cross a watermark again */
+    s_tx_notify = TX_NOTIFY_NONE;
+    if (s_tx_callback != NULL) {
+        s_tx_callback(notify == TX_NOTIFY_WRITABLE, s_tx_callback_user_data);
+    }
+}
+
+uint16_t tinypan_transport_tx_queued(void) {
+    return s_tx_frames;
+}
+
+void tinypan_transport_tx_set_callback(tinypan_tx_watermark_callback_t callback, void* user_data) {
+    s_tx_callback = callback;
+    s_tx_callback_user_data = user_data;
+    s_tx_notify = TX_NOTIFY_NONE;
+}
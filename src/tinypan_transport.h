@@ -12,6 +12,8 @@
 
 #include "../include/tinypan_config.h"
 
+#include "../include/tinypan.h"
+
 #if TINYPAN_ENABLE_LWIP
 struct pbuf;
 struct netif;
@@ -21,6 +23,13 @@ struct netif;
 extern "C" {
 #endif
 
+/**
+ * Leading L3 bytes the transports copy out of a frame for the TX
+ * classifiers (flow queueing, TX bursts): IPv4 options plus the TCP header
+ * up to its data offset.
+ */
+#define TINYPAN_TX_PEEK_LEN     80
+
 /**
  * @brief Transport interface definition
  */
@@ -53,6 +62,17 @@ typedef struct {
      * @param len Length of the data
      */
     void (*handle_incoming)(const uint8_t* data, uint16_t len);
+
+    /**
+     * @brief Handle raw incoming data in the HAL's RX context (optional)
+     *
+     * Must be safe to call concurrently with tinypan_process(). Only data
+     * frames may be consumed; everything else is left to handle_incoming.
+     * @param data Raw data buffer
+     * @param len Length of the data
+     * @return true if consumed, false to take the handle_incoming path
+     */
+    bool (*handle_incoming_direct)(const uint8_t* data, uint16_t len);
     
     /**
      * @brief Called during setup timeouts to retry the connection handshake
@@ -84,6 +104,47 @@ typedef struct {
      */
     int (*output)(struct netif* netif, struct pbuf* p);
 #endif
+
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_RAW_FRAMES
+    /**
+     * @brief Queue a raw Ethernet frame behind lwIP's (optional)
+     * @param dst_addr  Destination MAC, NULL for the NAP
+     * @param ethertype Ethertype of the payload
+     * @param payload   Referenced until done runs
+     * @param len       Payload length
+     * @param done      Release callback, may be NULL
+     * @param user_data Passed to done
+     * @return TINYPAN_OK or a tinypan_error_t
+     */
+    int (*send_frame)(const uint8_t* dst_addr, uint16_t ethertype, const void* payload,
+                      uint16_t len, tinypan_tx_done_callback_t done, void* user_data);
+#endif
+
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_FQ
+    /**
+     * @brief Frames any one flow may still queue before its share is full
+     */
+    uint16_t (*tx_flow_room)(void);
+#endif
+
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_LINK_ESTIMATE
+    /**
+     * @brief Copy out the link estimate under the TX lock
+     */
+    void (*link_estimate)(tinypan_link_estimate_t* estimate);
+#endif
+
+#if TINYPAN_ENABLE_LWIP && TINYPAN_ENABLE_HEARTBEAT
+    /**
+     * @brief Send a heartbeat probe the peer echoes back (optional)
+     *
+     * The answer is reported to tinypan_heartbeat_reply() with the same
+     * tag. Transports without this op are probed over ARP.
+     * @param tag Identifies the probe in the answer
+     * @return 0 if sent, negative if the peer cannot answer
+     */
+    int (*send_probe)(uint8_t tag);
+#endif
 } tinypan_transport_t;
 
 /**
@@ -95,6 +156,30 @@ const tinypan_transport_t* tinypan_transport_get(void);
 extern const tinypan_transport_t transport_bnep;
 extern const tinypan_transport_t transport_slip;
 
+/*
+ * TX queue occupancy, shared by the transports for tinypan_tx_available()
+ * and the watermark callback. The accounting calls may run with the
+ * transport's TX lock held; tinypan_transport_tx_notify() must not.
+ */
+
+/** A frame of len bytes entered the TX queue */
+void tinypan_transport_tx_enqueued(uint16_t len);
+
+/** A frame of len bytes left the TX queue (sent, dropped or flushed) */
+void tinypan_transport_tx_released(uint16_t len);
+
+/** The TX queue, or the frame's flow share of it, was full and refused a frame */
+void tinypan_transport_tx_refused(void);
+
+/** Run the watermark callback if the queue crossed a watermark since the last call */
+void tinypan_transport_tx_notify(void);
+
+/** Frames currently in the TX queue */
+uint16_t tinypan_transport_tx_queued(void);
+
+/** Set the watermark callback (NULL to remove) and forget pending notifications */
+void tinypan_transport_tx_set_callback(tinypan_tx_watermark_callback_t callback, void* user_data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,125 @@
+/*
+ * TinyPAN Adaptive TX Timeout
+ *
+ * Jacobson/Karels estimator (RFC 6298) over send -> TX_COMPLETE times, in
+ * fixed point: the smoothed mean is kept x8 and the mean deviation x4, so
+ * the gains of 1/8 and 1/4 are shifts. Unlike TCP nothing is retransmitted,
+ * so every completion is a valid sample.
+ *
+ * The timeout is mean + max(4 x deviation, mean), clamped to
+ * [TINYPAN_TX_TIMEOUT_MIN_MS, TINYPAN_BNEP_TX_TIMEOUT_MS]. The second term
+ * keeps at least twice the mean on a steady link, where the deviation
+ * decays to nothing, so a slowdown needs to more than double the service
+ * time before a healthy frame is mistaken for a stalled one.
+ *
+ * An expiry doubles the timeout, up to the ceiling, and the backed-off
+ * value holds until a frame completes (RFC 6298 section 5.5). A frame that
+ * expired gives no sample, so a link that slowed down suddenly gets a
+ * longer timeout for its next frame instead of the same one again.
+ */
+
+#include "tinypan_tx_rto.h"
+
+#if TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT
+
+#include "../include/tinypan_hal.h"
+#include <string.h>
+
+#if TINYPAN_TX_TIMEOUT_MIN_MS < 1 || TINYPAN_TX_TIMEOUT_MIN_MS > TINYPAN_BNEP_TX_TIMEOUT_MS
+#error "TINYPAN_TX_TIMEOUT_MIN_MS must be between 1 and TINYPAN_BNEP_TX_TIMEOUT_MS"
+#endif
+
+static uint32_t s_srtt8 = 0;        /* Smoothed service time, ms x 8 */
+static uint32_t s_rttvar4 = 0;      /* Mean deviation, ms x 4 */
+static uint32_t s_samples = 0;      /* Samples on this link */
+static uint32_t s_rto_ms = TINYPAN_BNEP_TX_TIMEOUT_MS;
+
+static volatile bool s_in_flight = false;
+static volatile uint32_t s_sent_ms = 0;
+
+static tinypan_tx_timeout_stats_t s_stats;
+
+static void rto_update(void) {
+    uint32_t srtt = s_srtt8 >> 3;
+    uint32_t var4 = s_rttvar4;
+    uint32_t rto = srtt + ((var4 > srtt) ? var4 : srtt);
+    if (rto < TINYPAN_TX_TIMEOUT_MIN_MS) {
+        rto = TINYPAN_TX_TIMEOUT_MIN_MS;
+    } else if (rto > TINYPAN_BNEP_TX_TIMEOUT_MS) {
+        rto = TINYPAN_BNEP_TX_TIMEOUT_MS;
+    }
+    s_rto_ms = rto;
+}
+
+void tinypan_tx_rto_reset(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+    tinypan_tx_rto_link_up();
+}
+
+void tinypan_tx_rto_link_up(void) {
+    s_srtt8 = 0;
+    s_rttvar4 = 0;
+    s_samples = 0;
+    s_rto_ms = TINYPAN_BNEP_TX_TIMEOUT_MS;
+    s_in_flight = false;
+}
+
+void tinypan_tx_rto_started(void) {
+    s_sent_ms = hal_get_tick_ms();
+    s_in_flight = true;
+}
+
+void tinypan_tx_rto_completed(void) {
+    if (!s_in_flight) {
+        return;
+    }
+    s_in_flight = false;
+
+    uint32_t r = hal_get_tick_ms() - s_sent_ms;
+    if (s_samples == 0) {
+        s_srtt8 = r << 3;
+        s_rttvar4 = r << 1;         /* Deviation r/2, x4 */
+    } else {
+        uint32_t srtt = s_srtt8 >> 3;
+        uint32_t err = (r > srtt) ? (r - srtt) : (srtt - r);
+        s_rttvar4 = s_rttvar4 - (s_rttvar4 >> 2) + err;
+        s_srtt8 = s_srtt8 - (s_srtt8 >> 3) + r;
+    }
+    s_samples++;
+    rto_update();
+
+    s_stats.samples++;
+    if (r > s_stats.max_service_ms) {
+        s_stats.max_service_ms = r;
+    }
+}
+
+void tinypan_tx_rto_expired(void) {
+    s_in_flight = false;
+    s_stats.timeouts++;
+
+    s_rto_ms = (s_rto_ms > TINYPAN_BNEP_TX_TIMEOUT_MS / 2) ? TINYPAN_BNEP_TX_TIMEOUT_MS
+                                                           : 2 * s_rto_ms;
+}
+
+uint32_t tinypan_tx_rto_ms(void) {
+    return s_rto_ms;
+}
+
+uint32_t tinypan_tx_rto_next_ms(void) {
+    if (!s_in_flight) {
+        return 0xFFFFFFFF;
+    }
+    /* The transport checks "elapsed > timeout", so the first tick past it */
+    uint32_t elapsed = hal_get_tick_ms() - s_sent_ms;
+    return (elapsed > s_rto_ms) ? 0 : (s_rto_ms - elapsed + 1);
+}
+
+void tinypan_tx_rto_get_stats(tinypan_tx_timeout_stats_t* stats) {
+    *stats = s_stats;
+    stats->timeout_ms = s_rto_ms;
+    stats->srtt_ms = s_srtt8 >> 3;
+    stats->rttvar_ms = s_rttvar4 >> 2;
+}
+
+#endif /* TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT */
@@ -0,0 +1,71 @@
+/*
+ * TinyPAN Adaptive TX Timeout - Internal Header
+ *
+ * Service-time estimator behind the BNEP TX completion timeout
+ * (TINYPAN_ENABLE_ADAPTIVE_TX_TIMEOUT). The BNEP transport reports each
+ * frame it hands to the HAL and each TX_COMPLETE, and asks for the timeout
+ * when it checks the frame in flight. tinypan.c wakes the application
+ * when that frame's deadline comes.
+ */
+
+#ifndef TINYPAN_TX_RTO_H
+#define TINYPAN_TX_RTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Forget the estimate and clear the statistics
+ */
+void tinypan_tx_rto_reset(void);
+
+/**
+ * @brief A new link: forget the estimate, keep the statistics
+ */
+void tinypan_tx_rto_link_up(void);
+
+/**
+ * @brief A frame was handed to the HAL
+ */
+void tinypan_tx_rto_started(void);
+
+/**
+ * @brief The frame in flight completed; its service time is a sample
+ */
+void tinypan_tx_rto_completed(void);
+
+/**
+ * @brief The frame in flight was declared stalled
+ *
+ * Doubles the timeout, up to TINYPAN_BNEP_TX_TIMEOUT_MS, until the next
+ * completion.
+ */
+void tinypan_tx_rto_expired(void);
+
+/**
+ * @brief Timeout for the frame in flight (ms)
+ */
+uint32_t tinypan_tx_rto_ms(void);
+
+/**
+ * @brief Milliseconds until the frame in flight times out
+ * @return 0 if overdue, 0xFFFFFFFF if nothing is in flight
+ */
+uint32_t tinypan_tx_rto_next_ms(void);
+
+/**
+ * @brief Current estimate and counters
+ */
+void tinypan_tx_rto_get_stats(tinypan_tx_timeout_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_TX_RTO_H */
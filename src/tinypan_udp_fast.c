@@ -0,0 +1,521 @@
+/*
+ * TinyPAN UDP Fast Path
+ *
+ * Each flow owns a static frame whose Ethernet, IP and UDP headers are
+ * built once (and again when the local address changes). A send copies the
+ * payload behind them while summing it, patches the IP total length, IP ID,
+ * UDP length and both checksums (from sums precomputed over the constant
+ * header words) and passes a PBUF_REF pbuf over the frame to the transport,
+ * the same call tinypan_netif_linkoutput() makes for lwIP. udp_sendto(),
+ * ip4_output_if() and etharp_output() are skipped entirely.
+ *
+ * The frame pbuf is reused once the transport has released it (ref back to
+ * one). Until then, and whenever the template cannot be used (payload over
+ * TINYPAN_UDP_MAX_PAYLOAD, multicast, next hop not in the ARP table), the
+ * datagram goes through the flow's lwIP UDP PCB instead, which also ARPs.
+ *
+ * With TINYPAN_ENABLE_ZERO_COPY_TX, tinypan_udp_send_ref() sends through the
+ * PCB as well, with the payload left in application memory.
+ *
+ * Received datagrams are demultiplexed by lwIP as usual; their pbufs are
+ * queued on the flow and tinypan_udp_recv() returns a pointer into them.
+ */
+
+#include "tinypan_udp_fast.h"
+
+#if TINYPAN_ENABLE_UDP_FAST
+
+#include "tinypan_lwip_netif.h"
+#include "tinypan_transport.h"
+#include "tinypan_chksum.h"
+#if TINYPAN_ENABLE_ZERO_COPY_TX
+#include "tinypan_zc_tx.h"
+#endif
+#include "../include/tinypan_hal.h"
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/netif.h"
+#include "lwip/ip4_addr.h"
+#include "lwip/etharp.h"
+#include "netif/ethernet.h"
+
+#include <string.h>
+
+#if TINYPAN_UDP_FLOWS < 1 || TINYPAN_UDP_FLOWS > 8
+#error "TINYPAN_UDP_FLOWS must be between 1 and 8"
+#endif
+
+#if TINYPAN_UDP_RX_QUEUE_LEN < 1 || TINYPAN_UDP_RX_QUEUE_LEN > 8
+#error "TINYPAN_UDP_RX_QUEUE_LEN must be between 1 and 8"
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define UDP_FAST_ETH_HLEN       14
+#define UDP_FAST_IP_HLEN        20
+#define UDP_FAST_UDP_HLEN       8
+#define UDP_FAST_IP_PROTO_UDP   17
+#define UDP_FAST_ETHTYPE_IP     0x0800
+
+#if TINYPAN_USE_BLE_SLIP
+/** SLIP carries bare IP packets */
+#define UDP_FAST_IP_OFFSET      0
+#else
+#define UDP_FAST_IP_OFFSET      (ETH_PAD_SIZE + UDP_FAST_ETH_HLEN)
+#endif
+
+#define UDP_FAST_HDR_LEN        (UDP_FAST_IP_OFFSET + UDP_FAST_IP_HLEN + UDP_FAST_UDP_HLEN)
+#define UDP_FAST_FRAME_LEN      (UDP_FAST_HDR_LEN + TINYPAN_UDP_MAX_PAYLOAD)
+
+/** How often a template's destination MAC is checked against the ARP table */
+#define UDP_FAST_ARP_RECHECK_MS 1000
+
+/* ============================================================================
+ * State
+ * ============================================================================ */
+
+typedef struct {
+    struct pbuf* p;
+    uint32_t src_ip;            /**< Network byte order */
+    uint16_t src_port;
+} udp_fast_rx_t;
+
+struct tinypan_udp_flow {
+    bool     open;
+    bool     ready;             /**< Template headers are valid for tmpl_src */
+    uint16_t remote_port;
+    uint32_t remote_ip;         /**< Network byte order */
+    uint32_t tmpl_src;          /**< Local address the template was built for */
+    uint32_t checked_ms;        /**< Last ARP check of the destination MAC */
+    uint32_t ip_sum;            /**< Sum of the constant IP header words */
+    uint32_t udp_sum;           /**< Pseudo header (less length) plus ports */
+    struct udp_pcb* pcb;
+    struct pbuf* tx_p;          /**< PBUF_REF over the frame, kept across close */
+    udp_fast_rx_t rx[TINYPAN_UDP_RX_QUEUE_LEN];
+    uint8_t  rx_head;
+    uint8_t  rx_count;
+    struct pbuf* rx_held;       /**< Datagram last returned by tinypan_udp_recv() */
+};
+
+static struct tinypan_udp_flow s_flows[TINYPAN_UDP_FLOWS];
+
+/** Frame buffers, word aligned */
+static uint32_t s_frames[TINYPAN_UDP_FLOWS][(UDP_FAST_FRAME_LEN + 3) / 4];
+
+static tinypan_udp_stats_t s_stats;
+static uint16_t s_ip_id = 0;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static uint8_t* udp_fast_frame(const tinypan_udp_t* flow) {
+    return (uint8_t*)s_frames[flow - s_flows];
+}
+
+static bool udp_fast_valid(const tinypan_udp_t* flow) {
+    return flow != NULL && flow >= s_flows && flow < &s_flows[TINYPAN_UDP_FLOWS] && flow->open;
+}
+
+static void udp_fast_put16(uint8_t* b, uint16_t v) {
+    b[0] = (uint8_t)(v >> 8);
+    b[1] = (uint8_t)v;
+}
+
+/** Sum of the two 16-bit words of an address in network byte order */
+static uint32_t udp_fast_addr_sum(uint32_t addr) {
+    const uint8_t* b = (const uint8_t*)&addr;
+    return (uint32_t)((b[0] << 8) | b[1]) + (uint32_t)((b[2] << 8) | b[3]);
+}
+
+static uint16_t udp_fast_fold(uint32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+static tinypan_error_t udp_fast_map_err(err_t err) {
+    switch (err) {
+        case ERR_OK:    return TINYPAN_OK;
+        case ERR_MEM:
+        case ERR_BUF:   return TINYPAN_ERR_BUSY;    /* TX queue full */
+        case ERR_CONN:
+        case ERR_RTE:
+        case ERR_IF:    return TINYPAN_ERR_NOT_STARTED;
+        default:        return TINYPAN_ERR_HAL_FAILED;
+    }
+}
+
+#if !TINYPAN_USE_BLE_SLIP
+/**
+ * @brief Write the destination MAC for the flow's next hop into the template
+ * @return false if it is not known (multicast, or not in the ARP table)
+ */
+static bool udp_fast_resolve_mac(tinypan_udp_t* flow, struct netif* netif, uint8_t* eth) {
+    ip4_addr_t dst;
+    ip4_addr_set_u32(&dst, flow->remote_ip);
+
+    if (ip4_addr_isbroadcast(&dst, netif)) {
+        memset(eth, 0xFF, ETH_HWADDR_LEN);
+        return true;
+    }
+    if (ip4_addr_ismulticast(&dst)) {
+        return false;
+    }
+
+    const ip4_addr_t* next_hop = ip4_addr_netcmp(&dst, netif_ip4_addr(netif), netif_ip4_netmask(netif))
+                                 ? &dst : netif_ip4_gw(netif);
+    struct eth_addr* mac = NULL;
+    const ip4_addr_t* unused = NULL;
+    if (etharp_find_addr(netif, next_hop, &mac, &unused) < 0 || mac == NULL) {
+        return false;
+    }
+    memcpy(eth, mac->addr, ETH_HWADDR_LEN);
+    return true;
+}
+#endif
+
+/**
+ * @brief Build the flow's headers for the current local address
+ */
+static bool udp_fast_build(tinypan_udp_t* flow, struct netif* netif) {
+    uint8_t* frame = udp_fast_frame(flow);
+    uint32_t src = netif_ip4_addr(netif)->addr;
+
+#if !TINYPAN_USE_BLE_SLIP
+    uint8_t* eth = frame + ETH_PAD_SIZE;
+    memset(frame, 0, ETH_PAD_SIZE);
+    if (!udp_fast_resolve_mac(flow, netif, eth)) {
+        return false;
+    }
+    memcpy(eth + 6, netif->hwaddr, ETH_HWADDR_LEN);
+    udp_fast_put16(eth + 12, UDP_FAST_ETHTYPE_IP);
+#endif
+
+    uint8_t* ip = frame + UDP_FAST_IP_OFFSET;
+    memset(ip, 0, UDP_FAST_IP_HLEN);
+    ip[0] = 0x45;                           /* IPv4, 20-byte header */
+    ip[8] = UDP_TTL;
+    ip[9] = UDP_FAST_IP_PROTO_UDP;
+    memcpy(ip + 12, &src, 4);
+    memcpy(ip + 16, &flow->remote_ip, 4);
+
+    uint8_t* udp = ip + UDP_FAST_IP_HLEN;
+    udp_fast_put16(udp, flow->pcb->local_port);
+    udp_fast_put16(udp + 2, flow->remote_port);
+
+    /* Total length, ID and checksum are added per send */
+    flow->ip_sum = 0x4500u + ((uint32_t)UDP_TTL << 8) + UDP_FAST_IP_PROTO_UDP +
+                   udp_fast_addr_sum(src) + udp_fast_addr_sum(flow->remote_ip);
+    /* Length appears twice (pseudo header and UDP header), added per send */
+    flow->udp_sum = udp_fast_addr_sum(src) + udp_fast_addr_sum(flow->remote_ip) +
+                    UDP_FAST_IP_PROTO_UDP + flow->pcb->local_port + flow->remote_port;
+
+    flow->tmpl_src = src;
+    flow->checked_ms = hal_get_tick_ms();
+    flow->ready = true;
+    return true;
+}
+
+/**
+ * @brief Make sure the template matches the interface's current state
+ */
+static bool udp_fast_ready(tinypan_udp_t* flow, struct netif* netif) {
+    if (!flow->ready || flow->tmpl_src != netif_ip4_addr(netif)->addr) {
+        return udp_fast_build(flow, netif);
+    }
+#if !TINYPAN_USE_BLE_SLIP
+    /* Follow ARP table changes without a lookup on every send */
+    uint32_t now = hal_get_tick_ms();
+    if (now - flow->checked_ms >= UDP_FAST_ARP_RECHECK_MS) {
+        flow->checked_ms = now;
+        if (!udp_fast_resolve_mac(flow, netif, udp_fast_frame(flow) + ETH_PAD_SIZE)) {
+            flow->ready = false;
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief Send through the prebuilt frame
+ */
+static tinypan_error_t udp_fast_send_frame(tinypan_udp_t* flow, struct netif* netif,
+                                           const void* data, uint16_t len) {
+    const tinypan_transport_t* transport = tinypan_transport_get();
+    if (transport == NULL || transport->output == NULL) {
+        return TINYPAN_ERR_NOT_STARTED;
+    }
+
+    uint8_t* ip = udp_fast_frame(flow) + UDP_FAST_IP_OFFSET;
+    uint8_t* udp = ip + UDP_FAST_IP_HLEN;
+    uint16_t udp_len = (uint16_t)(UDP_FAST_UDP_HLEN + len);
+    uint16_t tot_len = (uint16_t)(UDP_FAST_IP_HLEN + udp_len);
+    uint16_t id = s_ip_id++;
+
+    uint32_t data_sum = lwip_ntohs(tinypan_chksum_copy(udp + UDP_FAST_UDP_HLEN, data, len));
+    uint16_t udp_chk = (uint16_t)~udp_fast_fold(flow->udp_sum + 2u * udp_len + data_sum);
+
+    udp_fast_put16(ip + 2, tot_len);
+    udp_fast_put16(ip + 4, id);
+    udp_fast_put16(ip + 10, (uint16_t)~udp_fast_fold(flow->ip_sum + tot_len + id));
+    udp_fast_put16(udp + 4, udp_len);
+    udp_fast_put16(udp + 6, (udp_chk == 0) ? 0xFFFF : udp_chk);
+
+    struct pbuf* p = flow->tx_p;
+    p->len = p->tot_len = (uint16_t)(UDP_FAST_HDR_LEN + len);
+
+    /* The transport takes its own reference until the frame is on the air */
+    tinypan_error_t result = udp_fast_map_err((err_t)transport->output(netif, p));
+    if (result == TINYPAN_OK) {
+        s_stats.tx_fast++;
+    }
+    return result;
+}
+
+/**
+ * @brief Send through the flow's lwIP UDP PCB
+ */
+static tinypan_error_t udp_fast_send_lwip(tinypan_udp_t* flow, const void* data, uint16_t len) {
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (p == NULL) {
+        return TINYPAN_ERR_NO_MEMORY;
+    }
+    pbuf_take(p, data, len);
+
+    ip_addr_t dst;
+    ip_addr_set_ip4_u32(&dst, flow->remote_ip);
+    tinypan_error_t result = udp_fast_map_err(udp_sendto(flow->pcb, p, &dst, flow->remote_port));
+    pbuf_free(p);
+    if (result == TINYPAN_OK) {
+        s_stats.tx_fallback++;
+    }
+    return result;
+}
+
+static void udp_fast_recv(void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                          const ip_addr_t* addr, u16_t port) {
+    tinypan_udp_t* flow = (tinypan_udp_t*)arg;
+    (void)pcb;
+
+    if (flow->rx_count == TINYPAN_UDP_RX_QUEUE_LEN) {
+        s_stats.rx_dropped++;
+        pbuf_free(p);
+        return;
+    }
+    if (p->next != NULL) {
+        /* Rare (PBUF_POOL_BUFSIZE holds a full frame): make it contiguous */
+        struct pbuf* q = pbuf_coalesce(p, PBUF_RAW);
+        if (q == p) {
+            s_stats.rx_dropped++;
+            pbuf_free(p);
+            return;
+        }
+        p = q;
+    }
+
+    udp_fast_rx_t* slot = &flow->rx[(flow->rx_head + flow->rx_count) % TINYPAN_UDP_RX_QUEUE_LEN];
+    slot->p = p;
+    slot->src_ip = ip_addr_get_ip4_u32(addr);
+    slot->src_port = port;
+    flow->rx_count++;
+    s_stats.rx_datagrams++;
+}
+
+static void udp_fast_release_rx(tinypan_udp_t* flow) {
+    if (flow->rx_held != NULL) {
+        pbuf_free(flow->rx_held);
+        flow->rx_held = NULL;
+    }
+    while (flow->rx_count > 0) {
+        pbuf_free(flow->rx[flow->rx_head].p);
+        flow->rx[flow->rx_head].p = NULL;
+        flow->rx_head = (uint8_t)((flow->rx_head + 1) % TINYPAN_UDP_RX_QUEUE_LEN);
+        flow->rx_count--;
+    }
+}
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+void tinypan_udp_fast_init(void) {
+    tinypan_udp_fast_deinit();
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_ip_id = (uint16_t)hal_get_tick_ms();
+}
+
+void tinypan_udp_fast_deinit(void) {
+    for (int i = 0; i < TINYPAN_UDP_FLOWS; i++) {
+        if (s_flows[i].open) {
+            tinypan_udp_fast_close(&s_flows[i]);
+        }
+        if (s_flows[i].tx_p != NULL) {
+            /* A frame still queued keeps its pbuf; the buffer is static */
+            pbuf_free(s_flows[i].tx_p);
+        }
+        memset(&s_flows[i], 0, sizeof(s_flows[i]));
+    }
+}
+
+tinypan_error_t tinypan_udp_fast_open(uint32_t remote_ip, uint16_t remote_port,
+                                      uint16_t local_port, tinypan_udp_t** flow) {
+    tinypan_udp_t* f = NULL;
+    for (int i = 0; i < TINYPAN_UDP_FLOWS && f == NULL; i++) {
+        if (!s_flows[i].open) {
+            f = &s_flows[i];
+        }
+    }
+    if (f == NULL) {
+        return TINYPAN_ERR_NO_MEMORY;
+    }
+
+    if (f->tx_p == NULL) {
+        f->tx_p = pbuf_alloc(PBUF_RAW, UDP_FAST_FRAME_LEN, PBUF_REF);
+        if (f->tx_p == NULL) {
+            return TINYPAN_ERR_NO_MEMORY;
+        }
+        f->tx_p->payload = udp_fast_frame(f);
+    }
+
+    struct udp_pcb* pcb = udp_new();
+    if (pcb == NULL) {
+        return TINYPAN_ERR_NO_MEMORY;
+    }
+    /* Port 0: lwIP picks an ephemeral port */
+    if (udp_bind(pcb, IP_ADDR_ANY, local_port) != ERR_OK) {
+        udp_remove(pcb);
+        return TINYPAN_ERR_BUSY;
+    }
+    udp_recv(pcb, udp_fast_recv, f);
+
+    f->open = true;
+    f->ready = false;
+    f->remote_ip = remote_ip;
+    f->remote_port = remote_port;
+    f->pcb = pcb;
+    f->rx_head = 0;
+    f->rx_count = 0;
+    f->rx_held = NULL;
+    *flow = f;
+    return TINYPAN_OK;
+}
+
+/**
+ * @brief Checks shared by both send calls
+ */
+static tinypan_error_t udp_fast_check_send(tinypan_udp_t* flow, const void* data, uint16_t len,
+                                           struct netif** netif_out) {
+    if (!udp_fast_valid(flow) || (data == NULL && len > 0)) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+
+    struct netif* netif = tinypan_netif_get();
+    if (netif == NULL || !netif_is_up(netif) || netif_ip4_addr(netif)->addr == 0) {
+        return TINYPAN_ERR_NOT_STARTED;
+    }
+    if (len > netif->mtu - UDP_FAST_IP_HLEN - UDP_FAST_UDP_HLEN) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+    *netif_out = netif;
+    return TINYPAN_OK;
+}
+
+tinypan_error_t tinypan_udp_fast_send(tinypan_udp_t* flow, const void* data, uint16_t len) {
+    struct netif* netif = NULL;
+    tinypan_error_t result = udp_fast_check_send(flow, data, len, &netif);
+    if (result != TINYPAN_OK) {
+        return result;
+    }
+
+    if (len <= TINYPAN_UDP_MAX_PAYLOAD && flow->tx_p->ref == 1 && udp_fast_ready(flow, netif)) {
+        return udp_fast_send_frame(flow, netif, data, len);
+    }
+    return udp_fast_send_lwip(flow, data, len);
+}
+
+#if TINYPAN_ENABLE_ZERO_COPY_TX
+tinypan_error_t tinypan_udp_fast_send_ref(tinypan_udp_t* flow, const void* data, uint16_t len,
+                                          tinypan_tx_done_callback_t done, void* user_data) {
+    struct netif* netif = NULL;
+    tinypan_error_t result = udp_fast_check_send(flow, data, len, &netif);
+    if (result != TINYPAN_OK) {
+        return result;
+    }
+    if (data == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+
+    struct pbuf* p = tinypan_zc_tx_wrap(data, len, done, user_data);
+    if (p == NULL) {
+        return TINYPAN_ERR_BUSY;
+    }
+
+    /* udp_sendto() cannot grow a PBUF_REF, so it chains a header pbuf in
+     * front; the transport's reference on that chain keeps p alive */
+    ip_addr_t dst;
+    ip_addr_set_ip4_u32(&dst, flow->remote_ip);
+    result = udp_fast_map_err(udp_sendto(flow->pcb, p, &dst, flow->remote_port));
+    if (result != TINYPAN_OK) {
+        tinypan_zc_tx_cancel(p);
+        return result;
+    }
+    pbuf_free(p);
+    s_stats.tx_zero_copy++;
+    return TINYPAN_OK;
+}
+#endif
+
+tinypan_error_t tinypan_udp_fast_recv(tinypan_udp_t* flow, const uint8_t** data, uint16_t* len,
+                                      uint32_t* src_ip, uint16_t* src_port) {
+    if (!udp_fast_valid(flow) || data == NULL || len == NULL) {
+        return TINYPAN_ERR_INVALID_PARAM;
+    }
+
+    if (flow->rx_held != NULL) {
+        pbuf_free(flow->rx_held);
+        flow->rx_held = NULL;
+    }
+    if (flow->rx_count == 0) {
+        return TINYPAN_ERR_WOULD_BLOCK;
+    }
+
+    udp_fast_rx_t* slot = &flow->rx[flow->rx_head];
+    flow->rx_head = (uint8_t)((flow->rx_head + 1) % TINYPAN_UDP_RX_QUEUE_LEN);
+    flow->rx_count--;
+
+    flow->rx_held = slot->p;
+    slot->p = NULL;
+    *data = (const uint8_t*)flow->rx_held->payload;
+    *len = flow->rx_held->len;
+    if (src_ip != NULL) {
+        *src_ip = slot->src_ip;
+    }
+    if (src_port != NULL) {
+        *src_port = slot->src_port;
+    }
+    return TINYPAN_OK;
+}
+
+void tinypan_udp_fast_close(tinypan_udp_t* flow) {
+    if (!udp_fast_valid(flow)) {
+        return;
+    }
+    udp_remove(flow->pcb);
+    flow->pcb = NULL;
+    udp_fast_release_rx(flow);
+    flow->open = false;
+    flow->ready = false;
+}
+
+void tinypan_udp_fast_get_stats(tinypan_udp_stats_t* stats) {
+    *stats = s_stats;
+}
+
+#endif /* TINYPAN_ENABLE_UDP_FAST */
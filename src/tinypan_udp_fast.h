@@ -0,0 +1,69 @@
+/*
+ * TinyPAN UDP Fast Path - Internal Header
+ *
+ * Per-flow prebuilt Ethernet/IP/UDP frames for small periodic datagrams
+ * (TINYPAN_ENABLE_UDP_FAST). A send patches the lengths, IP ID and
+ * checksums into the template and hands the frame straight to the active
+ * transport; receives are read in place from lwIP's pbuf. tinypan.c exposes
+ * it as tinypan_udp_open()/send()/recv()/close().
+ */
+
+#ifndef TINYPAN_UDP_FAST_H
+#define TINYPAN_UDP_FAST_H
+
+#include <stdint.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Close every flow and clear the statistics
+ */
+void tinypan_udp_fast_init(void);
+
+/**
+ * @brief Close every flow and release the frame pbufs
+ */
+void tinypan_udp_fast_deinit(void);
+
+/**
+ * @brief Open a flow; see tinypan_udp_open()
+ */
+tinypan_error_t tinypan_udp_fast_open(uint32_t remote_ip, uint16_t remote_port,
+                                      uint16_t local_port, tinypan_udp_t** flow);
+
+/**
+ * @brief Send a datagram; see tinypan_udp_send()
+ */
+tinypan_error_t tinypan_udp_fast_send(tinypan_udp_t* flow, const void* data, uint16_t len);
+
+/**
+ * @brief Send a datagram from application memory; see tinypan_udp_send_ref()
+ */
+tinypan_error_t tinypan_udp_fast_send_ref(tinypan_udp_t* flow, const void* data, uint16_t len,
+                                          tinypan_tx_done_callback_t done, void* user_data);
+
+/**
+ * @brief Read the next datagram in place; see tinypan_udp_recv()
+ */
+tinypan_error_t tinypan_udp_fast_recv(tinypan_udp_t* flow, const uint8_t** data, uint16_t* len,
+                                      uint32_t* src_ip, uint16_t* src_port);
+
+/**
+ * @brief Close a flow; see tinypan_udp_close()
+ */
+void tinypan_udp_fast_close(tinypan_udp_t* flow);
+
+/**
+ * @brief Copy the statistics counters
+ */
+void tinypan_udp_fast_get_stats(tinypan_udp_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_UDP_FAST_H */
@@ -0,0 +1,105 @@
+/*
+ * TinyPAN Zero-Copy TX
+ *
+ * Each slot is an lwIP pbuf_custom whose payload points at application
+ * memory. lwIP treats it as PBUF_REF: udp_sendto() chains its own header
+ * pbuf in front, the checksum reads the data in place and the BNEP
+ * transport maps it into the iovec it hands to the HAL. The transports
+ * already hold a pbuf_ref until the frame is done with (TX_COMPLETE on BNEP,
+ * fully encoded on SLIP, or dropped by a queue flush), so the custom free
+ * function runs exactly when the buffer may be reused, and reports it.
+ *
+ * Where lwIP cannot keep a reference to volatile data (etharp queueing a
+ * packet while it ARPs), it copies the pbuf, and the buffer is released
+ * early.
+ */
+
+#include "tinypan_zc_tx.h"
+
+#if TINYPAN_ENABLE_ZERO_COPY_TX
+
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#if !LWIP_SUPPORT_CUSTOM_PBUF
+#error "TINYPAN_ENABLE_ZERO_COPY_TX needs LWIP_SUPPORT_CUSTOM_PBUF (see lwipopts.h)"
+#endif
+
+#if TINYPAN_ZC_TX_SLOTS < 1 || TINYPAN_ZC_TX_SLOTS > 16
+#error "TINYPAN_ZC_TX_SLOTS must be between 1 and 16"
+#endif
+
+typedef struct {
+    struct pbuf_custom pc;      /**< Must be first: lwIP hands back &pc.pbuf */
+    const void* data;
+    tinypan_tx_done_callback_t done;
+    void* user_data;
+    bool in_use;
+} zc_tx_slot_t;
+
+static zc_tx_slot_t s_slots[TINYPAN_ZC_TX_SLOTS];
+
+/**
+ * @brief Custom free function: the last reference is gone
+ */
+static void zc_tx_free(struct pbuf* p) {
+    zc_tx_slot_t* slot = (zc_tx_slot_t*)p;
+    tinypan_tx_done_callback_t done = slot->done;
+    void* user_data = slot->user_data;
+    const void* data = slot->data;
+
+    /* Free the slot first so the callback can tinypan_pbuf_wrap() the
+     * buffer again. It must not send it: this can run with the TX queue
+     * locked, from the flush or TX_COMPLETE that released the pbuf. */
+    slot->done = NULL;
+    slot->in_use = false;
+    if (done != NULL) {
+        done(data, user_data);
+    }
+}
+
+void tinypan_zc_tx_init(void) {
+    memset(s_slots, 0, sizeof(s_slots));
+}
+
+struct pbuf* tinypan_zc_tx_wrap(const void* data, uint16_t len,
+                                tinypan_tx_done_callback_t done, void* user_data) {
+    if (data == NULL) {
+        return NULL;
+    }
+
+    zc_tx_slot_t* slot = NULL;
+    for (int i = 0; i < TINYPAN_ZC_TX_SLOTS; i++) {
+        if (!s_slots[i].in_use) {
+            slot = &s_slots[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    slot->pc.custom_free_function = zc_tx_free;
+    struct pbuf* p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &slot->pc, (void*)data, len);
+    if (p == NULL) {
+        return NULL;
+    }
+    slot->data = data;
+    slot->done = done;
+    slot->user_data = user_data;
+    slot->in_use = true;
+    return p;
+}
+
+void tinypan_zc_tx_cancel(struct pbuf* p) {
+    if (p == NULL) {
+        return;
+    }
+    ((zc_tx_slot_t*)p)->done = NULL;
+    pbuf_free(p);
+}
+
+#endif /* TINYPAN_ENABLE_ZERO_COPY_TX */
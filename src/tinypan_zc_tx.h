@@ -0,0 +1,45 @@
+/*
+ * TinyPAN Zero-Copy TX - Internal Header
+ *
+ * Wraps application buffers in lwIP custom pbufs (TINYPAN_ENABLE_ZERO_COPY_TX)
+ * and reports their release. tinypan.c exposes it as tinypan_pbuf_wrap();
+ * the UDP fast path uses it for tinypan_udp_send_ref().
+ */
+
+#ifndef TINYPAN_ZC_TX_H
+#define TINYPAN_ZC_TX_H
+
+#include <stdint.h>
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Forget every slot
+ *
+ * Called before lwIP is (re)initialized, so no wrapped pbuf is alive.
+ */
+void tinypan_zc_tx_init(void);
+
+/**
+ * @brief Wrap a buffer; see tinypan_pbuf_wrap()
+ */
+struct pbuf* tinypan_zc_tx_wrap(const void* data, uint16_t len,
+                                tinypan_tx_done_callback_t done, void* user_data);
+
+/**
+ * @brief Drop the caller's reference without running the release callback
+ *
+ * For a send that failed: lwIP holds no other reference, and the
+ * application keeps ownership of the buffer.
+ */
+void tinypan_zc_tx_cancel(struct pbuf* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINYPAN_ZC_TX_H */
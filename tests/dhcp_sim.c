@@ -21,6 +21,12 @@
 /* DHCP Magic Cookie */
 static const uint8_t DHCP_MAGIC[] = {0x63, 0x82, 0x53, 0x63};
 
+/* Loss injection state */
+static dhcp_sim_loss_t s_loss;
+static uint32_t s_loss_msgs = 0;
+static uint32_t s_loss_lost = 0;
+static uint32_t s_loss_rng = 1;
+
 /* ============================================================================
  * Implementation
  * ============================================================================ */
@@ -183,13 +189,26 @@ int dhcp_sim_build_bnep_packet(uint8_t* buffer, uint16_t buffer_size,
                                 uint32_t dst_ip,
                                 const uint8_t* dhcp_data,
                                 uint16_t dhcp_len) {
+    return dhcp_sim_build_udp_packet(buffer, buffer_size, src_mac, dst_mac, src_ip, dst_ip,
+                                     DHCP_SERVER_PORT, DHCP_CLIENT_PORT, dhcp_data, dhcp_len);
+}
+
+int dhcp_sim_build_udp_packet(uint8_t* buffer, uint16_t buffer_size,
+                               const uint8_t src_mac[6],
+                               const uint8_t dst_mac[6],
+                               uint32_t src_ip,
+                               uint32_t dst_ip,
+                               uint16_t src_port,
+                               uint16_t dst_port,
+                               const uint8_t* dhcp_data,
+                               uint16_t dhcp_len) {
     /*
      * Build a complete BNEP packet with:
      * - BNEP header (1 byte for compressed, or 15 for general)
      * - Ethernet addresses (if general)
      * - IP header (20 bytes)
      * - UDP header (8 bytes)
-     * - DHCP payload
+     * - UDP payload (DHCP, DNS, ...)
      */
     
     /* Use general Ethernet format for clarity */
@@ -238,9 +257,9 @@ int dhcp_sim_build_bnep_packet(uint8_t* buffer, uint16_t buffer_size,
     WRITE_BE16(&buffer[checksum_pos], ip_chksum);
     
     /* UDP Header */
-    WRITE_BE16(&buffer[pos], DHCP_SERVER_PORT);  /* Source port */
+    WRITE_BE16(&buffer[pos], src_port);  /* Source port */
     pos += 2;
-    WRITE_BE16(&buffer[pos], DHCP_CLIENT_PORT);  /* Dest port */
+    WRITE_BE16(&buffer[pos], dst_port);  /* Dest port */
     pos += 2;
     uint16_t udp_len = udp_header + dhcp_len;
     WRITE_BE16(&buffer[pos], udp_len);
@@ -398,3 +417,278 @@ int dhcp_sim_is_request(const uint8_t* data, uint16_t len, uint32_t* xid) {
     
     return 0;
 }
+
+int dhcp_sim_requests_option(const uint8_t* data, uint16_t len, uint8_t option) {
+    if (data == NULL || len < 50) {
+        return 0;
+    }
+
+    uint16_t eth_offset = ((data[0] & 0x7F) == 0x00) ? 15 : 3;
+    uint16_t dhcp_offset = eth_offset + 20 + 8;
+    if (len < dhcp_offset + 240 || memcmp(&data[dhcp_offset + 236], DHCP_MAGIC, 4) != 0) {
+        return 0;
+    }
+
+    uint16_t opt_offset = dhcp_offset + 240;
+    while (opt_offset < len - 2) {
+        uint8_t opt_type = data[opt_offset];
+        if (opt_type == DHCP_OPTION_END) break;
+        if (opt_type == 0) { opt_offset++; continue; }
+
+        uint8_t opt_len = data[opt_offset + 1];
+        if (opt_type == DHCP_OPTION_PARAM_REQUEST_LIST && opt_offset + 2 + opt_len <= len) {
+            return memchr(&data[opt_offset + 2], option, opt_len) != NULL;
+        }
+
+        opt_offset += 2 + opt_len;
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * DNS Responder
+ * ============================================================================ */
+
+/**
+ * @brief Offset of the IP header in a BNEP Ethernet frame, 0 if not IPv4
+ */
+static uint16_t bnep_ipv4_offset(const uint8_t* data, uint16_t len) {
+    uint16_t eth_offset;
+
+    switch (data[0]) {     /* No extension headers */
+        case 0x00: eth_offset = 15; break;  /* General Ethernet */
+        case 0x02: eth_offset = 3;  break;  /* Compressed */
+        case 0x03:                          /* Compressed, source only */
+        case 0x04: eth_offset = 9;  break;  /* Compressed, destination only */
+        default: return 0;
+    }
+    if (len < eth_offset + 28 || data[eth_offset - 2] != 0x08 || data[eth_offset - 1] != 0x00) {
+        return 0;
+    }
+    return eth_offset;
+}
+
+int dhcp_sim_is_dns_query(const uint8_t* data, uint16_t len, dhcp_sim_dns_query_t* query) {
+    if (data == NULL || query == NULL || len < 50) {
+        return 0;
+    }
+
+    uint16_t ip_offset = bnep_ipv4_offset(data, len);
+    if (ip_offset == 0 || data[ip_offset + 9] != 17) {  /* UDP */
+        return 0;
+    }
+
+    uint16_t udp_offset = ip_offset + (uint16_t)((data[ip_offset] & 0x0F) * 4);
+    uint16_t dns_offset = udp_offset + 8;
+    if (len < dns_offset + 12) {
+        return 0;
+    }
+    if ((((uint16_t)data[udp_offset + 2] << 8) | data[udp_offset + 3]) != DNS_SERVER_PORT) {
+        return 0;
+    }
+
+    const uint8_t* dns = &data[dns_offset];
+    uint16_t dns_len = len - dns_offset;
+    if ((dns[2] & 0x80) != 0 || dns[4] != 0 || dns[5] != 1) {  /* Query, one question */
+        return 0;
+    }
+
+    memset(query, 0, sizeof(*query));
+    query->id = ((uint16_t)dns[0] << 8) | dns[1];
+    query->client_port = ((uint16_t)data[udp_offset] << 8) | data[udp_offset + 1];
+    query->client_ip = READ_BE32(&data[ip_offset + 12]);
+    query->server_ip = READ_BE32(&data[ip_offset + 16]);
+
+    /* Question: labels, then QTYPE and QCLASS */
+    uint16_t pos = 12;
+    uint16_t name_len = 0;
+    while (pos < dns_len && dns[pos] != 0) {
+        uint8_t label = dns[pos++];
+        if (label > 63 || pos + label > dns_len ||
+            name_len + label + 1 >= DHCP_SIM_DNS_NAME_MAX) {
+            return 0;
+        }
+        if (name_len > 0) {
+            query->name[name_len++] = '.';
+        }
+        memcpy(&query->name[name_len], &dns[pos], label);
+        name_len += label;
+        pos += label;
+    }
+    if (pos + 5 > dns_len) {
+        return 0;
+    }
+    pos++;
+    query->qtype = ((uint16_t)dns[pos] << 8) | dns[pos + 1];
+    pos += 4;
+
+    query->question_len = pos - 12;
+    memcpy(query->question, &dns[12], query->question_len);
+    return 1;
+}
+
+int dhcp_sim_build_dns_response(uint8_t* buffer, uint16_t buffer_size,
+                                 const dhcp_sim_config_t* config,
+                                 const dhcp_sim_dns_query_t* query,
+                                 const dhcp_sim_dns_answer_t* answer,
+                                 const uint8_t client_mac[6]) {
+    uint8_t msg[512];
+    uint16_t pos = 0;
+    int has_a = (answer->rcode == DNS_RCODE_NOERROR && answer->addr != 0);
+    int has_soa = (answer->soa_ttl != 0);
+
+    if (config == NULL || query == NULL || answer == NULL || client_mac == NULL) {
+        return -1;
+    }
+
+    /* Header: response, RD and RA set */
+    WRITE_BE16(&msg[pos], query->id);
+    pos += 2;
+    WRITE_BE16(&msg[pos], 0x8180 | (answer->rcode & 0x0F));
+    pos += 2;
+    WRITE_BE16(&msg[pos], 1);           /* QDCOUNT */
+    pos += 2;
+    WRITE_BE16(&msg[pos], has_a);       /* ANCOUNT */
+    pos += 2;
+    WRITE_BE16(&msg[pos], has_soa);     /* NSCOUNT */
+    pos += 2;
+    WRITE_BE16(&msg[pos], 0);           /* ARCOUNT */
+    pos += 2;
+
+    memcpy(&msg[pos], query->question, query->question_len);
+    pos += query->question_len;
+
+    if (has_a) {
+        msg[pos++] = 0xC0;              /* Name: pointer to the question */
+        msg[pos++] = 12;
+        WRITE_BE16(&msg[pos], 1);       /* A */
+        pos += 2;
+        WRITE_BE16(&msg[pos], 1);       /* IN */
+        pos += 2;
+        WRITE_BE32(&msg[pos], answer->ttl);
+        pos += 4;
+        WRITE_BE16(&msg[pos], 4);
+        pos += 2;
+        WRITE_BE32(&msg[pos], answer->addr);
+        pos += 4;
+    }
+
+    if (has_soa) {
+        msg[pos++] = 0x00;              /* Name: the root zone */
+        WRITE_BE16(&msg[pos], 6);       /* SOA */
+        pos += 2;
+        WRITE_BE16(&msg[pos], 1);       /* IN */
+        pos += 2;
+        WRITE_BE32(&msg[pos], answer->soa_ttl);
+        pos += 4;
+        WRITE_BE16(&msg[pos], 2 + 20);
+        pos += 2;
+        msg[pos++] = 0x00;              /* MNAME */
+        msg[pos++] = 0x00;              /* RNAME */
+        WRITE_BE32(&msg[pos], 1);       /* SERIAL */
+        pos += 4;
+        WRITE_BE32(&msg[pos], 1800);    /* REFRESH */
+        pos += 4;
+        WRITE_BE32(&msg[pos], 900);     /* RETRY */
+        pos += 4;
+        WRITE_BE32(&msg[pos], 604800);  /* EXPIRE */
+        pos += 4;
+        WRITE_BE32(&msg[pos], answer->soa_minimum);
+        pos += 4;
+    }
+
+    return dhcp_sim_build_udp_packet(buffer, buffer_size, config->server_mac, client_mac,
+                                     query->server_ip, query->client_ip,
+                                     DNS_SERVER_PORT, query->client_port, msg, pos);
+}
+
+/* ============================================================================
+ * UDP Datagrams
+ * ============================================================================ */
+
+int dhcp_sim_parse_udp(const uint8_t* data, uint16_t len, dhcp_sim_udp_t* udp) {
+    if (data == NULL || udp == NULL || len < 1) {
+        return 0;
+    }
+
+    uint16_t ip_offset = bnep_ipv4_offset(data, len);
+    if (ip_offset == 0 || (data[ip_offset] & 0x0F) != 5 || data[ip_offset + 9] != 17) {
+        return 0;
+    }
+    const uint8_t* ip = &data[ip_offset];
+    const uint8_t* uh = ip + 20;
+    uint16_t ip_len = ((uint16_t)ip[2] << 8) | ip[3];
+    uint16_t udp_len = ((uint16_t)uh[4] << 8) | uh[5];
+    if (ip_len != len - ip_offset || udp_len != ip_len - 20 || udp_len < 8) {
+        return 0;
+    }
+
+    memset(udp, 0, sizeof(*udp));
+    udp->bnep_type = data[0];
+    if (data[0] == 0x00 || data[0] == 0x04) {
+        memcpy(udp->dst_mac, &data[1], 6);
+    }
+    udp->src_ip = READ_BE32(&ip[12]);
+    udp->dst_ip = READ_BE32(&ip[16]);
+    udp->ip_id = ((uint16_t)ip[4] << 8) | ip[5];
+    udp->ttl = ip[8];
+    udp->src_port = ((uint16_t)uh[0] << 8) | uh[1];
+    udp->dst_port = ((uint16_t)uh[2] << 8) | uh[3];
+    udp->ip_checksum_ok = (calc_checksum(ip, 20) == 0);
+    udp->payload = uh + 8;
+    udp->payload_len = udp_len - 8;
+
+    if (uh[6] == 0 && uh[7] == 0) {
+        udp->udp_checksum_ok = 1;
+    } else {
+        /* Pseudo header: addresses, protocol, UDP length */
+        uint8_t pseudo[12];
+        memcpy(pseudo, &ip[12], 8);
+        pseudo[8] = 0;
+        pseudo[9] = 17;
+        WRITE_BE16(&pseudo[10], udp_len);
+        uint32_t sum = (uint16_t)~calc_checksum(pseudo, sizeof(pseudo));
+        sum += (uint16_t)~calc_checksum(uh, udp_len);
+        while (sum >> 16) {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        udp->udp_checksum_ok = (sum == 0xFFFF);
+    }
+    return 1;
+}
+
+void dhcp_sim_set_loss(const dhcp_sim_loss_t* loss) {
+    memset(&s_loss, 0, sizeof(s_loss));
+    if (loss != NULL) {
+        s_loss = *loss;
+    }
+    s_loss_msgs = 0;
+    s_loss_lost = 0;
+    s_loss_rng = (s_loss.seed != 0) ? s_loss.seed : 1;
+}
+
+int dhcp_sim_deliver(void) {
+    uint32_t n = s_loss_msgs++;
+    int lost = (n < 32) && (s_loss.drop_mask & (1UL << n)) != 0;
+
+    if (s_loss.loss_percent > 0) {
+        /* xorshift32: same sequence for the same seed on every platform */
+        s_loss_rng ^= s_loss_rng << 13;
+        s_loss_rng ^= s_loss_rng >> 17;
+        s_loss_rng ^= s_loss_rng << 5;
+        if (s_loss_rng % 100 < s_loss.loss_percent) {
+            lost = 1;
+        }
+    }
+
+    if (lost) {
+        s_loss_lost++;
+        return 0;
+    }
+    return 1;
+}
+
+uint32_t dhcp_sim_get_lost(void) {
+    return s_loss_lost;
+}
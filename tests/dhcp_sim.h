@@ -42,6 +42,7 @@ extern "C" {
 #define DHCP_OPTION_SUBNET_MASK         1
 #define DHCP_OPTION_ROUTER              3
 #define DHCP_OPTION_DNS                 6
+#define DHCP_OPTION_PARAM_REQUEST_LIST  55
 #define DHCP_OPTION_END                 255
 
 /* Ports */
@@ -126,6 +127,23 @@ int dhcp_sim_build_bnep_packet(uint8_t* buffer, uint16_t buffer_size,
                                 const uint8_t* dhcp_data,
                                 uint16_t dhcp_len);
 
+/**
+ * @brief Build a complete BNEP-wrapped UDP packet with the given ports
+ * 
+ * Same framing as dhcp_sim_build_bnep_packet(), for other UDP services.
+ * 
+ * @return Length of complete packet, or negative on error
+ */
+int dhcp_sim_build_udp_packet(uint8_t* buffer, uint16_t buffer_size,
+                               const uint8_t src_mac[6],
+                               const uint8_t dst_mac[6],
+                               uint32_t src_ip,
+                               uint32_t dst_ip,
+                               uint16_t src_port,
+                               uint16_t dst_port,
+                               const uint8_t* payload,
+                               uint16_t payload_len);
+
 /**
  * @brief Check if a received BNEP packet is a DHCP Discover
  * 
@@ -148,6 +166,139 @@ int dhcp_sim_is_discover(const uint8_t* data, uint16_t len,
  */
 int dhcp_sim_is_request(const uint8_t* data, uint16_t len, uint32_t* xid);
 
+/**
+ * @brief Check if a DHCP client message asks for an option
+ * 
+ * @param data        Received BNEP packet (DISCOVER or REQUEST)
+ * @param len         Packet length
+ * @param option      Option code to look for
+ * @return 1 if the parameter request list (option 55) contains it, 0 otherwise
+ */
+int dhcp_sim_requests_option(const uint8_t* data, uint16_t len, uint8_t option);
+
+/* ============================================================================
+ * DNS Responder
+ * ============================================================================ */
+
+#define DNS_SERVER_PORT         53
+
+#define DNS_RCODE_NOERROR       0
+#define DNS_RCODE_SERVFAIL      2
+#define DNS_RCODE_NXDOMAIN      3
+
+/** Longest name the responder parses */
+#define DHCP_SIM_DNS_NAME_MAX   128
+
+/** A DNS query sent by the client */
+typedef struct {
+    uint16_t id;                    /**< Transaction ID */
+    uint16_t client_port;           /**< Source port (the response goes back there) */
+    uint32_t client_ip;             /**< Source IP (host order) */
+    uint32_t server_ip;             /**< Destination IP (host order) */
+    uint16_t qtype;                 /**< Query type (1 = A) */
+    char     name[DHCP_SIM_DNS_NAME_MAX]; /**< Queried name, dotted */
+    uint16_t question_len;          /**< Bytes in question[] */
+    uint8_t  question[DHCP_SIM_DNS_NAME_MAX + 6]; /**< Question section as sent */
+} dhcp_sim_dns_query_t;
+
+/** How the simulated server answers a query */
+typedef struct {
+    uint8_t  rcode;                 /**< DNS_RCODE_* */
+    uint32_t addr;                  /**< A record (host order), 0 for none */
+    uint32_t ttl;                   /**< A record TTL in seconds */
+    uint32_t soa_ttl;               /**< SOA record TTL in the authority section, 0 for none */
+    uint32_t soa_minimum;           /**< SOA MINIMUM field (negative caching TTL) */
+} dhcp_sim_dns_answer_t;
+
+/**
+ * @brief Check if a received BNEP packet is a DNS query
+ * 
+ * @param data        Received BNEP packet
+ * @param len         Packet length
+ * @param query       [out] Parsed query
+ * @return 1 if it is a DNS query to port 53, 0 otherwise
+ */
+int dhcp_sim_is_dns_query(const uint8_t* data, uint16_t len, dhcp_sim_dns_query_t* query);
+
+/**
+ * @brief Build a complete BNEP-wrapped DNS response to a query
+ * 
+ * @param buffer      Buffer to write packet to
+ * @param buffer_size Size of buffer
+ * @param config      Network configuration (server MAC)
+ * @param query       Query being answered
+ * @param answer      What to answer
+ * @param client_mac  Client's MAC address
+ * @return Length of packet, or negative on error
+ */
+int dhcp_sim_build_dns_response(uint8_t* buffer, uint16_t buffer_size,
+                                 const dhcp_sim_config_t* config,
+                                 const dhcp_sim_dns_query_t* query,
+                                 const dhcp_sim_dns_answer_t* answer,
+                                 const uint8_t client_mac[6]);
+
+/* ============================================================================
+ * UDP Datagrams
+ * ============================================================================ */
+
+/** A UDP datagram sent by the client */
+typedef struct {
+    uint8_t  bnep_type;             /**< BNEP packet type (0x00, 0x02, 0x03 or 0x04) */
+    uint8_t  dst_mac[6];            /**< Destination MAC if carried (types 0x00, 0x04) */
+    uint32_t src_ip;                /**< Source IP (host order) */
+    uint32_t dst_ip;                /**< Destination IP (host order) */
+    uint16_t ip_id;                 /**< IP identification */
+    uint8_t  ttl;                   /**< IP time to live */
+    uint16_t src_port;
+    uint16_t dst_port;
+    int      ip_checksum_ok;        /**< IP header checksum verifies */
+    int      udp_checksum_ok;       /**< UDP checksum verifies (or is 0, not computed) */
+    const uint8_t* payload;         /**< Points into the parsed packet */
+    uint16_t payload_len;
+} dhcp_sim_udp_t;
+
+/**
+ * @brief Parse a received BNEP packet as an IPv4 UDP datagram
+ * 
+ * @param data        Received BNEP packet
+ * @param len         Packet length
+ * @param udp         [out] Parsed datagram
+ * @return 1 if it is a UDP datagram with consistent lengths, 0 otherwise
+ */
+int dhcp_sim_parse_udp(const uint8_t* data, uint16_t len, dhcp_sim_udp_t* udp);
+
+/* ============================================================================
+ * Loss Injection
+ * ============================================================================ */
+
+/** Which DHCP messages (in either direction) the simulated link loses */
+typedef struct {
+    uint32_t drop_mask;     /**< Bit n set: lose the n-th message (n < 32) */
+    uint8_t  loss_percent;  /**< Random loss applied to every message (0-100) */
+    uint32_t seed;          /**< Seed for the random loss, for repeatable runs */
+} dhcp_sim_loss_t;
+
+/**
+ * @brief Set the loss model and restart the message count
+ *
+ * @param loss Loss model, or NULL for a lossless link
+ */
+void dhcp_sim_set_loss(const dhcp_sim_loss_t* loss);
+
+/**
+ * @brief Decide the fate of the next DHCP message
+ *
+ * Call once per message, client DISCOVER/REQUEST and server OFFER/ACK alike.
+ *
+ * @return 1 if the message is delivered, 0 if it is lost
+ */
+int dhcp_sim_deliver(void);
+
+/**
+ * @brief Number of messages lost since dhcp_sim_set_loss()
+ */
+uint32_t dhcp_sim_get_lost(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,4 +10,7 @@
 /* Bluetooth device address */
 typedef uint8_t esp_bd_addr_t[6];
 
+/* esp_bt_status_t carries HCI error codes offset by this base */
+#define ESP_BT_STATUS_BASE_FOR_HCI_ERR  0x0100
+
 #endif /* ESP_BT_H */
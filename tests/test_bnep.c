@@ -302,6 +302,40 @@ static int test_buffer_overflow_protection(void) {
     return 1;
 }
 
+/**
+ * Test parsing the response code of a BNEP filter response
+ */
+static uint16_t s_filter_resp = 0xFFFF;
+
+static void on_filter_response(uint16_t response_code, void* user_data) {
+    (void)user_data;
+    s_filter_resp = response_code;
+}
+
+static int test_parse_filter_response(void) {
+    /* Control packet: type (0x01), Filter Multi Addr Response (0x06), code */
+    uint8_t success[] = {0x01, 0x06, 0x00, 0x00};
+    uint8_t too_many[] = {0x01, 0x06, 0x00, 0x03};
+
+    bnep_register_filter_response_callback(on_filter_response, NULL);
+
+    bnep_handle_incoming(success, sizeof(success));
+    if (s_filter_resp != 0x0000) {
+        printf("\n    Wrong response code: 0x%04X\n", s_filter_resp);
+        bnep_register_filter_response_callback(NULL, NULL);
+        return 0;
+    }
+
+    bnep_handle_incoming(too_many, sizeof(too_many));
+    bnep_register_filter_response_callback(NULL, NULL);
+    if (s_filter_resp != 0x0003) {
+        printf("\n    Wrong response code: 0x%04X\n", s_filter_resp);
+        return 0;
+    }
+
+    return 1;
+}
+
 /* ============================================================================
  * Main
  * ============================================================================ */
@@ -323,6 +357,7 @@ int main(void) {
     TEST(parse_setup_response);
     TEST(parse_compressed_ethernet);
     TEST(buffer_overflow_protection);
+    TEST(parse_filter_response);
     
     printf("\n=======================\n");
     printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
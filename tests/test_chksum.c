@@ -0,0 +1,258 @@
+/*
+ * TinyPAN Test - Internet Checksum
+ *
+ * Fuzzes tinypan_chksum() and tinypan_chksum_copy() against lwIP's stock
+ * routine (lwip_standard_chksum, LWIP_CHKSUM_ALGORITHM 2, reproduced below)
+ * over random lengths, contents and start offsets, then compares their
+ * throughput (CPU time) in bytes per nanosecond and, on x86, bytes per cycle.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../src/tinypan_chksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#else
+#define HAVE_CYCLES 0
+#endif
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define BUF_MAX         2048
+#define FUZZ_ROUNDS     200000
+
+/* 8-byte aligned so offsets 0..7 cover every start alignment */
+static uint64_t s_src_words[(BUF_MAX + 16) / 8];
+static uint64_t s_dst_words[(BUF_MAX + 16) / 8];
+#define s_src ((uint8_t*)s_src_words)
+#define s_dst ((uint8_t*)s_dst_words)
+
+static uint32_t s_rng = 0x12345678;
+
+static uint32_t rnd(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+/**
+ * lwIP 2.1.3 lwip_standard_chksum(), LWIP_CHKSUM_ALGORITHM 2
+ */
+static uint16_t stock_chksum(const void* dataptr, int len) {
+    const uint8_t* pb = (const uint8_t*)dataptr;
+    const uint16_t* ps;
+    uint16_t t = 0;
+    uint32_t sum = 0;
+    int odd = (int)((uintptr_t)pb & 1);
+
+    if (odd && len > 0) {
+        ((uint8_t*)&t)[1] = *pb++;
+        len--;
+    }
+    ps = (const uint16_t*)(const void*)pb;
+    while (len > 1) {
+        sum += *ps++;
+        len -= 2;
+    }
+    if (len > 0) {
+        ((uint8_t*)&t)[0] = *(const uint8_t*)ps;
+    }
+    sum += t;
+    sum = (sum >> 16) + (sum & 0x0000FFFFUL);
+    sum = (sum >> 16) + (sum & 0x0000FFFFUL);
+    if (odd) {
+        sum = ((sum & 0xFF) << 8) | ((sum & 0xFF00) >> 8);
+    }
+    return (uint16_t)sum;
+}
+
+static void fill(uint8_t* buf, int len, int pattern) {
+    for (int i = 0; i < len; i++) {
+        switch (pattern) {
+            case 0:  buf[i] = (uint8_t)rnd(); break;
+            case 1:  buf[i] = 0xFF; break;
+            case 2:  buf[i] = 0x00; break;
+            default: buf[i] = (rnd() & 1) ? 0xFF : 0x00; break;
+        }
+    }
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Known vector: RFC 1071 section 3 example, plus a real IPv4 header
+ */
+static int test_known_vectors(void) {
+    static const uint8_t rfc1071[] = { 0x00, 0x01, 0xF2, 0x03, 0xF4, 0xF5, 0xF6, 0xF7 };
+    /* 192.168.44.2 -> 192.168.44.1 UDP, header checksum 0xA17D filled in */
+    static const uint8_t ip_hdr[] = {
+        0x45, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x40, 0x11,
+        0xA1, 0x7D, 0xC0, 0xA8, 0x2C, 0x02, 0xC0, 0xA8, 0x2C, 0x01
+    };
+
+    memcpy(s_src, rfc1071, sizeof(rfc1071));
+    uint16_t sum = tinypan_chksum(s_src, sizeof(rfc1071));
+    uint8_t* b = (uint8_t*)&sum;
+    if (b[0] != 0xDD || b[1] != 0xF2) {     /* RFC 1071: 0xDDF2 */
+        printf("\n    RFC 1071 sum %02X%02X, expected DDF2\n", b[0], b[1]);
+        return 0;
+    }
+
+    /* A header with a valid checksum sums to all ones, at any alignment */
+    for (int off = 0; off < 8; off++) {
+        memcpy(s_src + off, ip_hdr, sizeof(ip_hdr));
+        if (tinypan_chksum(s_src + off, sizeof(ip_hdr)) != 0xFFFF) {
+            printf("\n    IPv4 header at offset %d does not verify\n", off);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Random lengths, contents and offsets: identical to the stock routine
+ */
+static int test_fuzz_matches_stock(void) {
+    for (int round = 0; round < FUZZ_ROUNDS; round++) {
+        int off = (int)(rnd() % 8);
+        int len = (round < 64) ? round : (int)(rnd() % (BUF_MAX - 8));
+        int pattern = (int)(rnd() % 4);
+        fill(s_src + off, len, pattern);
+
+        uint16_t want = stock_chksum(s_src + off, len);
+        uint16_t got = tinypan_chksum(s_src + off, len);
+        if (got != want) {
+            printf("\n    len %d offset %d pattern %d: 0x%04X, stock 0x%04X\n",
+                   len, off, pattern, got, want);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Copy variant: exact copy and the stock sum, for every src/dst alignment pair
+ */
+static int test_fuzz_copy(void) {
+    for (int round = 0; round < FUZZ_ROUNDS / 4; round++) {
+        int soff = (int)(rnd() % 8);
+        int doff = (int)(rnd() % 8);
+        int len = (round < 64) ? round : (int)(rnd() % (BUF_MAX - 8));
+        fill(s_src + soff, len, (int)(rnd() % 4));
+        memset(s_dst, 0xA5, BUF_MAX + 16);
+
+        uint16_t want = stock_chksum(s_src + soff, len);
+        uint16_t got = tinypan_chksum_copy(s_dst + doff, s_src + soff, (uint16_t)len);
+        if (got != want || memcmp(s_dst + doff, s_src + soff, (size_t)len) != 0) {
+            printf("\n    len %d src+%d dst+%d: 0x%04X, stock 0x%04X\n", len, soff, doff, got, want);
+            return 0;
+        }
+        /* Nothing written past the end */
+        if (s_dst[doff + len] != 0xA5 || (doff > 0 && s_dst[doff - 1] != 0xA5)) {
+            printf("\n    len %d src+%d dst+%d: wrote outside the destination\n", len, soff, doff);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * Benchmark
+ * ============================================================================ */
+
+typedef uint16_t (*chksum_fn_t)(const void* dataptr, int len);
+
+static volatile uint16_t s_sink;
+
+static double now_ns(void) {
+    return (double)clock() * (1e9 / CLOCKS_PER_SEC);
+}
+
+/** @return Bytes per ns; *bytes_per_cycle is filled in on x86 (else 0) */
+static double bench(chksum_fn_t fn, int off, int len, double* bytes_per_cycle) {
+    chksum_fn_t volatile call = fn;     /* Keep the sum inside the timed loop */
+    int iters = (int)(64L * 1024 * 1024 / len);
+    uint16_t acc = 0;
+#if HAVE_CYCLES
+    uint64_t c0 = __rdtsc();
+#endif
+    double t0 = now_ns();
+    for (int i = 0; i < iters; i++) {
+        acc = (uint16_t)(acc + call(s_src + off, len));
+    }
+    double t1 = now_ns();
+#if HAVE_CYCLES
+    uint64_t c1 = __rdtsc();
+    *bytes_per_cycle = (double)iters * len / (double)(c1 - c0);
+#else
+    *bytes_per_cycle = 0;
+#endif
+    s_sink = acc;
+    return (double)iters * len / (t1 - t0);
+}
+
+static int test_benchmark(void) {
+    static const int sizes[] = { 20, 64, 576, 1472 };
+
+    fill(s_src, BUF_MAX, 0);
+    printf("\n");
+    printf("    %6s %4s %14s %14s %8s\n", "bytes", "off", "stock B/ns", "tinypan B/ns", "speedup");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (int off = 0; off < 2; off++) {
+            double stock_bpc, fast_bpc;
+            double stock = bench(stock_chksum, off, sizes[i], &stock_bpc);
+            double fast = bench(tinypan_chksum, off, sizes[i], &fast_bpc);
+            printf("    %6d %4d %14.2f %14.2f %7.2fx", sizes[i], off, stock, fast, fast / stock);
+            if (HAVE_CYCLES) {
+                printf("   (%.2f vs %.2f B/cycle)", stock_bpc, fast_bpc);
+            }
+            printf("\n");
+        }
+    }
+    printf("    ");
+    return 1;   /* Informational: timing is not asserted */
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Checksum Tests\n");
+    printf("======================\n\n");
+
+    printf("Running tests:\n");
+
+    TEST(known_vectors);
+    TEST(fuzz_matches_stock);
+    TEST(fuzz_copy);
+    TEST(benchmark);
+
+    printf("\n======================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+/*
+ * TinyPAN Test - Common Fixture
+ *
+ * Helpers shared by the tests that run the full stack over the mock HAL
+ * on mock time: advancing the clock, starting the stack against the NAP,
+ * answering the L2CAP/BNEP handshake, and shutting it down again. Tests
+ * that include dhcp_sim.h first also get a simulated NAP that answers
+ * DHCP, and a bring-up to ONLINE through it. Each test keeps its own
+ * checks on top of these.
+ */
+
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "../src/tinypan_internal.h"
+
+/** Address of the NAP the tests connect to */
+static const uint8_t s_nap[6] = { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+
+static inline void step(uint32_t ms) {
+    mock_hal_advance_tick_ms(ms);
+    tinypan_process();
+}
+
+/**
+ * Sleep as long as tinypan_get_next_timeout_ms() allows, at most 1 s
+ */
+static inline void sleep_step(void) {
+    uint32_t sleep = tinypan_get_next_timeout_ms();
+    step((sleep == 0) ? 1 : ((sleep > 1000) ? 1000 : sleep));
+}
+
+/**
+ * Default configuration, connecting to s_nap
+ */
+static inline void nap_config(tinypan_config_t* config) {
+    tinypan_config_init(config);
+    memcpy(config->remote_addr, s_nap, sizeof(s_nap));
+}
+
+/**
+ * Start the stack on mock time and wait for its first connect attempt
+ * @param event_cb event callback to install, or NULL
+ */
+static inline int start_stack(const tinypan_config_t* config, tinypan_event_callback_t event_cb) {
+    if (tinypan_init(config) != TINYPAN_OK) return 0;
+    if (event_cb != NULL) {
+        tinypan_set_event_callback(event_cb, NULL);
+    }
+    mock_hal_use_mock_time(true);
+    if (tinypan_start() != TINYPAN_OK) return 0;
+
+    for (int i = 0; i < 3000 && tinypan_get_state() != TINYPAN_STATE_CONNECTING; i++) {
+        step(1);
+    }
+    return tinypan_get_state() == TINYPAN_STATE_CONNECTING;
+}
+
+/**
+ * Answer the L2CAP connect, BNEP setup and filter
+ */
+static inline void answer_handshake(void) {
+    mock_hal_simulate_connect_success();
+    tinypan_process();
+    mock_hal_simulate_bnep_setup_success();
+    tinypan_process();
+    const uint8_t filter_rsp[4] = { BNEP_PKT_TYPE_CONTROL, BNEP_CTRL_FILTER_MULTI_ADDR_RESPONSE, 0, 0 };
+    mock_hal_simulate_receive(filter_rsp, sizeof(filter_rsp));
+    tinypan_process();
+}
+
+/**
+ * Answer the handshake and hand out an address
+ */
+static inline void complete_bring_up(void) {
+    answer_handshake();
+    tinypan_internal_set_ip(0x0A00000Au, 0xFFFFFF00u, 0x0A000001u, 0);
+}
+
+/**
+ * Let the frames in flight complete, then shut the stack down
+ */
+static inline void tear_down(void) {
+    mock_hal_drop_tx_completes(0);
+    for (int i = 0; i < 50; i++) {
+        step(1);
+    }
+    tinypan_deinit();
+}
+
+#ifdef TINYPAN_DHCP_SIM_H
+/* ============================================================================
+ * Simulated NAP with DHCP
+ * ============================================================================ */
+
+extern const uint8_t* mock_hal_get_tx_history_data(int index_from_newest);
+extern uint16_t mock_hal_get_tx_history_len(int index_from_newest);
+extern void tinypan_netif_input(const uint8_t* dst, const uint8_t* src, uint16_t ethertype,
+                                const uint8_t* payload, uint16_t payload_len);
+
+#define NAP_STEP_MS             10
+#define NAP_ONLINE_TIMEOUT_MS   20000
+
+/** Steps settle() runs; tests with a deeper TX queue define it before the include */
+#ifndef NAP_SETTLE_STEPS
+#define NAP_SETTLE_STEPS        3
+#endif
+
+/** Ethernet address the stack derives from the mock HAL's BD address */
+static const uint8_t s_client_mac[6] = { 0x12, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+/** Network the NAP hands out (set by nap_connect()) */
+static dhcp_sim_config_t s_sim;
+
+/** TX frames nap_answer() has already looked at */
+static uint32_t s_tx_seen;
+
+/**
+ * Optional nap_answer() hooks: the DHCP hook sees each DISCOVER/REQUEST
+ * first and returns false to leave it unanswered; the frame hook sees
+ * every other frame the client sent
+ */
+static bool (*s_nap_dhcp_hook)(const uint8_t* tx, uint16_t tx_len, bool discover, uint32_t xid);
+static void (*s_nap_frame_hook)(const uint8_t* tx, uint16_t tx_len);
+
+/**
+ * Hand a BNEP-framed packet built by dhcp_sim to the stack
+ */
+static inline void nap_inject(const uint8_t* pkt, int len) {
+    if (len > 15) {
+        tinypan_netif_input(pkt + 1, pkt + 7, ((uint16_t)pkt[13] << 8) | pkt[14],
+                            pkt + 15, (uint16_t)(len - 15));
+    }
+}
+
+/**
+ * Broadcast a DHCP reply from the NAP
+ */
+static inline void nap_inject_dhcp(const uint8_t* dhcp, int dhcp_len) {
+    static const uint8_t broadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    uint8_t pkt[1024];
+    if (dhcp_len <= 0) return;
+    nap_inject(pkt, dhcp_sim_build_bnep_packet(pkt, sizeof(pkt), s_sim.server_mac, broadcast,
+                                               s_sim.server_ip, 0xFFFFFFFF, dhcp, (uint16_t)dhcp_len));
+}
+
+/**
+ * Answer the frames sent since the last call: DISCOVER with an OFFER and
+ * REQUEST with an ACK, each way through the dhcp_sim_set_loss() model
+ */
+static inline void nap_answer(void) {
+    uint8_t reply[512];
+    uint32_t fresh = mock_hal_get_tx_count() - s_tx_seen;
+    s_tx_seen += fresh;
+    if (fresh > 5) fresh = 5;
+
+    for (int i = (int)fresh - 1; i >= 0; i--) {
+        const uint8_t* tx = mock_hal_get_tx_history_data(i);
+        uint16_t tx_len = mock_hal_get_tx_history_len(i);
+        uint32_t xid = 0;
+        bool discover;
+        int n;
+        if (tx == NULL || tx_len == 0) continue;
+
+        if (dhcp_sim_is_discover(tx, tx_len, &xid, NULL)) {
+            discover = true;
+        } else if (dhcp_sim_is_request(tx, tx_len, &xid)) {
+            discover = false;
+        } else {
+            if (s_nap_frame_hook != NULL) s_nap_frame_hook(tx, tx_len);
+            continue;
+        }
+
+        if (s_nap_dhcp_hook != NULL && !s_nap_dhcp_hook(tx, tx_len, discover, xid)) continue;
+        if (!dhcp_sim_deliver()) continue;
+        n = discover ? dhcp_sim_build_offer(reply, sizeof(reply), &s_sim, xid, s_client_mac)
+                     : dhcp_sim_build_ack(reply, sizeof(reply), &s_sim, xid, s_client_mac);
+        if (dhcp_sim_deliver()) nap_inject_dhcp(reply, n);
+    }
+}
+
+/**
+ * Let the NAP answer, then advance mock time by one step
+ */
+static inline void nap_step(void) {
+    nap_answer();
+    step(NAP_STEP_MS);
+}
+
+/**
+ * Run the stack until the frames queued so far are on the link
+ */
+static inline void settle(void) {
+    for (int i = 0; i < NAP_SETTLE_STEPS; i++) {
+        step(NAP_STEP_MS);
+    }
+    s_tx_seen = mock_hal_get_tx_count();
+}
+
+/**
+ * Start the stack against the NAP and answer the handshake; DHCP is next
+ * @param sim network the NAP hands out, or NULL for dhcp_sim's default
+ * @return 0 on success, -1 on failure (the stack is de-initialized)
+ */
+static inline int nap_connect(const dhcp_sim_config_t* sim) {
+    tinypan_config_t config;
+    if (sim != NULL) {
+        s_sim = *sim;
+    } else {
+        dhcp_sim_get_default_config(&s_sim);
+    }
+    tinypan_config_init(&config);
+    memcpy(config.remote_addr, s_sim.server_mac, 6);
+    if (!start_stack(&config, NULL)) {
+        tinypan_deinit();
+        return -1;
+    }
+
+    /* nap_answer() picks the DHCP DISCOVER out of the handshake frames */
+    s_tx_seen = mock_hal_get_tx_count();
+    answer_handshake();
+    return 0;
+}
+
+/**
+ * Let the NAP answer until the stack is online
+ * @return Milliseconds it took, or -1 after NAP_ONLINE_TIMEOUT_MS
+ */
+static inline int nap_await_online(void) {
+    uint32_t start = hal_get_tick_ms();
+    while (!tinypan_is_online()) {
+        if (hal_get_tick_ms() - start > NAP_ONLINE_TIMEOUT_MS) return -1;
+        nap_step();
+    }
+    return (int)(hal_get_tick_ms() - start);
+}
+
+/**
+ * Bring the stack online through the NAP and drain the bring-up frames
+ * @param sim network the NAP hands out, or NULL for dhcp_sim's default
+ * @return 0 on success, -1 on failure (the stack is de-initialized)
+ */
+static inline int bring_online_with(const dhcp_sim_config_t* sim) {
+    if (nap_connect(sim) < 0) return -1;
+    if (nap_await_online() < 0) {
+        tinypan_deinit();
+        return -1;
+    }
+    settle();
+    return 0;
+}
+
+static inline int bring_online(void) {
+    return bring_online_with(NULL);
+}
+#endif /* TINYPAN_DHCP_SIM_H */
+
+#endif /* TEST_COMMON_H */
@@ -0,0 +1,323 @@
+/*
+ * TinyPAN Test - DHCP Lease Cache
+ *
+ * Unit tests for the per-NAP lease table, then a full-stack timing run
+ * against the simulated NAP DHCP server: time-to-online for a cold start,
+ * a reconnect with a valid lease, a reboot (INIT-REBOOT from storage) and
+ * a NAP that ignores INIT-REBOOT.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "../src/tinypan_dhcp_cache.h"
+#include "dhcp_sim.h"
+#include "test_common.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+static const uint8_t s_nap_a[6] = { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+static const uint8_t s_nap_b[6] = { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0x01 };
+static const uint8_t s_nap_c[6] = { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0x02 };
+
+static dhcp_cache_lease_t make_lease(const uint8_t peer[6], uint32_t ip, uint32_t lease_s) {
+    dhcp_cache_lease_t lease;
+    memset(&lease, 0, sizeof(lease));
+    memcpy(lease.peer, peer, 6);
+    lease.ip_addr = ip;
+    lease.netmask = 0x00FFFFFF;
+    lease.gateway = 0x012CA8C0;
+    lease.server_id = 0x012CA8C0;
+    lease.lease_s = lease_s;
+    lease.bound_ms = hal_get_tick_ms();
+    lease.timed = true;
+    return lease;
+}
+
+static void reset_cache(void) {
+    hal_bt_init();
+    mock_hal_storage_erase();
+    dhcp_cache_init();
+}
+
+/* ============================================================================
+ * Cache Unit Tests
+ * ============================================================================ */
+
+static int test_store_and_lookup(void) {
+    reset_cache();
+    dhcp_cache_lease_t lease = make_lease(s_nap_a, 0x022CA8C0, 3600);
+    dhcp_cache_lease_t out;
+
+    if (dhcp_cache_lookup(s_nap_a, &out) != DHCP_CACHE_MISS) return 0;
+    dhcp_cache_store(&lease);
+    if (dhcp_cache_lookup(s_nap_a, &out) != DHCP_CACHE_VALID) return 0;
+    if (out.ip_addr != lease.ip_addr || out.server_id != lease.server_id) return 0;
+    return dhcp_cache_lookup(s_nap_b, NULL) == DHCP_CACHE_MISS;
+}
+
+static int test_lru_eviction(void) {
+    reset_cache();
+    dhcp_cache_lease_t a = make_lease(s_nap_a, 0x022CA8C0, 3600);
+    dhcp_cache_lease_t b = make_lease(s_nap_b, 0x032CA8C0, 3600);
+    dhcp_cache_lease_t c = make_lease(s_nap_c, 0x042CA8C0, 3600);
+
+    dhcp_cache_store(&a);
+    dhcp_cache_store(&b);
+    dhcp_cache_store(&a);           /* Renewal: A becomes the newest */
+    dhcp_cache_store(&c);           /* Evicts B */
+
+#if TINYPAN_DHCP_CACHE_ENTRIES == 2
+    if (dhcp_cache_lookup(s_nap_b, NULL) != DHCP_CACHE_MISS) return 0;
+#endif
+    return dhcp_cache_lookup(s_nap_a, NULL) == DHCP_CACHE_VALID &&
+           dhcp_cache_lookup(s_nap_c, NULL) == DHCP_CACHE_VALID;
+}
+
+static int test_expiry(void) {
+    reset_cache();
+    dhcp_cache_lease_t lease = make_lease(s_nap_a, 0x022CA8C0, 600);
+    dhcp_cache_store(&lease);
+
+    /* Less than TINYPAN_DHCP_CACHE_MIN_REMAINING_S left: confirm first */
+    mock_hal_advance_tick_ms((600 - TINYPAN_DHCP_CACHE_MIN_REMAINING_S / 2) * 1000UL);
+    if (dhcp_cache_lookup(s_nap_a, NULL) != DHCP_CACHE_REBOOT) return 0;
+
+    /* Expired: must not be used at all (RFC 2131 4.3.2) */
+    mock_hal_advance_tick_ms(TINYPAN_DHCP_CACHE_MIN_REMAINING_S * 1000UL);
+    return dhcp_cache_lookup(s_nap_a, NULL) == DHCP_CACHE_MISS;
+}
+
+static int test_infinite_lease(void) {
+    reset_cache();
+    dhcp_cache_lease_t lease = make_lease(s_nap_a, 0x022CA8C0, 0xFFFFFFFFUL);
+    dhcp_cache_store(&lease);
+    mock_hal_advance_tick_ms(0x7FFFFFFFUL);
+    return dhcp_cache_lookup(s_nap_a, NULL) == DHCP_CACHE_VALID;
+}
+
+static int test_invalidate(void) {
+    reset_cache();
+    dhcp_cache_lease_t a = make_lease(s_nap_a, 0x022CA8C0, 3600);
+    dhcp_cache_lease_t b = make_lease(s_nap_b, 0x032CA8C0, 3600);
+    dhcp_cache_store(&a);
+    dhcp_cache_store(&b);
+    dhcp_cache_invalidate(s_nap_a);
+    return dhcp_cache_lookup(s_nap_a, NULL) == DHCP_CACHE_MISS &&
+           dhcp_cache_lookup(s_nap_b, NULL) == DHCP_CACHE_VALID;
+}
+
+static int test_persistence(void) {
+    reset_cache();
+    dhcp_cache_lease_t a = make_lease(s_nap_a, 0x022CA8C0, 3600);
+    dhcp_cache_lease_t b = make_lease(s_nap_b, 0x032CA8C0, 7200);
+    dhcp_cache_store(&a);
+    dhcp_cache_store(&b);
+    if (mock_hal_storage_get_writes() != 2) return 0;
+
+    /* Renewing an unchanged lease must not touch flash */
+    mock_hal_advance_tick_ms(1000);
+    a.bound_ms = hal_get_tick_ms();
+    dhcp_cache_store(&a);
+    if (mock_hal_storage_get_writes() != 2) return 0;
+
+    /* "Reboot": the tick restarts and the table is reloaded */
+    hal_bt_init();
+    dhcp_cache_init();
+
+    dhcp_cache_lease_t out;
+    if (dhcp_cache_lookup(s_nap_a, &out) != DHCP_CACHE_REBOOT) return 0;
+    if (out.ip_addr != a.ip_addr || out.netmask != a.netmask ||
+        out.gateway != a.gateway || out.server_id != a.server_id || out.lease_s != 3600) return 0;
+    if (dhcp_cache_lookup(s_nap_b, &out) != DHCP_CACHE_REBOOT || out.ip_addr != b.ip_addr) return 0;
+
+    /* Once confirmed, the lease is timed again */
+    a.bound_ms = hal_get_tick_ms();
+    dhcp_cache_store(&a);
+    return dhcp_cache_lookup(s_nap_a, NULL) == DHCP_CACHE_VALID;
+}
+
+static int test_corrupt_storage_ignored(void) {
+    reset_cache();
+    uint8_t junk[DHCP_CACHE_BLOB_LEN];
+    memset(junk, 0x5A, sizeof(junk));
+    hal_storage_save(junk, sizeof(junk));
+    dhcp_cache_init();
+    return dhcp_cache_lookup(s_nap_a, NULL) == DHCP_CACHE_MISS;
+}
+
+/* ============================================================================
+ * Full-Stack Timing
+ * ============================================================================ */
+
+static bool s_answer_reboot = true;     /* Does the NAP answer INIT-REBOOT? */
+static uint32_t s_offered_xid;
+static bool s_offered;
+static uint32_t s_acked_xid;
+static bool s_acked;
+static int s_discovers;
+static int s_requests;
+
+/** Count each new DISCOVER/REQUEST once; INIT-REBOOT goes unanswered on request */
+static bool nap_dhcp_hook(const uint8_t* tx, uint16_t tx_len, bool discover, uint32_t xid) {
+    (void)tx;
+    (void)tx_len;
+    if (discover) {
+        if (s_offered && xid == s_offered_xid) return false;
+        s_offered = true;
+        s_offered_xid = xid;
+        s_discovers++;
+        return true;
+    }
+    if (s_acked && xid == s_acked_xid) return false;
+    s_acked = true;
+    s_acked_xid = xid;
+    s_requests++;
+    /* A REQUEST without a preceding OFFER is INIT-REBOOT */
+    bool reboot = !(s_offered && xid == s_offered_xid);
+    return !reboot || s_answer_reboot;
+}
+
+static void pump(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += NAP_STEP_MS) {
+        nap_step();
+    }
+}
+
+/**
+ * @brief Answer the next connect attempt and run DHCP until ONLINE
+ * @return Milliseconds from DHCP start (filter response) to ONLINE, or -1
+ */
+static int bring_up(void) {
+    s_offered = false;
+    s_acked = false;
+    s_discovers = 0;
+    s_requests = 0;
+
+    for (uint32_t t = 0; tinypan_get_state() != TINYPAN_STATE_CONNECTING; t += NAP_STEP_MS) {
+        if (t > NAP_ONLINE_TIMEOUT_MS) return -1;
+        nap_step();
+    }
+    answer_handshake();
+    return nap_await_online();
+}
+
+static int stack_start(void) {
+    tinypan_config_t config;
+    tinypan_config_init(&config);
+    memcpy(config.remote_addr, s_sim.server_mac, 6);
+    return start_stack(&config, NULL) ? 0 : -1;
+}
+
+static int test_time_to_online(void) {
+    dhcp_sim_get_default_config(&s_sim);
+    s_nap_dhcp_hook = nap_dhcp_hook;
+    hal_bt_init();
+    mock_hal_storage_erase();
+    s_answer_reboot = true;
+
+    /* 1. Cold start: full DISCOVER/OFFER/REQUEST/ACK */
+    if (stack_start() < 0) return 0;
+    int cold = bring_up();
+    int cold_msgs = s_discovers + s_requests;
+    if (cold < 0 || s_discovers == 0) goto fail;
+
+    /* 2. Link loss and reconnect while the lease is valid: address reused at once */
+    pump(1000);
+    mock_hal_simulate_disconnect();
+    int cached = bring_up();
+    pump(1000);                     /* Background INIT-REBOOT confirmation */
+    int cached_msgs = s_discovers + s_requests;
+    if (cached < 0 || s_discovers != 0 || s_requests != 1) goto fail;
+
+    /* 3. Reboot: the lease comes back from storage and is confirmed first */
+    tinypan_deinit();
+    if (stack_start() < 0) return 0;
+    int reboot = bring_up();
+    int reboot_msgs = s_discovers + s_requests;
+    tinypan_deinit();
+    if (reboot < 0 || s_discovers != 0) return 0;
+
+    printf("\n");
+    printf("    %-28s %10s %10s\n", "Scenario", "online ms", "DHCP msgs");
+    printf("    %-28s %10d %10d\n", "cold start (DISCOVER)", cold, cold_msgs);
+    printf("    %-28s %10d %10d\n", "reconnect, lease valid", cached, cached_msgs);
+    printf("    %-28s %10d %10d\n", "reboot (INIT-REBOOT)", reboot, reboot_msgs);
+    printf("    flash writes: %u\n    ", (unsigned)mock_hal_storage_get_writes());
+
+    /* Same NAP, same address: the blob was written once */
+    return cached < cold && reboot < cold && mock_hal_storage_get_writes() == 1;
+
+fail:
+    tinypan_deinit();
+    return 0;
+}
+
+static int test_silent_nap_falls_back(void) {
+    /* The lease from the previous test is in storage; this NAP ignores INIT-REBOOT */
+    uint32_t writes = mock_hal_storage_get_writes();
+    s_answer_reboot = false;
+    if (stack_start() < 0) return 0;
+    int t = bring_up();
+    tinypan_deinit();
+    s_answer_reboot = true;
+
+    /* Fell back to discovery: the unconfirmed entry was dropped, then replaced */
+    if (t < 0 || s_discovers == 0) return 0;
+    if (mock_hal_storage_get_writes() < writes + 2) return 0;
+    hal_bt_init();
+    dhcp_cache_init();
+    dhcp_cache_lease_t out;
+    return dhcp_cache_lookup(s_sim.server_mac, &out) == DHCP_CACHE_REBOOT &&
+           out.ip_addr == s_sim.client_ip;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN DHCP Lease Cache Tests\n");
+    printf("==============================\n\n");
+
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(store_and_lookup);
+    TEST(lru_eviction);
+    TEST(expiry);
+    TEST(infinite_lease);
+    TEST(invalidate);
+    TEST(persistence);
+    TEST(corrupt_storage_ignored);
+    TEST(time_to_online);
+    TEST(silent_nap_falls_back);
+
+    printf("\n==============================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+/*
+ * TinyPAN Test - PAN DHCP Retransmission Profile
+ *
+ * Full-stack runs against the simulated NAP DHCP server with DHCP messages
+ * lost on the link: recovery time for each loss pattern, the retransmission
+ * schedule against a silent NAP, and the escalation to an L2CAP reconnect.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+#include "test_common.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define ONLINE_TIMEOUT_MS   30000
+
+/** Time the link is given to tear itself down when DHCP never succeeds */
+#define DHCP_BUDGET_MS      ((uint32_t)TINYPAN_DHCP_TIMEOUT_MS * TINYPAN_DHCP_MAX_RETRIES)
+
+#define MAX_DISCOVERS       16
+
+static bool s_silent;                   /* NAP never answers */
+static uint32_t s_dhcp_start;
+static int s_discovers;
+static int s_requests;
+static uint32_t s_discover_at[MAX_DISCOVERS];
+
+/** Count and time the client's messages; a silent NAP answers none */
+static bool nap_dhcp_hook(const uint8_t* tx, uint16_t tx_len, bool discover, uint32_t xid) {
+    (void)tx;
+    (void)tx_len;
+    (void)xid;
+    if (discover) {
+        if (s_discovers < MAX_DISCOVERS) {
+            s_discover_at[s_discovers] = hal_get_tick_ms() - s_dhcp_start;
+        }
+        s_discovers++;
+    } else {
+        s_requests++;
+    }
+    return !s_silent;
+}
+
+/**
+ * @brief Start the stack and bring it up to the DHCP phase
+ * @return 0 on success, -1 on failure (the stack is de-initialized)
+ */
+static int start_to_dhcp(bool silent, const dhcp_sim_loss_t* loss) {
+    s_silent = silent;
+    s_discovers = 0;
+    s_requests = 0;
+    s_nap_dhcp_hook = nap_dhcp_hook;
+    dhcp_sim_set_loss(loss);
+
+    if (nap_connect(NULL) < 0) return -1;
+    s_dhcp_start = hal_get_tick_ms();
+    if (tinypan_get_state() != TINYPAN_STATE_DHCP) {
+        tinypan_deinit();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Run DHCP through the given loss model
+ * @return Milliseconds from DHCP start to ONLINE, or -1
+ */
+static int time_to_online(const dhcp_sim_loss_t* loss) {
+    if (start_to_dhcp(false, loss) < 0) return -1;
+    while (!tinypan_is_online()) {
+        if (hal_get_tick_ms() - s_dhcp_start > ONLINE_TIMEOUT_MS) {
+            tinypan_deinit();
+            return -1;
+        }
+        nap_step();
+    }
+    int ms = (int)(hal_get_tick_ms() - s_dhcp_start);
+    tinypan_deinit();
+    return ms;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Recovery time for single and repeated losses stays in the hundreds of ms
+ */
+static int test_recovery_time(void) {
+    static const struct {
+        const char* name;
+        dhcp_sim_loss_t loss;
+        uint32_t limit_ms;
+    } cases[] = {
+        /* Message order: DISCOVER, OFFER, REQUEST, ACK */
+        { "no loss",           { 0x0, 0, 0 },  TINYPAN_DHCP_RETX_INITIAL_MS },
+        { "DISCOVER lost",     { 0x1, 0, 0 },  2 * TINYPAN_DHCP_RETX_INITIAL_MS },
+        { "OFFER lost",        { 0x2, 0, 0 },  2 * TINYPAN_DHCP_RETX_INITIAL_MS },
+        { "REQUEST lost",      { 0x4, 0, 0 },  2 * TINYPAN_DHCP_RETX_INITIAL_MS },
+        { "ACK lost",          { 0x8, 0, 0 },  2 * TINYPAN_DHCP_RETX_INITIAL_MS },
+        { "3 DISCOVERs lost",  { 0x7, 0, 0 },  8 * TINYPAN_DHCP_RETX_INITIAL_MS },
+        { "25% random loss",   { 0x0, 25, 7 }, DHCP_BUDGET_MS },
+    };
+    int ok = 1;
+
+    printf("\n");
+    printf("    %-20s %10s %6s %6s %6s\n", "Loss pattern", "online ms", "lost", "DISC", "REQ");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int ms = time_to_online(&cases[i].loss);
+        printf("    %-20s %10d %6u %6d %6d\n", cases[i].name, ms,
+               (unsigned)dhcp_sim_get_lost(), s_discovers, s_requests);
+        if (ms < 0 || (uint32_t)ms > cases[i].limit_ms) {
+            ok = 0;
+        }
+    }
+    printf("    ");
+    return ok;
+}
+
+/**
+ * Against a silent NAP, DISCOVERs go out on the PAN schedule:
+ * initial delay, then doubling up to the cap
+ */
+static int test_retransmit_schedule(void) {
+    if (start_to_dhcp(true, NULL) < 0) return 0;
+    while (hal_get_tick_ms() - s_dhcp_start < TINYPAN_DHCP_TIMEOUT_MS - NAP_STEP_MS) {
+        nap_step();
+    }
+    tinypan_deinit();
+
+    if (s_discovers < 4) {
+        printf("\n    Only %d DISCOVERs in %u ms\n", s_discovers, (unsigned)TINYPAN_DHCP_TIMEOUT_MS);
+        return 0;
+    }
+
+    uint32_t expect = TINYPAN_DHCP_RETX_INITIAL_MS;
+    for (int i = 1; i < s_discovers && i < MAX_DISCOVERS; i++) {
+        uint32_t gap = s_discover_at[i] - s_discover_at[i - 1];
+        if (gap + NAP_STEP_MS < expect || gap > expect + 2 * NAP_STEP_MS) {
+            printf("\n    DISCOVER %d after %u ms, expected %u ms\n", i, (unsigned)gap, (unsigned)expect);
+            return 0;
+        }
+        expect *= 2;
+        if (expect > TINYPAN_DHCP_RETX_MAX_MS) expect = TINYPAN_DHCP_RETX_MAX_MS;
+    }
+    return 1;
+}
+
+/**
+ * A NAP that never answers costs TINYPAN_DHCP_TIMEOUT_MS per attempt, then
+ * the L2CAP link is torn down
+ */
+static int test_silent_nap_escalates(void) {
+    if (start_to_dhcp(true, NULL) < 0) return 0;
+    while (tinypan_get_state() == TINYPAN_STATE_DHCP) {
+        if (hal_get_tick_ms() - s_dhcp_start > 2 * DHCP_BUDGET_MS) break;
+        nap_step();
+    }
+    uint32_t elapsed = hal_get_tick_ms() - s_dhcp_start;
+    tinypan_state_t state = tinypan_get_state();
+    bool connected = mock_hal_is_connected();
+    tinypan_deinit();
+
+    printf("\n    Link torn down after %u ms (%d DISCOVERs)\n    ", (unsigned)elapsed, s_discovers);
+    return state == TINYPAN_STATE_RECONNECTING && !connected &&
+           elapsed >= DHCP_BUDGET_MS && elapsed <= DHCP_BUDGET_MS + 2 * NAP_STEP_MS;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN DHCP Retransmission Tests\n");
+    printf("=================================\n\n");
+
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(recovery_time);
+    TEST(retransmit_schedule);
+    TEST(silent_nap_escalates);
+
+    printf("\n=================================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
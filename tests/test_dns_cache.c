@@ -0,0 +1,381 @@
+/*
+ * TinyPAN Test - DNS Server Capture and Resolver Cache
+ *
+ * Full-stack runs against the simulated NAP: the DNS server comes from the
+ * DHCP ACK, then tinypan_dns_resolve() is exercised against the simulated
+ * DNS responder for hits, TTL expiry, negative caching, background prefetch,
+ * retransmission and source port randomization, counting the queries that
+ * reach the link.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+#include "test_common.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+/** DNS server handed out by the simulated NAP: 10.20.30.40, reached through the gateway */
+#define SIM_DNS_IP          0x0A141E28
+
+static bool s_discover_asks_dns;
+static dhcp_sim_dns_query_t s_last_query;     /* Last query seen on the link */
+
+/* --- Simulated zone --- */
+
+typedef struct {
+    const char* name;
+    dhcp_sim_dns_answer_t answer;
+    bool silent;                /* Never answered */
+    int queries;                /* Queries seen on the link */
+} zone_entry_t;
+
+static zone_entry_t s_zone[] = {
+    { "sensor.example.com",  { DNS_RCODE_NOERROR,  0x0A000007, 300, 0, 0 },     false, 0 },
+    { "short.example.com",   { DNS_RCODE_NOERROR,  0x0A000008, 5, 0, 0 },       false, 0 },
+    { "missing.example.com", { DNS_RCODE_NXDOMAIN, 0, 0, 900, 30 },             false, 0 },
+    { "busy.example.com",    { DNS_RCODE_NOERROR,  0x0A000009, 20, 0, 0 },      false, 0 },
+    { "silent.example.com",  { DNS_RCODE_NOERROR,  0x0A00000A, 60, 0, 0 },      true,  0 },
+    { "api.example.com",     { DNS_RCODE_NOERROR,  0x0A00000B, 300, 0, 0 },     false, 0 },
+    { "time.example.com",    { DNS_RCODE_NOERROR,  0x0A00000C, 300, 0, 0 },     false, 0 },
+};
+
+#define ZONE_SIZE ((int)(sizeof(s_zone) / sizeof(s_zone[0])))
+
+static zone_entry_t* zone_find(const char* name) {
+    for (int i = 0; i < ZONE_SIZE; i++) {
+        if (strcmp(s_zone[i].name, name) == 0) {
+            return &s_zone[i];
+        }
+    }
+    return NULL;
+}
+
+/* --- Lookup results --- */
+
+static int s_callbacks;
+static tinypan_error_t s_last_result;
+static uint32_t s_last_addr;
+
+static void on_resolved(const char* hostname, tinypan_error_t result, uint32_t ip_addr,
+                        void* user_data) {
+    (void)hostname;
+    (void)user_data;
+    s_callbacks++;
+    s_last_result = result;
+    s_last_addr = ip_addr;
+}
+
+/** Host-order address as tinypan returns it (network byte order) */
+static uint32_t net_addr(uint32_t host) {
+    uint32_t net;
+    uint8_t* b = (uint8_t*)&net;
+    b[0] = (uint8_t)(host >> 24);
+    b[1] = (uint8_t)(host >> 16);
+    b[2] = (uint8_t)(host >> 8);
+    b[3] = (uint8_t)host;
+    return net;
+}
+
+/** Note whether the DISCOVER asks for option 6; every DISCOVER/REQUEST is answered */
+static bool nap_dhcp_hook(const uint8_t* tx, uint16_t tx_len, bool discover, uint32_t xid) {
+    (void)xid;
+    if (discover) {
+        s_discover_asks_dns = dhcp_sim_requests_option(tx, tx_len, DHCP_OPTION_DNS);
+    }
+    return true;
+}
+
+/** Answer DNS queries sent to SIM_DNS_IP from the zone */
+static void nap_dns_answer(const uint8_t* tx, uint16_t tx_len) {
+    uint8_t pkt[1024];
+    dhcp_sim_dns_query_t query;
+    if (!dhcp_sim_is_dns_query(tx, tx_len, &query)) return;
+
+    zone_entry_t* z = zone_find(query.name);
+    if (z == NULL || query.server_ip != SIM_DNS_IP) return;
+    z->queries++;
+    s_last_query = query;
+    if (z->silent) return;
+    nap_inject(pkt, dhcp_sim_build_dns_response(pkt, sizeof(pkt), &s_sim, &query,
+                                                &z->answer, s_client_mac));
+}
+
+static void pump(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += NAP_STEP_MS) {
+        nap_step();
+    }
+}
+
+/** Resolve and, if the answer is not immediate, wait for the callback */
+static tinypan_error_t resolve_wait(const char* name, uint32_t* addr) {
+    int before = s_callbacks;
+    tinypan_error_t err = tinypan_dns_resolve(name, addr, on_resolved, NULL);
+    if (err != TINYPAN_ERR_IN_PROGRESS) {
+        return err;
+    }
+    for (uint32_t t = 0; s_callbacks == before; t += NAP_STEP_MS) {
+        if (t > 60000) return TINYPAN_ERR_IN_PROGRESS;
+        pump(NAP_STEP_MS);
+    }
+    *addr = s_last_addr;
+    return s_last_result;
+}
+
+/**
+ * @brief Bring the stack online against a NAP that hands out SIM_DNS_IP
+ * @return 0 on success, -1 on failure (the stack is de-initialized)
+ */
+static int bring_online_dns(void) {
+    dhcp_sim_config_t sim;
+    dhcp_sim_get_default_config(&sim);
+    sim.dns_ip = SIM_DNS_IP;
+    s_nap_dhcp_hook = nap_dhcp_hook;
+    s_nap_frame_hook = nap_dns_answer;
+    return bring_online_with(&sim);
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * The DISCOVER asks for option 6 and the server from the ACK is exposed
+ */
+static int test_dns_server_from_dhcp(void) {
+    if (bring_online_dns() < 0) return 0;
+
+    tinypan_ip_info_t info;
+    if (tinypan_get_ip_info(&info) != TINYPAN_OK) return 0;
+    const uint8_t* d = (const uint8_t*)&info.dns_server;
+    printf("\n    DNS server %u.%u.%u.%u, requested in DISCOVER: %s\n    ",
+           d[0], d[1], d[2], d[3], s_discover_asks_dns ? "yes" : "no");
+    return info.dns_server == net_addr(SIM_DNS_IP) && s_discover_asks_dns;
+}
+
+/**
+ * Dotted-quad names complete at once without a query
+ */
+static int test_literal_needs_no_query(void) {
+    uint32_t addr = 0;
+    tinypan_dns_stats_t stats;
+    if (tinypan_dns_resolve("192.168.44.9", &addr, on_resolved, NULL) != TINYPAN_OK) return 0;
+    tinypan_get_dns_stats(&stats);
+    return addr == net_addr(0xC0A82C09) && stats.queries_sent == 0 && stats.misses == 0;
+}
+
+/**
+ * First lookup waits for the server, the next ones are answered from the cache
+ */
+static int test_miss_then_hit(void) {
+    zone_entry_t* z = zone_find("sensor.example.com");
+    uint32_t addr = 0;
+
+    if (resolve_wait("sensor.example.com", &addr) != TINYPAN_OK) return 0;
+    if (addr != net_addr(z->answer.addr) || z->queries != 1) return 0;
+
+    for (int i = 0; i < 10; i++) {
+        addr = 0;
+        if (tinypan_dns_resolve("Sensor.Example.COM", &addr, on_resolved, NULL) != TINYPAN_OK) {
+            return 0;
+        }
+        pump(1000);
+    }
+    return addr == net_addr(z->answer.addr) && z->queries == 1;
+}
+
+/**
+ * The answer is dropped once its TTL runs out
+ */
+static int test_ttl_expiry(void) {
+    zone_entry_t* z = zone_find("short.example.com");
+    uint32_t addr = 0;
+
+    if (resolve_wait("short.example.com", &addr) != TINYPAN_OK || z->queries != 1) return 0;
+    pump((z->answer.ttl + 1) * 1000);   /* Not looked up meanwhile: no prefetch */
+    if (z->queries != 1) return 0;
+
+    tinypan_error_t err = tinypan_dns_resolve("short.example.com", &addr, on_resolved, NULL);
+    pump(100);
+    return err == TINYPAN_ERR_IN_PROGRESS && z->queries == 2 && s_last_result == TINYPAN_OK;
+}
+
+/**
+ * NXDOMAIN is remembered for min(SOA TTL, SOA MINIMUM), then asked again
+ */
+static int test_negative_caching(void) {
+    zone_entry_t* z = zone_find("missing.example.com");
+    tinypan_dns_stats_t before, after;
+    uint32_t addr = 0;
+
+    if (resolve_wait("missing.example.com", &addr) != TINYPAN_ERR_NOT_FOUND) return 0;
+    tinypan_get_dns_stats(&before);
+    for (int i = 0; i < 5; i++) {
+        if (tinypan_dns_resolve("missing.example.com", &addr, on_resolved, NULL) != TINYPAN_ERR_NOT_FOUND) {
+            return 0;
+        }
+    }
+    tinypan_get_dns_stats(&after);
+    if (z->queries != 1 || after.negative_hits != before.negative_hits + 5) return 0;
+
+    pump(z->answer.soa_minimum * 1000);
+    return tinypan_dns_resolve("missing.example.com", &addr, on_resolved, NULL) == TINYPAN_ERR_IN_PROGRESS;
+}
+
+/**
+ * A name in use is refreshed shortly before it expires and never misses
+ */
+static int test_prefetch_before_expiry(void) {
+    zone_entry_t* z = zone_find("busy.example.com");
+    tinypan_dns_stats_t before, after;
+    uint32_t addr = 0;
+
+    if (resolve_wait("busy.example.com", &addr) != TINYPAN_OK) return 0;
+    tinypan_get_dns_stats(&before);
+
+    /* Looked up every second for four TTLs; the address changes after the first */
+    for (uint32_t s = 0; s < 4 * z->answer.ttl; s++) {
+        if (s == z->answer.ttl / 2) z->answer.addr = 0x0A000019;
+        if (tinypan_dns_resolve("busy.example.com", &addr, on_resolved, NULL) != TINYPAN_OK) {
+            printf("\n    miss after %u s\n    ", (unsigned)s);
+            return 0;
+        }
+        pump(1000);
+    }
+    tinypan_get_dns_stats(&after);
+    printf("\n    %u lookups, %d queries, %u prefetches\n    ",
+           (unsigned)(4 * z->answer.ttl), z->queries, (unsigned)(after.prefetches - before.prefetches));
+    return addr == net_addr(0x0A000019) && after.misses == before.misses &&
+           after.prefetches - before.prefetches >= 3 && z->queries == 1 + (int)(after.prefetches - before.prefetches);
+}
+
+/**
+ * An unanswered query is resent TINYPAN_DNS_RETRIES times, then fails
+ */
+static int test_timeout_after_retries(void) {
+    zone_entry_t* z = zone_find("silent.example.com");
+    tinypan_dns_stats_t before, after;
+    uint32_t addr = 0;
+
+    tinypan_get_dns_stats(&before);
+    if (resolve_wait("silent.example.com", &addr) != TINYPAN_ERR_TIMEOUT) return 0;
+    tinypan_get_dns_stats(&after);
+    return z->queries == 1 + TINYPAN_DNS_RETRIES && after.timeouts == before.timeouts + 1;
+}
+
+/**
+ * Each query leaves from a fresh ephemeral port and answers to any other are dropped
+ */
+static int test_fresh_port_per_query(void) {
+    zone_entry_t* z = zone_find("silent.example.com");
+    uint8_t pkt[1024];
+    uint32_t addr = 0;
+
+    pump(6000);     /* short.example.com has expired */
+    if (resolve_wait("short.example.com", &addr) != TINYPAN_OK) return 0;
+    uint16_t first = s_last_query.client_port;
+    pump(6000);
+    if (resolve_wait("short.example.com", &addr) != TINYPAN_OK) return 0;
+    uint16_t second = s_last_query.client_port;
+    printf("\n    source ports %u, %u\n    ", first, second);
+    if (first == second || first < 0xC000 || second < 0xC000) return 0;
+
+    /* Right ID and question, wrong port: must not complete the lookup */
+    int before = s_callbacks;
+    if (tinypan_dns_resolve("silent.example.com", &addr, on_resolved, NULL) != TINYPAN_ERR_IN_PROGRESS) {
+        return 0;
+    }
+    pump(NAP_STEP_MS);
+    dhcp_sim_dns_query_t spoof = s_last_query;
+    spoof.client_port = (spoof.client_port == first) ? second : first;
+    nap_inject(pkt, dhcp_sim_build_dns_response(pkt, sizeof(pkt), &s_sim, &spoof,
+                                                &z->answer, s_client_mac));
+    pump(NAP_STEP_MS);
+    if (s_callbacks != before) return 0;
+
+    nap_inject(pkt, dhcp_sim_build_dns_response(pkt, sizeof(pkt), &s_sim, &s_last_query,
+                                                &z->answer, s_client_mac));
+    pump(NAP_STEP_MS);
+    return s_callbacks == before + 1 && s_last_result == TINYPAN_OK &&
+           s_last_addr == net_addr(z->answer.addr);
+}
+
+/**
+ * Airtime: an app looking up the same names over and over
+ */
+static int test_repeated_lookups(void) {
+    static const char* names[] = { "api.example.com", "time.example.com", "sensor.example.com" };
+    tinypan_dns_stats_t before, after;
+    int lookups = 0;
+
+    tinypan_get_dns_stats(&before);
+    for (int round = 0; round < 60; round++) {
+        for (int i = 0; i < 3; i++) {
+            uint32_t addr;
+            if (resolve_wait(names[i], &addr) != TINYPAN_OK) return 0;
+            lookups++;
+        }
+        pump(2000);
+    }
+    tinypan_get_dns_stats(&after);
+
+    uint32_t queries = after.queries_sent - before.queries_sent;
+    printf("\n    %d lookups in %d s: %u queries sent (%u without the cache), %u hits\n    ",
+           lookups, 60 * 2, (unsigned)queries, (unsigned)lookups,
+           (unsigned)(after.hits - before.hits));
+    return queries <= 3;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN DNS Cache Tests\n");
+    printf("=======================\n\n");
+
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(dns_server_from_dhcp);
+    TEST(literal_needs_no_query);
+    TEST(miss_then_hit);
+    TEST(ttl_expiry);
+    TEST(negative_caching);
+    TEST(prefetch_before_expiry);
+    TEST(timeout_after_retries);
+    TEST(fresh_port_per_query);
+    TEST(repeated_lookups);
+
+    tinypan_deinit();
+
+    printf("\n=======================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,466 @@
+/*
+ * TinyPAN Test - Per-Flow Fair Queueing
+ *
+ * Checks flow classification and the deficit round robin scheduler, then
+ * runs the SLIP transport against the mock HAL's connection-event model
+ * with one bulk UDP flow that keeps its share of the TX queue full and a
+ * few sparse flows sending a small datagram now and then. The sparse flows
+ * must never be refused and must wait for at most the bulk frame being
+ * encoded plus what is already buffered below the scheduler, instead of
+ * for every bulk frame queued ahead of them. A bulk frame refused for its
+ * flow's share raises the watermark callback like a full queue does.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_transport.h"
+#include "../src/tinypan_fq.h"
+
+#include "lwip/init.h"
+#include "lwip/pbuf.h"
+#include "lwip/netif.h"
+
+extern const uint8_t* mock_hal_get_tx_history_data(int index_from_newest);
+extern uint16_t mock_hal_get_tx_history_len(int index_from_newest);
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define WIRE_MAX        8192
+
+/* Link: 2 chunks every 15 ms, 4 controller buffers */
+#define CE_INTERVAL_MS  15
+#define CE_PER_EVENT    2
+#define CE_BUFFERS      4
+
+#define BULK_LEN        1000
+#define SPARSE_LEN      100
+#define SPARSE_FLOWS    3
+#define SPARSE_PERIOD_MS 170
+#define RUN_MS          10000
+
+/* Chunks a frame of len bytes occupies (END + payload + END, no escapes) */
+#define CHUNKS(len)     (((len) + 2 + TINYPAN_SLIP_CHUNK_SIZE - 1) / TINYPAN_SLIP_CHUNK_SIZE)
+
+/*
+ * Worst wait of a sparse frame with the scheduler: controller buffers,
+ * chunks encoded ahead and the rest of one bulk frame, then its own chunk,
+ * plus one event interval of phase
+ */
+#define FQ_BOUND_MS     (((CE_BUFFERS + TINYPAN_SLIP_TX_CHUNKS + CHUNKS(BULK_LEN) + 1) / CE_PER_EVENT + 1) * CE_INTERVAL_MS)
+
+/* Without it, every bulk frame the queue holds goes first */
+#define FIFO_BOUND_MS   (FQ_BOUND_MS + (TINYPAN_TX_QUEUE_LEN - 2) * CHUNKS(BULK_LEN) * CE_INTERVAL_MS / CE_PER_EVENT)
+
+static const tinypan_transport_t* s_slip = &transport_slip;
+static struct netif s_netif;
+
+/* Wire bytes collected from the mock HAL */
+static uint8_t s_wire[WIRE_MAX];
+static uint32_t s_wire_len = 0;
+static uint32_t s_collected = 0;
+
+/* Per-flow delivery, flow 0 is the bulk flow */
+static uint32_t s_rx_frames[1 + SPARSE_FLOWS];
+static uint32_t s_rx_latency_max[1 + SPARSE_FLOWS];
+static uint16_t s_rx_next_seq[1 + SPARSE_FLOWS];
+static uint32_t s_rx_bad = 0;
+
+static uint16_t s_src_port[1 + SPARSE_FLOWS];
+
+/**
+ * Build an IPv4/UDP datagram carrying flow, seq and the send tick
+ */
+static void fill_datagram(uint8_t* buf, uint16_t len, uint8_t flow, uint16_t seq, uint32_t tick) {
+    memset(buf, 0, len);
+    buf[0] = 0x45;
+    buf[2] = (uint8_t)(len >> 8);
+    buf[3] = (uint8_t)len;
+    buf[8] = 64;
+    buf[9] = 17;
+    buf[12] = 10; buf[15] = 2;     /* 10.0.0.2 */
+    buf[16] = 10; buf[19] = 1;     /* 10.0.0.1 */
+    buf[20] = (uint8_t)(s_src_port[flow] >> 8);
+    buf[21] = (uint8_t)s_src_port[flow];
+    buf[22] = 0x13;                 /* Port 5000 */
+    buf[23] = 0x88;
+    buf[28] = flow;
+    buf[29] = (uint8_t)(seq >> 8);
+    buf[30] = (uint8_t)seq;
+    memcpy(&buf[31], &tick, sizeof(tick));
+    for (uint16_t i = 35; i < len; i++) {
+        buf[i] = (uint8_t)(i * 7 + seq);
+    }
+}
+
+static err_t loopback_input(struct pbuf* p, struct netif* netif) {
+    (void)netif;
+    uint8_t got[BULK_LEN];
+    uint8_t want[BULK_LEN];
+    uint16_t len = p->tot_len;
+    if (len >= 35 && len <= sizeof(got) && pbuf_copy_partial(p, got, len, 0) == len && got[28] <= SPARSE_FLOWS) {
+        uint8_t flow = got[28];
+        uint16_t seq = (uint16_t)((got[29] << 8) | got[30]);
+        uint32_t tick;
+        memcpy(&tick, &got[31], sizeof(tick));
+        fill_datagram(want, len, flow, seq, tick);
+        if (memcmp(got, want, len) == 0 && seq == s_rx_next_seq[flow]) {
+            uint32_t latency = hal_get_tick_ms() - tick;
+            s_rx_next_seq[flow]++;
+            s_rx_frames[flow]++;
+            if (latency > s_rx_latency_max[flow]) {
+                s_rx_latency_max[flow] = latency;
+            }
+        } else {
+            s_rx_bad++;
+        }
+    } else {
+        s_rx_bad++;
+    }
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+/* The transport hands received frames to the TinyPAN netif */
+struct netif* tinypan_netif_get(void) {
+    return &s_netif;
+}
+
+bool tinypan_netif_rx_admit(struct pbuf* p, uint16_t ip_offset) {
+    (void)p;
+    (void)ip_offset;
+    return true;
+}
+
+u32_t sys_now(void) {
+    return hal_get_tick_ms();
+}
+
+static void hal_event_cb(hal_l2cap_event_t event, int status, void* user_data) {
+    (void)status;
+    (void)user_data;
+    if (event == HAL_L2CAP_EVENT_CAN_SEND_NOW) {
+        s_slip->on_can_send_now();
+    }
+}
+
+/**
+ * Copy chunks accepted by the mock since the last call into s_wire
+ */
+static int collect_wire(void) {
+    mock_hal_conn_event_stats_t stats;
+    mock_hal_get_conn_event_stats(&stats);
+    uint32_t fresh = stats.packets_accepted - s_collected;
+    if (fresh > 5) return 0; /* Mock history depth */
+
+    for (int i = (int)fresh - 1; i >= 0; i--) {
+        uint16_t len = mock_hal_get_tx_history_len(i);
+        if (s_wire_len + len > sizeof(s_wire)) return 0;
+        memcpy(&s_wire[s_wire_len], mock_hal_get_tx_history_data(i), len);
+        s_wire_len += len;
+    }
+    s_collected = stats.packets_accepted;
+    return 1;
+}
+
+/**
+ * Queue a datagram; returns false if the transport refused it
+ */
+static int send_datagram(uint16_t len, uint8_t flow, uint16_t seq) {
+    uint8_t buf[BULK_LEN];
+    fill_datagram(buf, len, flow, seq, hal_get_tick_ms());
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (p == NULL) return 0;
+    pbuf_take(p, buf, len);
+    err_t err = s_slip->output(&s_netif, p);
+    pbuf_free(p);
+    return err == ERR_OK;
+}
+
+static uint8_t flow_bucket(uint8_t flow) {
+    uint8_t buf[40];
+    fill_datagram(buf, sizeof(buf), flow, 0, 0);
+    return tinypan_fq_classify(0x0800, buf, sizeof(buf));
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * One bucket per 5-tuple, fragments together, non-IP by ethertype
+ */
+static int test_classify(void) {
+    uint8_t pkt[40];
+    memset(pkt, 0, sizeof(pkt));
+    pkt[0] = 0x45;
+    pkt[9] = 6;
+    pkt[12] = 192; pkt[13] = 168; pkt[15] = 2;
+    pkt[16] = 93; pkt[17] = 184; pkt[19] = 34;
+    pkt[22] = 0x01; pkt[23] = 0xBB;
+
+    uint8_t seen = 0;
+    uint32_t used = 0;
+    for (uint16_t port = 50000; port < 50064; port++) {
+        pkt[20] = (uint8_t)(port >> 8);
+        pkt[21] = (uint8_t)port;
+        uint8_t b = tinypan_fq_classify(0x0800, pkt, sizeof(pkt));
+        if (b >= TINYPAN_FQ_BUCKETS) return 0;
+        if (tinypan_fq_classify(0x0800, pkt, sizeof(pkt)) != b) return 0;
+        if (!(used & (1u << b))) {
+            used |= 1u << b;
+            seen++;
+        }
+    }
+    /* 64 source ports spread over (nearly) every bucket */
+    if (seen < TINYPAN_FQ_BUCKETS - 1) return 0;
+
+    /* Fragments of a datagram share a bucket whatever their offset */
+    pkt[6] = 0x20; /* MF */
+    uint8_t frag = tinypan_fq_classify(0x0800, pkt, sizeof(pkt));
+    pkt[6] = 0x00;
+    pkt[7] = 0xB9; /* Offset 1480, payload is not a port pair */
+    pkt[20] = 0xAA;
+    if (tinypan_fq_classify(0x0800, pkt, sizeof(pkt)) != frag) return 0;
+
+    /* Non-IP: the ethertype decides, a truncated header does no harm */
+    uint8_t arp[28];
+    memset(arp, 0x5A, sizeof(arp));
+    uint8_t b = tinypan_fq_classify(0x0806, arp, sizeof(arp));
+    if (tinypan_fq_classify(0x0806, pkt, 4) != b) return 0;
+    return tinypan_fq_classify(0x0800, pkt, 4) < TINYPAN_FQ_BUCKETS;
+}
+
+/**
+ * Picks follow deficit round robin and keep each bucket in order
+ */
+static int test_drr_order(void) {
+    /* Bucket 0: three full frames, bucket 1: one small, bucket 2: two small */
+    uint8_t flows[6] = { 0, 0, 0, 1, 2, 2 };
+    uint16_t lens[6] = { 1500, 1500, 1500, 100, 200, 200 };
+    uint8_t ids[6] = { 0, 1, 2, 3, 4, 5 };
+    const uint8_t want[6] = { 0, 3, 4, 5, 1, 2 };
+    uint8_t count = 6;
+
+    tinypan_fq_reset();
+    for (int n = 0; n < 6; n++) {
+        uint8_t i = tinypan_fq_pick(flows, lens, count);
+        if (i >= count || ids[i] != want[n]) return 0;
+        /* Remove it, as the transport does when the frame is sent */
+        memmove(&flows[i], &flows[i + 1], (size_t)(count - i - 1));
+        memmove(&lens[i], &lens[i + 1], (size_t)(count - i - 1) * sizeof(lens[0]));
+        memmove(&ids[i], &ids[i + 1], (size_t)(count - i - 1));
+        count--;
+    }
+
+    /* A bucket may hold TINYPAN_FQ_FLOW_LIMIT frames */
+    uint8_t held[TINYPAN_FQ_FLOW_LIMIT + 1];
+    memset(held, 3, sizeof(held));
+    held[0] = 1;
+    return tinypan_fq_admit(held, TINYPAN_FQ_FLOW_LIMIT, 3) &&
+           !tinypan_fq_admit(&held[1], TINYPAN_FQ_FLOW_LIMIT, 3) &&
+           tinypan_fq_admit(&held[1], TINYPAN_FQ_FLOW_LIMIT, 1);
+}
+
+/**
+ * An empty queue has nothing to pick and leaves the round where it was
+ */
+static int test_pick_empty(void) {
+    uint8_t flows[2] = { 0, 1 };
+    uint16_t lens[2] = { 100, 100 };
+
+    tinypan_fq_reset();
+    if (tinypan_fq_pick(flows, lens, 0) != TINYPAN_FQ_NONE) return 0;
+
+    /* Bucket 0 still comes up first */
+    return tinypan_fq_pick(flows, lens, 2) == 0 && tinypan_fq_pick(&flows[1], &lens[1], 1) == 0;
+}
+
+/**
+ * A bulk flow with a full share and sparse flows over a slow link
+ */
+static int test_sparse_flows_bounded(void) {
+    /* Sparse flows in buckets of their own, away from the bulk flow */
+    uint32_t used = 0;
+    uint16_t port = 40000;
+    for (uint8_t flow = 0; flow <= SPARSE_FLOWS; flow++) {
+        do {
+            s_src_port[flow] = port++;
+        } while (used & (1u << flow_bucket(flow)));
+        used |= 1u << flow_bucket(flow);
+    }
+
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+    hal_bt_l2cap_register_event_callback(hal_event_cb, NULL);
+    mock_hal_simulate_connect_success();
+    mock_hal_set_conn_event_model(CE_INTERVAL_MS, CE_PER_EVENT, CE_BUFFERS);
+    tinypan_fq_reset();
+    s_slip->init();
+    s_slip->on_connected();
+    s_netif.input = loopback_input;
+
+    uint16_t seq[1 + SPARSE_FLOWS] = { 0 };
+    uint32_t sparse_refused = 0;
+    for (uint32_t t = 0; t < RUN_MS; t++) {
+        /* Bulk: refill its share whenever there is room */
+        while (send_datagram(BULK_LEN, 0, seq[0])) {
+            seq[0]++;
+        }
+        for (uint8_t flow = 1; flow <= SPARSE_FLOWS; flow++) {
+            if (t % SPARSE_PERIOD_MS == flow * 37u) {
+                if (send_datagram(SPARSE_LEN, flow, seq[flow])) {
+                    seq[flow]++;
+                } else {
+                    sparse_refused++;
+                }
+            }
+        }
+
+        mock_hal_advance_tick_ms(1);
+        hal_bt_poll();
+        if (!collect_wire()) return 0;
+        s_slip->handle_incoming(s_wire, (uint16_t)s_wire_len);
+        s_wire_len = 0;
+    }
+
+    uint32_t sparse_max = 0;
+    uint32_t sparse_frames = 0;
+    for (uint8_t flow = 1; flow <= SPARSE_FLOWS; flow++) {
+        sparse_frames += s_rx_frames[flow];
+        if (s_rx_latency_max[flow] > sparse_max) {
+            sparse_max = s_rx_latency_max[flow];
+        }
+    }
+    mock_hal_conn_event_stats_t stats;
+    mock_hal_get_conn_event_stats(&stats);
+
+    printf("\n    bulk %u frames, sparse %u frames (%u refused), sparse max latency %u ms"
+           " (bound %u ms, FIFO bound %u ms), idle events %u\n    ",
+           (unsigned)s_rx_frames[0], (unsigned)sparse_frames, (unsigned)sparse_refused,
+           (unsigned)sparse_max, (unsigned)FQ_BOUND_MS, (unsigned)FIFO_BOUND_MS,
+           (unsigned)stats.idle_events);
+
+    s_slip->on_disconnected();
+    s_slip->flush_queues();
+    mock_hal_set_conn_event_model(0, 0, 0);
+    hal_bt_deinit();
+
+    /* Every sparse datagram made it, in time, and the bulk flow kept the
+     * link busy (one idle event at the start at most) */
+    uint32_t sparse_sent = 0;
+    for (uint8_t flow = 1; flow <= SPARSE_FLOWS; flow++) {
+        sparse_sent += seq[flow];
+    }
+    return s_rx_bad == 0 && sparse_refused == 0 &&
+           sparse_frames + SPARSE_FLOWS >= sparse_sent && sparse_frames > 0 &&
+           sparse_max <= FQ_BOUND_MS &&
+           stats.idle_events <= 1 && s_rx_frames[0] > 0;
+}
+
+static int s_full_events;
+static int s_writable_events;
+
+static void on_watermark(bool writable, void* user_data) {
+    (void)user_data;
+    if (writable) {
+        s_writable_events++;
+    } else {
+        s_full_events++;
+    }
+}
+
+static err_t discard_input(struct pbuf* p, struct netif* netif) {
+    (void)netif;
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+/**
+ * A flow refused for its share gets the same backpressure as a full queue
+ */
+static int test_share_refusal_backpressure(void) {
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+    hal_bt_l2cap_register_event_callback(hal_event_cb, NULL);
+    mock_hal_simulate_connect_success();
+    mock_hal_set_conn_event_model(CE_INTERVAL_MS, CE_PER_EVENT, CE_BUFFERS);
+    tinypan_fq_reset();
+    s_slip->init();
+    s_slip->on_connected();
+    s_netif.input = discard_input;
+    s_full_events = 0;
+    s_writable_events = 0;
+    tinypan_transport_tx_set_callback(on_watermark, NULL);
+
+    /* The bulk flow fills its share; the chunk ring ahead of it fills first */
+    uint16_t seq = 0;
+    while (seq < 2 * TINYPAN_TX_QUEUE_LEN && send_datagram(BULK_LEN, 0, seq)) {
+        seq++;
+    }
+    uint16_t queued = tinypan_transport_tx_queued();
+    uint16_t room = s_slip->tx_flow_room();
+    int full_on_refusal = s_full_events;
+
+    /* The queue still takes another flow's frame */
+    int sparse_ok = send_datagram(SPARSE_LEN, 1, 0);
+
+    for (int t = 0; t < 1000 && tinypan_transport_tx_queued() > 0; t++) {
+        mock_hal_advance_tick_ms(1);
+        hal_bt_poll();
+    }
+    uint16_t room_drained = s_slip->tx_flow_room();
+
+    tinypan_transport_tx_set_callback(NULL, NULL);
+    s_slip->on_disconnected();
+    s_slip->flush_queues();
+    mock_hal_set_conn_event_model(0, 0, 0);
+    hal_bt_deinit();
+
+    return queued == TINYPAN_FQ_FLOW_LIMIT && room == 0 && full_on_refusal == 1 &&
+           sparse_ok && s_writable_events == 1 && room_drained == TINYPAN_FQ_FLOW_LIMIT;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Flow Queueing Tests\n");
+    printf("===========================\n\n");
+
+    lwip_init();
+
+    printf("Running tests:\n");
+
+    TEST(classify);
+    TEST(drr_order);
+    TEST(pick_empty);
+    TEST(sparse_flows_bounded);
+    TEST(share_refusal_backpressure);
+
+    printf("\n===========================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
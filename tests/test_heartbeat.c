@@ -0,0 +1,322 @@
+/*
+ * TinyPAN Test - Link Heartbeat
+ *
+ * Runs the full stack over the mock HAL with a NAP that answers, stays
+ * busy, or goes silent: an idle link is probed with an ARP request to the
+ * gateway and the round-trip times are reported, received traffic keeps
+ * the probe from ever going out, and a link that stops answering is torn
+ * down after heartbeat_retries misses. Every probe and the verdict must
+ * come at the exact time tinypan_get_next_timeout_ms() announced. A reply
+ * is only recorded in the RX path and timed by the next tinypan_process(),
+ * and a reply that may answer an earlier probe is not timed at all.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "../src/tinypan_internal.h"
+#include "../src/tinypan_lwip_netif.h"
+#include "lwip/netif.h"
+#include "lwip/ip4_addr.h"
+#include "test_common.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define INTERVAL_MS     1000
+
+static const uint8_t s_gw[4] = { 192, 168, 44, 1 };
+static const uint8_t s_ip[4] = { 192, 168, 44, 2 };
+
+static uint32_t probes(void) {
+    tinypan_heartbeat_stats_t stats;
+    tinypan_get_heartbeat_stats(&stats);
+    return stats.probes;
+}
+
+/**
+ * Is the last frame sent an ARP request for the gateway?
+ */
+static bool last_tx_is_probe(void) {
+    static const uint8_t arp_request[10] = { 0x08, 0x06, 0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x01 };
+    const uint8_t* tx = mock_hal_get_last_tx_data();
+    uint16_t len = mock_hal_get_last_tx_len();
+    for (uint16_t i = 0; tx != NULL && i + 2 + 28 <= len; i++) {
+        if (memcmp(tx + i, arp_request, sizeof(arp_request)) == 0) {
+            return memcmp(tx + i + 2 + 24, s_gw, 4) == 0;
+        }
+    }
+    return false;
+}
+
+/**
+ * The NAP answers the probe
+ */
+static void send_reply(void) {
+    uint8_t frame[1 + 14 + 28];
+    const uint8_t* mac = tinypan_netif_get()->hwaddr;
+    frame[0] = BNEP_PKT_TYPE_GENERAL_ETHERNET;
+    memcpy(frame + 1, mac, 6);
+    memcpy(frame + 7, s_nap, 6);
+    frame[13] = 0x08;
+    frame[14] = 0x06;
+    uint8_t* arp = frame + 15;
+    const uint8_t hdr[8] = { 0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x02 };
+    memcpy(arp, hdr, 8);
+    memcpy(arp + 8, s_nap, 6);
+    memcpy(arp + 14, s_gw, 4);
+    memcpy(arp + 18, mac, 6);
+    memcpy(arp + 24, s_ip, 4);
+    mock_hal_simulate_receive(frame, sizeof(frame));
+}
+
+/**
+ * Some other traffic from the NAP (a frame of an unhandled ethertype)
+ */
+static void send_traffic(void) {
+    uint8_t frame[1 + 14 + 46];
+    memset(frame, 0, sizeof(frame));
+    frame[0] = BNEP_PKT_TYPE_GENERAL_ETHERNET;
+    memcpy(frame + 1, tinypan_netif_get()->hwaddr, 6);
+    memcpy(frame + 7, s_nap, 6);
+    frame[13] = 0x88;
+    frame[14] = 0xB5;
+    mock_hal_simulate_receive(frame, sizeof(frame));
+}
+
+/**
+ * Bring the stack ONLINE over BNEP with a static address
+ * @param online_at set to the tick at which it went ONLINE
+ */
+static int bring_up(uint32_t* online_at) {
+    tinypan_config_t config;
+    nap_config(&config);
+    config.heartbeat_interval_ms = INTERVAL_MS;
+
+    if (!start_stack(&config, NULL)) return 0;
+    answer_handshake();
+
+    /* No DHCP server here: configure the address directly */
+    tinypan_netif_stop_dhcp();
+    ip4_addr_t ip, mask, gw;
+    IP4_ADDR(&ip, s_ip[0], s_ip[1], s_ip[2], s_ip[3]);
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&gw, s_gw[0], s_gw[1], s_gw[2], s_gw[3]);
+    netif_set_addr(tinypan_netif_get(), &ip, &mask, &gw);
+    *online_at = hal_get_tick_ms();
+    step(1);
+
+    return tinypan_get_state() == TINYPAN_STATE_ONLINE;
+}
+
+/**
+ * Sleep until the next probe goes out
+ * @return tick it went out at
+ */
+static uint32_t wait_probe(void) {
+    uint32_t before = probes();
+    while (probes() == before && tinypan_get_state() == TINYPAN_STATE_ONLINE) {
+        sleep_step();
+    }
+    return hal_get_tick_ms();
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * An idle link is probed on schedule and the replies are timed
+ */
+static int test_probe_and_rtt(void) {
+    uint32_t online_at;
+    if (!bring_up(&online_at)) return 0;
+
+    /* Idle: the supervisor asks to be woken for the probe, and only then */
+    if (supervisor_get_next_timeout_ms() != INTERVAL_MS - 1) {
+        tear_down();
+        return 0;
+    }
+
+    const uint32_t rtts[3] = { 20, 40, 30 };
+    uint32_t alive_at = online_at;
+    bool on_time = true;
+    bool is_probe = true;
+    for (int i = 0; i < 3; i++) {
+        uint32_t sent_at = wait_probe();
+        on_time = on_time && (sent_at - alive_at == INTERVAL_MS);
+        is_probe = is_probe && last_tx_is_probe();
+        step(rtts[i]);
+        send_reply();
+        tinypan_process();
+        alive_at = hal_get_tick_ms();
+    }
+
+    tinypan_heartbeat_stats_t stats;
+    tinypan_get_heartbeat_stats(&stats);
+    printf("\n    %u probes, %u replies: rtt last %u ms, avg %u ms, min %u ms, max %u ms\n    ",
+           (unsigned)stats.probes, (unsigned)stats.replies, (unsigned)stats.rtt_last_ms,
+           (unsigned)stats.rtt_avg_ms, (unsigned)stats.rtt_min_ms, (unsigned)stats.rtt_max_ms);
+    bool connected = mock_hal_is_connected();
+    tear_down();
+
+    /* Smoothed x8: 160, 160 - 20 + 40 = 180, 180 - 22 + 30 = 188 */
+    return connected && on_time && is_probe &&
+           stats.probes == 3 && stats.replies == 3 && stats.misses == 0 &&
+           stats.rtt_last_ms == 30 && stats.rtt_min_ms == 20 && stats.rtt_max_ms == 40 &&
+           stats.rtt_avg_ms == 23;
+}
+
+/**
+ * The reply is timed when it arrived, even if tinypan_process() runs later
+ */
+static int test_reply_taken_in_process(void) {
+    uint32_t online_at;
+    if (!bring_up(&online_at)) return 0;
+
+    wait_probe();
+    step(25);
+    send_reply();
+
+    /* The RX path left the shared state alone and asked to be woken */
+    tinypan_heartbeat_stats_t before;
+    tinypan_get_heartbeat_stats(&before);
+    uint32_t wake_in = supervisor_get_next_timeout_ms();
+
+    step(10);
+    tinypan_heartbeat_stats_t after;
+    tinypan_get_heartbeat_stats(&after);
+    tear_down();
+
+    return before.replies == 0 && wake_in == 0 &&
+           after.replies == 1 && after.rtt_last_ms == 25 && after.misses == 0;
+}
+
+/**
+ * A reply that arrives just after a repeated probe may answer the first
+ * one: it keeps the link alive but is not timed. The next quiet spell
+ * starts a fresh round whose reply is timed again.
+ */
+static int test_late_reply_not_timed(void) {
+    uint32_t online_at;
+    if (!bring_up(&online_at)) return 0;
+
+    uint32_t first = wait_probe();
+    uint32_t repeat = wait_probe();
+    step(5);
+    send_reply();
+    tinypan_process();
+
+    tinypan_heartbeat_stats_t late;
+    tinypan_get_heartbeat_stats(&late);
+    bool online = tinypan_get_state() == TINYPAN_STATE_ONLINE;
+
+    wait_probe();
+    step(30);
+    send_reply();
+    tinypan_process();
+
+    tinypan_heartbeat_stats_t fresh;
+    tinypan_get_heartbeat_stats(&fresh);
+    tear_down();
+
+    return online && repeat - first == TINYPAN_HEARTBEAT_TIMEOUT_MS &&
+           late.probes == 2 && late.misses == 1 && late.replies == 1 && late.rtt_last_ms == 0 &&
+           fresh.probes == 3 && fresh.replies == 2 && fresh.rtt_last_ms == 30 &&
+           fresh.rtt_avg_ms == 30 && fresh.rtt_max_ms == 30;
+}
+
+/**
+ * Received traffic keeps the probe from going out
+ */
+static int test_rx_suppresses_probe(void) {
+    uint32_t online_at;
+    if (!bring_up(&online_at)) return 0;
+
+    for (int i = 0; i < 20; i++) {
+        step(INTERVAL_MS / 2);
+        send_traffic();
+        tinypan_process();
+    }
+    uint32_t last_rx = hal_get_tick_ms();
+    uint32_t suppressed = probes();
+    uint32_t next = supervisor_get_next_timeout_ms();
+    uint32_t sent_at = wait_probe();
+
+    printf("\n    10 s of traffic every %u ms: %u probes, next one %u ms after the last frame\n    ",
+           (unsigned)(INTERVAL_MS / 2), (unsigned)suppressed, (unsigned)(sent_at - last_rx));
+    tear_down();
+
+    return suppressed == 0 && next == INTERVAL_MS && sent_at - last_rx == INTERVAL_MS;
+}
+
+/**
+ * A silent NAP: the link is declared dead after heartbeat_retries misses
+ */
+static int test_dead_after_misses(void) {
+    uint32_t online_at;
+    if (!bring_up(&online_at)) return 0;
+
+    uint32_t wakeups = 0;
+    while (tinypan_get_state() == TINYPAN_STATE_ONLINE && wakeups < 1000) {
+        sleep_step();
+        wakeups++;
+    }
+    uint32_t detect_ms = hal_get_tick_ms() - online_at;
+
+    tinypan_heartbeat_stats_t stats;
+    tinypan_get_heartbeat_stats(&stats);
+    printf("\n    silent link declared dead after %u ms (%u wake-ups, %u probes)\n    ",
+           (unsigned)detect_ms, (unsigned)wakeups, (unsigned)stats.probes);
+    bool connected = mock_hal_is_connected();
+    tinypan_state_t state = tinypan_get_state();
+    tear_down();
+
+    return !connected && state == TINYPAN_STATE_RECONNECTING &&
+           detect_ms == INTERVAL_MS + 3 * TINYPAN_HEARTBEAT_TIMEOUT_MS &&
+           stats.probes == 3 && stats.misses == 3 && stats.replies == 0 &&
+           stats.dead_links == 1;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Link Heartbeat Tests\n");
+    printf("============================\n\n");
+
+    printf("Running tests:\n");
+
+    TEST(probe_and_rtt);
+    TEST(reply_taken_in_process);
+    TEST(late_reply_not_timed);
+    TEST(rx_suppresses_probe);
+    TEST(dead_after_misses);
+
+    printf("\n============================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -14,9 +14,13 @@
 #include "../src/tinypan_bnep.h"
 #include "dhcp_sim.h"
 
+#include "lwip/udp.h"
+#include "lwip/etharp.h"
+
 static dhcp_sim_config_t g_dhcp_config;
 
 static tinypan_state_t g_state_history[16];
+static uint32_t g_state_time[16];
 static int g_state_history_count = 0;
 static int g_disconnect_count = 0;
 
@@ -33,6 +37,7 @@ static void event_callback(tinypan_event_t event, void* user_data) {
     switch (event) {
         case TINYPAN_EVENT_STATE_CHANGED:
             if (g_state_history_count < (int)(sizeof(g_state_history) / sizeof(g_state_history[0]))) {
+                g_state_time[g_state_history_count] = hal_get_tick_ms();
                 g_state_history[g_state_history_count++] = tinypan_get_state();
             }
             printf("    State: %s\n", tinypan_state_to_string(tinypan_get_state()));
@@ -52,6 +57,147 @@ static void event_callback(tinypan_event_t event, void* user_data) {
     }
 }
 
+/** Tick at which the state history first entered a state (-1 if never) */
+static int64_t state_entry_time(tinypan_state_t state) {
+    for (int i = 0; i < g_state_history_count; i++) {
+        if (g_state_history[i] == state) return g_state_time[i];
+    }
+    return -1;
+}
+
+/** Milliseconds between two recorded states (0 if either was skipped) */
+static uint32_t phase_ms(tinypan_state_t from, tinypan_state_t to) {
+    int64_t t0 = state_entry_time(from);
+    int64_t t1 = state_entry_time(to);
+    return (t0 < 0 || t1 < 0) ? 0 : (uint32_t)(t1 - t0);
+}
+
+/** Print the per-phase bring-up timing; returns the filter-wait time */
+static uint32_t print_phase_table(const char* title) {
+    tinypan_state_t after_setup = (state_entry_time(TINYPAN_STATE_BNEP_FILTER_WAIT) >= 0) ?
+                                  TINYPAN_STATE_BNEP_FILTER_WAIT : TINYPAN_STATE_DHCP;
+    uint32_t filter = phase_ms(TINYPAN_STATE_BNEP_FILTER_WAIT, TINYPAN_STATE_DHCP);
+
+    printf("    Bring-up phases (%s):\n", title);
+    printf("      L2CAP connect   %6u ms\n", (unsigned)phase_ms(TINYPAN_STATE_CONNECTING, TINYPAN_STATE_BNEP_SETUP));
+    printf("      BNEP setup      %6u ms\n", (unsigned)phase_ms(TINYPAN_STATE_BNEP_SETUP, after_setup));
+    printf("      Filter wait     %6u ms\n", (unsigned)filter);
+    printf("      DHCP            %6u ms\n", (unsigned)phase_ms(TINYPAN_STATE_DHCP, TINYPAN_STATE_ONLINE));
+    printf("      Total           %6u ms\n", (unsigned)phase_ms(TINYPAN_STATE_CONNECTING, TINYPAN_STATE_ONLINE));
+    return filter;
+}
+
+/** EtherType of a BNEP Ethernet frame from the TX history (0 if not one) */
+static uint16_t bnep_frame_ethertype(const uint8_t* data, uint16_t len) {
+    if (data == NULL || len < 3) return 0;
+    switch (data[0] & 0x7F) {
+        case BNEP_PKT_TYPE_GENERAL_ETHERNET:
+            return (len >= 15) ? (uint16_t)((data[13] << 8) | data[14]) : 0;
+        case BNEP_PKT_TYPE_COMPRESSED_ETHERNET:
+            return (uint16_t)((data[1] << 8) | data[2]);
+        case BNEP_PKT_TYPE_COMPRESSED_SRC_ONLY:
+        case BNEP_PKT_TYPE_COMPRESSED_DST_ONLY:
+            return (len >= 9) ? (uint16_t)((data[7] << 8) | data[8]) : 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Pump the stack, answering lwIP's DISCOVER/REQUEST like the NAP would
+ * @return true once ONLINE, false after timeout_ms
+ */
+static bool answer_dhcp_until_online(uint32_t timeout_ms) {
+    uint32_t start_time = hal_get_tick_ms();
+    bool offer_sent = false;
+    bool ack_sent = false;
+    
+    while (!tinypan_is_online() && (hal_get_tick_ms() - start_time) < timeout_ms) {
+        tinypan_process();
+        
+        if (!offer_sent || !ack_sent) {
+            extern const uint8_t* mock_hal_get_tx_history_data(int);
+            extern uint16_t mock_hal_get_tx_history_len(int);
+            
+            for (int i = 0; i < 5; i++) {
+                const uint8_t* tx_data = mock_hal_get_tx_history_data(i);
+                uint16_t tx_len = mock_hal_get_tx_history_len(i);
+                if (!tx_data || tx_len == 0) continue;
+                
+                uint32_t xid = 0;
+                uint8_t client_mac[6] = {0x12, 0x22, 0x33, 0x44, 0x55, 0x66};
+                
+                if (!offer_sent && dhcp_sim_is_discover(tx_data, tx_len, &xid, NULL)) {
+                    printf("[Step 5b] Intercepted lwIP DHCP DISCOVER (XID: 0x%08X)\n", xid);
+                    printf("[Step 5c] Automatically generating and injecting NAP DHCP OFFER response...\n");
+                    
+                    uint8_t dhcp_offer[512];
+                    int offer_len = dhcp_sim_build_offer(dhcp_offer, sizeof(dhcp_offer),
+                                                          &g_dhcp_config, xid, client_mac);
+                    
+                    uint8_t broadcast[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+                    uint8_t full_packet[1024];
+                    int pkt_len = dhcp_sim_build_bnep_packet(
+                        full_packet, sizeof(full_packet),
+                        g_dhcp_config.server_mac, broadcast,
+                        g_dhcp_config.server_ip, 0xFFFFFFFF,
+                        dhcp_offer, (uint16_t)offer_len
+                    );
+                    
+                    extern void tinypan_netif_input(const uint8_t* dst, const uint8_t* src, uint16_t ethertype, const uint8_t* payload, uint16_t payload_len);
+                    /* BNEP header is 15 bytes. Payload starts at 15. The packet length includes the 15-byte BNEP header. */
+                    tinypan_netif_input(full_packet + 1, full_packet + 7, ((uint16_t)full_packet[13] << 8) | full_packet[14], full_packet + 15, pkt_len - 15);
+                    offer_sent = true;
+                    
+                    printf("[Step 5c] Injected OFFER Packet Hex (%d bytes):\n", pkt_len);
+                    for (int j = 0; j < pkt_len; j++) {
+                        printf("%02X ", full_packet[j]);
+                        if ((j + 1) % 16 == 0) printf("\n");
+                    }
+                    printf("\n");
+                    
+                    /* Fast-forward a bit to give lwIP time to process the OFFER */
+                    extern void mock_hal_advance_tick_ms(uint32_t delta_ms);
+                    mock_hal_advance_tick_ms(50);
+                    break; /* Processed one packet, break the history loop */
+                    
+                } else if (offer_sent && !ack_sent && dhcp_sim_is_request(tx_data, tx_len, &xid)) {
+                    printf("[Step 5d] Intercepted lwIP DHCP REQUEST (XID: 0x%08X)\n", xid);
+                    printf("[Step 5e] Automatically generating and injecting NAP DHCP ACK response...\n");
+                    
+                    uint8_t dhcp_ack[512];
+                    int ack_len = dhcp_sim_build_ack(dhcp_ack, sizeof(dhcp_ack),
+                                                      &g_dhcp_config, xid, client_mac);
+                    
+                    uint8_t broadcast[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+                    uint8_t full_packet[1024];
+                    int pkt_len = dhcp_sim_build_bnep_packet(
+                        full_packet, sizeof(full_packet),
+                        g_dhcp_config.server_mac, broadcast,
+                        g_dhcp_config.server_ip, 0xFFFFFFFF,
+                        dhcp_ack, (uint16_t)ack_len
+                    );
+                    
+                    extern void tinypan_netif_input(const uint8_t* dst, const uint8_t* src, uint16_t ethertype, const uint8_t* payload, uint16_t payload_len);
+                    tinypan_netif_input(full_packet + 1, full_packet + 7, ((uint16_t)full_packet[13] << 8) | full_packet[14], full_packet + 15, pkt_len - 15);
+                    ack_sent = true;
+                    
+                    /* Fast-forward to let lwIP process ACK and setup IP */
+                    extern void mock_hal_advance_tick_ms(uint32_t delta_ms);
+                    mock_hal_advance_tick_ms(50);
+                    break; /* Processed one packet, break the history loop */
+                }
+            }
+        }
+        
+        /* Fast-forward simulated time by 10ms and pump again */
+        extern void mock_hal_advance_tick_ms(uint32_t delta_ms);
+        mock_hal_advance_tick_ms(10);
+    }
+    
+    return tinypan_is_online();
+}
+
 /* ============================================================================
  * Main Test
  * ============================================================================ */
@@ -113,14 +259,21 @@ int main(void) {
     mock_hal_simulate_bnep_setup_success();
     tinypan_process();
 
+#if TINYPAN_ENABLE_FAST_BRINGUP
+    /* Fast bring-up: DHCP starts at once, the filter response is handled later */
+    const tinypan_state_t after_setup = TINYPAN_STATE_DHCP;
+#else
     /* After BNEP setup, TinyPAN should be waiting for the multicast filter ACK */
-    if (tinypan_get_state() != TINYPAN_STATE_BNEP_FILTER_WAIT) {
-        printf("    FAILED: Expected BNEP_FILTER_WAIT (state = %s)\n",
+    const tinypan_state_t after_setup = TINYPAN_STATE_BNEP_FILTER_WAIT;
+#endif
+    if (tinypan_get_state() != after_setup) {
+        printf("    FAILED: Expected %s (state = %s)\n",
+               tinypan_state_to_string(after_setup),
                tinypan_state_to_string(tinypan_get_state()));
         tinypan_deinit();
         return 1;
     }
-    printf("    OK: State is BNEP_FILTER_WAIT\n");
+    printf("    OK: State is %s\n", tinypan_state_to_string(after_setup));
     
     /* We expect TinyPAN to immediately send the BNEP Multicast Filter SET request */
     extern const uint8_t* mock_hal_get_tx_history_data(int);
@@ -216,98 +369,15 @@ int main(void) {
        and automatically format and attempt to send a real DHCP DISCOVER packet out
        to our mock L2CAP HAL! We simulate 5 seconds of time passing. */
     const uint32_t timeout_ms = 5000;
-    uint32_t start_time = hal_get_tick_ms();
-    bool offer_sent = false;
-    bool ack_sent = false;
-    
-    while (!tinypan_is_online() && (hal_get_tick_ms() - start_time) < timeout_ms) {
-        tinypan_process();
-        
-        if (!offer_sent || !ack_sent) {
-            extern const uint8_t* mock_hal_get_tx_history_data(int);
-            extern uint16_t mock_hal_get_tx_history_len(int);
-            
-            for (int i = 0; i < 5; i++) {
-                const uint8_t* tx_data = mock_hal_get_tx_history_data(i);
-                uint16_t tx_len = mock_hal_get_tx_history_len(i);
-                if (!tx_data || tx_len == 0) continue;
-                
-                uint32_t xid = 0;
-                uint8_t client_mac[6] = {0x12, 0x22, 0x33, 0x44, 0x55, 0x66};
-                
-                if (!offer_sent && dhcp_sim_is_discover(tx_data, tx_len, &xid, NULL)) {
-                    printf("[Step 5b] Intercepted lwIP DHCP DISCOVER (XID: 0x%08X)\n", xid);
-                    printf("[Step 5c] Automatically generating and injecting NAP DHCP OFFER response...\n");
-                    
-                    uint8_t dhcp_offer[512];
-                    int offer_len = dhcp_sim_build_offer(dhcp_offer, sizeof(dhcp_offer),
-                                                          &g_dhcp_config, xid, client_mac);
-                    
-                    uint8_t broadcast[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-                    uint8_t full_packet[1024];
-                    int pkt_len = dhcp_sim_build_bnep_packet(
-                        full_packet, sizeof(full_packet),
-                        g_dhcp_config.server_mac, broadcast,
-                        g_dhcp_config.server_ip, 0xFFFFFFFF,
-                        dhcp_offer, (uint16_t)offer_len
-                    );
-                    
-                    extern void tinypan_netif_input(const uint8_t* dst, const uint8_t* src, uint16_t ethertype, const uint8_t* payload, uint16_t payload_len);
-                    /* BNEP header is 15 bytes. Payload starts at 15. The packet length includes the 15-byte BNEP header. */
-                    tinypan_netif_input(full_packet + 1, full_packet + 7, ((uint16_t)full_packet[13] << 8) | full_packet[14], full_packet + 15, pkt_len - 15);
-                    offer_sent = true;
-                    
-                    printf("[Step 5c] Injected OFFER Packet Hex (%d bytes):\n", pkt_len);
-                    for (int j = 0; j < pkt_len; j++) {
-                        printf("%02X ", full_packet[j]);
-                        if ((j + 1) % 16 == 0) printf("\n");
-                    }
-                    printf("\n");
-                    
-                    /* Fast-forward a bit to give lwIP time to process the OFFER */
-                    extern void mock_hal_advance_tick_ms(uint32_t delta_ms);
-                    mock_hal_advance_tick_ms(50);
-                    break; /* Processed one packet, break the history loop */
-                    
-                } else if (offer_sent && !ack_sent && dhcp_sim_is_request(tx_data, tx_len, &xid)) {
-                    printf("[Step 5d] Intercepted lwIP DHCP REQUEST (XID: 0x%08X)\n", xid);
-                    printf("[Step 5e] Automatically generating and injecting NAP DHCP ACK response...\n");
-                    
-                    uint8_t dhcp_ack[512];
-                    int ack_len = dhcp_sim_build_ack(dhcp_ack, sizeof(dhcp_ack),
-                                                      &g_dhcp_config, xid, client_mac);
-                    
-                    uint8_t broadcast[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-                    uint8_t full_packet[1024];
-                    int pkt_len = dhcp_sim_build_bnep_packet(
-                        full_packet, sizeof(full_packet),
-                        g_dhcp_config.server_mac, broadcast,
-                        g_dhcp_config.server_ip, 0xFFFFFFFF,
-                        dhcp_ack, (uint16_t)ack_len
-                    );
-                    
-                    extern void tinypan_netif_input(const uint8_t* dst, const uint8_t* src, uint16_t ethertype, const uint8_t* payload, uint16_t payload_len);
-                    tinypan_netif_input(full_packet + 1, full_packet + 7, ((uint16_t)full_packet[13] << 8) | full_packet[14], full_packet + 15, pkt_len - 15);
-                    ack_sent = true;
-                    
-                    /* Fast-forward to let lwIP process ACK and setup IP */
-                    extern void mock_hal_advance_tick_ms(uint32_t delta_ms);
-                    mock_hal_advance_tick_ms(50);
-                    break; /* Processed one packet, break the history loop */
-                }
-            }
-        }
-        
-        /* Fast-forward simulated time by 10ms and pump again */
-        extern void mock_hal_advance_tick_ms(uint32_t delta_ms);
-        mock_hal_advance_tick_ms(10);
-    }
+    answer_dhcp_until_online(timeout_ms);
     
     /* Validate state callback sequence */
     const tinypan_state_t expected_states[] = {
         TINYPAN_STATE_CONNECTING,
         TINYPAN_STATE_BNEP_SETUP,
+#if !TINYPAN_ENABLE_FAST_BRINGUP
         TINYPAN_STATE_BNEP_FILTER_WAIT,
+#endif
         TINYPAN_STATE_DHCP,
         TINYPAN_STATE_ONLINE
     };
@@ -332,6 +402,8 @@ int main(void) {
     printf("=====================================================\n\n");
     
     printf("Current State: %s\n\n", tinypan_state_to_string(tinypan_get_state()));
+    print_phase_table("phone answers the filter");
+    printf("\n");
     
     if (tinypan_is_online()) {
         tinypan_ip_info_t info;
@@ -355,6 +427,50 @@ int main(void) {
         return 1;
     }
     
+    /* The gateway is pinned to the NAP's MAC, so the first unicast packet
+     * leaves at once instead of waiting behind an ARP request. */
+    printf("\n[Step 5f] First Unicast Packet Needs No ARP\n");
+    {
+        extern const uint8_t* mock_hal_get_tx_history_data(int);
+        extern uint16_t mock_hal_get_tx_history_len(int);
+        extern struct netif* tinypan_netif_get(void);
+
+        struct udp_pcb* pcb = udp_new();
+        struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, 16, PBUF_RAM);
+        ip_addr_t dst;
+        IP_ADDR4(&dst, 8, 8, 8, 8);
+        if (pcb == NULL || p == NULL) {
+            printf("    FAILED: Could not allocate UDP pcb/pbuf\n");
+            tinypan_deinit();
+            return 1;
+        }
+        memset(p->payload, 0xA5, 16);
+        err_t err = udp_sendto(pcb, p, &dst, 9);
+        pbuf_free(p);
+        tinypan_process();
+
+        const uint8_t* tx = mock_hal_get_tx_history_data(0);
+        uint16_t tx_len = mock_hal_get_tx_history_len(0);
+        uint16_t ethertype = bnep_frame_ethertype(tx, tx_len);
+        if (err != ERR_OK || ethertype != 0x0800) {
+            printf("    FAILED: Expected the UDP datagram on the wire (err %d, ethertype 0x%04X)\n",
+                   err, ethertype);
+            udp_remove(pcb);
+            tinypan_deinit();
+            return 1;
+        }
+        /* Sent to the NAP: compressed, or general with the NAP as destination */
+        if ((tx[0] & 0x7F) == BNEP_PKT_TYPE_GENERAL_ETHERNET &&
+            memcmp(tx + 1, g_dhcp_config.server_mac, 6) != 0) {
+            printf("    FAILED: First unicast frame not addressed to the NAP\n");
+            udp_remove(pcb);
+            tinypan_deinit();
+            return 1;
+        }
+        printf("    OK: UDP datagram sent immediately, no ARP request\n");
+        udp_remove(pcb);
+    }
+
     printf("\nWhat we demonstrated:\n");
     printf("  [✓] L2CAP connection (PSM 0x000F)\n");
     printf("  [✓] BNEP handshake (PANU -> NAP)\n");
@@ -371,6 +487,60 @@ int main(void) {
         return 1;
     }
 
+    /* Stopping drops the pinned gateway entry */
+    {
+        extern struct netif* tinypan_netif_get(void);
+        ip4_addr_t gw;
+        struct eth_addr* eth_ret = NULL;
+        const ip4_addr_t* ip_ret = NULL;
+        IP4_ADDR(&gw, 192, 168, 44, 1);
+        if (etharp_find_addr(tinypan_netif_get(), &gw, &eth_ret, &ip_ret) >= 0) {
+            printf("    FAILED: Gateway ARP entry survived the disconnect\n");
+            tinypan_deinit();
+            return 1;
+        }
+    }
+
+    /* Most phones never answer the multicast filter request. Without fast
+     * bring-up, that costs the whole TINYPAN_BNEP_FILTER_TIMEOUT_MS. */
+    printf("\n[Step 7] Reconnect to a Phone that Ignores the Multicast Filter\n");
+    g_state_history_count = 0;
+    tinypan_start();
+    mock_hal_simulate_connect_success();
+    tinypan_process();
+    mock_hal_simulate_bnep_setup_success();
+    tinypan_process();
+    if (!answer_dhcp_until_online(TINYPAN_BNEP_FILTER_TIMEOUT_MS + timeout_ms)) {
+        printf("    FAILED: Did not go ONLINE (state = %s)\n",
+               tinypan_state_to_string(tinypan_get_state()));
+        tinypan_deinit();
+        return 1;
+    }
+    uint32_t filter_wait = print_phase_table("phone ignores the filter");
+#if TINYPAN_ENABLE_FAST_BRINGUP
+    if (filter_wait != 0) {
+        printf("    FAILED: Fast bring-up still waited %u ms for the filter\n", (unsigned)filter_wait);
+        tinypan_deinit();
+        return 1;
+    }
+    /* A late filter response is only logged */
+    mock_hal_simulate_receive(filter_resp, sizeof(filter_resp));
+    tinypan_process();
+    if (tinypan_get_state() != TINYPAN_STATE_ONLINE) {
+        printf("    FAILED: Late filter response changed state to %s\n",
+               tinypan_state_to_string(tinypan_get_state()));
+        tinypan_deinit();
+        return 1;
+    }
+#else
+    if (filter_wait < TINYPAN_BNEP_FILTER_TIMEOUT_MS) {
+        printf("    FAILED: Filter wait %u ms shorter than the timeout\n", (unsigned)filter_wait);
+        tinypan_deinit();
+        return 1;
+    }
+#endif
+    tinypan_stop();
+
     tinypan_deinit();
     printf("    Done!\n\n");
     
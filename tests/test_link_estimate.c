@@ -0,0 +1,225 @@
+/*
+ * TinyPAN Test - Link Capacity Estimate
+ *
+ * Full-stack runs against the simulated NAP with a saturating UDP producer.
+ * The mock radio completes one frame per tinypan_process() call, so the
+ * poll interval sets the link rate; stepping it must move the estimate to
+ * the new goodput within a few windows, with service and queueing times
+ * that match the queue depth. A stalled link must decay the estimate and
+ * an idle one must leave it alone.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+
+/* settle() drains a full TX queue */
+#define NAP_SETTLE_STEPS    (TINYPAN_TX_QUEUE_LEN + 1)
+#include "test_common.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define COLLECTOR_IP        0x0A141E32  /* 10.20.30.50, reached through the gateway */
+#define LOCAL_PORT          4000
+#define COLLECTOR_PORT      7000
+
+/* Built with TINYPAN_TX_QUEUE_LEN=5: four frames fit */
+#define QUEUE_FRAMES        (TINYPAN_TX_QUEUE_LEN - 1)
+
+#define PAYLOAD_LEN         200
+/* On the link: compressed BNEP header (3) + IP (20) + UDP (8) + payload */
+#define WIRE_LEN            (3 + 20 + 8 + PAYLOAD_LEN)
+
+#define WINDOW_MS           TINYPAN_LINK_EST_WINDOW_MS
+
+static struct udp_pcb* s_pcb;
+static uint32_t s_send_errors;
+
+/** Host-order address as tinypan takes it (network byte order) */
+static uint32_t net_addr(uint32_t host) {
+    uint32_t net;
+    uint8_t* b = (uint8_t*)&net;
+    b[0] = (uint8_t)(host >> 24);
+    b[1] = (uint8_t)(host >> 16);
+    b[2] = (uint8_t)(host >> 8);
+    b[3] = (uint8_t)host;
+    return net;
+}
+
+/** Datagram seq: the sequence number, then a pattern derived from it */
+static void send_datagram(uint32_t seq, uint16_t len) {
+    uint8_t buf[PAYLOAD_LEN];
+    ip_addr_t dst;
+
+    memcpy(buf, &seq, sizeof(seq));
+    for (uint16_t i = sizeof(seq); i < len; i++) {
+        buf[i] = (uint8_t)(seq + i * 7);
+    }
+    ip_addr_set_ip4_u32(&dst, net_addr(COLLECTOR_IP));
+
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (p == NULL) {
+        s_send_errors++;
+        return;
+    }
+    pbuf_take(p, buf, len);
+    if (udp_sendto(s_pcb, p, &dst, COLLECTOR_PORT) != ERR_OK) {
+        s_send_errors++;
+    }
+    pbuf_free(p);
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static uint32_t s_seq;
+
+/** Keep the TX queue full while polling every step_ms, for duration_ms */
+static void stream(uint32_t step_ms, uint32_t duration_ms) {
+    for (uint32_t t = 0; t < duration_ms; t += step_ms) {
+        while (tinypan_tx_available() > 0) {
+            send_datagram(s_seq++, PAYLOAD_LEN);
+        }
+        mock_hal_advance_tick_ms(step_ms);
+        tinypan_process();
+    }
+}
+
+static tinypan_link_estimate_t estimate(void) {
+    tinypan_link_estimate_t est;
+    memset(&est, 0, sizeof(est));
+    tinypan_get_link_estimate(&est);
+    return est;
+}
+
+/** value is within pct percent of expected */
+static int near(uint32_t value, uint32_t expected, uint32_t pct) {
+    uint32_t diff = (value > expected) ? value - expected : expected - value;
+    return (uint64_t)diff * 100u <= (uint64_t)expected * pct;
+}
+
+/**
+ * One frame per 10 ms: 100 frames/s of WIRE_LEN bytes. With four frames
+ * queued, each spends 40 ms from enqueue to TX_COMPLETE, 30 of them queued.
+ */
+static int test_steady_rate(void) {
+    tinypan_link_estimate_t est;
+    if (tinypan_get_link_estimate(NULL) != TINYPAN_ERR_INVALID_PARAM) return 0;
+    if (tinypan_get_link_estimate(&est) != TINYPAN_ERR_NOT_INITIALIZED) return 0;
+
+    if (bring_online() < 0) return 0;
+    s_pcb = udp_new();
+    if (s_pcb == NULL || udp_bind(s_pcb, IP_ADDR_ANY, LOCAL_PORT) != ERR_OK) return 0;
+
+    s_send_errors = 0;
+    stream(10, 8 * WINDOW_MS);
+    est = estimate();
+    printf("\n    %u B/s, %u frames/s, service %u us, queued %u us ",
+           (unsigned)est.tx_bytes_per_s, (unsigned)est.tx_frames_per_s,
+           (unsigned)est.service_time_us, (unsigned)est.queue_delay_us);
+    return s_send_errors == 0 && est.windows >= 8 &&
+           near(est.tx_bytes_per_s, 100 * WIRE_LEN, 5) && near(est.tx_frames_per_s, 100, 5) &&
+           near(est.service_time_us, 40000, 10) && near(est.queue_delay_us, 30000, 10);
+}
+
+/**
+ * The link slows to one frame per 40 ms, then recovers; each step is
+ * tracked within six windows
+ */
+static int test_stepped_rate(void) {
+    tinypan_link_estimate_t est;
+
+    stream(40, 6 * WINDOW_MS);
+    est = estimate();
+    if (!near(est.tx_bytes_per_s, 25 * WIRE_LEN, 10) || !near(est.tx_frames_per_s, 25, 10) ||
+        !near(est.service_time_us, 160000, 10)) {
+        return 0;
+    }
+
+    stream(10, 6 * WINDOW_MS);
+    est = estimate();
+    return s_send_errors == 0 && near(est.tx_bytes_per_s, 100 * WIRE_LEN, 10) &&
+           near(est.tx_frames_per_s, 100, 10);
+}
+
+/**
+ * Frames queued on a radio that sends nothing pull the rate down; an idle
+ * queue leaves the estimate where it was
+ */
+static int test_stall_and_idle(void) {
+    tinypan_link_estimate_t before;
+    tinypan_link_estimate_t est;
+
+    /* Let the queue run dry, then hold the estimate through idle time */
+    for (int i = 0; i < QUEUE_FRAMES + 2; i++) {
+        step(NAP_STEP_MS);
+    }
+    before = estimate();
+    for (int i = 0; i < 4 * WINDOW_MS / NAP_STEP_MS; i++) {
+        step(NAP_STEP_MS);
+    }
+    est = estimate();
+    if (est.tx_bytes_per_s != before.tx_bytes_per_s || est.windows != before.windows) return 0;
+
+    mock_hal_set_can_send(false);
+    stream(10, 4 * WINDOW_MS);
+    est = estimate();
+    mock_hal_set_can_send(true);
+    settle();
+    return est.tx_bytes_per_s < before.tx_bytes_per_s / 4;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Link Estimate Tests\n");
+    printf("===========================\n\n");
+
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(steady_rate);
+    TEST(stepped_rate);
+    TEST(stall_and_idle);
+
+    if (s_pcb != NULL) {
+        udp_remove(s_pcb);
+    }
+    tinypan_deinit();
+
+    printf("\n===========================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+/*
+ * TinyPAN Test - Trusted-Link RX Checksums
+ *
+ * Full-stack runs with link trust enabled: the stack is brought online
+ * against the simulated NAP DHCP server, then UDP datagrams are injected
+ * through tp0 to check the 1-in-N sampling, the bypass on skipped frames
+ * and the fall back to full checking once a sampled frame fails.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+#include "test_common.h"
+
+#include "lwip/udp.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define SAMPLE_RATE         TINYPAN_LINK_TRUST_SAMPLE_RATE
+
+#define APP_PORT            5000
+#define PAYLOAD_LEN         64
+
+static const uint8_t s_client_ip[4] = { 192, 168, 44, 2 };
+static const uint8_t s_server_ip[4] = { 192, 168, 44, 1 };
+
+static struct udp_pcb* s_pcb;
+static int s_delivered;
+
+static void on_udp(void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                   const ip_addr_t* addr, u16_t port) {
+    (void)arg; (void)pcb; (void)addr; (void)port;
+    s_delivered++;
+    pbuf_free(p);
+}
+
+/**
+ * @brief Bring the stack online and listen on APP_PORT
+ * @return 0 on success, -1 on failure (the stack is de-initialized)
+ */
+static int bring_online_app(void) {
+    if (bring_online() < 0) return -1;
+
+    s_pcb = udp_new();
+    if (s_pcb == NULL || udp_bind(s_pcb, IP_ADDR_ANY, APP_PORT) != ERR_OK) {
+        tinypan_deinit();
+        return -1;
+    }
+    udp_recv(s_pcb, on_udp, NULL);
+    s_delivered = 0;
+    return 0;
+}
+
+static void take_offline(void) {
+    if (s_pcb != NULL) {
+        udp_remove(s_pcb);
+        s_pcb = NULL;
+    }
+    tinypan_deinit();
+}
+
+/** One's complement sum of big-endian 16-bit words */
+static uint32_t sum16(uint32_t sum, const uint8_t* p, int len) {
+    for (int i = 0; i + 1 < len; i += 2) {
+        sum += (uint32_t)((p[i] << 8) | p[i + 1]);
+    }
+    if (len & 1) {
+        sum += (uint32_t)(p[len - 1] << 8);
+    }
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+/**
+ * @brief Inject one NAP -> client UDP datagram to APP_PORT
+ * @param corrupt Flip a payload bit after the checksums are filled in
+ *                (the kind of error a link CRC would otherwise catch)
+ */
+static void inject_udp(uint16_t seq, bool corrupt) {
+    uint8_t ip[20 + 8 + PAYLOAD_LEN];
+    uint8_t* udp = ip + 20;
+    uint16_t udp_len = 8 + PAYLOAD_LEN;
+
+    memset(ip, 0, sizeof(ip));
+    ip[0] = 0x45;
+    ip[2] = (uint8_t)(sizeof(ip) >> 8);
+    ip[3] = (uint8_t)sizeof(ip);
+    ip[4] = (uint8_t)(seq >> 8);
+    ip[5] = (uint8_t)seq;
+    ip[8] = 64;
+    ip[9] = 17;
+    memcpy(ip + 12, s_server_ip, 4);
+    memcpy(ip + 16, s_client_ip, 4);
+    uint16_t ip_sum = fold(sum16(0, ip, 20));
+    ip[10] = (uint8_t)(ip_sum >> 8);
+    ip[11] = (uint8_t)ip_sum;
+
+    udp[0] = 0x13; udp[1] = 0x88;       /* 5000 -> 5000 */
+    udp[2] = 0x13; udp[3] = 0x88;
+    udp[4] = (uint8_t)(udp_len >> 8);
+    udp[5] = (uint8_t)udp_len;
+    for (int i = 0; i < PAYLOAD_LEN; i++) {
+        udp[8 + i] = (uint8_t)(seq + i);
+    }
+    uint32_t pseudo = sum16(0, ip + 12, 8) + 17 + udp_len;
+    uint16_t udp_sum = fold(sum16(pseudo, udp, udp_len));
+    if (udp_sum == 0) udp_sum = 0xFFFF;
+    udp[6] = (uint8_t)(udp_sum >> 8);
+    udp[7] = (uint8_t)udp_sum;
+
+    if (corrupt) {
+        udp[8 + PAYLOAD_LEN / 2] ^= 0x10;
+    }
+    tinypan_netif_input(s_client_mac, s_sim.server_mac, 0x0800, ip, sizeof(ip));
+}
+
+/** @return true if the next injected frame will be sampled */
+static bool sample_next(void) {
+    tinypan_checksum_stats_t before, after;
+    tinypan_get_checksum_stats(&before);
+    inject_udp(0, false);
+    tinypan_get_checksum_stats(&after);
+    return after.frames_sampled == before.frames_sampled + 1;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Exactly one frame in SAMPLE_RATE is verified; every valid frame is delivered
+ */
+static int test_sampling_rate(void) {
+    if (bring_online_app() < 0) return 0;
+
+    tinypan_checksum_stats_t before, after;
+    tinypan_get_checksum_stats(&before);
+    for (uint16_t i = 0; i < 10 * SAMPLE_RATE; i++) {
+        inject_udp(i, false);
+    }
+    tinypan_get_checksum_stats(&after);
+    int delivered = s_delivered;
+    take_offline();
+
+    uint32_t sampled = after.frames_sampled - before.frames_sampled;
+    uint32_t skipped = after.checks_skipped - before.checks_skipped;
+    printf("\n    %d frames: %u sampled, %u skipped, %d delivered\n    ",
+           10 * SAMPLE_RATE, (unsigned)sampled, (unsigned)skipped, delivered);
+    return sampled == 10 && skipped == 10 * (SAMPLE_RATE - 1) &&
+           delivered == 10 * SAMPLE_RATE && after.failures == 0 && !after.full_checking;
+}
+
+/**
+ * A corrupt frame in a skipped slot is delivered; the first corrupt frame
+ * that is sampled is dropped and turns full checking back on, after which
+ * lwIP drops every corrupt frame itself
+ */
+static int test_failure_restores_full_checking(void) {
+    if (bring_online_app() < 0) return 0;
+
+    /* Align to the sampling period: the frame after a sampled one is skipped */
+    for (int i = 0; i < SAMPLE_RATE && !sample_next(); i++) {
+    }
+    s_delivered = 0;
+    inject_udp(1, true);
+    int bypassed = s_delivered;
+
+    /* The next sampled frame catches the corruption */
+    for (int i = 0; i < SAMPLE_RATE - 1; i++) {
+        inject_udp(2, true);
+    }
+    tinypan_checksum_stats_t tripped;
+    tinypan_get_checksum_stats(&tripped);
+    int dropped = SAMPLE_RATE - s_delivered;
+
+    /* Full checking: corrupt frames never reach the app, valid ones do */
+    s_delivered = 0;
+    for (uint16_t i = 0; i < 2 * SAMPLE_RATE; i++) {
+        inject_udp(i, (i & 1) != 0);
+    }
+    tinypan_checksum_stats_t after;
+    tinypan_get_checksum_stats(&after);
+    int delivered = s_delivered;
+    take_offline();
+
+    printf("\n    bypassed %d, dropped %d, failures %u, then %d/%d delivered\n    ",
+           bypassed, dropped, (unsigned)tripped.failures, delivered, 2 * SAMPLE_RATE);
+    return bypassed == 1 && dropped == 1 && tripped.failures == 1 && tripped.full_checking &&
+           delivered == SAMPLE_RATE &&
+           after.checks_skipped == tripped.checks_skipped &&
+           after.frames_sampled == tripped.frames_sampled;
+}
+
+/**
+ * Trust is per link: a restart starts trusted again with fresh counters
+ */
+static int test_trust_restored_on_reinit(void) {
+    if (bring_online_app() < 0) return 0;
+    tinypan_checksum_stats_t stats;
+    tinypan_get_checksum_stats(&stats);
+    take_offline();
+    return !stats.full_checking && stats.failures == 0;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Link Trust Tests\n");
+    printf("========================\n\n");
+
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(sampling_rate);
+    TEST(failure_restores_full_checking);
+    TEST(trust_restored_on_reinit);
+
+    printf("\n========================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+/*
+ * TinyPAN Test - Egress Pacing
+ *
+ * Checks the pacer's token bucket, then runs the SLIP transport against
+ * the mock HAL's connection-event model with the controller's buffer count
+ * hidden (as behind the ESP32 L2CAP ring buffer or a NUS queue). Bursts of
+ * frames are sent unpaced and paced just under the link rate with a burst
+ * of about one chunk (set by the test target): pacing must cut the
+ * busy returns and CAN_SEND_NOW cycles and the time chunks sit in the
+ * controller, while every frame still arrives intact.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_transport.h"
+#include "../src/tinypan_pacer.h"
+
+#include "lwip/init.h"
+#include "lwip/pbuf.h"
+#include "lwip/netif.h"
+
+extern const uint8_t* mock_hal_get_tx_history_data(int index_from_newest);
+extern uint16_t mock_hal_get_tx_history_len(int index_from_newest);
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define FRAME_LEN       1000
+#define WIRE_MAX        8192
+
+/* Link: 2 chunks of up to 247 bytes every 15 ms, 4 controller buffers */
+#define CE_INTERVAL_MS  15
+#define CE_PER_EVENT    2
+#define CE_BUFFERS      4
+#define LINK_BPS        (CE_PER_EVENT * TINYPAN_SLIP_CHUNK_SIZE * 1000 / CE_INTERVAL_MS)
+
+/* Application: a burst of two frames every 200 ms, about a third of the link */
+#define BURST_FRAMES    2
+#define BURST_PERIOD_MS 200
+#define BURSTS          20
+
+static const tinypan_transport_t* s_slip = &transport_slip;
+static struct netif s_netif;
+
+/* Frames delivered by the loopback decoder */
+static int s_rx_frames = 0;
+static int s_rx_bad = 0;
+
+/* Wire bytes collected from the mock HAL */
+static uint8_t s_wire[WIRE_MAX];
+static uint32_t s_wire_len = 0;
+static uint32_t s_collected = 0;
+
+static uint32_t s_can_send_events = 0;
+
+static void fill_frame(uint8_t* buf, uint8_t seed) {
+    for (int i = 0; i < FRAME_LEN; i++) {
+        /* Sprinkle in bytes that need escaping */
+        buf[i] = (i % 97 == 0) ? 0xC0 : (i % 89 == 0) ? 0xDB : (uint8_t)(i * 7 + seed);
+    }
+    /* IPv4 with a reserved protocol: never touched by header compression */
+    buf[0] = 0x45;
+    buf[9] = 0xFF;
+    buf[1] = seed;
+}
+
+static err_t loopback_input(struct pbuf* p, struct netif* netif) {
+    (void)netif;
+    uint8_t got[FRAME_LEN];
+    uint8_t want[FRAME_LEN];
+    if (p->tot_len == FRAME_LEN && pbuf_copy_partial(p, got, FRAME_LEN, 0) == FRAME_LEN) {
+        fill_frame(want, (uint8_t)s_rx_frames);
+        if (memcmp(got, want, FRAME_LEN) == 0) {
+            s_rx_frames++;
+        } else {
+            s_rx_bad++;
+        }
+    } else {
+        s_rx_bad++;
+    }
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+/* The transport hands received frames to the TinyPAN netif */
+struct netif* tinypan_netif_get(void) {
+    return &s_netif;
+}
+
+bool tinypan_netif_rx_admit(struct pbuf* p, uint16_t ip_offset) {
+    (void)p;
+    (void)ip_offset;
+    return true;
+}
+
+u32_t sys_now(void) {
+    return hal_get_tick_ms();
+}
+
+static void hal_event_cb(hal_l2cap_event_t event, int status, void* user_data) {
+    (void)status;
+    (void)user_data;
+    if (event == HAL_L2CAP_EVENT_CAN_SEND_NOW) {
+        s_can_send_events++;
+        s_slip->on_can_send_now();
+    }
+}
+
+/**
+ * Copy chunks accepted by the mock since the last call into s_wire
+ */
+static int collect_wire(void) {
+    mock_hal_conn_event_stats_t stats;
+    mock_hal_get_conn_event_stats(&stats);
+    uint32_t fresh = stats.packets_accepted - s_collected;
+    if (fresh > 5) return 0; /* Mock history depth */
+
+    for (int i = (int)fresh - 1; i >= 0; i--) {
+        uint16_t len = mock_hal_get_tx_history_len(i);
+        if (s_wire_len + len > sizeof(s_wire)) return 0;
+        memcpy(&s_wire[s_wire_len], mock_hal_get_tx_history_data(i), len);
+        s_wire_len += len;
+    }
+    s_collected = stats.packets_accepted;
+    return 1;
+}
+
+static void link_up(uint32_t pacing_bps) {
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+    hal_bt_l2cap_register_event_callback(hal_event_cb, NULL);
+    mock_hal_simulate_connect_success();
+    mock_hal_set_conn_event_model(CE_INTERVAL_MS, CE_PER_EVENT, CE_BUFFERS);
+    mock_hal_set_conn_event_hidden_buffers(true);
+    s_slip->init();
+    s_slip->on_connected();
+    tinypan_pacer_reset();
+    tinypan_pacer_set_rate(pacing_bps);
+    s_netif.input = loopback_input;
+    s_wire_len = 0;
+    s_collected = 0;
+    s_rx_frames = 0;
+    s_rx_bad = 0;
+    s_can_send_events = 0;
+}
+
+static void link_down(void) {
+    s_slip->on_disconnected();
+    s_slip->flush_queues();
+    mock_hal_set_conn_event_model(0, 0, 0);
+    hal_bt_deinit();
+}
+
+/**
+ * Queue frame number seq; returns false if the transport queue is full
+ */
+static int send_frame(uint8_t seq) {
+    uint8_t buf[FRAME_LEN];
+    fill_frame(buf, seq);
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, FRAME_LEN, PBUF_RAM);
+    if (p == NULL) return 0;
+    pbuf_take(p, buf, FRAME_LEN);
+    err_t err = s_slip->output(&s_netif, p);
+    pbuf_free(p);
+    return err == ERR_OK;
+}
+
+/** What tinypan_process() does for the pacer */
+static void poll_ms(void) {
+    mock_hal_advance_tick_ms(1);
+    hal_bt_poll();
+    if (tinypan_pacer_next_ms() == 0) {
+        s_slip->on_can_send_now();
+    }
+}
+
+typedef struct {
+    uint32_t busy_returns;
+    uint32_t can_send_events;
+    uint32_t residence_max_ms;
+    uint32_t residence_avg_ms;
+    uint32_t elapsed_ms;
+} burst_result_t;
+
+/**
+ * Send BURSTS bursts and run the link until every frame has been decoded
+ * @return 1 on success, 0 if frames were lost or corrupted
+ */
+static int run_bursts(uint32_t pacing_bps, burst_result_t* result) {
+    link_up(pacing_bps);
+
+    int sent = 0;
+    uint32_t t = 0;
+    while (s_rx_frames < BURSTS * BURST_FRAMES) {
+        if (t > 60000) return 0;
+        if (t % BURST_PERIOD_MS == 0 && sent < BURSTS * BURST_FRAMES) {
+            for (int i = 0; i < BURST_FRAMES; i++) {
+                if (!send_frame((uint8_t)sent)) return 0;
+                sent++;
+            }
+        }
+        poll_ms();
+        t++;
+        if (!collect_wire()) return 0;
+
+        /* Decode as the peer would */
+        s_slip->handle_incoming(s_wire, (uint16_t)s_wire_len);
+        s_wire_len = 0;
+    }
+
+    mock_hal_conn_event_stats_t stats;
+    mock_hal_get_conn_event_stats(&stats);
+    result->busy_returns = stats.busy_returns;
+    result->can_send_events = s_can_send_events;
+    result->residence_max_ms = stats.residence_max_ms;
+    result->residence_avg_ms = stats.packets_on_air ? stats.residence_total_ms / stats.packets_on_air : 0;
+    result->elapsed_ms = t;
+
+    int ok = (s_rx_bad == 0);
+    link_down();
+    return ok;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * The bucket starts full, may go into debt by one send, and reports the
+ * time until the debt is paid off
+ */
+static int test_token_bucket(void) {
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+    tinypan_pacer_reset();
+
+    /* No rate: never holds back */
+    if (!tinypan_pacer_admit(60000) || tinypan_pacer_next_ms() != 0xFFFFFFFF) return 0;
+
+    tinypan_pacer_reset();
+    tinypan_pacer_set_rate(10000); /* 10 bytes per ms */
+    if (!tinypan_pacer_admit(TINYPAN_PACING_BURST_BYTES)) return 0;
+    if (!tinypan_pacer_admit(200)) return 0;         /* Bucket at zero: admitted into debt */
+    if (tinypan_pacer_admit(1)) return 0;            /* 200 bytes of debt */
+    if (tinypan_pacer_next_ms() != 20) return 0;
+
+    mock_hal_advance_tick_ms(19);
+    if (tinypan_pacer_next_ms() != 1 || tinypan_pacer_admit(1)) return 0;
+    mock_hal_advance_tick_ms(1);
+    if (tinypan_pacer_next_ms() != 0 || !tinypan_pacer_admit(100)) return 0;
+
+    /* A refund of a busy send restores the tokens */
+    tinypan_pacer_refund(100);
+    if (!tinypan_pacer_admit(1)) return 0;
+
+    /* Idle time refills only up to the burst */
+    mock_hal_advance_tick_ms(10000);
+    if (!tinypan_pacer_admit(TINYPAN_PACING_BURST_BYTES)) return 0;
+    if (!tinypan_pacer_admit(10)) return 0;
+    int ok = !tinypan_pacer_admit(1) && tinypan_pacer_next_ms() == 1;
+
+    hal_bt_deinit();
+    return ok;
+}
+
+/**
+ * Bursts unpaced and paced at 90% of the link rate over a controller that
+ * only signals busy
+ */
+static int test_bursts_paced_vs_unpaced(void) {
+    burst_result_t unpaced;
+    burst_result_t paced;
+
+    if (!run_bursts(0, &unpaced)) return 0;
+    if (!run_bursts(LINK_BPS * 9 / 10, &paced)) return 0;
+
+    printf("\n    %-8s %6s %9s %14s %14s %8s\n", "mode", "busy", "can_send",
+           "residence max", "residence avg", "time");
+    printf("    %-8s %6u %9u %11u ms %11u ms %5u ms\n", "unpaced", (unsigned)unpaced.busy_returns,
+           (unsigned)unpaced.can_send_events, (unsigned)unpaced.residence_max_ms,
+           (unsigned)unpaced.residence_avg_ms, (unsigned)unpaced.elapsed_ms);
+    printf("    %-8s %6u %9u %11u ms %11u ms %5u ms\n    ", "paced", (unsigned)paced.busy_returns,
+           (unsigned)paced.can_send_events, (unsigned)paced.residence_max_ms,
+           (unsigned)paced.residence_avg_ms, (unsigned)paced.elapsed_ms);
+
+    /* Same traffic delivered in about the same time, without the busy cycles */
+    return unpaced.busy_returns > 0 &&
+           paced.busy_returns * 4 <= unpaced.busy_returns &&
+           paced.can_send_events * 4 <= unpaced.can_send_events &&
+           paced.residence_max_ms < unpaced.residence_max_ms &&
+           paced.residence_avg_ms < unpaced.residence_avg_ms &&
+           paced.elapsed_ms <= unpaced.elapsed_ms + BURST_PERIOD_MS / 2;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Pacing Tests\n");
+    printf("====================\n\n");
+
+    lwip_init();
+
+    printf("Running tests:\n");
+
+    TEST(token_bucket);
+    TEST(bursts_paced_vs_unpaced);
+
+    printf("\n====================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
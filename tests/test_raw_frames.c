@@ -0,0 +1,366 @@
+/*
+ * TinyPAN Test - Raw Ethernet Frames
+ *
+ * Full-stack runs against the simulated NAP: frames sent with
+ * tinypan_send_frame() must leave in submission order with lwIP's IP
+ * traffic, behind a compressed BNEP header for the NAP and a full one for
+ * other stations, and their payloads must stay referenced until
+ * TX_COMPLETE. Received frames of a registered ethertype must reach the
+ * handler in arrival order, while IPv4 and ARP frames interleaved with them
+ * still reach lwIP.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+#include "test_common.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define CLIENT_IP           0xC0A82C02  /* 192.168.44.2 */
+#define COLLECTOR_IP        0x0A141E32  /* 10.20.30.50, reached through the gateway */
+#define LOCAL_PORT          4000
+#define COLLECTOR_PORT      7000
+
+static struct udp_pcb* s_pcb;
+
+#define ETHERTYPE_L2        0x88B5      /* IEEE local experimental */
+#define ETHERTYPE_L2_ALT    0x88B6
+
+static const uint8_t s_peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x42 };
+
+/** Release callbacks, in the order they ran */
+static const void* s_released[8];
+static int s_release_count;
+
+static void on_done(const void* data, void* user_data) {
+    (void)user_data;
+    if (s_release_count < (int)(sizeof(s_released) / sizeof(s_released[0]))) {
+        s_released[s_release_count] = data;
+    }
+    s_release_count++;
+}
+
+/** Received frames, in the order the handler saw them */
+typedef struct {
+    uint16_t ethertype;
+    uint8_t src[6];
+    uint8_t payload[32];
+    uint16_t len;
+} rx_record_t;
+
+static rx_record_t s_rx[8];
+static int s_rx_count;
+
+static void on_frame(uint16_t ethertype, const uint8_t* dst_addr, const uint8_t* src_addr,
+                     const uint8_t* payload, uint16_t len, void* user_data) {
+    (void)dst_addr;
+    (void)user_data;
+    if (s_rx_count < (int)(sizeof(s_rx) / sizeof(s_rx[0]))) {
+        rx_record_t* r = &s_rx[s_rx_count];
+        r->ethertype = ethertype;
+        memcpy(r->src, src_addr, 6);
+        r->len = len;
+        memcpy(r->payload, payload, len < sizeof(r->payload) ? len : sizeof(r->payload));
+    }
+    s_rx_count++;
+}
+
+static void reset_logs(void) {
+    s_release_count = 0;
+    s_rx_count = 0;
+}
+
+/** Host-order address as tinypan takes it (network byte order) */
+static uint32_t net_addr(uint32_t host) {
+    uint32_t net;
+    uint8_t* b = (uint8_t*)&net;
+    b[0] = (uint8_t)(host >> 24);
+    b[1] = (uint8_t)(host >> 16);
+    b[2] = (uint8_t)(host >> 8);
+    b[3] = (uint8_t)host;
+    return net;
+}
+
+static void fill(uint8_t* buf, uint16_t len, uint8_t seed) {
+    for (uint16_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+/** The n-th newest frame on the link is a valid datagram to the collector carrying payload */
+static int sent_udp(int index_from_newest, uint16_t src_port, const uint8_t* payload, uint16_t len) {
+    dhcp_sim_udp_t udp;
+    if (!dhcp_sim_parse_udp(mock_hal_get_tx_history_data(index_from_newest),
+                            mock_hal_get_tx_history_len(index_from_newest), &udp)) {
+        return 0;
+    }
+    return udp.src_ip == CLIENT_IP && udp.dst_ip == COLLECTOR_IP &&
+           udp.src_port == src_port && udp.dst_port == COLLECTOR_PORT &&
+           udp.ip_checksum_ok && udp.udp_checksum_ok &&
+           udp.payload_len == len && memcmp(udp.payload, payload, len) == 0;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/** The n-th newest frame on the link is payload behind the expected BNEP header */
+static int sent_raw(int index_from_newest, const uint8_t* dst, const uint8_t* payload, uint16_t len) {
+    const uint8_t* tx = mock_hal_get_tx_history_data(index_from_newest);
+    uint16_t tx_len = mock_hal_get_tx_history_len(index_from_newest);
+    uint16_t hdr;
+
+    if (tx == NULL) return 0;
+    if (dst == NULL) {
+        /* Compressed Ethernet: type, ethertype */
+        if (tx[0] != BNEP_PKT_TYPE_COMPRESSED_ETHERNET) return 0;
+        hdr = 1;
+    } else {
+        /* General Ethernet: type, dst, src, ethertype */
+        if (tx[0] != BNEP_PKT_TYPE_GENERAL_ETHERNET || memcmp(&tx[1], dst, 6) != 0 ||
+            memcmp(&tx[7], s_client_mac, 6) != 0) {
+            return 0;
+        }
+        hdr = 13;
+    }
+    return tx_len == hdr + 2 + len && tx[hdr] == (ETHERTYPE_L2 >> 8) &&
+           tx[hdr + 1] == (ETHERTYPE_L2 & 0xFF) && memcmp(&tx[hdr + 2], payload, len) == 0;
+}
+
+/** Receive a compressed BNEP frame from the NAP */
+static void receive_frame(uint16_t ethertype, const uint8_t* payload, uint16_t len) {
+    uint8_t pkt[64];
+    pkt[0] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET;
+    pkt[1] = (uint8_t)(ethertype >> 8);
+    pkt[2] = (uint8_t)ethertype;
+    memcpy(&pkt[3], payload, len);
+    mock_hal_simulate_receive(pkt, (uint16_t)(3 + len));
+    tinypan_process();
+}
+
+/** Whether one of the newest n frames is an ARP reply */
+static int arp_reply_sent(int newest) {
+    for (int i = 0; i < newest; i++) {
+        const uint8_t* tx = mock_hal_get_tx_history_data(i);
+        uint16_t tx_len = mock_hal_get_tx_history_len(i);
+        /* Compressed header to the NAP: ethertype at 1, opcode at 3 + 6 */
+        if (tx != NULL && tx_len >= 3 + 28 && tx[0] == BNEP_PKT_TYPE_COMPRESSED_ETHERNET &&
+            tx[1] == 0x08 && tx[2] == 0x06 && tx[3 + 7] == 0x02) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * A frame for the NAP goes out behind the 3-byte compressed header; the
+ * payload is released on TX_COMPLETE, not when it is handed to the radio
+ */
+static int test_send_to_nap(void) {
+    static const uint8_t payload[] = "hello companion";
+
+    if (bring_online() < 0) return 0;
+    s_pcb = udp_new();
+    if (s_pcb == NULL || udp_bind(s_pcb, IP_ADDR_ANY, LOCAL_PORT) != ERR_OK) return 0;
+
+    reset_logs();
+    uint32_t before = mock_hal_get_tx_count();
+    if (tinypan_send_frame(NULL, ETHERTYPE_L2, payload, sizeof(payload), on_done, NULL) != TINYPAN_OK) {
+        return 0;
+    }
+    if (mock_hal_get_tx_count() != before + 1 || s_release_count != 0) return 0;
+    if (!sent_raw(0, NULL, payload, sizeof(payload))) return 0;
+
+    settle();
+    return s_release_count == 1 && s_released[0] == payload;
+}
+
+/**
+ * Any other station is addressed with the full header
+ */
+static int test_send_to_peer(void) {
+    static const uint8_t payload[] = { 1, 2, 3, 4, 5 };
+
+    reset_logs();
+    if (tinypan_send_frame(s_peer_mac, ETHERTYPE_L2, payload, sizeof(payload), on_done, NULL) != TINYPAN_OK) {
+        return 0;
+    }
+    settle();
+    return sent_raw(0, s_peer_mac, payload, sizeof(payload)) && s_release_count == 1;
+}
+
+/**
+ * Raw frames and lwIP datagrams queued together leave in submission order;
+ * a frame refused for a full queue is never released
+ */
+static int test_tx_order(void) {
+    static const uint8_t a[] = "raw-a";
+    static const uint8_t c[] = "raw-c";
+    static const uint8_t e[] = "raw-e";
+    uint8_t b[24], d[40];
+    ip_addr_t dst;
+
+    reset_logs();
+    fill(b, sizeof(b), 0x10);
+    fill(d, sizeof(d), 0x20);
+    ip_addr_set_ip4_u32(&dst, net_addr(COLLECTOR_IP));
+
+    mock_hal_set_can_send(false);
+    if (tinypan_send_frame(NULL, ETHERTYPE_L2, a, sizeof(a), on_done, NULL) != TINYPAN_OK) return 0;
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, sizeof(b), PBUF_RAM);
+    if (p == NULL) return 0;
+    pbuf_take(p, b, sizeof(b));
+    err_t err = udp_sendto(s_pcb, p, &dst, COLLECTOR_PORT);
+    pbuf_free(p);
+    if (err != ERR_OK) return 0;
+    if (tinypan_send_frame(s_peer_mac, ETHERTYPE_L2, c, sizeof(c), on_done, NULL) != TINYPAN_OK) return 0;
+    p = pbuf_alloc(PBUF_TRANSPORT, sizeof(d), PBUF_RAM);
+    if (p == NULL) return 0;
+    pbuf_take(p, d, sizeof(d));
+    err = udp_sendto(s_pcb, p, &dst, COLLECTOR_PORT);
+    pbuf_free(p);
+    if (err != ERR_OK) return 0;
+
+    /* TINYPAN_TX_QUEUE_LEN - 1 frames fit */
+    if (tinypan_send_frame(NULL, ETHERTYPE_L2, e, sizeof(e), on_done, NULL) != TINYPAN_ERR_BUSY) return 0;
+
+    uint32_t before = mock_hal_get_tx_count();
+    mock_hal_set_can_send(true);
+    hal_bt_l2cap_request_can_send_now();
+    settle();
+    settle();
+
+    return mock_hal_get_tx_count() == before + 4 &&
+           sent_raw(3, NULL, a, sizeof(a)) && sent_udp(2, LOCAL_PORT, b, sizeof(b)) &&
+           sent_raw(1, s_peer_mac, c, sizeof(c)) && sent_udp(0, LOCAL_PORT, d, sizeof(d)) &&
+           s_release_count == 2 && s_released[0] == a && s_released[1] == c;
+}
+
+/**
+ * Only IPv4 and ARP are reserved; the handler table has a fixed size
+ */
+static int test_register(void) {
+    if (tinypan_register_ethertype_handler(0x0800, on_frame, NULL) != TINYPAN_ERR_INVALID_PARAM) return 0;
+    if (tinypan_register_ethertype_handler(0x0806, on_frame, NULL) != TINYPAN_ERR_INVALID_PARAM) return 0;
+    if (tinypan_register_ethertype_handler(0x05DC, on_frame, NULL) != TINYPAN_ERR_INVALID_PARAM) return 0;
+
+    if (tinypan_register_ethertype_handler(ETHERTYPE_L2, on_frame, NULL) != TINYPAN_OK) return 0;
+    if (tinypan_register_ethertype_handler(ETHERTYPE_L2_ALT, on_frame, NULL) != TINYPAN_OK) return 0;
+    if (tinypan_register_ethertype_handler(0x88B7, on_frame, NULL) != TINYPAN_ERR_NO_MEMORY) return 0;
+    /* Re-registering replaces in place */
+    if (tinypan_register_ethertype_handler(ETHERTYPE_L2, on_frame, NULL) != TINYPAN_OK) return 0;
+    if (tinypan_register_ethertype_handler(ETHERTYPE_L2_ALT, NULL, NULL) != TINYPAN_OK) return 0;
+    return tinypan_register_ethertype_handler(0x88B7, on_frame, NULL) == TINYPAN_OK &&
+           tinypan_register_ethertype_handler(0x88B7, NULL, NULL) == TINYPAN_OK;
+}
+
+/**
+ * Registered frames reach the handler in arrival order; an ARP request
+ * between them still reaches lwIP, which answers it
+ */
+static int test_rx_dispatch(void) {
+    static const uint8_t arp_request[28] = {
+        0x00, 0x01, 0x08, 0x00, 6, 4, 0x00, 0x01,
+        0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 192, 168, 44, 1,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 192, 168, 44, 2
+    };
+
+    reset_logs();
+    uint32_t before = mock_hal_get_tx_count();
+    receive_frame(ETHERTYPE_L2, (const uint8_t*)"first", 5);
+    receive_frame(0x0806, arp_request, sizeof(arp_request));
+    receive_frame(ETHERTYPE_L2, (const uint8_t*)"second", 6);
+    settle();
+
+    if (s_rx_count != 2 || s_rx[0].ethertype != ETHERTYPE_L2 ||
+        memcmp(s_rx[0].src, s_sim.server_mac, 6) != 0 ||
+        s_rx[0].len != 5 || memcmp(s_rx[0].payload, "first", 5) != 0 ||
+        s_rx[1].len != 6 || memcmp(s_rx[1].payload, "second", 6) != 0) {
+        return 0;
+    }
+    uint32_t sent = mock_hal_get_tx_count() - before;
+    if (sent == 0 || !arp_reply_sent((int)sent)) return 0;
+
+    /* Unregistered: lwIP gets it (and ignores the unknown ethertype) */
+    tinypan_register_ethertype_handler(ETHERTYPE_L2, NULL, NULL);
+    receive_frame(ETHERTYPE_L2, (const uint8_t*)"third", 5);
+    return s_rx_count == 2;
+}
+
+/**
+ * Stopping drops queued frames and releases their payloads unsent; with
+ * BNEP down, sends are refused
+ */
+static int test_release_on_flush(void) {
+    static const uint8_t a[] = "queued";
+
+    reset_logs();
+    mock_hal_set_can_send(false);
+    if (tinypan_send_frame(NULL, ETHERTYPE_L2, a, sizeof(a), on_done, NULL) != TINYPAN_OK) return 0;
+    uint32_t before = mock_hal_get_tx_count();
+
+    udp_remove(s_pcb);
+    s_pcb = NULL;
+    tinypan_stop();
+    mock_hal_set_can_send(true);
+    settle();
+    if (s_release_count != 1 || s_released[0] != a || mock_hal_get_tx_count() != before) return 0;
+
+    return tinypan_send_frame(NULL, ETHERTYPE_L2, a, sizeof(a), on_done, NULL) == TINYPAN_ERR_NOT_STARTED &&
+           s_release_count == 1;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Raw Frame Tests\n");
+    printf("=======================\n\n");
+
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(send_to_nap);
+    TEST(send_to_peer);
+    TEST(tx_order);
+    TEST(register);
+    TEST(rx_dispatch);
+    TEST(release_on_flush);
+
+    tinypan_deinit();
+
+    printf("\n=======================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,326 @@
+/*
+ * TinyPAN Test - Reconnect Policy
+ *
+ * Runs the full stack over the mock HAL and fails it in each of the ways
+ * the supervisor classifies: a dropped link comes back on the fast-retry
+ * path and reconnects far sooner than a NAP that went away, each failure
+ * class stays on its own backoff curve, and devices with different
+ * addresses that lose the same phone at the same moment spread their
+ * attempts out instead of paging it in step. Port-local failure statuses
+ * are classified from the supervisor state, never as HCI reasons.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "../src/tinypan_internal.h"
+#include "../src/tinypan_reconnect.h"
+#include "test_common.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define INTERVAL_MS     1000        /* reconnect_interval_ms default */
+#define MAX_MS          30000       /* reconnect_max_ms default */
+#define OUTAGES         10
+
+static const uint8_t s_default_addr[6] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+/**
+ * Sleep until the supervisor pages the NAP again
+ * @return milliseconds waited
+ */
+static uint32_t wait_attempt(void) {
+    uint32_t start = hal_get_tick_ms();
+    while (tinypan_get_state() != TINYPAN_STATE_CONNECTING &&
+           hal_get_tick_ms() - start < 2 * MAX_MS) {
+        sleep_step();
+    }
+    return hal_get_tick_ms() - start;
+}
+
+static uint32_t last_delay(void) {
+    tinypan_reconnect_stats_t stats;
+    tinypan_get_reconnect_stats(&stats);
+    return stats.last_delay_ms;
+}
+
+/**
+ * Start the stack with the default configuration
+ */
+static int bring_up(void) {
+    tinypan_config_t config;
+    nap_config(&config);
+    return start_stack(&config, NULL);
+}
+
+/**
+ * Drop an online link with an HCI reason and time it back to ONLINE
+ * (every handshake answered at once)
+ */
+static uint32_t outage(int reason) {
+    uint32_t down_at = hal_get_tick_ms();
+    mock_hal_simulate_disconnect_reason(reason);
+    tinypan_process();
+    wait_attempt();
+    complete_bring_up();
+    return hal_get_tick_ms() - down_at;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * A dropped link is back sooner than one whose phone went away
+ */
+static int test_transient_reconnects_fast(void) {
+    if (!bring_up()) return 0;
+    complete_bring_up();
+
+    uint32_t transient_ms = 0;
+    uint32_t unreachable_ms = 0;
+    bool online = true;
+    for (int i = 0; i < OUTAGES; i++) {
+        transient_ms += outage(HAL_HCI_ERR_CONN_TIMEOUT);
+        online = online && tinypan_get_state() == TINYPAN_STATE_ONLINE;
+        unreachable_ms += outage(HAL_HCI_ERR_REMOTE_POWER_OFF);
+        online = online && tinypan_get_state() == TINYPAN_STATE_ONLINE;
+    }
+
+    tinypan_reconnect_stats_t stats;
+    tinypan_get_reconnect_stats(&stats);
+    printf("\n    mean time to reconnect over %u outages each: supervision timeout %u ms,"
+           " phone powered off %u ms (plain doubling: %u ms for both)\n    ",
+           (unsigned)OUTAGES, (unsigned)(transient_ms / OUTAGES),
+           (unsigned)(unreachable_ms / OUTAGES), (unsigned)INTERVAL_MS);
+    tear_down();
+
+    return online &&
+           transient_ms / OUTAGES <= TINYPAN_RECONNECT_FAST_MS &&
+           unreachable_ms / OUTAGES >= INTERVAL_MS &&
+           stats.failures[TINYPAN_RECONNECT_TRANSIENT] == OUTAGES &&
+           stats.failures[TINYPAN_RECONNECT_UNREACHABLE] == OUTAGES &&
+           stats.fast_retries == OUTAGES && stats.recoveries == 2 * OUTAGES &&
+           stats.time_ms[TINYPAN_RECONNECT_TRANSIENT] == transient_ms &&
+           stats.time_ms[TINYPAN_RECONNECT_UNREACHABLE] == unreachable_ms;
+}
+
+/**
+ * The fast retries run out and decorrelated jitter takes over
+ */
+static int test_fast_retries_then_backoff(void) {
+    if (!bring_up()) return 0;
+    complete_bring_up();
+
+    mock_hal_simulate_disconnect_reason(HAL_HCI_ERR_CONN_TIMEOUT);
+    tinypan_process();
+
+    bool in_range = true;
+    bool on_time = true;
+    uint32_t prev = 0;
+    uint32_t delays[8];
+    for (int i = 0; i < 8; i++) {
+        uint32_t delay = last_delay();
+        delays[i] = delay;
+        on_time = on_time && (wait_attempt() == delay);
+
+        if (i < TINYPAN_RECONNECT_FAST_RETRIES) {
+            in_range = in_range && delay >= TINYPAN_RECONNECT_FAST_MS / 2 &&
+                       delay <= TINYPAN_RECONNECT_FAST_MS;
+        } else {
+            uint32_t hi = (prev == 0) ? 3 * INTERVAL_MS : 3 * prev;
+            in_range = in_range && delay >= INTERVAL_MS && delay <= ((hi > MAX_MS) ? MAX_MS : hi);
+            prev = delay;
+        }
+        /* The phone is still not answering */
+        mock_hal_simulate_connect_failure(HAL_HCI_ERR_CONN_FAILED_TO_ESTABLISH);
+        tinypan_process();
+    }
+    printf("\n    link never comes back, delays:");
+    for (int i = 0; i < 8; i++) {
+        printf(" %u", (unsigned)delays[i]);
+    }
+    printf(" ms\n    ");
+
+    tinypan_reconnect_stats_t stats;
+    tinypan_get_reconnect_stats(&stats);
+    tear_down();
+
+    return in_range && on_time &&
+           stats.fast_retries == TINYPAN_RECONNECT_FAST_RETRIES &&
+           stats.failures[TINYPAN_RECONNECT_TRANSIENT] == 9;
+}
+
+/**
+ * Authentication failures, BNEP rejects and silence each keep their curve
+ */
+static int test_reason_curves(void) {
+    if (!bring_up()) return 0;
+
+    /* Authentication failed: half of reconnect_max_ms and up */
+    bool in_range = true;
+    uint32_t auth_ms = 0;
+    for (int i = 0; i < 3; i++) {
+        mock_hal_simulate_connect_failure(HAL_HCI_ERR_AUTH_FAILURE);
+        tinypan_process();
+        uint32_t delay = last_delay();
+        in_range = in_range && delay >= MAX_MS / 2 && delay <= MAX_MS;
+        auth_ms += wait_attempt();
+    }
+
+    /* BNEP setup refused: four times reconnect_interval_ms and up */
+    mock_hal_simulate_connect_success();
+    tinypan_process();
+    const uint8_t setup_rsp[4] = { BNEP_PKT_TYPE_CONTROL, BNEP_CTRL_SETUP_CONNECTION_RESPONSE,
+                                   0x00, BNEP_SETUP_RESPONSE_NOT_ALLOWED };
+    mock_hal_simulate_receive(setup_rsp, sizeof(setup_rsp));
+    tinypan_process();
+    uint32_t rejected = last_delay();
+    uint32_t rejected_ms = wait_attempt();
+
+    /* Unknown HAL error: the plain curve */
+    mock_hal_simulate_connect_failure(-1);
+    tinypan_process();
+    uint32_t unreachable = last_delay();
+    uint32_t unreachable_ms = wait_attempt();
+
+    tinypan_reconnect_stats_t stats;
+    tinypan_get_reconnect_stats(&stats);
+    printf("\n    auth failures wait %u ms in all, BNEP reject %u ms, unknown error %u ms\n    ",
+           (unsigned)auth_ms, (unsigned)rejected_ms, (unsigned)unreachable_ms);
+    tear_down();
+
+    return in_range &&
+           rejected >= 4 * INTERVAL_MS && rejected <= 12 * INTERVAL_MS &&
+           unreachable >= INTERVAL_MS && unreachable <= 3 * INTERVAL_MS &&
+           stats.failures[TINYPAN_RECONNECT_AUTH] == 3 &&
+           stats.failures[TINYPAN_RECONNECT_REJECTED] == 1 &&
+           stats.failures[TINYPAN_RECONNECT_UNREACHABLE] == 1 &&
+           stats.failures[TINYPAN_RECONNECT_TRANSIENT] == 0 &&
+           stats.time_ms[TINYPAN_RECONNECT_AUTH] == auth_ms &&
+           stats.time_ms[TINYPAN_RECONNECT_REJECTED] == rejected_ms &&
+           stats.time_ms[TINYPAN_RECONNECT_UNREACHABLE] >= unreachable_ms &&
+           stats.last_reason == TINYPAN_RECONNECT_UNREACHABLE;
+}
+
+/**
+ * Eight devices lose the same phone at the same moment
+ */
+static int test_fleet_spread(void) {
+    enum { DEVICES = 8, ATTEMPTS = 3 };
+    uint32_t attempt_at[DEVICES][ATTEMPTS];
+
+    for (int d = 0; d < DEVICES; d++) {
+        uint8_t addr[6];
+        memcpy(addr, s_default_addr, sizeof(addr));
+        addr[5] = (uint8_t)(0x10 + d);
+        mock_hal_set_local_addr(addr);
+        if (!bring_up()) return 0;
+
+        uint32_t lost_at = hal_get_tick_ms();
+        for (int a = 0; a < ATTEMPTS; a++) {
+            mock_hal_simulate_connect_failure(HAL_HCI_ERR_PAGE_TIMEOUT);
+            tinypan_process();
+            wait_attempt();
+            attempt_at[d][a] = hal_get_tick_ms() - lost_at;
+        }
+        tear_down();
+    }
+    mock_hal_set_local_addr(s_default_addr);
+
+    /* No two devices page the phone at the same moment */
+    bool apart = true;
+    for (int a = 0; a < ATTEMPTS; a++) {
+        for (int d = 0; d < DEVICES; d++) {
+            for (int e = d + 1; e < DEVICES; e++) {
+                apart = apart && attempt_at[d][a] != attempt_at[e][a];
+            }
+        }
+    }
+    uint32_t lo = attempt_at[0][0];
+    uint32_t hi = attempt_at[0][0];
+    for (int d = 1; d < DEVICES; d++) {
+        lo = (attempt_at[d][0] < lo) ? attempt_at[d][0] : lo;
+        hi = (attempt_at[d][0] > hi) ? attempt_at[d][0] : hi;
+    }
+    printf("\n    first retries of %u devices spread over %u ms (plain doubling: all at %u ms)\n    ",
+           (unsigned)DEVICES, (unsigned)(hi - lo), (unsigned)INTERVAL_MS);
+
+    return apart && hi - lo >= INTERVAL_MS / 2;
+}
+
+/**
+ * Port-local statuses (the ESP32 port's negated esp_bt_l2cap_status_t)
+ * take the supervisor's class, never an HCI one
+ */
+static int test_port_statuses(void) {
+    /* ESP_BT_L2CAP_FAILURE, NO_RESOURCE, BUSY, NEED_INIT, NEED_DEINIT, NO_CONNECTION */
+    bool fallback = true;
+    for (int status = 1; status <= 6; status++) {
+        fallback = fallback &&
+                   tinypan_reconnect_classify(-status, TINYPAN_RECONNECT_UNREACHABLE) == TINYPAN_RECONNECT_UNREACHABLE &&
+                   tinypan_reconnect_classify(-status, TINYPAN_RECONNECT_TRANSIENT) == TINYPAN_RECONNECT_TRANSIENT;
+    }
+
+    /* NEED_DEINIT and NO_CONNECTION passed raw would read as an auth failure */
+    if (!bring_up()) return 0;
+    mock_hal_simulate_connect_failure(-5);
+    tinypan_process();
+    wait_attempt();
+    mock_hal_simulate_connect_failure(-6);
+    tinypan_process();
+    wait_attempt();
+
+    tinypan_reconnect_stats_t stats;
+    tinypan_get_reconnect_stats(&stats);
+    tear_down();
+
+    return fallback &&
+           tinypan_reconnect_classify(5, TINYPAN_RECONNECT_UNREACHABLE) == TINYPAN_RECONNECT_AUTH &&
+           stats.failures[TINYPAN_RECONNECT_AUTH] == 0 &&
+           stats.failures[TINYPAN_RECONNECT_UNREACHABLE] == 2;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Reconnect Policy Tests\n");
+    printf("==============================\n\n");
+
+    printf("Running tests:\n");
+
+    TEST(transient_reconnects_fast);
+    TEST(fast_retries_then_backoff);
+    TEST(reason_curves);
+    TEST(fleet_spread);
+    TEST(port_statuses);
+
+    printf("\n==============================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
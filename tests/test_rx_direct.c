@@ -0,0 +1,362 @@
+/*
+ * TinyPAN Test - Direct RX Delivery
+ *
+ * Models an RTOS build with threads: the mock HAL's pthread reader plays the
+ * ESP32 port's RX task, a second thread plays the application task calling
+ * hal_bt_poll(), and a third plays lwIP's tcpip thread, fed through a mailbox
+ * the way tcpip_input() is. Frames are timestamped when they leave the
+ * "radio" and again when the tcpip thread dequeues them, once through the
+ * queued path (reader -> bridge queue -> app task -> BNEP) and once through
+ * bnep_handle_incoming_direct() in the reader.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define FRAMES          4000
+#define FRAME_GAP_US    100
+#define PAYLOAD_LEN     200
+#define MBOX_LEN        64
+#define DRAIN_TIMEOUT_S 5
+
+static const uint8_t s_local[6] = { 0x12, 0x22, 0x33, 0x44, 0x55, 0x66 };
+static const uint8_t s_remote[6] = { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* --- "tcpip thread": a mailbox of copied frames, like tcpip_input() --- */
+
+typedef struct {
+    uint64_t sent_ns;
+    uint8_t data[PAYLOAD_LEN];
+} mbox_msg_t;
+
+static mbox_msg_t s_mbox[MBOX_LEN];
+static uint32_t s_mbox_head;
+static uint32_t s_mbox_tail;
+static pthread_mutex_t s_mbox_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_mbox_cond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t s_latency_ns[FRAMES];
+static int s_received;
+static bool s_tcpip_running;
+
+static void* tcpip_thread_fn(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&s_mbox_lock);
+    for (;;) {
+        while (s_tcpip_running && s_mbox_head == s_mbox_tail) {
+            pthread_cond_wait(&s_mbox_cond, &s_mbox_lock);
+        }
+        if (s_mbox_head == s_mbox_tail) {
+            break;
+        }
+        uint64_t sent = s_mbox[s_mbox_head % MBOX_LEN].sent_ns;
+        s_mbox_head++;
+        if (s_received < FRAMES) {
+            s_latency_ns[s_received] = now_ns() - sent;
+        }
+        s_received++;
+        pthread_cond_broadcast(&s_mbox_cond);
+    }
+    pthread_mutex_unlock(&s_mbox_lock);
+    return NULL;
+}
+
+/* --- "application task": sleeps until woken, then runs hal_bt_poll() --- */
+
+static pthread_t s_app_thread;
+static pthread_mutex_t s_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_wake_cond = PTHREAD_COND_INITIALIZER;
+static bool s_wake;
+static bool s_app_running;
+
+static void wakeup_cb(void* user_data) {
+    (void)user_data;
+    pthread_mutex_lock(&s_wake_lock);
+    s_wake = true;
+    pthread_cond_signal(&s_wake_cond);
+    pthread_mutex_unlock(&s_wake_lock);
+}
+
+static void* app_thread_fn(void* arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&s_wake_lock);
+        while (s_app_running && !s_wake) {
+            pthread_cond_wait(&s_wake_cond, &s_wake_lock);
+        }
+        bool running = s_app_running;
+        s_wake = false;
+        pthread_mutex_unlock(&s_wake_lock);
+        if (!running) {
+            break;
+        }
+        hal_bt_poll();
+    }
+    return NULL;
+}
+
+/* --- TinyPAN side --- */
+
+static int s_frames_in_app;     /* Data frames delivered from the app task */
+static int s_controls_in_app;   /* Control packets handled in the app task */
+static int s_controls;
+
+static bool in_app_thread(void) {
+    return s_app_running && pthread_equal(pthread_self(), s_app_thread);
+}
+
+/** Stands in for tinypan_netif_input(): copy into a buffer, post to tcpip */
+static void on_frame(const bnep_ethernet_frame_t* frame, void* user_data) {
+    (void)user_data;
+    if (in_app_thread()) {
+        s_frames_in_app++;
+    }
+    pthread_mutex_lock(&s_mbox_lock);
+    while (s_mbox_tail - s_mbox_head == MBOX_LEN) {
+        pthread_cond_wait(&s_mbox_cond, &s_mbox_lock);
+    }
+    mbox_msg_t* msg = &s_mbox[s_mbox_tail % MBOX_LEN];
+    uint16_t n = frame->payload_len < PAYLOAD_LEN ? frame->payload_len : PAYLOAD_LEN;
+    memcpy(msg->data, frame->payload, n);
+    memcpy(&msg->sent_ns, frame->payload, sizeof(msg->sent_ns));
+    s_mbox_tail++;
+    pthread_cond_broadcast(&s_mbox_cond);
+    pthread_mutex_unlock(&s_mbox_lock);
+}
+
+static void on_filter_response(uint16_t response_code, void* user_data) {
+    (void)response_code;
+    (void)user_data;
+    s_controls++;
+    if (in_app_thread()) {
+        s_controls_in_app++;
+    }
+}
+
+static void app_recv(const uint8_t* data, uint16_t len, void* user_data) {
+    (void)user_data;
+    bnep_handle_incoming(data, len);
+}
+
+static bool direct_recv(const uint8_t* data, uint16_t len, void* user_data) {
+    (void)user_data;
+    return bnep_handle_incoming_direct(data, len);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+} latency_t;
+
+/**
+ * @brief Stream FRAMES timestamped frames (and one control packet) through
+ *        the threaded mock
+ * @return Number of data frames the tcpip thread received
+ */
+static int run(bool direct, latency_t* lat) {
+    static const uint8_t setup_resp[4] = { BNEP_PKT_TYPE_CONTROL, BNEP_CTRL_SETUP_CONNECTION_RESPONSE, 0x00, 0x00 };
+    static const uint8_t filter_resp[4] = { BNEP_PKT_TYPE_CONTROL, BNEP_CTRL_FILTER_MULTI_ADDR_RESPONSE, 0x00, 0x00 };
+    pthread_t tcpip;
+
+    hal_bt_init();
+    mock_hal_simulate_connect_success();
+    bnep_init();
+    bnep_set_local_addr(s_local);
+    bnep_set_remote_addr(s_remote);
+    bnep_register_frame_callback(on_frame, NULL);
+    bnep_register_filter_response_callback(on_filter_response, NULL);
+    bnep_on_l2cap_connected();
+    bnep_handle_incoming(setup_resp, sizeof(setup_resp));
+    if (!bnep_is_connected()) {
+        hal_bt_deinit();
+        return -1;
+    }
+
+    hal_bt_l2cap_register_recv_callback(app_recv, NULL);
+    hal_bt_l2cap_register_direct_recv_callback(direct ? direct_recv : NULL, NULL);
+    hal_bt_set_wakeup_callback(wakeup_cb, NULL);
+
+    s_mbox_head = s_mbox_tail = 0;
+    s_received = 0;
+    s_frames_in_app = 0;
+    s_controls = 0;
+    s_controls_in_app = 0;
+    s_tcpip_running = true;
+    s_app_running = true;
+    s_wake = false;
+    pthread_create(&tcpip, NULL, tcpip_thread_fn, NULL);
+    pthread_create(&s_app_thread, NULL, app_thread_fn, NULL);
+    mock_hal_rx_thread_start();
+
+    /* Compressed Ethernet (dst = us, src = NAP): type, ethertype, payload */
+    uint8_t pkt[3 + PAYLOAD_LEN];
+    memset(pkt, 0x5A, sizeof(pkt));
+    pkt[0] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET;
+    pkt[1] = 0x08;
+    pkt[2] = 0x00;
+    struct timespec gap = { 0, FRAME_GAP_US * 1000L };
+
+    for (int i = 0; i < FRAMES; i++) {
+        if (i == FRAMES / 2) {
+            mock_hal_rx_thread_inject(filter_resp, sizeof(filter_resp));
+        }
+        uint64_t t = now_ns();
+        memcpy(pkt + 3, &t, sizeof(t));
+        mock_hal_rx_thread_inject(pkt, sizeof(pkt));
+        nanosleep(&gap, NULL);
+    }
+
+    /* Wait for the tcpip thread to catch up */
+    uint64_t deadline = now_ns() + (uint64_t)DRAIN_TIMEOUT_S * 1000000000u;
+    pthread_mutex_lock(&s_mbox_lock);
+    while (s_received < FRAMES && now_ns() < deadline) {
+        pthread_mutex_unlock(&s_mbox_lock);
+        nanosleep(&gap, NULL);
+        pthread_mutex_lock(&s_mbox_lock);
+    }
+    s_tcpip_running = false;
+    pthread_cond_broadcast(&s_mbox_cond);
+    pthread_mutex_unlock(&s_mbox_lock);
+    pthread_join(tcpip, NULL);
+
+    mock_hal_rx_thread_stop();
+    pthread_mutex_lock(&s_wake_lock);
+    s_app_running = false;
+    pthread_cond_signal(&s_wake_cond);
+    pthread_mutex_unlock(&s_wake_lock);
+    pthread_join(s_app_thread, NULL);
+    hal_bt_deinit();
+
+    int n = s_received < FRAMES ? s_received : FRAMES;
+    double sum = 0;
+    qsort(s_latency_ns, (size_t)n, sizeof(s_latency_ns[0]), compare_u64);
+    for (int i = 0; i < n; i++) {
+        sum += (double)s_latency_ns[i];
+    }
+    memset(lat, 0, sizeof(*lat));
+    if (n > 0) {
+        lat->mean_us = sum / n / 1000.0;
+        lat->p50_us = (double)s_latency_ns[n / 2] / 1000.0;
+        lat->p99_us = (double)s_latency_ns[(n * 99) / 100] / 1000.0;
+        lat->max_us = (double)s_latency_ns[n - 1] / 1000.0;
+    }
+    return s_received;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Queued path: every frame reaches tcpip, through the application task
+ */
+static int test_queued_path(void) {
+    latency_t lat;
+    int received = run(false, &lat);
+    return received == FRAMES && s_frames_in_app == FRAMES &&
+           s_controls == 1 && s_controls_in_app == 1;
+}
+
+/**
+ * Direct path: every data frame reaches tcpip without the application task,
+ * while the control packet is still handled there
+ */
+static int test_direct_path(void) {
+    latency_t lat;
+    int received = run(true, &lat);
+    return received == FRAMES && s_frames_in_app == 0 &&
+           s_controls == 1 && s_controls_in_app == 1;
+}
+
+/**
+ * Direct path declines everything before BNEP setup completes
+ */
+static int test_direct_waits_for_setup(void) {
+    static const uint8_t frame[4] = { BNEP_PKT_TYPE_COMPRESSED_ETHERNET, 0x08, 0x00, 0x45 };
+    bnep_init();
+    bool before = bnep_handle_incoming_direct(frame, sizeof(frame));
+    static const uint8_t control[4] = { BNEP_PKT_TYPE_CONTROL, BNEP_CTRL_FILTER_MULTI_ADDR_RESPONSE, 0x00, 0x00 };
+    bool control_taken = bnep_handle_incoming_direct(control, sizeof(control));
+    return !before && !control_taken;
+}
+
+/**
+ * Per-frame latency from the radio to the tcpip thread, both paths
+ */
+static int test_latency(void) {
+    latency_t queued, direct;
+    int ok_q = run(false, &queued);
+    int ok_d = run(true, &direct);
+
+    printf("\n");
+    printf("    %-8s %10s %10s %10s %10s\n", "path", "mean us", "p50 us", "p99 us", "max us");
+    printf("    %-8s %10.1f %10.1f %10.1f %10.1f\n", "queued",
+           queued.mean_us, queued.p50_us, queued.p99_us, queued.max_us);
+    printf("    %-8s %10.1f %10.1f %10.1f %10.1f\n", "direct",
+           direct.mean_us, direct.p50_us, direct.p99_us, direct.max_us);
+    printf("    ");
+    return ok_q == FRAMES && ok_d == FRAMES;   /* Timing is informational */
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Direct RX Tests\n");
+    printf("=======================\n\n");
+
+    printf("Running tests:\n");
+
+    TEST(queued_path);
+    TEST(direct_path);
+    TEST(direct_waits_for_setup);
+    TEST(latency);
+
+    printf("\n=======================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,911 @@
+/*
+ * TinyPAN Test - SLIP TX Flow Control
+ *
+ * Runs the SLIP transport against the mock HAL's connection-event model to
+ * check that buffered chunks fill every free controller slot, that the byte
+ * stream survives congestion, and to benchmark goodput versus TX credits and
+ * versus the negotiated link MTU. Builds with optional compression enabled
+ * also negotiate with a simulated peer and loop compressed frames back
+ * through the receive path; heartbeat builds check the echo probe.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_transport.h"
+#if TINYPAN_SLIP_ENABLE_VJ
+#include "../src/tinypan_slip_vj.h"
+#endif
+#if TINYPAN_SLIP_ENABLE_LZ
+#include "../src/tinypan_slip_lz.h"
+#endif
+#if TINYPAN_ENABLE_HEARTBEAT
+#include "../src/tinypan_heartbeat.h"
+#endif
+
+#include "lwip/init.h"
+#include "lwip/pbuf.h"
+#include "lwip/netif.h"
+
+extern const uint8_t* mock_hal_get_tx_history_data(int index_from_newest);
+extern uint16_t mock_hal_get_tx_history_len(int index_from_newest);
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define FRAME_LEN       1000
+#define WIRE_MAX        8192
+
+static const tinypan_transport_t* s_slip = &transport_slip;
+static struct netif s_netif;
+
+/* Frames delivered by the loopback decoder */
+static uint8_t s_rx_frame[FRAME_LEN];
+static uint16_t s_rx_len = FRAME_LEN;
+static int s_rx_frames = 0;
+static int s_rx_bad = 0;
+
+/* Wire bytes collected from the mock HAL */
+static uint8_t s_wire[WIRE_MAX];
+static uint32_t s_wire_len = 0;
+static uint32_t s_collected = 0;
+
+static err_t loopback_input(struct pbuf* p, struct netif* netif) {
+    (void)netif;
+    uint8_t buf[FRAME_LEN];
+    if (p->tot_len == s_rx_len && pbuf_copy_partial(p, buf, s_rx_len, 0) == s_rx_len &&
+        memcmp(buf, s_rx_frame, s_rx_len) == 0) {
+        s_rx_frames++;
+    } else {
+        s_rx_bad++;
+    }
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+/* The transport hands received frames to the TinyPAN netif */
+struct netif* tinypan_netif_get(void) {
+    return &s_netif;
+}
+
+bool tinypan_netif_rx_admit(struct pbuf* p, uint16_t ip_offset) {
+    (void)p;
+    (void)ip_offset;
+    return true;
+}
+
+u32_t sys_now(void) {
+    return hal_get_tick_ms();
+}
+
+#if TINYPAN_ENABLE_HEARTBEAT
+/* Tag of the last echo reply the transport passed to the heartbeat */
+static int s_echo_tag = TINYPAN_HEARTBEAT_NO_TAG;
+
+void tinypan_heartbeat_reply(int tag) {
+    s_echo_tag = tag;
+}
+#endif
+
+static void hal_event_cb(hal_l2cap_event_t event, int status, void* user_data) {
+    (void)status;
+    (void)user_data;
+    if (event == HAL_L2CAP_EVENT_CAN_SEND_NOW) {
+        s_slip->on_can_send_now();
+    }
+}
+
+/**
+ * Copy chunks accepted by the mock since the last call into s_wire
+ */
+static int collect_wire(void) {
+    mock_hal_conn_event_stats_t stats;
+    mock_hal_get_conn_event_stats(&stats);
+    uint32_t fresh = stats.packets_accepted - s_collected;
+    if (fresh > 5) return 0; /* Mock history depth */
+
+    for (int i = (int)fresh - 1; i >= 0; i--) {
+        uint16_t len = mock_hal_get_tx_history_len(i);
+        if (s_wire_len + len > sizeof(s_wire)) return 0;
+        memcpy(&s_wire[s_wire_len], mock_hal_get_tx_history_data(i), len);
+        s_wire_len += len;
+    }
+    s_collected = stats.packets_accepted;
+    return 1;
+}
+
+static void link_up(uint16_t interval_ms, uint16_t per_event, uint16_t buffers) {
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+    hal_bt_l2cap_register_event_callback(hal_event_cb, NULL);
+    mock_hal_simulate_connect_success();
+    mock_hal_set_conn_event_model(interval_ms, per_event, buffers);
+    s_slip->init();
+    s_slip->on_connected();
+    s_netif.input = loopback_input;
+    s_wire_len = 0;
+    s_collected = 0;
+    s_rx_frames = 0;
+    s_rx_bad = 0;
+}
+
+static void link_down(void) {
+    s_slip->on_disconnected();
+    s_slip->flush_queues();
+    mock_hal_set_conn_event_model(0, 0, 0);
+    hal_bt_deinit();
+}
+
+/**
+ * Queue one test frame; returns false if the transport queue is full
+ */
+static int send_frame(uint8_t seed) {
+    for (int i = 0; i < FRAME_LEN; i++) {
+        /* Sprinkle in bytes that need escaping */
+        s_rx_frame[i] = (i % 97 == 0) ? 0xC0 : (i % 89 == 0) ? 0xDB : (uint8_t)(i * 7 + seed);
+    }
+    /* IPv4 with a reserved protocol: never touched by header compression */
+    s_rx_frame[0] = 0x45;
+    s_rx_frame[9] = 0xFF;
+    s_rx_len = FRAME_LEN;
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, FRAME_LEN, PBUF_RAM);
+    if (p == NULL) return 0;
+    pbuf_take(p, s_rx_frame, FRAME_LEN);
+    err_t err = s_slip->output(&s_netif, p);
+    pbuf_free(p);
+    return err == ERR_OK;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * One output fills every free controller buffer without a busy return
+ */
+static int test_burst_fills_credits(void) {
+    link_up(30, 4, 4);
+
+    if (!send_frame(1)) return 0;
+
+    mock_hal_conn_event_stats_t stats;
+    mock_hal_get_conn_event_stats(&stats);
+    int ok = (stats.packets_accepted == 4 && stats.busy_returns == 0);
+
+    /* The next connection event frees the buffers and the rest follows */
+    mock_hal_advance_tick_ms(30);
+    hal_bt_poll();
+    mock_hal_get_conn_event_stats(&stats);
+    uint32_t chunks = (FRAME_LEN + 16 + 244) / 245; /* ~245 payload bytes per 247-byte chunk */
+    ok = ok && stats.packets_on_air == 4 && stats.packets_accepted >= chunks;
+
+    link_down();
+    return ok;
+}
+
+/**
+ * Frames cross a congested link byte-exact
+ */
+static int test_stream_intact_under_congestion(void) {
+    link_up(15, 2, 3);
+
+    int sent = 0;
+    for (uint32_t t = 0; t < 2000 && s_rx_frames < 6; t++) {
+        if (s_rx_frames == sent && sent < 6 && send_frame((uint8_t)sent)) {
+            sent++;
+        }
+        mock_hal_advance_tick_ms(1);
+        hal_bt_poll();
+        if (!collect_wire()) return 0;
+
+        /* Decode as the peer would, so the expected frame is still current */
+        s_slip->handle_incoming(s_wire, (uint16_t)s_wire_len);
+        s_wire_len = 0;
+    }
+
+    int ok = (s_rx_frames == 6 && s_rx_bad == 0);
+    link_down();
+    return ok;
+}
+
+/**
+ * Goodput versus credits per connection event
+ */
+static int test_goodput_vs_credits(void) {
+    const uint16_t interval_ms = 15;
+    const uint16_t credits[] = { 1, 2, 4, 6 };
+    const int frames = 40;
+    uint32_t goodput[sizeof(credits) / sizeof(credits[0])];
+
+    printf("\n    %-8s %8s %10s %10s\n", "credits", "events", "idle", "goodput");
+    for (size_t c = 0; c < sizeof(credits) / sizeof(credits[0]); c++) {
+        link_up(interval_ms, 6, credits[c]);
+
+        int sent = 0;
+        uint32_t elapsed = 0;
+        mock_hal_conn_event_stats_t stats;
+        for (;;) {
+            while (sent < frames && send_frame((uint8_t)sent)) {
+                sent++;
+            }
+            mock_hal_get_conn_event_stats(&stats);
+            if (sent == frames && stats.queued == 0) {
+                break;
+            }
+            if (elapsed > 60000) return 0;
+            mock_hal_advance_tick_ms(1);
+            elapsed++;
+            hal_bt_poll();
+        }
+
+        goodput[c] = (uint32_t)((uint64_t)frames * FRAME_LEN * 8 / elapsed);
+        printf("    %-8u %8u %10u %7u kbps\n", credits[c], (unsigned)stats.events,
+               (unsigned)stats.idle_events, (unsigned)goodput[c]);
+        link_down();
+    }
+    printf("    ");
+
+    /* Buffering must scale with credits until the link, not the HAL, is the limit */
+    return goodput[1] > goodput[0] * 18 / 10 &&
+           goodput[2] > goodput[0] * 35 / 10 &&
+           goodput[3] >= goodput[2];
+}
+
+#if TINYPAN_SLIP_ENABLE_VJ || TINYPAN_SLIP_ENABLE_LZ || TINYPAN_ENABLE_HEARTBEAT
+
+/* Negotiation frames as the peer sends them: [0x10][op][features or tag] */
+#define CTRL_TYPE           0x10
+#define CTRL_HELLO          0x01
+#define CTRL_HELLO_ACK      0x02
+#define CTRL_ECHO           0x03
+#define CTRL_ECHO_REPLY     0x04
+#define FEATURE_VJ          0x01
+#define FEATURE_LZ          0x02
+#define FEATURE_ECHO        0x04
+#define LOCAL_FEATURES      ((TINYPAN_SLIP_ENABLE_VJ ? FEATURE_VJ : 0) | \
+                             (TINYPAN_SLIP_ENABLE_LZ ? FEATURE_LZ : 0) | \
+                             (TINYPAN_ENABLE_HEARTBEAT ? FEATURE_ECHO : 0))
+
+#define PKT_MAX             300
+
+static uint32_t s_wire_pos = 0;
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    put16(p, (uint16_t)(v >> 16));
+    put16(p + 2, (uint16_t)v);
+}
+
+static uint16_t build_ip(uint8_t* pkt, uint8_t proto, uint16_t id, uint16_t total) {
+    memset(pkt, 0, 20);
+    pkt[0] = 0x45;
+    put16(&pkt[2], total);
+    put16(&pkt[4], id);
+    pkt[6] = 0x40; /* DF */
+    pkt[8] = 64;
+    pkt[9] = proto;
+    put32(&pkt[12], 0xC0A80402);
+    put32(&pkt[16], 0xC0A80401);
+
+    /* The decompressor rebuilds the checksum, so it has to be right */
+    uint32_t sum = 0;
+    for (int i = 0; i < 20; i += 2) sum += (uint32_t)((pkt[i] << 8) | pkt[i + 1]);
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    put16(&pkt[10], (uint16_t)~sum);
+    return total;
+}
+
+/** Repetitive payload, the kind sensor and JSON traffic carries */
+static void fill_text(uint8_t* data, uint16_t len, uint8_t seed) {
+    for (uint16_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)"temp=21.5;rh=40;"[(i + seed) % 16];
+    }
+}
+
+static uint16_t build_udp(uint8_t* pkt, uint16_t id, uint16_t payload) {
+    uint16_t total = build_ip(pkt, 17, id, (uint16_t)(28 + payload));
+    put16(&pkt[20], 5000);
+    put16(&pkt[22], 7000);
+    put16(&pkt[24], (uint16_t)(8 + payload));
+    put16(&pkt[26], (uint16_t)(0x1234 + id)); /* Arbitrary, carried verbatim */
+    fill_text(&pkt[28], payload, (uint8_t)id);
+    return total;
+}
+
+/**
+ * Decode the next complete frame from s_wire; returns its length or -1
+ */
+static int next_frame(uint8_t* out, uint16_t max) {
+    int n = 0;
+    bool esc = false;
+    while (s_wire_pos < s_wire_len) {
+        uint8_t c = s_wire[s_wire_pos++];
+        if (c == 0xC0) {
+            if (n > 0) return n;
+            continue;
+        }
+        if (c == 0xDB) {
+            esc = true;
+            continue;
+        }
+        if (esc) {
+            c = (c == 0xDC) ? 0xC0 : 0xDB;
+            esc = false;
+        }
+        if (n >= max) return -1;
+        out[n++] = c;
+    }
+    return -1;
+}
+
+#if TINYPAN_SLIP_ENABLE_VJ || TINYPAN_SLIP_ENABLE_LZ
+/**
+ * Frame type as the header decompressor sees it, inside any LZ wrapping
+ */
+static uint8_t inner_type(const uint8_t* frame, int len) {
+#if TINYPAN_SLIP_ENABLE_LZ
+    if (frame[0] == SLIP_LZ_TYPE) {
+        uint8_t plain[PKT_MAX];
+        return (slip_lz_decode(frame, (uint16_t)len, plain, sizeof(plain)) > 0) ? plain[0] : 0;
+    }
+#endif
+    (void)len;
+    return frame[0];
+}
+#endif
+
+/**
+ * Encode a frame from the peer and feed it to the receive path
+ */
+static void peer_send(const uint8_t* frame, uint16_t len) {
+    uint8_t wire[2 * PKT_MAX + 2];
+    uint16_t n = 0;
+    wire[n++] = 0xC0;
+    for (uint16_t i = 0; i < len; i++) {
+        if (frame[i] == 0xC0 || frame[i] == 0xDB) {
+            wire[n++] = 0xDB;
+            wire[n++] = (frame[i] == 0xC0) ? 0xDC : 0xDD;
+        } else {
+            wire[n++] = frame[i];
+        }
+    }
+    wire[n++] = 0xC0;
+    s_slip->handle_incoming(wire, n);
+}
+
+/**
+ * Let a few connection events pass, collecting what goes on the air
+ */
+static int run_link(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t++) {
+        mock_hal_advance_tick_ms(1);
+        hal_bt_poll();
+        if (!collect_wire()) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Bring the link up, check the transport's HELLO and answer it as a peer
+ * supporting peer_features
+ */
+static int link_up_negotiated(uint8_t peer_features) {
+    uint8_t frame[8];
+
+    link_up(15, 4, 4);
+    s_wire_pos = 0;
+    if (!collect_wire() || !run_link(30)) return 0;
+    if (next_frame(frame, sizeof(frame)) != 3 || frame[0] != CTRL_TYPE ||
+        frame[1] != CTRL_HELLO || frame[2] != LOCAL_FEATURES) {
+        return 0;
+    }
+    s_wire_len = 0;
+    s_wire_pos = 0;
+
+    const uint8_t ack[3] = { CTRL_TYPE, CTRL_HELLO_ACK, peer_features };
+    peer_send(ack, sizeof(ack));
+    return 1;
+}
+
+/**
+ * Send one packet, capture the frame it became on the air, and loop the
+ * wire back through the receive path. Returns 1 if the packet came out
+ * of the receiver byte-exact.
+ */
+static int round_trip(const uint8_t* pkt, uint16_t len, uint8_t* frame, int* frame_len) {
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (p == NULL) return 0;
+    pbuf_take(p, pkt, len);
+    err_t err = s_slip->output(&s_netif, p);
+    pbuf_free(p);
+    if (err != ERR_OK || !collect_wire() || !run_link(30)) return 0;
+
+    s_wire_pos = 0;
+    *frame_len = next_frame(frame, PKT_MAX);
+    if (*frame_len <= 0) return 0;
+
+    memcpy(s_rx_frame, pkt, len);
+    s_rx_len = len;
+    int before = s_rx_frames;
+    s_slip->handle_incoming(s_wire, (uint16_t)s_wire_len);
+    s_slip->process();
+    s_wire_len = 0;
+    s_wire_pos = 0;
+    return s_rx_frames == before + 1 && s_rx_bad == 0;
+}
+
+/**
+ * HELLO carries the local features; nothing is compressed until the peer
+ * agrees, and a peer HELLO is answered with the features both sides support
+ */
+static int test_feature_negotiation(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX];
+    int frame_len;
+
+    /* Peer supports nothing: traffic stays plain */
+    if (!link_up_negotiated(0)) return 0;
+    uint16_t len = build_udp(pkt, 1, 200);
+    int ok = round_trip(pkt, len, frame, &frame_len) &&
+             frame_len == len && memcmp(frame, pkt, len) == 0;
+
+    /* A peer offering everything, and more, gets exactly the local set */
+    const uint8_t hello[3] = { CTRL_TYPE, CTRL_HELLO, 0xFF };
+    peer_send(hello, sizeof(hello));
+    ok = ok && collect_wire() && run_link(30) &&
+         next_frame(frame, PKT_MAX) == 3 && frame[0] == CTRL_TYPE &&
+         frame[1] == CTRL_HELLO_ACK && frame[2] == LOCAL_FEATURES;
+    s_wire_len = 0;
+    s_wire_pos = 0;
+
+#if TINYPAN_SLIP_ENABLE_VJ || TINYPAN_SLIP_ENABLE_LZ
+    /* From now on the flow is sent compressed */
+    len = build_udp(pkt, 2, 200);
+    ok = ok && round_trip(pkt, len, frame, &frame_len);
+    len = build_udp(pkt, 3, 200);
+    ok = ok && round_trip(pkt, len, frame, &frame_len) && frame_len < len;
+#endif
+
+    link_down();
+    return ok;
+}
+
+#if TINYPAN_ENABLE_HEARTBEAT
+
+/**
+ * The heartbeat probe is an echo, sent only to a peer that agreed to
+ * answer it; echoes in either direction carry their tag through
+ */
+static int test_echo_probe(void) {
+    uint8_t frame[8];
+
+    /* A peer without the echo feature cannot be probed */
+    if (!link_up_negotiated(0)) return 0;
+    int ok = s_slip->send_probe(7) < 0 && collect_wire() && run_link(30) && s_wire_len == 0;
+    link_down();
+
+    /* The tag survives escaping on the way out */
+    if (!link_up_negotiated(FEATURE_ECHO)) return 0;
+    ok = ok && s_slip->send_probe(0xC0) == 0 && collect_wire() && run_link(30) &&
+         next_frame(frame, sizeof(frame)) == 3 && frame[0] == CTRL_TYPE &&
+         frame[1] == CTRL_ECHO && frame[2] == 0xC0;
+    s_wire_len = 0;
+    s_wire_pos = 0;
+
+    /* The answer reaches the heartbeat with its tag */
+    const uint8_t reply[3] = { CTRL_TYPE, CTRL_ECHO_REPLY, 0xC0 };
+    s_echo_tag = TINYPAN_HEARTBEAT_NO_TAG;
+    peer_send(reply, sizeof(reply));
+    ok = ok && s_echo_tag == 0xC0;
+
+    /* The peer's own probe is answered, and is not mistaken for a reply */
+    const uint8_t echo[3] = { CTRL_TYPE, CTRL_ECHO, 0x42 };
+    s_echo_tag = TINYPAN_HEARTBEAT_NO_TAG;
+    peer_send(echo, sizeof(echo));
+    ok = ok && collect_wire() && run_link(30) &&
+         next_frame(frame, sizeof(frame)) == 3 && frame[0] == CTRL_TYPE &&
+         frame[1] == CTRL_ECHO_REPLY && frame[2] == 0x42 &&
+         s_echo_tag == TINYPAN_HEARTBEAT_NO_TAG && s_rx_bad == 0;
+
+    link_down();
+    return ok;
+}
+
+#endif /* TINYPAN_ENABLE_HEARTBEAT */
+
+#endif /* TINYPAN_SLIP_ENABLE_VJ || TINYPAN_SLIP_ENABLE_LZ || TINYPAN_ENABLE_HEARTBEAT */
+
+#if TINYPAN_SLIP_ENABLE_VJ
+
+static uint16_t build_tcp(uint8_t* pkt, uint16_t id, uint32_t seq, uint32_t ack,
+                          uint16_t payload) {
+    uint16_t total = build_ip(pkt, 6, id, (uint16_t)(40 + payload));
+    uint8_t* th = pkt + 20;
+    memset(th, 0, 20);
+    put16(&th[0], 49152);
+    put16(&th[2], 80);
+    put32(&th[4], seq);
+    put32(&th[8], ack);
+    th[12] = 0x50;
+    th[13] = 0x18; /* PSH | ACK */
+    put16(&th[14], 4096);
+    put16(&th[16], (uint16_t)(seq ^ ack ^ id)); /* Arbitrary, carried verbatim */
+    fill_text(&pkt[40], payload, (uint8_t)id);
+    return total;
+}
+
+static uint16_t build_ipv6(uint8_t* pkt, uint16_t payload) {
+    memset(pkt, 0, 40);
+    pkt[0] = 0x60;
+    put16(&pkt[4], payload);
+    pkt[6] = 17;
+    pkt[7] = 64;
+    pkt[8] = 0xFE; /* fe80::2 -> fe80::1 */
+    pkt[9] = 0x80;
+    pkt[23] = 0x02;
+    pkt[24] = 0xFE;
+    pkt[25] = 0x80;
+    pkt[39] = 0x01;
+    fill_text(&pkt[40], payload, 0);
+    return (uint16_t)(40 + payload);
+}
+
+/**
+ * A TCP flow opens with an uncompressed-TCP frame, then every segment
+ * goes out as a compressed header and comes back intact
+ */
+static int test_vj_tcp_round_trip(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX];
+    int frame_len;
+    uint32_t seq = 1000;
+
+    if (!link_up_negotiated(FEATURE_VJ)) return 0;
+    int ok = 1;
+    for (uint16_t i = 0; i < 6 && ok; i++) {
+        uint16_t payload = (uint16_t)(60 + i * 30);
+        uint16_t len = build_tcp(pkt, (uint16_t)(100 + i), seq, 5000, payload);
+        seq += payload;
+
+        ok = round_trip(pkt, len, frame, &frame_len);
+        uint8_t type = inner_type(frame, frame_len);
+        if (i == 0) {
+            ok = ok && (type & 0xF0) == SLIP_VJ_TYPE_UNCOMPRESSED_TCP;
+        } else {
+            ok = ok && (type & SLIP_VJ_TYPE_COMPRESSED_TCP) && frame_len < len;
+        }
+    }
+
+    link_down();
+    return ok;
+}
+
+/**
+ * UDP uses the context scheme: a full refresh, then compressed headers
+ */
+static int test_vj_udp_context(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX];
+    int frame_len;
+
+    if (!link_up_negotiated(FEATURE_VJ)) return 0;
+    int ok = 1;
+    for (uint16_t i = 0; i < 4 && ok; i++) {
+        uint16_t len = build_udp(pkt, (uint16_t)(200 + i), 40);
+        ok = round_trip(pkt, len, frame, &frame_len);
+        uint8_t type = inner_type(frame, frame_len) & 0xF0;
+        ok = ok && type == ((i == 0) ? SLIP_VJ_TYPE_CTX_REFRESH : SLIP_VJ_TYPE_CTX_COMPRESSED);
+    }
+
+    link_down();
+    return ok;
+}
+
+/**
+ * IPv6 crosses a CSLIP link untouched in both directions, between TCP
+ * segments that keep their compression state
+ */
+static int test_vj_ipv6_passthrough(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX];
+    int frame_len;
+
+    if (!link_up_negotiated(FEATURE_VJ)) return 0;
+
+    uint16_t len = build_tcp(pkt, 1, 1000, 5000, 100);
+    int ok = round_trip(pkt, len, frame, &frame_len);
+
+    len = build_ipv6(pkt, 120);
+    ok = ok && round_trip(pkt, len, frame, &frame_len) &&
+         (inner_type(frame, frame_len) & 0xF0) == 0x60;
+
+    len = build_tcp(pkt, 2, 1100, 5000, 100);
+    ok = ok && round_trip(pkt, len, frame, &frame_len) &&
+         (inner_type(frame, frame_len) & SLIP_VJ_TYPE_COMPRESSED_TCP);
+
+    link_down();
+    return ok;
+}
+
+#endif /* TINYPAN_SLIP_ENABLE_VJ */
+
+#if TINYPAN_SLIP_ENABLE_LZ
+
+/** IPv4 with a reserved protocol, so only LZ can shrink it */
+static uint16_t build_raw(uint8_t* pkt, uint16_t id, uint16_t payload, bool noise) {
+    uint16_t total = build_ip(pkt, 0xFF, id, (uint16_t)(20 + payload));
+    if (noise) {
+        uint32_t x = 0x9E3779B9u + id;
+        for (uint16_t i = 0; i < payload; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            pkt[20 + i] = (uint8_t)x;
+        }
+    } else {
+        fill_text(&pkt[20], payload, (uint8_t)id);
+    }
+    return total;
+}
+
+/**
+ * A compressible frame goes out LZ-encoded and comes back intact
+ */
+static int test_lz_round_trip(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX];
+    int frame_len;
+
+    if (!link_up_negotiated(FEATURE_LZ)) return 0;
+    int ok = 1;
+    for (uint16_t i = 0; i < 4 && ok; i++) {
+        uint16_t len = build_raw(pkt, i, (uint16_t)(100 + i * 50), false);
+        ok = round_trip(pkt, len, frame, &frame_len) &&
+             frame[0] == SLIP_LZ_TYPE && frame_len < len && inner_type(frame, frame_len) == 0x45;
+    }
+
+    link_down();
+    return ok;
+}
+
+/**
+ * Frames that would not shrink, and frames below the size threshold, go
+ * out as they are
+ */
+static int test_lz_skips_incompressible(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX];
+    int frame_len;
+
+    if (!link_up_negotiated(FEATURE_LZ)) return 0;
+
+    uint16_t len = build_raw(pkt, 1, 200, true);
+    int ok = round_trip(pkt, len, frame, &frame_len) &&
+             frame_len == len && memcmp(frame, pkt, len) == 0;
+
+    len = build_raw(pkt, 2, (uint16_t)(TINYPAN_SLIP_LZ_MIN_FRAME - 21), false);
+    ok = ok && round_trip(pkt, len, frame, &frame_len) &&
+         frame_len == len && memcmp(frame, pkt, len) == 0;
+
+    /* A compressible frame right after still gets encoded */
+    len = build_raw(pkt, 3, 200, false);
+    ok = ok && round_trip(pkt, len, frame, &frame_len) && frame[0] == SLIP_LZ_TYPE;
+
+    link_down();
+    return ok;
+}
+
+#if TINYPAN_SLIP_ENABLE_VJ
+/**
+ * With both features agreed, a TCP segment gets a compressed header and
+ * the result is LZ-encoded as one frame
+ */
+static int test_lz_over_vj(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX];
+    int frame_len;
+    uint32_t seq = 1000;
+
+    if (!link_up_negotiated(FEATURE_VJ | FEATURE_LZ)) return 0;
+    int ok = 1;
+    for (uint16_t i = 0; i < 4 && ok; i++) {
+        uint16_t len = build_tcp(pkt, (uint16_t)(300 + i), seq, 5000, 200);
+        seq += 200;
+
+        ok = round_trip(pkt, len, frame, &frame_len) && frame[0] == SLIP_LZ_TYPE;
+        uint8_t type = inner_type(frame, frame_len);
+        if (i == 0) {
+            ok = ok && (type & 0xF0) == SLIP_VJ_TYPE_UNCOMPRESSED_TCP;
+        } else {
+            ok = ok && (type & SLIP_VJ_TYPE_COMPRESSED_TCP);
+        }
+    }
+
+    link_down();
+    return ok;
+}
+#endif
+
+#endif /* TINYPAN_SLIP_ENABLE_LZ */
+
+#if TINYPAN_SLIP_MTU_AUTOTUNE
+
+static uint32_t s_rand = 12345;
+
+static uint8_t next_rand(void) {
+    s_rand = s_rand * 1103515245u + 12345u;
+    return (uint8_t)(s_rand >> 16);
+}
+
+/**
+ * Queue an IP packet with random content; returns false if the queue is full
+ */
+static int send_random_packet(uint16_t len) {
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (p == NULL) return 0;
+    uint8_t* data = (uint8_t*)p->payload;
+    for (uint16_t i = 0; i < len; i++) {
+        data[i] = next_rand();
+    }
+    data[0] = 0x45;
+    data[9] = 0xFF;
+    err_t err = s_slip->output(&s_netif, p);
+    pbuf_free(p);
+    return err == ERR_OK;
+}
+
+/**
+ * Netif MTU is derived from the link MTU and follows renegotiation
+ */
+static int test_mtu_follows_link(void) {
+    link_up(15, 6, 6);
+    int ok = 1;
+
+    for (uint16_t link_mtu = 4; link_mtu <= 600 && ok; link_mtu++) {
+        mock_hal_set_mtu(link_mtu);
+        s_slip->process();
+
+        uint32_t mtu = s_netif.mtu;
+        uint32_t chunk = (link_mtu < TINYPAN_SLIP_CHUNK_SIZE) ? link_mtu : TINYPAN_SLIP_CHUNK_SIZE;
+        uint32_t scale = 1000 + TINYPAN_SLIP_ESCAPE_PERMILLE;
+        if (mtu < 576 || mtu > 1500) ok = 0;
+        if (mtu == 576 || mtu == 1500) continue;
+
+        /* A full frame plus its escape reserve ends exactly on a chunk boundary */
+        uint32_t room = ((mtu * scale + 999) / 1000 + 2 + chunk - 1) / chunk * chunk - 2;
+        if (mtu * scale > room * 1000 || (mtu + 1) * scale <= room * 1000) {
+            printf("\n    Link MTU %u: IP MTU %u not chunk aligned", link_mtu, (unsigned)mtu);
+            ok = 0;
+        }
+    }
+
+    /* Renegotiation back to the default */
+    mock_hal_set_mtu(1500);
+    s_slip->process();
+    ok = ok && s_netif.mtu < 1500 && s_netif.mtu >= 1400;
+
+    link_down();
+    return ok;
+}
+
+/**
+ * Chunk fill ratio and goodput for common BLE ATT MTUs, untuned vs tuned
+ */
+static int test_mtu_chunk_fill_table(void) {
+    const uint16_t att_mtus[] = { 23, 185, 247 };
+    const int packets = 30;
+    int ok = 1;
+
+    printf("\n    %-4s %-7s %6s %10s %7s %10s\n", "ATT", "mode", "IP MTU", "chunks/pkt", "fill", "goodput");
+    for (size_t m = 0; m < sizeof(att_mtus) / sizeof(att_mtus[0]); m++) {
+        uint32_t goodput[2];
+        uint32_t fill[2];
+
+        for (int tuned = 0; tuned < 2; tuned++) {
+            link_up(15, 6, 6);
+            mock_hal_set_mtu((uint16_t)(att_mtus[m] - 3)); /* ATT header */
+            s_slip->process();
+            if (!tuned) s_netif.mtu = 1500;
+            uint16_t mtu = s_netif.mtu;
+            uint16_t chunk = (uint16_t)(att_mtus[m] - 3);
+
+            int sent = 0;
+            uint32_t elapsed = 0;
+            mock_hal_conn_event_stats_t stats;
+            for (;;) {
+                while (sent < packets && send_random_packet(mtu)) {
+                    sent++;
+                }
+                mock_hal_get_conn_event_stats(&stats);
+                if (sent == packets && stats.queued == 0) break;
+                if (elapsed > 60000) return 0;
+                mock_hal_advance_tick_ms(1);
+                elapsed++;
+                hal_bt_poll();
+            }
+
+            /* Application goodput: IP packets less 40 bytes of TCP/IP headers */
+            goodput[tuned] = (uint32_t)((uint64_t)packets * (mtu - 40) * 8 / elapsed);
+            fill[tuned] = (uint32_t)((uint64_t)stats.bytes_accepted * 1000 /
+                                     ((uint64_t)stats.packets_accepted * chunk));
+            printf("    %-4u %-7s %6u %10.2f %6.1f%% %6u kbps\n", att_mtus[m],
+                   tuned ? "tuned" : "1500", mtu, (double)stats.packets_accepted / packets,
+                   fill[tuned] / 10.0, (unsigned)goodput[tuned]);
+            link_down();
+        }
+
+        if (fill[1] < fill[0] || goodput[1] * 100 < goodput[0] * 99) ok = 0;
+        if (att_mtus[m] > 100 && (fill[1] < 970 || goodput[1] <= goodput[0])) ok = 0;
+    }
+    printf("    ");
+    return ok;
+}
+
+#endif /* TINYPAN_SLIP_MTU_AUTOTUNE */
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN SLIP Flow Control Tests\n");
+    printf("===============================\n\n");
+
+    lwip_init();
+
+    printf("Running tests:\n");
+
+    TEST(burst_fills_credits);
+    TEST(stream_intact_under_congestion);
+    TEST(goodput_vs_credits);
+#if TINYPAN_SLIP_ENABLE_VJ || TINYPAN_SLIP_ENABLE_LZ || TINYPAN_ENABLE_HEARTBEAT
+    TEST(feature_negotiation);
+#endif
+#if TINYPAN_ENABLE_HEARTBEAT
+    TEST(echo_probe);
+#endif
+#if TINYPAN_SLIP_ENABLE_VJ
+    TEST(vj_tcp_round_trip);
+    TEST(vj_udp_context);
+    TEST(vj_ipv6_passthrough);
+#endif
+#if TINYPAN_SLIP_ENABLE_LZ
+    TEST(lz_round_trip);
+    TEST(lz_skips_incompressible);
+#if TINYPAN_SLIP_ENABLE_VJ
+    TEST(lz_over_vj);
+#endif
+#endif
+#if TINYPAN_SLIP_MTU_AUTOTUNE
+    TEST(mtu_follows_link);
+    TEST(mtu_chunk_fill_table);
+#endif
+
+    printf("\n===============================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+/*
+ * TinyPAN Test - SLIP Payload Compression
+ *
+ * Round-trip and robustness tests for the LZSS codec, plus a ratio/goodput
+ * table for typical telemetry payloads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/tinypan_slip_lz.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define BUF_MAX     1600
+
+static slip_lz_enc_t s_enc;
+static uint32_t s_rand = 12345;
+
+static uint8_t next_rand(void) {
+    s_rand = s_rand * 1103515245u + 12345u;
+    return (uint8_t)(s_rand >> 16);
+}
+
+/**
+ * Compress data fed in `piece`-byte segments, returns LZ frame length (0 = bypass)
+ */
+static uint16_t compress(const uint8_t* data, uint16_t len, uint16_t piece, uint8_t* out) {
+    slip_lz_enc_begin(&s_enc, out, (uint16_t)(len - 1), len);
+    for (uint16_t off = 0; off < len; off += piece) {
+        uint16_t n = (uint16_t)((len - off < piece) ? len - off : piece);
+        if (!slip_lz_enc_feed(&s_enc, data + off, n)) break;
+    }
+    return slip_lz_enc_finish(&s_enc);
+}
+
+static int round_trip(const uint8_t* data, uint16_t len, uint16_t piece, uint16_t* lz_len) {
+    uint8_t frame[BUF_MAX];
+    uint8_t out[BUF_MAX];
+    *lz_len = compress(data, len, piece, frame);
+    if (*lz_len == 0) return 1; /* Bypassed */
+    int n = slip_lz_decode(frame, *lz_len, out, sizeof(out));
+    if (n != len || memcmp(out, data, len) != 0) {
+        printf("\n    Round trip mismatch (len %u, piece %u, decoded %d)\n", len, piece, n);
+        return 0;
+    }
+    return 1;
+}
+
+static uint16_t make_json(uint8_t* buf, uint16_t max, int seed) {
+    uint16_t len = 0;
+    for (int i = 0; len + 80 < max; i++) {
+        len += (uint16_t)snprintf((char*)buf + len, max - len,
+            "{\"sensor\":\"temp%02d\",\"value\":%d.%d,\"unit\":\"C\",\"ts\":%d},",
+            i % 8, 20 + (seed + i) % 7, (seed * 3 + i) % 10, 1700000000 + seed * 10 + i);
+    }
+    return len;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Repetitive text compresses and decodes, regardless of how it is fed
+ */
+static int test_text_round_trip(void) {
+    uint8_t json[1400];
+    uint16_t len = make_json(json, sizeof(json), 1);
+    uint16_t pieces[] = { 1, 7, 64, 300, 1400 };
+    uint16_t first = 0;
+
+    for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+        uint16_t lz_len;
+        if (!round_trip(json, len, pieces[i], &lz_len)) return 0;
+        if (lz_len == 0 || lz_len >= len / 2) return 0;
+        /* Output must not depend on segmentation */
+        if (i == 0) first = lz_len;
+        else if (lz_len != first) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Random data is bypassed instead of expanding
+ */
+static int test_incompressible_bypass(void) {
+    uint8_t data[1000];
+    uint8_t out[BUF_MAX];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = next_rand();
+    return compress(data, sizeof(data), 100, out) == 0;
+}
+
+/**
+ * Runs and overlapping back-references
+ */
+static int test_runs_and_overlap(void) {
+    uint8_t data[1500];
+    uint16_t lz_len;
+
+    memset(data, 0xAA, sizeof(data));
+    if (!round_trip(data, sizeof(data), 1500, &lz_len) || lz_len == 0) return 0;
+
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)"abc"[i % 3];
+    if (!round_trip(data, sizeof(data), 33, &lz_len) || lz_len == 0) return 0;
+
+    /* Matches far beyond the window must not be referenced */
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = next_rand();
+    memcpy(&data[1200], &data[10], 200);
+    return round_trip(data, sizeof(data), 500, &lz_len);
+}
+
+/**
+ * Random mixes of literals and repeats at many lengths
+ */
+static int test_random_round_trips(void) {
+    uint8_t data[1500];
+    for (int iter = 0; iter < 300; iter++) {
+        uint16_t len = (uint16_t)(2 + (next_rand() << 3 | next_rand() % 8) % 1498);
+        for (uint16_t i = 0; i < len; i++) {
+            if (i > 8 && next_rand() < 100) {
+                data[i] = data[i - 1 - next_rand() % 8];
+            } else {
+                data[i] = next_rand() & 0x0F;
+            }
+        }
+        uint16_t lz_len;
+        if (!round_trip(data, len, (uint16_t)(1 + next_rand()), &lz_len)) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Corrupt frames are rejected without overrunning the output
+ */
+static int test_malformed_frames(void) {
+    uint8_t json[600];
+    uint8_t frame[BUF_MAX];
+    uint8_t out[BUF_MAX];
+    uint16_t len = make_json(json, sizeof(json), 2);
+    uint16_t lz_len = compress(json, len, len, frame);
+    if (lz_len == 0) return 0;
+
+    /* Truncated bitstream */
+    if (slip_lz_decode(frame, (uint16_t)(lz_len / 2), out, sizeof(out)) >= 0) return 0;
+    /* Output buffer too small for the announced length */
+    if (slip_lz_decode(frame, lz_len, out, (uint16_t)(len - 1)) >= 0) return 0;
+    /* Invalid parameters */
+    frame[1] = 0x3F;
+    if (slip_lz_decode(frame, lz_len, out, sizeof(out)) >= 0) return 0;
+    /* Back-reference before the start of the frame */
+    const uint8_t bad_ref[] = { SLIP_LZ_TYPE, 0x84, 0x00, 0x08, 0x7F, 0xF0 };
+    if (slip_lz_decode(bad_ref, sizeof(bad_ref), out, sizeof(out)) >= 0) return 0;
+
+    /* Garbage must never crash the decoder */
+    for (int iter = 0; iter < 2000; iter++) {
+        uint8_t junk[64];
+        junk[0] = SLIP_LZ_TYPE;
+        junk[1] = (uint8_t)(0x40 + next_rand() % 0x90);
+        junk[2] = 0;
+        for (size_t i = 3; i < sizeof(junk); i++) junk[i] = next_rand();
+        (void)slip_lz_decode(junk, sizeof(junk), out, sizeof(out));
+    }
+    return 1;
+}
+
+/**
+ * Compression ratio and goodput for typical telemetry frames
+ */
+static int test_ratio_table(void) {
+    uint8_t data[1400];
+    uint8_t frame[BUF_MAX];
+    const uint32_t link_bps = 250000;
+    uint16_t sizes[] = { 256, 512, 1400 };
+
+    printf("\n    %-14s %6s %6s %7s %10s\n", "payload", "bytes", "lz", "ratio", "goodput");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint16_t len = make_json(data, sizes[s], 3);
+        uint16_t lz_len = compress(data, len, 256, frame);
+        if (lz_len == 0) return 0;
+        printf("    %-14s %6u %6u %6.2fx %7u kbps\n", "JSON telemetry", len, lz_len,
+               (double)len / lz_len, (unsigned)(link_bps / 1000 * len / lz_len));
+    }
+
+    /* Headers + binary CBOR-like records: fixed keys, varying values */
+    uint16_t len = 0;
+    for (int i = 0; len + 12 <= 512; i++) {
+        const uint8_t rec[] = { 0xA3, 0x61, 't', 0x1A, 0x65, 0x5D, (uint8_t)i, (uint8_t)(i * 7),
+                                0x61, 'v', 0x19, (uint8_t)(i >> 2) };
+        memcpy(&data[len], rec, sizeof(rec));
+        len += sizeof(rec);
+    }
+    uint16_t lz_len = compress(data, len, 256, frame);
+    if (lz_len == 0) return 0;
+    printf("    %-14s %6u %6u %6.2fx %7u kbps\n", "CBOR records", len, lz_len,
+           (double)len / lz_len, (unsigned)(link_bps / 1000 * len / lz_len));
+    printf("    ");
+    return 1;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN SLIP Payload Compression Tests\n");
+    printf("======================================\n\n");
+
+    printf("Running tests:\n");
+
+    TEST(text_round_trip);
+    TEST(incompressible_bypass);
+    TEST(runs_and_overlap);
+    TEST(random_round_trips);
+    TEST(malformed_frames);
+    TEST(ratio_table);
+
+    printf("\n======================================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,460 @@
+/*
+ * TinyPAN Test - SLIP Header Compression
+ *
+ * Round-trip tests for the CSLIP codec (RFC 1144 TCP plus the UDP/ICMP
+ * context scheme) and a goodput comparison against plain SLIP.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/tinypan_slip_vj.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define PKT_MAX     1500
+
+static slip_vj_state_t s_tx;
+static slip_vj_state_t s_rx;
+
+static void reset_link(void) {
+    slip_vj_init(&s_tx);
+    slip_vj_init(&s_rx);
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    put16(p, (uint16_t)(v >> 16));
+    put16(p + 2, (uint16_t)v);
+}
+
+static void ip_checksum(uint8_t* ip) {
+    uint32_t sum = 0;
+    ip[10] = ip[11] = 0;
+    for (int i = 0; i < 20; i += 2) sum += (uint32_t)((ip[i] << 8) | ip[i + 1]);
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    put16(&ip[10], (uint16_t)~sum);
+}
+
+static uint16_t build_ip(uint8_t* pkt, uint8_t proto, uint16_t id, uint16_t total,
+                         uint32_t src, uint32_t dst) {
+    memset(pkt, 0, 20);
+    pkt[0] = 0x45;
+    put16(&pkt[2], total);
+    put16(&pkt[4], id);
+    pkt[6] = 0x40; /* DF */
+    pkt[8] = 64;
+    pkt[9] = proto;
+    put32(&pkt[12], src);
+    put32(&pkt[16], dst);
+    ip_checksum(pkt);
+    return total;
+}
+
+static uint16_t build_tcp(uint8_t* pkt, uint16_t sport, uint16_t id, uint32_t seq,
+                          uint32_t ack, uint16_t win, uint8_t flags, uint16_t payload) {
+    uint16_t total = (uint16_t)(40 + payload);
+    build_ip(pkt, 6, id, total, 0xC0A80402, 0xC0A80401);
+    uint8_t* th = pkt + 20;
+    memset(th, 0, 20);
+    put16(&th[0], sport);
+    put16(&th[2], 80);
+    put32(&th[4], seq);
+    put32(&th[8], ack);
+    th[12] = 0x50;
+    th[13] = flags;
+    put16(&th[14], win);
+    put16(&th[16], (uint16_t)(seq ^ ack ^ id)); /* Arbitrary, carried verbatim */
+    for (uint16_t i = 0; i < payload; i++) pkt[40 + i] = (uint8_t)(i * 7 + seq);
+    return total;
+}
+
+static uint16_t build_udp(uint8_t* pkt, uint16_t sport, uint16_t id, uint16_t payload) {
+    uint16_t total = (uint16_t)(28 + payload);
+    build_ip(pkt, 17, id, total, 0xC0A80402, 0x08080808);
+    put16(&pkt[20], sport);
+    put16(&pkt[22], 53);
+    put16(&pkt[24], (uint16_t)(8 + payload));
+    put16(&pkt[26], (uint16_t)(0x1234 + id));
+    for (uint16_t i = 0; i < payload; i++) pkt[28 + i] = (uint8_t)(i + id);
+    return total;
+}
+
+static uint16_t build_icmp(uint8_t* pkt, uint16_t id, uint16_t payload) {
+    uint16_t total = (uint16_t)(20 + payload);
+    build_ip(pkt, 1, id, total, 0xC0A80402, 0xC0A80401);
+    for (uint16_t i = 0; i < payload; i++) pkt[20 + i] = (uint8_t)(i ^ id);
+    return total;
+}
+
+/**
+ * Compress pkt into a wire frame
+ */
+static uint16_t compress_frame(const uint8_t* pkt, uint16_t len, uint8_t* frame) {
+    uint8_t hdr[SLIP_VJ_MAX_OUT];
+    uint16_t skip = 0;
+    uint16_t avail = len < SLIP_VJ_MAX_HDR ? len : SLIP_VJ_MAX_HDR;
+    uint8_t hdr_len = slip_vj_compress(&s_tx, pkt, avail, len, hdr, &skip);
+    memcpy(frame, hdr, hdr_len);
+    memcpy(frame + hdr_len, pkt + skip, len - skip);
+    return (uint16_t)(hdr_len + len - skip);
+}
+
+/**
+ * Expand a wire frame, returns reconstructed length or -1
+ */
+static int expand_frame(const uint8_t* frame, uint16_t len, uint8_t* out) {
+    uint8_t hdr[SLIP_VJ_MAX_HDR];
+    uint16_t hdr_len = 0;
+    int consumed = slip_vj_uncompress(&s_rx, frame, len, hdr, &hdr_len);
+    if (consumed < 0) return -1;
+    memcpy(out, hdr, hdr_len);
+    memcpy(out + hdr_len, frame + consumed, len - consumed);
+    return hdr_len + len - consumed;
+}
+
+/**
+ * Full round trip, returns the wire frame length or 0 on mismatch
+ */
+static uint16_t round_trip(const uint8_t* pkt, uint16_t len) {
+    uint8_t frame[PKT_MAX + SLIP_VJ_MAX_OUT];
+    uint8_t out[PKT_MAX + SLIP_VJ_MAX_HDR];
+    uint16_t frame_len = compress_frame(pkt, len, frame);
+    int out_len = expand_frame(frame, frame_len, out);
+    if (out_len != len || memcmp(out, pkt, len) != 0) {
+        printf("\n    Round trip mismatch (frame type 0x%02X, len %u -> %d)\n",
+               frame[0], len, out_len);
+        return 0;
+    }
+    return frame_len;
+}
+
+/**
+ * Bytes on the air for one SLIP frame (END + escaped data + END)
+ */
+static uint32_t slip_wire_len(const uint8_t* frame, uint16_t len) {
+    uint32_t n = 2;
+    for (uint16_t i = 0; i < len; i++) {
+        n += (frame[i] == 0xC0 || frame[i] == 0xDB) ? 2 : 1;
+    }
+    return n;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Unidirectional bulk transfer collapses to SPECIAL_D (3-byte header)
+ */
+static int test_tcp_bulk_transfer(void) {
+    uint8_t pkt[PKT_MAX];
+    reset_link();
+
+    uint32_t seq = 1000;
+    for (int i = 0; i < 20; i++) {
+        uint16_t len = build_tcp(pkt, 40000, (uint16_t)(100 + i), seq, 5000, 8192, 0x18, 200);
+        uint16_t wire = round_trip(pkt, len);
+        if (wire == 0) return 0;
+        if (i > 0 && wire != 200 + 3) {
+            printf("\n    Segment %d: expected 203 byte frame, got %u\n", i, wire);
+            return 0;
+        }
+        seq += 200;
+    }
+    return s_tx.tx_compressed == 19 && s_rx.rx_compressed == 19;
+}
+
+/**
+ * Interactive traffic (seq and ack advance together) uses SPECIAL_I
+ */
+static int test_tcp_interactive(void) {
+    uint8_t pkt[PKT_MAX];
+    reset_link();
+
+    uint32_t seq = 7000, ack = 9000;
+    for (int i = 0; i < 10; i++) {
+        uint16_t len = build_tcp(pkt, 40001, (uint16_t)(i + 1), seq, ack, 4096, 0x18, 12);
+        uint16_t wire = round_trip(pkt, len);
+        if (wire == 0) return 0;
+        if (i > 0 && wire > 12 + 3) return 0;
+        seq += 12;
+        ack += 12;
+    }
+    return 1;
+}
+
+/**
+ * Window, ACK and ID changes, including values that need the 3-byte escape
+ */
+static int test_tcp_deltas(void) {
+    uint8_t pkt[PKT_MAX];
+    reset_link();
+
+    uint16_t len = build_tcp(pkt, 40002, 1, 1, 1, 1000, 0x10, 0);
+    if (round_trip(pkt, len) == 0) return 0;
+    len = build_tcp(pkt, 40002, 2, 1, 1001, 1000, 0x10, 0);     /* ACK +1000 */
+    if (round_trip(pkt, len) == 0) return 0;
+    len = build_tcp(pkt, 40002, 300, 1, 1001, 900, 0x10, 0);    /* Window shrinks, ID jumps */
+    if (round_trip(pkt, len) == 0) return 0;
+    len = build_tcp(pkt, 40002, 301, 1, 1001, 900, 0x30, 0);    /* URG */
+    pkt[20 + 19] = 5;
+    if (round_trip(pkt, len) == 0) return 0;
+    len = build_tcp(pkt, 40002, 302, 1, 1001, 900, 0x10, 0);    /* URG cleared */
+    if (round_trip(pkt, len) == 0) return 0;
+    len = build_tcp(pkt, 40002, 303, 1, 70000, 900, 0x10, 0);   /* ACK delta > 0xFFFF */
+    if (round_trip(pkt, len) == 0) return 0;
+    return 1;
+}
+
+/**
+ * Interleaved flows use separate slots and the NEW_C connection byte
+ */
+static int test_tcp_multiple_flows(void) {
+    uint8_t pkt[PKT_MAX];
+    uint32_t seq[3] = { 100, 200, 300 };
+    reset_link();
+
+    for (int round = 0; round < 5; round++) {
+        for (int f = 0; f < 3; f++) {
+            uint16_t len = build_tcp(pkt, (uint16_t)(41000 + f), (uint16_t)(round + f * 50),
+                                     seq[f], 1, 2048, 0x18, 64);
+            if (round_trip(pkt, len) == 0) return 0;
+            seq[f] += 64;
+        }
+    }
+    return s_rx.rx_errors == 0;
+}
+
+/**
+ * SYN/FIN/RST and fragments are never compressed
+ */
+static int test_uncompressible_packets(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t hdr[SLIP_VJ_MAX_OUT];
+    uint16_t skip;
+    reset_link();
+
+    uint16_t len = build_tcp(pkt, 40003, 1, 1, 0, 1000, 0x02, 0);
+    if (slip_vj_compress(&s_tx, pkt, len, len, hdr, &skip) != 0) return 0;
+
+    len = build_udp(pkt, 5000, 1, 100);
+    pkt[6] = 0x20; /* More fragments */
+    ip_checksum(pkt);
+    if (slip_vj_compress(&s_tx, pkt, SLIP_VJ_MAX_HDR, len, hdr, &skip) != 0) return 0;
+
+    /* Plain IP frames pass through the decompressor untouched */
+    uint16_t hdr_len = 99;
+    return slip_vj_uncompress(&s_rx, pkt, len, hdr, &hdr_len) == 0 && hdr_len == 0;
+}
+
+/**
+ * UDP flows: refresh once, then 5-byte headers
+ */
+static int test_udp_context(void) {
+    uint8_t pkt[PKT_MAX];
+    reset_link();
+
+    for (int i = 0; i < 10; i++) {
+        uint16_t len = build_udp(pkt, 5353, (uint16_t)(i * 3), (uint16_t)(20 + i * 10));
+        uint16_t wire = round_trip(pkt, len);
+        if (wire == 0) return 0;
+        uint16_t expected = (i == 0) ? (uint16_t)(len + 1) : (uint16_t)(len - 28 + 5);
+        if (wire != expected) {
+            printf("\n    Datagram %d: expected %u, got %u\n", i, expected, wire);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * ICMP flows and context slot eviction
+ */
+static int test_icmp_and_eviction(void) {
+    uint8_t pkt[PKT_MAX];
+    reset_link();
+
+    for (int i = 0; i < 6; i++) {
+        uint16_t len = build_icmp(pkt, (uint16_t)i, 56);
+        if (round_trip(pkt, len) == 0) return 0;
+        /* More UDP flows than context slots forces refreshes */
+        len = build_udp(pkt, (uint16_t)(6000 + (i % (TINYPAN_SLIP_VJ_CTX_SLOTS + 1))), (uint16_t)i, 32);
+        if (round_trip(pkt, len) == 0) return 0;
+    }
+    return s_rx.rx_errors == 0;
+}
+
+/**
+ * After an RX error, COMPRESSED_TCP is tossed until the sender refreshes
+ */
+static int test_toss_until_refresh(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX + SLIP_VJ_MAX_OUT];
+    uint8_t out[PKT_MAX + SLIP_VJ_MAX_HDR];
+    reset_link();
+
+    uint16_t len = build_tcp(pkt, 40004, 1, 1, 1, 1000, 0x10, 50);
+    if (round_trip(pkt, len) == 0) return 0;
+
+    /* Frame lost on the air: the receiver sees a framing error */
+    len = build_tcp(pkt, 40004, 2, 51, 1, 1000, 0x10, 50);
+    compress_frame(pkt, len, frame);
+    slip_vj_rx_error(&s_rx);
+
+    len = build_tcp(pkt, 40004, 3, 101, 1, 1000, 0x10, 50);
+    uint16_t frame_len = compress_frame(pkt, len, frame);
+    if (expand_frame(frame, frame_len, out) >= 0) return 0;
+
+    /* The TCP retransmit (or a TX reset) refreshes the slot */
+    slip_vj_tx_reset(&s_tx);
+    len = build_tcp(pkt, 40004, 4, 51, 1, 1000, 0x10, 50);
+    if (round_trip(pkt, len) == 0) return 0;
+    len = build_tcp(pkt, 40004, 5, 101, 1, 1000, 0x10, 50);
+    return round_trip(pkt, len) == 50 + 3;
+}
+
+/**
+ * Truncated and garbage frames are rejected without reading past the end
+ */
+static int test_malformed_frames(void) {
+    uint8_t pkt[PKT_MAX];
+    uint8_t hdr[SLIP_VJ_MAX_HDR];
+    uint16_t hdr_len;
+    reset_link();
+
+    uint16_t len = build_tcp(pkt, 40005, 1, 1, 1, 1000, 0x10, 0);
+    if (round_trip(pkt, len) == 0) return 0;
+
+    const uint8_t truncated_tcp[] = { 0x80 | 0x40 | 0x02, 0x00, 0x12 };
+    const uint8_t bad_slot[] = { 0x80 | 0x40, 0x0F, 0x00, 0x00 };
+    const uint8_t escape_cut[] = { 0x80 | 0x20, 0x00, 0x00, 0x00, 0x01 };
+    const uint8_t unknown_ctx[] = { 0x30 | 0x01, 0x00, 0x01, 0x00, 0x00 };
+    const uint8_t short_refresh[] = { 0x20, 0x45, 0x00 };
+    const uint8_t unknown_type[] = { 0x55, 0x00 };
+
+    if (slip_vj_uncompress(&s_rx, truncated_tcp, sizeof(truncated_tcp), hdr, &hdr_len) >= 0) return 0;
+    if (slip_vj_uncompress(&s_rx, bad_slot, sizeof(bad_slot), hdr, &hdr_len) >= 0) return 0;
+    if (slip_vj_uncompress(&s_rx, escape_cut, sizeof(escape_cut), hdr, &hdr_len) >= 0) return 0;
+    if (slip_vj_uncompress(&s_rx, unknown_ctx, sizeof(unknown_ctx), hdr, &hdr_len) >= 0) return 0;
+    if (slip_vj_uncompress(&s_rx, short_refresh, sizeof(short_refresh), hdr, &hdr_len) >= 0) return 0;
+    if (slip_vj_uncompress(&s_rx, unknown_type, sizeof(unknown_type), hdr, &hdr_len) >= 0) return 0;
+    return s_rx.rx_errors == 6;
+}
+
+/**
+ * Only the compression types are claimed; IPv4, IPv6 and the rest pass by
+ */
+static int test_owned_types(void) {
+    const uint8_t owned[] = { 0x70, 0x7F, 0x80, 0xC5, 0xFF, 0x20, 0x2F, 0x30, 0x3F };
+    const uint8_t foreign[] = { 0x00, 0x10, 0x45, 0x4F, 0x50, 0x60, 0x6F };
+
+    for (size_t i = 0; i < sizeof(owned); i++) {
+        if (!slip_vj_owns_type(owned[i])) return 0;
+    }
+    for (size_t i = 0; i < sizeof(foreign); i++) {
+        if (slip_vj_owns_type(foreign[i])) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Goodput comparison: SLIP wire bytes with and without header compression
+ */
+static int test_goodput_comparison(void) {
+    static const struct { const char* name; uint8_t proto; uint16_t payload; } cases[] = {
+        { "TCP bulk",   6, 1200 },
+        { "TCP bulk",   6,  200 },
+        { "TCP small",  6,   32 },
+        { "UDP",       17,  512 },
+        { "UDP",       17,   32 },
+        { "ICMP echo",  1,   56 },
+    };
+    const uint32_t link_bps = 250000; /* Typical BLE 1M PHY application throughput */
+    const int packets = 100;
+    uint8_t pkt[PKT_MAX];
+    uint8_t frame[PKT_MAX + SLIP_VJ_MAX_OUT];
+    int ok = 1;
+
+    printf("\n");
+    printf("    %-10s %7s %10s %10s %10s %10s\n",
+           "flow", "payload", "plain B", "cslip B", "plain kbps", "cslip kbps");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        uint32_t plain = 0, compressed = 0, goodput = 0;
+        uint32_t seq = 1;
+        reset_link();
+
+        for (int i = 0; i < packets; i++) {
+            uint16_t len;
+            if (cases[c].proto == 6) {
+                len = build_tcp(pkt, 40100, (uint16_t)i, seq, 1, 8192, 0x18, cases[c].payload);
+                seq += cases[c].payload;
+            } else if (cases[c].proto == 17) {
+                len = build_udp(pkt, 40100, (uint16_t)i, cases[c].payload);
+            } else {
+                len = build_icmp(pkt, (uint16_t)i, cases[c].payload);
+            }
+            plain += slip_wire_len(pkt, len);
+            uint16_t frame_len = compress_frame(pkt, len, frame);
+            compressed += slip_wire_len(frame, frame_len);
+            goodput += cases[c].payload;
+        }
+
+        uint32_t plain_kbps = (uint32_t)((uint64_t)link_bps * goodput / plain / 1000);
+        uint32_t cslip_kbps = (uint32_t)((uint64_t)link_bps * goodput / compressed / 1000);
+        printf("    %-10s %7u %10u %10u %10u %10u\n", cases[c].name, cases[c].payload,
+               plain, compressed, plain_kbps, cslip_kbps);
+        if (compressed >= plain) ok = 0;
+    }
+    printf("    ");
+    return ok;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN SLIP Header Compression Tests\n");
+    printf("=====================================\n\n");
+
+    printf("Running tests:\n");
+
+    TEST(tcp_bulk_transfer);
+    TEST(tcp_interactive);
+    TEST(tcp_deltas);
+    TEST(tcp_multiple_flows);
+    TEST(uncompressible_packets);
+    TEST(udp_context);
+    TEST(icmp_and_eviction);
+    TEST(toss_until_refresh);
+    TEST(malformed_frames);
+    TEST(owned_types);
+    TEST(goodput_comparison);
+
+    printf("\n=====================================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
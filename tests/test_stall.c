@@ -0,0 +1,349 @@
+/*
+ * TinyPAN Test - TX Stall Recovery
+ *
+ * Runs the full stack over the mock HAL with lost TX_COMPLETE events and
+ * times each step of the recovery: a stall on an online link is cancelled
+ * and the queue resumes without a reconnect, stalls separated by
+ * completed frames never escalate, back-to-back stalls tear the link down
+ * after TINYPAN_STALL_MAX_RECOVERIES, and a HAL that cannot cancel falls
+ * back to the disconnect at once. A link whose service time jumps past
+ * the timeout costs one cancelled frame: the backed-off timeout lets the
+ * next one complete. The link stays online and keeps its
+ * heartbeat idle time through a stall, and a queue that cannot send at all
+ * is torn down after twice the trained TX timeout.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "../src/tinypan_internal.h"
+#include "test_common.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define ETHERTYPE_L2        0x88B5      /* IEEE local experimental */
+#define FRAME_LEN           200
+#define SERVICE_MS          3           /* TX_COMPLETE delay of a healthy link */
+#define HEARTBEAT_MS        10000
+
+static uint8_t s_payload[FRAME_LEN];
+static uint32_t s_online_at;
+
+static uint32_t s_stall_events = 0;
+static bool s_saw_stalled = false;
+
+static void event_cb(tinypan_event_t event, void* user_data) {
+    (void)user_data;
+    if (event == TINYPAN_EVENT_TX_STALLED) {
+        s_stall_events++;
+    } else if (event == TINYPAN_EVENT_STATE_CHANGED &&
+               tinypan_get_state() == TINYPAN_STATE_STALLED) {
+        s_saw_stalled = true;
+    }
+}
+
+/**
+ * Bring the stack ONLINE over BNEP with a fast, trained TX timeout
+ */
+static int bring_up(void) {
+    tinypan_config_t config;
+    nap_config(&config);
+    config.heartbeat_interval_ms = HEARTBEAT_MS;
+
+    s_stall_events = 0;
+    s_saw_stalled = false;
+    if (!start_stack(&config, event_cb)) return 0;
+    complete_bring_up();
+    s_online_at = hal_get_tick_ms();
+
+    /* Train the timeout down to its floor */
+    mock_hal_set_tx_complete_delay(SERVICE_MS);
+    for (int i = 0; i < 300; i++) {
+        while (tinypan_send_frame(NULL, ETHERTYPE_L2, s_payload, FRAME_LEN, NULL, NULL) == TINYPAN_OK) {
+        }
+        step(1);
+    }
+    return mock_hal_is_connected() && tinypan_get_state() == TINYPAN_STATE_ONLINE;
+}
+
+/**
+ * Keep the TX queue topped up until done() or ms milliseconds
+ * @return milliseconds taken
+ */
+static uint32_t run_until(uint32_t ms, int (*done)(void)) {
+    uint32_t start = hal_get_tick_ms();
+    while (hal_get_tick_ms() - start < ms && !(done && done())) {
+        while (tinypan_send_frame(NULL, ETHERTYPE_L2, s_payload, FRAME_LEN, NULL, NULL) == TINYPAN_OK) {
+        }
+        step(1);
+    }
+    return hal_get_tick_ms() - start;
+}
+
+/**
+ * Lose the TX_COMPLETE of the next count frames
+ * @return tick of the first lost send
+ */
+static uint32_t lose_completions(uint32_t count) {
+    mock_hal_drop_tx_completes(count);
+    uint32_t tx_before = mock_hal_get_tx_count();
+    while (mock_hal_get_tx_count() == tx_before) {
+        tinypan_send_frame(NULL, ETHERTYPE_L2, s_payload, FRAME_LEN, NULL, NULL);
+        step(1);
+    }
+    return hal_get_tick_ms();
+}
+
+static uint32_t stalls(void) {
+    tinypan_stall_stats_t stats;
+    tinypan_get_stall_stats(&stats);
+    return stats.stalls;
+}
+
+static uint32_t s_stalls_before;
+
+static int stall_seen(void) {
+    return stalls() != s_stalls_before;
+}
+
+static int online(void) {
+    return tinypan_get_state() == TINYPAN_STATE_ONLINE;
+}
+
+static int disconnected(void) {
+    return !mock_hal_is_connected();
+}
+
+static int stalled(void) {
+    return tinypan_get_state() == TINYPAN_STATE_STALLED;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * One lost completion: cancelled, resumed, back ONLINE on the same link
+ */
+static int test_cancel_and_resume(void) {
+    if (!bring_up()) return 0;
+
+    s_stalls_before = stalls();
+    lose_completions(1);
+    uint32_t detect_ms = run_until(1000, stall_seen);
+    bool online_while_stalled = !stalled() || tinypan_is_online();
+    uint32_t resume_ms = run_until(1000, online);
+    /* Nothing received since ONLINE: the heartbeat idle time runs on */
+    uint32_t probe_in = supervisor_get_next_timeout_ms();
+    uint32_t idle_ms = hal_get_tick_ms() - s_online_at;
+    uint32_t tx_before = mock_hal_get_tx_count();
+    run_until(200, NULL);
+    uint32_t sent_after = mock_hal_get_tx_count() - tx_before;
+
+    tinypan_stall_stats_t stats;
+    tinypan_get_stall_stats(&stats);
+    printf("\n    lost completion caught after %u ms, queue moving %u ms later"
+           " (recovery %u ms), %u frames in the next 200 ms\n    ",
+           (unsigned)detect_ms, (unsigned)resume_ms,
+           (unsigned)stats.last_recovery_ms, (unsigned)sent_after);
+    bool connected = mock_hal_is_connected();
+    uint32_t cancels = mock_hal_get_cancel_tx_count();
+    tear_down();
+
+    return connected && cancels == 1 &&
+           stats.stalls == 1 && stats.recovered == 1 && stats.disconnects == 0 &&
+           detect_ms <= TINYPAN_TX_TIMEOUT_MIN_MS + 1 &&
+           stats.last_recovery_ms <= SERVICE_MS + 1 &&
+           s_stall_events == 1 && s_saw_stalled && sent_after > 20 &&
+           online_while_stalled && probe_in == HEARTBEAT_MS - idle_ms;
+}
+
+/**
+ * Stalls with completed frames in between are each recovered in place
+ */
+static int test_isolated_stalls_forgiven(void) {
+    if (!bring_up()) return 0;
+
+    for (int i = 0; i < 2 * TINYPAN_STALL_MAX_RECOVERIES + 1; i++) {
+        s_stalls_before = stalls();
+        lose_completions(1);
+        run_until(1000, stall_seen);
+        run_until(100, NULL);
+    }
+
+    tinypan_stall_stats_t stats;
+    tinypan_get_stall_stats(&stats);
+    bool connected = mock_hal_is_connected();
+    tinypan_state_t state = tinypan_get_state();
+    tear_down();
+
+    return connected && state == TINYPAN_STATE_ONLINE &&
+           stats.stalls == 2 * TINYPAN_STALL_MAX_RECOVERIES + 1 &&
+           stats.recovered == stats.stalls && stats.disconnects == 0 &&
+           s_stall_events == stats.stalls;
+}
+
+/**
+ * Back-to-back stalls escalate to a disconnect and a full reconnect
+ */
+static int test_repeated_stalls_disconnect(void) {
+    if (!bring_up()) return 0;
+
+    uint32_t lost_at = lose_completions(TINYPAN_STALL_MAX_RECOVERIES + 1);
+    run_until(5000, disconnected);
+    uint32_t teardown_ms = hal_get_tick_ms() - lost_at;
+    uint32_t cancels = mock_hal_get_cancel_tx_count();
+
+    /* The link is gone: reconnect, set up BNEP and get the address back */
+    mock_hal_simulate_disconnect();
+    tinypan_process();
+    uint32_t down_at = hal_get_tick_ms();
+    for (int i = 0; i < 60000 && tinypan_get_state() != TINYPAN_STATE_CONNECTING; i++) {
+        step(1);
+    }
+    complete_bring_up();
+    uint32_t reconnect_ms = hal_get_tick_ms() - down_at;
+
+    tinypan_stall_stats_t stats;
+    tinypan_get_stall_stats(&stats);
+    printf("\n    %u stalls in a row: link torn down %u ms after the first,"
+           " reconnect took %u ms more (instant handshakes)\n    ",
+           (unsigned)stats.stalls, (unsigned)teardown_ms, (unsigned)reconnect_ms);
+    tinypan_state_t state = tinypan_get_state();
+    tear_down();
+
+    /* Each stall doubles the timeout of the frame after it */
+    uint32_t deadline = 0;
+    uint32_t rto = TINYPAN_TX_TIMEOUT_MIN_MS;
+    for (int i = 0; i <= TINYPAN_STALL_MAX_RECOVERIES; i++) {
+        deadline += rto + 1;
+        rto = (2 * rto < TINYPAN_BNEP_TX_TIMEOUT_MS) ? 2 * rto : TINYPAN_BNEP_TX_TIMEOUT_MS;
+    }
+
+    return cancels == TINYPAN_STALL_MAX_RECOVERIES &&
+           stats.stalls == TINYPAN_STALL_MAX_RECOVERIES + 1 &&
+           stats.recovered == TINYPAN_STALL_MAX_RECOVERIES && stats.disconnects == 1 &&
+           teardown_ms <= deadline && state == TINYPAN_STATE_ONLINE;
+}
+
+/**
+ * A HAL that cannot cancel gets the disconnect straight away
+ */
+static int test_no_cancel_support(void) {
+    if (!bring_up()) return 0;
+    mock_hal_set_cancel_tx(-1);
+
+    uint32_t lost_at = lose_completions(1);
+    run_until(5000, disconnected);
+    uint32_t teardown_ms = hal_get_tick_ms() - lost_at;
+
+    tinypan_stall_stats_t stats;
+    tinypan_get_stall_stats(&stats);
+    printf("\n    no cancel in the HAL: link torn down after %u ms\n    ", (unsigned)teardown_ms);
+    tear_down();
+
+    return stats.stalls == 1 && stats.recovered == 0 && stats.disconnects == 1 &&
+           teardown_ms <= TINYPAN_TX_TIMEOUT_MIN_MS + 1;
+}
+
+/**
+ * Service time jumping from SERVICE_MS to 1.5 x the floor: the first slow
+ * frame is cancelled, the backed-off timeout covers the rest
+ */
+static int test_slowdown_backs_off(void) {
+    if (!bring_up()) return 0;
+
+    s_stalls_before = stalls();
+    mock_hal_set_tx_complete_delay(TINYPAN_TX_TIMEOUT_MIN_MS * 3 / 2);
+    run_until(6000, NULL);
+
+    tinypan_stall_stats_t stats;
+    tinypan_get_stall_stats(&stats);
+    tinypan_tx_timeout_stats_t rto;
+    tinypan_get_tx_timeout_stats(&rto);
+    printf("\n    service %u -> %u ms: %u stall(s), timeout now %u ms\n    ",
+           (unsigned)SERVICE_MS, (unsigned)(TINYPAN_TX_TIMEOUT_MIN_MS * 3 / 2),
+           (unsigned)(stats.stalls - s_stalls_before), (unsigned)rto.timeout_ms);
+    bool connected = mock_hal_is_connected();
+    tinypan_state_t state = tinypan_get_state();
+    tear_down();
+
+    return connected && state == TINYPAN_STATE_ONLINE &&
+           stats.stalls - s_stalls_before == 1 && stats.disconnects == 0 &&
+           rto.timeout_ms > TINYPAN_TX_TIMEOUT_MIN_MS * 3 / 2;
+}
+
+/**
+ * A queue that cannot send at all is torn down after twice the trained timeout
+ */
+static int test_stuck_queue_deadline(void) {
+    if (!bring_up()) return 0;
+
+    /* The frame in flight is lost and the radio takes nothing more */
+    lose_completions(1);
+    mock_hal_set_can_send(false);
+    bool entered = run_until(1000, stalled) < 1000;
+    tinypan_tx_timeout_stats_t rto;
+    tinypan_get_tx_timeout_stats(&rto);
+    uint32_t wake_in = tinypan_get_next_timeout_ms();
+    bool online_while_stalled = tinypan_is_online();
+
+    uint32_t teardown_ms = run_until(5000, disconnected);
+    tinypan_state_t state = tinypan_get_state();
+    printf("\n    queue stuck with a %u ms TX timeout: link torn down %u ms after"
+           " STALLED (fixed deadline %u ms)\n    ",
+           (unsigned)rto.timeout_ms, (unsigned)teardown_ms, (unsigned)(2 * TINYPAN_BNEP_TX_TIMEOUT_MS));
+    tear_down();
+
+    return entered && online_while_stalled && state == TINYPAN_STATE_RECONNECTING &&
+           rto.timeout_ms < TINYPAN_BNEP_TX_TIMEOUT_MS &&
+           wake_in <= 2 * rto.timeout_ms &&
+           teardown_ms >= 2 * rto.timeout_ms && teardown_ms <= 2 * rto.timeout_ms + 1;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN TX Stall Recovery Tests\n");
+    printf("===============================\n\n");
+
+    memset(s_payload, 0x5A, sizeof(s_payload));
+
+    printf("Running tests:\n");
+
+    TEST(cancel_and_resume);
+    TEST(isolated_stalls_forgiven);
+    TEST(repeated_stalls_disconnect);
+    TEST(no_cancel_support);
+    TEST(slowdown_backs_off);
+    TEST(stuck_queue_deadline);
+
+    printf("\n===============================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+/*
+ * TinyPAN Test - TX Bursts
+ *
+ * Checks which frames count as urgent, then runs the SLIP transport on the
+ * mock HAL with a sensor-style sender: a small UDP datagram every 20 ms.
+ * With bursts enabled the radio must wake once per hold instead of once per
+ * datagram, no datagram may wait longer than TINYPAN_TX_BURST_HOLD_MS,
+ * urgent frames must go out at once, and bursts must land on the anchors
+ * the HAL reports.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_transport.h"
+#include "../src/tinypan_burst.h"
+
+#include "lwip/init.h"
+#include "lwip/pbuf.h"
+#include "lwip/netif.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define DGRAM_LEN       120
+#define PERIOD_MS       20
+#define RUN_MS          3000
+#define ANCHOR_MS       30
+
+/* Send tick of each datagram not yet on the air, oldest first */
+#define PENDING_MAX     64
+static uint32_t s_pending[PENDING_MAX];
+static uint32_t s_pending_head = 0;
+static uint32_t s_pending_count = 0;
+
+static uint32_t s_tx_seen = 0;
+static uint32_t s_wakeups = 0;          /* Ticks in which the radio took chunks */
+static uint32_t s_latency_max = 0;
+static uint32_t s_off_anchor = 0;       /* Wake-ups away from an anchor */
+
+static const tinypan_transport_t* s_slip = &transport_slip;
+static struct netif s_netif;
+
+/* The transport hands received frames to the TinyPAN netif */
+struct netif* tinypan_netif_get(void) {
+    return &s_netif;
+}
+
+bool tinypan_netif_rx_admit(struct pbuf* p, uint16_t ip_offset) {
+    (void)p;
+    (void)ip_offset;
+    return true;
+}
+
+u32_t sys_now(void) {
+    return hal_get_tick_ms();
+}
+
+static void hal_event_cb(hal_l2cap_event_t event, int status, void* user_data) {
+    (void)status;
+    (void)user_data;
+    if (event == HAL_L2CAP_EVENT_CAN_SEND_NOW) {
+        s_slip->on_can_send_now();
+    }
+}
+
+/**
+ * Build an IPv4 header with protocol proto and a 4-byte port pair
+ */
+static void fill_ipv4(uint8_t* buf, uint16_t len, uint8_t proto, uint16_t sport, uint16_t dport) {
+    memset(buf, 0x11, len);
+    memset(buf, 0, 24);
+    buf[0] = 0x45;
+    buf[2] = (uint8_t)(len >> 8);
+    buf[3] = (uint8_t)len;
+    buf[8] = 64;
+    buf[9] = proto;
+    buf[12] = 10; buf[15] = 2;     /* 10.0.0.2 */
+    buf[16] = 10; buf[19] = 1;     /* 10.0.0.1 */
+    buf[20] = (uint8_t)(sport >> 8);
+    buf[21] = (uint8_t)sport;
+    buf[22] = (uint8_t)(dport >> 8);
+    buf[23] = (uint8_t)dport;
+}
+
+/**
+ * Build a TCP segment with payload bytes of data
+ */
+static void fill_tcp(uint8_t* buf, uint16_t payload) {
+    uint16_t len = (uint16_t)(40 + payload);
+    fill_ipv4(buf, len, 6, 50000, 443);
+    memset(&buf[24], 0, 16);
+    buf[32] = 0x50;                 /* Data offset: 5 words */
+    buf[33] = 0x10;                 /* ACK */
+}
+
+/**
+ * Queue an IP packet; returns false if the transport refused it
+ */
+static int send_packet(const uint8_t* buf, uint16_t len) {
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (p == NULL) return 0;
+    pbuf_take(p, buf, len);
+    err_t err = s_slip->output(&s_netif, p);
+    pbuf_free(p);
+    if (err == ERR_OK && s_pending_count < PENDING_MAX) {
+        s_pending[(s_pending_head + s_pending_count) % PENDING_MAX] = hal_get_tick_ms();
+        s_pending_count++;
+    }
+    return err == ERR_OK;
+}
+
+/**
+ * Account for chunks the mock took since the last call: one per frame
+ */
+static void account_tx(void) {
+    uint32_t count = mock_hal_get_tx_count();
+    if (count == s_tx_seen) return;
+
+    s_wakeups++;
+    if (hal_get_tick_ms() % ANCHOR_MS != 0) {
+        s_off_anchor++;
+    }
+    for (; s_tx_seen < count && s_pending_count > 0; s_tx_seen++) {
+        uint32_t latency = hal_get_tick_ms() - s_pending[s_pending_head];
+        s_pending_head = (s_pending_head + 1) % PENDING_MAX;
+        s_pending_count--;
+        if (latency > s_latency_max) {
+            s_latency_max = latency;
+        }
+    }
+    s_tx_seen = count;
+}
+
+/**
+ * One millisecond of the application loop, as tinypan_process() runs it
+ */
+static void step(void) {
+    mock_hal_advance_tick_ms(1);
+    hal_bt_poll();
+    if (tinypan_burst_process()) {
+        s_slip->on_can_send_now();
+    }
+    account_tx();
+}
+
+static void link_up(void) {
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+    hal_bt_l2cap_register_event_callback(hal_event_cb, NULL);
+    mock_hal_simulate_connect_success();
+    s_slip->init();
+    s_slip->on_connected();
+    tinypan_burst_reset();
+
+    s_pending_head = 0;
+    s_pending_count = 0;
+    s_tx_seen = mock_hal_get_tx_count();
+    s_wakeups = 0;
+    s_latency_max = 0;
+    s_off_anchor = 0;
+}
+
+static void link_down(void) {
+    s_slip->on_disconnected();
+    s_slip->flush_queues();
+    hal_bt_deinit();
+}
+
+/**
+ * Run the periodic sender for RUN_MS
+ * @return datagrams sent
+ */
+static uint32_t run_periodic(void) {
+    uint8_t buf[DGRAM_LEN];
+    uint32_t sent = 0;
+    for (uint32_t t = 0; t < RUN_MS; t++) {
+        if (t % PERIOD_MS == 7) {
+            fill_ipv4(buf, DGRAM_LEN, 17, 40000, 5000);
+            if (!send_packet(buf, DGRAM_LEN)) return 0;
+            sent++;
+        }
+        step();
+    }
+    /* Let the last hold expire */
+    for (uint32_t t = 0; t <= TINYPAN_TX_BURST_HOLD_MS; t++) {
+        step();
+    }
+    return sent;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Control traffic is urgent, data is not
+ */
+static int test_urgent_classes(void) {
+    uint8_t pkt[80];
+
+    fill_tcp(pkt, 0);
+    if (!tinypan_burst_urgent(0x0800, pkt, 40)) return 0;      /* Pure ACK */
+    fill_tcp(pkt, 40);
+    if (tinypan_burst_urgent(0x0800, pkt, 80)) return 0;       /* Data segment */
+
+    fill_ipv4(pkt, 60, 17, 68, 67);
+    if (!tinypan_burst_urgent(0x0800, pkt, 60)) return 0;      /* DHCP */
+    fill_ipv4(pkt, 60, 17, 40000, 53);
+    if (tinypan_burst_urgent(0x0800, pkt, 60)) return 0;       /* DNS query */
+    fill_ipv4(pkt, 60, 1, 0, 0);
+    if (tinypan_burst_urgent(0x0800, pkt, 60)) return 0;       /* ICMP */
+
+    memset(pkt, 0, sizeof(pkt));
+    if (!tinypan_burst_urgent(0x0806, pkt, 28)) return 0;      /* ARP */
+
+    /* IPv6: neighbour discovery and a bare ACK */
+    pkt[0] = 0x60;
+    pkt[5] = 24;
+    pkt[6] = 58;
+    if (!tinypan_burst_urgent(0x86DD, pkt, 64)) return 0;
+    pkt[5] = 20;
+    pkt[6] = 6;
+    pkt[52] = 0x50;
+    if (!tinypan_burst_urgent(0x86DD, pkt, 60)) return 0;
+    pkt[5] = 60;
+    if (tinypan_burst_urgent(0x86DD, pkt, 80)) return 0;
+
+    /* Truncated headers are not urgent and do no harm */
+    fill_tcp(pkt, 0);
+    return !tinypan_burst_urgent(0x0800, pkt, 30) && !tinypan_burst_urgent(0x0800, pkt, 4);
+}
+
+/**
+ * Periodic datagrams leave in bursts, none held longer than the hold
+ */
+static int test_periodic_batched(void) {
+    link_up();
+    uint32_t sent = run_periodic();
+
+    tinypan_tx_burst_stats_t stats;
+    tinypan_burst_get_stats(&stats);
+    uint32_t hints = 0;
+    bool idle = mock_hal_get_link_idle(&hints);
+
+    printf("\n    %u datagrams, %u radio wake-ups, %u bursts of %u.%u frames (max %u),"
+           " max hold %u ms\n    ",
+           (unsigned)sent, (unsigned)s_wakeups, (unsigned)stats.bursts,
+           (unsigned)(stats.bursts ? stats.frames / stats.bursts : 0),
+           (unsigned)(stats.bursts ? (stats.frames * 10 / stats.bursts) % 10 : 0),
+           (unsigned)stats.max_burst_frames, (unsigned)s_latency_max);
+    link_down();
+
+    return sent > 0 && s_pending_count == 0 && stats.frames == sent &&
+           s_wakeups == stats.bursts && stats.urgent_bursts == 0 &&
+           stats.frames >= 4 * stats.bursts &&
+           s_latency_max <= TINYPAN_TX_BURST_HOLD_MS &&
+           idle && hints >= stats.bursts;
+}
+
+/**
+ * An urgent frame goes out at once and takes the held frames with it
+ */
+static int test_urgent_bypass(void) {
+    uint8_t buf[DGRAM_LEN];
+    link_up();
+
+    fill_ipv4(buf, DGRAM_LEN, 17, 40000, 5000);
+    if (!send_packet(buf, DGRAM_LEN)) return 0;
+    for (int i = 0; i < 10; i++) step();
+    if (s_wakeups != 0 || s_pending_count != 1) return 0;      /* Held */
+
+    fill_tcp(buf, 0);
+    if (!send_packet(buf, 40)) return 0;
+    account_tx();
+    if (s_pending_count != 0 || s_wakeups != 1) return 0;      /* Both sent now */
+
+    /* Alone on an idle link it goes out at once too */
+    for (int i = 0; i < 10; i++) step();
+    fill_ipv4(buf, 60, 17, 68, 67);
+    if (!send_packet(buf, 60)) return 0;
+    account_tx();
+    if (s_pending_count != 0 || s_wakeups != 2) return 0;
+    step();
+
+    tinypan_tx_burst_stats_t stats;
+    tinypan_burst_get_stats(&stats);
+    link_down();
+    return stats.bursts == 2 && stats.urgent_bursts == 2 && stats.frames == 3 &&
+           stats.elapsed_ms == 21;
+}
+
+/**
+ * A full queue does not wait for the hold
+ */
+static int test_full_queue_opens(void) {
+    uint8_t buf[DGRAM_LEN];
+    link_up();
+
+    fill_ipv4(buf, DGRAM_LEN, 17, 40000, 5000);
+    for (int i = 0; i < TINYPAN_TX_QUEUE_LEN - 1; i++) {
+        if (!send_packet(buf, DGRAM_LEN)) return 0;
+    }
+    account_tx();
+    int ok = s_pending_count == 0 && s_wakeups == 1;
+    step();
+    link_down();
+    return ok;
+}
+
+/**
+ * Bursts ride the HAL's anchors
+ */
+static int test_anchored(void) {
+    link_up();
+    mock_hal_set_tx_anchor(ANCHOR_MS);
+    uint32_t sent = run_periodic();
+
+    tinypan_tx_burst_stats_t stats;
+    tinypan_burst_get_stats(&stats);
+    printf("\n    %u bursts, %u off an anchor, max hold %u ms\n    ",
+           (unsigned)stats.bursts, (unsigned)s_off_anchor, (unsigned)s_latency_max);
+    link_down();
+
+    return sent > 0 && s_pending_count == 0 && stats.frames == sent &&
+           s_off_anchor == 0 && s_latency_max <= TINYPAN_TX_BURST_HOLD_MS &&
+           stats.frames >= 3 * stats.bursts;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN TX Burst Tests\n");
+    printf("======================\n\n");
+
+    lwip_init();
+
+    printf("Running tests:\n");
+
+    TEST(urgent_classes);
+    TEST(periodic_batched);
+    TEST(urgent_bypass);
+    TEST(full_queue_opens);
+    TEST(anchored);
+
+    printf("\n======================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+/*
+ * TinyPAN Test - Adaptive TX Completion Timeout
+ *
+ * Checks the service-time estimator, then runs the full stack over the
+ * mock HAL with delayed and lost TX_COMPLETE events: on a healthy link a
+ * lost completion must be caught within TINYPAN_TX_TIMEOUT_MIN_MS rather
+ * than TINYPAN_BNEP_TX_TIMEOUT_MS, and a link whose service time climbs
+ * and jitters under load, or steps up all at once, must never be torn
+ * down.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "../src/tinypan_tx_rto.h"
+#include "test_common.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define ETHERTYPE_L2        0x88B5      /* IEEE local experimental */
+#define FRAME_LEN           200
+
+static uint8_t s_payload[FRAME_LEN];
+static uint32_t s_lcg = 12345;
+
+static uint32_t rand_below(uint32_t n) {
+    s_lcg = s_lcg * 1103515245u + 12345u;
+    return (s_lcg >> 16) % n;
+}
+
+/**
+ * One send -> TX_COMPLETE of r ms through the estimator
+ */
+static void sample(uint32_t r) {
+    tinypan_tx_rto_started();
+    mock_hal_advance_tick_ms(r);
+    tinypan_tx_rto_completed();
+}
+
+/**
+ * Bring the stack up to a BNEP link that accepts raw frames
+ */
+static int bring_up(void) {
+    tinypan_config_t config;
+    nap_config(&config);
+    if (!start_stack(&config, NULL)) return 0;
+    answer_handshake();
+
+    /* Let lwIP's first frames (DHCP) complete */
+    for (int i = 0; i < 50; i++) {
+        step(1);
+    }
+    return mock_hal_is_connected();
+}
+
+/**
+ * Keep the TX queue topped up for ms milliseconds
+ * @return frames accepted
+ */
+static uint32_t run_saturated(uint32_t ms, uint32_t (*delay_for)(uint32_t n)) {
+    uint32_t sent = 0;
+    for (uint32_t t = 0; t < ms && mock_hal_is_connected(); t++) {
+        if (delay_for) {
+            mock_hal_set_tx_complete_delay(delay_for(mock_hal_get_tx_count()));
+        }
+        while (tinypan_send_frame(NULL, ETHERTYPE_L2, s_payload, FRAME_LEN, NULL, NULL) == TINYPAN_OK) {
+            sent++;
+        }
+        step(1);
+    }
+    return sent;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Mean and deviation follow RFC 6298; floor and ceiling hold
+ */
+static int test_estimator(void) {
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+    tinypan_tx_rto_reset();
+
+    /* No sample yet: the fixed timeout */
+    if (tinypan_tx_rto_ms() != TINYPAN_BNEP_TX_TIMEOUT_MS) return 0;
+
+    /* First sample: mean r, deviation r/2 */
+    sample(400);
+    tinypan_tx_timeout_stats_t stats;
+    tinypan_tx_rto_get_stats(&stats);
+    if (stats.srtt_ms != 400 || stats.rttvar_ms != 200 || stats.timeout_ms != 1200) return 0;
+
+    /* A steady fast link decays to the floor */
+    for (int i = 0; i < 100; i++) sample(5);
+    tinypan_tx_rto_get_stats(&stats);
+    if (stats.srtt_ms != 5 || stats.timeout_ms != TINYPAN_TX_TIMEOUT_MIN_MS) return 0;
+
+    /* Each expiry doubles it up to the ceiling and no sample is taken */
+    uint32_t backed_off = TINYPAN_TX_TIMEOUT_MIN_MS;
+    for (int i = 0; i < 8; i++) {
+        tinypan_tx_rto_started();
+        mock_hal_advance_tick_ms(tinypan_tx_rto_ms() + 1);
+        tinypan_tx_rto_expired();
+        tinypan_tx_rto_completed();
+        backed_off = (2 * backed_off < TINYPAN_BNEP_TX_TIMEOUT_MS) ? 2 * backed_off
+                                                                  : TINYPAN_BNEP_TX_TIMEOUT_MS;
+        if (tinypan_tx_rto_ms() != backed_off) return 0;
+    }
+
+    /* The next completion is a fresh sample and the estimate takes over again */
+    sample(5);
+    tinypan_tx_rto_get_stats(&stats);
+    if (stats.timeout_ms != TINYPAN_TX_TIMEOUT_MIN_MS || stats.timeouts != 8) return 0;
+
+    /* Jitter widens it past the longest sample */
+    for (int i = 0; i < 40; i++) sample((i & 1) ? 10 : 900);
+    tinypan_tx_rto_get_stats(&stats);
+    if (stats.timeout_ms <= 900 || stats.max_service_ms != 900) return 0;
+
+    /* Never above the fixed timeout */
+    for (int i = 0; i < 40; i++) sample(1500);
+    if (tinypan_tx_rto_ms() != TINYPAN_BNEP_TX_TIMEOUT_MS) return 0;
+
+    /* A completion that was not started is no sample */
+    tinypan_tx_rto_completed();
+    tinypan_tx_rto_get_stats(&stats);
+    if (stats.samples != 182) return 0;
+
+    /* A new link starts over */
+    tinypan_tx_rto_link_up();
+    hal_bt_deinit();
+    return tinypan_tx_rto_ms() == TINYPAN_BNEP_TX_TIMEOUT_MS;
+}
+
+/**
+ * A lost TX_COMPLETE on a healthy link is caught within the floor
+ */
+static int test_lost_completion(void) {
+    if (!bring_up()) return 0;
+    mock_hal_set_tx_complete_delay(3);
+    uint32_t sent = run_saturated(500, NULL);
+
+    tinypan_tx_timeout_stats_t stats;
+    tinypan_get_tx_timeout_stats(&stats);
+    if (sent < 50 || stats.timeouts != 0 || stats.timeout_ms != TINYPAN_TX_TIMEOUT_MIN_MS) {
+        tinypan_deinit();
+        return 0;
+    }
+
+    /* Lose the completion of the next frame sent; nothing goes out after it */
+    mock_hal_drop_tx_completes(1);
+    uint32_t tx_before = mock_hal_get_tx_count();
+    while (mock_hal_get_tx_count() == tx_before) {
+        step(1);
+    }
+    uint32_t lost_at = hal_get_tick_ms();
+    uint32_t woke = 0;
+    while (mock_hal_is_connected() && hal_get_tick_ms() - lost_at < TINYPAN_BNEP_TX_TIMEOUT_MS) {
+        tinypan_send_frame(NULL, ETHERTYPE_L2, s_payload, FRAME_LEN, NULL, NULL);
+        sleep_step();
+        woke++;
+    }
+    uint32_t detect_ms = hal_get_tick_ms() - lost_at;
+    tinypan_get_tx_timeout_stats(&stats);
+
+    printf("\n    srtt %u ms, timeout %u ms: lost completion caught after %u ms (%u wake-ups),"
+           " fixed timeout %u ms\n    ",
+           (unsigned)stats.srtt_ms, (unsigned)stats.timeout_ms, (unsigned)detect_ms,
+           (unsigned)woke, (unsigned)TINYPAN_BNEP_TX_TIMEOUT_MS);
+    tinypan_deinit();
+
+    /* Caught at the first tick past the floor, with no polling in between */
+    return !mock_hal_is_connected() && stats.timeouts == 1 &&
+           detect_ms == TINYPAN_TX_TIMEOUT_MIN_MS + 1 && woke <= 2;
+}
+
+static uint32_t s_load_base;
+
+/* Service time climbing from 5 to ~250 ms with +-30% jitter */
+static uint32_t loaded_delay(uint32_t n) {
+    n -= s_load_base;
+    uint32_t mean = 5 + ((n < 80) ? n * 3 : 245);
+    return mean * 7 / 10 + rand_below(mean * 6 / 10 + 1);
+}
+
+/**
+ * Slow, jittery completions under load are no stall
+ */
+static int test_no_false_positive_under_load(void) {
+    if (!bring_up()) return 0;
+    s_load_base = mock_hal_get_tx_count();
+    uint32_t sent = run_saturated(20000, loaded_delay);
+
+    tinypan_tx_timeout_stats_t stats;
+    tinypan_get_tx_timeout_stats(&stats);
+    printf("\n    %u frames, service srtt %u ms, dev %u ms, max %u ms, timeout %u ms, %u timeouts\n    ",
+           (unsigned)sent, (unsigned)stats.srtt_ms, (unsigned)stats.rttvar_ms,
+           (unsigned)stats.max_service_ms, (unsigned)stats.timeout_ms, (unsigned)stats.timeouts);
+    bool connected = mock_hal_is_connected();
+    tinypan_deinit();
+
+    return connected && stats.timeouts == 0 && sent > 80 &&
+           stats.max_service_ms > 250 && stats.timeout_ms > stats.max_service_ms &&
+           stats.timeout_ms < TINYPAN_BNEP_TX_TIMEOUT_MS;
+}
+
+static uint32_t s_step_base;
+
+/* 20 ms completions, then 300 ms from the 200th frame on */
+static uint32_t stepped_delay(uint32_t n) {
+    return (n - s_step_base < 200) ? 20 : 300;
+}
+
+/**
+ * A sudden step in service time, with no ramp for the estimator to follow,
+ * is no stall
+ */
+static int test_latency_step(void) {
+    if (!bring_up()) return 0;
+    s_step_base = mock_hal_get_tx_count();
+    uint32_t sent = run_saturated(10000, stepped_delay);
+
+    tinypan_tx_timeout_stats_t stats;
+    tinypan_get_tx_timeout_stats(&stats);
+    printf("\n    20 -> 300 ms step: %u frames, srtt %u ms, timeout %u ms, %u timeouts\n    ",
+           (unsigned)sent, (unsigned)stats.srtt_ms, (unsigned)stats.timeout_ms,
+           (unsigned)stats.timeouts);
+    bool connected = mock_hal_is_connected();
+    tinypan_deinit();
+
+    return connected && stats.timeouts == 0 && sent > 200 &&
+           stats.max_service_ms >= 300 && stats.timeout_ms > stats.max_service_ms;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Adaptive TX Timeout Tests\n");
+    printf("=================================\n\n");
+
+    memset(s_payload, 0x5A, sizeof(s_payload));
+
+    printf("Running tests:\n");
+
+    TEST(estimator);
+    TEST(lost_completion);
+    TEST(no_false_positive_under_load);
+    TEST(latency_step);
+
+    printf("\n=================================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
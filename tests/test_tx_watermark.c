@@ -0,0 +1,315 @@
+/*
+ * TinyPAN Test - TX Watermarks
+ *
+ * Full-stack runs against the simulated NAP: tinypan_tx_available() must
+ * track the transport TX queue, the watermark callback must report
+ * congestion once at the high watermark (frames or bytes) and writability
+ * once the drain path reaches the low watermark, and a producer driven by
+ * the two must get every datagram onto the link, in order, through a link
+ * stall, where one that ignores them loses datagrams to ERR_MEM.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+
+/* settle() drains a full TX queue */
+#define NAP_SETTLE_STEPS    (TINYPAN_TX_QUEUE_LEN + 1)
+#include "test_common.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define CLIENT_IP           0xC0A82C02  /* 192.168.44.2 */
+#define COLLECTOR_IP        0x0A141E32  /* 10.20.30.50, reached through the gateway */
+#define LOCAL_PORT          4000
+#define COLLECTOR_PORT      7000
+
+/* Built with TINYPAN_TX_QUEUE_LEN=5: four frames fit */
+#define QUEUE_FRAMES        (TINYPAN_TX_QUEUE_LEN - 1)
+
+#define SMALL_LEN           32          /* Four of these stay under the byte high watermark */
+#define LARGE_LEN           400         /* Three of these cross it */
+
+#define PRODUCER_COUNT      40
+
+static struct udp_pcb* s_pcb;
+
+/** Watermark callbacks, in the order they ran, with the room left at the time */
+typedef struct {
+    bool writable;
+    uint16_t available;
+} wm_event_t;
+
+static wm_event_t s_events[16];
+static int s_event_count;
+
+/** Callback-driven producer */
+static bool s_producer_on;
+static uint32_t s_next_seq;
+static uint32_t s_send_errors;
+
+static void send_datagram(uint32_t seq, uint16_t len);
+
+static void producer_pump(void) {
+    /* The high watermark equals the queue size, so stopping at zero room
+     * always leaves a writable callback to come */
+    while (s_next_seq < PRODUCER_COUNT && tinypan_tx_available() > 0) {
+        send_datagram(s_next_seq++, SMALL_LEN);
+    }
+}
+
+static void on_watermark(bool writable, void* user_data) {
+    (void)user_data;
+    if (s_event_count < (int)(sizeof(s_events) / sizeof(s_events[0]))) {
+        s_events[s_event_count].writable = writable;
+        s_events[s_event_count].available = tinypan_tx_available();
+    }
+    s_event_count++;
+    if (writable && s_producer_on) {
+        producer_pump();
+    }
+}
+
+static void reset_logs(void) {
+    s_event_count = 0;
+    s_send_errors = 0;
+}
+
+/** Host-order address as tinypan takes it (network byte order) */
+static uint32_t net_addr(uint32_t host) {
+    uint32_t net;
+    uint8_t* b = (uint8_t*)&net;
+    b[0] = (uint8_t)(host >> 24);
+    b[1] = (uint8_t)(host >> 16);
+    b[2] = (uint8_t)(host >> 8);
+    b[3] = (uint8_t)host;
+    return net;
+}
+
+/** Datagram seq: the sequence number, then a pattern derived from it */
+static void send_datagram(uint32_t seq, uint16_t len) {
+    uint8_t buf[LARGE_LEN];
+    ip_addr_t dst;
+
+    memcpy(buf, &seq, sizeof(seq));
+    for (uint16_t i = sizeof(seq); i < len; i++) {
+        buf[i] = (uint8_t)(seq + i * 7);
+    }
+    ip_addr_set_ip4_u32(&dst, net_addr(COLLECTOR_IP));
+
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (p == NULL) {
+        s_send_errors++;
+        return;
+    }
+    pbuf_take(p, buf, len);
+    if (udp_sendto(s_pcb, p, &dst, COLLECTOR_PORT) != ERR_OK) {
+        s_send_errors++;
+    }
+    pbuf_free(p);
+}
+
+/** The n-th newest frame on the link is datagram seq, intact */
+static int sent_datagram(int index_from_newest, uint32_t seq, uint16_t len) {
+    dhcp_sim_udp_t udp;
+    uint32_t got;
+    if (!dhcp_sim_parse_udp(mock_hal_get_tx_history_data(index_from_newest),
+                            mock_hal_get_tx_history_len(index_from_newest), &udp)) {
+        return 0;
+    }
+    if (udp.src_ip != CLIENT_IP || udp.dst_ip != COLLECTOR_IP ||
+        udp.src_port != LOCAL_PORT || udp.dst_port != COLLECTOR_PORT ||
+        !udp.ip_checksum_ok || !udp.udp_checksum_ok || udp.payload_len != len) {
+        return 0;
+    }
+    memcpy(&got, udp.payload, sizeof(got));
+    return got == seq;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * Filling the queue reports congestion once, at the last free slot; a
+ * refused datagram does not report it again. Draining to the low watermark
+ * reports writability once.
+ */
+static int test_frame_watermarks(void) {
+    if (tinypan_tx_available() != 0) return 0;
+    if (bring_online() < 0) return 0;
+    s_pcb = udp_new();
+    if (s_pcb == NULL || udp_bind(s_pcb, IP_ADDR_ANY, LOCAL_PORT) != ERR_OK) return 0;
+    tinypan_set_tx_watermark_callback(on_watermark, NULL);
+    if (tinypan_tx_available() != QUEUE_FRAMES) return 0;
+
+    reset_logs();
+    mock_hal_set_can_send(false);
+    for (uint32_t i = 0; i < QUEUE_FRAMES; i++) {
+        send_datagram(i, SMALL_LEN);
+        if (tinypan_tx_available() != QUEUE_FRAMES - 1 - i) return 0;
+        if (s_event_count != (i == QUEUE_FRAMES - 1 ? 1 : 0)) return 0;
+    }
+    if (s_send_errors != 0 || s_events[0].writable || s_events[0].available != 0) return 0;
+
+    send_datagram(QUEUE_FRAMES, SMALL_LEN);
+    if (s_send_errors != 1 || s_event_count != 1) return 0;
+
+    /* One frame completes per step; writable at TINYPAN_TX_LOW_WATER_FRAMES */
+    mock_hal_set_can_send(true);
+    settle();
+    return s_event_count == 2 && s_events[1].writable &&
+           s_events[1].available == QUEUE_FRAMES - TINYPAN_TX_LOW_WATER_FRAMES &&
+           tinypan_tx_available() == QUEUE_FRAMES;
+}
+
+/**
+ * Large frames reach the byte high watermark before the queue is full, and
+ * are only reported writable once under the byte low watermark
+ */
+static int test_byte_watermarks(void) {
+    reset_logs();
+    mock_hal_set_can_send(false);
+    for (uint32_t i = 0; i < 3; i++) {
+        send_datagram(i, LARGE_LEN);
+    }
+    if (s_send_errors != 0 || s_event_count != 1 || s_events[0].writable ||
+        s_events[0].available != QUEUE_FRAMES - 3) {
+        return 0;
+    }
+
+    uint32_t before = mock_hal_get_tx_count();
+    mock_hal_set_can_send(true);
+    settle();
+    return mock_hal_get_tx_count() == before + 3 &&
+           s_event_count == 2 && s_events[1].writable && s_events[1].available == QUEUE_FRAMES &&
+           sent_datagram(2, 0, LARGE_LEN) && sent_datagram(1, 1, LARGE_LEN) &&
+           sent_datagram(0, 2, LARGE_LEN);
+}
+
+/**
+ * A producer that sends while there is room and resumes from the writable
+ * callback loses nothing, through a link stall, and its datagrams leave in
+ * order
+ */
+static int test_callback_producer(void) {
+    uint32_t expected = 0;
+
+    reset_logs();
+    s_next_seq = 0;
+    s_producer_on = true;
+    uint32_t seen = mock_hal_get_tx_count();
+    producer_pump();
+
+    for (int i = 0; i < 400 && expected < PRODUCER_COUNT; i++) {
+        /* The radio stops taking frames for a while */
+        if (i == 10) mock_hal_set_can_send(false);
+        if (i == 30) mock_hal_set_can_send(true);
+        step(NAP_STEP_MS);
+
+        /* Check what reached the link before the history wraps */
+        uint32_t fresh = mock_hal_get_tx_count() - seen;
+        seen += fresh;
+        if (fresh > 4) return 0;
+        for (int k = (int)fresh - 1; k >= 0; k--) {
+            if (!sent_datagram(k, expected, SMALL_LEN)) return 0;
+            expected++;
+        }
+    }
+    s_producer_on = false;
+
+    /* The stall congested the queue at least once more */
+    return expected == PRODUCER_COUNT && s_next_seq == PRODUCER_COUNT &&
+           s_send_errors == 0 && s_event_count >= 4 && (s_event_count % 2) == 0;
+}
+
+/**
+ * The same stream sent at a fixed rate, blind to the queue, loses datagrams
+ */
+static int test_blind_producer_drops(void) {
+    reset_logs();
+    for (uint32_t i = 0; i < PRODUCER_COUNT; i += 2) {
+        send_datagram(i, SMALL_LEN);
+        send_datagram(i + 1, SMALL_LEN);
+        step(NAP_STEP_MS);
+    }
+    settle();
+    return s_send_errors > 0;
+}
+
+/**
+ * De-initializing forgets the callback
+ */
+static int test_deinit(void) {
+    udp_remove(s_pcb);
+    s_pcb = NULL;
+    tinypan_deinit();
+    if (tinypan_tx_available() != 0) return 0;
+
+    reset_logs();
+    if (bring_online() < 0) return 0;
+    s_pcb = udp_new();
+    if (s_pcb == NULL || udp_bind(s_pcb, IP_ADDR_ANY, LOCAL_PORT) != ERR_OK) return 0;
+    mock_hal_set_can_send(false);
+    for (uint32_t i = 0; i < QUEUE_FRAMES; i++) {
+        send_datagram(i, SMALL_LEN);
+    }
+    mock_hal_set_can_send(true);
+    settle();
+    udp_remove(s_pcb);
+    s_pcb = NULL;
+    return s_event_count == 0 && tinypan_tx_available() == QUEUE_FRAMES;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN TX Watermark Tests\n");
+    printf("==========================\n\n");
+
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(frame_watermarks);
+    TEST(byte_watermarks);
+    TEST(callback_producer);
+    TEST(blind_producer_drops);
+    TEST(deinit);
+
+    tinypan_deinit();
+
+    printf("\n==========================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
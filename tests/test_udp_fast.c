@@ -0,0 +1,392 @@
+/*
+ * TinyPAN Test - UDP Fast Path
+ *
+ * Full-stack runs against the simulated NAP: datagrams sent through
+ * tinypan_udp_send() are parsed off the link and checked field by field
+ * (addresses, ports, lengths, IP ID, both checksums), the fallbacks to
+ * lwIP's UDP path are exercised (frame still queued, large payload, next
+ * hop not yet in the ARP table) and received datagrams are read in place.
+ * A benchmark compares the cost of a send with lwIP's raw udp_sendto().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+#include "test_common.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#else
+#define HAVE_CYCLES 0
+#endif
+
+extern void tinypan_netif_flush_queue(void);
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define CLIENT_IP           0xC0A82C02  /* 192.168.44.2 */
+#define COLLECTOR_IP        0x0A141E32  /* 10.20.30.50, reached through the gateway */
+#define NEIGHBOR_IP         0xC0A82C4D  /* 192.168.44.77, on the PAN subnet */
+#define LOCAL_PORT          4000
+#define COLLECTOR_PORT      7000
+
+static const uint8_t s_neighbor_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x4D };
+
+static tinypan_udp_t* s_flow;
+
+/** Host-order address as tinypan takes it (network byte order) */
+static uint32_t net_addr(uint32_t host) {
+    uint32_t net;
+    uint8_t* b = (uint8_t*)&net;
+    b[0] = (uint8_t)(host >> 24);
+    b[1] = (uint8_t)(host >> 16);
+    b[2] = (uint8_t)(host >> 8);
+    b[3] = (uint8_t)host;
+    return net;
+}
+
+/** Parse the n-th newest frame on the link as a UDP datagram */
+static int last_udp(int index_from_newest, dhcp_sim_udp_t* udp) {
+    return dhcp_sim_parse_udp(mock_hal_get_tx_history_data(index_from_newest),
+                              mock_hal_get_tx_history_len(index_from_newest), udp);
+}
+
+static void fill(uint8_t* buf, uint16_t len, uint8_t seed) {
+    for (uint16_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+/** The datagram carries the payload, addressed as expected, with valid checksums */
+static int check_udp(const dhcp_sim_udp_t* udp, uint32_t dst_ip, uint16_t dst_port,
+                     const uint8_t* payload, uint16_t len) {
+    return udp->src_ip == CLIENT_IP && udp->dst_ip == dst_ip &&
+           udp->src_port == LOCAL_PORT && udp->dst_port == dst_port &&
+           udp->ip_checksum_ok && udp->udp_checksum_ok &&
+           udp->payload_len == len && memcmp(udp->payload, payload, len) == 0;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * A send goes out from the prebuilt frame, to the NAP (the pinned gateway)
+ */
+static int test_fast_send(void) {
+    uint8_t payload[40];
+    tinypan_udp_stats_t stats;
+    dhcp_sim_udp_t udp;
+
+    if (bring_online() < 0) return 0;
+    if (tinypan_udp_open(net_addr(COLLECTOR_IP), COLLECTOR_PORT, LOCAL_PORT, &s_flow) != TINYPAN_OK) {
+        return 0;
+    }
+
+    fill(payload, sizeof(payload), 1);
+    uint32_t before = mock_hal_get_tx_count();
+    if (tinypan_udp_send(s_flow, payload, sizeof(payload)) != TINYPAN_OK) return 0;
+    settle();
+
+    tinypan_get_udp_stats(&stats);
+    if (mock_hal_get_tx_count() != before + 1 || stats.tx_fast != 1 || stats.tx_fallback != 0) {
+        return 0;
+    }
+    /* Compressed BNEP header: addressed to the NAP itself */
+    return last_udp(0, &udp) && udp.bnep_type == 0x02 && udp.ttl > 0 &&
+           check_udp(&udp, COLLECTOR_IP, COLLECTOR_PORT, payload, sizeof(payload));
+}
+
+/**
+ * Lengths, IP ID and checksums are right for every payload size
+ */
+static int test_patched_fields(void) {
+    static const uint16_t sizes[] = { 0, 1, 2, 7, 64, 255, TINYPAN_UDP_MAX_PAYLOAD };
+    uint8_t payload[TINYPAN_UDP_MAX_PAYLOAD];
+    dhcp_sim_udp_t udp;
+    uint16_t last_id = 0;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        fill(payload, sizes[i], (uint8_t)(0xF0 + i));
+        if (tinypan_udp_send(s_flow, payload, sizes[i]) != TINYPAN_OK) return 0;
+        settle();
+        if (!last_udp(0, &udp) || !check_udp(&udp, COLLECTOR_IP, COLLECTOR_PORT, payload, sizes[i])) {
+            printf("\n    bad datagram with %u byte payload\n    ", (unsigned)sizes[i]);
+            return 0;
+        }
+        if (i > 0 && udp.ip_id != (uint16_t)(last_id + 1)) return 0;
+        last_id = udp.ip_id;
+    }
+
+    tinypan_udp_stats_t stats;
+    tinypan_get_udp_stats(&stats);
+    return stats.tx_fallback == 0;
+}
+
+/**
+ * While the frame waits for the radio, the next send takes lwIP's path
+ */
+static int test_fallback_while_queued(void) {
+    uint8_t a[16], b[16];
+    tinypan_udp_stats_t before, after;
+    dhcp_sim_udp_t udp;
+
+    fill(a, sizeof(a), 0x10);
+    fill(b, sizeof(b), 0x20);
+    tinypan_get_udp_stats(&before);
+
+    mock_hal_set_can_send(false);
+    if (tinypan_udp_send(s_flow, a, sizeof(a)) != TINYPAN_OK) return 0;
+    if (tinypan_udp_send(s_flow, b, sizeof(b)) != TINYPAN_OK) return 0;
+    mock_hal_set_can_send(true);
+    settle();
+
+    tinypan_get_udp_stats(&after);
+    if (after.tx_fast != before.tx_fast + 1 || after.tx_fallback != before.tx_fallback + 1) return 0;
+    return last_udp(1, &udp) && check_udp(&udp, COLLECTOR_IP, COLLECTOR_PORT, a, sizeof(a)) &&
+           last_udp(0, &udp) && check_udp(&udp, COLLECTOR_IP, COLLECTOR_PORT, b, sizeof(b));
+}
+
+/**
+ * Payloads over TINYPAN_UDP_MAX_PAYLOAD go through lwIP, up to the MTU
+ */
+static int test_large_payload(void) {
+    static uint8_t payload[1472];
+    tinypan_udp_stats_t before, after;
+    dhcp_sim_udp_t udp;
+
+    fill(payload, sizeof(payload), 0x33);
+    tinypan_get_udp_stats(&before);
+    if (tinypan_udp_send(s_flow, payload, TINYPAN_UDP_MAX_PAYLOAD + 1) != TINYPAN_OK) return 0;
+    settle();
+    tinypan_get_udp_stats(&after);
+    if (after.tx_fallback != before.tx_fallback + 1 || !last_udp(0, &udp) ||
+        !check_udp(&udp, COLLECTOR_IP, COLLECTOR_PORT, payload, TINYPAN_UDP_MAX_PAYLOAD + 1)) {
+        return 0;
+    }
+    return tinypan_udp_send(s_flow, payload, (uint16_t)(tinypan_get_mtu() - 27)) == TINYPAN_ERR_INVALID_PARAM;
+}
+
+/**
+ * A neighbor on the subnet is ARPed by lwIP first, then sent to directly
+ */
+static int test_arp_then_fast(void) {
+    tinypan_udp_t* flow;
+    tinypan_udp_stats_t before, after;
+    uint8_t payload[8];
+    dhcp_sim_udp_t udp;
+
+    fill(payload, sizeof(payload), 0x44);
+    tinypan_get_udp_stats(&before);
+    if (tinypan_udp_open(net_addr(NEIGHBOR_IP), COLLECTOR_PORT, 0, &flow) != TINYPAN_OK) return 0;
+    if (tinypan_udp_send(flow, payload, sizeof(payload)) != TINYPAN_OK) return 0;
+    settle();
+    tinypan_get_udp_stats(&after);
+    if (after.tx_fallback != before.tx_fallback + 1 || after.tx_fast != before.tx_fast) return 0;
+
+    /* ARP reply from the neighbor; lwIP then sends the datagram it held */
+    uint8_t arp[28] = { 0x00, 0x01, 0x08, 0x00, 6, 4, 0x00, 0x02 };
+    memcpy(&arp[8], s_neighbor_mac, 6);
+    arp[14] = 192; arp[15] = 168; arp[16] = 44; arp[17] = 77;
+    memcpy(&arp[18], s_client_mac, 6);
+    arp[24] = 192; arp[25] = 168; arp[26] = 44; arp[27] = 2;
+    tinypan_netif_input(s_client_mac, s_neighbor_mac, 0x0806, arp, sizeof(arp));
+    settle();
+
+    if (tinypan_udp_send(flow, payload, sizeof(payload)) != TINYPAN_OK) return 0;
+    settle();
+    tinypan_get_udp_stats(&after);
+    int ok = after.tx_fast == before.tx_fast + 1 && last_udp(0, &udp) &&
+             udp.dst_ip == NEIGHBOR_IP && memcmp(udp.dst_mac, s_neighbor_mac, 6) == 0 &&
+             udp.ip_checksum_ok && udp.udp_checksum_ok;
+    tinypan_udp_close(flow);
+    return ok;
+}
+
+/**
+ * Broadcasts use the all-ones MAC without ARP
+ */
+static int test_broadcast(void) {
+    static const uint8_t all_ones[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    tinypan_udp_t* flow;
+    tinypan_udp_stats_t before, after;
+    uint8_t payload[12];
+    dhcp_sim_udp_t udp;
+
+    fill(payload, sizeof(payload), 0x55);
+    tinypan_get_udp_stats(&before);
+    if (tinypan_udp_open(0xFFFFFFFF, 9999, 0, &flow) != TINYPAN_OK) return 0;
+    if (tinypan_udp_send(flow, payload, sizeof(payload)) != TINYPAN_OK) return 0;
+    settle();
+    tinypan_get_udp_stats(&after);
+    int ok = after.tx_fast == before.tx_fast + 1 && last_udp(0, &udp) &&
+             udp.dst_ip == 0xFFFFFFFF && memcmp(udp.dst_mac, all_ones, 6) == 0 &&
+             udp.ip_checksum_ok && udp.udp_checksum_ok;
+    tinypan_udp_close(flow);
+    return ok;
+}
+
+/**
+ * Received datagrams are read in place, one queued per flow
+ */
+static int test_recv_in_place(void) {
+    uint8_t pkt[256];
+    const uint8_t* data = NULL;
+    uint16_t len = 0, port = 0;
+    uint32_t src = 0;
+    tinypan_udp_stats_t before, after;
+
+    tinypan_get_udp_stats(&before);
+    if (tinypan_udp_recv(s_flow, &data, &len, NULL, NULL) != TINYPAN_ERR_WOULD_BLOCK) return 0;
+
+    int n = dhcp_sim_build_udp_packet(pkt, sizeof(pkt), s_sim.server_mac, s_client_mac,
+                                      COLLECTOR_IP, CLIENT_IP, COLLECTOR_PORT, LOCAL_PORT,
+                                      (const uint8_t*)"set interval 30", 15);
+    nap_inject(pkt, n);
+    n = dhcp_sim_build_udp_packet(pkt, sizeof(pkt), s_sim.server_mac, s_client_mac,
+                                  COLLECTOR_IP, CLIENT_IP, COLLECTOR_PORT, LOCAL_PORT,
+                                  (const uint8_t*)"overflow", 8);
+    nap_inject(pkt, n);
+    tinypan_get_udp_stats(&after);
+    if (after.rx_datagrams != before.rx_datagrams + TINYPAN_UDP_RX_QUEUE_LEN ||
+        after.rx_dropped != before.rx_dropped + 2 - TINYPAN_UDP_RX_QUEUE_LEN) {
+        return 0;
+    }
+
+    if (tinypan_udp_recv(s_flow, &data, &len, &src, &port) != TINYPAN_OK) return 0;
+    if (len != 15 || memcmp(data, "set interval 30", 15) != 0 ||
+        src != net_addr(COLLECTOR_IP) || port != COLLECTOR_PORT) {
+        return 0;
+    }
+    while (tinypan_udp_recv(s_flow, &data, &len, NULL, NULL) == TINYPAN_OK) {
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * Benchmark
+ * ============================================================================ */
+
+/** TSC cycles on x86, CPU-time nanoseconds elsewhere */
+static uint64_t now_ticks(void) {
+#if HAVE_CYCLES
+    return __rdtsc();
+#else
+    return (uint64_t)((double)clock() * (1e9 / CLOCKS_PER_SEC));
+#endif
+}
+
+/**
+ * @brief Cost of one send, frames kept off the radio and flushed untimed
+ * @param pcb NULL for tinypan_udp_send(), else lwIP raw udp_sendto() on it
+ */
+static double bench(struct udp_pcb* pcb, const uint8_t* payload, uint16_t len, int iters) {
+    ip_addr_t dst;
+    ip_addr_set_ip4_u32(&dst, net_addr(COLLECTOR_IP));
+    uint64_t total = 0;
+
+    mock_hal_set_can_send(false);
+    for (int i = 0; i < iters; i++) {
+        uint64_t t0 = now_ticks();
+        if (pcb == NULL) {
+            tinypan_udp_send(s_flow, payload, len);
+        } else {
+            struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+            if (p != NULL) {
+                pbuf_take(p, payload, len);
+                udp_sendto(pcb, p, &dst, COLLECTOR_PORT);
+                pbuf_free(p);
+            }
+        }
+        total += now_ticks() - t0;
+        tinypan_netif_flush_queue();
+    }
+    mock_hal_set_can_send(true);
+    return (double)total / iters;
+}
+
+static int test_benchmark(void) {
+    static const uint16_t sizes[] = { 16, 64, 256 };
+    uint8_t payload[256];
+    tinypan_udp_stats_t before, after;
+
+    struct udp_pcb* pcb = udp_new();
+    if (pcb == NULL || udp_bind(pcb, IP_ADDR_ANY, LOCAL_PORT + 1) != ERR_OK) return 0;
+
+    tinypan_get_udp_stats(&before);
+    printf("\n");
+    printf("    %6s %14s %14s %8s   (%s per datagram)\n", "bytes", "lwIP raw", "fast path",
+           "speedup", HAVE_CYCLES ? "cycles" : "ns");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        fill(payload, sizes[i], 0x66);
+        bench(NULL, payload, sizes[i], 100);     /* Warm up */
+        double raw = bench(pcb, payload, sizes[i], 20000);
+        double fast = bench(NULL, payload, sizes[i], 20000);
+        printf("    %6u %14.0f %14.0f %7.2fx\n", (unsigned)sizes[i], raw, fast, raw / fast);
+    }
+    printf("    ");
+    tinypan_get_udp_stats(&after);
+    udp_remove(pcb);
+    settle();
+
+    /* Informational: timing is not asserted, but every send must be a fast one */
+    return after.tx_fallback == before.tx_fallback;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN UDP Fast Path Tests\n");
+    printf("===========================\n\n");
+
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(fast_send);
+    TEST(patched_fields);
+    TEST(fallback_while_queued);
+    TEST(large_payload);
+    TEST(arp_then_fast);
+    TEST(broadcast);
+    TEST(recv_in_place);
+    TEST(benchmark);
+
+    tinypan_deinit();
+
+    printf("\n===========================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
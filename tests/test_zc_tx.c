@@ -0,0 +1,268 @@
+/*
+ * TinyPAN Test - Zero-Copy Application TX
+ *
+ * Full-stack runs against the simulated NAP: buffers sent with
+ * tinypan_udp_send_ref() or wrapped with tinypan_pbuf_wrap() must stay
+ * referenced while their frame is queued or in flight, be released exactly
+ * once (on TX_COMPLETE, or when a flush drops the frame), and never be
+ * reported on a failed send.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tinypan.h"
+#include "../include/tinypan_config.h"
+#include "../include/tinypan_hal.h"
+#include "../hal/mock/tinypan_hal_mock.h"
+#include "../src/tinypan_bnep.h"
+#include "dhcp_sim.h"
+#include "test_common.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+/* ============================================================================
+ * Test Helpers
+ * ============================================================================ */
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %s... ", #name); \
+        tests_run++; \
+        if (test_##name()) { \
+            printf("PASSED\n"); \
+            tests_passed++; \
+        } else { \
+            printf("FAILED\n"); \
+        } \
+    } while(0)
+
+#define CLIENT_IP           0xC0A82C02  /* 192.168.44.2 */
+#define COLLECTOR_IP        0x0A141E32  /* 10.20.30.50, reached through the gateway */
+#define LOCAL_PORT          4000
+#define COLLECTOR_PORT      7000
+
+static tinypan_udp_t* s_flow;
+
+/** Release callback record */
+typedef struct {
+    int count;
+    const void* data;
+    void* user_data;
+} done_log_t;
+
+static done_log_t s_done[4];
+
+static void on_done(const void* data, void* user_data) {
+    done_log_t* log = (done_log_t*)user_data;
+    log->count++;
+    log->data = data;
+    log->user_data = user_data;
+}
+
+static void reset_done(void) {
+    memset(s_done, 0, sizeof(s_done));
+}
+
+/** Host-order address as tinypan takes it (network byte order) */
+static uint32_t net_addr(uint32_t host) {
+    uint32_t net;
+    uint8_t* b = (uint8_t*)&net;
+    b[0] = (uint8_t)(host >> 24);
+    b[1] = (uint8_t)(host >> 16);
+    b[2] = (uint8_t)(host >> 8);
+    b[3] = (uint8_t)host;
+    return net;
+}
+
+static void fill(uint8_t* buf, uint16_t len, uint8_t seed) {
+    for (uint16_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+/** The n-th newest frame on the link is a valid datagram to the collector carrying payload */
+static int sent_udp(int index_from_newest, uint16_t src_port, const uint8_t* payload, uint16_t len) {
+    dhcp_sim_udp_t udp;
+    if (!dhcp_sim_parse_udp(mock_hal_get_tx_history_data(index_from_newest),
+                            mock_hal_get_tx_history_len(index_from_newest), &udp)) {
+        return 0;
+    }
+    return udp.src_ip == CLIENT_IP && udp.dst_ip == COLLECTOR_IP &&
+           udp.src_port == src_port && udp.dst_port == COLLECTOR_PORT &&
+           udp.ip_checksum_ok && udp.udp_checksum_ok &&
+           udp.payload_len == len && memcmp(udp.payload, payload, len) == 0;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+/**
+ * The frame goes on the air from the application buffer, which is released
+ * on TX_COMPLETE and not before
+ */
+static int test_release_on_tx_complete(void) {
+    static uint8_t chunk[1024];
+    tinypan_udp_stats_t stats;
+
+    if (bring_online() < 0) return 0;
+    if (tinypan_udp_open(net_addr(COLLECTOR_IP), COLLECTOR_PORT, LOCAL_PORT, &s_flow) != TINYPAN_OK) {
+        return 0;
+    }
+
+    reset_done();
+    fill(chunk, sizeof(chunk), 0x21);
+    uint32_t before = mock_hal_get_tx_count();
+    if (tinypan_udp_send_ref(s_flow, chunk, sizeof(chunk), on_done, &s_done[0]) != TINYPAN_OK) return 0;
+
+    /* Handed to the radio straight away, but not completed yet */
+    if (mock_hal_get_tx_count() != before + 1 || s_done[0].count != 0) return 0;
+    if (!sent_udp(0, LOCAL_PORT, chunk, sizeof(chunk))) return 0;
+
+    settle();
+    tinypan_get_udp_stats(&stats);
+    return s_done[0].count == 1 && s_done[0].data == chunk && s_done[0].user_data == &s_done[0] &&
+           stats.tx_zero_copy == 1 && stats.tx_fallback == 0;
+}
+
+/**
+ * Buffers waiting in the TX queue stay referenced; each is released once,
+ * in order, after its own frame. A send the queue refuses is never reported.
+ */
+static int test_held_while_queued(void) {
+    static uint8_t a[300], b[400], c[50];
+
+    reset_done();
+    fill(a, sizeof(a), 0x31);
+    fill(b, sizeof(b), 0x41);
+    fill(c, sizeof(c), 0x51);
+
+    mock_hal_set_can_send(false);
+    if (tinypan_udp_send_ref(s_flow, a, sizeof(a), on_done, &s_done[0]) != TINYPAN_OK) return 0;
+    if (tinypan_udp_send_ref(s_flow, b, sizeof(b), on_done, &s_done[1]) != TINYPAN_OK) return 0;
+    if (tinypan_udp_send_ref(s_flow, c, sizeof(c), on_done, &s_done[2]) != TINYPAN_ERR_BUSY) return 0;
+
+    for (int i = 0; i < 20; i++) {
+        step(NAP_STEP_MS);
+    }
+    if (s_done[0].count != 0 || s_done[1].count != 0 || s_done[2].count != 0) return 0;
+
+    uint32_t before = mock_hal_get_tx_count();
+    mock_hal_set_can_send(true);
+    hal_bt_l2cap_request_can_send_now();
+    settle();
+
+    return mock_hal_get_tx_count() == before + 2 &&
+           s_done[0].count == 1 && s_done[1].count == 1 && s_done[2].count == 0 &&
+           sent_udp(1, LOCAL_PORT, a, sizeof(a)) && sent_udp(0, LOCAL_PORT, b, sizeof(b));
+}
+
+/**
+ * A failed send leaves the buffer with the application and no callback
+ */
+static int test_no_release_on_error(void) {
+    static uint8_t big[1500];
+
+    reset_done();
+    if (tinypan_udp_send_ref(s_flow, big, (uint16_t)(tinypan_get_mtu() - 27), on_done, &s_done[0]) !=
+        TINYPAN_ERR_INVALID_PARAM) {
+        return 0;
+    }
+    if (tinypan_udp_send_ref(s_flow, NULL, 0, on_done, &s_done[0]) != TINYPAN_ERR_INVALID_PARAM) {
+        return 0;
+    }
+    settle();
+    return s_done[0].count == 0;
+}
+
+/**
+ * Raw lwIP use: the wrapped pbuf outlives the caller's pbuf_free() until
+ * the transport lets go of it. Slots run out at TINYPAN_ZC_TX_SLOTS.
+ */
+static int test_pbuf_wrap(void) {
+    static uint8_t data[200];
+    struct pbuf* held[TINYPAN_ZC_TX_SLOTS];
+
+    reset_done();
+    fill(data, sizeof(data), 0x61);
+
+    struct udp_pcb* pcb = udp_new();
+    if (pcb == NULL || udp_bind(pcb, IP_ADDR_ANY, LOCAL_PORT + 1) != ERR_OK) return 0;
+    ip_addr_t dst;
+    ip_addr_set_ip4_u32(&dst, net_addr(COLLECTOR_IP));
+
+    struct pbuf* p = tinypan_pbuf_wrap(data, sizeof(data), on_done, &s_done[0]);
+    if (p == NULL) return 0;
+    uint32_t before = mock_hal_get_tx_count();
+    if (udp_sendto(pcb, p, &dst, COLLECTOR_PORT) != ERR_OK) return 0;
+    pbuf_free(p);
+    if (s_done[0].count != 0 || mock_hal_get_tx_count() != before + 1) return 0;
+    settle();
+    udp_remove(pcb);
+    if (s_done[0].count != 1 || !sent_udp(0, LOCAL_PORT + 1, data, sizeof(data))) return 0;
+
+    /* Not sent anywhere: released by the last pbuf_free() */
+    for (int i = 0; i < TINYPAN_ZC_TX_SLOTS; i++) {
+        held[i] = tinypan_pbuf_wrap(data, sizeof(data), on_done, &s_done[1]);
+        if (held[i] == NULL) return 0;
+    }
+    if (tinypan_pbuf_wrap(data, sizeof(data), on_done, &s_done[2]) != NULL) return 0;
+    pbuf_free(held[0]);
+    if (s_done[1].count != 1) return 0;
+    held[0] = tinypan_pbuf_wrap(data, sizeof(data), on_done, &s_done[1]);
+    if (held[0] == NULL) return 0;
+    for (int i = 0; i < TINYPAN_ZC_TX_SLOTS; i++) {
+        pbuf_free(held[i]);
+    }
+    return s_done[1].count == 1 + TINYPAN_ZC_TX_SLOTS && s_done[2].count == 0;
+}
+
+/**
+ * Stopping drops the queued frames and releases their buffers unsent
+ */
+static int test_release_on_flush(void) {
+    static uint8_t a[64], b[64];
+
+    reset_done();
+    mock_hal_set_can_send(false);
+    if (tinypan_udp_send_ref(s_flow, a, sizeof(a), on_done, &s_done[0]) != TINYPAN_OK) return 0;
+    if (tinypan_udp_send_ref(s_flow, b, sizeof(b), on_done, &s_done[1]) != TINYPAN_OK) return 0;
+    uint32_t before = mock_hal_get_tx_count();
+
+    tinypan_stop();
+    mock_hal_set_can_send(true);
+    settle();
+    return s_done[0].count == 1 && s_done[1].count == 1 && mock_hal_get_tx_count() == before;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("TinyPAN Zero-Copy TX Tests\n");
+    printf("==========================\n\n");
+
+    hal_bt_init();
+    mock_hal_use_mock_time(true);
+
+    printf("Running tests:\n");
+
+    TEST(release_on_tx_complete);
+    TEST(held_while_queued);
+    TEST(no_release_on_error);
+    TEST(pbuf_wrap);
+    TEST(release_on_flush);
+
+    tinypan_deinit();
+
+    printf("\n==========================\n");
+    printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
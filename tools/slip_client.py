@@ -5,11 +5,22 @@ TinyPAN SLIP Client (Companion App Mock)
 This script connects to the `slip_simulator.py` on 127.0.0.1:8080 and simulates
 the Flutter/Kotlin Companion App. It reads raw bytes, decodes the SLIP frames,
 and parses the underlying IPv4 packets.
+
+When the MCU offers CSLIP header compression (TINYPAN_SLIP_ENABLE_VJ) the
+client answers the HELLO control frame and expands compressed frames with
+`CslipCodec`, a reference implementation of the C codec in
+src/tinypan_slip_vj.c. LZSS payload compression (TINYPAN_SLIP_ENABLE_LZ) is
+handled by `LzssCodec`, which matches src/tinypan_slip_lz.c bit for bit.
+The heartbeat's echo probes (TINYPAN_ENABLE_HEARTBEAT) are answered with
+their tag.
 """
 
+import argparse
+import random
 import socket
 import struct
 import sys
+import time
 
 # SLIP Protocol Constants
 SLIP_END = 0xC0
@@ -17,6 +28,40 @@ SLIP_ESC = 0xDB
 SLIP_ESC_END = 0xDC
 SLIP_ESC_ESC = 0xDD
 
+# Link negotiation control frame: [type][op][features]
+SLIP_CTRL_TYPE = 0x10
+SLIP_CTRL_HELLO = 0x01
+SLIP_CTRL_HELLO_ACK = 0x02
+SLIP_CTRL_ECHO = 0x03
+SLIP_CTRL_ECHO_REPLY = 0x04
+SLIP_FEATURE_VJ = 0x01
+SLIP_FEATURE_LZ = 0x02
+SLIP_FEATURE_ECHO = 0x04
+
+# LZSS payload compression frame: [0x50][W << 4 | L][orig len BE16][bitstream]
+SLIP_LZ_TYPE = 0x50
+
+# CSLIP frame types (first byte of every frame)
+TYPE_IP = 0x40
+TYPE_UNCOMPRESSED_TCP = 0x70
+TYPE_COMPRESSED_TCP = 0x80
+TYPE_CTX_REFRESH = 0x20
+TYPE_CTX_COMPRESSED = 0x30
+
+# RFC 1144 change mask
+NEW_C, NEW_I, TCP_PUSH_BIT, NEW_S, NEW_A, NEW_W, NEW_U = 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+SPECIAL_I = NEW_S | NEW_W | NEW_U
+SPECIAL_D = NEW_S | NEW_A | NEW_W | NEW_U
+SPECIALS_MASK = SPECIAL_D
+
+TH_FIN, TH_SYN, TH_RST, TH_PUSH, TH_ACK, TH_URG = 0x01, 0x02, 0x04, 0x08, 0x10, 0x20
+
+# Load generator probes (slip_simulator.py --mode load): UDP to the discard
+# port carrying [magic][sequence BE32][send time, monotonic ns BE64]
+LOAD_PORT = 9
+LOAD_MAGIC = b'TPLG'
+LOAD_HDR = struct.Struct('!4sIQ')
+
 def parse_ipv4(packet):
     """Deeply parses an IPv4 packet (assuming no IP options for simplicity)"""
     if len(packet) < 20:
@@ -47,62 +92,615 @@ def parse_ipv4(packet):
                 result += f" Payload: '{safe_payload}'"
     return result
 
+def slip_encode(frame):
+    """Wraps a frame in SLIP END delimiters with escaping"""
+    # ESC first, so the ESC bytes inserted for END are not escaped again
+    return b'\xc0' + bytes(frame).replace(b'\xdb', b'\xdb\xdd').replace(b'\xc0', b'\xdb\xdc') + b'\xc0'
+
+def ip_checksum(hdr):
+    """Returns hdr with its IPv4 header checksum recomputed"""
+    hdr = bytearray(hdr)
+    hdr[10:12] = b'\x00\x00'
+    total = sum(struct.unpack('!%dH' % (len(hdr) // 2), bytes(hdr)))
+    while total >> 16:
+        total = (total & 0xFFFF) + (total >> 16)
+    hdr[10:12] = struct.pack('!H', ~total & 0xFFFF)
+    return hdr
+
+class CslipCodec:
+    """
+    CSLIP codec matching src/tinypan_slip_vj.c: RFC 1144 TCP header
+    compression plus the TinyPAN UDP/ICMP context scheme.
+    """
+    def __init__(self, tcp_slots=4, ctx_slots=2):
+        self.tcp_slots = tcp_slots
+        self.ctx_slots = ctx_slots
+        self.reset()
+
+    def reset(self):
+        self.tx_tcp = {}            # slot -> header bytes
+        self.tx_stamp = {}
+        self.tx_clock = 0
+        self.tx_last = None
+        self.tx_ctx = {}
+        self.tx_ctx_next = 0
+        self.rx_tcp = {}
+        self.rx_ctx = {}
+        self.rx_last = 0
+        self.rx_toss = True
+
+    def rx_error(self):
+        self.rx_toss = True
+
+    # --- Compression -------------------------------------------------------
+
+    @staticmethod
+    def _encode(n, allow_zero=False):
+        if n >= 256 or (allow_zero and n == 0):
+            return bytes([0]) + struct.pack('!H', n)
+        return bytes([n])
+
+    def compress(self, pkt):
+        """Returns the wire frame for an IPv4 packet"""
+        pkt = bytes(pkt)
+        if len(pkt) < 20 or pkt[0] >> 4 != 4 or struct.unpack('!H', pkt[2:4])[0] != len(pkt):
+            return pkt
+        if struct.unpack('!H', pkt[6:8])[0] & 0x3FFF:
+            return pkt
+        if pkt[9] == 6:
+            return self._compress_tcp(pkt)
+        return self._compress_ctx(pkt)
+
+    def _compress_tcp(self, pkt):
+        ip_hlen = (pkt[0] & 0x0F) * 4
+        if ip_hlen < 20 or len(pkt) < ip_hlen + 20:
+            return pkt
+        th = pkt[ip_hlen:]
+        hlen = ip_hlen + (th[12] >> 4) * 4
+        if th[12] >> 4 < 5 or hlen > 64 or hlen > len(pkt):
+            return pkt
+        flags = th[13]
+        if flags & (TH_SYN | TH_FIN | TH_RST | TH_ACK) != TH_ACK:
+            return pkt
+
+        slot = None
+        for i, old in self.tx_tcp.items():
+            oip_hlen = (old[0] & 0x0F) * 4
+            if old[12:20] == pkt[12:20] and old[oip_hlen:oip_hlen + 4] == th[:4]:
+                slot = i
+                break
+        found = slot is not None
+        if not found:
+            free = [i for i in range(self.tcp_slots) if i not in self.tx_tcp]
+            slot = free[0] if free else min(self.tx_tcp, key=lambda i: self.tx_stamp[i])
+        self.tx_clock += 1
+        self.tx_stamp[slot] = self.tx_clock
+
+        frame = self._try_compress_tcp(pkt, slot, hlen, ip_hlen, flags) if found else None
+        self.tx_tcp[slot] = pkt[:hlen]
+        if frame is None:
+            self.tx_last = slot
+            frame = bytearray(pkt)
+            frame[0] = TYPE_UNCOMPRESSED_TCP | (pkt[0] & 0x0F)
+            frame[9] = slot
+            return bytes(frame)
+        return frame
+
+    def _try_compress_tcp(self, pkt, slot, hlen, ip_hlen, flags):
+        oip = self.tx_tcp[slot]
+        th, oth = pkt[ip_hlen:], oip[ip_hlen:]
+        if (len(oip) != hlen or oip[0:2] != pkt[0:2] or oip[6:10] != pkt[6:10] or
+                oth[12] != th[12] or oip[20:ip_hlen] != pkt[20:ip_hlen] or
+                oth[20:hlen - ip_hlen] != th[20:hlen - ip_hlen]):
+            return None
+
+        u16 = lambda b, o: struct.unpack('!H', b[o:o + 2])[0]
+        u32 = lambda b, o: struct.unpack('!I', b[o:o + 4])[0]
+        deltas = b''
+        changes = 0
+        if (flags ^ oth[13]) & ~(TH_PUSH | TH_URG) & 0xFF:
+            return None
+        if flags & TH_URG:
+            deltas += self._encode(u16(th, 18), True)
+            changes |= NEW_U
+        elif u16(th, 18) != u16(oth, 18) or oth[13] & TH_URG:
+            return None
+        dw = (u16(th, 14) - u16(oth, 14)) & 0xFFFF
+        if dw:
+            deltas += self._encode(dw)
+            changes |= NEW_W
+        da = (u32(th, 8) - u32(oth, 8)) & 0xFFFFFFFF
+        if da:
+            if da > 0xFFFF:
+                return None
+            deltas += self._encode(da)
+            changes |= NEW_A
+        ds = (u32(th, 4) - u32(oth, 4)) & 0xFFFFFFFF
+        if ds:
+            if ds > 0xFFFF:
+                return None
+            deltas += self._encode(ds)
+            changes |= NEW_S
+
+        last_payload = (u16(oip, 2) - hlen) & 0xFFFFFFFF
+        if changes == 0:
+            if not (u16(pkt, 2) != u16(oip, 2) and u16(oip, 2) == hlen):
+                return None
+        elif changes in (SPECIAL_I, SPECIAL_D):
+            return None
+        elif changes == NEW_S | NEW_A and ds == da == last_payload:
+            changes, deltas = SPECIAL_I, b''
+        elif changes == NEW_S and ds == last_payload:
+            changes, deltas = SPECIAL_D, b''
+
+        di = (u16(pkt, 4) - u16(oip, 4)) & 0xFFFF
+        if di != 1:
+            deltas += self._encode(di, True)
+            changes |= NEW_I
+        if flags & TH_PUSH:
+            changes |= TCP_PUSH_BIT
+
+        if self.tx_last != slot:
+            self.tx_last = slot
+            head = bytes([TYPE_COMPRESSED_TCP | NEW_C | changes, slot])
+        else:
+            head = bytes([TYPE_COMPRESSED_TCP | changes])
+        return head + th[16:18] + deltas + pkt[hlen:]
+
+    def _compress_ctx(self, pkt):
+        if pkt[0] != 0x45 or pkt[9] not in (1, 17):
+            return pkt
+        udp = pkt[9] == 17
+        hlen = 28 if udp else 20
+        if len(pkt) < hlen or (udp and struct.unpack('!H', pkt[24:26])[0] != len(pkt) - 20):
+            return pkt
+        for i, ctx in self.tx_ctx.items():
+            if (ctx[0:2] == pkt[0:2] and ctx[6:10] == pkt[6:10] and ctx[12:20] == pkt[12:20] and
+                    (not udp or ctx[20:24] == pkt[20:24])):
+                head = bytes([TYPE_CTX_COMPRESSED | i]) + pkt[4:6]
+                if udp:
+                    head += pkt[26:28]
+                return head + pkt[hlen:]
+        slot = self.tx_ctx_next
+        self.tx_ctx_next = (slot + 1) % self.ctx_slots
+        self.tx_ctx[slot] = pkt[:hlen]
+        return bytes([TYPE_CTX_REFRESH | slot]) + pkt
+
+    # --- Decompression -----------------------------------------------------
+
+    def decompress(self, frame):
+        """Returns the reconstructed IPv4 packet, or None if it must be dropped"""
+        if not frame:
+            return None
+        ftype = frame[0]
+        if ftype & TYPE_COMPRESSED_TCP:
+            return self._uncompress_tcp(frame)
+        kind = ftype & 0xF0
+        if kind == TYPE_IP:
+            return bytes(frame)
+        if kind == TYPE_UNCOMPRESSED_TCP:
+            ip_hlen = (ftype & 0x0F) * 4
+            if ip_hlen < 20 or len(frame) < ip_hlen + 20:
+                return None
+            hlen = ip_hlen + (frame[ip_hlen + 12] >> 4) * 4
+            slot = frame[9]
+            if hlen > 64 or hlen > len(frame) or slot >= self.tcp_slots:
+                return None
+            pkt = bytearray(frame)
+            pkt[0] = TYPE_IP | (ftype & 0x0F)
+            pkt[9] = 6
+            self.rx_tcp[slot] = bytearray(pkt[:hlen])
+            self.rx_last = slot
+            self.rx_toss = False
+            return bytes(pkt)
+        if kind in (TYPE_CTX_REFRESH, TYPE_CTX_COMPRESSED):
+            slot = ftype & 0x0F
+            if slot >= self.ctx_slots:
+                return None
+            if kind == TYPE_CTX_REFRESH:
+                pkt = frame[1:]
+                if len(pkt) < 20 or pkt[0] != 0x45 or pkt[9] not in (1, 17):
+                    return None
+                if pkt[9] == 17 and len(pkt) < 28:
+                    return None
+                self.rx_ctx[slot] = bytes(pkt[:28 if pkt[9] == 17 else 20])
+                return bytes(pkt)
+            ctx = self.rx_ctx.get(slot)
+            if ctx is None:
+                return None
+            udp = ctx[9] == 17
+            consumed = 5 if udp else 3
+            if len(frame) < consumed:
+                return None
+            payload = frame[consumed:]
+            hdr = bytearray(ctx[:20])
+            hdr[4:6] = frame[1:3]
+            if udp:
+                hdr += ctx[20:24] + struct.pack('!H', 8 + len(payload)) + frame[3:5]
+            hdr[2:4] = struct.pack('!H', len(hdr) + len(payload))
+            hdr[:20] = ip_checksum(hdr[:20])
+            return bytes(hdr) + bytes(payload)
+        return None
+
+    def _uncompress_tcp(self, frame):
+        pos = 1
+        changes = frame[0]
+        try:
+            if changes & NEW_C:
+                if frame[pos] >= self.tcp_slots:
+                    raise IndexError
+                self.rx_last = frame[pos]
+                self.rx_toss = False
+                pos += 1
+            elif self.rx_toss:
+                return None
+            hdr = self.rx_tcp[self.rx_last]
+            ip_hlen = (hdr[0] & 0x0F) * 4
+            th = ip_hlen
+            if len(frame) < pos + 2:
+                raise IndexError
+            hdr[th + 16:th + 18] = frame[pos:pos + 2]
+            pos += 2
+
+            def decode():
+                nonlocal pos
+                if frame[pos] == 0:
+                    if len(frame) < pos + 3:
+                        raise IndexError
+                    val = struct.unpack('!H', frame[pos + 1:pos + 3])[0]
+                    pos += 3
+                else:
+                    val = frame[pos]
+                    pos += 1
+                return val
+
+            def add32(off, n):
+                v = (struct.unpack('!I', hdr[off:off + 4])[0] + n) & 0xFFFFFFFF
+                hdr[off:off + 4] = struct.pack('!I', v)
+
+            def add16(off, n):
+                v = (struct.unpack('!H', hdr[off:off + 2])[0] + n) & 0xFFFF
+                hdr[off:off + 2] = struct.pack('!H', v)
+
+            if changes & TCP_PUSH_BIT:
+                hdr[th + 13] |= TH_PUSH
+            else:
+                hdr[th + 13] &= ~TH_PUSH & 0xFF
+
+            last_payload = struct.unpack('!H', hdr[2:4])[0] - len(hdr)
+            special = changes & SPECIALS_MASK
+            if special == SPECIAL_I:
+                add32(th + 8, last_payload)
+                add32(th + 4, last_payload)
+            elif special == SPECIAL_D:
+                add32(th + 4, last_payload)
+            else:
+                if changes & NEW_U:
+                    hdr[th + 13] |= TH_URG
+                    hdr[th + 18:th + 20] = struct.pack('!H', decode())
+                else:
+                    hdr[th + 13] &= ~TH_URG & 0xFF
+                if changes & NEW_W:
+                    add16(th + 14, decode())
+                if changes & NEW_A:
+                    add32(th + 8, decode())
+                if changes & NEW_S:
+                    add32(th + 4, decode())
+            if changes & NEW_I:
+                add16(4, decode())
+            else:
+                add16(4, 1)
+        except (IndexError, KeyError):
+            self.rx_toss = True
+            return None
+
+        payload = frame[pos:]
+        hdr[2:4] = struct.pack('!H', len(hdr) + len(payload))
+        hdr[:ip_hlen] = ip_checksum(hdr[:ip_hlen])
+        return bytes(hdr) + bytes(payload)
+
+class LzssCodec:
+    """
+    Heatshrink-class LZSS matching src/tinypan_slip_lz.c. Every frame is
+    coded independently; a literal is 1 + 8 bits, a back-reference is
+    0 + W bits (distance - 1) + L bits (length - min_match), MSB first.
+    """
+    def __init__(self, window_bits=8, lookahead_bits=4):
+        self.w = window_bits
+        self.l = lookahead_bits
+
+    @staticmethod
+    def min_match(w, l):
+        return 2 if 1 + w + l < 18 else 3
+
+    def encode(self, data):
+        """Returns the LZ frame, or None if it would not be smaller than data"""
+        data = bytes(data)
+        window = 1 << self.w
+        mm = self.min_match(self.w, self.l)
+        max_match = (1 << self.l) + mm - 1
+        bits = []
+        pos = 0
+        while pos < len(data):
+            max_len = min(len(data) - pos, max_match)
+            best_len, best_dist = 0, 0
+            for cand in range(pos - 1, max(pos - window, 0) - 1, -1):
+                if best_len >= max_len:
+                    break
+                n = 0
+                while n < max_len and data[cand + n] == data[pos + n]:
+                    n += 1
+                if n > best_len:
+                    best_len, best_dist = n, pos - cand
+            if best_len >= mm:
+                bits.append('0' + format(best_dist - 1, '0%db' % self.w) +
+                            format(best_len - mm, '0%db' % self.l))
+                pos += best_len
+            else:
+                bits.append('1' + format(data[pos], '08b'))
+                pos += 1
+        stream = ''.join(bits)
+        stream += '0' * (-len(stream) % 8)
+        body = bytes(int(stream[i:i + 8], 2) for i in range(0, len(stream), 8))
+        frame = bytes([SLIP_LZ_TYPE, (self.w << 4) | self.l]) + struct.pack('!H', len(data)) + body
+        return frame if len(frame) < len(data) else None
+
+    @classmethod
+    def decode(cls, frame):
+        """Returns the decoded frame, or None if it is malformed"""
+        if len(frame) < 4 or frame[0] != SLIP_LZ_TYPE:
+            return None
+        w, l = frame[1] >> 4, frame[1] & 0x0F
+        orig_len = struct.unpack('!H', frame[2:4])[0]
+        if not (4 <= w <= 12 and 2 <= l < w):
+            return None
+        mm = cls.min_match(w, l)
+        stream = ''.join(format(b, '08b') for b in frame[4:])
+        pos = 0
+        out = bytearray()
+
+        def take(n):
+            nonlocal pos
+            if pos + n > len(stream):
+                raise ValueError
+            v = int(stream[pos:pos + n], 2)
+            pos += n
+            return v
+
+        try:
+            while len(out) < orig_len:
+                if take(1):
+                    out.append(take(8))
+                    continue
+                dist, count = take(w) + 1, take(l) + mm
+                if dist > len(out) or count > orig_len - len(out):
+                    return None
+                for _ in range(count):
+                    out.append(out[-dist])
+        except ValueError:
+            return None
+        return bytes(out)
+
 class SlipDecoder:
-    def __init__(self):
+    """
+    Stream decoder built on bytes.find/split so the per-byte work happens in C.
+    Escaped bytes stay in the buffer until their END arrives, so an escape
+    split across two reads needs no extra state.
+    """
+    def __init__(self, max_frame=65536):
         self.buffer = bytearray()
-        self.escape_active = False
+        self.max_frame = max_frame
+        self.errors = 0
+        self.on_error = None    # Called on framing errors (e.g. CslipCodec.rx_error)
+
+    def _error(self):
+        self.errors += 1
+        if self.on_error:
+            self.on_error()
 
     def decode_bytes(self, raw_bytes):
+        if raw_bytes.find(b'\xc0') < 0:
+            self.buffer += raw_bytes
+            if len(self.buffer) > self.max_frame:
+                self.buffer.clear()
+                self._error()
+            return []
+
+        self.buffer += raw_bytes
+        parts = self.buffer.split(b'\xc0')
+        self.buffer = parts.pop()
         packets = []
-        for b in raw_bytes:
-            if b == SLIP_END:
-                if len(self.buffer) > 0:
-                    packets.append(bytes(self.buffer))
-                    self.buffer.clear()
-                self.escape_active = False
-            elif self.escape_active:
-                if b == SLIP_ESC_END:
-                    self.buffer.append(SLIP_END)
-                elif b == SLIP_ESC_ESC:
-                    self.buffer.append(SLIP_ESC)
-                else:
-                    print(f"SLIP Protocol Error: Invalid escape character {hex(b)}")
-                self.escape_active = False
-            elif b == SLIP_ESC:
-                self.escape_active = True
-            else:
-                self.buffer.append(b)
+        for part in parts:
+            if not part:
+                continue
+            if part.find(b'\xdb') >= 0:
+                # Every ESC must pair with ESC_END or ESC_ESC; the pairs cannot
+                # overlap, so counting them is enough to find a stray ESC
+                n_end = part.count(b'\xdb\xdc')
+                n_esc = part.count(b'\xdb\xdd')
+                if part.count(b'\xdb') != n_end + n_esc:
+                    self._error()
+                    continue
+                if n_end:
+                    part = part.replace(b'\xdb\xdc', b'\xc0')
+                if n_esc:
+                    part = part.replace(b'\xdb\xdd', b'\xdb')
+            packets.append(bytes(part))
         return packets
 
+def parse_load_probe(pkt):
+    """Returns (sequence, send time ns) for a load generator packet, else None"""
+    if len(pkt) < 20 or pkt[0] >> 4 != 4 or pkt[9] != 17:
+        return None
+    ihl = (pkt[0] & 0x0F) * 4
+    if len(pkt) < ihl + 8 + LOAD_HDR.size or pkt[ihl + 2:ihl + 4] != struct.pack('!H', LOAD_PORT):
+        return None
+    magic, seq, sent_ns = LOAD_HDR.unpack_from(pkt, ihl + 8)
+    if magic != LOAD_MAGIC:
+        return None
+    return seq, sent_ns
+
+class TrafficStats:
+    """
+    Throughput, frame loss and latency for load generator probes. Loss is
+    derived from sequence gaps, so reordered frames are not counted as lost.
+    Latencies are reservoir-sampled to bound memory on long runs. The send
+    timestamps come from time.monotonic_ns(), so both ends must share a host.
+    """
+    RESERVOIR = 100000
+
+    def __init__(self):
+        self.start = time.monotonic()
+        self.frames = 0
+        self.bytes = 0
+        self.errors = 0
+        self.first_seq = None
+        self.highest_seq = None
+        self.latencies = []
+        self.last = self.start
+        self._rand = random.Random(1)
+        self._mark = (self.start, 0, 0)
+
+    def record(self, seq, size, latency_ns):
+        self.frames += 1
+        self.bytes += size
+        self.last = time.monotonic()
+        if self.first_seq is None:
+            self.start = self.last
+            self._mark = (self.start, 0, 0)
+            self.first_seq = self.highest_seq = seq
+        elif seq > self.highest_seq:
+            self.highest_seq = seq
+        if len(self.latencies) < self.RESERVOIR:
+            self.latencies.append(latency_ns)
+        else:
+            j = self._rand.randrange(self.frames)
+            if j < self.RESERVOIR:
+                self.latencies[j] = latency_ns
+
+    def lost(self, expected=None):
+        """Frames missing from the sequence range seen (or out of `expected`)"""
+        if expected is None:
+            expected = 0 if self.first_seq is None else self.highest_seq - self.first_seq + 1
+        return max(expected - self.frames, 0)
+
+    def percentiles(self, points=(50, 90, 99)):
+        """Latency percentiles and maximum in milliseconds"""
+        if not self.latencies:
+            return None
+        ordered = sorted(self.latencies)
+        last = len(ordered) - 1
+        return [ordered[min(last, p * len(ordered) // 100)] / 1e6 for p in points] + [ordered[last] / 1e6]
+
+    def _line(self, frames, nbytes, seconds, expected):
+        seconds = max(seconds, 1e-9)
+        lost = self.lost(expected)
+        total = self.frames + lost
+        line = (f"{frames / seconds:8.0f} pps {nbytes * 8 / seconds / 1e6:7.3f} Mbps | "
+                f"lost {lost} ({100.0 * lost / total if total else 0.0:.2f}%)")
+        if self.errors:
+            line += f" errors {self.errors}"
+        lat = self.percentiles()
+        if lat:
+            line += " | ms p50 {:.3f} p90 {:.3f} p99 {:.3f} max {:.3f}".format(*lat)
+        return line
+
+    def interval(self, expected=None):
+        """Report line with throughput since the previous call"""
+        now = time.monotonic()
+        since, frames, nbytes = self._mark
+        self._mark = (now, self.frames, self.bytes)
+        return self._line(self.frames - frames, self.bytes - nbytes, now - since, expected)
+
+    def summary(self, expected=None):
+        """Report line with throughput from the first to the last frame"""
+        return (f"{self.frames} frames, {self.bytes} bytes in {self.last - self.start:.1f} s: " +
+                self._line(self.frames, self.bytes, self.last - self.start, expected))
+
 def main():
-    HOST = '127.0.0.1'
-    PORT = 8080
-    
+    parser = argparse.ArgumentParser(description="TinyPAN SLIP companion app mock")
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--interval', type=float, default=1.0,
+                        help="seconds between load statistics lines (0 = summary only)")
+    parser.add_argument('--echo', action='store_true',
+                        help="send load probes back so the simulator can measure round trips")
+    parser.add_argument('--verbose', action='store_true', help="print load probes frame by frame")
+    args = parser.parse_args()
+
     decoder = SlipDecoder()
-    
-    print(f"[Companion App] Connecting to MCU Simulator at {HOST}:{PORT}...")
+    codec = CslipCodec()
+    stats = TrafficStats()
+
+    def on_error():
+        stats.errors += 1
+        codec.rx_error()
+    decoder.on_error = on_error
+
+    print(f"[Companion App] Connecting to MCU Simulator at {args.host}:{args.port}...")
     try:
         with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-            s.connect((HOST, PORT))
+            s.connect((args.host, args.port))
             print("[Companion App] Connected! Listening for SLIP frames...")
-            
+            next_report = time.monotonic() + args.interval
+
             while True:
-                data = s.recv(1024)
+                data = s.recv(65536)
                 if not data:
                     print("[Companion App] Connection closed by Simulator.")
                     break
-                
+
                 # We might receive multiple frames, partial frames, or chunks. The decoder handles it.
                 packets = decoder.decode_bytes(data)
-                for pkt in packets:
-                    print(f"\n<<< Received SLIP Frame ({len(pkt)} bytes) <<<")
+                echo = []
+                for frame in packets:
+                    if frame[0] == SLIP_CTRL_TYPE and len(frame) >= 3:
+                        if frame[1] == SLIP_CTRL_HELLO:
+                            agreed = frame[2] & (SLIP_FEATURE_VJ | SLIP_FEATURE_LZ | SLIP_FEATURE_ECHO)
+                            codec.reset()
+                            s.sendall(slip_encode(bytes([SLIP_CTRL_TYPE, SLIP_CTRL_HELLO_ACK, agreed])))
+                            print(f"[Companion App] HELLO from MCU, features 0x{agreed:02X} accepted")
+                        elif frame[1] == SLIP_CTRL_ECHO:
+                            # Heartbeat probe (TINYPAN_ENABLE_HEARTBEAT): return its tag
+                            s.sendall(slip_encode(bytes([SLIP_CTRL_TYPE, SLIP_CTRL_ECHO_REPLY, frame[2]])))
+                        continue
+
+                    wire_len = len(frame)
+                    if frame[0] == SLIP_LZ_TYPE:
+                        frame = LzssCodec.decode(frame)
+                        if frame is None:
+                            print("\n<<< Dropped corrupt LZ frame <<<")
+                            on_error()
+                            continue
+
+                    pkt = codec.decompress(frame)
+                    if pkt is None:
+                        print(f"\n<<< Dropped undecodable CSLIP frame (type 0x{frame[0]:02X}) <<<")
+                        continue
+
+                    probe = parse_load_probe(pkt)
+                    if probe is not None:
+                        stats.record(probe[0], len(pkt), time.monotonic_ns() - probe[1])
+                        if args.echo:
+                            echo.append(slip_encode(pkt))
+                        if not args.verbose:
+                            continue
+                    print(f"\n<<< Received SLIP Frame ({wire_len} bytes on wire, {len(pkt)} bytes IP) <<<")
                     print(f"    {parse_ipv4(pkt)}")
-                    
+
+                if echo:
+                    s.sendall(b''.join(echo))
+                if args.interval > 0 and stats.frames and time.monotonic() >= next_report:
+                    next_report = time.monotonic() + args.interval
+                    print(f"[Companion App] RX {stats.interval()}")
+
     except ConnectionRefusedError:
         print("\n[Error] Could not connect. Ensure `slip_simulator.py` is running.")
         sys.exit(1)
     except KeyboardInterrupt:
         print("\n[Companion App] Terminated.")
+    if stats.frames:
+        print(f"[Companion App] RX total: {stats.summary()}")
 
 if __name__ == '__main__':
     main()
@@ -7,16 +7,32 @@ It acts as a local TCP Server (simulating the BLE UART pipe). When a Companion A
 connects to it, it continuously streams SLIP-encoded IPv4 ICMP Echo Requests (Pings)
 to simulate live MCU network traffic.
 
+With `--mode load` it becomes a traffic generator for load-testing the
+companion bridge: UDP probes with a configurable size distribution, density
+of bytes that need SLIP escaping, target rate and burst shape. Every probe
+carries a sequence number and a send timestamp, which `slip_client.py` turns
+into throughput, frame loss and latency percentiles. If the client runs with
+`--echo`, the simulator also reports round-trip figures.
+
 Usage:
     python tools/slip_simulator.py
+    python tools/slip_simulator.py --mode load --sizes imix --mbps 2 --duration 10
+    python tools/slip_simulator.py --mode load --sizes uniform:64-1500 --escape 0.05 \\
+        --pps 500 --burst 20
 
 The Companion App should connect to 127.0.0.1:8080 and decode the SLIP stream.
 """
 
+import argparse
+import random
+import select
 import socket
 import struct
+import threading
 import time
 
+from slip_client import LOAD_HDR, LOAD_MAGIC, LOAD_PORT, SlipDecoder, TrafficStats, parse_load_probe
+
 # SLIP Protocol Constants (RFC 1055)
 SLIP_END = 0xC0
 SLIP_ESC = 0xDB
@@ -69,52 +85,206 @@ def build_icmp_echo():
 
 def slip_encode(packet):
     """Encodes a raw bytearray into SLIP format with escape character stuffing"""
-    encoded = bytearray()
-    encoded.append(SLIP_END) # Start delimiter
-    
-    for b in packet:
-        if b == SLIP_END:
-            encoded.append(SLIP_ESC)
-            encoded.append(SLIP_ESC_END)
-        elif b == SLIP_ESC:
-            encoded.append(SLIP_ESC)
-            encoded.append(SLIP_ESC_ESC)
-        else:
-            encoded.append(b)
-            
-    encoded.append(SLIP_END) # End delimiter
-    return bytes(encoded)
+    # ESC first, so the ESC bytes inserted for END are not escaped again
+    return b'\xc0' + bytes(packet).replace(b'\xdb', b'\xdb\xdd').replace(b'\xc0', b'\xdb\xdc') + b'\xc0'
 
-def main():
+# Simple IMIX: 7 x 40, 4 x 576, 1 x 1500 bytes (probes need at least 44)
+IMIX = [44] * 7 + [576] * 4 + [1500]
+MIN_PROBE = 20 + 8 + LOAD_HDR.size
+
+def size_picker(spec, rng):
+    """Returns a function yielding IP packet sizes for a --sizes spec"""
+    kind, _, arg = spec.partition(':')
+    if kind == 'imix':
+        return lambda: rng.choice(IMIX)
+    if kind == 'fixed':
+        size = max(int(arg), MIN_PROBE)
+        return lambda: size
+    if kind == 'uniform':
+        lo, hi = (max(int(v), MIN_PROBE) for v in arg.split('-'))
+        return lambda: rng.randint(lo, hi)
+    if kind == 'list':
+        sizes = [max(int(v), MIN_PROBE) for v in arg.split(',')]
+        return lambda: rng.choice(sizes)
+    raise ValueError(f"unknown size distribution '{spec}'")
+
+class ProbeBuilder:
+    """
+    Builds UDP load probes from 192.168.44.2 to the gateway's discard port.
+    Payload filler is cut from a pre-generated pool in which `escape` of
+    the bytes are SLIP END/ESC, so encoder and decoder escape paths see a
+    controlled load.
+    """
+    POOL = 1 << 16
+
+    def __init__(self, escape, rng):
+        pool = bytearray(rng.getrandbits(8) for _ in range(self.POOL))
+        # Keep the random bytes clear of END/ESC so the density is exact
+        pool = pool.replace(b'\xc0', b'\x00').replace(b'\xdb', b'\x00')
+        for i in rng.sample(range(self.POOL), int(self.POOL * escape)):
+            pool[i] = rng.choice((SLIP_END, SLIP_ESC))
+        self.pool = bytes(pool * 2)
+        self.rng = rng
+        self.src = socket.inet_aton("192.168.44.2")
+        self.dst = socket.inet_aton("192.168.44.1")
+        self.ip_id = 0
+
+    def build(self, size, seq):
+        self.ip_id = (self.ip_id + 1) & 0xFFFF
+        ip = struct.pack('!BBHHHBBH4s4s', 0x45, 0, size, self.ip_id, 0, 64, 17, 0, self.src, self.dst)
+        ip = ip[:10] + struct.pack('!H', checksum(ip)) + ip[12:]
+        # UDP checksum 0: not computed, allowed for IPv4
+        udp = struct.pack('!HHHH', 40000, LOAD_PORT, size - 20, 0)
+        fill = size - MIN_PROBE
+        off = self.rng.randrange(self.POOL)
+        return (ip + udp + LOAD_HDR.pack(LOAD_MAGIC, seq, time.monotonic_ns()) +
+                self.pool[off:off + fill])
+
+def run_load(conn, args):
+    rng = random.Random(args.seed)
+    pick = size_picker(args.sizes, rng)
+    builder = ProbeBuilder(args.escape, rng)
+    rtt = TrafficStats()
+    done = threading.Event()
+
+    def receiver():
+        """Collects probes echoed by `slip_client.py --echo`"""
+        decoder = SlipDecoder()
+        # select() instead of a socket timeout, which would also apply to sendall()
+        while not done.is_set():
+            if not select.select([conn], [], [], 0.2)[0]:
+                continue
+            try:
+                data = conn.recv(65536)
+            except OSError:
+                break
+            if not data:
+                break
+            for pkt in decoder.decode_bytes(data):
+                probe = parse_load_probe(pkt)
+                if probe is not None:
+                    rtt.record(probe[0], len(pkt), time.monotonic_ns() - probe[1])
+
+    rx_thread = threading.Thread(target=receiver, daemon=True)
+    rx_thread.start()
+
+    # Pace whole bursts: the long-run average meets --pps / --mbps, packets
+    # inside a burst leave back to back
+    avg_size = sum(pick() for _ in range(1000)) / 1000.0
+    if args.mbps:
+        pps = args.mbps * 1e6 / 8 / avg_size
+    else:
+        pps = args.pps
+    gap = args.burst / pps if pps else 0.0
+
+    print(f"[MCU Simulator] Load: sizes {args.sizes} (avg {avg_size:.0f} B), escape {args.escape:.1%}, "
+          f"{f'{pps:.0f} pps' if pps else 'unpaced'}, burst {args.burst}")
+    sent = sent_bytes = wire_bytes = 0
+    start = time.monotonic()
+    deadline = start + args.duration if args.duration else None
+    next_burst = start
+    next_report = start + args.interval
+    mark = (start, 0, 0)
+    try:
+        while deadline is None or time.monotonic() < deadline:
+            if args.count and sent >= args.count:
+                break
+            if gap:
+                delay = next_burst - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                next_burst += gap
+
+            frames = []
+            for _ in range(args.burst):
+                pkt = builder.build(pick(), sent)
+                frames.append(slip_encode(pkt))
+                sent += 1
+                sent_bytes += len(pkt)
+            burst = b''.join(frames)
+            wire_bytes += len(burst)
+            conn.sendall(burst)
+
+            now = time.monotonic()
+            if args.interval > 0 and now >= next_report:
+                secs = now - mark[0]
+                print(f"[MCU Simulator] TX {(sent - mark[1]) / secs:8.0f} pps "
+                      f"{(sent_bytes - mark[2]) * 8 / secs / 1e6:7.3f} Mbps"
+                      + (f" | RTT {rtt.interval()}" if rtt.frames else ""))
+                mark = (now, sent, sent_bytes)
+                next_report = now + args.interval
+    except (ConnectionResetError, BrokenPipeError):
+        print("\n[MCU Simulator] Companion App disconnected.")
+    except KeyboardInterrupt:
+        pass
+
+    # Give echoes still in flight a moment before counting them as lost
+    elapsed = time.monotonic() - start
+    time.sleep(0.5)
+    done.set()
+    rx_thread.join()
+    print(f"[MCU Simulator] TX total: {sent} frames, {sent_bytes} bytes IP, {wire_bytes} bytes SLIP "
+          f"({(wire_bytes - sent_bytes) * 100.0 / max(sent_bytes, 1):.1f}% framing overhead) in {elapsed:.1f} s: "
+          f"{sent / elapsed:.0f} pps {sent_bytes * 8 / elapsed / 1e6:.3f} Mbps")
+    if rtt.frames:
+        print(f"[MCU Simulator] RTT total: {rtt.summary(sent)}")
+
+def run_ping(conn):
     print("Building raw IPv4 ICMP packet...")
     raw_packet = build_icmp_echo()
-    
+
     print("SLIP encoding packet...")
     slip_packet = slip_encode(raw_packet)
     print(f"Original Length: {len(raw_packet)} bytes -> SLIP Length: {len(slip_packet)} bytes")
-    
-    HOST = '127.0.0.1'
-    PORT = 8080
-    
+
+    packet_count = 1
+    try:
+        while True:
+            print(f"[MCU Simulator] TX: SLIP ICMP Echo Request #{(packet_count)}")
+            conn.sendall(slip_packet)
+            packet_count += 1
+            time.sleep(2) # Send a ping every 2 seconds
+    except (ConnectionResetError, BrokenPipeError):
+        print("\n[MCU Simulator] Companion App disconnected.")
+    except KeyboardInterrupt:
+        pass
+
+def main():
+    parser = argparse.ArgumentParser(description="TinyPAN BLE SLIP MCU simulator")
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--mode', choices=('ping', 'load'), default='ping',
+                        help="ping: one ICMP echo every 2 s; load: traffic generator")
+    parser.add_argument('--sizes', default='imix',
+                        help="IP size distribution: imix, fixed:N, uniform:A-B or list:A,B,...")
+    parser.add_argument('--escape', type=float, default=0.0,
+                        help="fraction of payload bytes that need SLIP escaping (0..1)")
+    rate = parser.add_mutually_exclusive_group()
+    rate.add_argument('--pps', type=float, default=0.0, help="target packets per second (0 = unpaced)")
+    rate.add_argument('--mbps', type=float, default=0.0, help="target IP throughput in Mbit/s")
+    parser.add_argument('--burst', type=int, default=1, help="packets sent back to back per pacing slot")
+    parser.add_argument('--duration', type=float, default=0.0, help="seconds to run (0 = until stopped)")
+    parser.add_argument('--count', type=int, default=0, help="packets to send (0 = unlimited)")
+    parser.add_argument('--interval', type=float, default=1.0,
+                        help="seconds between statistics lines (0 = summary only)")
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+    if not 0.0 <= args.escape <= 1.0 or args.burst < 1:
+        parser.error("--escape must be within 0..1 and --burst at least 1")
+
     with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
         s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-        s.bind((HOST, PORT))
+        s.bind((args.host, args.port))
         s.listen()
-        
-        print(f"\n[MCU Simulator] Waiting for Companion App to connect on {HOST}:{PORT}...")
+
+        print(f"\n[MCU Simulator] Waiting for Companion App to connect on {args.host}:{args.port}...")
         conn, addr = s.accept()
         with conn:
             print(f"[MCU Simulator] Companion App connected from {addr}")
-            
-            packet_count = 1
-            try:
-                while True:
-                    print(f"[MCU Simulator] TX: SLIP ICMP Echo Request #{(packet_count)}")
-                    conn.sendall(slip_packet)
-                    packet_count += 1
-                    time.sleep(2) # Send a ping every 2 seconds
-            except (ConnectionResetError, BrokenPipeError):
-                print("\n[MCU Simulator] Companion App disconnected.")
+            if args.mode == 'load':
+                run_load(conn, args)
+            else:
+                run_ping(conn)
 
 if __name__ == '__main__':
     main()